@@ -0,0 +1,33 @@
+#include "ast/Trees.h"
+#include "common/BlockPool.h"
+
+using namespace std;
+
+namespace sorbet::ast {
+
+/*
+ * Every pass that builds or rewrites trees allocates lots of small nodes, and freeing a whole file's tree used to mean
+ * one free() per node. Instead, each thread bump-allocates nodes out of its own blocks (see BlockPool), so the nodes
+ * of a file end up next to each other and go back to the system a block at a time.
+ *
+ * Trees outlive the thread and the file that built them (LSP keeps indexed trees around, trees get moved between
+ * ParsedFiles and deep-copied), which is why blocks count their live nodes rather than being tied to a ParsedFile.
+ */
+namespace {
+atomic<int64_t> treeBytes{0};
+thread_local BlockPool treeBlocks(treeBytes);
+} // namespace
+
+void *Expression::operator new(size_t size) {
+    return treeBlocks.allocate(size);
+}
+
+void Expression::operator delete(void *ptr, size_t size) {
+    BlockPool::deallocate(ptr, size, treeBytes);
+}
+
+int64_t Expression::allocatedBytes() {
+    return treeBytes.load(memory_order_relaxed);
+}
+
+} // namespace sorbet::ast
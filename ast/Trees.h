@@ -28,9 +28,44 @@
 
 namespace sorbet::ast {
 
+// One per final tree class, so that cast_tree and TreeMap tell trees apart with a compare or a switch instead of
+// comparing typeids.
+enum class Tag : u1 {
+    ClassDef = 1,
+    MethodDef,
+    If,
+    While,
+    Break,
+    Retry,
+    Next,
+    Return,
+    RescueCase,
+    Rescue,
+    Field,
+    Local,
+    UnresolvedIdent,
+    RestArg,
+    KeywordArg,
+    OptionalArg,
+    BlockArg,
+    ShadowArg,
+    Assign,
+    Send,
+    Cast,
+    Hash,
+    Array,
+    Literal,
+    UnresolvedConstantLit,
+    ConstantLit,
+    ZSuperArgs,
+    Block,
+    InsSeq,
+    EmptyTree,
+};
+
 class Expression {
 public:
-    Expression(core::Loc loc);
+    Expression(Tag tag, core::Loc loc);
     virtual ~Expression() = default;
     virtual std::string toStringWithTabs(const core::GlobalState &gs, int tabs = 0) const = 0;
     std::string toString(const core::GlobalState &gs) const {
@@ -41,6 +76,7 @@ public:
     std::unique_ptr<Expression> deepCopy() const;
     virtual void _sanityCheck() = 0;
     const core::Loc loc;
+    const Tag tag;
 
     class DeepCopyError {};
 
@@ -48,6 +84,12 @@ public:
     virtual std::unique_ptr<Expression> _deepCopy(const Expression *avoid, bool root = false) const = 0;
 
     bool isSelfReference() const;
+
+    // Trees are allocated out of per-thread blocks instead of one malloc per node (see TreeAllocation.cc).
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+    // The memory that all live trees of all threads currently take up.
+    static int64_t allocatedBytes();
 };
 // CheckSize(Expression, 16, 8);
 
@@ -69,13 +111,13 @@ template <class To> const To *cast_tree_const(const Expression *what) {
     return fast_cast<Expression, To>(const_cast<Expression *>(what));
 }
 
-template <class To> bool isa_tree(Expression *what) {
-    return cast_tree<To>(what) != nullptr;
+template <class To> bool isa_tree(const Expression *what) {
+    return cast_tree_const<To>(what) != nullptr;
 }
 
 class Reference : public Expression {
 public:
-    Reference(core::Loc loc);
+    Reference(Tag tag, core::Loc loc);
 };
 // CheckSize(Reference, 16, 8);
 
@@ -84,7 +126,7 @@ public:
     core::Loc declLoc;
     core::SymbolRef symbol;
 
-    Declaration(core::Loc loc, core::Loc declLoc, core::SymbolRef symbol);
+    Declaration(Tag tag, core::Loc loc, core::Loc declLoc, core::SymbolRef symbol);
 };
 // CheckSize(Declaration, 24, 8);
 
@@ -677,4 +719,46 @@ private:
 
 } // namespace sorbet::ast
 
+namespace sorbet {
+// Specialized so that typecase, which goes through fast_cast directly, also gets the cheaper check.
+#define SORBET_TREE_FAST_CAST(name)                                                              \
+    template <> inline ast::name *fast_cast<ast::Expression, ast::name>(ast::Expression *what) { \
+        if (what == nullptr || what->tag != ast::Tag::name) {                                    \
+            return nullptr;                                                                      \
+        }                                                                                        \
+        return static_cast<ast::name *>(what);                                                   \
+    }
+SORBET_TREE_FAST_CAST(ClassDef)
+SORBET_TREE_FAST_CAST(MethodDef)
+SORBET_TREE_FAST_CAST(If)
+SORBET_TREE_FAST_CAST(While)
+SORBET_TREE_FAST_CAST(Break)
+SORBET_TREE_FAST_CAST(Retry)
+SORBET_TREE_FAST_CAST(Next)
+SORBET_TREE_FAST_CAST(Return)
+SORBET_TREE_FAST_CAST(RescueCase)
+SORBET_TREE_FAST_CAST(Rescue)
+SORBET_TREE_FAST_CAST(Field)
+SORBET_TREE_FAST_CAST(Local)
+SORBET_TREE_FAST_CAST(UnresolvedIdent)
+SORBET_TREE_FAST_CAST(RestArg)
+SORBET_TREE_FAST_CAST(KeywordArg)
+SORBET_TREE_FAST_CAST(OptionalArg)
+SORBET_TREE_FAST_CAST(BlockArg)
+SORBET_TREE_FAST_CAST(ShadowArg)
+SORBET_TREE_FAST_CAST(Assign)
+SORBET_TREE_FAST_CAST(Send)
+SORBET_TREE_FAST_CAST(Cast)
+SORBET_TREE_FAST_CAST(Hash)
+SORBET_TREE_FAST_CAST(Array)
+SORBET_TREE_FAST_CAST(Literal)
+SORBET_TREE_FAST_CAST(UnresolvedConstantLit)
+SORBET_TREE_FAST_CAST(ConstantLit)
+SORBET_TREE_FAST_CAST(ZSuperArgs)
+SORBET_TREE_FAST_CAST(Block)
+SORBET_TREE_FAST_CAST(InsSeq)
+SORBET_TREE_FAST_CAST(EmptyTree)
+#undef SORBET_TREE_FAST_CAST
+} // namespace sorbet
+
 #endif // SORBET_TREES_H
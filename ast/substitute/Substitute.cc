@@ -6,9 +6,9 @@
 namespace sorbet::ast {
 
 namespace {
-class SubstWalk {
+template <class Subst> class SubstWalk {
 private:
-    const core::GlobalSubstitution &subst;
+    Subst &subst;
 
     unique_ptr<Expression> substClassName(core::MutableContext ctx, unique_ptr<Expression> node) {
         auto constLit = cast_tree<UnresolvedConstantLit>(node.get());
@@ -42,7 +42,7 @@ private:
     }
 
 public:
-    SubstWalk(const core::GlobalSubstitution &subst) : subst(subst) {}
+    SubstWalk(Subst &subst) : subst(subst) {}
 
     unique_ptr<ClassDef> preTransformClassDef(core::MutableContext ctx, unique_ptr<ClassDef> original) {
         original->name = substClassName(ctx, move(original->name));
@@ -123,7 +123,14 @@ unique_ptr<Expression> Substitute::run(core::MutableContext ctx, const core::Glo
     if (subst.useFastPath()) {
         return what;
     }
-    SubstWalk walk(subst);
+    SubstWalk<const core::GlobalSubstitution> walk(subst);
+    what = TreeMap::apply(ctx, walk, move(what));
+    return what;
+}
+
+unique_ptr<Expression> Substitute::run(core::MutableContext ctx, core::LazyGlobalSubstitution &subst,
+                                       unique_ptr<Expression> what) {
+    SubstWalk<core::LazyGlobalSubstitution> walk(subst);
     what = TreeMap::apply(ctx, walk, move(what));
     return what;
 }
@@ -9,6 +9,8 @@ class Substitute {
 public:
     static std::unique_ptr<Expression> run(core::MutableContext ctx, const core::GlobalSubstitution &subst,
                                            std::unique_ptr<Expression> what);
+    static std::unique_ptr<Expression> run(core::MutableContext ctx, core::LazyGlobalSubstitution &subst,
+                                           std::unique_ptr<Expression> what);
 };
 } // namespace sorbet::ast
 #endif // SORBET_SUBSTITUTE_H
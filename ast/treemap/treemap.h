@@ -638,63 +638,70 @@ private:
         auto loc = what->loc;
 
         try {
-            // TODO: reorder by frequency
             if constexpr (HAS_MEMBER_preTransformExpression<FUNC>::value) {
                 what = PostPonePreTransform_Expression<FUNC, CTX, HAS_MEMBER_preTransformExpression<FUNC>::value>::call(
                     ctx, move(what), func);
             }
 
-            if (isa_tree<EmptyTree>(what.get()) || isa_tree<ZSuperArgs>(what.get())) {
-                return what;
-            }
-
-            if (isa_tree<UnresolvedConstantLit>(what.get())) {
-                return mapUnresolvedConstantLit(
-                    std::unique_ptr<UnresolvedConstantLit>(static_cast<UnresolvedConstantLit *>(what.release())), ctx);
-            } else if (isa_tree<ConstantLit>(what.get())) {
-                return mapConstantLit(std::unique_ptr<ConstantLit>(static_cast<ConstantLit *>(what.release())), ctx);
-            } else if (isa_tree<Send>(what.get())) {
-                return mapSend(std::unique_ptr<Send>(static_cast<Send *>(what.release())), ctx);
-            } else if (isa_tree<Literal>(what.get())) {
-                return mapLiteral(std::unique_ptr<Literal>(static_cast<Literal *>(what.release())), ctx);
-            } else if (UnresolvedIdent *u = cast_tree<UnresolvedIdent>(what.get())) {
-                return mapUnresolvedIdent(
-                    std::unique_ptr<UnresolvedIdent>(static_cast<UnresolvedIdent *>(what.release())), ctx);
-            } else if (isa_tree<Local>(what.get())) {
-                return mapLocal(std::unique_ptr<Local>(static_cast<Local *>(what.release())), ctx);
-            } else if (isa_tree<MethodDef>(what.get())) {
-                return mapMethodDef(std::unique_ptr<MethodDef>(static_cast<MethodDef *>(what.release())), ctx);
-            } else if (isa_tree<InsSeq>(what.get())) {
-                return mapInsSeq(std::unique_ptr<InsSeq>(static_cast<InsSeq *>(what.release())), ctx);
-            } else if (isa_tree<Hash>(what.get())) {
-                return mapHash(std::unique_ptr<Hash>(static_cast<Hash *>(what.release())), ctx);
-            } else if (isa_tree<ClassDef>(what.get())) {
-                return mapClassDef(std::unique_ptr<ClassDef>(static_cast<ClassDef *>(what.release())), ctx);
-            } else if (isa_tree<If>(what.get())) {
-                return mapIf(std::unique_ptr<If>(static_cast<If *>(what.release())), ctx);
-            } else if (isa_tree<While>(what.get())) {
-                return mapWhile(std::unique_ptr<While>(static_cast<While *>(what.release())), ctx);
-            } else if (isa_tree<Break>(what.get())) {
-                return mapBreak(std::unique_ptr<Break>(static_cast<Break *>(what.release())), ctx);
-            } else if (isa_tree<Retry>(what.get())) {
-                return mapRetry(std::unique_ptr<Retry>(static_cast<Retry *>(what.release())), ctx);
-            } else if (isa_tree<Next>(what.get())) {
-                return mapNext(std::unique_ptr<Next>(static_cast<Next *>(what.release())), ctx);
-            } else if (isa_tree<Return>(what.get())) {
-                return mapReturn(std::unique_ptr<Return>(static_cast<Return *>(what.release())), ctx);
-            } else if (isa_tree<Rescue>(what.get())) {
-                return mapRescue(std::unique_ptr<Rescue>(static_cast<Rescue *>(what.release())), ctx);
-            } else if (isa_tree<Field>(what.get())) {
-                return mapField(std::unique_ptr<Field>(static_cast<Field *>(what.release())), ctx);
-            } else if (isa_tree<Assign>(what.get())) {
-                return mapAssign(std::unique_ptr<Assign>(static_cast<Assign *>(what.release())), ctx);
-            } else if (isa_tree<Array>(what.get())) {
-                return mapArray(std::unique_ptr<Array>(static_cast<Array *>(what.release())), ctx);
-            } else if (isa_tree<Cast>(what.get())) {
-                return mapCast(std::unique_ptr<Cast>(static_cast<Cast *>(what.release())), ctx);
-            } else {
-                Exception::raise("should never happen. Forgot to add new tree kind? {}", what->nodeName());
+            switch (what->tag) {
+                case Tag::EmptyTree:
+                case Tag::ZSuperArgs:
+                    return what;
+                case Tag::UnresolvedConstantLit:
+                    return mapUnresolvedConstantLit(
+                        unique_ptr<UnresolvedConstantLit>(static_cast<UnresolvedConstantLit *>(what.release())), ctx);
+                case Tag::ConstantLit:
+                    return mapConstantLit(unique_ptr<ConstantLit>(static_cast<ConstantLit *>(what.release())), ctx);
+                case Tag::Send:
+                    return mapSend(unique_ptr<Send>(static_cast<Send *>(what.release())), ctx);
+                case Tag::Literal:
+                    return mapLiteral(unique_ptr<Literal>(static_cast<Literal *>(what.release())), ctx);
+                case Tag::UnresolvedIdent:
+                    return mapUnresolvedIdent(
+                        unique_ptr<UnresolvedIdent>(static_cast<UnresolvedIdent *>(what.release())), ctx);
+                case Tag::Local:
+                    return mapLocal(unique_ptr<Local>(static_cast<Local *>(what.release())), ctx);
+                case Tag::MethodDef:
+                    return mapMethodDef(unique_ptr<MethodDef>(static_cast<MethodDef *>(what.release())), ctx);
+                case Tag::InsSeq:
+                    return mapInsSeq(unique_ptr<InsSeq>(static_cast<InsSeq *>(what.release())), ctx);
+                case Tag::Hash:
+                    return mapHash(unique_ptr<Hash>(static_cast<Hash *>(what.release())), ctx);
+                case Tag::ClassDef:
+                    return mapClassDef(unique_ptr<ClassDef>(static_cast<ClassDef *>(what.release())), ctx);
+                case Tag::If:
+                    return mapIf(unique_ptr<If>(static_cast<If *>(what.release())), ctx);
+                case Tag::While:
+                    return mapWhile(unique_ptr<While>(static_cast<While *>(what.release())), ctx);
+                case Tag::Break:
+                    return mapBreak(unique_ptr<Break>(static_cast<Break *>(what.release())), ctx);
+                case Tag::Retry:
+                    return mapRetry(unique_ptr<Retry>(static_cast<Retry *>(what.release())), ctx);
+                case Tag::Next:
+                    return mapNext(unique_ptr<Next>(static_cast<Next *>(what.release())), ctx);
+                case Tag::Return:
+                    return mapReturn(unique_ptr<Return>(static_cast<Return *>(what.release())), ctx);
+                case Tag::Rescue:
+                    return mapRescue(unique_ptr<Rescue>(static_cast<Rescue *>(what.release())), ctx);
+                case Tag::Field:
+                    return mapField(unique_ptr<Field>(static_cast<Field *>(what.release())), ctx);
+                case Tag::Assign:
+                    return mapAssign(unique_ptr<Assign>(static_cast<Assign *>(what.release())), ctx);
+                case Tag::Array:
+                    return mapArray(unique_ptr<Array>(static_cast<Array *>(what.release())), ctx);
+                case Tag::Cast:
+                    return mapCast(unique_ptr<Cast>(static_cast<Cast *>(what.release())), ctx);
+                // Only ever found inside the trees above, which map them themselves.
+                case Tag::RescueCase:
+                case Tag::RestArg:
+                case Tag::KeywordArg:
+                case Tag::OptionalArg:
+                case Tag::BlockArg:
+                case Tag::ShadowArg:
+                case Tag::Block:
+                    break;
             }
+            Exception::raise("should never happen. Forgot to add new tree kind? {}", what->nodeName());
         } catch (SorbetException &e) {
             Exception::failInFuzzer();
 
@@ -719,6 +726,97 @@ public:
         }
     }
 };
+
+/**
+ * Runs two tree transformers in a single TreeMap walk instead of one walk each. Every preTransform* hook runs First
+ * and then Second on the same tree, and every postTransform* hook runs First and then, if First left a tree of the
+ * same kind behind, Second.
+ *
+ * This is only equivalent to running First and then Second over the whole tree when the two are compatible: Second
+ * never sees the trees that First's postTransform* hooks build (it sees them in a later walk), and First sees the
+ * children that Second's preTransform* hooks add (it would not, in an earlier one).
+ */
+template <class First, class Second> class FusedTransform {
+private:
+    First &first;
+    Second &second;
+
+    static_assert(!HAS_MEMBER_preTransformExpression<First>::value &&
+                      !HAS_MEMBER_preTransformExpression<Second>::value,
+                  "preTransformExpression can not be fused");
+
+public:
+    FusedTransform(First &first, Second &second) : first(first), second(second) {}
+
+#define FUSED_PRE_TRANSFORM(X)                                                            \
+    template <class CTX> unique_ptr<X> preTransform##X(CTX ctx, unique_ptr<X> original) { \
+        if constexpr (HAS_MEMBER_preTransform##X<First>::value) {                         \
+            original = first.preTransform##X(ctx, move(original));                        \
+        }                                                                                 \
+        if constexpr (HAS_MEMBER_preTransform##X<Second>::value) {                        \
+            original = second.preTransform##X(ctx, move(original));                       \
+        }                                                                                 \
+        return original;                                                                  \
+    }
+
+#define FUSED_POST_TRANSFORM(X)                                                                           \
+    template <class CTX> unique_ptr<Expression> postTransform##X(CTX ctx, unique_ptr<X> original) {       \
+        unique_ptr<Expression> result = move(original);                                                   \
+        if constexpr (HAS_MEMBER_postTransform##X<First>::value) {                                        \
+            result = first.postTransform##X(ctx, unique_ptr<X>(static_cast<X *>(result.release())));      \
+        }                                                                                                 \
+        if constexpr (HAS_MEMBER_postTransform##X<Second>::value) {                                       \
+            if (isa_tree<X>(result.get())) {                                                              \
+                result = second.postTransform##X(ctx, unique_ptr<X>(static_cast<X *>(result.release()))); \
+            }                                                                                             \
+        }                                                                                                 \
+        return result;                                                                                    \
+    }
+
+    FUSED_PRE_TRANSFORM(ClassDef)
+    FUSED_PRE_TRANSFORM(MethodDef)
+    FUSED_PRE_TRANSFORM(If)
+    FUSED_PRE_TRANSFORM(While)
+    FUSED_PRE_TRANSFORM(Break)
+    FUSED_PRE_TRANSFORM(Next)
+    FUSED_PRE_TRANSFORM(Return)
+    FUSED_PRE_TRANSFORM(RescueCase)
+    FUSED_PRE_TRANSFORM(Rescue)
+    FUSED_PRE_TRANSFORM(Assign)
+    FUSED_PRE_TRANSFORM(Send)
+    FUSED_PRE_TRANSFORM(Hash)
+    FUSED_PRE_TRANSFORM(Array)
+    FUSED_PRE_TRANSFORM(Block)
+    FUSED_PRE_TRANSFORM(InsSeq)
+    FUSED_PRE_TRANSFORM(Cast)
+
+    FUSED_POST_TRANSFORM(ClassDef)
+    FUSED_POST_TRANSFORM(MethodDef)
+    FUSED_POST_TRANSFORM(If)
+    FUSED_POST_TRANSFORM(While)
+    FUSED_POST_TRANSFORM(Break)
+    FUSED_POST_TRANSFORM(Retry)
+    FUSED_POST_TRANSFORM(Next)
+    FUSED_POST_TRANSFORM(Return)
+    FUSED_POST_TRANSFORM(RescueCase)
+    FUSED_POST_TRANSFORM(Rescue)
+    FUSED_POST_TRANSFORM(Field)
+    FUSED_POST_TRANSFORM(UnresolvedIdent)
+    FUSED_POST_TRANSFORM(Assign)
+    FUSED_POST_TRANSFORM(Send)
+    FUSED_POST_TRANSFORM(Hash)
+    FUSED_POST_TRANSFORM(Array)
+    FUSED_POST_TRANSFORM(Local)
+    FUSED_POST_TRANSFORM(Literal)
+    FUSED_POST_TRANSFORM(UnresolvedConstantLit)
+    FUSED_POST_TRANSFORM(ConstantLit)
+    FUSED_POST_TRANSFORM(Block)
+    FUSED_POST_TRANSFORM(InsSeq)
+    FUSED_POST_TRANSFORM(Cast)
+
+#undef FUSED_PRE_TRANSFORM
+#undef FUSED_POST_TRANSFORM
+};
 } // namespace sorbet::ast
 
 #endif // SORBET_TREEMAP_H
@@ -0,0 +1,270 @@
+#ifndef SORBET_TREEWALK_H
+#define SORBET_TREEWALK_H
+
+#include "ast/treemap/treemap.h"
+
+namespace sorbet::ast {
+
+class WALKER_EXAMPLE {
+public:
+    // all members are optional, but METHOD NAMES MATTER
+    // Not including the member will skip the call
+    // every kind of tree that TreeMap visits has a preWalk and a postWalk member, e.g.
+    void preWalkClassDef(core::Context ctx, const ClassDef &tree);
+    void postWalkClassDef(core::Context ctx, const ClassDef &tree);
+
+    void preWalkSend(core::Context ctx, const Send &tree);
+    void postWalkSend(core::Context ctx, const Send &tree);
+
+    void postWalkConstantLit(core::Context ctx, const ConstantLit &tree);
+};
+
+#define GENERATE_WALK_HOOKS(X)       \
+    GENERATE_HAS_MEMBER(preWalk##X); \
+    GENERATE_HAS_MEMBER(postWalk##X);
+
+GENERATE_WALK_HOOKS(ClassDef);
+GENERATE_WALK_HOOKS(MethodDef);
+GENERATE_WALK_HOOKS(If);
+GENERATE_WALK_HOOKS(While);
+GENERATE_WALK_HOOKS(Break);
+GENERATE_WALK_HOOKS(Retry);
+GENERATE_WALK_HOOKS(Next);
+GENERATE_WALK_HOOKS(Return);
+GENERATE_WALK_HOOKS(RescueCase);
+GENERATE_WALK_HOOKS(Rescue);
+GENERATE_WALK_HOOKS(Field);
+GENERATE_WALK_HOOKS(Local);
+GENERATE_WALK_HOOKS(UnresolvedIdent);
+GENERATE_WALK_HOOKS(Assign);
+GENERATE_WALK_HOOKS(Send);
+GENERATE_WALK_HOOKS(Cast);
+GENERATE_WALK_HOOKS(Hash);
+GENERATE_WALK_HOOKS(Array);
+GENERATE_WALK_HOOKS(Literal);
+GENERATE_WALK_HOOKS(UnresolvedConstantLit);
+GENERATE_WALK_HOOKS(ConstantLit);
+GENERATE_WALK_HOOKS(ZSuperArgs);
+GENERATE_WALK_HOOKS(Block);
+GENERATE_WALK_HOOKS(InsSeq);
+GENERATE_WALK_HOOKS(EmptyTree);
+
+#define WALK_PRE(X)                                          \
+    if constexpr (HAS_MEMBER_preWalk##X<FUNC>::value) {      \
+        func.preWalk##X(ctx, static_cast<const X &>(*what)); \
+    }
+
+#define WALK_POST(X)                                          \
+    if constexpr (HAS_MEMBER_postWalk##X<FUNC>::value) {      \
+        func.postWalk##X(ctx, static_cast<const X &>(*what)); \
+    }
+
+/**
+ * Like TreeMapper, for passes that only look at trees: it visits the same trees in the same order, but hands FUNC
+ * const references instead of moving every tree out of its parent and back. Nothing is written to the tree, so
+ * several walks may go over the same tree at once.
+ */
+template <class FUNC, class CTX> class TreeWalker {
+private:
+    friend class TreeWalk;
+
+    FUNC &func;
+
+    TreeWalker(FUNC &func) : func(func) {}
+
+    template <class T> void walkArgs(const T &args, CTX ctx) {
+        for (auto &arg : args) {
+            // Only OptionalArgs have subexpressions within them.
+            if (auto *optArg = cast_tree_const<OptionalArg>(arg.get())) {
+                walkIt(optArg->default_.get(), ctx);
+            }
+        }
+    }
+
+    void walkChildren(const Expression *what, CTX ctx) {
+        switch (what->tag) {
+            case Tag::ClassDef: {
+                auto &v = static_cast<const ClassDef &>(*what);
+                // Like TreeMap, we intentionally do not walk v.ancestors nor v.singletonAncestors.
+                for (auto &def : v.rhs) {
+                    walkIt(def.get(), ctx.withOwner(v.symbol));
+                }
+                break;
+            }
+            case Tag::MethodDef: {
+                auto &v = static_cast<const MethodDef &>(*what);
+                walkArgs(v.args, ctx.withOwner(v.symbol));
+                walkIt(v.rhs.get(), ctx.withOwner(v.symbol));
+                break;
+            }
+            case Tag::If: {
+                auto &v = static_cast<const If &>(*what);
+                walkIt(v.cond.get(), ctx);
+                walkIt(v.thenp.get(), ctx);
+                walkIt(v.elsep.get(), ctx);
+                break;
+            }
+            case Tag::While: {
+                auto &v = static_cast<const While &>(*what);
+                walkIt(v.cond.get(), ctx);
+                walkIt(v.body.get(), ctx);
+                break;
+            }
+            case Tag::Break:
+                walkIt(static_cast<const Break &>(*what).expr.get(), ctx);
+                break;
+            case Tag::Next:
+                walkIt(static_cast<const Next &>(*what).expr.get(), ctx);
+                break;
+            case Tag::Return:
+                walkIt(static_cast<const Return &>(*what).expr.get(), ctx);
+                break;
+            case Tag::RescueCase: {
+                auto &v = static_cast<const RescueCase &>(*what);
+                for (auto &el : v.exceptions) {
+                    walkIt(el.get(), ctx);
+                }
+                walkIt(v.var.get(), ctx);
+                walkIt(v.body.get(), ctx);
+                break;
+            }
+            case Tag::Rescue: {
+                auto &v = static_cast<const Rescue &>(*what);
+                walkIt(v.body.get(), ctx);
+                for (auto &el : v.rescueCases) {
+                    walkIt(el.get(), ctx);
+                }
+                walkIt(v.else_.get(), ctx);
+                walkIt(v.ensure.get(), ctx);
+                break;
+            }
+            case Tag::Assign: {
+                auto &v = static_cast<const Assign &>(*what);
+                walkIt(v.lhs.get(), ctx);
+                walkIt(v.rhs.get(), ctx);
+                break;
+            }
+            case Tag::Send: {
+                auto &v = static_cast<const Send &>(*what);
+                walkIt(v.recv.get(), ctx);
+                for (auto &arg : v.args) {
+                    walkIt(arg.get(), ctx);
+                }
+                walkIt(v.block.get(), ctx);
+                break;
+            }
+            case Tag::Cast:
+                walkIt(static_cast<const Cast &>(*what).arg.get(), ctx);
+                break;
+            case Tag::Hash: {
+                auto &v = static_cast<const Hash &>(*what);
+                for (auto &key : v.keys) {
+                    walkIt(key.get(), ctx);
+                }
+                for (auto &value : v.values) {
+                    walkIt(value.get(), ctx);
+                }
+                break;
+            }
+            case Tag::Array:
+                for (auto &elem : static_cast<const Array &>(*what).elems) {
+                    walkIt(elem.get(), ctx);
+                }
+                break;
+            case Tag::Block: {
+                auto &v = static_cast<const Block &>(*what);
+                walkArgs(v.args, ctx);
+                walkIt(v.body.get(), ctx);
+                break;
+            }
+            case Tag::InsSeq: {
+                auto &v = static_cast<const InsSeq &>(*what);
+                for (auto &stat : v.stats) {
+                    walkIt(stat.get(), ctx);
+                }
+                walkIt(v.expr.get(), ctx);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void walkIt(const Expression *what, CTX ctx) {
+        if (what == nullptr) {
+            return;
+        }
+
+        try {
+            switch (what->tag) {
+#define WALK_CASE(X)             \
+    case Tag::X:                 \
+        WALK_PRE(X);             \
+        walkChildren(what, ctx); \
+        WALK_POST(X);            \
+        return;
+                WALK_CASE(ClassDef);
+                WALK_CASE(MethodDef);
+                WALK_CASE(If);
+                WALK_CASE(While);
+                WALK_CASE(Break);
+                WALK_CASE(Retry);
+                WALK_CASE(Next);
+                WALK_CASE(Return);
+                WALK_CASE(RescueCase);
+                WALK_CASE(Rescue);
+                WALK_CASE(Field);
+                WALK_CASE(Local);
+                WALK_CASE(UnresolvedIdent);
+                WALK_CASE(Assign);
+                WALK_CASE(Send);
+                WALK_CASE(Cast);
+                WALK_CASE(Hash);
+                WALK_CASE(Array);
+                WALK_CASE(Literal);
+                WALK_CASE(UnresolvedConstantLit);
+                WALK_CASE(ConstantLit);
+                WALK_CASE(ZSuperArgs);
+                WALK_CASE(Block);
+                WALK_CASE(InsSeq);
+                WALK_CASE(EmptyTree);
+#undef WALK_CASE
+                // Only ever found in the argument lists above, which walk them themselves.
+                case Tag::RestArg:
+                case Tag::KeywordArg:
+                case Tag::OptionalArg:
+                case Tag::BlockArg:
+                case Tag::ShadowArg:
+                    break;
+            }
+            Exception::raise("should never happen. Forgot to add new tree kind? {}",
+                             const_cast<Expression *>(what)->nodeName());
+        } catch (SorbetException &e) {
+            Exception::failInFuzzer();
+
+            throw ReportedRubyException{e, what->loc};
+        }
+    }
+};
+
+#undef WALK_PRE
+#undef WALK_POST
+
+class TreeWalk {
+public:
+    template <typename CTX, typename FUNC> static void apply(CTX ctx, FUNC &func, const Expression *to) {
+        TreeWalker<FUNC, CTX> walker(func);
+        try {
+            walker.walkIt(to, ctx);
+        } catch (ReportedRubyException &exception) {
+            Exception::failInFuzzer();
+            if (auto e = ctx.state.beginError(exception.onLoc, core::errors::Internal::InternalError)) {
+                e.setHeader("Failed to process tree (backtrace is above)");
+            }
+            throw exception.reported;
+        }
+    }
+};
+} // namespace sorbet::ast
+
+#endif // SORBET_TREEWALK_H
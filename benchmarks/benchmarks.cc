@@ -0,0 +1,387 @@
+#include "rapidjson/document.h"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+#include <cxxopts.hpp>
+// ^^^ should go first as they violate our poisons
+
+#include "ast/desugar/Desugar.h"
+#include "benchmarks/corpus.h"
+#include "common/FileOps.h"
+#include "core/ErrorQueue.h"
+#include "core/Unfreeze.h"
+#include "core/serialize/serialize.h"
+#include "main/lsp/wrapper.h"
+#include "main/pipeline/pipeline.h"
+#include "parser/parser.h"
+#include "payload/payload.h"
+#include "resolver/resolver.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "version/version.h"
+#include <chrono>
+
+using namespace std;
+
+namespace sorbet::benchmarks {
+namespace {
+
+// Every phase that gets timed, in the order they run.
+const vector<string> PHASES = {"parse",     "desugar",   "index",         "name",         "resolve",
+                               "typecheck", "serialize", "lsp_slow_path", "lsp_fast_path"};
+
+constexpr string_view LSP_ROOT_PATH = "/benchmarks";
+
+using PhaseSamples = UnorderedMap<string, vector<double>>;
+
+double millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+double median(vector<double> samples) {
+    if (samples.empty()) {
+        return 0;
+    }
+    fast_sort(samples);
+    return samples[samples.size() / 2];
+}
+
+// Runs the command line pipeline one phase at a time. Parsing and desugaring are also timed on their own, on a copy
+// of the state, since `index` interleaves them with the DSL and local variable passes file by file.
+void runPipeline(const core::GlobalState &base, const Corpus &corpus, const realmain::options::Options &opts,
+                 WorkerPool &workers, PhaseSamples &samples) {
+    auto gs = base.deepCopy();
+    vector<core::FileRef> files;
+    {
+        core::UnfreezeFileTable fileTableAccess(*gs);
+        for (auto &file : corpus.files) {
+            auto ref = gs->enterFile(file.path, file.source);
+            ref.data(*gs).strictLevel = realmain::pipeline::decideStrictLevel(*gs, ref, opts);
+            files.emplace_back(ref);
+        }
+    }
+
+    {
+        auto scratch = gs->deepCopy();
+        vector<pair<core::FileRef, unique_ptr<parser::Node>>> parsed;
+        auto start = chrono::steady_clock::now();
+        {
+            core::UnfreezeNameTable nameTableAccess(*scratch);
+            for (auto file : files) {
+                parsed.emplace_back(file, parser::Parser::run(*scratch, file));
+            }
+        }
+        samples["parse"].emplace_back(millisSince(start));
+
+        start = chrono::steady_clock::now();
+        {
+            core::MutableContext ctx(*scratch, core::Symbols::root());
+            core::UnfreezeNameTable nameTableAccess(*scratch);
+            for (auto &[file, node] : parsed) {
+                core::ErrorRegion errs(*scratch, file);
+                ast::desugar::node2Tree(ctx, move(node));
+            }
+        }
+        samples["desugar"].emplace_back(millisSince(start));
+    }
+
+    unique_ptr<KeyValueStore> kvstore;
+    auto start = chrono::steady_clock::now();
+    auto trees = realmain::pipeline::index(gs, files, opts, workers, kvstore);
+    samples["index"].emplace_back(millisSince(start));
+
+    start = chrono::steady_clock::now();
+    trees = realmain::pipeline::name(*gs, move(trees), opts, workers);
+    samples["name"].emplace_back(millisSince(start));
+
+    // The same as the resolving half of pipeline::resolve.
+    start = chrono::steady_clock::now();
+    {
+        core::MutableContext ctx(*gs, core::Symbols::root());
+        vector<core::ErrorRegion> errs;
+        for (auto &tree : trees) {
+            errs.emplace_back(*gs, tree.file);
+        }
+        core::UnfreezeNameTable nameTableAccess(*gs);
+        core::UnfreezeSymbolTable symbolTableAccess(*gs);
+        trees = resolver::Resolver::run(ctx, move(trees), workers);
+    }
+    samples["resolve"].emplace_back(millisSince(start));
+
+    start = chrono::steady_clock::now();
+    trees = realmain::pipeline::typecheck(gs, move(trees), opts, workers);
+    samples["typecheck"].emplace_back(millisSince(start));
+
+    // What --cache-dir writes: the global state and a tree per file.
+    start = chrono::steady_clock::now();
+    core::serialize::Serializer::store(*gs);
+    for (auto &tree : trees) {
+        core::serialize::Serializer::storeExpression(*gs, tree.tree);
+    }
+    samples["serialize"].emplace_back(millisSince(start));
+
+    gs->errorQueue->drainAllErrors();
+}
+
+bool tookFastPath(const vector<unique_ptr<realmain::lsp::LSPMessage>> &responses) {
+    for (auto &response : responses) {
+        if (response->isNotification() && response->method() == realmain::lsp::LSPMethod::SorbetTypecheckRunInfo) {
+            auto &params = get<unique_ptr<realmain::lsp::SorbetTypecheckRunInfo>>(response->asNotification().params);
+            return params->tookFastPath;
+        }
+    }
+    return false;
+}
+
+// Opens the whole corpus in a fresh LSP server, which typechecks it on the slow path, and then makes an edit to its
+// first file that can be typechecked on the fast path. Returns whether it was.
+bool runLSP(const Corpus &corpus, PhaseSamples &samples) {
+    using namespace realmain::lsp;
+    LSPWrapper wrapper(LSP_ROOT_PATH);
+    auto rootUri = fmt::format("file://{}", LSP_ROOT_PATH);
+    auto uriFor = [&rootUri](const CorpusFile &file) { return fmt::format("{}/{}", rootUri, file.path); };
+
+    auto initializeParams = make_unique<InitializeParams>(string(LSP_ROOT_PATH), rootUri,
+                                                          make_unique<ClientCapabilities>());
+    auto initializationOptions = make_unique<SorbetInitializationOptions>();
+    initializationOptions->enableTypecheckInfo = true;
+    initializeParams->initializationOptions = move(initializationOptions);
+    wrapper.getLSPResponsesFor(
+        LSPMessage(make_unique<RequestMessage>("2.0", 0, LSPMethod::Initialize, move(initializeParams))));
+    wrapper.getLSPResponsesFor(LSPMessage(
+        make_unique<NotificationMessage>("2.0", LSPMethod::Initialized, make_unique<InitializedParams>())));
+
+    // Sent together, so that they are merged into a single typecheck.
+    vector<unique_ptr<LSPMessage>> opens;
+    for (auto &file : corpus.files) {
+        auto params = make_unique<DidOpenTextDocumentParams>(make_unique<TextDocumentItem>(uriFor(file), "ruby", 1,
+                                                                                           file.source));
+        opens.emplace_back(make_unique<LSPMessage>(
+            make_unique<NotificationMessage>("2.0", LSPMethod::TextDocumentDidOpen, move(params))));
+    }
+    auto start = chrono::steady_clock::now();
+    wrapper.getLSPResponsesFor(opens);
+    samples["lsp_slow_path"].emplace_back(millisSince(start));
+
+    // A trailing comment changes no definition.
+    auto &edited = corpus.files.front();
+    vector<unique_ptr<TextDocumentContentChangeEvent>> changes;
+    changes.emplace_back(make_unique<TextDocumentContentChangeEvent>(edited.source + "\n# edited\n"));
+    auto params = make_unique<DidChangeTextDocumentParams>(
+        make_unique<VersionedTextDocumentIdentifier>(uriFor(edited), 2), move(changes));
+    LSPMessage change(make_unique<NotificationMessage>("2.0", LSPMethod::TextDocumentDidChange, move(params)));
+    start = chrono::steady_clock::now();
+    auto responses = wrapper.getLSPResponsesFor(change);
+    samples["lsp_fast_path"].emplace_back(millisSince(start));
+    return tookFastPath(responses);
+}
+
+struct CorpusResult {
+    string name;
+    size_t files;
+    size_t bytes;
+    bool lspTookFastPath;
+    PhaseSamples samples;
+};
+
+string toJSON(const vector<CorpusResult> &results, int scale, int iterations, int threads) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("version");
+    writer.String(Version::full_version_string.c_str());
+    writer.Key("scale");
+    writer.Int(scale);
+    writer.Key("iterations");
+    writer.Int(iterations);
+    writer.Key("threads");
+    writer.Int(threads);
+    writer.Key("corpora");
+    writer.StartArray();
+    for (auto &result : results) {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(result.name.c_str());
+        writer.Key("files");
+        writer.Uint64(result.files);
+        writer.Key("bytes");
+        writer.Uint64(result.bytes);
+        writer.Key("lsp_took_fast_path");
+        writer.Bool(result.lspTookFastPath);
+        writer.Key("phases");
+        writer.StartObject();
+        for (auto &phase : PHASES) {
+            auto it = result.samples.find(phase);
+            if (it == result.samples.end()) {
+                continue;
+            }
+            writer.Key(phase.c_str());
+            writer.StartObject();
+            writer.Key("median_ms");
+            writer.Double(median(it->second));
+            writer.Key("min_ms");
+            writer.Double(*min_element(it->second.begin(), it->second.end()));
+            writer.Key("samples_ms");
+            writer.StartArray();
+            for (auto sample : it->second) {
+                writer.Double(sample);
+            }
+            writer.EndArray();
+            writer.EndObject();
+        }
+        writer.EndObject();
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return string(buffer.GetString(), buffer.GetSize());
+}
+
+// Compares the medians of every phase that both runs timed. Phases that took less than `minMs` in the baseline are
+// too noisy to judge, and are skipped. Returns the number of regressions.
+int compareToBaseline(spdlog::logger &logger, const vector<CorpusResult> &results, const string &baselineJSON,
+                      double maxRegressionPercent, double minMs) {
+    rapidjson::Document baseline;
+    if (baseline.Parse(baselineJSON.c_str(), baselineJSON.size()).HasParseError() || !baseline.IsObject() ||
+        !baseline.HasMember("corpora") || !baseline["corpora"].IsArray()) {
+        logger.error("The baseline is not the output of a benchmarks run");
+        return 1;
+    }
+
+    int regressions = 0;
+    for (auto &corpus : baseline["corpora"].GetArray()) {
+        if (!corpus.HasMember("name") || !corpus["name"].IsString() || !corpus.HasMember("phases")) {
+            continue;
+        }
+        string_view name = corpus["name"].GetString();
+        auto result = absl::c_find_if(results, [&](auto &result) { return result.name == name; });
+        if (result == results.end()) {
+            continue;
+        }
+        for (auto &[phaseName, phase] : corpus["phases"].GetObject()) {
+            auto samples = result->samples.find(phaseName.GetString());
+            if (samples == result->samples.end() || !phase.HasMember("median_ms") || !phase["median_ms"].IsNumber()) {
+                continue;
+            }
+            double before = phase["median_ms"].GetDouble();
+            double after = median(samples->second);
+            if (before < minMs) {
+                continue;
+            }
+            double change = 100 * (after - before) / before;
+            if (change > maxRegressionPercent) {
+                logger.error("{} {}: {:.1f}ms -> {:.1f}ms (+{:.1f}%)", name, phaseName.GetString(), before, after,
+                             change);
+                regressions++;
+            } else {
+                logger.info("{} {}: {:.1f}ms -> {:.1f}ms ({:+.1f}%)", name, phaseName.GetString(), before, after,
+                            change);
+            }
+        }
+    }
+    return regressions;
+}
+
+int runBenchmarks(int argc, char **argv) {
+    cxxopts::Options options("benchmarks", "Times every phase of Sorbet over synthetic and on-disk Ruby corpora, "
+                                           "and reports the results as JSON.");
+    options.add_options()("scale", "How large to make the synthetic corpora",
+                          cxxopts::value<int>()->default_value("1"), "int");
+    options.add_options()("iterations", "How many times to time each corpus", cxxopts::value<int>()->default_value("5"),
+                          "int");
+    options.add_options()("threads", "Worker threads for the pipeline. 0 runs everything on the main thread, which "
+                                     "gives the most stable numbers",
+                          cxxopts::value<int>()->default_value("0"), "int");
+    options.add_options()("corpus", "A directory of Ruby files to benchmark as well", cxxopts::value<vector<string>>(),
+                          "dir");
+    options.add_options()("no-synthetic", "Only benchmark the corpora passed with --corpus");
+    options.add_options()("output", "Where to write the JSON results. Defaults to stdout",
+                          cxxopts::value<string>()->default_value(""), "file");
+    options.add_options()("baseline", "The JSON results of an earlier run. Fails if a phase got slower than allowed",
+                          cxxopts::value<string>()->default_value(""), "file");
+    options.add_options()("max-regression-percent", "How much slower than the baseline a phase may get",
+                          cxxopts::value<double>()->default_value("10"), "percent");
+    options.add_options()("min-regression-ms", "Phases that took less than this in the baseline are not compared",
+                          cxxopts::value<double>()->default_value("5"), "ms");
+    options.add_options()("h,help", "Show this help");
+
+    auto raw = options.parse(argc, argv);
+    if (raw.count("help") > 0) {
+        fmt::print("{}\n", options.help());
+        return 0;
+    }
+
+    auto logger = spdlog::stderr_color_mt("benchmarks");
+    auto typeErrorsConsole = spdlog::stderr_color_mt("benchmarks-errors");
+    typeErrorsConsole->set_level(spdlog::level::off);
+    fatalLogger = logger;
+
+    auto scale = raw["scale"].as<int>();
+    auto iterations = raw["iterations"].as<int>();
+    auto threads = raw["threads"].as<int>();
+    if (scale < 1 || iterations < 1 || threads < 0) {
+        logger->error("--scale and --iterations must be positive, and --threads must not be negative");
+        return 1;
+    }
+
+    vector<Corpus> corpora;
+    if (raw.count("no-synthetic") == 0) {
+        corpora = syntheticCorpora(scale);
+    }
+    if (raw.count("corpus") > 0) {
+        for (auto &dir : raw["corpus"].as<vector<string>>()) {
+            corpora.emplace_back(corpusFromDirectory(dir));
+        }
+    }
+
+    realmain::options::Options opts;
+    auto workers = WorkerPool::create(threads, *logger);
+    auto base = make_unique<core::GlobalState>(make_shared<core::ErrorQueue>(*typeErrorsConsole, *logger));
+    unique_ptr<KeyValueStore> kvstore;
+    payload::createInitialGlobalState(base, opts, kvstore);
+    base->errorQueue->ignoreFlushes = true;
+
+    vector<CorpusResult> results;
+    for (auto &corpus : corpora) {
+        if (corpus.files.empty()) {
+            logger->warn("Skipping {}, which has no Ruby files", corpus.name);
+            continue;
+        }
+        logger->info("Benchmarking {} ({} files, {} bytes)", corpus.name, corpus.files.size(), corpus.bytes());
+        CorpusResult result{corpus.name, corpus.files.size(), corpus.bytes(), true, {}};
+        for (int i = 0; i < iterations; i++) {
+            runPipeline(*base, corpus, opts, *workers, result.samples);
+            // Every iteration has to take the fast path for its timing to mean anything.
+            result.lspTookFastPath = runLSP(corpus, result.samples) && result.lspTookFastPath;
+        }
+        if (!result.lspTookFastPath) {
+            logger->warn("The edit to {} did not take the fast path", corpus.name);
+        }
+        results.emplace_back(move(result));
+    }
+
+    auto json = toJSON(results, scale, iterations, threads);
+    auto output = raw["output"].as<string>();
+    if (output.empty()) {
+        fmt::print("{}\n", json);
+    } else {
+        FileOps::write(output, json);
+    }
+
+    auto baseline = raw["baseline"].as<string>();
+    if (!baseline.empty()) {
+        auto regressions = compareToBaseline(*logger, results, FileOps::read(baseline),
+                                             raw["max-regression-percent"].as<double>(),
+                                             raw["min-regression-ms"].as<double>());
+        if (regressions > 0) {
+            logger->error("{} phases regressed", regressions);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+} // namespace sorbet::benchmarks
+
+int main(int argc, char **argv) {
+    return sorbet::benchmarks::runBenchmarks(argc, argv);
+}
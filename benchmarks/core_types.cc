@@ -0,0 +1,296 @@
+#include "benchmark/benchmark.h"
+// ^^ has to go first
+#include "core/ErrorQueue.h"
+#include "core/Unfreeze.h"
+#include "main/options/options.h"
+#include "payload/payload.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace {
+// Every allocation made through operator new, so that each benchmark can report how many allocations one operation
+// costs next to how long it takes.
+atomic<sorbet::u8> allocations;
+} // namespace
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (auto ptr = malloc(size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace sorbet::benchmarks {
+namespace {
+
+// The types and names the benchmarks operate on. They are built once, on top of the stdlib payload, so that every
+// benchmark sees the symbol table Sorbet sees when typechecking a real codebase.
+struct Fixture {
+    unique_ptr<core::GlobalState> gs;
+
+    core::TypePtr wideUnion;
+    core::TypePtr otherWideUnion;
+    core::TypePtr nilableString;
+    core::TypePtr nestedApplied;
+    core::TypePtr widerNestedApplied;
+    core::TypePtr shape;
+    core::TypePtr otherShape;
+    core::TypePtr tuple;
+    core::TypePtr otherTuple;
+
+    core::NameRef plus;
+    core::NameRef first;
+    core::NameRef toS;
+    core::NameRef tap;
+    core::NameRef eachSlice;
+};
+
+Fixture *fixture;
+
+core::Context ctx() {
+    return core::Context(*fixture->gs, core::Symbols::root());
+}
+
+core::TypePtr anyOf(const vector<core::TypePtr> &types) {
+    auto res = core::Types::bottom();
+    for (auto &type : types) {
+        res = core::Types::any(ctx(), res, type);
+    }
+    return res;
+}
+
+core::TypePtr shapeOf(const vector<core::NameRef> &keys, const vector<core::TypePtr> &values) {
+    vector<core::TypePtr> keyTypes;
+    for (auto key : keys) {
+        keyTypes.emplace_back(core::make_type<core::LiteralType>(core::Symbols::Symbol(), key));
+    }
+    return core::make_type<core::ShapeType>(core::Types::hashOfUntyped(), move(keyTypes), values);
+}
+
+void buildFixture(unique_ptr<core::GlobalState> base) {
+    fixture = new Fixture();
+    fixture->gs = move(base);
+    auto &gs = *fixture->gs;
+    vector<core::NameRef> keys;
+    {
+        core::UnfreezeNameTable nameTableAccess(gs);
+        fixture->plus = gs.enterNameUTF8("+");
+        fixture->first = gs.enterNameUTF8("first");
+        fixture->toS = gs.enterNameUTF8("to_s");
+        fixture->tap = gs.enterNameUTF8("tap");
+        fixture->eachSlice = gs.enterNameUTF8("each_slice");
+        for (auto key : {"id", "name", "email", "created_at", "updated_at", "tags"}) {
+            keys.emplace_back(gs.enterNameUTF8(key));
+        }
+    }
+
+    auto context = ctx();
+    auto integer = core::Types::Integer();
+    auto str = core::Types::String();
+    auto symbol = core::Types::Symbol();
+    auto float_ = core::Types::Float();
+    auto nil = core::Types::nilClass();
+
+    fixture->wideUnion = anyOf({integer, str, symbol, float_, nil, core::Types::trueClass(), core::Types::falseClass(),
+                                core::Types::arrayOfUntyped()});
+    fixture->nilableString = anyOf({str, nil});
+    fixture->otherWideUnion =
+        anyOf({str, float_, core::Types::hashOfUntyped(), core::Types::procClass(), core::Types::classClass(),
+               core::Types::arrayOf(context, integer), core::Types::hashOf(context, str)});
+
+    // Array[T::Hash[Symbol, Array[Integer]]] and Array[T::Hash[Symbol, Array[T.any(Integer, String)]]]
+    fixture->nestedApplied =
+        core::Types::arrayOf(context, core::Types::hashOf(context, core::Types::arrayOf(context, integer)));
+    fixture->widerNestedApplied = core::Types::arrayOf(
+        context, core::Types::hashOf(context, core::Types::arrayOf(context, anyOf({integer, str}))));
+
+    fixture->shape = shapeOf(keys, {integer, str, str, float_, float_, core::Types::arrayOf(context, str)});
+    fixture->otherShape = shapeOf(keys, {anyOf({integer, nil}), str, anyOf({str, nil}), float_, integer,
+                                         core::Types::arrayOf(context, symbol)});
+
+    fixture->tuple = core::TupleType::build(context, {integer, str, symbol, float_});
+    fixture->otherTuple = core::TupleType::build(context, {anyOf({integer, nil}), str, str, float_});
+}
+
+// Runs `op` for every iteration of `state`, and reports how many allocations it made per iteration.
+template <class F> void measure(benchmark::State &state, F op) {
+    auto before = allocations.load(memory_order_relaxed);
+    for (auto _ : state) {
+        op();
+    }
+    auto allocated = allocations.load(memory_order_relaxed) - before;
+    state.counters["allocs/op"] = benchmark::Counter(allocated, benchmark::Counter::kAvgIterations);
+}
+
+void binaryOp(benchmark::State &state, core::TypePtr (*op)(core::Context, const core::TypePtr &, const core::TypePtr &),
+              const core::TypePtr &left, const core::TypePtr &right) {
+    auto context = ctx();
+    measure(state, [&]() { benchmark::DoNotOptimize(op(context, left, right)); });
+}
+
+void subType(benchmark::State &state, const core::TypePtr &left, const core::TypePtr &right) {
+    auto context = ctx();
+    measure(state, [&]() { benchmark::DoNotOptimize(core::Types::isSubType(context, left, right)); });
+}
+
+void dispatch(benchmark::State &state, const core::TypePtr &recv, core::NameRef name,
+              const vector<core::TypePtr> &argTypes) {
+    auto context = ctx();
+    vector<core::TypeAndOrigins> argValues(argTypes.size());
+    InlinedVector<const core::TypeAndOrigins *, 2> args;
+    InlinedVector<core::Loc, 2> argLocs;
+    for (size_t i = 0; i < argTypes.size(); i++) {
+        argValues[i].type = argTypes[i];
+        args.emplace_back(&argValues[i]);
+        argLocs.emplace_back(core::Loc::none());
+    }
+    core::CallLocs locs{core::Loc::none(), core::Loc::none(), argLocs};
+    shared_ptr<const core::SendAndBlockLink> block;
+    measure(state, [&]() {
+        core::DispatchArgs dispatchArgs{name, locs, args, recv, recv, block};
+        benchmark::DoNotOptimize(recv->dispatchCall(context, dispatchArgs));
+    });
+}
+
+void findMember(benchmark::State &state, core::SymbolRef klass, core::NameRef name) {
+    const auto &gs = *fixture->gs;
+    measure(state, [&]() { benchmark::DoNotOptimize(klass.data(gs)->findMemberTransitive(gs, name)); });
+}
+
+void BM_LubWideUnions(benchmark::State &state) {
+    binaryOp(state, core::Types::lub, fixture->wideUnion, fixture->otherWideUnion);
+}
+BENCHMARK(BM_LubWideUnions);
+
+void BM_LubWideUnionWithMember(benchmark::State &state) {
+    binaryOp(state, core::Types::lub, fixture->wideUnion, core::Types::Float());
+}
+BENCHMARK(BM_LubWideUnionWithMember);
+
+void BM_LubNilableWithArm(benchmark::State &state) {
+    binaryOp(state, core::Types::lub, core::Types::String(), fixture->nilableString);
+}
+BENCHMARK(BM_LubNilableWithArm);
+
+void BM_GlbNilableWithArm(benchmark::State &state) {
+    binaryOp(state, core::Types::glb, fixture->nilableString, core::Types::String());
+}
+BENCHMARK(BM_GlbNilableWithArm);
+
+void BM_GlbWideUnions(benchmark::State &state) {
+    binaryOp(state, core::Types::glb, fixture->wideUnion, fixture->otherWideUnion);
+}
+BENCHMARK(BM_GlbWideUnions);
+
+void BM_LubNestedApplied(benchmark::State &state) {
+    binaryOp(state, core::Types::lub, fixture->nestedApplied, fixture->widerNestedApplied);
+}
+BENCHMARK(BM_LubNestedApplied);
+
+void BM_GlbNestedApplied(benchmark::State &state) {
+    binaryOp(state, core::Types::glb, fixture->nestedApplied, fixture->widerNestedApplied);
+}
+BENCHMARK(BM_GlbNestedApplied);
+
+void BM_LubShapes(benchmark::State &state) {
+    binaryOp(state, core::Types::lub, fixture->shape, fixture->otherShape);
+}
+BENCHMARK(BM_LubShapes);
+
+void BM_LubTuples(benchmark::State &state) {
+    binaryOp(state, core::Types::lub, fixture->tuple, fixture->otherTuple);
+}
+BENCHMARK(BM_LubTuples);
+
+void BM_IsSubTypeWideUnions(benchmark::State &state) {
+    subType(state, fixture->wideUnion, fixture->otherWideUnion);
+}
+BENCHMARK(BM_IsSubTypeWideUnions);
+
+void BM_IsSubTypeNestedApplied(benchmark::State &state) {
+    subType(state, fixture->nestedApplied, fixture->widerNestedApplied);
+}
+BENCHMARK(BM_IsSubTypeNestedApplied);
+
+void BM_IsSubTypeShapes(benchmark::State &state) {
+    subType(state, fixture->shape, fixture->otherShape);
+}
+BENCHMARK(BM_IsSubTypeShapes);
+
+void BM_IsSubTypeTuples(benchmark::State &state) {
+    subType(state, fixture->tuple, fixture->otherTuple);
+}
+BENCHMARK(BM_IsSubTypeTuples);
+
+void BM_DispatchIntegerPlus(benchmark::State &state) {
+    dispatch(state, core::Types::Integer(), fixture->plus, {core::Types::Integer()});
+}
+BENCHMARK(BM_DispatchIntegerPlus);
+
+void BM_DispatchAppliedFirst(benchmark::State &state) {
+    dispatch(state, fixture->nestedApplied, fixture->first, {});
+}
+BENCHMARK(BM_DispatchAppliedFirst);
+
+void BM_DispatchWideUnionToS(benchmark::State &state) {
+    dispatch(state, fixture->wideUnion, fixture->toS, {});
+}
+BENCHMARK(BM_DispatchWideUnionToS);
+
+void BM_DispatchTupleFirst(benchmark::State &state) {
+    dispatch(state, fixture->tuple, fixture->first, {});
+}
+BENCHMARK(BM_DispatchTupleFirst);
+
+void BM_FindMemberOnClass(benchmark::State &state) {
+    findMember(state, core::Symbols::Integer(), fixture->plus);
+}
+BENCHMARK(BM_FindMemberOnClass);
+
+void BM_FindMemberOnKernel(benchmark::State &state) {
+    findMember(state, core::Symbols::Integer(), fixture->tap);
+}
+BENCHMARK(BM_FindMemberOnKernel);
+
+void BM_FindMemberOnMixin(benchmark::State &state) {
+    findMember(state, core::Symbols::Array(), fixture->eachSlice);
+}
+BENCHMARK(BM_FindMemberOnMixin);
+
+} // namespace
+} // namespace sorbet::benchmarks
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    auto logger = spdlog::stderr_color_mt("core-types-benchmarks");
+    auto typeErrorsConsole = spdlog::stderr_color_mt("core-types-benchmarks-errors");
+    typeErrorsConsole->set_level(spdlog::level::off);
+    sorbet::fatalLogger = logger;
+
+    auto gs = make_unique<sorbet::core::GlobalState>(
+        make_shared<sorbet::core::ErrorQueue>(*typeErrorsConsole, *logger));
+    sorbet::realmain::options::Options opts;
+    unique_ptr<sorbet::KeyValueStore> kvstore;
+    sorbet::payload::createInitialGlobalState(gs, opts, kvstore);
+    sorbet::benchmarks::buildFixture(move(gs));
+
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "benchmarks/corpus.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
+#include "common/FileSystem.h"
+
+using namespace std;
+
+namespace sorbet::benchmarks {
+
+size_t Corpus::bytes() const {
+    size_t res = 0;
+    for (auto &file : files) {
+        res += file.source.size();
+    }
+    return res;
+}
+
+Corpus deepHierarchy(int scale) {
+    Corpus corpus{"deep_hierarchy", {}};
+    const int depth = 50 * scale;
+    for (int i = 0; i < depth; i++) {
+        string source = "# typed: true\n";
+        if (i == 0) {
+            absl::StrAppend(&source, "class Deep0\n");
+        } else {
+            absl::StrAppend(&source, "class Deep", i, " < Deep", i - 1, "\n");
+        }
+        absl::StrAppend(&source, "  extend T::Sig\n\n");
+        absl::StrAppend(&source, "  sig {params(x: Integer).returns(Integer)}\n");
+        absl::StrAppend(&source, "  def level", i, "(x)\n");
+        if (i == 0) {
+            absl::StrAppend(&source, "    x\n");
+        } else {
+            absl::StrAppend(&source, "    level", i - 1, "(x) + level0(x)\n");
+        }
+        absl::StrAppend(&source, "  end\n\n");
+        absl::StrAppend(&source, "  sig {returns(String)}\n");
+        absl::StrAppend(&source, "  def name\n");
+        absl::StrAppend(&source, "    \"Deep", i, "\"\n");
+        absl::StrAppend(&source, "  end\n");
+        absl::StrAppend(&source, "end\n");
+        corpus.files.push_back({absl::StrCat("deep_hierarchy/deep_", i, ".rb"), move(source)});
+    }
+    return corpus;
+}
+
+Corpus wideFiles(int scale) {
+    Corpus corpus{"wide_files", {}};
+    const int methodsPerFile = 200;
+    for (int i = 0; i < 4 * scale; i++) {
+        string source = absl::StrCat("# typed: true\nclass Wide", i, "\n  extend T::Sig\n");
+        for (int j = 0; j < methodsPerFile; j++) {
+            absl::StrAppend(&source, "\n  sig {params(a: Integer, b: String).returns(String)}\n");
+            absl::StrAppend(&source, "  def m", j, "(a, b)\n");
+            absl::StrAppend(&source, "    c = a + ", j, "\n");
+            absl::StrAppend(&source, "    if c > 10\n");
+            absl::StrAppend(&source, "      b + c.to_s\n");
+            absl::StrAppend(&source, "    else\n");
+            if (j == 0) {
+                absl::StrAppend(&source, "      b * c\n");
+            } else {
+                absl::StrAppend(&source, "      m", j - 1, "(c, b)\n");
+            }
+            absl::StrAppend(&source, "    end\n");
+            absl::StrAppend(&source, "  end\n");
+        }
+        absl::StrAppend(&source, "end\n");
+        corpus.files.push_back({absl::StrCat("wide_files/wide_", i, ".rb"), move(source)});
+    }
+    return corpus;
+}
+
+Corpus heavyGenerics(int scale) {
+    Corpus corpus{"heavy_generics", {}};
+    for (int i = 0; i < 20 * scale; i++) {
+        auto box = absl::StrCat("Box", i);
+        string source = "# typed: strict\n";
+        absl::StrAppend(&source, "class ", box, "\n");
+        absl::StrAppend(&source, "  extend T::Sig\n");
+        absl::StrAppend(&source, "  extend T::Generic\n\n");
+        absl::StrAppend(&source, "  Elem = type_member\n\n");
+        absl::StrAppend(&source, "  sig {params(value: Elem).void}\n");
+        absl::StrAppend(&source, "  def initialize(value)\n");
+        absl::StrAppend(&source, "    @value = T.let(value, Elem)\n");
+        absl::StrAppend(&source, "  end\n\n");
+        absl::StrAppend(&source, "  sig {returns(Elem)}\n");
+        absl::StrAppend(&source, "  def get\n");
+        absl::StrAppend(&source, "    @value\n");
+        absl::StrAppend(&source, "  end\n\n");
+        absl::StrAppend(&source, "  sig do\n");
+        absl::StrAppend(&source, "    type_parameters(:U)\n");
+        absl::StrAppend(&source, "      .params(blk: T.proc.params(x: Elem).returns(T.type_parameter(:U)))\n");
+        absl::StrAppend(&source, "      .returns(T.type_parameter(:U))\n");
+        absl::StrAppend(&source, "  end\n");
+        absl::StrAppend(&source, "  def map(&blk)\n");
+        absl::StrAppend(&source, "    blk.call(@value)\n");
+        absl::StrAppend(&source, "  end\n");
+        absl::StrAppend(&source, "end\n\n");
+        absl::StrAppend(&source, "module Use", box, "\n");
+        absl::StrAppend(&source, "  extend T::Sig\n\n");
+        absl::StrAppend(&source, "  sig {params(xs: T::Array[", box,
+                        "[Integer]]).returns(T::Hash[String, T::Array[Integer]])}\n");
+        absl::StrAppend(&source, "  def self.run(xs)\n");
+        absl::StrAppend(&source, "    ys = xs.map {|b| b.map {|x| x + 1}}\n");
+        absl::StrAppend(&source, "    pairs = ys.each_with_index.map {|y, i| [y.to_s, [y, i]]}\n");
+        absl::StrAppend(&source, "    pairs.to_h\n");
+        absl::StrAppend(&source, "  end\n");
+        absl::StrAppend(&source, "end\n");
+        corpus.files.push_back({absl::StrCat("heavy_generics/box_", i, ".rb"), move(source)});
+    }
+    return corpus;
+}
+
+Corpus dslModels(int scale) {
+    Corpus corpus{"dsl_models", {}};
+    for (int i = 0; i < 30 * scale; i++) {
+        auto model = absl::StrCat("Model", i);
+        string source = "# typed: true\n";
+        absl::StrAppend(&source, "class ", model, " < T::Struct\n");
+        absl::StrAppend(&source, "  prop :id, Integer\n");
+        absl::StrAppend(&source, "  prop :name, String\n");
+        absl::StrAppend(&source, "  prop :tags, T::Array[String], default: []\n");
+        absl::StrAppend(&source, "  const :created_at, Float\n");
+        if (i > 0) {
+            absl::StrAppend(&source, "  prop :parent, T.nilable(Model", i - 1, ")\n");
+        }
+        absl::StrAppend(&source, "end\n\n");
+        absl::StrAppend(&source, "Point", i, " = Struct.new(:x, :y)\n\n");
+        absl::StrAppend(&source, "class ", model, "Service\n");
+        absl::StrAppend(&source, "  extend T::Sig\n\n");
+        absl::StrAppend(&source, "  attr_reader :count\n\n");
+        absl::StrAppend(&source, "  sig {params(m: ", model, ").returns(String)}\n");
+        absl::StrAppend(&source, "  def self.describe(m)\n");
+        absl::StrAppend(&source, "    \"#{m.name} #{m.id} #{m.tags.join(\",\")}\"\n");
+        absl::StrAppend(&source, "  end\n");
+        absl::StrAppend(&source, "end\n");
+        corpus.files.push_back({absl::StrCat("dsl_models/model_", i, ".rb"), move(source)});
+    }
+    return corpus;
+}
+
+vector<Corpus> syntheticCorpora(int scale) {
+    vector<Corpus> res;
+    res.emplace_back(deepHierarchy(scale));
+    res.emplace_back(wideFiles(scale));
+    res.emplace_back(heavyGenerics(scale));
+    res.emplace_back(dslModels(scale));
+    return res;
+}
+
+Corpus corpusFromDirectory(string_view dir) {
+    auto trimmed = dir;
+    while (trimmed.size() > 1 && trimmed.back() == '/') {
+        trimmed.remove_suffix(1);
+    }
+    auto slash = trimmed.rfind('/');
+    Corpus corpus{string(slash == string_view::npos ? trimmed : trimmed.substr(slash + 1)), {}};
+
+    OSFileSystem fs;
+    auto paths = fs.listFilesInDir(dir, {".rb", ".rbi"}, true, {}, {});
+    // Directory listings come back in no particular order.
+    fast_sort(paths);
+    for (auto &path : paths) {
+        // Relative paths, so that the corpus can be moved without changing what gets timed.
+        auto relative = absl::StripPrefix(absl::StripPrefix(path, trimmed), "/");
+        corpus.files.push_back({string(relative), fs.readFile(path)});
+    }
+    return corpus;
+}
+
+} // namespace sorbet::benchmarks
@@ -0,0 +1,41 @@
+#ifndef SORBET_BENCHMARKS_CORPUS_H
+#define SORBET_BENCHMARKS_CORPUS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sorbet::benchmarks {
+
+struct CorpusFile {
+    std::string path;
+    std::string source;
+};
+
+struct Corpus {
+    std::string name;
+    std::vector<CorpusFile> files;
+
+    size_t bytes() const;
+};
+
+// The synthetic corpora only depend on `scale`, so that runs of different commits time exactly the same Ruby.
+// Each one stresses a different part of the pipeline.
+
+/** A single inheritance chain, 50 * `scale` classes deep, where every method calls the one it inherited. */
+Corpus deepHierarchy(int scale);
+/** 4 * `scale` files with 200 methods each. */
+Corpus wideFiles(int scale);
+/** 20 * `scale` generic classes, with generic methods, blocks and stdlib generics at their call sites. */
+Corpus heavyGenerics(int scale);
+/** 30 * `scale` T::Struct models and Struct.new values, which the DSL passes expand into methods. */
+Corpus dslModels(int scale);
+
+std::vector<Corpus> syntheticCorpora(int scale);
+
+/** Every .rb and .rbi file under `dir`, with paths relative to it, named after the last component of `dir`. */
+Corpus corpusFromDirectory(std::string_view dir);
+
+} // namespace sorbet::benchmarks
+
+#endif
@@ -27,22 +27,45 @@ CFG::CFG() {
     deadBlock()->bexit.cond.variable = core::LocalVariable::noVariable();
 }
 
+int CFG::localVariableId(core::LocalVariable local) const {
+    auto fnd = localVariableIds.find(local);
+    ENFORCE(fnd != localVariableIds.end(), "Local variable was never read or written by this CFG");
+    return fnd->second;
+}
+
+int CFG::enterLocalVariable(core::LocalVariable local) {
+    auto [it, inserted] = localVariableIds.try_emplace(local, localVariables.size());
+    if (inserted) {
+        localVariables.emplace_back(local);
+    }
+    return it->second;
+}
+
 CFG::ReadsAndWrites CFG::findAllReadsAndWrites(core::Context ctx) {
     Timer timeit(ctx.state.tracer(), "findAllReadsAndWrites");
     CFG::ReadsAndWrites target;
     target.reads.resize(maxBasicBlockId);
     target.writes.resize(maxBasicBlockId);
     target.dead.resize(maxBasicBlockId);
-    vector<UnorderedSet<core::LocalVariable>> readsAndWrites(maxBasicBlockId);
+    vector<LocalVariableSet> readsAndWrites(maxBasicBlockId);
 
+    for (const auto &[local, _] : this->minLoops) {
+        enterLocalVariable(local);
+    }
     for (unique_ptr<BasicBlock> &bb : this->basicBlocks) {
         auto &blockWrites = target.writes[bb->id];
         auto &blockReads = target.reads[bb->id];
         auto &blockDead = target.dead[bb->id];
         auto &blockReadsAndWrites = readsAndWrites[bb->id];
+        auto read = [&](core::LocalVariable local) {
+            auto id = enterLocalVariable(local);
+            blockReads.add(id);
+            blockReadsAndWrites.add(id);
+        };
         for (Binding &bind : bb->exprs) {
-            blockWrites.insert(bind.bind.variable);
-            blockReadsAndWrites.insert(bind.bind.variable);
+            auto bindId = enterLocalVariable(bind.bind.variable);
+            blockWrites.add(bindId);
+            blockReadsAndWrites.add(bindId);
             /*
              * When we write to an alias, we rely on the type information being
              * propagated through block arguments from the point of
@@ -50,61 +73,51 @@ CFG::ReadsAndWrites CFG::findAllReadsAndWrites(core::Context ctx) {
              * variable serves to represent this.
              */
             if (bind.bind.variable.isAliasForGlobal(ctx) && cast_instruction<Alias>(bind.value.get()) == nullptr) {
-                blockReads.insert(bind.bind.variable);
+                blockReads.add(bindId);
             }
 
             if (auto *v = cast_instruction<Ident>(bind.value.get())) {
-                blockReads.insert(v->what);
-                blockReadsAndWrites.insert(v->what);
+                read(v->what);
             } else if (auto *v = cast_instruction<Send>(bind.value.get())) {
-                blockReads.insert(v->recv.variable);
-                blockReadsAndWrites.insert(v->recv.variable);
+                read(v->recv.variable);
                 for (auto &arg : v->args) {
-                    blockReads.insert(arg.variable);
-                    blockReadsAndWrites.insert(arg.variable);
+                    read(arg.variable);
                 }
             } else if (auto *v = cast_instruction<TAbsurd>(bind.value.get())) {
-                blockReads.insert(v->what.variable);
+                blockReads.add(enterLocalVariable(v->what.variable));
             } else if (auto *v = cast_instruction<Return>(bind.value.get())) {
-                blockReads.insert(v->what.variable);
-                blockReadsAndWrites.insert(v->what.variable);
+                read(v->what.variable);
             } else if (auto *v = cast_instruction<BlockReturn>(bind.value.get())) {
-                blockReads.insert(v->what.variable);
-                blockReadsAndWrites.insert(v->what.variable);
+                read(v->what.variable);
             } else if (auto *v = cast_instruction<Cast>(bind.value.get())) {
-                blockReads.insert(v->value.variable);
-                blockReadsAndWrites.insert(v->value.variable);
+                read(v->value.variable);
             } else if (auto *v = cast_instruction<LoadSelf>(bind.value.get())) {
-                blockReads.insert(v->fallback);
-                blockReadsAndWrites.insert(v->fallback);
+                read(v->fallback);
             }
 
-            auto fnd = blockReads.find(bind.bind.variable);
-            if (fnd == blockReads.end()) {
-                blockDead.insert(bind.bind.variable);
+            if (!blockReads.contains(bindId)) {
+                blockDead.add(bindId);
             }
         }
         if (bb->bexit.cond.variable.exists()) {
-            blockReads.insert(bb->bexit.cond.variable);
-            blockReadsAndWrites.insert(bb->bexit.cond.variable);
+            read(bb->bexit.cond.variable);
         }
     }
-    UnorderedMap<core::LocalVariable, pair<int, int>> usageCounts;
 
     {
-        Timer timeit(ctx.state.tracer(), "privates1");
-
+        Timer timeit(ctx.state.tracer(), "privates");
+        // A variable that only one block mentions never needs to flow between blocks.
+        vector<int> usageCounts(numLocalVariables());
+        vector<int> usageBlocks(numLocalVariables());
         for (auto blockId = 0; blockId < maxBasicBlockId; blockId++) {
-            for (auto &el : readsAndWrites[blockId]) {
-                usageCounts.try_emplace(el, make_pair(0, blockId)).first->second.first += 1;
-            }
+            readsAndWrites[blockId].forEach([&](int id) {
+                usageCounts[id] += 1;
+                usageBlocks[id] = blockId;
+            });
         }
-    }
-    {
-        Timer timeit(ctx.state.tracer(), "privates2");
-        for (const auto &[local, usages] : usageCounts) {
-            if (usages.first == 1) {
-                target.writes[usages.second].erase(local);
+        for (int id = 0; id < numLocalVariables(); id++) {
+            if (usageCounts[id] == 1) {
+                target.writes[usageBlocks[id]].remove(id);
             }
         }
     }
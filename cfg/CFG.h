@@ -8,6 +8,7 @@
 #include <memory>
 
 #include "cfg/Instructions.h"
+#include "cfg/LocalVariableSet.h"
 
 //
 // This file defines the IR that the inference algorithm operates on.
@@ -65,6 +66,12 @@ public:
     };
 
     std::string toString(core::Context ctx);
+
+    // Basic blocks are bump-allocated out of per-thread memory instead of one malloc each (see CFGAllocation.cc).
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+    // The memory that all live basic blocks and instructions of all threads currently take up.
+    static int64_t allocatedBytes();
 };
 
 class CFGContext;
@@ -105,21 +112,39 @@ public:
     static constexpr int MIN_LOOP_GLOBAL = -2;
     static constexpr int MIN_LOOP_LET = -3;
 
+    // The special minLoops above, assigned while walking the tree. computeMinMaxLoops folds them into minLoopsById.
     UnorderedMap<core::LocalVariable, int> minLoops;
-    UnorderedMap<core::LocalVariable, int> maxLoopWrite;
+
+    /**
+     * Every local variable that the CFG reads or writes gets a dense id when findAllReadsAndWrites runs, so that the
+     * dataflow passes and inference can keep their per-variable facts in bitsets and vectors instead of hashing the
+     * variable on every lookup.
+     */
+    UnorderedMap<core::LocalVariable, int> localVariableIds;
+    /** The inverse of localVariableIds */
+    std::vector<core::LocalVariable> localVariables;
+    /** The minimal and maximal loop depth at which each local variable is read or written, indexed by id */
+    std::vector<int> minLoopsById;
+    std::vector<int> maxLoopWriteById;
+
+    int numLocalVariables() const {
+        return localVariables.size();
+    }
+    int localVariableId(core::LocalVariable local) const;
 
     void sanityCheck(core::Context ctx);
 
     struct ReadsAndWrites {
-        std::vector<UnorderedSet<core::LocalVariable>> reads;
-        std::vector<UnorderedSet<core::LocalVariable>> writes;
+        std::vector<LocalVariableSet> reads;
+        std::vector<LocalVariableSet> writes;
 
         // The "dead" set reports, for each block, variables that are *only*
         // read in that block after being written; they are thus dead on entry,
         // which we take advantage of when building dataflow information for
         // inference.
-        std::vector<UnorderedSet<core::LocalVariable>> dead;
+        std::vector<LocalVariableSet> dead;
     };
+    /** Also numbers every local variable that gets read or written (see localVariableIds). */
     ReadsAndWrites findAllReadsAndWrites(core::Context ctx);
 
     // Should this CFG be exported?
@@ -128,6 +153,7 @@ public:
 private:
     CFG();
     BasicBlock *freshBlock(int outerLoops);
+    int enterLocalVariable(core::LocalVariable local);
 };
 
 } // namespace sorbet::cfg
@@ -0,0 +1,38 @@
+#include "cfg/CFG.h"
+#include "common/BlockPool.h"
+
+using namespace std;
+
+namespace sorbet::cfg {
+
+/*
+ * A CFG is built, typechecked and thrown away by one thread, one method at a time, so its basic blocks and
+ * instructions are bump-allocated out of that thread's blocks (see BlockPool) and go back to the system a block at a
+ * time when the CFG is destroyed, instead of with one free() each.
+ */
+namespace {
+atomic<int64_t> cfgBytes{0};
+thread_local BlockPool cfgBlocks(cfgBytes);
+} // namespace
+
+void *Instruction::operator new(size_t size) {
+    return cfgBlocks.allocate(size);
+}
+
+void Instruction::operator delete(void *ptr, size_t size) {
+    BlockPool::deallocate(ptr, size, cfgBytes);
+}
+
+void *BasicBlock::operator new(size_t size) {
+    return cfgBlocks.allocate(size);
+}
+
+void BasicBlock::operator delete(void *ptr, size_t size) {
+    BlockPool::deallocate(ptr, size, cfgBytes);
+}
+
+int64_t BasicBlock::allocatedBytes() {
+    return cfgBytes.load(memory_order_relaxed);
+}
+
+} // namespace sorbet::cfg
@@ -35,6 +35,10 @@ public:
     virtual std::string toString(core::Context ctx) = 0;
     Instruction() = default;
     bool isSynthetic = false;
+
+    // Instructions are allocated out of per-thread blocks instead of one malloc each (see CFGAllocation.cc).
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
 };
 
 template <class To> To *cast_instruction(Instruction *what) {
@@ -90,7 +94,7 @@ public:
 
     virtual std::string toString(core::Context ctx);
 };
-CheckSize(Send, 152, 8);
+CheckSize(Send, 136, 8);
 
 class Return final : public Instruction {
 public:
@@ -99,7 +103,7 @@ public:
     Return(core::LocalVariable what);
     virtual std::string toString(core::Context ctx);
 };
-CheckSize(Return, 40, 8);
+CheckSize(Return, 32, 8);
 
 class BlockReturn final : public Instruction {
 public:
@@ -109,7 +113,7 @@ public:
     BlockReturn(std::shared_ptr<core::SendAndBlockLink> link, core::LocalVariable what);
     virtual std::string toString(core::Context ctx);
 };
-CheckSize(BlockReturn, 56, 8);
+CheckSize(BlockReturn, 48, 8);
 
 class LoadSelf final : public Instruction {
 public:
@@ -127,7 +131,7 @@ public:
     Literal(const core::TypePtr &value);
     virtual std::string toString(core::Context ctx);
 };
-CheckSize(Literal, 32, 8);
+CheckSize(Literal, 24, 8);
 
 class Unanalyzable : public Instruction {
 public:
@@ -185,7 +189,7 @@ public:
 
     virtual std::string toString(core::Context ctx);
 };
-CheckSize(Cast, 64, 8);
+CheckSize(Cast, 48, 8);
 
 class TAbsurd final : public Instruction {
 public:
@@ -197,7 +201,7 @@ public:
 
     virtual std::string toString(core::Context ctx);
 };
-CheckSize(TAbsurd, 40, 8);
+CheckSize(TAbsurd, 32, 8);
 
 } // namespace sorbet::cfg
 
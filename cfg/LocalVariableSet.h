@@ -0,0 +1,91 @@
+#ifndef SORBET_CFG_LOCAL_VARIABLE_SET_H
+#define SORBET_CFG_LOCAL_VARIABLE_SET_H
+
+#include "common/common.h"
+
+namespace sorbet::cfg {
+
+/**
+ * A set of local variable ids (see CFG::localVariableIds), stored as a bitset so that the dataflow passes over a CFG
+ * combine whole sets a word at a time. The set grows as larger ids are added; ids past its end are simply absent.
+ */
+class LocalVariableSet final {
+    std::vector<u8> words;
+
+    static constexpr int BITS = 64;
+
+    void grow(size_t size) {
+        if (words.size() < size) {
+            words.resize(size);
+        }
+    }
+
+public:
+    LocalVariableSet() = default;
+    explicit LocalVariableSet(int maxId) : words((maxId + BITS - 1) / BITS) {}
+
+    bool contains(int id) const {
+        size_t word = id / BITS;
+        return word < words.size() && (words[word] & (u8(1) << (id % BITS))) != 0;
+    }
+
+    void add(int id) {
+        grow(id / BITS + 1);
+        words[id / BITS] |= u8(1) << (id % BITS);
+    }
+
+    void remove(int id) {
+        size_t word = id / BITS;
+        if (word < words.size()) {
+            words[word] &= ~(u8(1) << (id % BITS));
+        }
+    }
+
+    /** Adds everything in `other`, and returns whether that changed this set. */
+    bool add(const LocalVariableSet &other) {
+        grow(other.words.size());
+        u8 changed = 0;
+        for (size_t i = 0; i < other.words.size(); i++) {
+            changed |= other.words[i] & ~words[i];
+            words[i] |= other.words[i];
+        }
+        return changed != 0;
+    }
+
+    void remove(const LocalVariableSet &other) {
+        auto common = std::min(words.size(), other.words.size());
+        for (size_t i = 0; i < common; i++) {
+            words[i] &= ~other.words[i];
+        }
+    }
+
+    void intersect(const LocalVariableSet &other) {
+        words.resize(std::min(words.size(), other.words.size()));
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] &= other.words[i];
+        }
+    }
+
+    int size() const {
+        int res = 0;
+        for (auto word : words) {
+            res += __builtin_popcountll(word);
+        }
+        return res;
+    }
+
+    /** Calls `f` on every id in the set, in increasing order. */
+    template <class F> void forEach(F f) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            auto word = words[i];
+            while (word != 0) {
+                f(int(i * BITS + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+};
+
+} // namespace sorbet::cfg
+
+#endif
@@ -241,8 +241,8 @@ void CFGBuilder::removeDeadAssigns(core::Context ctx, const CFG::ReadsAndWrites
                 continue;
             }
 
-            auto fnd = RnW.reads[it->id].find(bind.bind.variable);
-            bool wasRead = fnd != RnW.reads[it->id].end(); // read in the same block
+            // read in the same block
+            bool wasRead = RnW.reads[it->id].contains(cfg.localVariableId(bind.bind.variable));
             if (!wasRead) {
                 for (const auto &arg : it->bexit.thenb->args) {
                     if (arg.variable == bind.bind.variable) {
@@ -265,9 +265,13 @@ void CFGBuilder::removeDeadAssigns(core::Context ctx, const CFG::ReadsAndWrites
                 // shorter to list the converse set -- those which *do* have
                 // side effects -- but doing it this way is more robust to us
                 // adding more instruction types in the future.
+                //
+                // Constant loads have no side effects either, but the ones that nothing reads are how the scopes of
+                // nested constants (`A::B` in `A::B::C`) stay in the CFG, so they are only removed when asked to.
                 if (isa_instruction<Ident>(bind.value.get()) || isa_instruction<Literal>(bind.value.get()) ||
                     isa_instruction<LoadSelf>(bind.value.get()) || isa_instruction<LoadArg>(bind.value.get()) ||
-                    isa_instruction<LoadYieldParams>(bind.value.get())) {
+                    isa_instruction<LoadYieldParams>(bind.value.get()) ||
+                    (ctx.state.optimizeCFG && isa_instruction<Alias>(bind.value.get()))) {
                     expIt = it->exprs.erase(expIt);
                 } else {
                     ++expIt;
@@ -280,31 +284,30 @@ void CFGBuilder::removeDeadAssigns(core::Context ctx, const CFG::ReadsAndWrites
 }
 
 void CFGBuilder::computeMinMaxLoops(core::Context ctx, const CFG::ReadsAndWrites &RnW, CFG &cfg) {
+    cfg.minLoopsById.assign(cfg.numLocalVariables(), INT_MAX);
+    cfg.maxLoopWriteById.assign(cfg.numLocalVariables(), 0);
+    for (const auto &[local, minLoops] : cfg.minLoops) {
+        cfg.minLoopsById[cfg.localVariableId(local)] = minLoops;
+    }
     for (const auto &bb : cfg.basicBlocks) {
-        for (const core::LocalVariable what : RnW.reads[bb->id]) {
-            const auto minIt = cfg.minLoops.find(what);
-            int curMin = minIt != cfg.minLoops.end() ? minIt->second : INT_MAX;
+        RnW.reads[bb->id].forEach([&](int id) {
+            auto &curMin = cfg.minLoopsById[id];
             if (curMin > bb->outerLoops) {
                 curMin = bb->outerLoops;
             }
-            cfg.minLoops[what] = curMin;
-        }
+        });
     }
     for (const auto &bb : cfg.basicBlocks) {
         for (const auto &expr : bb->exprs) {
-            auto what = expr.bind.variable;
-            const auto minIt = cfg.minLoops.find(what);
-            const auto maxIt = cfg.maxLoopWrite.find(what);
-            int curMin = minIt != cfg.minLoops.end() ? minIt->second : INT_MAX;
-            int curMax = maxIt != cfg.maxLoopWrite.end() ? maxIt->second : 0;
+            auto id = cfg.localVariableId(expr.bind.variable);
+            auto &curMin = cfg.minLoopsById[id];
+            auto &curMax = cfg.maxLoopWriteById[id];
             if (curMin > bb->outerLoops) {
                 curMin = bb->outerLoops;
             }
             if (curMax < bb->outerLoops) {
                 curMax = bb->outerLoops;
             }
-            cfg.minLoops[what] = curMin;
-            cfg.maxLoopWrite[what] = curMax;
         }
     }
 }
@@ -321,51 +324,52 @@ void CFGBuilder::fillInBlockArguments(core::Context ctx, const CFG::ReadsAndWrit
     //
     // This solution is  (|BB| + |symbols-mentioned|) * (|cycles|) + |answer_size| in complexity.
     // making this quadratic in anything will be bad.
+    //
+    // The sets are bitsets over local variable ids, so each step of the fixed point handles 64 variables at once.
 
-    const vector<UnorderedSet<core::LocalVariable>> &readsByBlock = RnW.reads;
-    const vector<UnorderedSet<core::LocalVariable>> &writesByBlock = RnW.writes;
-    const vector<UnorderedSet<core::LocalVariable>> &deadByBlock = RnW.dead;
+    const vector<LocalVariableSet> &readsByBlock = RnW.reads;
+    const vector<LocalVariableSet> &writesByBlock = RnW.writes;
+    const vector<LocalVariableSet> &deadByBlock = RnW.dead;
 
     // iterate ver basic blocks in reverse and found upper bounds on what could a block need.
-    vector<UnorderedSet<core::LocalVariable>> upperBounds1(cfg.maxBasicBlockId);
+    vector<LocalVariableSet> upperBounds1(cfg.maxBasicBlockId);
     bool changed = true;
     {
         Timer timeit(ctx.state.tracer(), "upperBounds1");
+        // Any variable that we write and do not read is dead on entry to
+        // this block, and we do not require it.
+        vector<LocalVariableSet> deadOnEntry(cfg.maxBasicBlockId);
         for (BasicBlock *bb : cfg.forwardsTopoSort) {
+            deadByBlock[bb->id].forEach([&](int dead) {
+                // TODO(nelhage) We can't erase for variables inside loops, due
+                // to how our "pinning" type inference works. We can remove this
+                // inner condition when we get a better type inference
+                // algorithm.
+                if (bb->outerLoops <= cfg.minLoopsById[dead]) {
+                    deadOnEntry[bb->id].add(dead);
+                }
+            });
             auto &upperBoundsForBlock = upperBounds1[bb->id];
-            upperBoundsForBlock.insert(readsByBlock[bb->id].begin(), readsByBlock[bb->id].end());
+            upperBoundsForBlock.add(readsByBlock[bb->id]);
+            upperBoundsForBlock.remove(deadOnEntry[bb->id]);
         }
         while (changed) {
             changed = false;
             for (BasicBlock *bb : cfg.forwardsTopoSort) {
-                auto &upperBoundsForBlock = upperBounds1[bb->id];
-                int sz = upperBoundsForBlock.size();
+                LocalVariableSet fromSuccessors;
                 if (bb->bexit.thenb != cfg.deadBlock()) {
-                    upperBoundsForBlock.insert(upperBounds1[bb->bexit.thenb->id].begin(),
-                                               upperBounds1[bb->bexit.thenb->id].end());
+                    fromSuccessors.add(upperBounds1[bb->bexit.thenb->id]);
                 }
                 if (bb->bexit.elseb != cfg.deadBlock()) {
-                    upperBoundsForBlock.insert(upperBounds1[bb->bexit.elseb->id].begin(),
-                                               upperBounds1[bb->bexit.elseb->id].end());
-                }
-                // Any variable that we write and do not read is dead on entry to
-                // this block, and we do not require it.
-                for (auto dead : deadByBlock[bb->id]) {
-                    // TODO(nelhage) We can't erase for variables inside loops, due
-                    // to how our "pinning" type inference works. We can remove this
-                    // inner condition when we get a better type inference
-                    // algorithm.
-                    if (bb->outerLoops <= cfg.minLoops[dead]) {
-                        upperBoundsForBlock.erase(dead);
-                    }
+                    fromSuccessors.add(upperBounds1[bb->bexit.elseb->id]);
                 }
-
-                changed = changed || (upperBoundsForBlock.size() != sz);
+                fromSuccessors.remove(deadOnEntry[bb->id]);
+                changed = upperBounds1[bb->id].add(fromSuccessors) || changed;
             }
         }
     }
 
-    vector<UnorderedSet<core::LocalVariable>> upperBounds2(cfg.maxBasicBlockId);
+    vector<LocalVariableSet> upperBounds2(cfg.maxBasicBlockId);
 
     changed = true;
     {
@@ -375,14 +379,12 @@ void CFGBuilder::fillInBlockArguments(core::Context ctx, const CFG::ReadsAndWrit
             for (auto it = cfg.forwardsTopoSort.rbegin(); it != cfg.forwardsTopoSort.rend(); ++it) {
                 BasicBlock *bb = *it;
                 auto &upperBoundsForBlock = upperBounds2[bb->id];
-                int sz = upperBoundsForBlock.size();
                 for (BasicBlock *edge : bb->backEdges) {
                     if (edge != cfg.deadBlock()) {
-                        upperBoundsForBlock.insert(writesByBlock[edge->id].begin(), writesByBlock[edge->id].end());
-                        upperBoundsForBlock.insert(upperBounds2[edge->id].begin(), upperBounds2[edge->id].end());
+                        changed = upperBoundsForBlock.add(writesByBlock[edge->id]) || changed;
+                        changed = upperBoundsForBlock.add(upperBounds2[edge->id]) || changed;
                     }
                 }
-                changed = changed || (upperBounds2[bb->id].size() != sz);
             }
         }
     }
@@ -390,16 +392,10 @@ void CFGBuilder::fillInBlockArguments(core::Context ctx, const CFG::ReadsAndWrit
         Timer timeit(ctx.state.tracer(), "upperBoundsMerge");
         /** Combine two upper bounds */
         for (auto &it : cfg.basicBlocks) {
-            auto set2 = upperBounds2[it->id];
-
-            int set1Sz = set2.size();
-            int set2Sz = upperBounds1[it->id].size();
-            it->args.reserve(set1Sz > set2Sz ? set2Sz : set1Sz);
-            for (auto el : upperBounds1[it->id]) {
-                if (set2.find(el) != set2.end()) {
-                    it->args.emplace_back(el);
-                }
-            }
+            auto &args = upperBounds1[it->id];
+            args.intersect(upperBounds2[it->id]);
+            it->args.reserve(args.size());
+            args.forEach([&](int id) { it->args.emplace_back(cfg.localVariables[id]); });
             fast_sort(it->args, [](const auto &lhs, const auto &rhs) -> bool { return lhs.variable < rhs.variable; });
             histogramInc("cfgbuilder.blockArguments", it->args.size());
         }
@@ -0,0 +1,97 @@
+#include "common/BlockPool.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace sorbet {
+
+namespace {
+constexpr size_t BLOCK_SIZE = 64 * 1024;
+constexpr size_t ALIGNMENT = alignof(max_align_t);
+// Objects bigger than this don't pack well and go straight to malloc.
+constexpr size_t MAX_BLOCK_ALLOCATION = 1024;
+
+constexpr size_t roundUp(size_t size) {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+} // namespace
+
+struct alignas(ALIGNMENT) BlockPool::Block {
+    atomic<int64_t> live{0};
+};
+
+void BlockPool::retire(Block *block, int64_t allocated, atomic<int64_t> &bytesHeld) {
+    if (block->live.fetch_add(allocated, memory_order_acq_rel) + allocated == 0) {
+        block->~Block();
+        free(block);
+        bytesHeld.fetch_sub(BLOCK_SIZE, memory_order_relaxed);
+    }
+}
+
+BlockPool::BlockPool(atomic<int64_t> &bytesHeld) : bytesHeld(bytesHeld), offset(BLOCK_SIZE) {}
+
+BlockPool::~BlockPool() {
+    if (block != nullptr) {
+        retire(block, allocated, bytesHeld);
+    }
+}
+
+#if __has_feature(address_sanitizer)
+void *BlockPool::allocate(size_t size) {
+    bytesHeld.fetch_add(size, memory_order_relaxed);
+    return ::operator new(size);
+}
+
+void BlockPool::deallocate(void *ptr, size_t size, atomic<int64_t> &bytesHeld) {
+    if (ptr != nullptr) {
+        bytesHeld.fetch_sub(size, memory_order_relaxed);
+    }
+    ::operator delete(ptr);
+}
+#else
+void *BlockPool::allocate(size_t size) {
+    size = roundUp(size);
+    if (size > MAX_BLOCK_ALLOCATION) {
+        bytesHeld.fetch_add(size, memory_order_relaxed);
+        return ::operator new(size);
+    }
+    if (offset + size > BLOCK_SIZE) {
+        if (block != nullptr) {
+            retire(block, allocated, bytesHeld);
+        }
+        void *raw = aligned_alloc(BLOCK_SIZE, BLOCK_SIZE);
+        if (raw == nullptr) {
+            throw bad_alloc();
+        }
+        bytesHeld.fetch_add(BLOCK_SIZE, memory_order_relaxed);
+        block = new (raw) Block();
+        offset = roundUp(sizeof(Block));
+        allocated = 0;
+    }
+    void *result = reinterpret_cast<char *>(block) + offset;
+    offset += size;
+    allocated++;
+    return result;
+}
+
+void BlockPool::deallocate(void *ptr, size_t size, atomic<int64_t> &bytesHeld) {
+    if (ptr == nullptr) {
+        return;
+    }
+    if (roundUp(size) > MAX_BLOCK_ALLOCATION) {
+        bytesHeld.fetch_sub(roundUp(size), memory_order_relaxed);
+        ::operator delete(ptr);
+        return;
+    }
+    auto *block = reinterpret_cast<Block *>(reinterpret_cast<uintptr_t>(ptr) & ~(BLOCK_SIZE - 1));
+    if (block->live.fetch_sub(1, memory_order_acq_rel) == 1) {
+        block->~Block();
+        free(block);
+        bytesHeld.fetch_sub(BLOCK_SIZE, memory_order_relaxed);
+    }
+}
+#endif
+
+} // namespace sorbet
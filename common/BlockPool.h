@@ -0,0 +1,51 @@
+#ifndef SORBET_COMMON_BLOCK_POOL_H
+#define SORBET_COMMON_BLOCK_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sorbet {
+
+/*
+ * Bump-allocates small objects out of 64KiB blocks, for classes that are created and destroyed in huge numbers and
+ * whose instances tend to die together (tree nodes, CFG instructions and blocks). Each such class keeps a
+ * thread_local BlockPool of its own and routes its operator new and delete through it, so one free() releases a whole
+ * block once every object carved out of it has been deleted.
+ *
+ * Objects may outlive the thread and be deleted from any thread, so a block counts its live objects:
+ *
+ * - `live` starts at 0 and each delete (from any thread) decrements it;
+ * - once the owning thread moves on to a new block it adds the number of objects it handed out.
+ *
+ * Before that hand-off `live` can never be positive, so whoever brings it back to 0 afterwards frees the block.
+ *
+ * Oversized objects, and every object in ASan builds (so use-after-free bugs are still caught), use the global
+ * allocator.
+ *
+ * Every pool adds what it takes from the system to a `bytesHeld` counter shared by all pools of the class, and
+ * whoever gives memory back subtracts it, so the counter tells how much memory the class's objects currently pin.
+ */
+class BlockPool final {
+    struct Block;
+    std::atomic<int64_t> &bytesHeld;
+    Block *block = nullptr;
+    size_t offset;
+    int64_t allocated = 0;
+
+    static void retire(Block *block, int64_t allocated, std::atomic<int64_t> &bytesHeld);
+
+public:
+    explicit BlockPool(std::atomic<int64_t> &bytesHeld);
+    ~BlockPool();
+    BlockPool(const BlockPool &) = delete;
+    BlockPool &operator=(const BlockPool &) = delete;
+
+    void *allocate(size_t size);
+    /** Frees memory that allocate(size) returned, on any thread and from any pool sharing `bytesHeld` */
+    static void deallocate(void *ptr, size_t size, std::atomic<int64_t> &bytesHeld);
+};
+
+} // namespace sorbet
+
+#endif
@@ -1,6 +1,8 @@
 #include "common/Counters.h"
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
 #include "common/Counters_impl.h"
+#include <array>
 #include <algorithm>
 #include <chrono>
 #include <cmath>
@@ -23,6 +25,92 @@ bool CounterState::hasNullCounters() const {
     return counters.get() == nullptr;
 }
 
+namespace {
+// The name of a counter slot. `category` is null for counters that don't belong to one.
+struct SlotName {
+    const char *category;
+    const char *counter;
+};
+
+// Hands out the ids of counter slots. Every distinct name gets one id for the lifetime of the process, no matter how
+// many string literals spell it, so the slots of different threads line up.
+class SlotRegistry {
+    absl::Mutex mtx;
+    UnorderedMap<std::pair<string_view, string_view>, u4> idsByName;
+    vector<SlotName> names;
+
+public:
+    u4 idFor(const char *category, const char *counter) {
+        absl::MutexLock lock(&mtx);
+        auto [it, inserted] =
+            idsByName.try_emplace(make_pair(category == nullptr ? string_view() : category, counter), names.size());
+        if (inserted) {
+            names.emplace_back(SlotName{category, counter});
+        }
+        return it->second;
+    }
+
+    vector<SlotName> allNames() {
+        absl::MutexLock lock(&mtx);
+        return names;
+    }
+};
+
+SlotRegistry &slotRegistry() {
+    static SlotRegistry registry;
+    return registry;
+}
+
+// Remembers the slot of each (category, counter) literal this thread has used, so that the registry's lock is only
+// taken the first time. The common case is a hit in the direct-mapped `recent`.
+struct SlotCache {
+    static constexpr size_t RECENT_SIZE = 1024;
+    struct Entry {
+        const char *category = nullptr;
+        const char *counter = nullptr;
+        u4 id = 0;
+    };
+    std::array<Entry, RECENT_SIZE> recent;
+    UnorderedMap<std::pair<const char *, const char *>, u4> all;
+};
+
+thread_local SlotCache slotCache;
+
+u4 slotFor(const char *category, const char *counter) {
+    auto hash = (reinterpret_cast<uintptr_t>(counter) >> 3) ^ (reinterpret_cast<uintptr_t>(category) >> 7);
+    auto &entry = slotCache.recent[hash % SlotCache::RECENT_SIZE];
+    if (entry.counter == counter && entry.category == category) {
+        return entry.id;
+    }
+    auto [it, inserted] = slotCache.all.try_emplace(make_pair(category, counter), 0);
+    if (inserted) {
+        it->second = slotRegistry().idFor(category, counter);
+    }
+    entry = SlotCache::Entry{category, counter, it->second};
+    return it->second;
+}
+
+enum class StreamingMode { Off, Stream, StreamAndKeep };
+atomic<StreamingMode> streamingMode{StreamingMode::Off};
+
+struct StreamedTimings {
+    absl::Mutex mtx;
+    vector<CounterImpl::Timing> pending;
+};
+
+StreamedTimings &streamedTimings() {
+    static StreamedTimings streamed;
+    return streamed;
+}
+
+void slotAdd(vector<CounterImpl::CounterType> &slots, u4 id, unsigned long value) {
+    if (id >= slots.size()) {
+        slots.resize(max<size_t>(id + 1, 2 * slots.size()));
+    }
+    slots[id] += value;
+}
+} // namespace
+
 const char *CounterImpl::internKey(const char *str) {
     auto it1 = this->stringsByPtr.find(str);
     if (it1 != this->stringsByPtr.end()) {
@@ -66,7 +154,7 @@ void CounterImpl::prodCategoryCounterAdd(const char *category, const char *count
     if (fuzz_mode) {
         return;
     }
-    this->countersByCategory[category][counter] += value;
+    slotAdd(this->slots, slotFor(category, counter), value);
 }
 
 void CounterImpl::counterAdd(const char *counter, unsigned long value) {
@@ -80,7 +168,16 @@ void CounterImpl::prodCounterAdd(const char *counter, unsigned long value) {
     if (fuzz_mode) {
         return;
     }
-    this->counters[counter] += value;
+    slotAdd(this->slots, slotFor(nullptr, counter), value);
+}
+
+void CounterImpl::slotsAdd(const vector<CounterType> &other) {
+    if (other.size() > this->slots.size()) {
+        this->slots.resize(other.size());
+    }
+    for (size_t i = 0; i < other.size(); i++) {
+        this->slots[i] += other[i];
+    }
 }
 
 void CounterImpl::timingAdd(CounterImpl::Timing timing) {
@@ -104,6 +201,7 @@ void CounterImpl::clear() {
     this->histograms.clear();
     this->counters.clear();
     this->countersByCategory.clear();
+    this->slots.clear();
 }
 
 UnorderedMap<long, long> getAndClearHistogram(ConstExprStr histogram) {
@@ -122,9 +220,10 @@ UnorderedMap<long, long> getAndClearHistogram(ConstExprStr histogram) {
 }
 
 void counterConsume(CounterState cs) {
+    counterState.slotsAdd(cs.counters->slots);
     for (auto &cat : cs.counters->countersByCategory) {
         for (auto &e : cat.second) {
-            counterState.prodCategoryCounterAdd(cat.first, e.first, e.second);
+            counterState.countersByCategory[cat.first][e.first] += e.second;
         }
     }
 
@@ -135,7 +234,7 @@ void counterConsume(CounterState cs) {
     }
 
     for (auto &e : cs.counters->counters) {
-        counterState.prodCounterAdd(e.first, e.second);
+        counterState.counters[e.first] += e.second;
     }
     for (auto &e : cs.counters->timings) {
         counterState.timingAdd(e);
@@ -198,7 +297,33 @@ void timingAdd(ConstExprStr measure, std::chrono::time_point<std::chrono::steady
                                             // for workaround
     CounterImpl::Timing tim{0,    measure.str, start, end, getThreadId(), givenArgs2StoredArgs(move(args)),
                             self, previous};
-    counterState.timingAdd(tim);
+    auto mode = streamingMode.load(memory_order_relaxed);
+    if (mode != StreamingMode::Off && !fuzz_mode) {
+        auto &streamed = streamedTimings();
+        absl::MutexLock lock(&streamed.mtx);
+        if (mode == StreamingMode::Stream) {
+            streamed.pending.emplace_back(move(tim));
+            return;
+        }
+        streamed.pending.emplace_back(tim);
+    }
+    counterState.timingAdd(move(tim));
+}
+
+void startStreamingTimings(bool keepInCounters) {
+    streamingMode.store(keepInCounters ? StreamingMode::StreamAndKeep : StreamingMode::Stream);
+}
+
+void stopStreamingTimings() {
+    streamingMode.store(StreamingMode::Off);
+}
+
+vector<CounterImpl::Timing> takeStreamedTimings() {
+    auto &streamed = streamedTimings();
+    vector<CounterImpl::Timing> taken;
+    absl::MutexLock lock(&streamed.mtx);
+    swap(taken, streamed.pending);
+    return taken;
 }
 
 void prodCategoryCounterAdd(ConstExprStr category, ConstExprStr counter, unsigned long value) {
@@ -229,9 +354,25 @@ const float HIST_CUTOFF = 0.1;
 void CounterImpl::canonicalize() {
     CounterImpl out;
 
+    if (!this->slots.empty()) {
+        auto names = slotRegistry().allNames();
+        for (size_t id = 0; id < this->slots.size(); id++) {
+            if (this->slots[id] == 0) {
+                continue;
+            }
+            auto &name = names[id];
+            if (name.category == nullptr) {
+                this->counters[name.counter] += this->slots[id];
+            } else {
+                this->countersByCategory[name.category][name.counter] += this->slots[id];
+            }
+        }
+        this->slots.clear();
+    }
+
     for (auto &cat : this->countersByCategory) {
         for (auto &e : cat.second) {
-            out.prodCategoryCounterAdd(internKey(cat.first), internKey(e.first), e.second);
+            out.countersByCategory[internKey(cat.first)][internKey(e.first)] += e.second;
         }
     }
 
@@ -242,7 +383,7 @@ void CounterImpl::canonicalize() {
     }
 
     for (auto &e : this->counters) {
-        out.prodCounterAdd(internKey(e.first), e.second);
+        out.counters[internKey(e.first)] += e.second;
     }
 
     for (auto &e : this->timings) {
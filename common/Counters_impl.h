@@ -26,6 +26,9 @@ struct CounterImpl {
     void counterAdd(const char *counter, unsigned long value);
     void prodCounterAdd(const char *counter, unsigned long value);
 
+    // Adds `other`'s counter slots to this one's.
+    void slotsAdd(const std::vector<CounterType> &other);
+
     // std::string_view isn't hashable, so we use an unordered map. We could
     // implement hash ourselves, but this is the slowpath anyways.
     UnorderedMap<std::string_view, const char *> strings_by_value;
@@ -43,10 +46,21 @@ struct CounterImpl {
     };
     void timingAdd(Timing timing);
     UnorderedMap<const char *, UnorderedMap<int, CounterType>> histograms;
+    // Counters and category counters are only filled in by canonicalize(). Until then, their values live in `slots`,
+    // indexed by an id that is handed out once per distinct (category, counter) name for the whole process, so that
+    // bumping a counter is an array increment and merging two threads' counters is adding two arrays together.
     UnorderedMap<const char *, CounterType> counters;
     std::vector<Timing> timings;
     UnorderedMap<const char *, UnorderedMap<const char *, CounterType>> countersByCategory;
+    std::vector<CounterType> slots;
 };
+
+// While a trace is streamed (see web_tracer_framework::TraceStreamer), every timing is collected for it as soon as it
+// is recorded, on any thread. `keepInCounters` says whether the recording thread's CounterState gets the timing too.
+void startStreamingTimings(bool keepInCounters);
+void stopStreamingTimings();
+// The timings recorded since the last call, in no particular order.
+std::vector<CounterImpl::Timing> takeStreamedTimings();
 } // namespace sorbet
 
 #endif
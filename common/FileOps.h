@@ -1,23 +1,61 @@
 #ifndef SORBET_COMMON_FILEOPS_HPP
 #define SORBET_COMMON_FILEOPS_HPP
 #include "common/common.h"
+#include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
 
 namespace sorbet {
 
+/**
+ * The contents of a file, mapped read-only into memory. The mapping lives as long as this object.
+ */
+class MappedFile final {
+    void *data;
+    size_t size;
+
+public:
+    /**
+     * What stat said about the file when it was mapped. As long as none of it changes, the file on disk is still the
+     * one that was read, so its contents need not be looked at again.
+     */
+    struct Stamp {
+        u8 size = 0;
+        u8 mtimeNs = 0;
+        u8 inode = 0;
+        u8 device = 0;
+    };
+    const Stamp stamp;
+
+    MappedFile(void *data, size_t size, Stamp stamp);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&) = delete;
+
+    std::string_view contents() const;
+};
+
 class FileOps final {
 public:
     static bool exists(std::string_view filename);
     static bool isFile(std::string_view path, std::string_view ignorePattern, const int pos);
     static bool isFolder(std::string_view path, std::string_view ignorePattern, const int pos);
     static std::string read(std::string_view filename);
+    /**
+     * Like `read`, but maps the file into memory instead of copying it. Throws FileNotFoundException.
+     *
+     * The mapping is private, but still reads through to the file: if it is truncated while mapped, touching the
+     * contents past its new end raises SIGBUS. Only map files that aren't expected to change while they are in use.
+     */
+    static std::shared_ptr<MappedFile> readMapped(std::string_view filename);
     static void write(std::string_view filename, const std::vector<sorbet::u1> &data);
     static void append(std::string_view filename, std::string_view text);
     static void write(std::string_view filename, std::string_view text);
     static bool writeIfDifferent(std::string_view filename, std::string_view text);
     static bool dirExists(std::string_view path);
+    /** Size of the file in bytes, or 0 if it can not be found. */
+    static size_t fileSize(std::string_view path);
     static void createDir(std::string_view path);
     static void removeFile(std::string_view path);
     /**
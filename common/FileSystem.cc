@@ -8,6 +8,10 @@ string OSFileSystem::readFile(string_view path) const {
     return FileOps::read(path);
 }
 
+shared_ptr<MappedFile> OSFileSystem::readFileMapped(string_view path) const {
+    return FileOps::readMapped(path);
+}
+
 void OSFileSystem::writeFile(string_view filename, string_view text) {
     return FileOps::write(filename, text);
 }
@@ -2,10 +2,12 @@
 #define COMMON_FILESYSTEM_H
 
 #include "common/common.h"
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace sorbet {
+class MappedFile;
 
 /**
  * File system interface.
@@ -18,7 +20,15 @@ public:
     /** Read the file at the given path. Throws a `FileNotFoundException` if not found. */
     virtual std::string readFile(std::string_view path) const = 0;
 
-    /** Writes the specified data to the given file. */
+    /**
+     * Maps the file at the given path into memory. Returns nullptr if this file system can't map files, in which case
+     * callers should fall back to `readFile`. Throws a `FileNotFoundException` if not found.
+     */
+    virtual std::shared_ptr<MappedFile> readFileMapped(std::string_view path) const {
+        return nullptr;
+    }
+
+    /** Writes the specified data to the given file. Different files may be written from different threads at once. */
     virtual void writeFile(std::string_view filename, std::string_view text) = 0;
 
     /**
@@ -44,6 +54,7 @@ public:
     OSFileSystem() = default;
 
     std::string readFile(std::string_view path) const override;
+    std::shared_ptr<MappedFile> readFileMapped(std::string_view path) const override;
     void writeFile(std::string_view filename, std::string_view text) override;
     std::vector<std::string> listFilesInDir(std::string_view path, const UnorderedSet<std::string> &extensions,
                                             bool recursive, const std::vector<std::string> &absoluteIgnorePatterns,
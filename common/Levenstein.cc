@@ -1,15 +1,57 @@
 #include "common/Levenstein.h"
 #include "common/common.h"
+#include <array>
 #include <vector>
 
 using namespace std;
 
-int sorbet::Levenstein::distance(string_view s1, string_view s2, int bound) noexcept {
+namespace sorbet {
+
+namespace {
+
+// Hyyrö's formulation of Myers' bit-parallel algorithm: for a `pattern` that fits in a machine word, each character of
+// `text` advances a whole column of the distance matrix, stored as bit vectors of the +1/-1 steps between its rows.
+int bitParallelDistance(string_view pattern, string_view text, int bound) noexcept {
+    ENFORCE(!pattern.empty() && pattern.size() <= 64);
+    array<u8, 256> peq{};
+    for (int i = 0; i < pattern.size(); i++) {
+        peq[static_cast<unsigned char>(pattern[i])] |= u8(1) << i;
+    }
+
+    const u8 last = u8(1) << (pattern.size() - 1);
+    u8 pv = ~u8(0);
+    u8 mv = 0;
+    int score = pattern.size();
+    int left = text.size();
+    for (auto c : text) {
+        u8 eq = peq[static_cast<unsigned char>(c)];
+        u8 xv = eq | mv;
+        u8 xh = (((eq & pv) + pv) ^ pv) | eq;
+        u8 ph = mv | ~(xh | pv);
+        u8 mh = pv & xh;
+        if (ph & last) {
+            score++;
+        } else if (mh & last) {
+            score--;
+        }
+        // The distance can only come down by one for each character left.
+        if (score - --left > bound) {
+            return INT_MAX;
+        }
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+} // namespace
+
+int Levenstein::distance(string_view s1, string_view s2, int bound) noexcept {
     if (s1.data() == s2.data() && s1.size() == s2.size()) {
         return 0;
     }
-    // A mildly tweaked version from
-    // https://en.wikibooks.org/wiki/Algorithm_Implementation/Strings/Levenshtein_distance#C++
     int s1len = s1.size();
     int s2len = s2.size();
     if (s2len < s1len) {
@@ -20,20 +62,36 @@ int sorbet::Levenstein::distance(string_view s1, string_view s2, int bound) noex
     if (s2len - s1len > bound) {
         return INT_MAX;
     }
+    if (s1len == 0) {
+        return s2len;
+    }
+    if (s1len <= 64) {
+        return bitParallelDistance(s1, s2, bound);
+    }
 
+    // A mildly tweaked version from
+    // https://en.wikibooks.org/wiki/Algorithm_Implementation/Strings/Levenshtein_distance#C++
     vector<int> column(s1len + 1);
     absl::c_iota(column, 0);
 
     for (int x = 1; x <= s2len; x++) {
         column[0] = x;
         int lastDiagonal = x - 1;
+        int best = column[0];
         for (auto y = 1; y <= s1len; y++) {
             int oldDiagonal = column[y];
             auto possibilities = {column[y] + 1, column[y - 1] + 1, lastDiagonal + (s1[y - 1] == s2[x - 1] ? 0 : 1)};
             column[y] = min(possibilities);
+            best = min(best, column[y]);
             lastDiagonal = oldDiagonal;
         }
+        // Distances never come down from one column to the next.
+        if (best > bound) {
+            return INT_MAX;
+        }
     }
     int result = column[s1len];
-    return result;
+    return result > bound ? INT_MAX : result;
 }
+
+} // namespace sorbet
@@ -1,6 +1,8 @@
 #include "common/Subprocess.h"
 #include "common/common.h"
 #include <array>
+#include <csignal>
+#include <fcntl.h>
 #include <spawn.h>
 #include <sstream>
 #include <string>
@@ -128,3 +130,127 @@ optional<string> sorbet::Subprocess::spawn(string executable, vector<string> arg
 
     return sink.str();
 }
+
+sorbet::ResidentSubprocess::ResidentSubprocess(pid_t childPid, int toChild, int fromChild)
+    : childPid(childPid), toChild(toChild), fromChild(fromChild) {}
+
+unique_ptr<sorbet::ResidentSubprocess> sorbet::ResidentSubprocess::spawn(string executable, vector<string> arguments) {
+    if (emscripten_build) {
+        return nullptr;
+    }
+    // A child that dies mid-request must surface as a failed write, not kill us.
+    static const bool ignoringSigpipe = signal(SIGPIPE, SIG_IGN) != SIG_ERR;
+    if (!ignoringSigpipe) {
+        return nullptr;
+    }
+
+    int input[2];
+    int output[2];
+    if (pipe(input)) {
+        return nullptr;
+    }
+    if (pipe(output)) {
+        close(input[0]);
+        close(input[1]);
+        return nullptr;
+    }
+    // Our ends must not leak into other children, or this child would never see EOF on its stdin.
+    fcntl(input[1], F_SETFD, FD_CLOEXEC);
+    fcntl(output[0], F_SETFD, FD_CLOEXEC);
+
+    pid_t childPid;
+    int ret;
+    {
+        FileCloser closeChildRead(input[0]);
+        FileCloser closeChildWrite(output[1]);
+
+        FileActions fileActions;
+        ret = fileActions.initialized() ? 0 : -1;
+        if (!ret) {
+            ret = posix_spawn_file_actions_adddup2(fileActions, input[0], 0);
+        }
+        if (!ret) {
+            ret = posix_spawn_file_actions_adddup2(fileActions, output[1], 1);
+        }
+        if (!ret) {
+            vector<char *> argv;
+            argv.reserve(arguments.size() + 2);
+            argv.push_back(executable.data());
+            for (auto &arg : arguments) {
+                argv.push_back(arg.data());
+            }
+            argv.push_back(nullptr);
+
+            ret = posix_spawnp(&childPid, executable.data(), fileActions, nullptr, argv.data(), nullptr);
+        }
+    }
+    if (ret) {
+        close(input[1]);
+        close(output[0]);
+        return nullptr;
+    }
+    return unique_ptr<ResidentSubprocess>(new ResidentSubprocess(childPid, input[1], output[0]));
+}
+
+sorbet::ResidentSubprocess::~ResidentSubprocess() {
+    close(toChild);
+    close(fromChild);
+    while (waitpid(childPid, nullptr, 0) < 0 && errno == EINTR) {
+    }
+}
+
+bool sorbet::ResidentSubprocess::write(string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = ::write(toChild, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(written);
+    }
+    return true;
+}
+
+bool sorbet::ResidentSubprocess::fill() {
+    array<char, 4096> chunk;
+    while (true) {
+        const ssize_t bytesRead = read(fromChild, chunk.data(), chunk.size());
+        if (bytesRead > 0) {
+            buffered.append(chunk.data(), bytesRead);
+            return true;
+        } else if (bytesRead == 0) {
+            return false;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+optional<string> sorbet::ResidentSubprocess::readUntil(char delimiter) {
+    size_t searched = 0;
+    while (true) {
+        auto pos = buffered.find(delimiter, searched);
+        if (pos != string::npos) {
+            string result = buffered.substr(0, pos);
+            buffered.erase(0, pos + 1);
+            return result;
+        }
+        searched = buffered.size();
+        if (!fill()) {
+            return nullopt;
+        }
+    }
+}
+
+optional<string> sorbet::ResidentSubprocess::readExactly(size_t size) {
+    while (buffered.size() < size) {
+        if (!fill()) {
+            return nullopt;
+        }
+    }
+    string result = buffered.substr(0, size);
+    buffered.erase(0, size);
+    return result;
+}
@@ -1,7 +1,11 @@
 #ifndef SORBET_SUBPROCESS_H
 #define SORBET_SUBPROCESS_H
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
 
 namespace sorbet {
 
@@ -12,5 +16,34 @@ public:
     static std::optional<std::string> spawn(std::string executable, std::vector<std::string> arguments);
 };
 
+// A child process that stays alive between requests. Requests are written to its stdin and replies read from its
+// stdout, so that the cost of starting the child is paid once rather than once per request.
+//
+// Not thread safe: each thread that talks to a resident child should own its own.
+class ResidentSubprocess {
+    pid_t childPid;
+    int toChild;
+    int fromChild;
+    std::string buffered;
+
+    ResidentSubprocess(pid_t childPid, int toChild, int fromChild);
+
+    bool fill();
+
+public:
+    static std::unique_ptr<ResidentSubprocess> spawn(std::string executable, std::vector<std::string> arguments);
+
+    // Closes the child's stdin and waits for it to exit.
+    ~ResidentSubprocess();
+    ResidentSubprocess(const ResidentSubprocess &) = delete;
+    ResidentSubprocess &operator=(const ResidentSubprocess &) = delete;
+
+    bool write(std::string_view data);
+    // Reads up to and excluding the next `delimiter`. Returns nullopt if the child closes its stdout first.
+    std::optional<std::string> readUntil(char delimiter);
+    // Reads exactly `size` bytes. Returns nullopt if the child closes its stdout first.
+    std::optional<std::string> readExactly(size_t size);
+};
+
 } // namespace sorbet
 #endif // SORBET_SUBPROCESS_H
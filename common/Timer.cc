@@ -1,7 +1,13 @@
 #include "common/Timer.h"
+#include <atomic>
 using namespace std;
 namespace sorbet {
 
+namespace {
+atomic<bool> recordAllSpans = false;
+atomic<bool> argsEnabled = true;
+}
+
 Timer::Timer(spdlog::logger &log, ConstExprStr name, FlowId prev, initializer_list<pair<ConstExprStr, string>> args)
     : log(log), name(name), prev(prev), self{0}, args(args), start(chrono::steady_clock::now()){};
 
@@ -34,10 +40,29 @@ FlowId Timer::getFlowEdge() {
     return this->self;
 }
 
+void Timer::setTag(ConstExprStr name, string value) {
+    if (!spanArgsEnabled()) {
+        return;
+    }
+    args.emplace_back(name, move(value));
+}
+
+void Timer::setRecordAllSpans(bool recordAll) {
+    recordAllSpans.store(recordAll, memory_order_relaxed);
+}
+
+void Timer::setSpanArgsEnabled(bool enabled) {
+    argsEnabled.store(enabled, memory_order_relaxed);
+}
+
+bool Timer::spanArgsEnabled() {
+    return argsEnabled.load(memory_order_relaxed);
+}
+
 Timer::~Timer() {
     auto clock = chrono::steady_clock::now();
     auto dur = clock - start;
-    if (dur > std::chrono::milliseconds(1)) {
+    if (dur > std::chrono::milliseconds(1) || recordAllSpans.load(memory_order_relaxed)) {
         // the trick ^^^ is to skip double comparison in the common case and use the most efficient represnetation.
         auto dur = std::chrono::duration<double, std::milli>(clock - start);
         log.debug("{}: {}ms", this->name.str, dur.count());
@@ -19,9 +19,27 @@ public:
           std::initializer_list<std::pair<ConstExprStr, std::string>> args);
     Timer(const std::shared_ptr<spdlog::logger> &log, ConstExprStr name,
           std::initializer_list<std::pair<ConstExprStr, std::string>> args);
+    // Only calls `arg` when spans take arguments, so that spans opened for every file don't copy its path for nothing.
+    template <class F>
+    Timer(spdlog::logger &log, ConstExprStr name, ConstExprStr argName, F &&arg) : Timer(log, name) {
+        if (spanArgsEnabled()) {
+            args.emplace_back(argName, arg());
+        }
+    }
     ~Timer();
     FlowId getFlowEdge();
 
+    // Attaches another argument to the span, e.g. something only known once the work it measures is done.
+    void setTag(ConstExprStr name, std::string value);
+
+    // By default, spans that take less than a millisecond are not recorded. --profile-files needs all of them.
+    static void setRecordAllSpans(bool recordAll);
+
+    // Span arguments only show up in the web trace and in --profile-files. Without either, setTag and the lazy
+    // constructor skip them.
+    static void setSpanArgsEnabled(bool enabled);
+    static bool spanArgsEnabled();
+
 private:
     spdlog::logger &log;
     ConstExprStr name;
@@ -30,6 +48,17 @@ private:
     std::vector<std::pair<ConstExprStr, std::string>> args;
     const std::chrono::time_point<std::chrono::steady_clock> start;
 };
+
+#ifndef SORBET_NO_PER_FILE_SPANS
+// A span opened once per file. Building with `--define per_file_spans=false` compiles these out.
+using FileTimer = Timer;
+#else
+class FileTimer {
+public:
+    template <class... Args> FileTimer(Args &&...) {}
+    void setTag(ConstExprStr, std::string) {}
+};
+#endif
 } // namespace sorbet
 
 #endif
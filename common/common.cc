@@ -1,6 +1,7 @@
 #include "common/common.h"
 #include "common/Exception.h"
 #include "common/FileOps.h"
+#include "absl/synchronization/mutex.h"
 #include "os/os.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include <array>
@@ -9,8 +10,13 @@
 #include <cstdio>
 #include <cxxabi.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <exception>
 #include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
 using namespace std;
@@ -49,6 +55,51 @@ string sorbet::FileOps::read(string_view filename) {
     throw sorbet::FileNotFoundException();
 }
 
+sorbet::MappedFile::MappedFile(void *data, size_t size, Stamp stamp) : data(data), size(size), stamp(stamp) {}
+
+sorbet::MappedFile::~MappedFile() {
+    if (size > 0) {
+        munmap(data, size);
+    }
+}
+
+string_view sorbet::MappedFile::contents() const {
+    return string_view(static_cast<const char *>(data), size);
+}
+
+shared_ptr<sorbet::MappedFile> sorbet::FileOps::readMapped(string_view filename) {
+    int fd = open(string(filename).c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw sorbet::FileNotFoundException();
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw sorbet::FileNotFoundException();
+    }
+    size_t size = st.st_size;
+    MappedFile::Stamp stamp;
+    stamp.size = size;
+#ifdef __APPLE__
+    stamp.mtimeNs = (u8)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    stamp.mtimeNs = (u8)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    stamp.inode = st.st_ino;
+    stamp.device = st.st_dev;
+    if (size == 0) {
+        // mmap refuses empty mappings
+        close(fd);
+        return make_shared<MappedFile>(nullptr, 0, stamp);
+    }
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw sorbet::FileNotFoundException();
+    }
+    return make_shared<MappedFile>(data, size, stamp);
+}
+
 void sorbet::FileOps::write(string_view filename, const vector<sorbet::u1> &data) {
     FILE *fp = std::fopen(string(filename).c_str(), "wb");
     if (fp) {
@@ -64,6 +115,14 @@ bool sorbet::FileOps::dirExists(string_view path) {
     return stat((string(path)).c_str(), &buffer) == 0 && S_ISDIR(buffer.st_mode);
 }
 
+size_t sorbet::FileOps::fileSize(string_view path) {
+    struct stat buffer;
+    if (stat((string(path)).c_str(), &buffer) != 0) {
+        return 0;
+    }
+    return buffer.st_size;
+}
+
 void sorbet::FileOps::createDir(string_view path) {
     auto err = mkdir(string(path).c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
     if (err) {
@@ -227,9 +286,54 @@ bool sorbet::FileOps::isFileIgnored(string_view basePath, string_view filePath,
     return false;
 }
 
-void appendFilesInDir(string_view basePath, string_view path, const sorbet::UnorderedSet<string> &extensions,
-                      bool recursive, vector<string> &result, const std::vector<std::string> &absoluteIgnorePatterns,
-                      const std::vector<std::string> &relativeIgnorePatterns) {
+namespace {
+// The ignore patterns of one listFilesInDir call, in hash sets. Directories are only listed once they were checked
+// themselves, so the parts of a path ending at its parent's end never need checking again: it is enough to look up the
+// whole path among absolute patterns, and its suffixes starting at a '/' among relative ones.
+class IgnoreMatcher {
+    const vector<string> &absoluteIgnorePatterns;
+    const vector<string> &relativeIgnorePatterns;
+    sorbet::UnorderedSet<string_view> absolute;
+    sorbet::UnorderedSet<string_view> relative;
+    // Patterns that don't start with a '/' can match in the middle of a file name, so they are searched for instead.
+    bool searchForPatterns = false;
+
+public:
+    IgnoreMatcher(const vector<string> &absoluteIgnorePatterns, const vector<string> &relativeIgnorePatterns)
+        : absoluteIgnorePatterns(absoluteIgnorePatterns), relativeIgnorePatterns(relativeIgnorePatterns) {
+        for (auto &p : absoluteIgnorePatterns) {
+            searchForPatterns = searchForPatterns || p.empty() || p[0] != '/';
+            absolute.insert(p);
+        }
+        for (auto &p : relativeIgnorePatterns) {
+            searchForPatterns = searchForPatterns || p.empty() || p[0] != '/';
+            relative.insert(p);
+        }
+    }
+
+    bool isIgnored(string_view basePath, string_view filePath) const {
+        if (searchForPatterns) {
+            return sorbet::FileOps::isFileIgnored(basePath, filePath, absoluteIgnorePatterns, relativeIgnorePatterns);
+        }
+        string_view relativePath = filePath.substr(basePath.length());
+        if (absolute.find(relativePath) != absolute.end()) {
+            return true;
+        }
+        if (relative.empty()) {
+            return false;
+        }
+        for (auto pos = relativePath.find('/'); pos != string_view::npos; pos = relativePath.find('/', pos + 1)) {
+            if (relative.find(relativePath.substr(pos)) != relative.end()) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Lists the entries of one directory: matching files go to `files`, and subdirectories to `subdirs` (when recursive).
+void listOneDir(string_view basePath, string_view path, const sorbet::UnorderedSet<string> &extensions, bool recursive,
+                const IgnoreMatcher &ignoreMatcher, vector<string> &files, vector<string> &subdirs) {
     DIR *dir;
     struct dirent *entry;
 
@@ -245,21 +349,20 @@ void appendFilesInDir(string_view basePath, string_view path, const sorbet::Unor
 
     while ((entry = readdir(dir)) != nullptr) {
         auto fullPath = fmt::format("{}/{}", path, entry->d_name);
-        if (sorbet::FileOps::isFileIgnored(basePath, fullPath, absoluteIgnorePatterns, relativeIgnorePatterns)) {
+        if (ignoreMatcher.isIgnored(basePath, fullPath)) {
             continue;
         } else if (entry->d_type == DT_DIR) {
             if (!recursive || strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
                 continue;
             }
-            appendFilesInDir(basePath, fullPath, extensions, recursive, result, absoluteIgnorePatterns,
-                             relativeIgnorePatterns);
+            subdirs.emplace_back(move(fullPath));
         } else {
             auto dotLocation = fullPath.rfind('.');
             // Note: Can't call substr with an index > string length, so explicitly check if a dot isn't found.
             if (dotLocation != string::npos) {
                 auto ext = fullPath.substr(dotLocation);
                 if (extensions.find(ext) != extensions.end()) {
-                    result.emplace_back(fullPath);
+                    files.emplace_back(fullPath);
                 }
             }
         }
@@ -267,11 +370,103 @@ void appendFilesInDir(string_view basePath, string_view path, const sorbet::Unor
     closedir(dir);
 }
 
+// Walks a directory tree on several threads, which take whichever directory is next to list. Most of a walk is spent
+// waiting on opendir and readdir, which on network filesystems each take a round trip.
+class DirectoryWalker {
+    const string_view basePath;
+    const sorbet::UnorderedSet<string> &extensions;
+    const IgnoreMatcher &ignoreMatcher;
+
+    absl::Mutex mtx;
+    vector<string> pending GUARDED_BY(mtx);
+    // Directories being listed, which might add more to `pending`.
+    int listing GUARDED_BY(mtx) = 0;
+    exception_ptr failure GUARDED_BY(mtx);
+    vector<string> result GUARDED_BY(mtx);
+
+    bool canProceed() const EXCLUSIVE_LOCKS_REQUIRED(mtx) {
+        return !pending.empty() || listing == 0 || failure;
+    }
+
+    void work() {
+        vector<string> files;
+        vector<string> subdirs;
+        while (true) {
+            string dir;
+            {
+                absl::MutexLock lock(&mtx);
+                mtx.Await(absl::Condition(this, &DirectoryWalker::canProceed));
+                if (pending.empty() || failure) {
+                    return;
+                }
+                dir = move(pending.back());
+                pending.pop_back();
+                listing++;
+            }
+            exception_ptr error;
+            try {
+                listOneDir(basePath, dir, extensions, true, ignoreMatcher, files, subdirs);
+            } catch (...) {
+                error = current_exception();
+            }
+            absl::MutexLock lock(&mtx);
+            listing--;
+            if (error) {
+                failure = error;
+                return;
+            }
+            result.insert(result.end(), make_move_iterator(files.begin()), make_move_iterator(files.end()));
+            pending.insert(pending.end(), make_move_iterator(subdirs.begin()), make_move_iterator(subdirs.end()));
+            files.clear();
+            subdirs.clear();
+        }
+    }
+
+public:
+    DirectoryWalker(string_view basePath, const sorbet::UnorderedSet<string> &extensions,
+                    const IgnoreMatcher &ignoreMatcher)
+        : basePath(basePath), extensions(extensions), ignoreMatcher(ignoreMatcher) {}
+
+    vector<string> walk(int threads) {
+        {
+            absl::MutexLock lock(&mtx);
+            pending.emplace_back(basePath);
+        }
+        {
+            vector<unique_ptr<Joinable>> helpers;
+            for (int i = 1; i < threads; i++) {
+                helpers.emplace_back(runInAThread("listFilesInDir", [this]() { work(); }));
+            }
+            work();
+        }
+        absl::MutexLock lock(&mtx);
+        if (failure) {
+            rethrow_exception(failure);
+        }
+        return move(result);
+    }
+};
+
+// Enough to hide the latency of a network filesystem, without crowding out everything else at startup.
+constexpr int MAX_LISTING_THREADS = 8;
+} // namespace
+
 vector<string> sorbet::FileOps::listFilesInDir(string_view path, const UnorderedSet<string> &extensions, bool recursive,
                                                const std::vector<std::string> &absoluteIgnorePatterns,
                                                const std::vector<std::string> &relativeIgnorePatterns) {
     vector<string> result;
-    appendFilesInDir(path, path, extensions, recursive, result, absoluteIgnorePatterns, relativeIgnorePatterns);
+    IgnoreMatcher ignoreMatcher(absoluteIgnorePatterns, relativeIgnorePatterns);
+    if (recursive && threads_supported) {
+        int threads = min<int>(MAX_LISTING_THREADS, max(1u, thread::hardware_concurrency()));
+        result = DirectoryWalker(path, extensions, ignoreMatcher).walk(threads);
+    } else {
+        vector<string> subdirs{string(path)};
+        while (!subdirs.empty()) {
+            string dir = move(subdirs.back());
+            subdirs.pop_back();
+            listOneDir(path, dir, extensions, recursive, ignoreMatcher, result, subdirs);
+        }
+    }
     fast_sort(result);
     return result;
 }
@@ -48,6 +48,14 @@ constexpr bool emscripten_build = false;
 constexpr bool emscripten_build = true;
 #endif
 
+// Whether this build can start threads. WebAssembly builds only can when compiled with -pthread (see the
+// webasm-threads config), which makes the browser run each thread in a Web Worker sharing the module's memory.
+#if !defined(EMSCRIPTEN) || defined(__EMSCRIPTEN_PTHREADS__)
+constexpr bool threads_supported = true;
+#else
+constexpr bool threads_supported = false;
+#endif
+
 #if !defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION)
 constexpr bool fuzz_mode = false;
 #else
@@ -29,44 +29,67 @@ struct DequeueResult {
 template <class Elem, class Queue> class AbstractConcurrentBoundedQueue {
     Queue _queue;
     std::atomic<int> elementsLeftToPush; // double serves as a counter and as safe publication marker
+    std::atomic<int> elementsPushed;
     std::atomic<int> elementsPopped;
 
+    // Whether more elements are still to come, or some of the pushed ones are yet to be popped.
+    inline bool mightGetMore() noexcept {
+        return elementsLeftToPush.load(std::memory_order_acquire) != 0 ||
+               elementsPopped.load(std::memory_order_acquire) < elementsPushed.load(std::memory_order_acquire);
+    }
+
 public:
     const int bound;
-    AbstractConcurrentBoundedQueue(int bound) noexcept : elementsLeftToPush(bound), elementsPopped(0), bound(bound) {}
+    AbstractConcurrentBoundedQueue(int bound) noexcept
+        : elementsLeftToPush(bound), elementsPushed(0), elementsPopped(0), bound(bound) {}
     AbstractConcurrentBoundedQueue(const AbstractConcurrentBoundedQueue &other) = delete;
     AbstractConcurrentBoundedQueue(AbstractConcurrentBoundedQueue &&other) = delete;
 
+    // The counters are updated before the element is enqueued: a consumer that gets woken up by the last element
+    // then knows right away that there is nothing left to wait for, instead of waiting for another timeout.
     inline void push(Elem &&elem, int count) noexcept {
-        _queue.enqueue(std::move(elem));
+        elementsPushed.fetch_add(1, std::memory_order_release);
         elementsLeftToPush.fetch_add(-count, std::memory_order_release);
         ENFORCE(elementsLeftToPush.load(std::memory_order_relaxed) >= 0);
+        _queue.enqueue(std::move(elem));
     }
 
     inline DequeueResult try_pop(Elem &elem) noexcept {
         DequeueResult ret;
-        ret.shouldRetry = elementsLeftToPush.load(std::memory_order_acquire) != 0;
+        ret.shouldRetry = mightGetMore();
         ret.returned = _queue.try_dequeue(elem);
         if (ret.returned) {
-            elementsPopped.fetch_add(1, std::memory_order_relaxed);
+            elementsPopped.fetch_add(1, std::memory_order_release);
         }
         return ret;
     }
 
+    // Waits for an element for at most `timeout`. Only whoever gets an element is woken up by its push, so the wait is
+    // split into slices that start short and double, and it stops early once no more elements can come: otherwise,
+    // all but one of the threads waiting for the last element would sleep through the rest of their timeout.
     template <typename Rep, typename Period>
     inline DequeueResult wait_pop_timed(Elem &elem, std::chrono::duration<Rep, Period> const &timeout,
                                         spdlog::logger &log) noexcept {
         DequeueResult ret;
-        if (!sorbet::emscripten_build) {
-            ret.shouldRetry = elementsLeftToPush.load(std::memory_order_acquire) != 0;
+        if (sorbet::threads_supported) {
+            ret.shouldRetry = mightGetMore();
             if (ret.shouldRetry) {
                 sorbet::Timer time(log, "wait_pop_timed");
-                ret.returned = _queue.wait_dequeue_timed(elem, timeout);
+                auto left = std::chrono::duration_cast<std::chrono::microseconds>(timeout);
+                std::chrono::microseconds slice(500);
+                while (!(ret.returned = _queue.wait_dequeue_timed(elem, std::min(slice, left)))) {
+                    left -= std::min(slice, left);
+                    if (left.count() <= 0 || !mightGetMore()) {
+                        ret.shouldRetry = mightGetMore();
+                        break;
+                    }
+                    slice *= 2;
+                }
             } else { // all elements has been pushed, no need to wait.
                 ret.returned = _queue.try_dequeue(elem);
             }
             if (ret.returned) {
-                elementsPopped.fetch_add(1, std::memory_order_relaxed);
+                elementsPopped.fetch_add(1, std::memory_order_release);
             }
             return ret;
         }
@@ -94,6 +117,12 @@ public:
 template <class Elem>
 using BlockingBoundedQueue = AbstractConcurrentBoundedQueue<Elem, moodycamel::BlockingConcurrentQueue<Elem>>;
 
+template <class Elem>
+class BlockingUnBoundedQueue : public AbstractConcurrentBoundedQueue<Elem, moodycamel::BlockingConcurrentQueue<Elem>> {
+public:
+    BlockingUnBoundedQueue() : AbstractConcurrentBoundedQueue<Elem, moodycamel::BlockingConcurrentQueue<Elem>>(INT_MAX){};
+};
+
 #ifdef _MACH_BOOLEAN_H_
 // on mac, system headers define FALSE and TRUE as macros. Undefine them so that they don't break parser.
 #undef TRUE
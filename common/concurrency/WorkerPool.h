@@ -1,10 +1,13 @@
 #ifndef SORBET_WORKERPOOL_H
 #define SORBET_WORKERPOOL_H
 
+#include "common/Counters.h"
 #include "common/common.h"
 #include "spdlog/spdlog.h"
 namespace spd = spdlog;
 namespace sorbet {
+class TaskGroup;
+
 class WorkerPool {
 public:
     inline static constexpr std::chrono::milliseconds BLOCK_INTERVAL() {
@@ -12,8 +15,31 @@ public:
         return 250ms;
     }
     typedef std::function<void()> Task;
-    static std::unique_ptr<WorkerPool> create(int size, spd::logger &logger);
-    virtual void multiplexJob(std::string_view taskName, Task t) = 0;
+    // With `pinThreads`, every worker stays on a core of its own, and workers fill up the cores of one NUMA node
+    // before using the next one, so that they share as much of their caches as possible. Threads are also pinned when
+    // there are as many as cores.
+    static std::unique_ptr<WorkerPool> create(int size, spd::logger &logger, bool pinThreads = false);
+    // Runs `t` on every worker. Each worker records how long it waited for the job to start, how long it ran it, how
+    // much of that it spent on a CPU, and the last one how long it kept running after the first was done: prod
+    // counters in the workers.* categories, by `taskName`, and a span in the web trace. reportUsage hands them over.
+    virtual void multiplexJob(ConstExprStr taskName, Task t) = 0;
+    // Like multiplexJob, for a job that works through `items` items of about the same cost: it runs on no more
+    // workers than the items keep busy, judging by the CPU time an item took in the last jobs of the same name, and on
+    // the calling thread if that's no more than one. Until a job of that name has finished, every item is assumed to
+    // be worth a worker of its own.
+    virtual void multiplexJob(ConstExprStr taskName, size_t items, Task t) = 0;
+    // Waits for the workers to have recorded the usage of every job they ran, and adds it to the calling thread's
+    // counters. Call it once the results of those jobs are in, e.g. before reporting metrics.
+    virtual void reportUsage() = 0;
+
+    // Tasks added to a group can run on any worker, and idle workers steal them from busy ones. Whoever waits for the
+    // group runs its tasks too, so a job already running on a worker can start a group of its own (e.g. to check the
+    // methods of a big file in parallel) without needing more threads.
+    virtual std::unique_ptr<TaskGroup> taskGroup(std::string_view taskName) = 0;
+
+    // Calls `body` on every index in [0, size) from a task group, a chunk of indices per task, and returns once all
+    // of them are done.
+    virtual void parallelFor(std::string_view taskName, size_t size, std::function<void(size_t)> body) = 0;
     virtual ~WorkerPool() = 0;
     WorkerPool() = default;
     WorkerPool(WorkerPool &) = delete;
@@ -21,5 +47,14 @@ public:
     WorkerPool &operator=(WorkerPool &&) = delete;
     WorkerPool &operator=(const WorkerPool &) = delete;
 };
+
+class TaskGroup {
+public:
+    virtual void run(WorkerPool::Task task) = 0;
+    // Returns once every task of the group ran, and rethrows the first exception one of them threw, if any.
+    virtual void wait() = 0;
+    // Waits for the tasks still running, as they might reference their creator's stack.
+    virtual ~TaskGroup() = default;
+};
 };     // namespace sorbet
 #endif // SORBET_WORKERPOOL_H
@@ -1,36 +1,151 @@
 #include "common/concurrency/WorkerPoolImpl.h"
 #include "absl/strings/str_cat.h"
+#include "common/Timer.h"
 #include "common/concurrency/WorkerPool.h"
+#include <chrono>
+#include <cmath>
+#include <optional>
 
 using namespace std;
 namespace sorbet {
-unique_ptr<WorkerPool> WorkerPool::create(int size, spd::logger &logger) {
-    return make_unique<WorkerPoolImpl>(size, logger);
+namespace {
+// Which worker of which pool the current thread is, if any.
+thread_local const WorkerPoolImpl *currentPool = nullptr;
+thread_local int currentWorker = -1;
+
+// The least CPU time worth handing to a worker of its own, rather than to one that's already running the job.
+constexpr double MIN_MICROS_PER_WORKER = 10000;
+
+// How the workers running one multiplexJob spent it. Shared by them, so that the last one to finish can tell how long
+// it kept running after the first one was done.
+struct JobUsage {
+    const ConstExprStr taskName;
+    const chrono::steady_clock::time_point enqueued;
+    mutex mtx;
+    int running;
+    optional<chrono::steady_clock::time_point> firstDone;
+    // Set for jobs that told how many items they work through, so that the pool learns what an item costs.
+    WorkerPoolImpl *const pool;
+    const size_t items;
+    long cpu = 0;
+
+    JobUsage(ConstExprStr taskName, int workers, WorkerPoolImpl *pool, size_t items)
+        : taskName(taskName), enqueued(chrono::steady_clock::now()), running(workers), pool(pool), items(items) {}
+};
+
+long micros(chrono::steady_clock::duration duration) {
+    return chrono::duration_cast<chrono::microseconds>(duration).count();
+}
+
+void runAndRecordUsage(JobUsage &job, const WorkerPool::Task &t) {
+    auto start = chrono::steady_clock::now();
+    auto cpuBefore = currentThreadCpuMicros();
+    t();
+    auto end = chrono::steady_clock::now();
+    long cpu = currentThreadCpuMicros() - cpuBefore;
+    long wall = micros(end - start);
+    long waited = micros(start - job.enqueued);
+    prodCategoryCounterAdd("workers.queue_wait_us", job.taskName, waited);
+    prodCategoryCounterAdd("workers.wall_us", job.taskName, wall);
+    prodCategoryCounterAdd("workers.cpu_us", job.taskName, cpu);
+    // Time off the CPU: mostly spent waiting for work, or for what other workers were computing.
+    prodCategoryCounterAdd("workers.idle_us", job.taskName, max(0L, wall - cpu));
+    {
+        lock_guard<mutex> lock(job.mtx);
+        if (!job.firstDone.has_value()) {
+            job.firstDone = end;
+        }
+        job.cpu += cpu;
+        if (--job.running == 0) {
+            prodCategoryCounterAdd("workers.straggler_us", job.taskName, micros(end - *job.firstDone));
+            if (job.pool != nullptr && job.items > 0) {
+                job.pool->recordItemCost(job.taskName, job.cpu, job.items);
+            }
+        }
+    }
+    vector<pair<ConstExprStr, string>> args;
+    if (Timer::spanArgsEnabled()) {
+        args.emplace_back("task", string(job.taskName.str, job.taskName.size));
+        args.emplace_back("cpu_ms", to_string(cpu / 1000));
+        args.emplace_back("queue_wait_ms", to_string(waited / 1000));
+    }
+    timingAdd("multiplexJob", start, end, move(args), FlowId{0}, FlowId{0});
+}
+
+class TaskGroupImpl final : public TaskGroup {
+    WorkerPoolImpl &workers;
+    shared_ptr<WorkerPoolImpl::GroupState> state;
+
+public:
+    TaskGroupImpl(WorkerPoolImpl &workers, string_view taskName)
+        : workers(workers), state(make_shared<WorkerPoolImpl::GroupState>()) {
+        state->taskName = taskName;
+    }
+
+    void run(WorkerPool::Task task) override {
+        workers.spawn(state, move(task));
+    }
+
+    void wait() override {
+        workers.waitFor(*state);
+        exception_ptr error;
+        {
+            lock_guard<mutex> lock(state->errorMtx);
+            swap(error, state->error);
+        }
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+    ~TaskGroupImpl() override {
+        workers.waitFor(*state);
+    }
+};
+} // namespace
+
+unique_ptr<WorkerPool> WorkerPool::create(int size, spd::logger &logger, bool pinThreads) {
+    return make_unique<WorkerPoolImpl>(size, logger, pinThreads);
 }
 
 WorkerPool::~WorkerPool() {
     // see https://eli.thegreenplace.net/2010/11/13/pure-virtual-destructors-in-c
 }
 
-WorkerPoolImpl::WorkerPoolImpl(int size, spd::logger &logger) : size(size), logger(logger) {
+WorkerPoolImpl::WorkerPoolImpl(int size, spd::logger &logger, bool pinThreads) : size(size), logger(logger) {
     logger.debug("Creating {} worker threads", size);
-    if (sorbet::emscripten_build) {
+    if (!sorbet::threads_supported) {
         ENFORCE(size == 0);
         this->size = 0;
     } else {
-        bool pinThreads = (size > 0) && (size == thread::hardware_concurrency());
+        pinThreads = (size > 0) && (pinThreads || size == thread::hardware_concurrency());
+        vector<int> cores;
+        if (pinThreads) {
+            cores = coresInNumaOrder();
+            if (cores.empty()) {
+                for (int core = 0; core < thread::hardware_concurrency(); core++) {
+                    cores.emplace_back(core);
+                }
+            }
+            logger.debug("Pinning worker threads to cores {}", fmt::join(cores.begin(), cores.end(), ","));
+        }
         threadQueues.reserve(size);
+        for (int i = 0; i < size; i++) {
+            asked.emplace_back(make_unique<atomic<bool>>(false));
+        }
         for (int i = 0; i < size; i++) {
             auto &last = threadQueues.emplace_back(make_unique<Queue>());
             auto *ptr = last.get();
             auto threadIdleName = absl::StrCat("idle", i + 1);
             optional<int> pinToCore;
-            if (pinThreads) {
-                pinToCore = i;
+            if (pinThreads && !cores.empty()) {
+                pinToCore = cores[i % cores.size()];
             }
             threads.emplace_back(runInAThread(
                 threadIdleName,
-                [ptr, &logger, threadIdleName]() {
+                [this, i, ptr, &logger, threadIdleName]() {
+                    currentPool = this;
+                    currentWorker = i;
                     bool repeat = true;
                     while (repeat) {
                         Task_ task;
@@ -43,36 +158,215 @@ WorkerPoolImpl::WorkerPoolImpl(int size, spd::logger &logger) : size(size), logg
                 pinToCore));
         }
     }
+    for (int i = 0; i <= this->size; i++) {
+        taskDeques.emplace_back(make_unique<TaskDeque>());
+    }
     logger.debug("Worker threads created");
 }
 
 WorkerPoolImpl::~WorkerPoolImpl() {
     auto &logger = this->logger;
-    multiplexJob_([&logger]() {
-        logger.debug("Killing worker thread");
-        return false;
-    });
-    // join will be called when destructing joinable;
+    multiplexJob_(
+        [&logger]() {
+            logger.debug("Killing worker thread");
+            return false;
+        },
+        size);
+    // Join before the task deques go away, as workers might still be looking for tasks in them.
+    threads.clear();
 }
 
-void WorkerPoolImpl::multiplexJob(string_view taskName, WorkerPool::Task t) {
-    if (size > 0) {
-        multiplexJob_([t{move(t)}, taskName] {
-            setCurrentThreadName(taskName);
-            t();
-            return true;
-        });
+void WorkerPoolImpl::multiplexJob(ConstExprStr taskName, WorkerPool::Task t) {
+    multiplexJobOn(taskName, move(t), size, 0);
+}
+
+void WorkerPoolImpl::multiplexJob(ConstExprStr taskName, size_t items, WorkerPool::Task t) {
+    double workers = min<size_t>(size, items);
+    {
+        lock_guard<mutex> lock(usageMtx);
+        auto fnd = microsPerItem.find(string_view(taskName.str, taskName.size));
+        if (fnd != microsPerItem.end()) {
+            workers = min(workers, ceil(items * fnd->second / MIN_MICROS_PER_WORKER));
+        }
+    }
+    // A single worker would only leave the calling thread waiting for it; the job is better off run right here.
+    int used = workers > 1 ? (int)workers : 0;
+    if (used < size) {
+        prodCategoryCounterAdd("workers.left_out", taskName, size - used);
+    }
+    multiplexJobOn(taskName, move(t), used, items);
+}
+
+void WorkerPoolImpl::multiplexJobOn(ConstExprStr taskName, WorkerPool::Task t, int workers, size_t items) {
+    auto job = make_shared<JobUsage>(taskName, max(workers, 1), this, items);
+    if (workers > 0) {
+        {
+            lock_guard<mutex> lock(usageMtx);
+            usagePending += workers;
+        }
+        multiplexJob_(
+            [this, t{move(t)}, job] {
+                setCurrentThreadName(string_view(job->taskName.str, job->taskName.size));
+                runAndRecordUsage(*job, t);
+                // Jobs hand back their counters before they return, so what is left is the usage.
+                recordUsage(getAndClearThreadCounters());
+                return true;
+            },
+            workers);
     } else {
         // main thread is the worker.
-        t();
+        runAndRecordUsage(*job, t);
+    }
+}
+
+void WorkerPoolImpl::recordItemCost(ConstExprStr taskName, long cpuMicros, size_t items) {
+    double cost = (double)cpuMicros / items;
+    lock_guard<mutex> lock(usageMtx);
+    auto [it, inserted] = microsPerItem.try_emplace(string(taskName.str, taskName.size), cost);
+    if (!inserted) {
+        // Runs of a job differ (LSP's fast path typechecks one file, the slow path all of them), so the estimate
+        // follows the recent ones.
+        it->second = (it->second + cost) / 2;
     }
 }
 
-void WorkerPoolImpl::multiplexJob_(WorkerPoolImpl::Task_ t) {
+void WorkerPoolImpl::recordUsage(CounterState counters) {
+    lock_guard<mutex> lock(usageMtx);
+    usage.emplace_back(move(counters));
+    usagePending--;
+    usageRecorded.notify_all();
+}
+
+void WorkerPoolImpl::reportUsage() {
+    vector<CounterState> recorded;
+    {
+        unique_lock<mutex> lock(usageMtx);
+        usageRecorded.wait(lock, [this]() { return usagePending == 0; });
+        swap(recorded, usage);
+    }
+    for (auto &counters : recorded) {
+        counterConsume(move(counters));
+    }
+}
+
+void WorkerPoolImpl::multiplexJob_(WorkerPoolImpl::Task_ t, int workers) {
     logger.debug("Multiplexing job");
-    for (int i = 0; i < size; i++) {
+    for (int i = 0; i < workers; i++) {
         threadQueues[i]->enqueue(t);
     }
 }
 
+unique_ptr<TaskGroup> WorkerPoolImpl::taskGroup(string_view taskName) {
+    return make_unique<TaskGroupImpl>(*this, taskName);
+}
+
+void WorkerPoolImpl::parallelFor(string_view taskName, size_t size, function<void(size_t)> body) {
+    // A few chunks per thread, so that stealing can even out chunks that take longer than others.
+    const size_t chunks = 8 * (this->size + 1);
+    const size_t chunkSize = max<size_t>(1, (size + chunks - 1) / chunks);
+    TaskGroupImpl group(*this, taskName);
+    for (size_t begin = 0; begin < size; begin += chunkSize) {
+        auto end = min(size, begin + chunkSize);
+        group.run([&body, begin, end]() {
+            for (size_t i = begin; i < end; i++) {
+                body(i);
+            }
+        });
+    }
+    group.wait();
+}
+
+int WorkerPoolImpl::currentDeque() const {
+    return currentPool == this ? currentWorker : this->size;
+}
+
+void WorkerPoolImpl::spawn(const shared_ptr<GroupState> &group, Task task) {
+    group->pending.fetch_add(1);
+    {
+        auto &deque = *taskDeques[currentDeque()];
+        lock_guard<mutex> lock(deque.mtx);
+        deque.tasks.push_back(StealableTask{move(task), group});
+    }
+    spawned.fetch_add(1);
+    wakeWaiters();
+    for (int i = 0; i < size; i++) {
+        if (i == currentWorker && currentPool == this) {
+            continue;
+        }
+        if (!asked[i]->exchange(true)) {
+            threadQueues[i]->enqueue([this, i]() {
+                asked[i]->store(false);
+                while (runOneTask(i)) {
+                }
+                return true;
+            });
+        }
+    }
+}
+
+bool WorkerPoolImpl::runOneTask(int self) {
+    optional<StealableTask> next;
+    const int deques = taskDeques.size();
+    for (int offset = 0; offset < deques && !next.has_value(); offset++) {
+        auto &deque = *taskDeques[(self + offset) % deques];
+        lock_guard<mutex> lock(deque.mtx);
+        if (deque.tasks.empty()) {
+            continue;
+        }
+        if (offset == 0) {
+            next = move(deque.tasks.back());
+            deque.tasks.pop_back();
+        } else {
+            next = move(deque.tasks.front());
+            deque.tasks.pop_front();
+        }
+    }
+    if (!next.has_value()) {
+        return false;
+    }
+    auto &group = *next->group;
+    if (currentPool == this) {
+        setCurrentThreadName(group.taskName);
+    }
+    try {
+        next->task();
+    } catch (...) {
+        lock_guard<mutex> lock(group.errorMtx);
+        if (!group.error) {
+            group.error = current_exception();
+        }
+    }
+    if (group.pending.fetch_sub(1) == 1) {
+        wakeWaiters();
+    }
+    return true;
+}
+
+void WorkerPoolImpl::wakeWaiters() {
+    if (sleepingWaiters.load() == 0) {
+        return;
+    }
+    // Taking the lock makes sure a waiter that is about to sleep either sees the change or gets the notification.
+    {
+        lock_guard<mutex> lock(waitMtx);
+    }
+    tasksChanged.notify_all();
+}
+
+void WorkerPoolImpl::waitFor(GroupState &group) {
+    auto self = currentDeque();
+    while (group.pending.load() > 0) {
+        auto seen = spawned.load();
+        // Tasks of other groups might run in the meantime, but no thread ever sits idle while there is work left.
+        if (runOneTask(self)) {
+            continue;
+        }
+        // Every task left in the group is running on some other thread.
+        unique_lock<mutex> lock(waitMtx);
+        sleepingWaiters.fetch_add(1);
+        tasksChanged.wait(lock, [&]() -> bool { return group.pending.load() == 0 || spawned.load() != seen; });
+        sleepingWaiters.fetch_sub(1);
+    }
+}
+
 }; // namespace sorbet
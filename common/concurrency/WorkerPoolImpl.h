@@ -5,7 +5,10 @@
 #include "common/concurrency/WorkerPool.h"
 #include "common/os/os.h"
 #include "spdlog/spdlog.h"
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 namespace spd = spdlog;
 namespace sorbet {
@@ -83,13 +86,65 @@ class WorkerPoolImpl : public WorkerPool {
     std::vector<std::unique_ptr<Joinable>> threads;
     spd::logger &logger;
 
-    void multiplexJob_(Task_ t);
+public:
+    struct GroupState {
+        std::string_view taskName;
+        std::atomic<int> pending{0};
+        std::mutex errorMtx;
+        std::exception_ptr error;
+    };
+
+private:
+    struct StealableTask {
+        Task task;
+        std::shared_ptr<GroupState> group;
+    };
+    // One per worker, plus a last one shared by the threads outside the pool. A worker takes the tasks it added
+    // itself from the back, and steals from the front of others'.
+    struct TaskDeque {
+        std::mutex mtx;
+        std::deque<StealableTask> tasks;
+    };
+    std::vector<std::unique_ptr<TaskDeque>> taskDeques;
+    // Whether a worker already has a request to look for tasks in its queue. There's never more than one, as the
+    // queues only hold very few elements.
+    std::vector<std::unique_ptr<std::atomic<bool>>> asked;
+    // Threads in waitFor that found nothing to steal sleep on `tasksChanged` until a task is spawned or a group they
+    // might be waiting for is done. `spawned` counts spawned tasks, so that a waiter can tell new ones came in.
+    std::mutex waitMtx;
+    std::condition_variable tasksChanged;
+    std::atomic<u8> spawned{0};
+    std::atomic<int> sleepingWaiters{0};
+
+    // The counters workers recorded about the jobs they finished, after those jobs handed back their own.
+    std::mutex usageMtx;
+    std::condition_variable usageRecorded;
+    // Workers that are yet to record the usage of a job they were handed. Guarded by usageMtx.
+    int usagePending = 0;
+    std::vector<CounterState> usage;
+    // How many microseconds of CPU an item took in the recent jobs of each name. Guarded by usageMtx.
+    UnorderedMap<std::string, double> microsPerItem;
+
+    void multiplexJob_(Task_ t, int workers);
+    void multiplexJobOn(ConstExprStr taskName, Task t, int workers, size_t items);
+    int currentDeque() const;
+    bool runOneTask(int self);
+    void wakeWaiters();
 
 public:
-    WorkerPoolImpl(int size, spd::logger &logger);
+    WorkerPoolImpl(int size, spd::logger &logger, bool pinThreads);
     ~WorkerPoolImpl();
 
-    void multiplexJob(std::string_view taskName, Task t) override;
+    void multiplexJob(ConstExprStr taskName, Task t) override;
+    void multiplexJob(ConstExprStr taskName, size_t items, Task t) override;
+    void reportUsage() override;
+    std::unique_ptr<TaskGroup> taskGroup(std::string_view taskName) override;
+    void parallelFor(std::string_view taskName, size_t size, std::function<void(size_t)> body) override;
+
+    void spawn(const std::shared_ptr<GroupState> &group, Task task);
+    void recordUsage(CounterState counters);
+    void recordItemCost(ConstExprStr taskName, long cpuMicros, size_t items);
+    void waitFor(GroupState &group);
 };
 };     // namespace sorbet
 #endif // SORBET_WORKERPOOL_IMPL_H
@@ -1,11 +1,18 @@
 #include "common/kvstore/KeyValueStore.h"
+#include "absl/strings/str_cat.h"
+#include "common/Counters.h"
 
+#include <algorithm>
 #include <utility>
 
 using namespace std;
 namespace sorbet {
 constexpr string_view OLD_VERSION_KEY = "VERSION"sv;
 constexpr string_view VERSION_KEY = "DB_FORMAT_VERSION"sv;
+// Lives in the generations database, next to the per-key stamps.
+constexpr string_view GENERATION_KEY = "CURRENT_GENERATION"sv;
+// Eviction frees a little more than strictly needed so that a cache at its cap isn't compacted on every run.
+constexpr size_t EVICTION_TARGET_PERCENT = 75;
 constexpr size_t MAX_DB_SIZE_BYTES =
     1L * 1024 * 1024 * 1024; // 1G. This is both maximum fs db size and max virtual memory usage.
 
@@ -14,8 +21,10 @@ static void throw_mdb_error(string_view what, int err) {
     throw invalid_argument(string(what));
 }
 
-KeyValueStore::KeyValueStore(string version, string path, string flavor)
-    : path(move(path)), flavor(move(flavor)), writerId(this_thread::get_id()) {
+KeyValueStore::KeyValueStore(string version, string path, string flavor, size_t maxSizeBytes,
+                             unique_ptr<RemoteCache> remote)
+    : version(move(version)), path(move(path)), flavor(move(flavor)), writerId(this_thread::get_id()),
+      maxSizeBytes(maxSizeBytes), remote(move(remote)) {
     int rc;
     rc = mdb_env_create(&env);
     if (rc != 0) {
@@ -25,7 +34,7 @@ KeyValueStore::KeyValueStore(string version, string path, string flavor)
     if (rc != 0) {
         goto fail;
     }
-    rc = mdb_env_set_maxdbs(env, 3);
+    rc = mdb_env_set_maxdbs(env, 6);
     if (rc != 0) {
         goto fail;
     }
@@ -39,10 +48,23 @@ KeyValueStore::KeyValueStore(string version, string path, string flavor)
             clear();
         }
         auto dbVersion = readString(VERSION_KEY);
-        if (dbVersion != version) {
+        if (dbVersion != this->version) {
             clear();
-            writeString(VERSION_KEY, version);
+            writeString(VERSION_KEY, this->version);
         }
+        MDB_val kv;
+        kv.mv_size = GENERATION_KEY.size();
+        kv.mv_data = (void *)GENERATION_KEY.data();
+        MDB_val dv;
+        rc = mdb_get(txn, generationsDbi, &kv, &dv);
+        if (rc == 0) {
+            if (dv.mv_size == sizeof(generation)) {
+                memcpy(&generation, dv.mv_data, sizeof(generation));
+            }
+        } else if (rc != MDB_NOTFOUND) {
+            goto fail;
+        }
+        generation++;
         return;
     }
 fail:
@@ -74,6 +96,25 @@ void KeyValueStore::write(string_view key, const vector<u1> &value) {
     if (rc != 0) {
         throw invalid_argument("failed write into database");
     }
+    recordAccess(key);
+}
+
+void KeyValueStore::writeShared(string_view key, const vector<u1> &value) {
+    write(key, value);
+    if (remote != nullptr) {
+        written.emplace(key);
+    }
+}
+
+void KeyValueStore::setRemoteScope(string scope) {
+    remoteScope = move(scope);
+}
+
+u1 *KeyValueStore::readShared(string_view key) {
+    if (auto *local = read(key)) {
+        return local;
+    }
+    return readRemote(key);
 }
 
 u1 *KeyValueStore::read(string_view key) {
@@ -109,6 +150,7 @@ u1 *KeyValueStore::read(string_view key) {
         }
         throw_mdb_error("failed read from the database"sv, rc);
     }
+    recordAccess(key);
     return (u1 *)data.mv_data;
 }
 
@@ -120,6 +162,10 @@ void KeyValueStore::clear() {
     if (rc != 0) {
         goto fail;
     }
+    rc = mdb_drop(txn, generationsDbi, 0);
+    if (rc != 0) {
+        goto fail;
+    }
     rc = mdb_txn_commit(txn);
     if (rc != 0) {
         goto fail;
@@ -130,8 +176,8 @@ fail:
     throw_mdb_error("failed to clear the database"sv, rc);
 }
 
-string_view KeyValueStore::readString(string_view key) {
-    auto rawData = read(key);
+namespace {
+string_view decodeString(const u1 *rawData) {
     if (!rawData) {
         return string_view();
     }
@@ -140,6 +186,15 @@ string_view KeyValueStore::readString(string_view key) {
     string_view result(((const char *)rawData) + sizeof(sz), sz);
     return result;
 }
+} // namespace
+
+string_view KeyValueStore::readString(string_view key) {
+    return decodeString(read(key));
+}
+
+string_view KeyValueStore::readSharedString(string_view key) {
+    return decodeString(readShared(key));
+}
 
 void KeyValueStore::writeString(string_view key, string_view value) {
     vector<u1> rawData(value.size() + sizeof(size_t));
@@ -161,6 +216,10 @@ void KeyValueStore::refreshMainTransaction() {
     if (rc != 0) {
         goto fail;
     }
+    rc = mdb_dbi_open(txn, (flavor + ".generations").c_str(), MDB_CREATE, &generationsDbi);
+    if (rc != 0) {
+        goto fail;
+    }
     // Per the docs for mdb_dbi_open:
     //
     // The database handle will be private to the current transaction
@@ -190,8 +249,182 @@ fail:
     throw_mdb_error("failed to create transaction"sv, rc);
 }
 
+void KeyValueStore::recordAccess(string_view key) {
+    absl::MutexLock lk(&accessed_mtx);
+    if (!accessed.contains(key)) {
+        accessed.emplace(key);
+    }
+}
+
+void KeyValueStore::writeGenerations() {
+    MDB_val kv;
+    MDB_val dv;
+    dv.mv_size = sizeof(generation);
+    dv.mv_data = (void *)&generation;
+    int rc = 0;
+    for (auto &key : accessed) {
+        kv.mv_size = key.size();
+        kv.mv_data = (void *)key.data();
+        rc = mdb_put(txn, generationsDbi, &kv, &dv, 0);
+        if (rc != 0) {
+            throw_mdb_error("failed to record key generation"sv, rc);
+        }
+    }
+    kv.mv_size = GENERATION_KEY.size();
+    kv.mv_data = (void *)GENERATION_KEY.data();
+    rc = mdb_put(txn, generationsDbi, &kv, &dv, 0);
+    if (rc != 0) {
+        throw_mdb_error("failed to record generation"sv, rc);
+    }
+}
+
+size_t KeyValueStore::usedBytes() {
+    size_t used = 0;
+    for (auto db : {dbi, generationsDbi}) {
+        MDB_stat stat;
+        int rc = mdb_stat(txn, db, &stat);
+        if (rc != 0) {
+            throw_mdb_error("failed to measure the database"sv, rc);
+        }
+        used += (size_t)stat.ms_psize * (stat.ms_branch_pages + stat.ms_leaf_pages + stat.ms_overflow_pages);
+    }
+    return used;
+}
+
+void KeyValueStore::evictOldGenerations() {
+    auto used = usedBytes();
+    if (used <= maxSizeBytes) {
+        return;
+    }
+
+    struct Candidate {
+        u4 generation;
+        size_t bytes;
+        string key;
+    };
+    vector<Candidate> candidates;
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn, dbi, &cursor);
+    if (rc != 0) {
+        throw_mdb_error("failed to open a cursor"sv, rc);
+    }
+    MDB_val kv;
+    MDB_val dv;
+    for (rc = mdb_cursor_get(cursor, &kv, &dv, MDB_FIRST); rc == 0; rc = mdb_cursor_get(cursor, &kv, &dv, MDB_NEXT)) {
+        string_view key((const char *)kv.mv_data, kv.mv_size);
+        if (key == VERSION_KEY) {
+            continue;
+        }
+        // Entries written before generations were tracked count as the oldest.
+        u4 keyGeneration = 0;
+        MDB_val gv;
+        if (mdb_get(txn, generationsDbi, &kv, &gv) == 0 && gv.mv_size == sizeof(keyGeneration)) {
+            memcpy(&keyGeneration, gv.mv_data, sizeof(keyGeneration));
+        }
+        if (keyGeneration == generation) {
+            continue;
+        }
+        candidates.push_back(Candidate{keyGeneration, kv.mv_size + dv.mv_size, string(key)});
+    }
+    mdb_cursor_close(cursor);
+    if (rc != MDB_NOTFOUND) {
+        throw_mdb_error("failed to scan the database"sv, rc);
+    }
+
+    fast_sort(candidates, [](const auto &l, const auto &r) -> bool { return l.generation < r.generation; });
+    const size_t targetBytes = maxSizeBytes / 100 * EVICTION_TARGET_PERCENT;
+    size_t evicted = 0;
+    for (auto &candidate : candidates) {
+        if (used <= targetBytes) {
+            break;
+        }
+        kv.mv_size = candidate.key.size();
+        kv.mv_data = (void *)candidate.key.data();
+        rc = mdb_del(txn, dbi, &kv, nullptr);
+        if (rc == 0) {
+            rc = mdb_del(txn, generationsDbi, &kv, nullptr);
+        }
+        if (rc != 0 && rc != MDB_NOTFOUND) {
+            throw_mdb_error("failed to evict an entry"sv, rc);
+        }
+        used -= min(used, candidate.bytes);
+        evicted++;
+    }
+    prodCounterAdd("cache.evicted", evicted);
+}
+
+string KeyValueStore::remoteKey(string_view key) const {
+    // A remote cache is shared by every version, flavor and state, so they are part of the key.
+    return absl::StrCat(version, "\n", flavor, "\n", remoteScope, "\n", key);
+}
+
+u1 *KeyValueStore::readRemote(string_view key) {
+    if (remote == nullptr || remoteScope.empty()) {
+        return nullptr;
+    }
+    {
+        absl::ReaderMutexLock lk(&fetched_mtx);
+        auto fnd = fetched.find(key);
+        if (fnd != fetched.end()) {
+            return fnd->second->data();
+        }
+    }
+    auto value = remote->read(remoteKey(key));
+    if (!value.has_value()) {
+        prodCounterInc("cache.remote.miss");
+        return nullptr;
+    }
+    prodCounterInc("cache.remote.hit");
+    recordAccess(key);
+    absl::WriterMutexLock lk(&fetched_mtx);
+    // Another thread may have fetched the same key meanwhile; keep whichever got here first, as it may be in use.
+    auto &stored = fetched[string(key)];
+    if (stored == nullptr) {
+        stored = make_unique<vector<u1>>(move(*value));
+    }
+    return stored->data();
+}
+
+void KeyValueStore::syncRemote() {
+    MDB_val kv;
+    MDB_val dv;
+    int rc;
+    if (remoteScope.empty()) {
+        // Nothing says what the values written were pickled against, so they can only be decoded locally.
+        written.clear();
+    }
+    for (auto &key : written) {
+        kv.mv_size = key.size();
+        kv.mv_data = (void *)key.data();
+        rc = mdb_get(txn, dbi, &kv, &dv);
+        if (rc != 0) {
+            throw_mdb_error("failed read from the database"sv, rc);
+        }
+        auto *bytes = (const u1 *)dv.mv_data;
+        remote->write(remoteKey(key), vector<u1>(bytes, bytes + dv.mv_size));
+    }
+    absl::MutexLock lk(&fetched_mtx);
+    for (auto &[key, value] : fetched) {
+        kv.mv_size = key.size();
+        kv.mv_data = (void *)key.data();
+        dv.mv_size = value->size();
+        dv.mv_data = (void *)value->data();
+        rc = mdb_put(txn, dbi, &kv, &dv, 0);
+        if (rc != 0) {
+            throw_mdb_error("failed write into database"sv, rc);
+        }
+    }
+}
+
 bool KeyValueStore::commit(unique_ptr<KeyValueStore> k) {
     int rc;
+    if (k->remote != nullptr) {
+        k->syncRemote();
+    }
+    k->writeGenerations();
+    if (k->maxSizeBytes > 0) {
+        k->evictOldGenerations();
+    }
     k->commited = true;
     rc = mdb_txn_commit(k->txn);
 
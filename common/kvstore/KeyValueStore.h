@@ -2,6 +2,7 @@
 #define SORBET_KEYVALUESTORE_H
 #include "absl/synchronization/mutex.h"
 #include "common/common.h"
+#include "common/kvstore/RemoteCache.h"
 #include "lmdb.h"
 #include <thread>
 namespace sorbet {
@@ -14,16 +15,37 @@ namespace sorbet {
 class KeyValueStore {
     MDB_env *env;
     MDB_dbi dbi;
+    // Maps every key of `dbi` to the generation (the number of the run) that last read or wrote it.
+    MDB_dbi generationsDbi;
     MDB_txn *txn;
+    const std::string version;
     const std::string path;
     const std::string flavor;
     const std::thread::id writerId;
     UnorderedMap<std::thread::id, MDB_txn *> readers;
     absl::Mutex readers_mtx;
     bool commited = false;
+    const size_t maxSizeBytes;
+    u4 generation = 0;
+    UnorderedSet<std::string> accessed;
+    absl::Mutex accessed_mtx;
+    const std::unique_ptr<RemoteCache> remote;
+    // Values that missed locally but were found in `remote`. They are copied into the database on `commit`.
+    UnorderedMap<std::string, std::unique_ptr<std::vector<u1>>> fetched;
+    absl::Mutex fetched_mtx;
+    // Keys written through `writeShared`, which `commit` uploads to `remote`.
+    UnorderedSet<std::string> written;
+    // Identifies the state that shared values are pickled against and decoded with. Empty while nothing is shared.
+    std::string remoteScope;
 
     void clear();
     void refreshMainTransaction();
+    void recordAccess(std::string_view key);
+    void writeGenerations();
+    void evictOldGenerations();
+    std::string remoteKey(std::string_view key) const;
+    u1 *readRemote(std::string_view key);
+    void syncRemote();
 
 public:
     /**
@@ -42,14 +64,42 @@ public:
      * other options that may affect the cached data. Two
      * `KeyValueStore`s opened with different `flavor`s will not share
      * any entries, but each will see their own set of values.
+     *
+     * Each time a store is opened counts as a new generation, and
+     * every key that gets read or written is stamped with it on
+     * `commit`. If `maxSizeBytes` is non-zero and the database has
+     * outgrown it, `commit` first evicts the entries that went unused
+     * for the most generations, leaving the ones the current
+     * generation touched alone.
+     *
+     * With a `remote`, `readShared` retries the reads that miss
+     * locally there, and `commit` copies what they found into the
+     * local database and uploads everything `writeShared` wrote. Only
+     * values that their key and the remote scope fully determine may
+     * be shared; see `setRemoteScope`.
      */
-    KeyValueStore(std::string version, std::string path, std::string flavor);
+    KeyValueStore(std::string version, std::string path, std::string flavor, size_t maxSizeBytes = 0,
+                  std::unique_ptr<RemoteCache> remote = nullptr);
     /** returns nullptr if not found*/
     u1 *read(std::string_view key);
     std::string_view readString(std::string_view key);
     void writeString(std::string_view key, std::string_view value);
     /** can only be called from main thread */
     void write(std::string_view key, const std::vector<u1> &value);
+    /** Like `read`, but also looks in `remote` if the key isn't found locally */
+    u1 *readShared(std::string_view key);
+    std::string_view readSharedString(std::string_view key);
+    /** Like `write`, but also uploads the value to `remote` on `commit`. Can only be called from main thread */
+    void writeShared(std::string_view key, const std::vector<u1> &value);
+    /**
+     * Values pickled against a GlobalState refer to its names by id, so other machines may only decode them with the
+     * very same state. `scope` identifies that state, and is part of the remote key of every shared value: lookups
+     * use the scope set when they are made, and uploads the one set when `commit` makes them. While it is empty, as
+     * it starts out, nothing is read from or written to `remote`.
+     */
+    void setRemoteScope(std::string scope);
+    /** The bytes of the database file that hold data, as this store sees it. Can only be called from main thread */
+    size_t usedBytes();
     ~KeyValueStore() noexcept(false);
     static bool commit(std::unique_ptr<KeyValueStore>);
 };
@@ -0,0 +1,45 @@
+#include "common/kvstore/RemoteCache.h"
+#include "absl/strings/escaping.h"
+#include "common/FileOps.h"
+#include "common/crypto_hashing/crypto_hashing.h"
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+namespace sorbet {
+
+DirectoryRemoteCache::DirectoryRemoteCache(string path) : path(move(path)) {}
+
+string DirectoryRemoteCache::pathFor(string_view key) const {
+    // Keys can be long and contain slashes, so files are named after a hash of the key instead.
+    auto hash = crypto_hashing::hash64(key);
+    return fmt::format("{}/{}", path, absl::BytesToHexString(string_view{(char *)hash.data(), 32}));
+}
+
+optional<vector<u1>> DirectoryRemoteCache::read(string_view key) {
+    string contents;
+    try {
+        contents = FileOps::read(pathFor(key));
+    } catch (FileNotFoundException &) {
+        return nullopt;
+    }
+    return vector<u1>(contents.begin(), contents.end());
+}
+
+void DirectoryRemoteCache::write(string_view key, const vector<u1> &value) {
+    auto finalPath = pathFor(key);
+    auto tempPath =
+        fmt::format("{}.{}.{}.tmp", finalPath, getpid(), std::hash<thread::id>()(this_thread::get_id()));
+    FILE *fp = fopen(tempPath.c_str(), "wb");
+    if (!fp) {
+        return;
+    }
+    bool written = fwrite(value.data(), sizeof(u1), value.size(), fp) == value.size();
+    written = fclose(fp) == 0 && written;
+    if (!written || rename(tempPath.c_str(), finalPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+    }
+}
+
+} // namespace sorbet
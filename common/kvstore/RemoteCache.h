@@ -0,0 +1,37 @@
+#ifndef SORBET_REMOTECACHE_H
+#define SORBET_REMOTECACHE_H
+#include "common/common.h"
+#include <optional>
+
+namespace sorbet {
+
+/**
+ * A store shared between machines, which a KeyValueStore reads its shared values through to when its own database
+ * misses. Keys name everything their value depends on, including the state it was pickled against (see
+ * KeyValueStore::setRemoteScope), so implementations need no invalidation and may drop writes they fail to make. Both
+ * methods may be called from any thread.
+ */
+class RemoteCache {
+public:
+    virtual ~RemoteCache() = default;
+    virtual std::optional<std::vector<u1>> read(std::string_view key) = 0;
+    virtual void write(std::string_view key, const std::vector<u1> &value) = 0;
+};
+
+/**
+ * A RemoteCache kept in a directory, typically on a network mount, with one file per key. Files are written under a
+ * temporary name and renamed into place, so concurrent writers and readers never observe a partial value.
+ */
+class DirectoryRemoteCache final : public RemoteCache {
+    const std::string path;
+
+    std::string pathFor(std::string_view key) const;
+
+public:
+    explicit DirectoryRemoteCache(std::string path);
+    std::optional<std::vector<u1>> read(std::string_view key) override;
+    void write(std::string_view key, const std::vector<u1> &value) override;
+};
+} // namespace sorbet
+
+#endif // SORBET_REMOTECACHE_H
@@ -1,5 +1,6 @@
 #ifdef EMSCRIPTEN
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -15,4 +16,28 @@ bool setCurrentThreadName(string_view name) {
     return false;
 }
 
+vector<int> coresInNumaOrder() {
+    return {};
+}
+
+void adviseHugePages(void *ptr, size_t size) {}
+
+void prefaultPages(void *ptr, size_t size) {}
+
+long currentThreadCpuMicros() {
+    return 0;
+}
+
+size_t peakRssBytes() {
+    return 0;
+}
+
+size_t heapAllocatedBytes() {
+    return 0;
+}
+
+bool dumpHeapProfile(const std::string &path) {
+    return false;
+}
+
 #endif
@@ -5,8 +5,12 @@
 #include <csignal>
 #include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <malloc.h>
 #include <sstream>
 #include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -108,4 +112,93 @@ bool bindThreadToCore(pthread_t handle, int coreId) {
     int rc = pthread_setaffinity_np(handle, sizeof(cpu_set_t), &cpuset);
     return rc == 0;
 }
+
+vector<int> coresInNumaOrder() {
+    vector<int> cores;
+    for (int node = 0;; node++) {
+        // e.g. "0-23,48-71"
+        ifstream cpulist(fmt::format("/sys/devices/system/node/node{}/cpulist", node));
+        if (!cpulist) {
+            break;
+        }
+        string range;
+        while (getline(cpulist, range, ',')) {
+            int first, last;
+            auto matched = sscanf(range.c_str(), "%d-%d", &first, &last);
+            if (matched < 1) {
+                continue;
+            }
+            if (matched == 1) {
+                last = first;
+            }
+            for (int core = first; core <= last; core++) {
+                cores.emplace_back(core);
+            }
+        }
+    }
+    return cores;
+}
+
+void adviseHugePages(void *ptr, size_t size) {
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+}
+
+void prefaultPages(void *ptr, size_t size) {
+#ifdef MADV_POPULATE_WRITE // Linux 5.14+
+    madvise(ptr, size, MADV_POPULATE_WRITE);
+#endif
+}
+
+long currentThreadCpuMicros() {
+    rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+        return 0;
+    }
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1'000'000L + usage.ru_utime.tv_usec +
+           usage.ru_stime.tv_usec;
+}
+
+size_t peakRssBytes() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // Linux reports this in kilobytes.
+    return (size_t)usage.ru_maxrss * 1024;
+}
+
+// Only defined when we are linked against jemalloc, which keeps glibc's mallinfo from seeing the heap.
+extern "C" int mallctl(const char *name, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+    __attribute__((weak));
+
+size_t heapAllocatedBytes() {
+    if (mallctl != nullptr) {
+        // jemalloc only refreshes its statistics when the epoch is bumped.
+        uint64_t epoch = 1;
+        size_t len = sizeof(epoch);
+        mallctl("epoch", &epoch, &len, &epoch, len);
+        size_t allocated = 0;
+        len = sizeof(allocated);
+        if (mallctl("stats.allocated", &allocated, &len, nullptr, 0) != 0) {
+            return 0;
+        }
+        return allocated;
+    }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+bool dumpHeapProfile(const std::string &path) {
+    if (mallctl == nullptr) {
+        return false;
+    }
+    const char *filename = path.c_str();
+    return mallctl("prof.dump", nullptr, nullptr, &filename, sizeof(filename)) == 0;
+}
 #endif
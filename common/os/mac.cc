@@ -4,8 +4,11 @@
 #include <cstdio>
 #include <mach-o/dyld.h> /* _NSGetExecutablePath */
 
+#include <mach/mach.h>
+#include <malloc/malloc.h>
 #import <mach/thread_act.h>
 #include <string>
+#include <sys/resource.h>
 #include <sys/sysctl.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -87,4 +90,45 @@ bool bindThreadToCore(pthread_t handle, int coreId) {
     auto ret = thread_policy_set(mach_thread, THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, 1);
     return ret == 0;
 }
+
+vector<int> coresInNumaOrder() {
+    // Macs have a single NUMA node.
+    return {};
+}
+
+void adviseHugePages(void *ptr, size_t size) {}
+
+void prefaultPages(void *ptr, size_t size) {}
+
+long currentThreadCpuMicros() {
+    auto thread = mach_thread_self();
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    auto result = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    if (result != KERN_SUCCESS) {
+        return 0;
+    }
+    return (info.user_time.seconds + info.system_time.seconds) * 1'000'000L + info.user_time.microseconds +
+           info.system_time.microseconds;
+}
+
+size_t peakRssBytes() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // macOS reports this in bytes.
+    return usage.ru_maxrss;
+}
+
+size_t heapAllocatedBytes() {
+    malloc_statistics_t stats;
+    malloc_zone_statistics(nullptr, &stats);
+    return stats.size_in_use;
+}
+
+bool dumpHeapProfile(const std::string &path) {
+    return false;
+}
 #endif
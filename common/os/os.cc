@@ -21,9 +21,9 @@ void *Joinable::trampoline(void *ptr) {
 }
 
 unique_ptr<Joinable> runInAThread(string_view threadName, function<void()> function, optional<int> bindToCore) {
-#ifdef EMSCRIPTEN
-    sorbet::Exception::raise("Creating threads in unsupported in EMSCRIPTEN");
-#endif
+    if (!sorbet::threads_supported) {
+        sorbet::Exception::raise("Creating threads in unsupported in EMSCRIPTEN without -pthread");
+    }
     // AFAIK this should all be:
     //    - defined behaviour
     //    - available on all posix systems
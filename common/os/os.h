@@ -5,6 +5,7 @@
 #include <optional>
 #include <pthread.h>
 #include <string>
+#include <vector>
 
 std::string addr2line(std::string_view programName, void const *const *addr, int count);
 
@@ -37,6 +38,23 @@ std::unique_ptr<Joinable> runInAThread(std::string_view threadName, std::functio
                                        std::optional<int> bindToCore = std::nullopt);
 bool setCurrentThreadName(std::string_view name);
 bool bindThreadToCore(pthread_t handle, int coreId);
+// The ids of all cores, grouped by the NUMA node that they belong to. Empty when the topology is unknown.
+std::vector<int> coresInNumaOrder();
+
+// Hints that [ptr, ptr + size) should be backed by huge pages. Does nothing where the OS offers no such hint.
+void adviseHugePages(void *ptr, size_t size);
+// Faults [ptr, ptr + size) in without changing its contents, so it is safe while other threads use the memory. Does
+// nothing where the OS can not do this.
+void prefaultPages(void *ptr, size_t size);
+
+// The CPU time, user and system, that the calling thread has used so far. 0 where the OS does not tell.
+long currentThreadCpuMicros();
+// The most memory the process has had resident at once so far, in bytes. 0 where the OS does not tell.
+size_t peakRssBytes();
+// The bytes malloc has handed out and not been given back yet. 0 where the allocator does not tell.
+size_t heapAllocatedBytes();
+// Writes a heap profile to `path`. False where the allocator can not, e.g. jemalloc without profiling turned on.
+bool dumpHeapProfile(const std::string &path);
 
 /** The should trigger debugger breakpoint if the debugger is attached, if no debugger is attach, it should do nothing
  *  This allows to:
@@ -16,7 +16,8 @@ using namespace std;
 namespace sorbet {
 
 class StatsdClientWrapper {
-    constexpr static int PKT_LEN = 512; // conservative bound for MTU
+    // statsd's recommendation for networks whose MTU is Ethernet's. Metrics are sent to an agent on the same network.
+    constexpr static int PKT_LEN = 1432;
     statsd_link *link;
     string packet;
 
@@ -27,8 +28,11 @@ class StatsdClientWrapper {
     void addMetric(string_view name, size_t value, string_view type) {
         // spec: https://github.com/etsy/statsd/blob/master/docs/metric_types.md#multi-metric-packets
         auto newLine = fmt::format("{}{}:{}|{}", link->ns ? link->ns : "", cleanMetricName(name), value, type);
-        if (packet.size() + newLine.size() + 1 < PKT_LEN) {
-            packet = packet + '\n' + newLine;
+        if (packet.empty() && newLine.size() < PKT_LEN) {
+            packet = move(newLine);
+        } else if (!packet.empty() && packet.size() + newLine.size() + 1 < PKT_LEN) {
+            packet += '\n';
+            packet += newLine;
         } else {
             if (!packet.empty()) {
                 statsd_send(link, packet.c_str());
@@ -61,6 +65,10 @@ public:
     }
 };
 
+namespace {
+const vector<pair<int, string_view>> PERCENTILES = {{50, "p50"}, {90, "p90"}, {99, "p99"}};
+} // namespace
+
 bool StatsD::submitCounters(const CounterState &counters, string_view host, int port, string_view prefix) {
     StatsdClientWrapper statsd(string(host), port, string(prefix));
 
@@ -76,12 +84,26 @@ bool StatsD::submitCounters(const CounterState &counters, string_view host, int
     }
 
     for (auto &hist : counters.counters->histograms) {
+        // Sending every bucket would take a metric each; the percentiles are what dashboards look at anyway.
+        vector<pair<int, CounterImpl::CounterType>> buckets(hist.second.begin(), hist.second.end());
+        fast_sort(buckets);
         CounterImpl::CounterType sum = 0;
-        for (auto &e : hist.second) {
+        for (auto &e : buckets) {
             sum += e.second;
-            statsd.gauge(absl::StrCat(hist.first, ".", e.first), e.second);
+        }
+        if (sum == 0) {
+            continue;
         }
 
+        CounterImpl::CounterType seen = 0;
+        auto percentile = PERCENTILES.begin();
+        for (auto &e : buckets) {
+            seen += e.second;
+            for (; percentile != PERCENTILES.end() && seen * 100 >= sum * percentile->first; ++percentile) {
+                statsd.gauge(absl::StrCat(hist.first, ".", percentile->second), e.first);
+            }
+        }
+        statsd.gauge(absl::StrCat(hist.first, ".max"), buckets.back().first);
         statsd.gauge(absl::StrCat(hist.first, ".total"), sum);
     }
 
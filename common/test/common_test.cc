@@ -1,15 +1,122 @@
 #include "gtest/gtest.h"
 // violates our requirements, thus has to go first
+#include "common/Counters.h"
+#include "common/FileOps.h"
 #include "common/Levenstein.h"
 #include "common/common.h"
+#include "common/concurrency/WorkerPool.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
 
 namespace sorbet::common {
+auto logger = spdlog::stderr_color_mt("common-test");
 
 TEST(CommonTest, Levenstein) { // NOLINT
     EXPECT_EQ(2, Levenstein::distance("Mama", "Papa", 10));
     EXPECT_EQ(5, Levenstein::distance("Ruby", "Scala", 10));
     EXPECT_EQ(3, Levenstein::distance("Java", "Scala", 10));
     EXPECT_EQ(INT_MAX, Levenstein::distance("Java", "S", 1));
+    EXPECT_EQ(INT_MAX, Levenstein::distance("Mama", "Papa", 1));
+    EXPECT_EQ(3, Levenstein::distance("", "abc", 3));
+
+    // Longer than a machine word, so not computed bit-parallel.
+    std::string longName(70, 'a');
+    std::string otherLongName = longName;
+    otherLongName[3] = 'b';
+    otherLongName.push_back('c');
+    EXPECT_EQ(2, Levenstein::distance(longName, otherLongName, 10));
+    EXPECT_EQ(INT_MAX, Levenstein::distance(longName, otherLongName, 1));
+    EXPECT_EQ(2, Levenstein::distance(longName.substr(0, 64), otherLongName.substr(0, 65), 10));
+}
+
+// Two literals with the same contents are one counter, even when they are bumped on different threads.
+TEST(CommonTest, CountersMergeAcrossThreads) { // NOLINT
+    static const char name[] = "common_test.merged";
+    static const char sameName[] = "common_test.merged";
+    getAndClearThreadCounters();
+
+    prodCounterAdd(name, 2);
+    CounterState fromThread;
+    std::thread worker([&fromThread]() {
+        prodCounterAdd(sameName, 3);
+        fromThread = getAndClearThreadCounters();
+    });
+    worker.join();
+    counterConsume(std::move(fromThread));
+
+    auto stats = getCounterStatistics({"common_test.merged"});
+    EXPECT_NE(std::string::npos, stats.find(" common_test.merged :         5\n")) << stats;
+    getAndClearThreadCounters();
+}
+
+// Ignore patterns only match whole path components, whether they're checked for a directory or for a file in it.
+TEST(CommonTest, ListFilesInDirIgnoresWholeComponents) { // NOLINT
+    auto dir = ::testing::TempDir() + "/list_files_in_dir";
+    for (auto sub : {"", "/a", "/a/vendor", "/a/vendored", "/b", "/b/c"}) {
+        FileOps::createDir(dir + sub);
+    }
+    for (auto file : {"/top.rb", "/a/x.rb", "/a/vendor/y.rb", "/a/vendored/z.rb", "/b/gen.rb", "/b/c/gen.rb",
+                      "/b/c/w.rb"}) {
+        FileOps::write(dir + file, "");
+    }
+
+    auto files = FileOps::listFilesInDir(dir, {".rb"}, true, {"/b/c"}, {"/vendor", "/gen.rb"});
+    for (auto &file : files) {
+        file = file.substr(dir.size());
+    }
+    EXPECT_EQ((std::vector<std::string>{"/a/vendored/z.rb", "/a/x.rb", "/top.rb"}), files);
+}
+
+// The first exception a task throws comes out of wait(), once every other task of the group ran.
+TEST(WorkerPoolTest, WaitRethrowsFromTasks) { // NOLINT
+    auto workers = WorkerPool::create(2, *logger);
+    auto group = workers->taskGroup("throwing");
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 16; i++) {
+        group->run([&ran, i]() {
+            ran++;
+            if (i == 5) {
+                throw std::runtime_error("task failed");
+            }
+        });
+    }
+    EXPECT_THROW(group->wait(), std::runtime_error);
+    EXPECT_EQ(16, ran.load());
+    // The group can be reused, and does not throw the same exception twice.
+    group->run([&ran]() { ran++; });
+    group->wait();
+    EXPECT_EQ(17, ran.load());
+}
+
+// Tasks running on the workers can open groups of their own and wait for them without running out of threads.
+TEST(WorkerPoolTest, NestedGroups) { // NOLINT
+    auto workers = WorkerPool::create(2, *logger);
+    std::atomic<int> ran{0};
+    workers->parallelFor("outer", 8, [&](size_t) {
+        auto inner = workers->taskGroup("inner");
+        for (int i = 0; i < 8; i++) {
+            inner->run([&ran]() { ran++; });
+        }
+        inner->wait();
+    });
+    EXPECT_EQ(64, ran.load());
+}
+
+// Without workers, the thread that waits runs every task itself.
+TEST(WorkerPoolTest, EmptyPool) { // NOLINT
+    auto workers = WorkerPool::create(0, *logger);
+    std::vector<int> seen(100, 0);
+    workers->parallelFor("empty", seen.size(), [&seen](size_t i) { seen[i]++; });
+    EXPECT_EQ(std::vector<int>(100, 1), seen);
+
+    auto group = workers->taskGroup("empty");
+    const auto caller = std::this_thread::get_id();
+    bool onCaller = false;
+    group->run([&]() { onCaller = std::this_thread::get_id() == caller; });
+    group->wait();
+    EXPECT_TRUE(onCaller);
 }
 
 } // namespace sorbet::common
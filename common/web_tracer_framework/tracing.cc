@@ -1,6 +1,7 @@
 #include "common/Counters.h"
 #include "common/FileOps.h"
 
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_replace.h"
 #include "common/Counters_impl.h"
@@ -11,7 +12,98 @@
 #include <unistd.h>
 using namespace std;
 namespace sorbet::web_tracer_framework {
-bool Tracing::storeTraces(const CounterState &counters, string_view fileName) {
+namespace {
+constexpr int FLUSH_INTERVAL_MS = 200;
+
+double durationMs(const CounterImpl::Timing &timing) {
+    return chrono::duration<double, milli>(timing.end - timing.start).count();
+}
+
+string csvField(string_view field) {
+    if (field.find_first_of(",\"\n") == string_view::npos) {
+        return string(field);
+    }
+    return absl::StrCat("\"", absl::StrReplaceAll(field, {{"\"", "\"\""}}), "\"");
+}
+
+template <class T> vector<string> sortedKeys(const UnorderedMap<string, T> &map) {
+    vector<string> keys;
+    for (const auto &[key, _] : map) {
+        keys.emplace_back(key);
+    }
+    fast_sort(keys);
+    return keys;
+}
+
+struct FileProfile {
+    string_view path;
+    // The outermost spans only, as e.g. runParser happens inside of indexOneWithPlugins
+    double totalMs = 0;
+    UnorderedMap<string, double> phaseMs;
+    UnorderedMap<string, u8> counts;
+    vector<const CounterImpl::Timing *> spans;
+};
+
+void formatTiming(fmt::memory_buffer &result, const CounterImpl::Timing &e, int pid) {
+    string maybeArgs;
+    if (!e.args.empty()) {
+        maybeArgs = fmt::format(",\"args\":{{{}}}", fmt::map_join(e.args, ",", [](const auto &nameValue) -> string {
+                                    return fmt::format("\"{}\":\"{}\"", nameValue.first, nameValue.second);
+                                }));
+    }
+
+    string maybeFlow;
+    if (e.self.id != 0) {
+        ENFORCE(e.prev.id == 0);
+        maybeFlow = fmt::format(",\"bind_id\":{},\"flow_out\":true", e.self.id);
+    } else if (e.prev.id != 0) {
+        maybeFlow = fmt::format(",\"bind_id\":{},\"flow_in\":true", e.prev.id);
+    }
+
+    fmt::format_to(result, "{{\"name\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":{},\"tid\":{}{}{}}},\n",
+                   e.measure, (std::chrono::duration<double, std::micro>(e.start.time_since_epoch())).count(),
+                   (std::chrono::duration<double, std::micro>(e.end - e.start)).count(), pid, e.threadId, maybeArgs,
+                   maybeFlow);
+}
+} // namespace
+
+TraceStreamer::TraceStreamer(string fileName, int sampleRate, bool keepInCounters)
+    : fileName(move(fileName)), sampleRate(max(sampleRate, 1)) {
+    startStreamingTimings(keepInCounters);
+    writer = runInAThread("traceStreamer", [this]() {
+        while (!stopped.WaitForNotificationWithTimeout(absl::Milliseconds(FLUSH_INTERVAL_MS))) {
+            writePending();
+        }
+    });
+}
+
+TraceStreamer::~TraceStreamer() {
+    stopStreamingTimings();
+    stopped.Notify();
+    writer = nullptr;
+    writePending();
+}
+
+void TraceStreamer::writePending() {
+    auto timings = takeStreamedTimings();
+    if (timings.empty()) {
+        return;
+    }
+    fmt::memory_buffer result;
+    if (!FileOps::exists(fileName)) {
+        fmt::format_to(result, "[\n");
+    }
+    auto pid = getpid();
+    for (const auto &e : timings) {
+        auto seen = spansSeen[e.measure]++;
+        if (seen < SAMPLE_AFTER || seen % sampleRate == 0) {
+            formatTiming(result, e, pid);
+        }
+    }
+    FileOps::append(fileName, to_string(result));
+}
+
+bool Tracing::storeTraces(const CounterState &counters, string_view fileName, bool includeTimings) {
     fmt::memory_buffer result;
 
     if (!FileOps::exists(fileName)) {
@@ -48,31 +140,88 @@ bool Tracing::storeTraces(const CounterState &counters, string_view fileName) {
     //                    }));
     // }
 
-    for (const auto &e : counters.counters->timings) {
-        string maybeArgs;
-        if (!e.args.empty()) {
-            maybeArgs = fmt::format(",\"args\":{{{}}}", fmt::map_join(e.args, ",", [](const auto &nameValue) -> string {
-                                        return fmt::format("\"{}\":\"{}\"", nameValue.first, nameValue.second);
-                                    }));
+    if (includeTimings) {
+        for (const auto &e : counters.counters->timings) {
+            formatTiming(result, e, pid);
         }
+    }
 
-        string maybeFlow;
-        if (e.self.id != 0) {
-            ENFORCE(e.prev.id == 0);
-            maybeFlow = fmt::format(",\"bind_id\":{},\"flow_out\":true", e.self.id);
-        } else if (e.prev.id != 0) {
-            maybeFlow = fmt::format(",\"bind_id\":{},\"flow_in\":true", e.prev.id);
+    fmt::format_to(result, "\n");
+    FileOps::append(fileName, to_string(result));
+    return true;
+}
+
+bool Tracing::storeFileProfile(const CounterState &counters, string_view fileName) {
+    UnorderedMap<string_view, FileProfile> profiles;
+    UnorderedMap<string, double> allPhases;
+    UnorderedMap<string, u8> allCounts;
+    for (const auto &e : counters.counters->timings) {
+        auto file = absl::c_find_if(e.args, [](const auto &arg) -> bool { return string_view(arg.first) == "file"; });
+        if (file == e.args.end()) {
+            continue;
+        }
+        auto &profile = profiles[file->second];
+        profile.path = file->second;
+        profile.phaseMs[e.measure] += durationMs(e);
+        allPhases[e.measure] += durationMs(e);
+        for (const auto &[name, value] : e.args) {
+            u8 count;
+            if (&value != &file->second && absl::SimpleAtoi(value, &count)) {
+                profile.counts[name] += count;
+                allCounts[name] += count;
+            }
         }
+        profile.spans.emplace_back(&e);
+    }
 
-        fmt::format_to(result,
-                       "{{\"name\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":{},\"tid\":{}{}{}}},\n",
-                       e.measure, (std::chrono::duration<double, std::micro>(e.start.time_since_epoch())).count(),
-                       (std::chrono::duration<double, std::micro>(e.end - e.start)).count(), pid, e.threadId, maybeArgs,
-                       maybeFlow);
+    vector<FileProfile *> sorted;
+    for (auto &[_, profile] : profiles) {
+        // A span nested in another span of the same file starts on the same thread before the outer one ends.
+        fast_sort(profile.spans, [](const auto *left, const auto *right) -> bool {
+            if (left->threadId != right->threadId) {
+                return left->threadId < right->threadId;
+            }
+            if (left->start != right->start) {
+                return left->start < right->start;
+            }
+            return left->end > right->end;
+        });
+        const CounterImpl::Timing *outer = nullptr;
+        for (const auto *span : profile.spans) {
+            if (outer == nullptr || outer->threadId != span->threadId || span->start >= outer->end) {
+                profile.totalMs += durationMs(*span);
+                outer = span;
+            }
+        }
+        sorted.emplace_back(&profile);
     }
+    fast_sort(sorted, [](const auto *left, const auto *right) -> bool {
+        if (left->totalMs != right->totalMs) {
+            return left->totalMs > right->totalMs;
+        }
+        return left->path < right->path;
+    });
 
-    fmt::format_to(result, "\n");
-    FileOps::append(fileName, to_string(result));
+    auto phases = sortedKeys(allPhases);
+    auto counts = sortedKeys(allCounts);
+    fmt::memory_buffer result;
+    fmt::format_to(result, "file,total_ms{}{}\n", fmt::map_join(phases, "", [](const auto &phase) -> string {
+                       return absl::StrCat(",", csvField(phase), "_ms");
+                   }),
+                   fmt::map_join(counts, "", [](const auto &count) -> string { return "," + csvField(count); }));
+    for (const auto *profile : sorted) {
+        fmt::format_to(result, "{},{:.3f}", csvField(profile->path), profile->totalMs);
+        for (const auto &phase : phases) {
+            auto it = profile->phaseMs.find(phase);
+            fmt::format_to(result, ",{:.3f}", it == profile->phaseMs.end() ? 0.0 : it->second);
+        }
+        for (const auto &count : counts) {
+            auto it = profile->counts.find(count);
+            fmt::format_to(result, ",{}", it == profile->counts.end() ? 0 : it->second);
+        }
+        fmt::format_to(result, "\n");
+    }
+    FileOps::write(fileName, to_string(result));
     return true;
 }
 } // namespace sorbet::web_tracer_framework
@@ -1,6 +1,8 @@
 #ifndef SORBET_CORE_WEB_TRACER_FRAMEWORK_TRACING_H
 #define SORBET_CORE_WEB_TRACER_FRAMEWORK_TRACING_H
 
+#include "absl/synchronization/notification.h"
+#include "common/os/os.h"
 #include "core/core.h"
 
 namespace sorbet::web_tracer_framework {
@@ -8,7 +10,41 @@ class Tracing {
 public:
     Tracing() = delete;
 
-    static bool storeTraces(const CounterState &counters, std::string_view fileName);
+    // Leave out the Timer spans with `includeTimings = false`, when a TraceStreamer already wrote them.
+    static bool storeTraces(const CounterState &counters, std::string_view fileName, bool includeTimings = true);
+
+    // Writes a CSV with one row per file, most expensive first: the time spent in each kind of span that carries a
+    // `file` argument, and the sum of every numeric argument of those spans.
+    static bool storeFileProfile(const CounterState &counters, std::string_view fileName);
+};
+
+/**
+ * While alive, appends the spans of every Timer to a trace file as they get recorded, from a background thread, so
+ * that long runs don't hold millions of them in memory until exit, and a killed process still leaves a trace behind.
+ * The file is in the same format storeTraces writes, which then adds the counters at exit.
+ *
+ * Past the first SAMPLE_AFTER spans of a timer, only every `sampleRate`-th one is written, to bound the overhead of
+ * very hot timers. Unless `keepInCounters`, spans no longer reach the threads' CounterStates, so nothing else (StatsD,
+ * --profile-files) sees them.
+ */
+class TraceStreamer final {
+public:
+    static constexpr u8 SAMPLE_AFTER = 1000;
+
+    TraceStreamer(std::string fileName, int sampleRate, bool keepInCounters);
+    ~TraceStreamer();
+    TraceStreamer(const TraceStreamer &) = delete;
+    TraceStreamer &operator=(const TraceStreamer &) = delete;
+
+private:
+    void writePending();
+
+    const std::string fileName;
+    const int sampleRate;
+    // Only touched by the writer thread
+    UnorderedMap<const char *, u8> spansSeen;
+    absl::Notification stopped;
+    std::unique_ptr<Joinable> writer;
 };
 } // namespace sorbet::web_tracer_framework
 
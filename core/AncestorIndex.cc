@@ -0,0 +1,86 @@
+#include "core/AncestorIndex.h"
+#include "core/GlobalState.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace sorbet::core {
+
+namespace {
+enum class BuildState : u1 { Unvisited, InProgress, Done, NotIndexed };
+
+struct Builder {
+    const GlobalState &gs;
+    vector<BuildState> state;
+    vector<vector<u4>> ancestorsOf;
+
+    Builder(const GlobalState &gs)
+        : gs(gs), state(gs.symbolsUsed(), BuildState::Unvisited), ancestorsOf(gs.symbolsUsed()) {}
+
+    // Mirrors the linearized branch of Symbol::derivesFrom: own mixins (already transitive), then the superclass
+    // chain with its mixins.
+    bool visit(SymbolRef klass) {
+        switch (state[klass._id]) {
+            case BuildState::Done:
+                return true;
+            case BuildState::NotIndexed:
+            case BuildState::InProgress:
+                return false;
+            case BuildState::Unvisited:
+                break;
+        }
+        auto data = klass.data(gs);
+        if (!data->isClass() || !data->isClassLinearizationComputed()) {
+            state[klass._id] = BuildState::NotIndexed;
+            return false;
+        }
+        state[klass._id] = BuildState::InProgress;
+        auto &result = ancestorsOf[klass._id];
+        for (auto mixin : data->mixins()) {
+            result.emplace_back(mixin._id);
+        }
+        auto super = data->superClass();
+        if (super.exists()) {
+            if (!visit(super)) {
+                result.clear();
+                state[klass._id] = BuildState::NotIndexed;
+                return false;
+            }
+            result.emplace_back(super._id);
+            auto &inherited = ancestorsOf[super._id];
+            result.insert(result.end(), inherited.begin(), inherited.end());
+        }
+        fast_sort(result);
+        result.erase(unique(result.begin(), result.end()), result.end());
+        state[klass._id] = BuildState::Done;
+        return true;
+    }
+};
+} // namespace
+
+shared_ptr<const AncestorIndex> AncestorIndex::build(const GlobalState &gs) {
+    Builder builder(gs);
+    auto result = make_shared<AncestorIndex>();
+    result->offsets.reserve(gs.symbolsUsed() + 1);
+    result->indexed.resize(gs.symbolsUsed(), false);
+    for (u4 i = 0; i < gs.symbolsUsed(); i++) {
+        result->offsets.emplace_back(result->ancestors.size());
+        if (i == 0 || !builder.visit(SymbolRef(gs, i))) {
+            continue;
+        }
+        result->indexed[i] = true;
+        auto &ancestors = builder.ancestorsOf[i];
+        result->ancestors.insert(result->ancestors.end(), ancestors.begin(), ancestors.end());
+    }
+    result->offsets.emplace_back(result->ancestors.size());
+    return result;
+}
+
+bool AncestorIndex::derivesFrom(SymbolRef klass, SymbolRef ancestor) const {
+    ENFORCE(covers(klass));
+    auto first = ancestors.begin() + offsets[klass._id];
+    auto last = ancestors.begin() + offsets[klass._id + 1];
+    return binary_search(first, last, ancestor._id);
+}
+
+} // namespace sorbet::core
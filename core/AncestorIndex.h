@@ -0,0 +1,37 @@
+#ifndef SORBET_ANCESTORINDEX_H
+#define SORBET_ANCESTORINDEX_H
+
+#include "core/SymbolRef.h"
+#include <memory>
+#include <vector>
+
+namespace sorbet::core {
+class GlobalState;
+
+/**
+ * The sorted set of ancestors (superclasses and mixins, transitively) of every linearized class, laid out flat so
+ * that Symbol::derivesFrom is a binary search instead of a walk up the hierarchy.
+ *
+ * Built by the resolver once the hierarchy is final. Classes that didn't exist or weren't linearized at that point
+ * are simply not covered, and derivesFrom falls back to walking for them.
+ */
+class AncestorIndex final {
+    // ancestors of symbol `i` are ancestors[offsets[i]..offsets[i + 1])
+    std::vector<u4> offsets;
+    std::vector<u4> ancestors;
+    std::vector<bool> indexed;
+
+public:
+    static std::shared_ptr<const AncestorIndex> build(const GlobalState &gs);
+
+    /** Whether `klass` has an entry */
+    bool covers(SymbolRef klass) const {
+        return klass._id < indexed.size() && indexed[klass._id];
+    }
+    /** Requires covers(klass) */
+    bool derivesFrom(SymbolRef klass, SymbolRef ancestor) const;
+};
+
+} // namespace sorbet::core
+
+#endif
@@ -1,15 +1,12 @@
 #include "core/AutocorrectSuggestion.h"
-#include "absl/strings/str_cat.h"
 
 using namespace std;
 
 namespace sorbet::core {
 
-bool hasSeen(const UnorderedSet<Loc> &seen, Loc loc) {
+namespace {
+bool hasSeen(const vector<Loc> &seen, Loc loc) {
     for (auto &seenLoc : seen) {
-        if (seenLoc.file() != loc.file()) {
-            continue;
-        }
         // Check exactly equal for zero-width locs
         if (seenLoc == loc) {
             return true;
@@ -24,41 +21,45 @@ bool hasSeen(const UnorderedSet<Loc> &seen, Loc loc) {
     }
     return false;
 }
+} // namespace
 
-UnorderedMap<FileRef, string> AutocorrectSuggestion::apply(vector<AutocorrectSuggestion> autocorrects,
-                                                           UnorderedMap<FileRef, string> sources) {
-    // Sort the locs backwards
-    auto compare = [](const AutocorrectSuggestion &left, const AutocorrectSuggestion &right) {
-        if (left.loc.file() != right.loc.file()) {
-            return left.loc.file().id() > right.loc.file().id();
+string AutocorrectSuggestion::applyToFile(vector<AutocorrectSuggestion> autocorrects, string source) {
+    // Sort the locs backwards, so that applying one never moves the ones still to be applied. Ties are broken on the
+    // rest of the autocorrect, so that the outcome doesn't depend on the order they were reported in.
+    fast_sort(autocorrects, [](const AutocorrectSuggestion &left, const AutocorrectSuggestion &right) -> bool {
+        if (left.loc.beginPos() != right.loc.beginPos()) {
+            return left.loc.beginPos() > right.loc.beginPos();
         }
-
-        auto a = left.loc.beginPos();
-        auto b = right.loc.beginPos();
-        if (a != b) {
-            return a > b;
+        if (left.loc.endPos() != right.loc.endPos()) {
+            return left.loc.endPos() > right.loc.endPos();
         }
+        return left.replacement < right.replacement;
+    });
 
-        return false;
-    };
-    fast_sort(autocorrects, compare);
-
-    UnorderedSet<Loc> seen; // used to make sure nothing overlaps
-    UnorderedMap<FileRef, string> ret;
+    vector<Loc> seen; // used to make sure nothing overlaps
     for (auto &autocorrect : autocorrects) {
         auto &loc = autocorrect.loc;
-        if (!ret.count(loc.file())) {
-            ret[loc.file()] = sources[loc.file()];
-        }
-        auto source = ret[loc.file()];
-        auto start = loc.beginPos();
-        auto end = loc.endPos();
-
+        ENFORCE(loc.file() == autocorrects.front().loc.file());
         if (hasSeen(seen, loc)) {
             continue;
         }
-        seen.emplace(loc);
-        ret[loc.file()] = absl::StrCat(source.substr(0, start), autocorrect.replacement, source.substr(end, -1));
+        seen.emplace_back(loc);
+        source.replace(loc.beginPos(), loc.endPos() - loc.beginPos(), autocorrect.replacement);
+    }
+    return source;
+}
+
+UnorderedMap<FileRef, string> AutocorrectSuggestion::apply(vector<AutocorrectSuggestion> autocorrects,
+                                                           UnorderedMap<FileRef, string> sources) {
+    UnorderedMap<FileRef, vector<AutocorrectSuggestion>> byFile;
+    for (auto &autocorrect : autocorrects) {
+        auto file = autocorrect.loc.file();
+        byFile[file].emplace_back(move(autocorrect));
+    }
+
+    UnorderedMap<FileRef, string> ret;
+    for (auto &[file, fileAutocorrects] : byFile) {
+        ret[file] = applyToFile(move(fileAutocorrects), move(sources[file]));
     }
     return ret;
 }
@@ -12,6 +12,11 @@ struct AutocorrectSuggestion {
     AutocorrectSuggestion(Loc loc, std::string replacement) : loc(loc), replacement(replacement) {}
     static UnorderedMap<FileRef, std::string> apply(std::vector<AutocorrectSuggestion> autocorrects,
                                                     UnorderedMap<FileRef, std::string> sources);
+    /**
+     * Applies autocorrects that are all in the same file to that file's `source`. Autocorrects that overlap one
+     * further down the file are dropped; which one survives only depends on the autocorrects, never on their order.
+     */
+    static std::string applyToFile(std::vector<AutocorrectSuggestion> autocorrects, std::string source);
 };
 
 } // namespace sorbet::core
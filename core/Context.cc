@@ -140,4 +140,37 @@ bool GlobalSubstitution::useFastPath() const {
     return fastPath;
 }
 
+LazyGlobalSubstitution::LazyGlobalSubstitution(const GlobalState &from, GlobalState &to)
+    : from(from), to(to), namesKept(to.namesUsed()) {
+    ENFORCE(from.symbols.size() == to.symbols.size(), "Can't substitute symbols yet");
+    nameSubstitution.resize(from.namesUsed());
+}
+
+NameRef LazyGlobalSubstitution::substitute(NameRef from, bool allowSameFromTo) {
+    if (from._id < namesKept) {
+        return NameRef(to, from._id);
+    }
+    ENFORCE(from._id < nameSubstitution.size(), "name substitution index out of bounds, got {} where there are {} names",
+            std::to_string(from._id), std::to_string(nameSubstitution.size()));
+    auto &substituted = nameSubstitution[from._id];
+    if (substituted == 0) {
+        const Name &nm = this->from.names[from._id];
+        switch (nm.kind) {
+            case NameKind::UNIQUE:
+                substituted =
+                    to.freshNameUnique(nm.unique.uniqueNameKind, substitute(nm.unique.original), nm.unique.num)._id;
+                break;
+            case NameKind::UTF8:
+                substituted = to.enterNameUTF8(nm.raw.utf8)._id;
+                break;
+            case NameKind::CONSTANT:
+                substituted = to.enterNameConstant(substitute(nm.cnst.original))._id;
+                break;
+            default:
+                ENFORCE(false, "NameKind missing");
+        }
+    }
+    return NameRef(to, substituted);
+}
+
 } // namespace sorbet::core
@@ -0,0 +1,253 @@
+#ifndef SORBET_COPY_ON_WRITE_VECTOR_H
+#define SORBET_COPY_ON_WRITE_VECTOR_H
+
+#include "common/common.h"
+#include "common/os/os.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <new>
+
+namespace sorbet::core {
+
+/**
+ * An append-only vector that keeps its elements in fixed-size chunks, which copies of the vector share. Copying the
+ * vector only copies the chunk pointers; a shared chunk is duplicated the first time it is written through
+ * `mutableAt` or appended to, so a copy pays only for the chunks it changes.
+ *
+ * Elements never move once inserted. Chunks are aligned to their own size, which lets `indexOf` recover an element's
+ * index from its address.
+ *
+ * There is deliberately no non-const operator[] or iterator: reading through a mutable owner must not unshare
+ * anything, so writes have to ask for `mutableAt`.
+ */
+template <class T, size_t ChunkBytes = 128 * 1024> class CopyOnWriteVector final {
+    static_assert((ChunkBytes & (ChunkBytes - 1)) == 0, "chunk size must be a power of two");
+
+    struct Chunk {
+        const u4 base;
+        u4 used = 0;
+
+        explicit Chunk(u4 base) : base(base) {}
+
+        T *elems();
+        const T *elems() const;
+    };
+
+    static constexpr size_t ELEMS_OFFSET = (sizeof(Chunk) + alignof(T) - 1) / alignof(T) * alignof(T);
+    static constexpr u4 PER_CHUNK = (ChunkBytes - ELEMS_OFFSET) / sizeof(T);
+    static_assert(PER_CHUNK > 0, "elements do not fit in a chunk");
+
+    // Huge pages are 2MB on the platforms that have them.
+    static constexpr size_t REGION_ALIGNMENT = std::max(ChunkBytes, (size_t)2 * 1024 * 1024);
+
+    // A block of chunks allocated together by preallocate(). It is freed once every chunk carved out of it is gone.
+    struct Region {
+        void *mem;
+        std::unique_ptr<Joinable> prefaulter;
+
+        ~Region() {
+            prefaulter.reset(); // joins
+            ::operator delete(mem, std::align_val_t(REGION_ALIGNMENT));
+        }
+    };
+
+    struct ChunkDeleter {
+        // Set for chunks that were carved out of a Region, which owns their memory.
+        std::shared_ptr<Region> region;
+
+        void operator()(Chunk *chunk) const {
+            auto *elems = chunk->elems();
+            for (u4 i = 0; i < chunk->used; i++) {
+                elems[i].~T();
+            }
+            chunk->~Chunk();
+            if (region == nullptr) {
+                ::operator delete(chunk, std::align_val_t(ChunkBytes));
+            }
+        }
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    u4 size_ = 0;
+    u4 capacity_ = 0;
+
+    static std::shared_ptr<Chunk> allocate(u4 base) {
+        void *mem = ::operator new(ChunkBytes, std::align_val_t(ChunkBytes));
+        return std::shared_ptr<Chunk>(new (mem) Chunk(base), ChunkDeleter());
+    }
+
+    // Only called by the owner, while no other thread writes through this vector. Another vector sharing the chunk
+    // may be dropping its reference concurrently, hence the fence before we start writing in place.
+    static void makeUnique(std::shared_ptr<Chunk> &chunk) {
+        if (chunk.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return;
+        }
+        auto copy = allocate(chunk->base);
+        const auto *from = chunk->elems();
+        auto *to = copy->elems();
+        for (; copy->used < chunk->used; copy->used++) {
+            new (to + copy->used) T(from[copy->used]);
+        }
+        chunk = std::move(copy);
+    }
+
+public:
+    class const_iterator {
+        const CopyOnWriteVector *vec;
+        u4 idx;
+
+    public:
+        const_iterator(const CopyOnWriteVector *vec, u4 idx) : vec(vec), idx(idx) {}
+        const T &operator*() const {
+            return (*vec)[idx];
+        }
+        const T *operator->() const {
+            return &(*vec)[idx];
+        }
+        const_iterator &operator++() {
+            idx++;
+            return *this;
+        }
+        bool operator==(const const_iterator &other) const {
+            return idx == other.idx;
+        }
+        bool operator!=(const const_iterator &other) const {
+            return idx != other.idx;
+        }
+    };
+
+    CopyOnWriteVector() = default;
+    CopyOnWriteVector(const CopyOnWriteVector &) = default;
+    CopyOnWriteVector(CopyOnWriteVector &&) noexcept = default;
+    CopyOnWriteVector &operator=(const CopyOnWriteVector &) = default;
+    CopyOnWriteVector &operator=(CopyOnWriteVector &&) noexcept = default;
+
+    u4 size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    // Like std::vector, this grows geometrically unless reserve() asks for more; callers use it to size side tables.
+    u4 capacity() const {
+        return capacity_;
+    }
+    void reserve(u4 n) {
+        if (n > capacity_) {
+            capacity_ = n;
+            chunks.reserve((n + PER_CHUNK - 1) / PER_CHUNK);
+        }
+    }
+    void clear() {
+        chunks.clear();
+        size_ = 0;
+    }
+    /** Drops every element from index `n` on, and releases the chunks that held only those. */
+    void truncate(u4 n) {
+        if (n >= size_) {
+            return;
+        }
+        chunks.resize((n + PER_CHUNK - 1) / PER_CHUNK);
+        if (n % PER_CHUNK != 0) {
+            auto &chunk = chunks.back();
+            makeUnique(chunk);
+            auto *elems = chunk->elems();
+            for (u4 i = n % PER_CHUNK; i < chunk->used; i++) {
+                elems[i].~T();
+            }
+            chunk->used = n % PER_CHUNK;
+        }
+        size_ = n;
+    }
+    /** Copies every chunk that is shared, so that mutableAt() no longer changes the vector itself. */
+    void unshareAll() {
+        for (auto &chunk : chunks) {
+            makeUnique(chunk);
+        }
+    }
+    /**
+     * Reserves room for as many chunks as u4 indices can address. Appending then never moves the chunk index, so
+     * other threads can keep reading elements they have been handed while one thread appends.
+     */
+    void reserveEveryChunk() {
+        chunks.reserve(std::numeric_limits<u4>::max() / PER_CHUNK + 1);
+    }
+
+    const T &operator[](u4 idx) const {
+        return chunks[idx / PER_CHUNK]->elems()[idx % PER_CHUNK];
+    }
+    T &mutableAt(u4 idx) {
+        auto &chunk = chunks[idx / PER_CHUNK];
+        makeUnique(chunk);
+        return chunk->elems()[idx % PER_CHUNK];
+    }
+    /**
+     * Allocates the chunks for the first `n` elements now, in one region that is backed by huge pages where the OS
+     * offers them, and faults that region in on a background thread. Meant for vectors that are known to grow that
+     * large, to spare them the page faults (and TLB misses) of growing one page at a time.
+     */
+    void preallocate(u4 n) {
+        reserve(n);
+        u4 have = chunks.size();
+        u4 want = (n + PER_CHUNK - 1) / PER_CHUNK;
+        if (want <= have) {
+            return;
+        }
+        size_t bytes = (size_t)(want - have) * ChunkBytes;
+        auto region = std::make_shared<Region>();
+        region->mem = ::operator new(bytes, std::align_val_t(REGION_ALIGNMENT));
+        adviseHugePages(region->mem, bytes);
+        region->prefaulter =
+            runInAThread("prefaultChunks", [mem = region->mem, bytes]() { prefaultPages(mem, bytes); });
+        for (u4 i = have; i < want; i++) {
+            void *mem = static_cast<char *>(region->mem) + (size_t)(i - have) * ChunkBytes;
+            chunks.emplace_back(new (mem) Chunk(i * PER_CHUNK), ChunkDeleter{region});
+        }
+    }
+
+    template <class... Args> T &emplace_back(Args &&... args) {
+        // Chunks past the last element were preallocated, and may be shared with a copy.
+        auto chunkIdx = size_ / PER_CHUNK;
+        if (chunkIdx == chunks.size()) {
+            chunks.emplace_back(allocate(size_));
+        } else {
+            makeUnique(chunks[chunkIdx]);
+        }
+        auto &chunk = *chunks[chunkIdx];
+        T *res = new (chunk.elems() + chunk.used) T(std::forward<Args>(args)...);
+        chunk.used++;
+        size_++;
+        if (size_ > capacity_) {
+            capacity_ = std::max(size_, capacity_ * 2);
+        }
+        return *res;
+    }
+
+    /** The index of `elem`, which must be stored in this vector (or in a chunk this vector shares). */
+    u4 indexOf(const T *elem) const {
+        auto *chunk = reinterpret_cast<const Chunk *>(reinterpret_cast<uintptr_t>(elem) & ~(uintptr_t)(ChunkBytes - 1));
+        return chunk->base + (elem - chunk->elems());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(this, size_);
+    }
+};
+
+template <class T, size_t ChunkBytes> T *CopyOnWriteVector<T, ChunkBytes>::Chunk::elems() {
+    return reinterpret_cast<T *>(reinterpret_cast<char *>(this) + ELEMS_OFFSET);
+}
+
+template <class T, size_t ChunkBytes> const T *CopyOnWriteVector<T, ChunkBytes>::Chunk::elems() const {
+    return reinterpret_cast<const T *>(reinterpret_cast<const char *>(this) + ELEMS_OFFSET);
+}
+
+} // namespace sorbet::core
+
+#endif
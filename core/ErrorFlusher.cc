@@ -1,50 +1,50 @@
 #include "core/ErrorFlusher.h"
 #include "common/FileSystem.h"
+#include "common/concurrency/ConcurrentQueue.h"
+#include "common/concurrency/WorkerPool.h"
+#include "core/GlobalState.h"
 #include "core/lsp/QueryResponse.h"
 
 using namespace std;
 
 namespace sorbet::core {
 
-void ErrorFlusher::flushErrors(spdlog::logger &logger, vector<unique_ptr<ErrorQueueMessage>> errors) {
-    fmt::memory_buffer critical, nonCritical;
-    for (auto &error : errors) {
-        if (error->kind == ErrorQueueMessage::Kind::Error) {
-            if (error->error->isSilenced) {
+template <class F> void ErrorFlusher::flushEach(vector<unique_ptr<ErrorQueueMessage>> &errors, F write) {
+    // Critical errors go first. Each error is written as soon as it is reached and then freed, instead of formatting
+    // the whole batch into one buffer, so that a huge batch is never held in memory twice.
+    for (bool critical : {true, false}) {
+        for (auto &error : errors) {
+            if (error == nullptr || error->kind != ErrorQueueMessage::Kind::Error || error->error->isSilenced ||
+                error->error->isCritical() != critical) {
                 continue;
             }
 
             prodHistogramAdd("error", error->error->what.code, 1);
 
-            auto &out = error->error->isCritical() ? critical : nonCritical;
-            if (out.size() != 0) {
-                fmt::format_to(out, "\n\n");
-            }
             ENFORCE(error->text.has_value());
-            fmt::format_to(out, "{}", error->text.value_or(""));
+            write(critical, error->text.value_or(""));
 
             for (auto &autocorrect : error->error->autocorrects) {
                 autocorrects.emplace_back(move(autocorrect));
             }
+            error = nullptr;
         }
     }
+}
 
-    if (critical.size() != 0) {
-        if (!printedAtLeastOneError) {
-            logger.log(spdlog::level::critical, "{}", to_string(critical));
-            printedAtLeastOneError = true;
-        } else {
-            logger.log(spdlog::level::critical, "\n{}", to_string(critical));
-        }
-    }
-    if (nonCritical.size() != 0) {
-        if (!printedAtLeastOneError) {
-            logger.log(spdlog::level::err, "{}", to_string(nonCritical));
-            printedAtLeastOneError = true;
-        } else {
-            logger.log(spdlog::level::err, "\n{}", to_string(nonCritical));
-        }
-    }
+void ErrorFlusher::flushErrors(spdlog::logger &logger, vector<unique_ptr<ErrorQueueMessage>> errors) {
+    flushEach(errors, [&](bool critical, const string &text) {
+        // Separating errors with a leading newline, on top of the one the logger appends, leaves a blank line
+        // between them.
+        logger.log(critical ? spdlog::level::critical : spdlog::level::err, printedAtLeastOneError ? "\n{}" : "{}",
+                   text);
+        printedAtLeastOneError = true;
+    });
+}
+
+void ErrorFlusher::flushRenderedErrors(ostream &out, vector<unique_ptr<ErrorQueueMessage>> errors) {
+    flushEach(errors, [&](bool critical, const string &text) { out.write(text.data(), text.size()); });
+    out.flush();
 }
 
 void ErrorFlusher::flushErrorCount(spdlog::logger &logger, int count) {
@@ -55,20 +55,50 @@ void ErrorFlusher::flushErrorCount(spdlog::logger &logger, int count) {
     }
 }
 
-void ErrorFlusher::flushAutocorrects(const GlobalState &gs, FileSystem &fs) {
-    UnorderedMap<FileRef, string> sources;
+void ErrorFlusher::flushAutocorrects(const GlobalState &gs, FileSystem &fs, WorkerPool &workers) {
+    UnorderedMap<FileRef, vector<AutocorrectSuggestion>> byFile;
     for (auto &autocorrect : autocorrects) {
         auto file = autocorrect.loc.file();
-        if (!sources.count(file)) {
-            sources[file] = fs.readFile(file.data(gs).path());
-        }
+        byFile[file].emplace_back(move(autocorrect));
     }
+    autocorrects.clear();
 
-    auto toWrite = AutocorrectSuggestion::apply(autocorrects, sources);
-    for (auto &entry : toWrite) {
-        fs.writeFile(entry.first.data(gs).path(), entry.second);
+    vector<pair<FileRef, vector<AutocorrectSuggestion>>> files(make_move_iterator(byFile.begin()),
+                                                               make_move_iterator(byFile.end()));
+    auto fileq = make_shared<ConcurrentBoundedQueue<int>>(files.size());
+    for (int i = 0; i < files.size(); i++) {
+        auto copy = i;
+        fileq->push(move(copy), 1);
+    }
+
+    // Every file is read, corrected, and written back independently of the others, so files are spread across the
+    // workers. Conflicts between autocorrects are only ever resolved within a file.
+    auto doneq = make_shared<BlockingBoundedQueue<int>>(files.size());
+    workers.multiplexJob("flushAutocorrects", [&gs, &fs, &files, fileq, doneq]() {
+        int processedByThread = 0;
+        int job;
+        for (auto result = fileq->try_pop(job); !result.done(); result = fileq->try_pop(job)) {
+            if (result.gotItem()) {
+                processedByThread++;
+                auto &[file, fileAutocorrects] = files[job];
+                auto path = file.data(gs).path();
+                try {
+                    auto source = fs.readFile(path);
+                    fs.writeFile(path, AutocorrectSuggestion::applyToFile(move(fileAutocorrects), move(source)));
+                } catch (FileNotFoundException &) {
+                    // The file was removed since it was typechecked; there is nothing left to correct.
+                }
+            }
+        }
+        if (processedByThread > 0) {
+            doneq->push(move(processedByThread), processedByThread);
+        }
+    });
+
+    int processed;
+    for (auto result = doneq->wait_pop_timed(processed, WorkerPool::BLOCK_INTERVAL(), gs.tracer()); !result.done();
+         result = doneq->wait_pop_timed(processed, WorkerPool::BLOCK_INTERVAL(), gs.tracer())) {
     }
-    autocorrects.clear();
 }
 
 } // namespace sorbet::core
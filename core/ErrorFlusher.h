@@ -3,10 +3,12 @@
 
 #include "core/AutocorrectSuggestion.h"
 #include "core/ErrorQueueMessage.h"
+#include <ostream>
 #include <vector>
 
 namespace sorbet {
 class FileSystem;
+class WorkerPool;
 namespace core {
 
 class ErrorFlusher {
@@ -14,11 +16,15 @@ private:
     std::vector<AutocorrectSuggestion> autocorrects;
     bool printedAtLeastOneError{false};
 
+    template <class F> void flushEach(std::vector<std::unique_ptr<ErrorQueueMessage>> &errors, F write);
+
 public:
     ErrorFlusher() = default;
     void flushErrors(spdlog::logger &logger, std::vector<std::unique_ptr<ErrorQueueMessage>> error);
+    /** Like flushErrors, but writes each error's text to `out` exactly as it was rendered, with no separators. */
+    void flushRenderedErrors(std::ostream &out, std::vector<std::unique_ptr<ErrorQueueMessage>> errors);
     void flushErrorCount(spdlog::logger &logger, int count);
-    void flushAutocorrects(const GlobalState &gs, FileSystem &fs);
+    void flushAutocorrects(const GlobalState &gs, FileSystem &fs, WorkerPool &workers);
 };
 
 } // namespace core
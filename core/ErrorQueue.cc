@@ -7,6 +7,28 @@ namespace sorbet::core {
 
 using namespace std;
 
+namespace {
+thread_local u4 pushedByThisThread = 0;
+thread_local vector<ErrorQueueMessage> *bufferOfThisThread = nullptr;
+thread_local ErrorProbe *probeOfThisThread = nullptr;
+} // namespace
+
+ErrorBuffer::ErrorBuffer() : previous(bufferOfThisThread) {
+    bufferOfThisThread = &messages;
+}
+
+ErrorBuffer::~ErrorBuffer() {
+    bufferOfThisThread = previous;
+}
+
+ErrorProbe::ErrorProbe() : previous(probeOfThisThread) {
+    probeOfThisThread = this;
+}
+
+ErrorProbe::~ErrorProbe() {
+    probeOfThisThread = previous;
+}
+
 ErrorQueue::ErrorQueue(spdlog::logger &logger, spdlog::logger &tracer)
     : owner(this_thread::get_id()), logger(logger), tracer(tracer){};
 
@@ -51,6 +73,17 @@ vector<unique_ptr<core::Error>> ErrorQueue::drainAllErrors() {
     return move(drainWithQueryResponses().first);
 }
 
+pair<vector<FileRef>, vector<unique_ptr<core::Error>>> ErrorQueue::drainFlushedErrors() {
+    vector<FileRef> files;
+    vector<unique_ptr<core::Error>> out;
+    for (auto &msg : drainFlushed(&files)) {
+        if (msg->kind == ErrorQueueMessage::Kind::Error) {
+            out.emplace_back(move(msg->error));
+        }
+    }
+    return make_pair(move(files), move(out));
+}
+
 void ErrorQueue::flushErrors(bool all) {
     checkOwned();
     if (ignoreFlushes) {
@@ -64,27 +97,76 @@ void ErrorQueue::flushErrors(bool all) {
     } else {
         errors = drainFlushed();
     }
-    errorFlusher.flushErrors(logger, move(errors));
+    if (recordFlushedErrors) {
+        for (auto &msg : errors) {
+            if (msg->kind == ErrorQueueMessage::Kind::Error && !msg->error->isSilenced) {
+                recordedErrors.emplace_back(
+                    RenderedError{msg->whatFile, msg->error->what.code, msg->error->isCritical(), *msg->text});
+            }
+        }
+    }
+    if (recordFilesWithErrors) {
+        for (auto &msg : errors) {
+            if (msg->kind == ErrorQueueMessage::Kind::Error && !msg->error->isSilenced) {
+                filesWithFlushedErrors.insert(msg->whatFile);
+            }
+        }
+    }
+    if (renderedOutput != nullptr) {
+        errorFlusher.flushRenderedErrors(*renderedOutput, move(errors));
+    } else {
+        errorFlusher.flushErrors(logger, move(errors));
+    }
 }
 
 void ErrorQueue::flushErrorCount() {
     errorFlusher.flushErrorCount(logger, nonSilencedErrorCount);
 }
 
-void ErrorQueue::flushAutocorrects(const GlobalState &gs, FileSystem &fs) {
-    errorFlusher.flushAutocorrects(gs, fs);
+void ErrorQueue::flushAutocorrects(const GlobalState &gs, FileSystem &fs, WorkerPool &workers) {
+    errorFlusher.flushAutocorrects(gs, fs, workers);
 }
 
 void ErrorQueue::pushError(const core::GlobalState &gs, unique_ptr<core::Error> error) {
+    if (probeOfThisThread != nullptr) {
+        probeOfThisThread->sawError = true;
+        return;
+    }
     core::ErrorQueueMessage msg;
     msg.kind = core::ErrorQueueMessage::Kind::Error;
     msg.whatFile = error->loc.file();
+    pushedByThisThread++;
     if (!error->isSilenced) {
         this->nonSilencedErrorCount.fetch_add(1);
         // Serializing errors is expensive, so we only serialize them if the error isn't silenced.
-        msg.text = error->toString(gs);
+        msg.text = errorRenderer ? errorRenderer(gs, *error) : error->toString(gs);
     }
     msg.error = move(error);
+    if (bufferOfThisThread != nullptr) {
+        bufferOfThisThread->emplace_back(move(msg));
+        return;
+    }
+    this->queue.push(move(msg), 1);
+}
+
+void ErrorQueue::pushBuffered(vector<ErrorQueueMessage> messages) {
+    for (auto &msg : messages) {
+        this->queue.push(move(msg), 1);
+    }
+}
+
+u4 ErrorQueue::errorsPushedByThisThread() {
+    return pushedByThisThread;
+}
+
+void ErrorQueue::pushRenderedError(RenderedError error) {
+    core::ErrorQueueMessage msg;
+    msg.kind = core::ErrorQueueMessage::Kind::Error;
+    msg.whatFile = error.file;
+    this->nonSilencedErrorCount.fetch_add(1);
+    msg.text = move(error.text);
+    msg.error = make_unique<core::Error>(core::Loc::none(error.file), core::ErrorClass{error.code, StrictLevel::None},
+                                         "", vector<ErrorSection>{}, vector<AutocorrectSuggestion>{}, false);
     this->queue.push(move(msg), 1);
 }
 
@@ -99,7 +181,7 @@ void ErrorQueue::collectForFile(core::FileRef whatFile, vector<unique_ptr<core::
     collected[whatFile].clear();
 };
 
-vector<unique_ptr<core::ErrorQueueMessage>> ErrorQueue::drainFlushed() {
+vector<unique_ptr<core::ErrorQueueMessage>> ErrorQueue::drainFlushed(vector<FileRef> *flushedFiles) {
     checkOwned();
 
     vector<unique_ptr<core::ErrorQueueMessage>> ret;
@@ -107,6 +189,9 @@ vector<unique_ptr<core::ErrorQueueMessage>> ErrorQueue::drainFlushed() {
     core::ErrorQueueMessage msg;
     for (auto result = queue.try_pop(msg); result.gotItem(); result = queue.try_pop(msg)) {
         if (msg.kind == core::ErrorQueueMessage::Kind::Flush) {
+            if (flushedFiles != nullptr) {
+                flushedFiles->emplace_back(msg.whatFile);
+            }
             collectForFile(msg.whatFile, ret);
             collectForFile(core::FileRef(), ret);
         } else {
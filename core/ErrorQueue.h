@@ -6,16 +6,19 @@
 #include "core/ErrorQueueMessage.h"
 #include "core/lsp/QueryResponse.h"
 #include <atomic>
+#include <functional>
 
 namespace sorbet {
 class FileSystem;
+class WorkerPool;
 
 namespace core {
 class ErrorQueue {
 private:
     void checkOwned();
     std::vector<std::unique_ptr<ErrorQueueMessage>> drainAll();
-    std::vector<std::unique_ptr<ErrorQueueMessage>> drainFlushed();
+    /** Also appends the file of every flush marker to `flushedFiles`, if given. */
+    std::vector<std::unique_ptr<ErrorQueueMessage>> drainFlushed(std::vector<FileRef> *flushedFiles = nullptr);
     void collectForFile(core::FileRef whatFile, std::vector<std::unique_ptr<core::ErrorQueueMessage>> &out);
     ErrorFlusher errorFlusher;
     const std::thread::id owner;
@@ -28,12 +31,31 @@ public:
     std::atomic<bool> hadCritical{false};
     std::atomic<int> nonSilencedErrorCount{0};
     bool ignoreFlushes{false};
+    /** When set, every error that gets flushed is also copied into `recordedErrors`. */
+    bool recordFlushedErrors{false};
+    std::vector<RenderedError> recordedErrors;
+    /** When set, the file of every error that gets flushed is added to `filesWithFlushedErrors`. */
+    bool recordFilesWithErrors{false};
+    UnorderedSet<FileRef> filesWithFlushedErrors;
+    /**
+     * When set, errors are rendered with this instead of Error::toString, and are flushed verbatim to
+     * `renderedOutput` instead of being logged. Used by machine-readable error formats; must be set before any error
+     * is pushed.
+     */
+    std::function<std::string(const GlobalState &, const Error &)> errorRenderer;
+    std::ostream *renderedOutput = nullptr;
 
     ErrorQueue(spdlog::logger &logger, spdlog::logger &tracer);
 
     /** register a new error to be reported */
     void pushError(const GlobalState &gs, std::unique_ptr<Error> error);
+    /** the number of errors, silenced ones included, that the calling thread has pushed to any ErrorQueue */
+    static u4 errorsPushedByThisThread();
+    /** register, in order, errors that were held back by an ErrorBuffer */
+    void pushBuffered(std::vector<ErrorQueueMessage> messages);
     void pushQueryResponse(std::unique_ptr<lsp::QueryResponse> response);
+    /** report an error that was rendered by an earlier run, e.g. one restored from a cache */
+    void pushRenderedError(RenderedError error);
     /** indicate that errors for `file` should be flushed on next call to to flushErrors */
     void markFileForFlushing(FileRef file);
     /** Extract all query responses. This discards all errors currently present in error Queue */
@@ -42,10 +64,48 @@ public:
     bool isEmpty();
     /** Extract all errors. This discards all query responses currently present in error Queue */
     std::vector<std::unique_ptr<core::Error>> drainAllErrors();
+    /**
+     * Extract the errors of the files marked for flushing so far, along with those files; errors of other files stay in
+     * the queue. Like flushErrors, but for callers that report errors themselves. Discards query responses.
+     */
+    std::pair<std::vector<FileRef>, std::vector<std::unique_ptr<core::Error>>> drainFlushedErrors();
 
     void flushErrors(bool all = false);
     void flushErrorCount();
-    void flushAutocorrects(const GlobalState &gs, FileSystem &fs);
+    void flushAutocorrects(const GlobalState &gs, FileSystem &fs, WorkerPool &workers);
+};
+
+/**
+ * Holds back every error that the constructing thread pushes while the buffer is alive, so that work split across
+ * threads can still report its errors in a deterministic order through ErrorQueue::pushBuffered.
+ */
+class ErrorBuffer {
+    std::vector<ErrorQueueMessage> *previous;
+
+public:
+    std::vector<ErrorQueueMessage> messages;
+
+    ErrorBuffer();
+    ~ErrorBuffer();
+    ErrorBuffer(const ErrorBuffer &) = delete;
+    ErrorBuffer(ErrorBuffer &&) = delete;
+};
+
+/**
+ * Drops every error that the constructing thread pushes while the probe is alive, only remembering that there was one.
+ * Errors are neither rendered nor counted, so work can first be done cheaply and redone with full error reporting only
+ * when it turns out to report something.
+ */
+class ErrorProbe {
+    ErrorProbe *previous;
+
+public:
+    bool sawError = false;
+
+    ErrorProbe();
+    ~ErrorProbe();
+    ErrorProbe(const ErrorProbe &) = delete;
+    ErrorProbe(ErrorProbe &&) = delete;
 };
 
 } // namespace core
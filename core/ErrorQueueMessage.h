@@ -17,6 +17,14 @@ struct ErrorQueueMessage {
     std::unique_ptr<lsp::QueryResponse> queryResponse;
 };
 
+// An error that has already been turned into text, detached from the GlobalState that reported it.
+struct RenderedError {
+    core::FileRef file;
+    u2 code;
+    bool isCritical = false;
+    std::string text;
+};
+
 } // namespace sorbet::core
 
 #endif
@@ -1,6 +1,9 @@
 #include "core/Files.h"
+#include "common/FileOps.h"
+#include "common/crypto_hashing/crypto_hashing.h"
 #include "core/Context.h"
 #include "core/GlobalState.h"
+#include <cstring>
 #include <vector>
 
 #include "absl/strings/match.h"
@@ -13,20 +16,43 @@ namespace sorbet::core {
 
 vector<int> findLineBreaks(string_view s) {
     vector<int> res;
-    int i = -1;
     res.emplace_back(-1);
-    for (auto c : s) {
-        i++;
-        if (c == '\n') {
-            res.emplace_back(i);
-        }
+    // memchr scans a vector register's worth of bytes at a time, which is much faster than looking at every byte.
+    const char *begin = s.data();
+    const char *end = begin + s.size();
+    for (auto *nl = begin; (nl = static_cast<const char *>(memchr(nl, '\n', end - nl))) != nullptr; nl++) {
+        res.emplace_back(nl - begin);
     }
-    // We start at -1 so the last character of the file is actually i+1
-    res.emplace_back(i + 1);
-    ENFORCE(i + 1 == s.size());
+    // The break after the last line is one past the last character of the file
+    res.emplace_back(s.size());
     return res;
 }
 
+namespace {
+// Every 1 << LINE_INDEX_BLOCK_BITS bytes of source get an entry in LineIndex::blockStarts.
+constexpr u4 LINE_INDEX_BLOCK_BITS = 8;
+} // namespace
+
+struct File::LineIndex {
+    vector<int> lineBreaks;
+    // blockStarts[b] is the index of the first line break at or after offset b << LINE_INDEX_BLOCK_BITS.
+    vector<int> blockStarts;
+
+    explicit LineIndex(string_view source) : lineBreaks(findLineBreaks(source)) {
+        // One extra block past the end, so that the block of every offset up to source.size() has a successor.
+        int blocks = (source.size() >> LINE_INDEX_BLOCK_BITS) + 2;
+        blockStarts.reserve(blocks);
+        int breakIdx = 0;
+        for (int block = 0; block < blocks; block++) {
+            int blockStart = block << LINE_INDEX_BLOCK_BITS;
+            while (breakIdx < lineBreaks.size() && lineBreaks[breakIdx] < blockStart) {
+                breakIdx++;
+            }
+            blockStarts.emplace_back(breakIdx);
+        }
+    }
+};
+
 StrictLevel File::fileSigil(string_view source) {
     /*
      * StrictLevel::None: <none>
@@ -98,22 +124,38 @@ StrictLevel File::fileSigil(string_view source) {
 }
 
 File::File(string &&path_, string &&source_, Type sourceType)
-    : sourceType(sourceType), path_(path_), source_(source_), originalSigil(fileSigil(this->source_)),
+    : sourceType(sourceType), path_(move(path_)), ownedSource_(move(source_)), source_(this->ownedSource_),
+      originalSigil(fileSigil(this->source_)), strictLevel(originalSigil) {}
+
+File::File(string &&path_, shared_ptr<MappedFile> mapping, Type sourceType)
+    : sourceType(sourceType), path_(move(path_)), mapping_(move(mapping)), source_(this->mapping_->contents()),
+      originalSigil(fileSigil(this->source_)), strictLevel(originalSigil) {}
+
+File::File(string &&path_, BorrowedSource source, Type sourceType)
+    : sourceType(sourceType), path_(move(path_)), source_(source.source), originalSigil(fileSigil(this->source_)),
       strictLevel(originalSigil) {}
 
 unique_ptr<File> File::deepCopy(GlobalState &gs) const {
-    string sourceCopy = source_;
     string pathCopy = path_;
-    auto ret = make_unique<File>(move(pathCopy), move(sourceCopy), sourceType);
+    unique_ptr<File> ret;
+    if (mapping_ != nullptr) {
+        // The mapping is read-only, so copies can share it.
+        ret = make_unique<File>(move(pathCopy), mapping_, sourceType);
+    } else if (source_.data() != ownedSource_.data()) {
+        ret = make_unique<File>(move(pathCopy), BorrowedSource{source_}, sourceType);
+    } else {
+        string sourceCopy = ownedSource_;
+        ret = make_unique<File>(move(pathCopy), move(sourceCopy), sourceType);
+    }
     ret->lineBreaks_ = lineBreaks_;
+    ret->commentRunStarts_ = atomic_load(&commentRunStarts_);
     ret->minErrorLevel_ = minErrorLevel_;
+    ret->contentHash_ = atomic_load(&contentHash_);
     ret->strictLevel = strictLevel;
     return ret;
 }
 
-FileRef::FileRef(unsigned int id) : _id(id) {
-    ENFORCE(((u2)id) == id, "FileRef overflow. Do you have 2^16 files?");
-}
+FileRef::FileRef(unsigned int id) : _id(id) {}
 
 const File &FileRef::data(const GlobalState &gs) const {
     ENFORCE(gs.files[_id]);
@@ -165,24 +207,56 @@ bool File::isStdlib() const {
     return fileSigil(source()) == StrictLevel::Stdlib;
 }
 
-vector<int> &File::lineBreaks() const {
+const File::LineIndex &File::lineIndex() const {
     ENFORCE(this->sourceType != Type::TombStone);
     ENFORCE(this->sourceType != File::NotYetRead);
     auto ptr = atomic_load(&lineBreaks_);
     if (ptr) {
         return *ptr;
     } else {
-        auto my = make_shared<vector<int>>(findLineBreaks(this->source_));
+        auto my = make_shared<LineIndex>(this->source_);
         atomic_compare_exchange_weak(&lineBreaks_, &ptr, my);
-        return lineBreaks();
+        return lineIndex();
     }
 }
 
+const array<u1, 16> &File::contentHash() const {
+    ENFORCE(this->sourceType != File::NotYetRead);
+    auto ptr = atomic_load(&contentHash_);
+    if (ptr) {
+        return *ptr;
+    }
+    auto my = make_shared<const array<u1, 16>>(crypto_hashing::hash16(this->source_));
+    atomic_compare_exchange_strong(&contentHash_, &ptr, my);
+    return *atomic_load(&contentHash_);
+}
+
+void File::trustContentHash(const array<u1, 16> &hash) {
+    shared_ptr<const array<u1, 16>> expected;
+    if (atomic_compare_exchange_strong(&contentHash_, &expected, make_shared<const array<u1, 16>>(hash))) {
+        contentHashTrusted_ = true;
+    }
+}
+
+vector<int> &File::lineBreaks() const {
+    return const_cast<vector<int> &>(lineIndex().lineBreaks);
+}
+
+int File::lineBreakIndexAtOrAfter(u4 offset) const {
+    const auto &index = lineIndex();
+    auto block = offset >> LINE_INDEX_BLOCK_BITS;
+    ENFORCE(block + 1 < index.blockStarts.size());
+    // Every break in [blockStarts[block], blockStarts[block + 1]) lies in the same block as `offset`.
+    auto begin = index.lineBreaks.begin() + index.blockStarts[block];
+    auto end = index.lineBreaks.begin() + index.blockStarts[block + 1];
+    return lower_bound(begin, end, (int)offset) - index.lineBreaks.begin();
+}
+
 int File::lineCount() const {
     return lineBreaks().size() - 1;
 }
 
-string_view File::getLine(int i) {
+string_view File::getLine(int i) const {
     auto &lineBreaks = this->lineBreaks();
     ENFORCE(i < lineBreaks.size());
     ENFORCE(i > 0);
@@ -191,4 +265,26 @@ string_view File::getLine(int i) {
     return source().substr(start, end - start);
 }
 
+int File::commentRunStart(int i) const {
+    auto ptr = atomic_load(&commentRunStarts_);
+    if (!ptr) {
+        auto &lineBreaks = this->lineBreaks();
+        auto runStarts = make_shared<vector<u4>>(lineBreaks.size());
+        for (u4 line = 1; line < lineBreaks.size(); line++) {
+            auto text = getLine(line);
+            if (text.find('#') == string_view::npos) {
+                (*runStarts)[line] = line + 1;
+            } else {
+                auto previous = (*runStarts)[line - 1];
+                (*runStarts)[line] = line > 1 && previous < line ? previous : line;
+            }
+        }
+        shared_ptr<const vector<u4>> my = move(runStarts);
+        atomic_compare_exchange_strong(&commentRunStarts_, &ptr, my);
+        ptr = atomic_load(&commentRunStarts_);
+    }
+    ENFORCE(i > 0 && i < ptr->size());
+    return (*ptr)[i];
+}
+
 } // namespace sorbet::core
@@ -3,8 +3,13 @@
 
 #include "core/Names.h"
 #include "core/StrictLevel.h"
+#include <array>
 #include <string>
 
+namespace sorbet {
+class MappedFile;
+}
+
 namespace sorbet::core {
 class GlobalState;
 class File;
@@ -39,7 +44,7 @@ public:
         return _id > rhs._id;
     }
 
-    inline u2 id() const {
+    inline u4 id() const {
         return _id;
     }
 
@@ -53,9 +58,9 @@ public:
     File &dataAllowingUnsafe(GlobalState &gs) const;
 
 private:
-    u2 _id;
+    u4 _id;
 };
-CheckSize(FileRef, 2, 2);
+CheckSize(FileRef, 4, 4);
 
 class File final {
 public:
@@ -85,22 +90,65 @@ public:
     bool isStdlib() const;
 
     File(std::string &&path_, std::string &&source_, Type sourceType);
+    // Builds a File whose source is a view into `mapping`, rather than an owned copy.
+    File(std::string &&path_, std::shared_ptr<MappedFile> mapping, Type sourceType);
+    // Builds a File whose source is a view into memory that outlives it, like the payload compiled into the binary:
+    // its pages are then only read when something looks at the source.
+    struct BorrowedSource {
+        std::string_view source;
+    };
+    File(std::string &&path_, BorrowedSource source, Type sourceType);
     File(File &&other) = delete;
     File(const File &other) = delete;
     File() = delete;
     std::unique_ptr<File> deepCopy(GlobalState &) const;
     std::vector<int> &lineBreaks() const;
+    /**
+     * The index of the first entry of lineBreaks() that is >= `offset`, as std::lower_bound would find it. A coarse
+     * per-block index narrows the search to the few line breaks near `offset`.
+     */
+    int lineBreakIndexAtOrAfter(u4 offset) const;
     int lineCount() const;
     StrictLevel minErrorLevel() const;
+    // crypto_hashing::hash16 of source(), computed the first time anything asks for it. Cache keys for the file's
+    // trees, its plugin output and its state hash are all derived from it, so the source is only hashed once per run.
+    const std::array<u1, 16> &contentHash() const;
+    /**
+     * Seeds contentHash() with the digest an earlier run recorded for this same file on disk, so that the source is
+     * not read just to hash it again.
+     */
+    void trustContentHash(const std::array<u1, 16> &hash);
+    bool contentHashTrusted() const {
+        return contentHashTrusted_;
+    }
+    // The mapping the source is a view into, or nullptr if the source is owned or borrowed.
+    const MappedFile *mapping() const {
+        return mapping_.get();
+    }
 
     /** Given a 1-based line number, returns a string view of the line. */
-    std::string_view getLine(int i);
+    std::string_view getLine(int i) const;
+    /**
+     * The first line of the run of consecutive lines ending at 1-based line `i` that all contain a `#`, or `i + 1` if
+     * line `i` contains none. Computed for the whole file the first time anything asks, so that the comments above a
+     * definition can be found without scanning back through the source.
+     */
+    int commentRunStart(int i) const;
 
 private:
     const std::string path_;
-    const std::string source_;
-    mutable std::shared_ptr<std::vector<int>> lineBreaks_;
+    // Empty when the source is backed by `mapping_` or borrowed.
+    const std::string ownedSource_;
+    const std::shared_ptr<MappedFile> mapping_;
+    const std::string_view source_;
+    struct LineIndex;
+    const LineIndex &lineIndex() const;
+    mutable std::shared_ptr<LineIndex> lineBreaks_;
+    // commentRunStarts_[i] is commentRunStart(i)
+    mutable std::shared_ptr<const std::vector<u4>> commentRunStarts_;
     mutable StrictLevel minErrorLevel_ = StrictLevel::Max;
+    mutable std::shared_ptr<const std::array<u1, 16>> contentHash_;
+    bool contentHashTrusted_ = false;
 
 public:
     const StrictLevel originalSigil;
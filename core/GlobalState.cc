@@ -11,6 +11,7 @@
 #include "core/errors/errors.h"
 #include <utility>
 
+#include "absl/algorithm/container.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "core/errors/infer.h"
@@ -43,11 +44,45 @@ SymbolRef GlobalState::synthesizeClass(NameRef nameId, u4 superclass, bool isMod
 }
 
 atomic<int> globalStateIdCounter(1);
+atomic<u4> concurrentIndexingEpochCounter(1);
+
+namespace {
+// The names each thread most recently entered during concurrent indexing, so that the identifiers a file repeats
+// don't all take the name table lock. Names are never removed and never move, so an entry stays valid for the
+// whole session it was recorded in.
+struct RecentNames {
+    struct Entry {
+        u4 epoch = 0;
+        u4 hash = 0;
+        u4 id = 0;
+    };
+    static constexpr u4 SIZE = 4096;
+    Entry entries[SIZE];
+
+    Entry &slot(u4 hash) {
+        return entries[hash & (SIZE - 1)];
+    }
+};
+thread_local RecentNames recentNames;
+
+// Returns the cache slot for `hash` while `gs` is being indexed concurrently, and nullptr otherwise.
+RecentNames::Entry *recentNameSlot(bool concurrent, u4 hash) {
+    return concurrent ? &recentNames.slot(hash) : nullptr;
+}
+
+NameRef rememberName(RecentNames::Entry *slot, u4 epoch, u4 hash, NameRef name) {
+    if (slot != nullptr) {
+        *slot = RecentNames::Entry{epoch, hash, (u4)name.id()};
+    }
+    return name;
+}
+} // namespace
 const int Symbols::MAX_PROC_ARITY;
 
 GlobalState::GlobalState(shared_ptr<ErrorQueue> errorQueue)
     : globalStateId(globalStateIdCounter.fetch_add(1)), errorQueue(std::move(errorQueue)),
-      lspQuery(lsp::Query::noQuery()) {
+      typeInterner(make_shared<TypeInterner>()), typeShowCache(make_unique<TypeShowCache>()),
+      overrideCheckCache(make_shared<OverrideCheckCache>()), lspQuery(lsp::Query::noQuery()) {
     // Empirically determined to be the smallest powers of two larger than the
     // values required by the payload
     unsigned int maxNameCount = 8192;
@@ -60,13 +95,19 @@ GlobalState::GlobalState(shared_ptr<ErrorQueue> errorQueue)
     ENFORCE((namesByHashSize & (namesByHashSize - 1)) == 0, "namesByHashSize is not a power of 2");
 }
 
+GlobalState::GlobalState(shared_ptr<ErrorQueue> errorQueue, const GlobalState &copyOf)
+    : globalStateId(globalStateIdCounter.fetch_add(1)), errorQueue(std::move(errorQueue)),
+      typeInterner(copyOf.typeInterner), typeShowCache(make_unique<TypeShowCache>()),
+      ancestorIndex(copyOf.ancestorIndex), overrideCheckCache(copyOf.overrideCheckCache),
+      lspQuery(lsp::Query::noQuery()) {}
+
 void GlobalState::initEmpty() {
     UnfreezeFileTable fileTableAccess(*this);
     UnfreezeNameTable nameTableAccess(*this);
     UnfreezeSymbolTable symTableAccess(*this);
-    names.emplace_back(); // first name is used in hashes to indicate empty cell
-    names[0].kind = NameKind::UTF8;
-    names[0].raw.utf8 = string_view();
+    auto &emptyName = names.emplace_back(); // first name is used in hashes to indicate empty cell
+    emptyName.kind = NameKind::UTF8;
+    emptyName.raw.utf8 = string_view();
     Names::registerNames(*this);
 
     SymbolRef id;
@@ -509,14 +550,16 @@ void GlobalState::initEmpty() {
 }
 
 void GlobalState::installIntrinsics() {
+    u4 intrinsicId = 0;
     for (auto &entry : intrinsicMethods) {
+        intrinsicId++;
         auto symbol = entry.symbol;
         if (entry.singleton) {
             symbol = symbol.data(*this)->singletonClass(*this);
         }
         auto countBefore = symbolsUsed();
         SymbolRef method = enterMethodSymbol(Loc::none(), symbol, entry.method);
-        method.data(*this)->intrinsic = entry.impl;
+        method.data(*this)->intrinsicId = intrinsicId;
         if (countBefore != symbolsUsed()) {
             auto &blkArg = enterMethodArgumentSymbol(Loc::none(), method, Names::blkArg());
             blkArg.flags.isBlock = true;
@@ -546,6 +589,10 @@ void GlobalState::reserveMemory(u4 kb) {
     u4 scale = nextPowerOfTwo(want / allocated);
     symbols.reserve(symbols.capacity() * scale);
     expandNames(scale);
+    // Since we know the tables will grow this large, allocate them now, on huge pages where available, instead of
+    // page faulting them in one page at a time during indexing.
+    symbols.preallocate(symbols.capacity());
+    names.preallocate(names.capacity());
     sanityCheck();
 
     allocated = (sizeof(Name) + sizeof(decltype(namesByHash)::value_type)) * names.capacity() +
@@ -555,6 +602,16 @@ void GlobalState::reserveMemory(u4 kb) {
                        " names=", names.capacity()));
 }
 
+void GlobalState::reserveNames(u4 count) {
+    if (count <= names.capacity()) {
+        return;
+    }
+    // expandNames needs a power of two to keep `namesByHash` a power of two in size.
+    expandNames(nextPowerOfTwo((count + names.capacity() - 1) / names.capacity()));
+    sanityCheck();
+    trace(absl::StrCat("Reserved space for ", names.capacity(), " names"));
+}
+
 constexpr decltype(GlobalState::STRINGS_PAGE_SIZE) GlobalState::STRINGS_PAGE_SIZE;
 
 SymbolRef GlobalState::enterSymbol(Loc loc, SymbolRef owner, NameRef name, u4 flags) {
@@ -745,7 +802,24 @@ string_view GlobalState::enterString(string_view nm) {
 }
 
 NameRef GlobalState::enterNameUTF8(string_view nm) {
+    // Well-known names have the same id in every state that has them all, so the identifiers most files are full of
+    // (`new`, `sig`, `params`, ...) are found without hashing them or probing the table.
+    if (names.size() > Names::LAST_WELL_KNOWN_NAME) {
+        auto wellKnown = Names::lookupWellKnownUTF8(nm);
+        if (wellKnown.exists()) {
+            ENFORCE(names[wellKnown.id()].kind == NameKind::UTF8 && names[wellKnown.id()].raw.utf8 == nm);
+            return wellKnown;
+        }
+    }
     const auto hs = _hash(nm);
+    auto *recent = recentNameSlot(nameTableMutex != nullptr, hs);
+    if (recent != nullptr && recent->epoch == concurrentIndexingEpoch && recent->hash == hs) {
+        auto &nm2 = names[recent->id];
+        if (nm2.kind == NameKind::UTF8 && nm2.raw.utf8 == nm) {
+            return NameRef(*this, recent->id);
+        }
+    }
+    absl::MutexLockMaybe lock(nameTableMutex.get());
     unsigned int hashTableSize = namesByHash.size();
     unsigned int mask = hashTableSize - 1;
     auto bucketId = hs & mask;
@@ -758,7 +832,7 @@ NameRef GlobalState::enterNameUTF8(string_view nm) {
             auto &nm2 = names[nameId];
             if (nm2.kind == NameKind::UTF8 && nm2.raw.utf8 == nm) {
                 counterInc("names.utf8.hit");
-                return nm2.ref(*this);
+                return rememberName(recent, concurrentIndexingEpoch, hs, nm2.ref(*this));
             } else {
                 counterInc("names.hash_collision.utf8");
             }
@@ -786,15 +860,15 @@ NameRef GlobalState::enterNameUTF8(string_view nm) {
     auto &bucket = namesByHash[bucketId];
     bucket.first = hs;
     bucket.second = idx;
-    names.emplace_back();
+    auto &name = names.emplace_back();
 
-    names[idx].kind = NameKind::UTF8;
-    names[idx].raw.utf8 = enterString(nm);
-    ENFORCE(names[idx].hash(*this) == hs);
+    name.kind = NameKind::UTF8;
+    name.raw.utf8 = enterString(nm);
+    ENFORCE(name.hash(*this) == hs);
     categoryCounterInc("names", "utf8");
 
     wasModified_ = true;
-    return NameRef(*this, idx);
+    return rememberName(recent, concurrentIndexingEpoch, hs, NameRef(*this, idx));
 }
 
 NameRef GlobalState::enterNameConstant(NameRef original) {
@@ -805,6 +879,14 @@ NameRef GlobalState::enterNameConstant(NameRef original) {
             "making a constant name over wrong name kind");
 
     const auto hs = _hash_mix_constant(CONSTANT, original.id());
+    auto *recent = recentNameSlot(nameTableMutex != nullptr, hs);
+    if (recent != nullptr && recent->epoch == concurrentIndexingEpoch && recent->hash == hs) {
+        auto &nm2 = names[recent->id];
+        if (nm2.kind == CONSTANT && nm2.cnst.original == original) {
+            return NameRef(*this, recent->id);
+        }
+    }
+    absl::MutexLockMaybe lock(nameTableMutex.get());
     unsigned int hashTableSize = namesByHash.size();
     unsigned int mask = hashTableSize - 1;
     auto bucketId = hs & mask;
@@ -816,7 +898,7 @@ NameRef GlobalState::enterNameConstant(NameRef original) {
             auto &nm2 = names[bucket.second];
             if (nm2.kind == CONSTANT && nm2.cnst.original == original) {
                 counterInc("names.constant.hit");
-                return nm2.ref(*this);
+                return rememberName(recent, concurrentIndexingEpoch, hs, nm2.ref(*this));
             } else {
                 counterInc("names.hash_collision.constant");
             }
@@ -847,14 +929,14 @@ NameRef GlobalState::enterNameConstant(NameRef original) {
     bucket.second = names.size();
 
     auto idx = names.size();
-    names.emplace_back();
+    auto &name = names.emplace_back();
 
-    names[idx].kind = CONSTANT;
-    names[idx].cnst.original = original;
-    ENFORCE(names[idx].hash(*this) == hs);
+    name.kind = CONSTANT;
+    name.cnst.original = original;
+    ENFORCE(name.hash(*this) == hs);
     wasModified_ = true;
     categoryCounterInc("names", "constant");
-    return NameRef(*this, idx);
+    return rememberName(recent, concurrentIndexingEpoch, hs, NameRef(*this, idx));
 }
 
 NameRef GlobalState::enterNameConstant(string_view original) {
@@ -893,6 +975,7 @@ void GlobalState::expandNames(int growBy) {
 NameRef GlobalState::getNameUnique(UniqueNameKind uniqueNameKind, NameRef original, u2 num) const {
     ENFORCE(num > 0, "num == 0, name overflow");
     const auto hs = _hash_mix_unique((u2)uniqueNameKind, UNIQUE, num, original.id());
+    absl::MutexLockMaybe lock(nameTableMutex.get());
     unsigned int hashTableSize = namesByHash.size();
     unsigned int mask = hashTableSize - 1;
     auto bucketId = hs & mask;
@@ -919,6 +1002,15 @@ NameRef GlobalState::getNameUnique(UniqueNameKind uniqueNameKind, NameRef origin
 NameRef GlobalState::freshNameUnique(UniqueNameKind uniqueNameKind, NameRef original, u2 num) {
     ENFORCE(num > 0, "num == 0, name overflow");
     const auto hs = _hash_mix_unique((u2)uniqueNameKind, UNIQUE, num, original.id());
+    auto *recent = recentNameSlot(nameTableMutex != nullptr, hs);
+    if (recent != nullptr && recent->epoch == concurrentIndexingEpoch && recent->hash == hs) {
+        auto &nm2 = names[recent->id];
+        if (nm2.kind == UNIQUE && nm2.unique.uniqueNameKind == uniqueNameKind && nm2.unique.num == num &&
+            nm2.unique.original == original) {
+            return NameRef(*this, recent->id);
+        }
+    }
+    absl::MutexLockMaybe lock(nameTableMutex.get());
     unsigned int hashTableSize = namesByHash.size();
     unsigned int mask = hashTableSize - 1;
     auto bucketId = hs & mask;
@@ -931,7 +1023,7 @@ NameRef GlobalState::freshNameUnique(UniqueNameKind uniqueNameKind, NameRef orig
             if (nm2.kind == UNIQUE && nm2.unique.uniqueNameKind == uniqueNameKind && nm2.unique.num == num &&
                 nm2.unique.original == original) {
                 counterInc("names.unique.hit");
-                return nm2.ref(*this);
+                return rememberName(recent, concurrentIndexingEpoch, hs, nm2.ref(*this));
             } else {
                 counterInc("names.hash_collision.unique");
             }
@@ -962,20 +1054,21 @@ NameRef GlobalState::freshNameUnique(UniqueNameKind uniqueNameKind, NameRef orig
     bucket.second = names.size();
 
     auto idx = names.size();
-    names.emplace_back();
+    auto &name = names.emplace_back();
 
-    names[idx].kind = UNIQUE;
-    names[idx].unique.num = num;
-    names[idx].unique.uniqueNameKind = uniqueNameKind;
-    names[idx].unique.original = original;
-    ENFORCE(names[idx].hash(*this) == hs);
+    name.kind = UNIQUE;
+    name.unique.num = num;
+    name.unique.uniqueNameKind = uniqueNameKind;
+    name.unique.original = original;
+    ENFORCE(name.hash(*this) == hs);
     wasModified_ = true;
     categoryCounterInc("names", "unique");
-    return NameRef(*this, idx);
+    return rememberName(recent, concurrentIndexingEpoch, hs, NameRef(*this, idx));
 }
 
 FileRef GlobalState::enterFile(const shared_ptr<File> &file) {
     ENFORCE(!fileTableFrozen);
+    ENFORCE(nameTableMutex == nullptr, "only reserved files can be filled in during concurrent indexing");
 
     DEBUG_ONLY(for (auto &f
                     : this->files) {
@@ -1030,6 +1123,9 @@ void GlobalState::mangleRenameSymbol(SymbolRef what, NameRef origName) {
     ownerMembers.erase(fnd);
     ownerMembers[name] = what;
     whatData->name = name;
+    // Types that mention `what` show its name, so any symbol's ownHash may have changed.
+    ownHashes.clear();
+    symbolEpoch_++;
     if (whatData->isClass()) {
         auto singleton = whatData->lookupSingletonClass(*this);
         if (singleton.exists()) {
@@ -1042,6 +1138,25 @@ unsigned int GlobalState::symbolsUsed() const {
     return symbols.size();
 }
 
+GlobalState::MemoryUsage GlobalState::memoryUsage() const {
+    MemoryUsage usage;
+    usage.names = sizeof(Name) * names.capacity() + sizeof(decltype(namesByHash)::value_type) * namesByHash.capacity();
+    usage.symbols = sizeof(Symbol) * symbols.capacity();
+    for (u4 i = 0; i < symbols.size(); i++) {
+        usage.symbols += symbols[i].heapBytes();
+    }
+    for (auto &file : files) {
+        if (file != nullptr) {
+            usage.files += sizeof(File) + file->path().size() + file->source().size();
+        }
+    }
+    usage.files += fileRefByPath.capacity() * sizeof(decltype(fileRefByPath)::value_type);
+    for (auto &page : strings) {
+        usage.strings += page->capacity();
+    }
+    return usage;
+}
+
 unsigned int GlobalState::filesUsed() const {
     return files.size();
 }
@@ -1097,12 +1212,20 @@ void GlobalState::sanityCheck() const {
 }
 
 bool GlobalState::freezeNameTable() {
+    if (nameTableMutex != nullptr) {
+        // Stays unfrozen until the concurrent indexing ends.
+        return false;
+    }
     bool old = this->nameTableFrozen;
     this->nameTableFrozen = true;
     return old;
 }
 
 bool GlobalState::freezeFileTable() {
+    if (nameTableMutex != nullptr) {
+        // Stays unfrozen until the concurrent indexing ends.
+        return false;
+    }
     bool old = this->fileTableFrozen;
     this->fileTableFrozen = true;
     return old;
@@ -1115,12 +1238,20 @@ bool GlobalState::freezeSymbolTable() {
 }
 
 bool GlobalState::unfreezeNameTable() {
+    if (nameTableMutex != nullptr) {
+        // Pretend to every thread that it is the one unfreezing the table.
+        return true;
+    }
     bool old = this->nameTableFrozen;
     this->nameTableFrozen = false;
     return old;
 }
 
 bool GlobalState::unfreezeFileTable() {
+    if (nameTableMutex != nullptr) {
+        // Pretend to every thread that it is the one unfreezing the table.
+        return true;
+    }
     bool old = this->fileTableFrozen;
     this->fileTableFrozen = false;
     return old;
@@ -1132,10 +1263,33 @@ bool GlobalState::unfreezeSymbolTable() {
     return old;
 }
 
+bool GlobalState::beginConcurrentIndexing() {
+    ENFORCE(nameTableMutex == nullptr);
+    bool old = this->nameTableFrozen && this->fileTableFrozen;
+    this->nameTableFrozen = false;
+    this->fileTableFrozen = false;
+    // Every thread may look names up without the lock and may ask for mutable symbol data, so neither table may
+    // change shape under them: chunks shared with other states are copied now, and appending a name never moves the
+    // name chunk index.
+    names.unshareAll();
+    names.reserveEveryChunk();
+    symbols.unshareAll();
+    concurrentIndexingEpoch = concurrentIndexingEpochCounter.fetch_add(1);
+    nameTableMutex = make_unique<absl::Mutex>();
+    return old;
+}
+
+void GlobalState::endConcurrentIndexing() {
+    ENFORCE(nameTableMutex != nullptr);
+    nameTableMutex = nullptr;
+    this->nameTableFrozen = true;
+    this->fileTableFrozen = true;
+}
+
 unique_ptr<GlobalState> GlobalState::deepCopy(bool keepId) const {
     Timer timeit(tracer(), "GlobalState::deepCopy", this->creation);
     this->sanityCheck();
-    auto result = make_unique<GlobalState>(this->errorQueue);
+    unique_ptr<GlobalState> result(new GlobalState(this->errorQueue, *this));
 
     result->silenceErrors = this->silenceErrors;
     result->autocorrect = this->autocorrect;
@@ -1143,6 +1297,7 @@ unique_ptr<GlobalState> GlobalState::deepCopy(bool keepId) const {
     result->ensureCleanStrings = this->ensureCleanStrings;
     result->runningUnderAutogen = this->runningUnderAutogen;
     result->censorForSnapshotTests = this->censorForSnapshotTests;
+    result->optimizeCFG = this->optimizeCFG;
 
     if (keepId) {
         result->globalStateId = this->globalStateId;
@@ -1161,23 +1316,15 @@ unique_ptr<GlobalState> GlobalState::deepCopy(bool keepId) const {
     result->onlyErrorClasses = this->onlyErrorClasses;
     result->dslPlugins = this->dslPlugins;
     result->dslRubyExtraArgs = this->dslRubyExtraArgs;
-    result->names.reserve(this->names.capacity());
-    if (keepId) {
-        result->names.resize(this->names.size());
-        ::memcpy(result->names.data(), this->names.data(), this->names.size() * sizeof(Name));
-    } else {
-        for (auto &nm : this->names) {
-            result->names.emplace_back(nm.deepCopy(*result));
-        }
-    }
+    result->dslResidentPlugins = this->dslResidentPlugins;
+    // The name and symbol tables share their chunks with this state; either side copies a chunk when it first writes
+    // to it. The NameRefs inside stay valid for the copy, since deepCloneHistory attributes them to this state.
+    result->names = this->names;
 
-    result->namesByHash.reserve(this->namesByHash.size());
     result->namesByHash = this->namesByHash;
 
-    result->symbols.reserve(this->symbols.size());
-    for (auto &sym : this->symbols) {
-        result->symbols.emplace_back(sym.deepCopy(*result, keepId));
-    }
+    result->symbols = this->symbols;
+    result->ownHashes = this->ownHashes;
     result->pathPrefix = this->pathPrefix;
     result->sanityCheck();
     {
@@ -1187,6 +1334,56 @@ unique_ptr<GlobalState> GlobalState::deepCopy(bool keepId) const {
     return result;
 }
 
+unique_ptr<GlobalState> GlobalState::copyWithNamesBelow(u4 namesKept) const {
+    ENFORCE(namesKept > Names::LAST_WELL_KNOWN_NAME && namesKept <= namesUsed());
+    DEBUG_ONLY(for (auto &sym : symbols) { ENFORCE(sym.name.id() < namesKept); });
+    auto result = deepCopy();
+    // The names this state entered after the first `namesKept` mean nothing to the copy.
+    result->deepCloneHistory.back().lastNameKnownByParentGlobalState = namesKept;
+    result->names.truncate(namesKept);
+
+    fill(result->namesByHash.begin(), result->namesByHash.end(), make_pair(0u, 0u));
+    const unsigned int mask = result->namesByHash.size() - 1;
+    for (u4 id = 1; id < namesKept; id++) {
+        auto hs = result->names[id].hash(*result);
+        unsigned int probe = 1;
+        auto bucketId = hs & mask;
+        while (result->namesByHash[bucketId].second != 0) {
+            bucketId = (bucketId + probe) & mask;
+            probe++;
+        }
+        result->namesByHash[bucketId] = make_pair(hs, id);
+    }
+
+    // Pages only ever hold the strings of names, so the ones no kept name points into can go.
+    vector<pair<const char *, int>> pageStarts;
+    for (int i = 0; i < strings.size(); i++) {
+        pageStarts.emplace_back(strings[i]->data(), i);
+    }
+    fast_sort(pageStarts);
+    vector<bool> pageUsed(strings.size());
+    for (u4 id = 1; id < namesKept; id++) {
+        auto &nm = names[id];
+        if (nm.kind != NameKind::UTF8 || nm.raw.utf8.empty()) {
+            continue;
+        }
+        auto page = upper_bound(pageStarts.begin(), pageStarts.end(), make_pair(nm.raw.utf8.data(), (int)strings.size()));
+        ENFORCE(page != pageStarts.begin());
+        pageUsed[prev(page)->second] = true;
+    }
+    result->strings.clear();
+    for (int i = 0; i < strings.size(); i++) {
+        if (pageUsed[i]) {
+            result->strings.emplace_back(strings[i]);
+        }
+    }
+    if (result->strings.empty()) {
+        result->strings.emplace_back(make_shared<vector<char>>(GlobalState::STRINGS_PAGE_SIZE));
+    }
+    result->sanityCheck();
+    return result;
+}
+
 string_view GlobalState::getPrintablePath(string_view path) const {
     // Only strip the path prefix if the path has it.
     if (path.substr(0, pathPrefix.length()) == pathPrefix) {
@@ -1220,9 +1417,12 @@ ErrorBuilder GlobalState::beginError(Loc loc, ErrorClass what) const {
     if (what == errors::Internal::InternalError) {
         Exception::failInFuzzer();
     }
-    bool report = (what == errors::Internal::InternalError) || (what == errors::Internal::FileNotFound) ||
-                  (shouldReportErrorOn(loc, what) && !this->silenceErrors);
-    return ErrorBuilder(*this, report, loc, what);
+    return ErrorBuilder(*this, wouldReportErrorOn(loc, what), loc, what);
+}
+
+bool GlobalState::wouldReportErrorOn(Loc loc, ErrorClass what) const {
+    return (what == errors::Internal::InternalError) || (what == errors::Internal::FileNotFound) ||
+           (shouldReportErrorOn(loc, what) && !this->silenceErrors);
 }
 
 void GlobalState::suppressErrorClass(int code) {
@@ -1295,6 +1495,10 @@ bool GlobalState::wasModified() const {
     return wasModified_;
 }
 
+bool GlobalState::indexingConcurrently() const {
+    return nameTableMutex != nullptr;
+}
+
 void GlobalState::trace(string_view msg) const {
     errorQueue->tracer.trace(msg);
 }
@@ -1342,19 +1546,30 @@ u4 patchHash(u4 hash) {
     return hash;
 }
 
+u4 GlobalState::cachedOwnHash(u4 id) const {
+    auto &cached = ownHashes[id];
+    if (cached == 0) {
+        // A symbol whose ownHash really is 0 is simply recomputed every time.
+        cached = symbols[id].ownHash(*this);
+    }
+    return cached;
+}
+
 unique_ptr<GlobalStateHash> GlobalState::hash() const {
     constexpr bool DEBUG_HASHING_TAIL = false;
     u4 hierarchyHash = 0;
     UnorderedMap<NameHash, u4> methodHashes;
     int counter = 0;
+    // Only the symbols written to since the last call need their ownHash recomputed.
+    ownHashes.resize(symbolsUsed(), 0);
     for (const auto &sym : this->symbols) {
         if (!sym.ignoreInHashing(*this)) {
             if (sym.isMethod()) {
                 auto &target = methodHashes[NameHash(*this, sym.name.data(*this))];
-                target = mix(target, sym.hash(*this));
+                target = mix(target, sym.hash(*this, cachedOwnHash(counter)));
                 hierarchyHash = mix(hierarchyHash, sym.methodShapeHash(*this));
             } else {
-                hierarchyHash = mix(hierarchyHash, sym.hash(*this));
+                hierarchyHash = mix(hierarchyHash, sym.hash(*this, cachedOwnHash(counter)));
             }
         }
         counter++;
@@ -1370,6 +1585,23 @@ unique_ptr<GlobalStateHash> GlobalState::hash() const {
     return result;
 }
 
+vector<pair<u4, NameHash>> GlobalState::definitionShapes() const {
+    vector<pair<u4, NameHash>> result;
+    for (const auto &sym : this->symbols) {
+        if (sym.ignoreInHashing(*this)) {
+            continue;
+        }
+        bool definedInFile = absl::c_any_of(sym.locs(), [&](const auto &loc) -> bool {
+            return loc.file().exists() && loc.file().data(*this).sourceType == File::Type::Normal;
+        });
+        if (definedInFile) {
+            result.emplace_back(sym.definitionShapeHash(*this), NameHash(*this, sym.name.data(*this)));
+        }
+    }
+    fast_sort(result);
+    return result;
+}
+
 vector<shared_ptr<File>> GlobalState::getFiles() const {
     return files;
 }
@@ -2,12 +2,16 @@
 #define SORBET_GLOBAL_STATE_H
 #include "absl/synchronization/mutex.h"
 
+#include "core/AncestorIndex.h"
 #include "core/Error.h"
 #include "core/ErrorQueue.h"
 #include "core/Files.h"
 #include "core/Loc.h"
 #include "core/Names.h"
+#include "core/OverrideCheckCache.h"
 #include "core/Symbols.h"
+#include "core/TypeInterner.h"
+#include "core/TypeShowCache.h"
 #include "core/lsp/Query.h"
 #include <memory>
 
@@ -18,9 +22,11 @@ class NameRef;
 class Symbol;
 class SymbolRef;
 class GlobalSubstitution;
+class LazyGlobalSubstitution;
 class ErrorRegion;
 class ErrorQueue;
 struct GlobalStateHash;
+class NameHash;
 
 namespace serialize {
 class Serializer;
@@ -35,6 +41,7 @@ class GlobalState final {
     friend File;
     friend FileRef;
     friend GlobalSubstitution;
+    friend LazyGlobalSubstitution;
     friend ErrorRegion;
     friend ErrorBuilder;
     friend serialize::Serializer;
@@ -42,8 +49,13 @@ class GlobalState final {
     friend class UnfreezeNameTable;
     friend class UnfreezeSymbolTable;
     friend class UnfreezeFileTable;
+    friend class UnfreezeForConcurrentIndexing;
     friend struct NameRefDebugCheck;
 
+    // For deepCopy: shares `copyOf`'s caches, and leaves the tables empty for deepCopy to share or copy, instead of
+    // allocating tables and caches that deepCopy would throw away.
+    GlobalState(std::shared_ptr<ErrorQueue> errorQueue, const GlobalState &copyOf);
+
 public:
     GlobalState(std::shared_ptr<ErrorQueue> errorQueue);
 
@@ -53,6 +65,8 @@ public:
     // Expand tables to use approximate `kb` KiB of memory. Can be used prior to
     // operation to avoid table resizes.
     void reserveMemory(u4 kb);
+    // Grows the name table so that it holds at least `count` names before it next has to be rehashed.
+    void reserveNames(u4 count);
 
     GlobalState(const GlobalState &) = delete;
     GlobalState(GlobalState &&) = delete;
@@ -99,6 +113,16 @@ public:
     unsigned int symbolsUsed() const;
     unsigned int filesUsed() const;
 
+    // Roughly how much memory each of the tables takes up. Deep copies share most of it, so the numbers of a state
+    // and its copies don't add up.
+    struct MemoryUsage {
+        u8 names = 0;
+        u8 symbols = 0;
+        u8 files = 0;
+        u8 strings = 0;
+    };
+    MemoryUsage memoryUsage() const;
+
     void sanityCheck() const;
     void markAsPayload();
 
@@ -128,10 +152,19 @@ public:
     bool hadCriticalError() const;
 
     ErrorBuilder beginError(Loc loc, ErrorClass what) const;
+    /**
+     * Whether beginError(loc, what) would return a live ErrorBuilder, without making one. Work that only feeds an
+     * error's message belongs inside `if (auto e = beginError(...))`; this is for work that has to be set up before.
+     * Note that skipping such work also skips the silenced error, which still counts towards File::minErrorLevel.
+     */
+    bool wouldReportErrorOn(Loc loc, ErrorClass what) const;
     void _error(std::unique_ptr<Error> error) const;
 
     int totalErrors() const;
     bool wasModified() const;
+    // Whether several threads are indexing into this state (see UnfreezeForConcurrentIndexing), so that any of them
+    // may enter names.
+    bool indexingConcurrently() const;
 
     int globalStateId;
     bool silenceErrors = false;
@@ -151,9 +184,28 @@ public:
     // (hint: probably you want to find an alternate solution)
     bool runningUnderAutogen = false;
     bool censorForSnapshotTests = false;
+    // Lets the CFG builder remove constant loads that nothing reads (see --optimize-cfg).
+    bool optimizeCFG = false;
 
     std::unique_ptr<GlobalState> deepCopy(bool keepId = false) const;
+    // Like deepCopy, but only keeps the first `namesKept` names, and the pages of `strings` that they are in. Every
+    // symbol's name must be among those. Trees move over with a LazyGlobalSubstitution, which enters the other names
+    // they still use again.
+    std::unique_ptr<GlobalState> copyWithNamesBelow(u4 namesKept) const;
     mutable std::shared_ptr<ErrorQueue> errorQueue;
+    // Shared by deep copies. Symbol ids only ever get appended, so interned types stay valid in every copy.
+    std::shared_ptr<TypeInterner> typeInterner;
+    // Not shared by deep copies, since what a type shows as depends on the names of this state's symbols.
+    std::unique_ptr<TypeShowCache> typeShowCache;
+    // Bumped whenever a symbol is renamed or the symbol table is replaced, which are the only changes to how a type
+    // mentioning a symbol shows. Entries of typeShowCache from an older epoch are ignored.
+    u4 symbolEpoch() const {
+        return symbolEpoch_;
+    }
+    // Set by the resolver once the class hierarchy is final, and dropped whenever it starts changing it again.
+    std::shared_ptr<const AncestorIndex> ancestorIndex;
+    // Shared by deep copies, like typeInterner. Entries are tied to the ancestorIndex they were made under.
+    std::shared_ptr<OverrideCheckCache> overrideCheckCache;
 
     // Contains a path prefix that should be stripped from all printed paths.
     std::string pathPrefix;
@@ -173,6 +225,8 @@ public:
     void trace(std::string_view msg) const;
 
     std::unique_ptr<GlobalStateHash> hash() const;
+    /** GlobalStateHash::definitionShapes of the symbols defined in files that aren't payload files. */
+    std::vector<std::pair<u4, NameHash>> definitionShapes() const;
     std::vector<std::shared_ptr<File>> getFiles() const;
 
     // Contains a string to be used as the base of the error URL.
@@ -182,6 +236,8 @@ public:
     void onlyShowErrorClass(int code);
 
     std::vector<std::string> dslRubyExtraArgs;
+    // Run DSL plugins inside long-lived Ruby processes, and reuse their output for repeated calls.
+    bool dslResidentPlugins = false;
     void addDslPlugin(std::string_view method, std::string_view command);
     std::optional<std::string_view> findDslPlugin(NameRef method) const;
     bool hasAnyDslPlugin() const;
@@ -198,9 +254,15 @@ private:
     std::vector<std::shared_ptr<std::vector<char>>> strings;
     std::string_view enterString(std::string_view nm);
     u2 stringsLastPageUsed = STRINGS_PAGE_SIZE + 1;
-    std::vector<Name> names;
+    CopyOnWriteVector<Name> names;
     UnorderedMap<std::string, FileRef> fileRefByPath;
-    std::vector<Symbol> symbols;
+    CopyOnWriteVector<Symbol> symbols;
+    // Symbol::ownHash of each symbol, or 0 if it has not been computed since the symbol was last handed out for
+    // writing (see SymbolRef::data). Kept here rather than on the Symbol because this state may share a chunk of
+    // symbols with others, which would otherwise race on it.
+    mutable std::vector<u4> ownHashes;
+    u4 cachedOwnHash(u4 id) const;
+    u4 symbolEpoch_ = 0;
     std::vector<std::pair<unsigned int, unsigned int>> namesByHash;
     std::vector<std::shared_ptr<File>> files;
     UnorderedSet<int> suppressedErrorClasses;
@@ -218,6 +280,14 @@ private:
     bool symbolTableFrozen = true;
     bool fileTableFrozen = true;
 
+    // Non-null while several threads index into this state at once (see UnfreezeForConcurrentIndexing). Entering or
+    // looking up a name then takes this lock, and the name and file tables stay unfrozen.
+    std::unique_ptr<absl::Mutex> nameTableMutex;
+    // Identifies the current concurrent indexing session in the threads' caches of recently entered names.
+    u4 concurrentIndexingEpoch = 0;
+    bool beginConcurrentIndexing();
+    void endConcurrentIndexing();
+
     void expandNames(int growBy = 2);
 
     SymbolRef synthesizeClass(NameRef nameID, u4 superclass = Symbols::todo()._id, bool isModule = false);
@@ -35,6 +35,25 @@ private:
     const int toGlobalStateId;
 };
 
+/**
+ * Maps the names of `from` to those of `to`, a GlobalState::copyWithNamesBelow of it: the names both have stay as they
+ * are, and any other name is entered in `to` the first time it is substituted. Moving every live tree over this way
+ * leaves `to` with only the names that something still uses.
+ */
+class LazyGlobalSubstitution {
+public:
+    LazyGlobalSubstitution(const GlobalState &from, GlobalState &to);
+
+    NameRef substitute(NameRef from, bool allowSameFromTo = false);
+
+private:
+    const GlobalState &from;
+    GlobalState &to;
+    const u4 namesKept;
+    // Indexed by the id in `from` of a name that `to` doesn't have; 0 until it is entered.
+    std::vector<u4> nameSubstitution;
+};
+
 } // namespace sorbet::core
 
 #endif
@@ -28,15 +28,15 @@ Loc::Detail Loc::offset2Pos(const File &file, u4 off) {
 
     ENFORCE(off <= file.source().size(), "file offset out of bounds in file: {} @ {} <= {}", string(file.path()),
             to_string(off), to_string(file.source().size()));
-    auto it = absl::c_lower_bound(file.lineBreaks(), off);
-    if (it == file.lineBreaks().begin()) {
+    auto idx = file.lineBreakIndexAtOrAfter(off);
+    if (idx == 0) {
         pos.line = 1;
         pos.column = off + 1;
         return pos;
     }
-    --it;
-    pos.line = (it - file.lineBreaks().begin()) + 1;
-    pos.column = off - *it;
+    --idx;
+    pos.line = idx + 1;
+    pos.column = off - file.lineBreaks()[idx];
     return pos;
 }
 
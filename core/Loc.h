@@ -2,6 +2,7 @@
 #define SORBET_AST_LOC_H
 
 #include "Files.h"
+#include <tuple>
 
 namespace sorbet::core {
 namespace serialize {
@@ -11,10 +12,10 @@ class GlobalState;
 
 class Loc final {
     struct {
+        u4 fileRef;
         unsigned int beginLoc : 24;
         unsigned int endLoc : 24;
-        unsigned int fileRef : 16;
-    } __attribute__((packed, aligned(8))) storage;
+    } __attribute__((packed, aligned(4))) storage;
     template <typename H> friend H AbslHashValue(H h, const Loc &m);
     friend class sorbet::core::serialize::SerializerImpl;
 
@@ -56,7 +57,7 @@ public:
         }
     }
 
-    inline Loc(FileRef file, u4 begin, u4 end) : storage{begin, end, file.id()} {
+    inline Loc(FileRef file, u4 begin, u4 end) : storage{file.id(), begin, end} {
         ENFORCE(begin <= INVALID_POS_LOC);
         ENFORCE(end <= INVALID_POS_LOC);
         ENFORCE(begin <= end);
@@ -89,17 +90,15 @@ public:
     static u4 pos2Offset(const File &file, Detail pos);
     static Detail offset2Pos(const File &file, u4 off);
     static Loc fromDetails(const GlobalState &gs, FileRef fileRef, Detail begin, Detail end);
-    std::pair<u4, u4> getAs2u4() const {
-        auto low = (((u4)storage.beginLoc) << 8) + ((((u4)storage.fileRef) >> 8) & ((1 << 8) - 1));
-        auto high = (((u4)storage.endLoc) << 8) + ((((u4)storage.fileRef)) & ((1 << 8) - 1));
-        return {low, high};
+    std::tuple<u4, u4, u4> getAs3u4() const {
+        return {storage.beginLoc, storage.endLoc, storage.fileRef};
     };
 
     // Intentionally not a constructor because we don't want to ever be able to call it unintentionally
-    void setFrom2u4(u4 low, u4 high) {
-        storage.fileRef = (high & ((1 << 8) - 1)) + ((low & ((1 << 8) - 1)) << 8);
-        storage.endLoc = high >> 8;
-        storage.beginLoc = low >> 8;
+    void setFrom3u4(u4 begin, u4 end, u4 file) {
+        storage.beginLoc = begin;
+        storage.endLoc = end;
+        storage.fileRef = file;
     }
 
     // For a given Loc, returns
@@ -114,7 +113,7 @@ public:
         return Loc(file(), beginPos(), beginPos());
     }
 };
-CheckSize(Loc, 8, 8);
+CheckSize(Loc, 12, 4);
 
 template <typename H> H AbslHashValue(H h, const Loc &m) {
     return H::combine(std::move(h), m.storage.beginLoc, m.storage.endLoc, m.storage.fileRef);
@@ -45,6 +45,12 @@ struct GlobalStateHash {
     static constexpr int HASH_STATE_INVALID_COLLISION_AVOID = 3;
     u4 hierarchyHash = HASH_STATE_NOT_COMPUTED;
     UnorderedMap<NameHash, u4> methodHashes;
+    /**
+     * Symbol::definitionShapeHash and the name of every definition in a file, sorted. Only computed for the hashes of
+     * single files (see GlobalState::definitionShapes), where it tells edits that only add definitions apart from
+     * others.
+     */
+    std::vector<std::pair<u4, NameHash>> definitionShapes;
 };
 
 struct UsageHash {
@@ -5,18 +5,15 @@
 namespace sorbet::core {
 class GlobalState;
 class GlobalSubstitution;
+class LazyGlobalSubstitution;
 class Name;
 
-struct NameDataDebugCheck {
-    const GlobalState &gs;
-    const unsigned int nameCountAtCreation;
-
-    NameDataDebugCheck(const GlobalState &gs);
-    void check() const;
-};
-
-/** This is to `NameRef &` what SymbolData is to `SymbolRef &`. Read docs on SymbolData */
-class NameData : private DebugOnlyCheck<NameDataDebugCheck> {
+/**
+ * This is to `NameRef &` what SymbolData is to `SymbolRef &`. Names never move once entered, so unlike SymbolData
+ * it stays valid while other names are entered (which may happen on other threads, see
+ * UnfreezeForConcurrentIndexing).
+ */
+class NameData {
     Name &name;
 
 public:
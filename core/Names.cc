@@ -169,8 +169,7 @@ void Name::sanityCheck(const GlobalState &gs) const {
 }
 
 NameRef Name::ref(const GlobalState &gs) const {
-    auto distance = this - gs.names.data();
-    return NameRef(gs, distance);
+    return NameRef(gs, gs.names.indexOf(this));
 }
 
 bool Name::isClassName(const GlobalState &gs) const {
@@ -237,7 +236,7 @@ NameData NameRef::data(GlobalState &gs) const {
     ENFORCE(_id < gs.names.size(), "name id out of bounds");
     ENFORCE(exists(), "non existing name");
     enforceCorrectGlobalState(gs);
-    return NameData(gs.names[_id], gs);
+    return NameData(gs.names.mutableAt(_id), gs);
 }
 
 const NameData NameRef::data(const GlobalState &gs) const {
@@ -284,47 +283,13 @@ NameRef NameRef::prepend(GlobalState &gs, string_view s) const {
     return gs.enterNameUTF8(nameEq);
 }
 
-Name Name::deepCopy(const GlobalState &to) const {
-    Name out;
-    out.kind = this->kind;
-
-    switch (this->kind) {
-        case UTF8:
-            out.raw = this->raw;
-            break;
-
-        case UNIQUE:
-            out.unique.uniqueNameKind = this->unique.uniqueNameKind;
-            out.unique.num = this->unique.num;
-            out.unique.original = NameRef(to, this->unique.original.id());
-            break;
-
-        case CONSTANT:
-            out.cnst.original = NameRef(to, this->cnst.original.id());
-            break;
-
-        default:
-            Exception::notImplemented();
-    }
-
-    return out;
-}
-
-NameData::NameData(Name &ref, const GlobalState &gs) : DebugOnlyCheck(gs), name(ref) {}
-
-NameDataDebugCheck::NameDataDebugCheck(const GlobalState &gs) : gs(gs), nameCountAtCreation(gs.namesUsed()) {}
-
-void NameDataDebugCheck::check() const {
-    ENFORCE(nameCountAtCreation == gs.namesUsed());
-}
+NameData::NameData(Name &ref, const GlobalState &gs) : name(ref) {}
 
 Name *NameData::operator->() {
-    runDebugOnlyCheck();
     return &name;
 };
 
 const Name *NameData::operator->() const {
-    runDebugOnlyCheck();
     return &name;
 };
 
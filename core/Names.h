@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "core/CopyOnWriteVector.h"
 #include "core/NameRef.h"
 #include "core/Names_gen.h"
 
@@ -74,6 +75,10 @@ public:
 private:
     unsigned char UNUSED(_fill[3]);
 
+    // Only GlobalState's name table copies names, when it unshares a chunk.
+    template <class T, size_t ChunkBytes> friend class CopyOnWriteVector;
+    Name(const Name &other) = default;
+
 public:
     union { // todo: can discriminate this union through the pointer to Name
         // itself using lower bits
@@ -86,8 +91,6 @@ public:
 
     Name(Name &&other) noexcept = default;
 
-    Name(const Name &other) = delete;
-
     ~Name() noexcept;
 
     bool operator==(const Name &rhs) const;
@@ -102,7 +105,6 @@ public:
     void sanityCheck(const GlobalState &gs) const;
     NameRef ref(const GlobalState &gs) const;
 
-    Name deepCopy(const GlobalState &to) const;
 
 private:
     unsigned int hash(const GlobalState &gs) const;
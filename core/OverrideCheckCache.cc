@@ -0,0 +1,30 @@
+#include "core/OverrideCheckCache.h"
+
+using namespace std;
+
+namespace sorbet::core {
+
+optional<OverrideCheckCache::Entry> OverrideCheckCache::find(const shared_ptr<const AncestorIndex> &hierarchy,
+                                                             SymbolRef method) {
+    absl::ReaderMutexLock lck(&mtx);
+    if (this->hierarchy != hierarchy) {
+        return nullopt;
+    }
+    auto fnd = entries.find(method._id);
+    if (fnd == entries.end()) {
+        return nullopt;
+    }
+    return fnd->second;
+}
+
+void OverrideCheckCache::insert(const shared_ptr<const AncestorIndex> &hierarchy, SymbolRef method, Entry entry) {
+    ENFORCE(hierarchy != nullptr);
+    absl::MutexLock lck(&mtx);
+    if (this->hierarchy != hierarchy) {
+        this->hierarchy = hierarchy;
+        entries.clear();
+    }
+    entries[method._id] = move(entry);
+}
+
+} // namespace sorbet::core
@@ -0,0 +1,44 @@
+#ifndef SORBET_OVERRIDECHECKCACHE_H
+#define SORBET_OVERRIDECHECKCACHE_H
+
+#include "absl/synchronization/mutex.h"
+#include "core/AncestorIndex.h"
+#include "core/SymbolRef.h"
+#include <memory>
+#include <optional>
+
+namespace sorbet::core {
+
+/**
+ * The methods definition_validator found nothing wrong with, so that typechecking the same files again, as LSP's fast
+ * path does on every edit, doesn't look up what every method overrides again. Shared by a GlobalState and its deep
+ * copies, and safe to use from any thread.
+ *
+ * Each method maps to the methods it overrides and a fingerprint of everything the checks read about them (see
+ * definition_validator::validateOverriding). What a method overrides depends on the class hierarchy, so entries only
+ * hold under the GlobalState::ancestorIndex they were made with: the first use with any other index empties the cache.
+ */
+class OverrideCheckCache final {
+public:
+    struct Entry {
+        u4 fingerprint;
+        InlinedVector<SymbolRef, 2> overridden;
+    };
+
+    OverrideCheckCache() = default;
+    OverrideCheckCache(const OverrideCheckCache &) = delete;
+    OverrideCheckCache &operator=(const OverrideCheckCache &) = delete;
+
+    std::optional<Entry> find(const std::shared_ptr<const AncestorIndex> &hierarchy, SymbolRef method);
+    void insert(const std::shared_ptr<const AncestorIndex> &hierarchy, SymbolRef method, Entry entry);
+
+private:
+    absl::Mutex mtx;
+    // Held so that a later index can't reuse its address.
+    std::shared_ptr<const AncestorIndex> hierarchy;
+    UnorderedMap<u4, Entry> entries;
+};
+
+} // namespace sorbet::core
+
+#endif
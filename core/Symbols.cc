@@ -56,7 +56,7 @@ TypePtr Symbol::externalType(const GlobalState &gs) const {
         TypePtr newResultType;
         auto ref = this->ref(gs);
         if (typeMembers().empty()) {
-            newResultType = make_type<ClassType>(ref);
+            newResultType = gs.typeInterner->classType(ref);
         } else {
             vector<TypePtr> targs;
             for (auto tm : typeMembers()) {
@@ -66,14 +66,18 @@ TypePtr Symbol::externalType(const GlobalState &gs) const {
                     targs.emplace_back(Types::untyped(gs, ref));
                 }
             }
-            newResultType = make_type<AppliedType>(ref, targs);
+            newResultType = gs.typeInterner->appliedType(ref, move(targs));
         }
         {
             // this method is supposed to be idempotent. The lines below implement "safe publication" of a value that is
             // safe to be used in presence of multiple threads running this tion concurrently
             auto mutableThis = const_cast<Symbol *>(this);
-            shared_ptr<core::Type> current(nullptr);
-            atomic_compare_exchange_weak(&mutableThis->resultType.store, &current, newResultType.store);
+            uintptr_t current = 0;
+            if (__atomic_compare_exchange_n(&mutableThis->resultType.store, &current, newResultType.store, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                // resultType took over our reference
+                newResultType.store = 0;
+            }
         }
         return externalType(gs);
     }
@@ -81,6 +85,12 @@ TypePtr Symbol::externalType(const GlobalState &gs) const {
 }
 
 bool Symbol::derivesFrom(const GlobalState &gs, SymbolRef sym) const {
+    if (auto &index = gs.ancestorIndex) {
+        auto self = ref(gs);
+        if (index->covers(self)) {
+            return index->derivesFrom(self, sym);
+        }
+    }
     if (isClassLinearizationComputed()) {
         for (SymbolRef a : mixins()) {
             if (a == sym) {
@@ -101,8 +111,7 @@ bool Symbol::derivesFrom(const GlobalState &gs, SymbolRef sym) const {
 }
 
 SymbolRef Symbol::ref(const GlobalState &gs) const {
-    auto distance = this - gs.symbols.data();
-    return SymbolRef(gs, distance);
+    return SymbolRef(gs, gs.symbols.indexOf(this));
 }
 
 SymbolData SymbolRef::data(GlobalState &gs) const {
@@ -112,7 +121,12 @@ SymbolData SymbolRef::data(GlobalState &gs) const {
 
 SymbolData SymbolRef::dataAllowingNone(GlobalState &gs) const {
     ENFORCE(_id < gs.symbols.size());
-    return SymbolData(gs.symbols[this->_id], gs);
+    // The caller may be about to change this symbol. Concurrent indexing shares one state between threads and has the
+    // symbol table frozen, and the passes it runs only read symbols, so there is nothing to invalidate then.
+    if (_id < gs.ownHashes.size() && !gs.indexingConcurrently()) {
+        gs.ownHashes[_id] = 0;
+    }
+    return SymbolData(gs.symbols.mutableAt(this->_id), gs);
 }
 
 const SymbolData SymbolRef::data(const GlobalState &gs) const {
@@ -389,7 +403,7 @@ vector<Symbol::FuzzySearchResult> Symbol::findMemberFuzzyMatchConstant(const Glo
                         continue;
                     }
                     auto thisDistance = Levenstein::distance(
-                        currentName, member.first.data(gs)->cnst.original.data(gs)->raw.utf8, best.distance);
+                        currentName, member.first.data(gs)->cnst.original.data(gs)->raw.utf8, globalBestDistance);
                     if (thisDistance <= globalBestDistance) {
                         if (thisDistance < globalBestDistance) {
                             globalBest.clear();
@@ -876,32 +890,14 @@ void ArgInfo::ArgFlags::setFromU1(u1 flags) {
     isBlock = flags & 16;
 }
 
-Symbol Symbol::deepCopy(const GlobalState &to, bool keepGsId) const {
-    Symbol result;
-    result.owner = this->owner;
-    result.flags = this->flags;
-    result.mixins_ = this->mixins_;
-    result.resultType = this->resultType;
-    result.name = NameRef(to, this->name.id());
-    result.locs_ = this->locs_;
-    result.typeParams = this->typeParams;
-    if (keepGsId) {
-        result.members_ = this->members_;
-    } else {
-        result.members_.reserve(this->members().size());
-        for (auto &mem : this->members_) {
-            result.members_[NameRef(to, mem.first.id())] = mem.second;
-        }
-    }
-    result.arguments_.reserve(this->arguments_.size());
-    for (auto &mem : this->arguments_) {
-        auto &store = result.arguments_.emplace_back(mem.deepCopy());
-        store.name = NameRef(to, mem.name.id());
+Symbol::Symbol(const Symbol &other)
+    : owner(other.owner), superClassOrRebind(other.superClassOrRebind), flags(other.flags), name(other.name),
+      resultType(other.resultType), intrinsicId(other.intrinsicId), members_(other.members_),
+      uniqueCounter(other.uniqueCounter), mixins_(other.mixins_), typeParams(other.typeParams), locs_(other.locs_) {
+    arguments_.reserve(other.arguments_.size());
+    for (auto &arg : other.arguments_) {
+        arguments_.emplace_back(arg.deepCopy());
     }
-    result.superClassOrRebind = this->superClassOrRebind;
-    result.uniqueCounter = this->uniqueCounter;
-    result.intrinsic = this->intrinsic;
-    return result;
 }
 
 int Symbol::typeArity(const GlobalState &gs) const {
@@ -940,6 +936,17 @@ void Symbol::sanityCheck(const GlobalState &gs) const {
     }
 }
 
+namespace {
+template <class T, size_t N> size_t inlinedVectorHeapBytes(const InlinedVector<T, N> &vec) {
+    return vec.capacity() > N ? vec.capacity() * sizeof(T) : 0;
+}
+} // namespace
+
+size_t Symbol::heapBytes() const {
+    return members_.heapBytes() + arguments_.capacity() * sizeof(ArgInfo) + inlinedVectorHeapBytes(mixins_) +
+           inlinedVectorHeapBytes(typeParams) + inlinedVectorHeapBytes(locs_);
+}
+
 SymbolRef Symbol::enclosingMethod(const GlobalState &gs) const {
     if (isMethod()) {
         return ref(gs);
@@ -962,22 +969,40 @@ SymbolRef Symbol::enclosingClass(const GlobalState &gs) const {
 }
 
 u4 Symbol::hash(const GlobalState &gs) const {
-    u4 result = _hash(name.data(gs)->shortName(gs));
-    result = mix(result, !this->resultType ? 0 : this->resultType->hash(gs));
-    result = mix(result, this->flags);
-    result = mix(result, this->owner._id);
-    result = mix(result, this->superClassOrRebind._id);
-    // argumentsOrMixins, typeParams, typeAliases
-    for (auto e : membersStableOrderSlow(gs)) {
+    return hash(gs, ownHash(gs));
+}
+
+u4 Symbol::hash(const GlobalState &gs, u4 ownHash) const {
+    u4 result = ownHash;
+    // Summed rather than mixed so that the result does not depend on the order of the members, which saves sorting
+    // them.
+    u4 membersHash = 0;
+    for (const auto &e : members_) {
         if (e.second.exists() && !e.second.data(gs)->ignoreInHashing(gs)) {
-            result = mix(result, _hash(e.second.data(gs)->name.data(gs)->shortName(gs)));
+            membersHash += _hash(e.second.data(gs)->name.data(gs)->shortName(gs));
         }
     }
+    result = mix(result, membersHash);
     for (const auto &e : mixins_) {
         if (e.exists() && !e.data(gs)->ignoreInHashing(gs)) {
             result = mix(result, _hash(e.data(gs)->name.data(gs)->shortName(gs)));
         }
     }
+    for (const auto &e : typeParams) {
+        if (e.exists() && !e.data(gs)->ignoreInHashing(gs)) {
+            result = mix(result, _hash(e.data(gs)->name.data(gs)->shortName(gs)));
+        }
+    }
+
+    return result;
+}
+
+u4 Symbol::ownHash(const GlobalState &gs) const {
+    u4 result = _hash(name.data(gs)->shortName(gs));
+    result = mix(result, !this->resultType ? 0 : this->resultType->hash(gs));
+    result = mix(result, this->flags);
+    result = mix(result, this->owner._id);
+    result = mix(result, this->superClassOrRebind._id);
     for (const auto &arg : arguments_) {
         // If an argument's resultType changes, then the sig has changed.
         auto type = arg.type;
@@ -987,11 +1012,6 @@ u4 Symbol::hash(const GlobalState &gs) const {
         result = mix(result, type);
         result = mix(result, _hash(arg.name.data(gs)->shortName(gs)));
     }
-    for (const auto &e : typeParams) {
-        if (e.exists() && !e.data(gs)->ignoreInHashing(gs)) {
-            result = mix(result, _hash(e.data(gs)->name.data(gs)->shortName(gs)));
-        }
-    }
 
     return result;
 }
@@ -1019,6 +1039,31 @@ u4 Symbol::methodShapeHash(const GlobalState &gs) const {
     return result;
 }
 
+u4 Symbol::definitionShapeHash(const GlobalState &gs) const {
+    u4 result = _hash(showFullName(gs));
+    if (isMethod()) {
+        result = mix(result, this->flags | METHOD_FLAGS_IGNORED_IN_SHAPE_HASH);
+        for (const auto &e : arguments()) {
+            result = mix(result, _hash(e.name.data(gs)->shortName(gs)));
+            result = mix(result, e.flags.toU1());
+        }
+        return result;
+    }
+    result = mix(result, this->flags);
+    result = mix(result, superClassOrRebind.exists() ? _hash(superClassOrRebind.data(gs)->showFullName(gs)) : 0);
+    for (const auto &e : mixins_) {
+        result = mix(result, e.exists() ? _hash(e.data(gs)->showFullName(gs)) : 0);
+    }
+    for (const auto &e : typeParams) {
+        result = mix(result, e.exists() ? _hash(e.data(gs)->name.data(gs)->shortName(gs)) : 0);
+    }
+    result = mix(result, !this->resultType ? 0 : _hash(this->resultType->show(gs)));
+    if (isClass()) {
+        result = mix(result, findMember(gs, core::Names::classMethods()).exists());
+    }
+    return result;
+}
+
 bool Symbol::ignoreInHashing(const GlobalState &gs) const {
     if (isClass()) {
         return superClass() == core::Symbols::StubModule();
@@ -1057,11 +1102,7 @@ void Symbol::addLoc(const core::GlobalState &gs, core::Loc loc) {
 }
 
 vector<std::pair<NameRef, SymbolRef>> Symbol::membersStableOrderSlow(const GlobalState &gs) const {
-    vector<pair<NameRef, SymbolRef>> result;
-    result.reserve(members().size());
-    for (const auto &e : members()) {
-        result.emplace_back(e);
-    }
+    vector<pair<NameRef, SymbolRef>> result(members().begin(), members().end());
     fast_sort(result, [&](auto const &lhs, auto const &rhs) -> bool {
         auto lhsShort = lhs.first.data(gs)->shortName(gs);
         auto rhsShort = rhs.first.data(gs)->shortName(gs);
@@ -1071,6 +1112,102 @@ vector<std::pair<NameRef, SymbolRef>> Symbol::membersStableOrderSlow(const Globa
     return result;
 }
 
+SymbolMembers::SymbolMembers(const SymbolMembers &other) : entries(other.entries) {
+    if (other.index != nullptr) {
+        index = make_unique<UnorderedMap<NameRef, u4>>(*other.index);
+    }
+}
+
+SymbolMembers &SymbolMembers::operator=(const SymbolMembers &other) {
+    if (this != &other) {
+        entries = other.entries;
+        index = other.index == nullptr ? nullptr : make_unique<UnorderedMap<NameRef, u4>>(*other.index);
+    }
+    return *this;
+}
+
+size_t SymbolMembers::findIndex(NameRef name) const {
+    if (index != nullptr) {
+        auto fnd = index->find(name);
+        return fnd == index->end() ? entries.size() : fnd->second;
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].first == name) {
+            return i;
+        }
+    }
+    return entries.size();
+}
+
+SymbolMembers::iterator SymbolMembers::find(NameRef name) {
+    return entries.begin() + findIndex(name);
+}
+
+SymbolMembers::const_iterator SymbolMembers::find(NameRef name) const {
+    return entries.begin() + findIndex(name);
+}
+
+SymbolRef &SymbolMembers::operator[](NameRef name) {
+    auto i = findIndex(name);
+    if (i == entries.size()) {
+        entries.emplace_back(name, Symbols::noSymbol());
+        if (index != nullptr) {
+            (*index)[name] = i;
+        } else if (entries.size() > INDEX_THRESHOLD) {
+            buildIndex();
+        }
+    }
+    return entries[i].second;
+}
+
+SymbolRef SymbolMembers::at(NameRef name) const {
+    auto fnd = find(name);
+    ENFORCE(fnd != end());
+    return fnd->second;
+}
+
+void SymbolMembers::erase(const_iterator it) {
+    // Order is not part of the contract, so fill the hole with the last entry.
+    auto i = it - entries.begin();
+    if (index != nullptr) {
+        index->erase(entries[i].first);
+    }
+    if (i != entries.size() - 1) {
+        entries[i] = entries.back();
+        if (index != nullptr) {
+            (*index)[entries[i].first] = i;
+        }
+    }
+    entries.pop_back();
+}
+
+void SymbolMembers::reserve(size_t size) {
+    entries.reserve(size);
+    if (size > INDEX_THRESHOLD && index == nullptr) {
+        buildIndex();
+        index->reserve(size);
+    }
+}
+
+size_t SymbolMembers::heapBytes() const {
+    size_t bytes = 0;
+    if (entries.capacity() > 1) {
+        bytes += entries.capacity() * sizeof(value_type);
+    }
+    if (index != nullptr) {
+        bytes += sizeof(*index) + index->capacity() * (sizeof(UnorderedMap<NameRef, u4>::value_type) + 1);
+    }
+    return bytes;
+}
+
+void SymbolMembers::buildIndex() {
+    index = make_unique<UnorderedMap<NameRef, u4>>();
+    index->reserve(entries.size());
+    for (u4 i = 0; i < entries.size(); i++) {
+        (*index)[entries[i].first] = i;
+    }
+}
+
 SymbolData::SymbolData(Symbol &ref, const GlobalState &gs) : DebugOnlyCheck(gs), symbol(ref) {}
 
 SymbolDataDebugCheck::SymbolDataDebugCheck(const GlobalState &gs) : gs(gs), symbolCountAtCreation(gs.symbolsUsed()) {}
@@ -32,9 +32,70 @@ public:
 
 enum class Variance { CoVariant = 1, ContraVariant = -1, Invariant = 0 };
 
-class Symbol final {
+/**
+ * The members of a symbol, by name. Most symbols are methods or fields with few or no members, so the entries live in
+ * a small vector (with one inline slot) that is searched linearly; only symbols with many members also get a hash
+ * index into it. Iteration is in insertion order.
+ */
+class SymbolMembers final {
+public:
+    using value_type = std::pair<NameRef, SymbolRef>;
+    using Entries = InlinedVector<value_type, 1>;
+    using iterator = Entries::iterator;
+    using const_iterator = Entries::const_iterator;
+
+    SymbolMembers() = default;
+    SymbolMembers(SymbolMembers &&) noexcept = default;
+    SymbolMembers &operator=(SymbolMembers &&) noexcept = default;
+    SymbolMembers(const SymbolMembers &other);
+    SymbolMembers &operator=(const SymbolMembers &other);
+
+    size_t size() const {
+        return entries.size();
+    }
+    bool empty() const {
+        return entries.empty();
+    }
+    iterator begin() {
+        return entries.begin();
+    }
+    iterator end() {
+        return entries.end();
+    }
+    const_iterator begin() const {
+        return entries.begin();
+    }
+    const_iterator end() const {
+        return entries.end();
+    }
+
+    iterator find(NameRef name);
+    const_iterator find(NameRef name) const;
+    /** The member called `name`, inserting noSymbol if there is none */
+    SymbolRef &operator[](NameRef name);
+    /** Requires a member called `name` */
+    SymbolRef at(NameRef name) const;
+    void erase(const_iterator it);
+    void reserve(size_t size);
+    /** Roughly how much memory the members take up outside of the SymbolMembers itself */
+    size_t heapBytes() const;
+
+private:
+    static constexpr size_t INDEX_THRESHOLD = 16;
+    Entries entries;
+    std::unique_ptr<UnorderedMap<NameRef, u4>> index;
+
+    size_t findIndex(NameRef name) const;
+    void buildIndex();
+};
+
+// Aligned to a cache line so that the fields at the start of every symbol share one; see `owner` below.
+class alignas(64) Symbol final {
+    // Only GlobalState's symbol table copies symbols, when it unshares a chunk.
+    template <class T, size_t ChunkBytes> friend class CopyOnWriteVector;
+    Symbol(const Symbol &other);
+
 public:
-    Symbol(const Symbol &) = delete;
     Symbol() = default;
     Symbol(Symbol &&) noexcept = default;
 
@@ -106,7 +167,15 @@ public:
     void addLoc(const core::GlobalState &gs, core::Loc loc);
 
     u4 hash(const GlobalState &gs) const;
+    // hash, given the result of ownHash. Only looks at the names of the members, mixins and type parameters.
+    u4 hash(const GlobalState &gs, u4 ownHash) const;
+    // The part of hash that only depends on what is stored in this symbol.
+    u4 ownHash(const GlobalState &gs) const;
     u4 methodShapeHash(const GlobalState &gs) const;
+    // What makes this symbol part of the class hierarchy, hashed from names instead of symbol IDs so that it can be
+    // compared across GlobalStates. Does not look at the members of classes, except for whether there is a
+    // `mixes_in_class_methods`: a file that adds definitions keeps the shape hash of every symbol it had.
+    u4 definitionShapeHash(const GlobalState &gs) const;
 
     std::vector<TypePtr> selfTypeArgs(const GlobalState &gs) const;
 
@@ -540,8 +609,29 @@ public:
 
     bool ignoreInHashing(const GlobalState &gs) const;
 
+    // The fields are laid out by how often the type checker reads them. `owner` through `members_` fill the first
+    // cache line of the symbol, which is all that isClass, dealias and findMember read; arguments and mixins, which
+    // dispatchCall and derivesFrom also need, are in the second. Fields rarely read after naming, like locs_, go last.
     SymbolRef owner;
     SymbolRef superClassOrRebind; // method arugments store rebind here
+    u4 flags = Flags::NONE;
+    NameRef name; // todo: move out? it should not matter but it's important for name resolution
+    TypePtr resultType;
+
+    // One more than the index in `intrinsicMethods` of this method's intrinsic, or 0 if it has none. An index rather
+    // than a pointer, so that it is stored with the rest of the symbol table and means the same in every process that
+    // loads it.
+    u4 intrinsicId = 0;
+    bool hasIntrinsic() const {
+        return intrinsicId != 0;
+    }
+    const IntrinsicMethod *intrinsic() const {
+        return hasIntrinsic() ? intrinsicMethods[intrinsicId - 1].impl : nullptr;
+    }
+
+    SymbolMembers members_;
+    std::vector<ArgInfo> arguments_;
+    u4 uniqueCounter = 1; // used as a counter inside the namer
 
     inline SymbolRef superClass() const {
         ENFORCE(isClass());
@@ -563,18 +653,10 @@ public:
         return superClassOrRebind;
     }
 
-    u4 flags = Flags::NONE;
-    u4 uniqueCounter = 1; // used as a counter inside the namer
-    NameRef name;         // todo: move out? it should not matter but it's important for name resolution
-    TypePtr resultType;
-
-    UnorderedMap<NameRef, SymbolRef> members_;
-    std::vector<ArgInfo> arguments_;
-
-    UnorderedMap<NameRef, SymbolRef> &members() {
+    SymbolMembers &members() {
         return members_;
     };
-    const UnorderedMap<NameRef, SymbolRef> &members() const {
+    const SymbolMembers &members() const {
         return members_;
     };
 
@@ -588,16 +670,13 @@ public:
 
     std::vector<std::pair<NameRef, SymbolRef>> membersStableOrderSlow(const GlobalState &gs) const;
 
-    Symbol deepCopy(const GlobalState &to, bool keepGsId = false) const;
     void sanityCheck(const GlobalState &gs) const;
     SymbolRef enclosingMethod(const GlobalState &gs) const;
+    /** Roughly how much memory this symbol takes up outside of the symbol table */
+    size_t heapBytes() const;
 
     SymbolRef enclosingClass(const GlobalState &gs) const;
 
-    // All `IntrinsicMethod`s in sorbet should be statically-allocated, which is
-    // why raw pointers are safe.
-    const IntrinsicMethod *intrinsic = nullptr;
-
 private:
     friend class serialize::SerializerImpl;
     friend class GlobalState;
@@ -629,7 +708,7 @@ private:
     SymbolRef findMemberTransitiveInternal(const GlobalState &gs, NameRef name, u4 mask, u4 flags,
                                            int maxDepth = 100) const;
 };
-// CheckSize(Symbol, 144, 8); // This is under too much churn to be worth checking
+// CheckSize(Symbol, 192, 64); // This is under too much churn to be worth checking
 
 } // namespace sorbet::core
 #endif // SORBET_SYMBOLS_H
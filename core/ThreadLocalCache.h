@@ -0,0 +1,60 @@
+#ifndef SORBET_CORE_THREADLOCALCACHE_H
+#define SORBET_CORE_THREADLOCALCACHE_H
+
+#include "common/common.h"
+
+namespace sorbet::core {
+
+/**
+ * Base of the caches that, while alive, memoize some lookup for the thread that constructed them. They nest: the
+ * innermost one alive is the thread's `current()`, and the enclosing one is again once it is destroyed. What an entry
+ * means, and for how long it stays valid, is up to `Derived`.
+ *
+ * Bounds the memory a single thread's cache can take, including whatever its values keep alive: once it holds
+ * `MaxSize` entries it is simply dropped, and fills up again from scratch.
+ */
+template <class Derived, class Key, class Value, size_t MaxSize> class ThreadLocalCache {
+    static thread_local Derived *current_;
+    Derived *previous;
+    UnorderedMap<Key, Value> entries;
+
+protected:
+    ThreadLocalCache() : previous(current_) {
+        current_ = static_cast<Derived *>(this);
+    }
+    ~ThreadLocalCache() {
+        current_ = previous;
+    }
+
+    const Value *lookup(const Key &key) const {
+        auto fnd = entries.find(key);
+        return fnd == entries.end() ? nullptr : &fnd->second;
+    }
+
+    void store(const Key &key, Value value) {
+        if (entries.size() >= MaxSize) {
+            entries.clear();
+        }
+        entries[key] = std::move(value);
+    }
+
+public:
+    ThreadLocalCache(const ThreadLocalCache &) = delete;
+    ThreadLocalCache(ThreadLocalCache &&) = delete;
+
+    /** The innermost cache of this kind alive on the calling thread, if any */
+    static Derived *current() {
+        return current_;
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+};
+
+template <class Derived, class Key, class Value, size_t MaxSize>
+thread_local Derived *ThreadLocalCache<Derived, Key, Value, MaxSize>::current_ = nullptr;
+
+} // namespace sorbet::core
+
+#endif
@@ -8,9 +8,12 @@ namespace sorbet::core {
 
 class TypeConstraint {
     static TypeConstraint makeEmptyFrozenConstraint();
-    std::vector<std::pair<SymbolRef, TypePtr>> upperBounds;
-    std::vector<std::pair<SymbolRef, TypePtr>> lowerBounds;
-    std::vector<std::pair<SymbolRef, TypePtr>> solution;
+    // Room for as many type parameters as defineDomain expects inline, so that the constraint for a call to a typical
+    // generic method needs no allocation besides the TypeConstraint itself.
+    using Bounds = InlinedVector<std::pair<SymbolRef, TypePtr>, 4>;
+    Bounds upperBounds;
+    Bounds lowerBounds;
+    Bounds solution;
     bool wasSolved = false;
     bool cantSolve = false;
     TypePtr &findUpperBound(SymbolRef forWhat);
@@ -0,0 +1,61 @@
+#include "core/TypeInterner.h"
+#include "core/Types.h"
+#include <typeinfo>
+
+using namespace std;
+
+namespace sorbet::core {
+
+namespace {
+// ClassType has subclasses (BlamedUntyped, UnresolvedClassType) that carry more than the symbol.
+bool isPlainClassType(const TypePtr &type) {
+    auto *ptr = type.get();
+    return ptr != nullptr && ptr->tag == TypeTag::ClassType;
+}
+} // namespace
+
+TypePtr TypeInterner::classType(SymbolRef symbol) {
+    auto &shard = shards[symbol._id % SHARD_COUNT];
+    {
+        absl::ReaderMutexLock lck(&shard.mtx);
+        auto fnd = shard.classTypes.find(symbol._id);
+        if (fnd != shard.classTypes.end()) {
+            return fnd->second;
+        }
+    }
+    absl::MutexLock lck(&shard.mtx);
+    auto &slot = shard.classTypes[symbol._id];
+    if (!slot) {
+        slot = make_type<ClassType>(symbol);
+    }
+    return slot;
+}
+
+TypePtr TypeInterner::appliedType(SymbolRef klass, vector<TypePtr> targs) {
+    vector<u4> key;
+    key.reserve(targs.size() + 1);
+    key.emplace_back(klass._id);
+    for (auto &targ : targs) {
+        if (!isPlainClassType(targ)) {
+            return make_type<AppliedType>(klass, move(targs));
+        }
+        key.emplace_back(cast_type<ClassType>(targ.get())->symbol._id);
+    }
+
+    auto &shard = shards[absl::Hash<vector<u4>>()(key) % SHARD_COUNT];
+    {
+        absl::ReaderMutexLock lck(&shard.mtx);
+        auto fnd = shard.appliedTypes.find(key);
+        if (fnd != shard.appliedTypes.end()) {
+            return fnd->second;
+        }
+    }
+    absl::MutexLock lck(&shard.mtx);
+    auto &slot = shard.appliedTypes[move(key)];
+    if (!slot) {
+        slot = make_type<AppliedType>(klass, move(targs));
+    }
+    return slot;
+}
+
+} // namespace sorbet::core
@@ -0,0 +1,42 @@
+#ifndef SORBET_TYPEINTERNER_H
+#define SORBET_TYPEINTERNER_H
+
+#include "absl/synchronization/mutex.h"
+#include "core/SymbolRef.h"
+#include "core/TypePtr.h"
+#include <array>
+#include <vector>
+
+namespace sorbet::core {
+
+/**
+ * Hands out one shared instance per distinct ground type, so that the class and applied types that recur all over
+ * inference don't each cost an allocation, and so that identical types usually compare equal by pointer. Safe to use
+ * from any thread; a GlobalState and all of its deep copies share one.
+ *
+ * Only types that are fully determined by symbols are interned: ClassTypes, and AppliedTypes whose type arguments are
+ * all plain ClassTypes. Anything else is allocated as before, which keeps the table bounded by the shapes the program
+ * actually spells out.
+ */
+class TypeInterner final {
+public:
+    TypeInterner() = default;
+    TypeInterner(const TypeInterner &) = delete;
+    TypeInterner &operator=(const TypeInterner &) = delete;
+
+    TypePtr classType(SymbolRef symbol);
+    TypePtr appliedType(SymbolRef klass, std::vector<TypePtr> targs);
+
+private:
+    static constexpr int SHARD_COUNT = 64;
+    struct Shard {
+        absl::Mutex mtx;
+        UnorderedMap<u4, TypePtr> classTypes;
+        UnorderedMap<std::vector<u4>, TypePtr> appliedTypes;
+    };
+    std::array<Shard, SHARD_COUNT> shards;
+};
+
+} // namespace sorbet::core
+
+#endif
@@ -4,25 +4,47 @@
 #include <memory>
 
 namespace sorbet::core {
-// using TypePtr = std::shared_ptr<Type>;
 class Type;
+// An intrusively reference counted handle to a Type. The count lives in the Type itself, so a handle is one word
+// wide. Handles to immortal types (the singletons in Types::*) carry a tag bit and skip reference counting entirely,
+// which keeps the hottest types from turning their counts into contended cache lines.
+//
+// The copying and destroying members are defined in Types.h, where Type is complete.
 class TypePtr {
-    std::shared_ptr<Type> store;
-    TypePtr(std::shared_ptr<Type> &&store);
+    static constexpr uintptr_t IMMORTAL_TAG = 1;
+    uintptr_t store = 0;
+
+    inline static void incRef(uintptr_t store);
+    inline static void decRef(uintptr_t store);
 
 public:
     TypePtr() = default;
-    TypePtr(TypePtr &&other) = default;
-    TypePtr(const TypePtr &other) = default;
-    TypePtr &operator=(TypePtr &&other) = default;
-    TypePtr &operator=(const TypePtr &other) = default;
-    explicit TypePtr(Type *ptr) : store(ptr) {}
-    TypePtr(std::nullptr_t n) : store(nullptr) {}
+    TypePtr(TypePtr &&other) noexcept : store(other.store) {
+        other.store = 0;
+    }
+    inline TypePtr(const TypePtr &other);
+    inline TypePtr &operator=(TypePtr &&other) noexcept;
+    inline TypePtr &operator=(const TypePtr &other);
+    inline explicit TypePtr(Type *ptr);
+    TypePtr(std::nullptr_t n) {}
+    inline ~TypePtr();
+
+    // Makes a handle that never frees `ptr` and never touches its reference count.
+    static TypePtr immortal(Type *ptr) {
+        TypePtr res;
+        res.store = reinterpret_cast<uintptr_t>(ptr) | IMMORTAL_TAG;
+        return res;
+    }
+
+    // Another handle to `ptr`, which must already be owned by some handle. Empty for immortal types and anything else
+    // whose references aren't counted.
+    static inline TypePtr retain(const Type *ptr);
+
     operator bool() const {
-        return (bool)store;
+        return store != 0;
     }
     Type *get() const {
-        return store.get();
+        return reinterpret_cast<Type *>(store & ~IMMORTAL_TAG);
     }
     Type *operator->() const {
         return get();
@@ -31,22 +53,20 @@ public:
         return *get();
     }
     bool operator!=(const TypePtr &other) const {
-        return store != other.store;
+        return get() != other.get();
     }
     bool operator==(const TypePtr &other) const {
-        return store == other.store;
+        return get() == other.get();
     }
     bool operator!=(std::nullptr_t n) const {
-        return store != nullptr;
+        return store != 0;
     }
     bool operator==(std::nullptr_t n) const {
-        return store == nullptr;
+        return store == 0;
     }
     friend class Symbol;
-
-    template <class T, class... Args> friend TypePtr make_type(Args &&... args);
 };
-CheckSize(TypePtr, 16, 8);
+CheckSize(TypePtr, 8, 8);
 } // namespace sorbet::core
 
 #endif
@@ -0,0 +1,33 @@
+#include "core/TypeShowCache.h"
+#include "core/Types.h"
+
+using namespace std;
+
+namespace sorbet::core {
+
+TypeShowCache::Shard &TypeShowCache::shardFor(const Type *type) {
+    // Types are at least 8-byte aligned, so the low bits say nothing.
+    return shards[(reinterpret_cast<uintptr_t>(type) >> 4) % SHARD_COUNT];
+}
+
+optional<string> TypeShowCache::find(const Type *type, u4 epoch) {
+    auto &shard = shardFor(type);
+    absl::ReaderMutexLock lck(&shard.mtx);
+    auto fnd = shard.entries.find(type);
+    if (fnd == shard.entries.end() || fnd->second.epoch != epoch) {
+        return nullopt;
+    }
+    return fnd->second.shown;
+}
+
+void TypeShowCache::insert(TypePtr type, u4 epoch, string shown) {
+    auto &shard = shardFor(type.get());
+    absl::MutexLock lck(&shard.mtx);
+    if (shard.entries.size() >= MAX_ENTRIES_PER_SHARD) {
+        shard.entries.clear();
+    }
+    auto *key = type.get();
+    shard.entries[key] = Entry{move(type), epoch, move(shown)};
+}
+
+} // namespace sorbet::core
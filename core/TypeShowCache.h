@@ -0,0 +1,50 @@
+#ifndef SORBET_TYPESHOWCACHE_H
+#define SORBET_TYPESHOWCACHE_H
+
+#include "absl/synchronization/mutex.h"
+#include "core/TypePtr.h"
+#include <array>
+#include <optional>
+#include <string>
+
+namespace sorbet::core {
+class Type;
+
+/**
+ * Remembers what show() printed for the composite types (applied types, shapes, tuples and unions) that error messages
+ * and hover print over and over again. Safe to use from any thread.
+ *
+ * Entries are keyed by the type's address, and each one holds a handle to its type, so that no other type can take
+ * that address while the entry is alive. What a type shows as depends on the names of the symbols it mentions, so
+ * every entry also records the GlobalState's symbol epoch (see GlobalState::symbolEpoch) it was printed at, and each
+ * GlobalState has a cache of its own. A shard that fills up is simply emptied, which keeps the cache bounded.
+ */
+class TypeShowCache final {
+public:
+    TypeShowCache() = default;
+    TypeShowCache(const TypeShowCache &) = delete;
+    TypeShowCache &operator=(const TypeShowCache &) = delete;
+
+    std::optional<std::string> find(const Type *type, u4 epoch);
+    void insert(TypePtr type, u4 epoch, std::string shown);
+
+private:
+    static constexpr int SHARD_COUNT = 16;
+    static constexpr int MAX_ENTRIES_PER_SHARD = 1024;
+    struct Entry {
+        TypePtr type;
+        u4 epoch;
+        std::string shown;
+    };
+    struct Shard {
+        absl::Mutex mtx;
+        UnorderedMap<const Type *, Entry> entries;
+    };
+    std::array<Shard, SHARD_COUNT> shards;
+
+    Shard &shardFor(const Type *type);
+};
+
+} // namespace sorbet::core
+
+#endif
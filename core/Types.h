@@ -1,11 +1,15 @@
 #ifndef SORBET_TYPES_H
 #define SORBET_TYPES_H
 
+#include "absl/types/span.h"
 #include "common/Counters.h"
 #include "core/Context.h"
 #include "core/Error.h"
 #include "core/SymbolRef.h"
+#include "core/ThreadLocalCache.h"
 #include "core/TypeConstraint.h"
+#include <array>
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <string>
@@ -64,7 +68,7 @@ public:
 CheckSize(ArgInfo, 40, 8);
 
 template <class T, class... Args> TypePtr make_type(Args &&... args) {
-    return TypePtr(std::make_shared<T>(std::forward<Args>(args)...));
+    return TypePtr(new T(std::forward<Args>(args)...));
 }
 
 class Types final {
@@ -104,6 +108,8 @@ public:
     static TypePtr falsyTypes();
 
     static TypePtr dropSubtypesOf(Context ctx, const TypePtr &from, SymbolRef klass);
+    /** Drops the subtypes of any of `klasses` in one walk over `from`, instead of one walk per class. */
+    static TypePtr dropSubtypesOf(Context ctx, const TypePtr &from, absl::Span<const SymbolRef> klasses);
     static TypePtr approximateSubtract(Context ctx, const TypePtr &from, const TypePtr &what);
     static bool canBeTruthy(Context ctx, const TypePtr &what);
     static bool canBeFalsy(Context ctx, const TypePtr &what);
@@ -152,6 +158,51 @@ public:
     static core::SymbolRef getRepresentedClass(core::Context ctx, const core::Type *ty);
 };
 
+/**
+ * While alive, the constructing thread memoizes Types::isSubType answers for ground types (class types, applied types
+ * of class types, and unions and intersections of those) that are checked without a constraint. The answers depend on
+ * the class hierarchy, so this must only be used once it can no longer change, i.e. while typechecking.
+ */
+class SubtypingCache final : public ThreadLocalCache<SubtypingCache, std::array<u4, 16>, bool, 1 << 14> {
+public:
+    using Key = std::array<u4, 16>;
+    static constexpr int KEY_LENGTH = std::tuple_size<Key>::value;
+
+private:
+    friend class Types;
+};
+
+/**
+ * While alive, the constructing thread memoizes which member a (class, name) pair resolves to through
+ * findMemberTransitive, so that repeated sends to the same method cost a single probe. The symbol table must not
+ * change while it is alive, which holds while typechecking.
+ */
+class MethodLookupCache final : public ThreadLocalCache<MethodLookupCache, u8, SymbolRef, 1 << 16> {
+public:
+    /** `klass.data(gs)->findMemberTransitive(gs, name)`, served from the calling thread's cache when it has one */
+    static SymbolRef findMemberTransitive(const GlobalState &gs, SymbolRef klass, NameRef name);
+};
+
+struct AsSeenFromEntry {
+    TypePtr what;
+    SymbolRef fromWhat;
+    SymbolRef inWhat;
+    std::vector<TypePtr> targs;
+    TypePtr result;
+};
+
+/**
+ * While alive, the constructing thread memoizes Types::resultTypeAsSeenFrom, so that sends to a generic method on the
+ * same receiver type arguments (say `T::Array[Foo]#each`) substitute its type members once. Entries are keyed by the
+ * identity of the types involved and hold on to them, so that no address they are keyed by is reused while they
+ * exist. Like MethodLookupCache, this needs the symbol table not to change while it is alive.
+ *
+ * Lookups go by a hash of those inputs; an entry whose inputs turn out to differ is simply replaced.
+ */
+class AsSeenFromCache final : public ThreadLocalCache<AsSeenFromCache, u8, AsSeenFromEntry, 1 << 16> {
+    friend class Types;
+};
+
 struct Intrinsic {
     const SymbolRef symbol;
     const bool singleton;
@@ -160,9 +211,33 @@ struct Intrinsic {
 };
 extern const std::vector<Intrinsic> intrinsicMethods;
 
+// One per final type class, so that cast_type and typecase tell types apart with a compare instead of comparing
+// typeids. The subclasses of each abstract type class are consecutive, so that casting to it is a range check.
+enum class TypeTag : u1 {
+    // ClassType and its subclasses. The first GroundType.
+    ClassType = 1,
+    BlamedUntyped,
+    UnresolvedClassType,
+    OrType,
+    // The last GroundType.
+    AndType,
+    // The first ProxyType.
+    LiteralType,
+    ShapeType,
+    TupleType,
+    // The last ProxyType.
+    MetaType,
+    LambdaParam,
+    SelfTypeParam,
+    AliasType,
+    SelfType,
+    TypeVar,
+    AppliedType,
+};
+
 class Type {
 public:
-    Type() = default;
+    Type(TypeTag tag) : tag(tag) {}
     Type(const Type &obj) = delete;
     virtual ~Type() = default;
     // Internal printer.
@@ -202,8 +277,64 @@ public:
     virtual int kind() = 0;
     virtual TypePtr _approximate(Context ctx, const TypeConstraint &tc);
     unsigned int hash(const GlobalState &gs) const;
+
+    const TypeTag tag;
+
+private:
+    friend class TypePtr;
+    mutable std::atomic<u4> counter{0};
 };
-CheckSize(Type, 8, 8);
+CheckSize(Type, 16, 8);
+
+void TypePtr::incRef(uintptr_t store) {
+    if (store != 0 && (store & IMMORTAL_TAG) == 0) {
+        reinterpret_cast<Type *>(store)->counter.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void TypePtr::decRef(uintptr_t store) {
+    if (store != 0 && (store & IMMORTAL_TAG) == 0) {
+        auto *ptr = reinterpret_cast<Type *>(store);
+        if (ptr->counter.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete ptr;
+        }
+    }
+}
+
+TypePtr::TypePtr(Type *ptr) : store(reinterpret_cast<uintptr_t>(ptr)) {
+    incRef(store);
+}
+
+TypePtr TypePtr::retain(const Type *ptr) {
+    if (ptr->counter.load(std::memory_order_relaxed) == 0) {
+        return TypePtr();
+    }
+    return TypePtr(const_cast<Type *>(ptr));
+}
+
+TypePtr::TypePtr(const TypePtr &other) : store(other.store) {
+    incRef(store);
+}
+
+TypePtr &TypePtr::operator=(TypePtr &&other) noexcept {
+    if (this != &other) {
+        decRef(store);
+        store = other.store;
+        other.store = 0;
+    }
+    return *this;
+}
+
+TypePtr &TypePtr::operator=(const TypePtr &other) {
+    incRef(other.store);
+    decRef(store);
+    store = other.store;
+    return *this;
+}
+
+TypePtr::~TypePtr() {
+    decRef(store);
+}
 
 template <class To> To *cast_type(Type *what) {
     static_assert(!std::is_pointer<To>::value, "To has to be a pointer");
@@ -221,13 +352,16 @@ template <class To> bool isa_type(Type *what) {
     return cast_type<To>(what) != nullptr;
 }
 
-class GroundType : public Type {};
+class GroundType : public Type {
+public:
+    GroundType(TypeTag tag) : Type(tag) {}
+};
 
 class ProxyType : public Type {
 public:
     // TODO: use shared pointers that use inline counter
     virtual TypePtr underlying() const = 0;
-    ProxyType() = default;
+    ProxyType(TypeTag tag) : Type(tag) {}
 
     virtual DispatchResult dispatchCall(Context ctx, DispatchArgs args) override;
     virtual TypePtr getCallArguments(Context ctx, NameRef name) override;
@@ -235,7 +369,7 @@ public:
 
     void _sanityCheck(Context ctx) override;
 };
-CheckSize(ProxyType, 8, 8);
+CheckSize(ProxyType, 16, 8);
 
 class ClassType : public GroundType {
 public:
@@ -243,6 +377,11 @@ public:
     ClassType(SymbolRef symbol);
     virtual int kind() final;
 
+protected:
+    ClassType(TypeTag tag, SymbolRef symbol);
+
+public:
+
     virtual std::string toStringWithTabs(const GlobalState &gs, int tabs = 0) const override;
     virtual std::string show(const GlobalState &gs) const override;
     virtual std::string typeName() const override;
@@ -345,7 +484,7 @@ public:
     virtual TypePtr getCallArguments(Context ctx, NameRef name) final;
     virtual bool derivesFrom(const GlobalState &gs, SymbolRef klass) const final;
 };
-CheckSize(SelfType, 8, 8);
+CheckSize(SelfType, 16, 8);
 
 class LiteralType final : public ProxyType {
 public:
@@ -374,7 +513,7 @@ public:
                                  const std::vector<TypePtr> &targs) override;
     virtual int kind() final;
 };
-CheckSize(LiteralType, 24, 8);
+CheckSize(LiteralType, 32, 8);
 
 class TypeVar final : public Type {
 public:
@@ -436,14 +575,15 @@ private:
     friend class GlobalSubstitution;
     friend class serialize::SerializerImpl;
     friend TypePtr lubDistributeOr(Context ctx, const TypePtr &t1, const TypePtr &t2);
+    friend TypePtr lubClassUnions(Context ctx, const TypePtr &t1, const TypePtr &t2);
     friend TypePtr lubGround(Context ctx, const TypePtr &t1, const TypePtr &t2);
     friend TypePtr Types::lub(Context ctx, const TypePtr &t1, const TypePtr &t2);
     friend TypePtr Types::glb(Context ctx, const TypePtr &t1, const TypePtr &t2);
-    friend TypePtr Types::dropSubtypesOf(Context ctx, const TypePtr &from, SymbolRef klass);
+    friend TypePtr Types::dropSubtypesOf(Context ctx, const TypePtr &from, absl::Span<const SymbolRef> klasses);
 
     static TypePtr make_shared(const TypePtr &left, const TypePtr &right);
 };
-CheckSize(OrType, 40, 8);
+CheckSize(OrType, 32, 8);
 
 class AndType final : public GroundType {
 public:
@@ -485,16 +625,20 @@ private:
 
     static TypePtr make_shared(const TypePtr &left, const TypePtr &right);
 };
-CheckSize(AndType, 40, 8);
+CheckSize(AndType, 32, 8);
 
 class ShapeType final : public ProxyType {
 public:
-    std::vector<TypePtr> keys; // TODO: store sorted by whatever
+    std::vector<TypePtr> keys; // in the order they were written, which is the order they are shown in
     std::vector<TypePtr> values;
     const TypePtr underlying_;
     ShapeType();
     ShapeType(TypePtr underlying, std::vector<TypePtr> keys, std::vector<TypePtr> values);
 
+    // The position in `keys` of the first key with this literal value, if there is one.
+    std::optional<size_t> indexForKey(const LiteralType &key) const;
+    std::optional<size_t> indexForKey(LiteralType::LiteralTypeKind kind, int64_t value) const;
+
     virtual std::string toStringWithTabs(const GlobalState &gs, int tabs = 0) const final;
     virtual std::string show(const GlobalState &gs) const final;
     virtual std::string typeName() const override;
@@ -509,8 +653,13 @@ public:
     virtual TypePtr _approximate(Context ctx, const TypeConstraint &tc) override;
     virtual TypePtr _instantiate(Context ctx, const TypeConstraint &tc) override;
     virtual TypePtr underlying() const override;
+
+private:
+    // For shapes with many keys, the positions of `keys` ordered by literal value, so that indexForKey is a binary
+    // search rather than a scan. Empty for small shapes, which are scanned.
+    std::vector<u4> sortedKeys;
 };
-CheckSize(ShapeType, 72, 8);
+CheckSize(ShapeType, 96, 8);
 
 class TupleType final : public ProxyType {
 private:
@@ -698,7 +847,8 @@ struct DispatchResult {
 class BlamedUntyped final : public ClassType {
 public:
     const core::SymbolRef blame;
-    BlamedUntyped(SymbolRef whoToBlame) : ClassType(core::Symbols::untyped()), blame(whoToBlame){};
+    BlamedUntyped(SymbolRef whoToBlame)
+        : ClassType(TypeTag::BlamedUntyped, core::Symbols::untyped()), blame(whoToBlame){};
 };
 
 class UnresolvedClassType final : public ClassType {
@@ -706,11 +856,44 @@ public:
     const core::SymbolRef scope;
     const std::vector<core::NameRef> names;
     UnresolvedClassType(SymbolRef scope, std::vector<core::NameRef> names)
-        : ClassType(core::Symbols::untyped()), scope(scope), names(names){};
+        : ClassType(TypeTag::UnresolvedClassType, core::Symbols::untyped()), scope(scope), names(names){};
     virtual std::string toStringWithTabs(const GlobalState &gs, int tabs = 0) const final;
     virtual std::string show(const GlobalState &gs) const final;
     virtual std::string typeName() const final;
 };
 
 } // namespace sorbet::core
+
+namespace sorbet {
+// Specialized so that typecase, which goes through fast_cast directly, also gets the cheaper check.
+#define SORBET_TYPE_FAST_CAST(name, first, last)                                                                    \
+    template <> inline core::name *fast_cast<core::Type, core::name>(core::Type * what) {                          \
+        if (what == nullptr || what->tag < core::TypeTag::first || what->tag > core::TypeTag::last) {               \
+            return nullptr;                                                                                         \
+        }                                                                                                           \
+        return static_cast<core::name *>(what);                                                                     \
+    }                                                                                                               \
+    template <> inline const core::name *fast_cast<const core::Type, const core::name>(const core::Type *what) {    \
+        return fast_cast<core::Type, core::name>(const_cast<core::Type *>(what));                                   \
+    }
+SORBET_TYPE_FAST_CAST(GroundType, ClassType, AndType)
+SORBET_TYPE_FAST_CAST(ClassType, ClassType, UnresolvedClassType)
+SORBET_TYPE_FAST_CAST(BlamedUntyped, BlamedUntyped, BlamedUntyped)
+SORBET_TYPE_FAST_CAST(UnresolvedClassType, UnresolvedClassType, UnresolvedClassType)
+SORBET_TYPE_FAST_CAST(OrType, OrType, OrType)
+SORBET_TYPE_FAST_CAST(AndType, AndType, AndType)
+SORBET_TYPE_FAST_CAST(ProxyType, LiteralType, MetaType)
+SORBET_TYPE_FAST_CAST(LiteralType, LiteralType, LiteralType)
+SORBET_TYPE_FAST_CAST(ShapeType, ShapeType, ShapeType)
+SORBET_TYPE_FAST_CAST(TupleType, TupleType, TupleType)
+SORBET_TYPE_FAST_CAST(MetaType, MetaType, MetaType)
+SORBET_TYPE_FAST_CAST(LambdaParam, LambdaParam, LambdaParam)
+SORBET_TYPE_FAST_CAST(SelfTypeParam, SelfTypeParam, SelfTypeParam)
+SORBET_TYPE_FAST_CAST(AliasType, AliasType, AliasType)
+SORBET_TYPE_FAST_CAST(SelfType, SelfType, SelfType)
+SORBET_TYPE_FAST_CAST(TypeVar, TypeVar, TypeVar)
+SORBET_TYPE_FAST_CAST(AppliedType, AppliedType, AppliedType)
+#undef SORBET_TYPE_FAST_CAST
+} // namespace sorbet
+
 #endif // SORBET_TYPES_H
@@ -29,4 +29,13 @@ UnfreezeFileTable::~UnfreezeFileTable() {
     gs.freezeFileTable();
 }
 
+UnfreezeForConcurrentIndexing::UnfreezeForConcurrentIndexing(GlobalState &gs) : gs(gs) {
+    auto oldState = gs.beginConcurrentIndexing();
+    ENFORCE(oldState);
+}
+
+UnfreezeForConcurrentIndexing::~UnfreezeForConcurrentIndexing() {
+    gs.endConcurrentIndexing();
+}
+
 } // namespace sorbet::core
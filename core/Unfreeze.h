@@ -28,5 +28,18 @@ public:
     ~UnfreezeFileTable();
 };
 
+/**
+ * Lets several threads index files into one GlobalState at the same time. While it is alive, any thread may enter
+ * names, and may fill in the file reserved at a FileRef that it owns. The other Unfreeze guards for those tables do
+ * nothing. Nothing else becomes thread-safe: in particular, symbols must not be entered.
+ */
+class UnfreezeForConcurrentIndexing {
+    GlobalState &gs;
+
+public:
+    UnfreezeForConcurrentIndexing(GlobalState &gs);
+    ~UnfreezeForConcurrentIndexing();
+};
+
 } // namespace sorbet::core
 #endif // SORBET_UNFREEZING_H
@@ -27,15 +27,25 @@ Query Query::createVarQuery(core::SymbolRef owner, core::LocalVariable variable)
     return Query(Query::Kind::VAR, core::Loc::none(), owner, variable);
 }
 
+Query Query::createReferencesQuery() {
+    return Query(Query::Kind::REFERENCES, core::Loc::none(), core::Symbols::noSymbol(), core::LocalVariable());
+}
+
+Query Query::createEveryLocQuery() {
+    return Query(Query::Kind::EVERY_LOC, core::Loc::none(), core::Symbols::noSymbol(), core::LocalVariable());
+}
+
 bool Query::matchesSymbol(const core::SymbolRef &symbol) const {
-    return kind == Query::Kind::SYMBOL && this->symbol == symbol;
+    return (kind == Query::Kind::SYMBOL && this->symbol == symbol) ||
+           (kind == Query::Kind::REFERENCES && symbol.exists());
 }
 
 bool Query::matchesLoc(const core::Loc &loc) const {
     // N.B.: Sorbet inserts zero-length Locs for items that are implicitly inserted during parsing.
     // Example: `foo` may be translated into `self.foo`, where `self.` has a 0-length loc.
     // We disregard these in LSP matches, as they don't correspond to source text that the user is pointing at.
-    return kind == Query::Kind::LOC && (loc.endPos() - loc.beginPos()) > 0 && loc.contains(this->loc);
+    return (kind == Query::Kind::LOC || kind == Query::Kind::EVERY_LOC) && (loc.endPos() - loc.beginPos()) > 0 &&
+           (kind == Query::Kind::EVERY_LOC || loc.contains(this->loc));
 }
 
 bool Query::matchesVar(const core::SymbolRef &owner, const core::LocalVariable &var) const {
@@ -19,7 +19,11 @@ public:
         // Looking for all references to the given symbol.
         SYMBOL,
         // Looking for all references to the given variable.
-        VAR
+        VAR,
+        // Looking for the references to every symbol, to fill in the LSP reference index.
+        REFERENCES,
+        // Looking for the items at every location, to fill in the LSP location index.
+        EVERY_LOC
     };
 
     Kind kind;
@@ -33,6 +37,8 @@ public:
     static Query createLocQuery(core::Loc loc);
     static Query createSymbolQuery(core::SymbolRef symbol);
     static Query createVarQuery(core::SymbolRef owner, core::LocalVariable variable);
+    static Query createReferencesQuery();
+    static Query createEveryLocQuery();
 
     bool matchesSymbol(const core::SymbolRef &symbol) const;
     bool matchesLoc(const core::Loc &loc) const;
@@ -1,7 +1,10 @@
 // have to be included first as they violate our poisons
 #include "core/proto/proto.h"
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/util/type_resolver_util.h>
+#include <google/protobuf/wire_format_lite.h>
 
 #include "absl/strings/str_cat.h"
 #include "common/Counters_impl.h"
@@ -41,12 +44,14 @@ com::stripe::rubytyper::Symbol::ArgumentInfo Proto::toProto(const GlobalState &g
 
     return argProto;
 }
-com::stripe::rubytyper::Symbol Proto::toProto(const GlobalState &gs, SymbolRef sym, bool showFull) {
+
+namespace {
+com::stripe::rubytyper::Symbol toProtoWithoutChildren(const GlobalState &gs, SymbolRef sym) {
     com::stripe::rubytyper::Symbol symbolProto;
     const auto data = sym.data(gs);
 
     symbolProto.set_id(sym._id);
-    *symbolProto.mutable_name() = toProto(gs, data->name);
+    *symbolProto.mutable_name() = Proto::toProto(gs, data->name);
 
     if (data->isClass()) {
         symbolProto.set_kind(com::stripe::rubytyper::Symbol::CLASS);
@@ -69,7 +74,7 @@ com::stripe::rubytyper::Symbol Proto::toProto(const GlobalState &gs, SymbolRef s
             }
         } else {
             for (auto &thing : data->arguments()) {
-                *symbolProto.add_arguments() = toProto(gs, thing);
+                *symbolProto.add_arguments() = Proto::toProto(gs, thing);
             }
         }
 
@@ -84,7 +89,13 @@ com::stripe::rubytyper::Symbol Proto::toProto(const GlobalState &gs, SymbolRef s
         }
     }
 
-    for (auto pair : data->membersStableOrderSlow(gs)) {
+    return symbolProto;
+}
+
+// The members of `sym` that are printed as its children, in the order they are printed.
+vector<SymbolRef> printedChildren(const GlobalState &gs, SymbolRef sym, bool showFull) {
+    vector<SymbolRef> children;
+    for (auto pair : sym.data(gs)->membersStableOrderSlow(gs)) {
         if (pair.first == Names::singleton() || pair.first == Names::attached() ||
             pair.first == Names::classMethods()) {
             continue;
@@ -107,12 +118,142 @@ com::stripe::rubytyper::Symbol Proto::toProto(const GlobalState &gs, SymbolRef s
             }
         }
 
-        *symbolProto.add_children() = toProto(gs, pair.second, showFull);
+        children.emplace_back(pair.second);
     }
+    return children;
+}
+} // namespace
 
+com::stripe::rubytyper::Symbol Proto::toProto(const GlobalState &gs, SymbolRef sym, bool showFull) {
+    auto symbolProto = toProtoWithoutChildren(gs, sym);
+    for (auto child : printedChildren(gs, sym, showFull)) {
+        *symbolProto.add_children() = toProto(gs, child, showFull);
+    }
     return symbolProto;
 }
 
+namespace {
+constexpr size_t SYMBOL_STREAM_FLUSH_BYTES = 1024 * 1024;
+
+// Appends `json` to `out`, with every line after the first indented by `indent` more spaces.
+void appendIndented(string_view json, int indent, string &out) {
+    size_t start = 0;
+    while (start < json.size()) {
+        auto end = json.find('\n', start);
+        end = end == string_view::npos ? json.size() : end + 1;
+        if (start > 0) {
+            out.append(indent, ' ');
+        }
+        out.append(json.substr(start, end - start));
+        start = end;
+    }
+}
+
+// Writes what Proto::toJSON would print for Proto::toProto(gs, root, showFull), one symbol at a time. protobuf prints
+// fields in field number order, so each symbol is printed as its fields numbered before `children`, then its
+// children, then the fields numbered after them.
+class SymbolJSONWriter {
+    const GlobalState &gs;
+    const bool showFull;
+    const function<void(string_view)> &out;
+    string buf;
+
+    void maybeFlush() {
+        if (buf.size() >= SYMBOL_STREAM_FLUSH_BYTES) {
+            out(buf);
+            buf.clear();
+        }
+    }
+
+public:
+    SymbolJSONWriter(const GlobalState &gs, bool showFull, const function<void(string_view)> &out)
+        : gs(gs), showFull(showFull), out(out) {}
+
+    // Leaves out the newline after the closing brace, which only the outermost symbol has.
+    void write(SymbolRef sym, int indent) {
+        auto head = toProtoWithoutChildren(gs, sym);
+        com::stripe::rubytyper::Symbol tail;
+        tail.set_aliasto(head.aliasto());
+        tail.mutable_arguments()->Swap(head.mutable_arguments());
+        head.clear_aliasto();
+
+        // Everything but the final "\n}\n".
+        auto json = Proto::toJSON(head);
+        appendIndented(string_view(json).substr(0, json.size() - 3), indent, buf);
+
+        auto children = printedChildren(gs, sym, showFull);
+        if (!children.empty()) {
+            buf += ",\n";
+            buf.append(indent + 1, ' ');
+            buf += "\"children\": [\n";
+            bool first = true;
+            for (auto child : children) {
+                if (!first) {
+                    buf += ",\n";
+                }
+                first = false;
+                buf.append(indent + 2, ' ');
+                write(child, indent + 2);
+            }
+            buf += '\n';
+            buf.append(indent + 1, ' ');
+            buf += ']';
+        }
+
+        if (tail.ByteSizeLong() > 0) {
+            // Everything between the opening "{\n" and the final "\n}\n".
+            json = Proto::toJSON(tail);
+            buf += ",\n";
+            buf.append(indent, ' ');
+            appendIndented(string_view(json).substr(2, json.size() - 5), indent, buf);
+        }
+
+        buf += '\n';
+        buf.append(indent, ' ');
+        buf += '}';
+        maybeFlush();
+    }
+
+    void finish() {
+        buf += '\n';
+        out(buf);
+        buf.clear();
+    }
+};
+
+void appendDelimitedSymbols(const GlobalState &gs, SymbolRef sym, SymbolRef owner, bool showFull,
+                            const function<void(string_view)> &out, string &buf) {
+    auto symbolProto = toProtoWithoutChildren(gs, sym);
+    if (owner.exists()) {
+        symbolProto.set_owner(owner._id);
+    }
+    buf += Proto::toDelimited(symbolProto);
+    if (buf.size() >= SYMBOL_STREAM_FLUSH_BYTES) {
+        out(buf);
+        buf.clear();
+    }
+    for (auto child : printedChildren(gs, sym, showFull)) {
+        appendDelimitedSymbols(gs, child, sym, showFull, out, buf);
+    }
+}
+} // namespace
+
+void Proto::symbolsToJSON(const GlobalState &gs, SymbolRef root, bool showFull,
+                          const function<void(string_view)> &out) {
+    SymbolJSONWriter writer(gs, showFull, out);
+    writer.write(root, 0);
+    writer.finish();
+}
+
+void Proto::symbolsToDelimited(const GlobalState &gs, SymbolRef root, bool showFull,
+                               const function<void(string_view)> &out) {
+    string buf;
+    appendDelimitedSymbols(gs, root, Symbols::noSymbol(), showFull, out, buf);
+    if (!buf.empty()) {
+        out(buf);
+    }
+}
+
 com::stripe::rubytyper::Type::Literal Proto::toProto(const GlobalState &gs, const LiteralType &lit) {
     com::stripe::rubytyper::Type::Literal proto;
 
@@ -339,6 +480,29 @@ com::stripe::rubytyper::FileTable Proto::filesToProto(const GlobalState &gs) {
     return files;
 }
 
+com::stripe::rubytyper::Error Proto::toProto(const GlobalState &gs, const Error &error) {
+    com::stripe::rubytyper::Error protoError;
+    protoError.set_code(error.what.code);
+    protoError.set_is_critical(error.isCritical());
+    *protoError.mutable_loc() = toProto(gs, error.loc);
+    protoError.set_header(error.header);
+    for (auto &section : error.sections) {
+        auto *protoSection = protoError.add_sections();
+        protoSection->set_header(section.header);
+        for (auto &line : section.messages) {
+            auto *protoLine = protoSection->add_messages();
+            *protoLine->mutable_loc() = toProto(gs, line.loc);
+            protoLine->set_message(line.formattedMessage);
+        }
+    }
+    for (auto &autocorrect : error.autocorrects) {
+        auto *protoAutocorrect = protoError.add_autocorrects();
+        *protoAutocorrect->mutable_loc() = toProto(gs, autocorrect.loc);
+        protoAutocorrect->set_replacement(autocorrect.replacement);
+    }
+    return protoError;
+}
+
 string Proto::toJSON(const google::protobuf::Message &message) {
     string jsonString;
     google::protobuf::util::JsonPrintOptions options;
@@ -349,6 +513,26 @@ string Proto::toJSON(const google::protobuf::Message &message) {
     return jsonString;
 }
 
+string Proto::toDelimited(const google::protobuf::Message &message) {
+    string out;
+    {
+        google::protobuf::io::StringOutputStream raw(&out);
+        google::protobuf::io::CodedOutputStream coded(&raw);
+        coded.WriteVarint32(message.ByteSizeLong());
+        message.SerializeWithCachedSizes(&coded);
+    }
+    return out;
+}
+
+void Proto::appendAsRepeated(const google::protobuf::Message &message, int fieldNumber, string &out) {
+    using google::protobuf::internal::WireFormatLite;
+    google::protobuf::io::StringOutputStream raw(&out);
+    google::protobuf::io::CodedOutputStream coded(&raw);
+    coded.WriteTag(WireFormatLite::MakeTag(fieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+    coded.WriteVarint32(message.ByteSizeLong());
+    message.SerializeWithCachedSizes(&coded);
+}
+
 const char *kTypeUrlPrefix = "type.googleapis.com";
 
 void Proto::toJSON(const google::protobuf::Message &message, ostream &out) {
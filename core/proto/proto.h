@@ -1,6 +1,7 @@
 #ifndef SORBET_CORE_PROTO_H
 #define SORBET_CORE_PROTO_H
 // have to go first as they violate our poisons
+#include "proto/Error.pb.h"
 #include "proto/File.pb.h"
 #include "proto/Loc.pb.h"
 #include "proto/Name.pb.h"
@@ -9,8 +10,10 @@
 #include "proto/pay-server/SourceMetrics.pb.h"
 #include <google/protobuf/util/json_util.h>
 
+#include "core/Error.h"
 #include "core/core.h"
 #include <fstream>
+#include <functional>
 
 namespace sorbet::core {
 class Proto {
@@ -21,6 +24,18 @@ public:
 
     static com::stripe::rubytyper::Symbol::ArgumentInfo toProto(const GlobalState &gs, const ArgInfo &arg);
     static com::stripe::rubytyper::Symbol toProto(const GlobalState &gs, SymbolRef sym, bool showFull);
+    /**
+     * Writes the JSON that toJSON(toProto(gs, root, showFull)) would, handing it to `out` in pieces as it goes. Only
+     * one symbol's proto is built at a time, which keeps this usable for symbol tables too large to build whole.
+     */
+    static void symbolsToJSON(const GlobalState &gs, SymbolRef root, bool showFull,
+                              const std::function<void(std::string_view)> &out);
+    /**
+     * Writes `root` and every symbol toProto(gs, root, showFull) would print under it as length-delimited Symbols
+     * (see toDelimited), each before its children. Their `children` are left empty; each names its `owner` instead.
+     */
+    static void symbolsToDelimited(const GlobalState &gs, SymbolRef root, bool showFull,
+                                   const std::function<void(std::string_view)> &out);
 
     static com::stripe::rubytyper::Type::Literal toProto(const GlobalState &gs, const LiteralType &lit);
     static com::stripe::rubytyper::Type toProto(const GlobalState &gs, TypePtr typ);
@@ -28,11 +43,20 @@ public:
     static com::stripe::rubytyper::Loc toProto(const GlobalState &gs, Loc loc);
     static com::stripe::rubytyper::FileTable filesToProto(const GlobalState &gs);
 
+    static com::stripe::rubytyper::Error toProto(const GlobalState &gs, const Error &error);
+
     static com::stripe::payserver::events::cibot::SourceMetrics toProto(const CounterState &counters,
                                                                         std::string_view prefix);
 
     static std::string toJSON(const google::protobuf::Message &message);
     static void toJSON(const google::protobuf::Message &message, std::ostream &out);
+    /** Serializes `message` prefixed with its length as a varint, so that many can be written to one stream. */
+    static std::string toDelimited(const google::protobuf::Message &message);
+    /**
+     * Appends `message` to `out` as one element of the repeated message field `fieldNumber`, so that a run of them
+     * parses as the message holding that field without ever building it.
+     */
+    static void appendAsRepeated(const google::protobuf::Message &message, int fieldNumber, std::string &out);
 };
 } // namespace sorbet::core
 
@@ -14,13 +14,26 @@ public:
     void putS8(const int64_t i);
     void putStr(std::string_view s);
     std::vector<u1> result(int compressionDegree);
+    /**
+     * Like result(), but leaves the payload uncompressed: the header records a compressed size of 0, which Lizard
+     * never produces. UnPickler then reads such a blob in place instead of copying it into a buffer of its own.
+     */
+    std::vector<u1> resultUncompressed();
     Pickler() = default;
+
+    // State of the tree serializer: the begin of the last Loc it wrote, which the next one is written relative to,
+    // and the index of each name it has written so far, in order of first appearance.
+    u4 lastLocBegin = 0;
+    UnorderedMap<u4, u4> nameIndices;
 };
 
 class UnPickler {
     int pos;
     u1 zeroCounter = 0;
     std::vector<u1> data;
+    // Either data.data() or, for an uncompressed blob, a pointer into the blob itself. The blob must then outlive
+    // this unpickler.
+    const u1 *bytes;
 
 public:
     u4 getU4();
@@ -28,6 +41,14 @@ public:
     int64_t getS8();
     std::string_view getStr();
     explicit UnPickler(const u1 *const compressed, spdlog::logger &tracer);
+    /** Whether this reads straight out of the blob it was given, i.e. the blob was stored uncompressed. */
+    bool readsInPlace() const {
+        return bytes != data.data();
+    }
+
+    // Mirrors the tree serializer state of Pickler.
+    u4 lastLocBegin = 0;
+    std::vector<u4> names;
 };
 
 } // namespace sorbet::core::serialize
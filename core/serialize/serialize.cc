@@ -3,6 +3,7 @@
 #include "absl/types/span.h"
 #include "ast/Helpers.h"
 #include "common/Timer.h"
+#include "common/os/os.h"
 #include "common/typecase.h"
 #include "core/Error.h"
 #include "core/GlobalState.h"
@@ -10,6 +11,8 @@
 #include "core/serialize/pickler.h"
 #include "lib/lizard_compress.h"
 #include "lib/lizard_decompress.h"
+#include <atomic>
+#include <thread>
 
 template class std::vector<sorbet::u4>;
 
@@ -20,12 +23,36 @@ const u4 Serializer::VERSION;
 const u1 Serializer::GLOBAL_STATE_COMPRESSION_DEGREE;
 const u1 Serializer::FILE_COMPRESSION_DEGREE;
 
+// The strings of the names in one frame. They are handed over to the GlobalState once every frame has been read.
+struct StringArena {
+    static constexpr size_t PAGE_SIZE = 4096;
+    vector<shared_ptr<vector<char>>> pages;
+    size_t lastPageUsed = PAGE_SIZE;
+    // Set when the strings being entered live in a buffer that outlives the GlobalState, so they need no copy.
+    bool borrow = false;
+
+    string_view enter(string_view str) {
+        if (borrow) {
+            return str;
+        }
+        if (lastPageUsed + str.size() > PAGE_SIZE) {
+            pages.emplace_back(make_shared<vector<char>>(max(PAGE_SIZE, str.size())));
+            lastPageUsed = 0;
+        }
+        char *from = pages.back()->data() + lastPageUsed;
+        memcpy(from, str.data(), str.size());
+        lastPageUsed += str.size();
+        return string_view(from, str.size());
+    }
+};
+
 // These helper methods are declared in a class inside of an anonymous namespace
 // or inline so that `GlobalState` can forward-declare and `friend` the entire
 // class.
 class SerializerImpl {
 public:
-    static Pickler pickle(const GlobalState &gs, bool payloadOnly = false);
+    static vector<u1> pickle(const GlobalState &gs, bool payloadOnly = false, bool skipFiles = false,
+                             bool compress = true);
     static void pickle(Pickler &p, const File &what);
     static void pickle(Pickler &p, const Name &what);
     static void pickle(Pickler &p, Type *what);
@@ -33,15 +60,18 @@ public:
     static void pickle(Pickler &p, const Symbol &what);
     static void pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expression> &what);
     static void pickle(Pickler &p, core::Loc loc);
+    static void pickleTreeLoc(Pickler &p, core::Loc loc);
+    static void pickleNameRef(Pickler &p, NameRef name);
 
     template <class T> static void pickleTree(Pickler &p, FileRef file, unique_ptr<T> &t);
 
-    static shared_ptr<File> unpickleFile(UnPickler &p);
-    static Name unpickleName(UnPickler &p, GlobalState &gs);
+    static shared_ptr<File> unpickleFile(UnPickler &p, bool borrowSource);
+    static Name unpickleName(UnPickler &p, GlobalState &gs, StringArena &strings);
     static TypePtr unpickleType(UnPickler &p, GlobalState *gs);
     static ArgInfo unpickleArgInfo(UnPickler &p, GlobalState *gs);
     static Symbol unpickleSymbol(UnPickler &p, GlobalState *gs);
-    static void unpickleGS(UnPickler &p, GlobalState &result);
+    static void unpickleGS(const u1 *const data, GlobalState &result, bool keepFiles = false,
+                           bool dataOutlivesState = false);
     static Loc unpickleLoc(UnPickler &p, FileRef file);
     static unique_ptr<ast::Expression> unpickleExpr(UnPickler &p, GlobalState &, FileRef file);
     static NameRef unpickleNameRef(UnPickler &p, GlobalState &);
@@ -62,26 +92,23 @@ void Pickler::putStr(string_view s) {
 
 constexpr size_t SIZE_BYTES = sizeof(int) / sizeof(u1);
 
-vector<u1> Pickler::result(int compressionDegree) {
-    if (zeroCounter != 0) {
-        data.emplace_back(zeroCounter);
-        zeroCounter = 0;
-    }
-    const size_t maxDstSize = Lizard_compressBound(data.size());
+namespace {
+vector<u1> compressPickled(const u1 *data, size_t size, int compressionDegree) {
+    const size_t maxDstSize = Lizard_compressBound(size);
     vector<u1> compressedData;
     compressedData.resize(2048 + maxDstSize); // give extra room for compression
                                               // Lizard_compressBound returns size of data if compression
                                               // succeeds. It seems to be written for big inputs
                                               // and returns too small sizes for small inputs,
                                               // where compressed size is bigger than original size
-    int resultCode = Lizard_compress((const char *)data.data(), (char *)(compressedData.data() + SIZE_BYTES * 2),
-                                     data.size(), (compressedData.size() - SIZE_BYTES * 2), compressionDegree);
+    int resultCode = Lizard_compress((const char *)data, (char *)(compressedData.data() + SIZE_BYTES * 2), size,
+                                     (compressedData.size() - SIZE_BYTES * 2), compressionDegree);
     if (resultCode == 0) {
         // did not compress!
         Exception::raise("incompressible pickler?");
     } else {
         memcpy(compressedData.data(), &resultCode, SIZE_BYTES); // ~200K of our stdlib
-        int uncompressedSize = data.size();
+        int uncompressedSize = size;
         memcpy(compressedData.data() + SIZE_BYTES, &uncompressedSize,
                SIZE_BYTES);                                     // 172817 ints(x4), ~675K of our stdlib
         int actualCompressedSize = resultCode + SIZE_BYTES * 2; // SIZE_BYTES * 2 are for sizes
@@ -89,6 +116,30 @@ vector<u1> Pickler::result(int compressionDegree) {
     }
     return compressedData;
 }
+} // namespace
+
+vector<u1> Pickler::result(int compressionDegree) {
+    if (zeroCounter != 0) {
+        data.emplace_back(zeroCounter);
+        zeroCounter = 0;
+    }
+    return compressPickled(data.data(), data.size(), compressionDegree);
+}
+
+vector<u1> Pickler::resultUncompressed() {
+    if (zeroCounter != 0) {
+        data.emplace_back(zeroCounter);
+        zeroCounter = 0;
+    }
+    vector<u1> res;
+    res.resize(SIZE_BYTES * 2 + data.size());
+    int compressedSize = 0;
+    memcpy(res.data(), &compressedSize, SIZE_BYTES);
+    int uncompressedSize = data.size();
+    memcpy(res.data() + SIZE_BYTES, &uncompressedSize, SIZE_BYTES);
+    memcpy(res.data() + SIZE_BYTES * 2, data.data(), data.size());
+    return res;
+}
 
 UnPickler::UnPickler(const u1 *const compressed, spdlog::logger &tracer) : pos(0) {
     Timer timeit(tracer, "Unpickler::UnPickler");
@@ -97,6 +148,11 @@ UnPickler::UnPickler(const u1 *const compressed, spdlog::logger &tracer) : pos(0
     int uncompressedSize;
     memcpy(&uncompressedSize, compressed + SIZE_BYTES, SIZE_BYTES);
 
+    if (compressedSize == 0) {
+        bytes = compressed + 2 * SIZE_BYTES;
+        return;
+    }
+
     data.resize(uncompressedSize);
 
     int resultCode = Lizard_decompress_safe((const char *)(compressed + 2 * SIZE_BYTES), (char *)this->data.data(),
@@ -104,11 +160,12 @@ UnPickler::UnPickler(const u1 *const compressed, spdlog::logger &tracer) : pos(0
     if (resultCode != uncompressedSize) {
         Exception::raise("incomplete decompression");
     }
+    bytes = data.data();
 }
 
 string_view UnPickler::getStr() {
     int sz = getU4();
-    string_view result((char *)&data[pos], sz);
+    string_view result((char *)&bytes[pos], sz);
     pos += sz;
 
     return result;
@@ -124,7 +181,7 @@ void Pickler::putU1(u1 u) {
 
 u1 UnPickler::getU1() {
     ENFORCE(zeroCounter == 0);
-    auto res = data[pos++];
+    auto res = bytes[pos++];
     return res;
 }
 
@@ -161,9 +218,9 @@ u4 UnPickler::getU4() {
         zeroCounter--;
         return 0;
     }
-    u1 r = data[pos++];
+    u1 r = bytes[pos++];
     if (r == 0) {
-        zeroCounter = data[pos++];
+        zeroCounter = bytes[pos++];
         zeroCounter--;
         return r;
     } else {
@@ -173,25 +230,25 @@ u4 UnPickler::getU4() {
             goto done;
         }
 
-        vle = data[pos++];
+        vle = bytes[pos++];
         res |= (vle & 127) << 7;
         if ((vle & 128) == 0) {
             goto done;
         }
 
-        vle = data[pos++];
+        vle = bytes[pos++];
         res |= (vle & 127) << 14;
         if ((vle & 128) == 0) {
             goto done;
         }
 
-        vle = data[pos++];
+        vle = bytes[pos++];
         res |= (vle & 127) << 21;
         if ((vle & 128) == 0) {
             goto done;
         }
 
-        vle = data[pos++];
+        vle = bytes[pos++];
         res |= (vle & 127) << 28;
         if ((vle & 128) == 0) {
             goto done;
@@ -229,9 +286,12 @@ void SerializerImpl::pickle(Pickler &p, const File &what) {
     p.putStr(what.source());
 }
 
-shared_ptr<File> SerializerImpl::unpickleFile(UnPickler &p) {
+shared_ptr<File> SerializerImpl::unpickleFile(UnPickler &p, bool borrowSource) {
     auto t = (File::Type)p.getU1();
     auto path = string(p.getStr());
+    if (borrowSource && p.readsInPlace()) {
+        return make_shared<File>(std::move(path), File::BorrowedSource{p.getStr()}, t);
+    }
     auto source = string(p.getStr());
     auto ret = make_shared<File>(std::move(path), std::move(source), t);
     return ret;
@@ -254,13 +314,13 @@ void SerializerImpl::pickle(Pickler &p, const Name &what) {
     }
 }
 
-Name SerializerImpl::unpickleName(UnPickler &p, GlobalState &gs) {
+Name SerializerImpl::unpickleName(UnPickler &p, GlobalState &gs, StringArena &strings) {
     Name result;
     result.kind = (NameKind)p.getU1();
     switch (result.kind) {
         case NameKind::UTF8:
             result.kind = NameKind::UTF8;
-            result.raw.utf8 = gs.enterString(p.getStr());
+            result.raw.utf8 = strings.enter(p.getStr());
             break;
         case NameKind::UNIQUE:
             result.unique.uniqueNameKind = (UniqueNameKind)p.getU1();
@@ -344,7 +404,7 @@ TypePtr SerializerImpl::unpickleType(UnPickler &p, GlobalState *gs) {
             return empty;
         }
         case 1:
-            return make_type<ClassType>(SymbolRef(gs, p.getU4()));
+            return gs->typeInterner->classType(SymbolRef(gs, p.getU4()));
         case 2:
             return OrType::make_shared(unpickleType(p, gs), unpickleType(p, gs));
         case 3: {
@@ -404,7 +464,7 @@ TypePtr SerializerImpl::unpickleType(UnPickler &p, GlobalState *gs) {
             for (auto &t : targs) {
                 t = unpickleType(p, gs);
             }
-            return make_type<AppliedType>(klass, targs);
+            return gs->typeInterner->appliedType(klass, move(targs));
         }
         case 10: {
             SymbolRef sym(gs, p.getU4());
@@ -432,9 +492,10 @@ ArgInfo SerializerImpl::unpickleArgInfo(UnPickler &p, GlobalState *gs) {
     result.rebind = core::SymbolRef(gs, p.getU4());
     {
         core::Loc loc;
-        auto low = p.getU4();
-        auto high = p.getU4();
-        loc.setFrom2u4(low, high);
+        auto begin = p.getU4();
+        auto end = p.getU4();
+        auto file = p.getU4();
+        loc.setFrom3u4(begin, end, file);
         result.loc = loc;
     }
     {
@@ -462,6 +523,7 @@ void SerializerImpl::pickle(Pickler &p, const Symbol &what) {
         p.putU4(s._id);
     }
     if (what.isMethod()) {
+        p.putU4(what.intrinsicId);
         p.putU4(what.arguments().size());
         for (const auto &a : what.arguments()) {
             pickle(p, a);
@@ -509,6 +571,10 @@ Symbol SerializerImpl::unpickleSymbol(UnPickler &p, GlobalState *gs) {
     }
 
     if (result.isMethod()) {
+        result.intrinsicId = p.getU4();
+        ENFORCE(result.intrinsicId <= intrinsicMethods.size());
+        ENFORCE(!result.hasIntrinsic() || intrinsicMethods[result.intrinsicId - 1].method == result.name,
+                "Stored intrinsic does not match its method");
         int argsSize = p.getU4();
         for (int i = 0; i < argsSize; i++) {
             result.arguments().emplace_back(unpickleArgInfo(p, gs));
@@ -529,21 +595,77 @@ Symbol SerializerImpl::unpickleSymbol(UnPickler &p, GlobalState *gs) {
     auto locCount = p.getU4();
     for (int i = 0; i < locCount; i++) {
         core::Loc loc;
-        auto low = p.getU4();
-        auto high = p.getU4();
-        loc.setFrom2u4(low, high);
+        auto begin = p.getU4();
+        auto end = p.getU4();
+        auto file = p.getU4();
+        loc.setFrom3u4(begin, end, file);
         result.locs_.emplace_back(loc);
     }
     return result;
 }
 
-Pickler SerializerImpl::pickle(const GlobalState &gs, bool payloadOnly) {
+// A stored GlobalState starts with an uncompressed index, [VERSION][section count][offset of each section], which
+// is followed by the sections themselves. The entries of a section are split into frames that are compressed on
+// their own, so that they can be pickled and unpickled in parallel. A section is
+// [entry count][entries per frame][frame count][offset of each frame], and each frame starts with the index of its
+// first entry. All offsets are from the start of the stored state.
+enum GlobalStateSection : u1 { FILES_SECTION = 0, NAMES_SECTION, SYMBOLS_SECTION, NAME_TABLE_SECTION, SECTION_COUNT };
+
+// Frames are sized to keep every core busy on the standard library payload without the frames compressing badly.
+constexpr u4 ENTRIES_PER_FRAME[SECTION_COUNT] = {64, 16384, 4096, 65536};
+
+namespace {
+void putInt(vector<u1> &out, size_t at, int value) {
+    memcpy(out.data() + at, &value, SIZE_BYTES);
+}
+
+int getInt(const u1 *const data, size_t at) {
+    int value;
+    memcpy(&value, data + at, SIZE_BYTES);
+    return value;
+}
+
+// Runs `jobs` on up to one thread per core, the calling thread included, and rethrows the first exception any of
+// them threw.
+void runConcurrently(vector<function<void()>> jobs) {
+    vector<exception_ptr> failures(jobs.size());
+    atomic<int> nextJob{0};
+    auto run = [&jobs, &failures, &nextJob]() {
+        for (int i = nextJob++; i < jobs.size(); i = nextJob++) {
+            try {
+                jobs[i]();
+            } catch (...) {
+                failures[i] = current_exception();
+            }
+        }
+    };
+    {
+        vector<unique_ptr<Joinable>> threads;
+#ifndef EMSCRIPTEN
+        int threadCount = min<int>(jobs.size(), thread::hardware_concurrency());
+        for (int i = 1; i < threadCount; i++) {
+            threads.emplace_back(runInAThread("serializeGS", run));
+        }
+#endif
+        run();
+        // `threads` joins on destruction
+    }
+    for (auto &failure : failures) {
+        if (failure) {
+            rethrow_exception(failure);
+        }
+    }
+}
+
+} // namespace
+
+vector<u1> SerializerImpl::pickle(const GlobalState &gs, bool payloadOnly, bool skipFiles, bool compress) {
     Timer timeit(gs.tracer(), "pickleGlobalState");
-    Pickler result;
-    result.putU4(Serializer::VERSION);
 
     absl::Span<const shared_ptr<File>> wantFiles;
-    if (payloadOnly) {
+    if (skipFiles) {
+        // leave `wantFiles` empty
+    } else if (payloadOnly) {
         auto lastPayload =
             absl::c_find_if(gs.files, [](auto &file) { return file && file->sourceType != File::Payload; });
         ENFORCE(none_of(lastPayload, gs.files.end(), [](auto &file) { return file->sourceType == File::Payload; }));
@@ -552,33 +674,66 @@ Pickler SerializerImpl::pickle(const GlobalState &gs, bool payloadOnly) {
         wantFiles = absl::Span<const shared_ptr<File>>(gs.files.data(), gs.files.size());
     }
 
-    result.putU4(wantFiles.size());
-    int i = -1;
-    for (auto &f : wantFiles) {
-        ++i;
-        if (i != 0) {
-            pickle(result, *f);
+    const u4 counts[SECTION_COUNT] = {(u4)wantFiles.size(), gs.names.size(), gs.symbols.size(),
+                                      (u4)gs.namesByHash.size()};
+    auto pickleEntry = [&](GlobalStateSection section, Pickler &p, u4 i) {
+        switch (section) {
+            case FILES_SECTION:
+                if (i != 0) {
+                    pickle(p, *wantFiles[i]);
+                }
+                break;
+            case NAMES_SECTION:
+                if (i != 0) {
+                    pickle(p, gs.names[i]);
+                }
+                break;
+            case SYMBOLS_SECTION:
+                pickle(p, gs.symbols[i]);
+                break;
+            case NAME_TABLE_SECTION:
+                p.putU4(gs.namesByHash[i].first);
+                p.putU4(gs.namesByHash[i].second);
+                break;
+            case SECTION_COUNT:
+                break;
         }
-    }
-
-    result.putU4(gs.names.size());
-    i = -1;
-    for (const Name &n : gs.names) {
-        ++i;
-        if (i != 0) {
-            pickle(result, n);
+    };
+
+    vector<vector<u1>> frames[SECTION_COUNT];
+    vector<function<void()>> jobs;
+    for (int section = 0; section < SECTION_COUNT; section++) {
+        const u4 perFrame = ENTRIES_PER_FRAME[section];
+        frames[section].resize((counts[section] + perFrame - 1) / perFrame);
+        for (u4 frame = 0; frame < frames[section].size(); frame++) {
+            jobs.emplace_back([&, section, frame, perFrame]() {
+                Pickler p;
+                const u4 begin = frame * perFrame;
+                p.putU4(begin);
+                for (u4 i = begin; i < min(begin + perFrame, counts[section]); i++) {
+                    pickleEntry((GlobalStateSection)section, p, i);
+                }
+                frames[section][frame] =
+                    compress ? p.result(Serializer::GLOBAL_STATE_COMPRESSION_DEGREE) : p.resultUncompressed();
+            });
         }
     }
-
-    result.putU4(gs.symbols.size());
-    for (const Symbol &s : gs.symbols) {
-        pickle(result, s);
-    }
-
-    result.putU4(gs.namesByHash.size());
-    for (const auto &s : gs.namesByHash) {
-        result.putU4(s.first);
-        result.putU4(s.second);
+    runConcurrently(move(jobs));
+
+    vector<u1> result(SIZE_BYTES * (2 + SECTION_COUNT));
+    putInt(result, 0, Serializer::VERSION);
+    putInt(result, SIZE_BYTES, SECTION_COUNT);
+    for (int section = 0; section < SECTION_COUNT; section++) {
+        const size_t sectionStart = result.size();
+        putInt(result, SIZE_BYTES * (2 + section), sectionStart);
+        result.resize(sectionStart + SIZE_BYTES * (3 + frames[section].size()));
+        putInt(result, sectionStart, counts[section]);
+        putInt(result, sectionStart + SIZE_BYTES, ENTRIES_PER_FRAME[section]);
+        putInt(result, sectionStart + SIZE_BYTES * 2, frames[section].size());
+        for (int frame = 0; frame < frames[section].size(); frame++) {
+            putInt(result, sectionStart + SIZE_BYTES * (3 + frame), result.size());
+            result.insert(result.end(), frames[section][frame].begin(), frames[section][frame].end());
+        }
     }
     return result;
 }
@@ -591,126 +746,227 @@ int nearestPowerOf2(int from) {
     return i;
 }
 
-void SerializerImpl::unpickleGS(UnPickler &p, GlobalState &result) {
+void SerializerImpl::unpickleGS(const u1 *const data, GlobalState &result, bool keepFiles, bool dataOutlivesState) {
     Timer timeit(result.tracer(), "unpickleGS");
     result.creation = timeit.getFlowEdge();
-    if (p.getU4() != Serializer::VERSION) {
+    if (getInt(data, 0) != (int)Serializer::VERSION || getInt(data, SIZE_BYTES) != SECTION_COUNT) {
         Exception::raise("Payload version mismatch");
     }
-
-    vector<shared_ptr<File>> files(std::move(result.files));
-    files.clear();
-    vector<Name> names(std::move(result.names));
-    names.clear();
-    vector<Symbol> symbols(std::move(result.symbols));
-    symbols.clear();
-    vector<pair<unsigned int, unsigned int>> namesByHash(std::move(result.namesByHash));
-    namesByHash.clear();
-    {
-        Timer timeit(result.tracer(), "readFiles");
-
-        int filesSize = p.getU4();
-        files.reserve(filesSize);
-        for (int i = 0; i < filesSize; i++) {
-            if (i == 0) {
-                files.emplace_back();
-            } else {
-                files.emplace_back(unpickleFile(p));
-            }
+    // The symbols it was built from are about to be replaced
+    result.ancestorIndex = nullptr;
+
+    struct Section {
+        u4 count;
+        u4 perFrame;
+        u4 frameCount;
+        size_t frameOffsets;
+    };
+    auto section = [&](GlobalStateSection which) {
+        const size_t start = getInt(data, SIZE_BYTES * (2 + which));
+        return Section{(u4)getInt(data, start), (u4)getInt(data, start + SIZE_BYTES),
+                       (u4)getInt(data, start + SIZE_BYTES * 2), start + SIZE_BYTES * 3};
+    };
+    // Calls `readEntry(p, i)` for every entry of `which`, one job per frame.
+    vector<function<void()>> jobs;
+    auto readFrames = [&](GlobalStateSection which, ConstExprStr timerName, auto readEntry) {
+        auto layout = section(which);
+        for (u4 frame = 0; frame < layout.frameCount; frame++) {
+            jobs.emplace_back([&result, data, layout, frame, timerName, readEntry]() {
+                Timer timeit(result.tracer(), timerName);
+                UnPickler p(data + getInt(data, layout.frameOffsets + SIZE_BYTES * frame), result.tracer());
+                const u4 begin = p.getU4();
+                ENFORCE(begin == frame * layout.perFrame);
+                for (u4 i = begin; i < min(begin + layout.perFrame, layout.count); i++) {
+                    readEntry(p, i);
+                }
+            });
         }
+        return layout;
+    };
+
+    vector<shared_ptr<File>> files;
+    if (!keepFiles) {
+        files = std::move(result.files);
+        files.clear();
+        // A state that keeps its own files never needs to look at this section.
+        files.resize(readFrames(FILES_SECTION, "readFiles", [&files, dataOutlivesState](UnPickler &p, u4 i) {
+                         if (i != 0) {
+                             files[i] = unpickleFile(p, dataOutlivesState);
+                         }
+                     }).count);
     }
 
-    {
-        Timer timeit(result.tracer(), "readNames");
-
-        int namesSize = p.getU4();
-        ENFORCE(namesSize > 0);
-        names.reserve(nearestPowerOf2(namesSize));
-        for (int i = 0; i < namesSize; i++) {
-            if (i == 0) {
-                auto &inserted = names.emplace_back();
-                inserted.kind = NameKind::UTF8;
-                inserted.raw.utf8 = string_view();
-            } else {
-                names.emplace_back(unpickleName(p, result));
-            }
+    // Names and symbols are read into one buffer per frame, and strings into one arena per frame, which are only
+    // moved into `result` once every frame is done.
+    auto namesLayout = section(NAMES_SECTION);
+    ENFORCE(namesLayout.count > 0);
+    vector<vector<Name>> nameFrames(namesLayout.frameCount);
+    vector<StringArena> arenas(namesLayout.frameCount);
+    readFrames(NAMES_SECTION, "readNames", [&, namesLayout](UnPickler &p, u4 i) {
+        const u4 frame = i / namesLayout.perFrame;
+        arenas[frame].borrow = dataOutlivesState && p.readsInPlace();
+        if (i == 0) {
+            auto &inserted = nameFrames[frame].emplace_back();
+            inserted.kind = NameKind::UTF8;
+            inserted.raw.utf8 = string_view();
+        } else {
+            nameFrames[frame].emplace_back(unpickleName(p, result, arenas[frame]));
         }
-    }
+    });
 
-    {
-        Timer timeit(result.tracer(), "readSymbols");
+    auto symbolsLayout = section(SYMBOLS_SECTION);
+    ENFORCE(symbolsLayout.count > 0);
+    vector<vector<Symbol>> symbolFrames(symbolsLayout.frameCount);
+    readFrames(SYMBOLS_SECTION, "readSymbols", [&result, &symbolFrames, symbolsLayout](UnPickler &p, u4 i) {
+        symbolFrames[i / symbolsLayout.perFrame].emplace_back(unpickleSymbol(p, &result));
+    });
 
-        int symbolSize = p.getU4();
-        ENFORCE(symbolSize > 0);
-        symbols.reserve(symbolSize);
-        for (int i = 0; i < symbolSize; i++) {
-            symbols.emplace_back(unpickleSymbol(p, &result));
-        }
-    }
+    vector<pair<unsigned int, unsigned int>> namesByHash(std::move(result.namesByHash));
+    namesByHash.clear();
+    namesByHash.resize(section(NAME_TABLE_SECTION).count);
+    readFrames(NAME_TABLE_SECTION, "readNameTable", [&namesByHash](UnPickler &p, u4 i) {
+        auto hash = p.getU4();
+        auto value = p.getU4();
+        namesByHash[i] = make_pair(hash, value);
+    });
 
+    runConcurrently(move(jobs));
+
+    CopyOnWriteVector<Name> names(std::move(result.names));
+    names.clear();
+    CopyOnWriteVector<Symbol> symbols(std::move(result.symbols));
+    symbols.clear();
     {
-        Timer timeit(result.tracer(), "readNameTable");
-        int namesByHashSize = p.getU4();
-        names.reserve(namesByHashSize / 2);
+        Timer timeit(result.tracer(), "collectFrames");
+        names.reserve(max((size_t)nearestPowerOf2(namesLayout.count), namesByHash.size() / 2));
+        for (auto &frame : nameFrames) {
+            for (auto &name : frame) {
+                names.emplace_back(std::move(name));
+            }
+        }
         namesByHash.reserve(names.capacity() * 2);
-        for (int i = 0; i < namesByHashSize; i++) {
-            auto hash = p.getU4();
-            auto value = p.getU4();
-            namesByHash.emplace_back(make_pair(hash, value));
+        symbols.reserve(symbolsLayout.count);
+        for (auto &frame : symbolFrames) {
+            for (auto &symbol : frame) {
+                symbols.emplace_back(std::move(symbol));
+            }
         }
+        // Keep the page that `result` is still filling last.
+        auto insertAt = result.strings.empty() ? result.strings.end() : result.strings.end() - 1;
+        vector<shared_ptr<vector<char>>> pages;
+        for (auto &arena : arenas) {
+            pages.insert(pages.end(), make_move_iterator(arena.pages.begin()), make_move_iterator(arena.pages.end()));
+        }
+        result.strings.insert(insertAt, make_move_iterator(pages.begin()), make_move_iterator(pages.end()));
     }
 
-    UnorderedMap<string, FileRef> fileRefByPath;
-    int i = 0;
-    for (auto f : files) {
-        if (f && !f->path().empty()) {
-            fileRefByPath[string(f->path())] = FileRef(i);
+    if (!keepFiles) {
+        UnorderedMap<string, FileRef> fileRefByPath;
+        int i = 0;
+        for (auto f : files) {
+            if (f && !f->path().empty()) {
+                fileRefByPath[string(f->path())] = FileRef(i);
+            }
+            i++;
         }
-        i++;
+        result.fileRefByPath = std::move(fileRefByPath);
+        result.files = std::move(files);
     }
 
     {
         Timer timeit(result.tracer(), "moving");
-        result.fileRefByPath = std::move(fileRefByPath);
-        result.files = std::move(files);
         result.names = std::move(names);
         result.symbols = std::move(symbols);
         result.namesByHash = std::move(namesByHash);
     }
+    result.ownHashes.clear();
+    result.symbolEpoch_++;
     result.sanityCheck();
 }
 
 void SerializerImpl::pickle(Pickler &p, Loc loc) {
-    auto [low, high] = loc.getAs2u4();
-    p.putU4(low);
-    p.putU4(high);
+    auto [begin, end, file] = loc.getAs3u4();
+    p.putU4(begin);
+    p.putU4(end);
+    p.putU4(file);
+}
+
+namespace {
+// Maps small negative and positive deltas alike to small varints.
+u4 zigzag(int delta) {
+    return ((u4)delta << 1) ^ (u4)(delta >> 31);
+}
+
+int unzigzag(u4 encoded) {
+    return (int)(encoded >> 1) ^ -(int)(encoded & 1);
+}
+} // namespace
+
+// Locs in trees always belong to the file being pickled, so only their range is written: the begin relative to the
+// previous Loc's begin, which is usually close by, followed by the length.
+void SerializerImpl::pickleTreeLoc(Pickler &p, Loc loc) {
+    auto [begin, end, file] = loc.getAs3u4();
+    p.putU4(zigzag(begin - p.lastLocBegin));
+    p.putU4(zigzag(end - begin));
+    if (begin != Loc::INVALID_POS_LOC) {
+        p.lastLocBegin = begin;
+    }
 }
 
 Loc SerializerImpl::unpickleLoc(UnPickler &p, FileRef file) {
     Loc loc;
-    auto low = p.getU4();
-    auto high = p.getU4();
-    loc.setFrom2u4(low, high);
-    loc.setFile(file);
+    u4 begin = p.lastLocBegin + unzigzag(p.getU4());
+    u4 end = begin + unzigzag(p.getU4());
+    if (begin != Loc::INVALID_POS_LOC) {
+        p.lastLocBegin = begin;
+    }
+    loc.setFrom3u4(begin, end, file.id());
     return loc;
 }
 
-vector<u1> Serializer::store(GlobalState &gs) {
-    Pickler p = SerializerImpl::pickle(gs);
-    return p.result(GLOBAL_STATE_COMPRESSION_DEGREE);
+// A name is written as its id the first time, and as its index among the names written before it after that; 0 marks
+// a first appearance.
+void SerializerImpl::pickleNameRef(Pickler &p, NameRef name) {
+    auto [it, inserted] = p.nameIndices.emplace(name._id, p.nameIndices.size() + 1);
+    if (inserted) {
+        p.putU4(0);
+        p.putU4(name._id);
+    } else {
+        p.putU4(it->second);
+    }
 }
 
-vector<u1> Serializer::storePayloadAndNameTable(GlobalState &gs) {
+vector<u1> Serializer::store(GlobalState &gs, bool compress) {
+    return SerializerImpl::pickle(gs, false, false, compress);
+}
+
+vector<u1> Serializer::storePayloadAndNameTable(GlobalState &gs, bool compress) {
     Timer timeit(gs.tracer(), "Serializer::storePayloadAndNameTable");
-    Pickler p = SerializerImpl::pickle(gs, true);
-    return p.result(GLOBAL_STATE_COMPRESSION_DEGREE);
+    return SerializerImpl::pickle(gs, true, false, compress);
 }
 
-void Serializer::loadGlobalState(GlobalState &gs, const u1 *const data) {
+vector<u1> Serializer::compressGlobalState(const vector<u1> &stored) {
+    int compressedSize;
+    memcpy(&compressedSize, stored.data(), SIZE_BYTES);
+    if (compressedSize != 0) {
+        return stored;
+    }
+    return compressPickled(stored.data() + SIZE_BYTES * 2, stored.size() - SIZE_BYTES * 2,
+                           GLOBAL_STATE_COMPRESSION_DEGREE);
+}
+
+void Serializer::loadGlobalState(GlobalState &gs, const u1 *const data, bool dataOutlivesState) {
     ENFORCE(gs.files.empty() && gs.names.empty() && gs.symbols.empty(), "Can't load into a non-empty state");
-    UnPickler p(data, gs.tracer());
-    SerializerImpl::unpickleGS(p, gs);
-    gs.installIntrinsics();
+    SerializerImpl::unpickleGS(data, gs, false, dataOutlivesState);
+}
+
+vector<u1> Serializer::storeNamesAndSymbols(GlobalState &gs) {
+    Timer timeit(gs.tracer(), "Serializer::storeNamesAndSymbols");
+    return SerializerImpl::pickle(gs, false, true);
+}
+
+void Serializer::loadNamesAndSymbols(GlobalState &gs, const u1 *const data) {
+    SerializerImpl::unpickleGS(data, gs, true);
 }
 
 template <class T> void SerializerImpl::pickleTree(Pickler &p, FileRef file, unique_ptr<T> &t) {
@@ -723,7 +979,7 @@ template <class T> void SerializerImpl::pickleTree(Pickler &p, FileRef file, uni
 
 void SerializerImpl::pickleAstHeader(Pickler &p, u1 tag, ast::Expression *tree) {
     p.putU1(tag);
-    pickle(p, tree->loc);
+    pickleTreeLoc(p, tree->loc);
 }
 
 void SerializerImpl::pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expression> &what) {
@@ -738,7 +994,7 @@ void SerializerImpl::pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expr
         what.get(),
         [&](ast::Send *s) {
             pickleAstHeader(p, 2, s);
-            p.putU4(s->fun._id);
+            pickleNameRef(p, s->fun);
             p.putU4(s->flags);
             p.putU4(s->args.size());
             pickle(p, file, s->recv);
@@ -777,7 +1033,7 @@ void SerializerImpl::pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expr
 
         [&](ast::UnresolvedConstantLit *a) {
             pickleAstHeader(p, 8, a);
-            p.putU4(a->cnst._id);
+            pickleNameRef(p, a->cnst);
             pickle(p, file, a->scope);
         },
         [&](ast::Field *a) {
@@ -786,7 +1042,7 @@ void SerializerImpl::pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expr
         },
         [&](ast::Local *a) {
             pickleAstHeader(p, 10, a);
-            p.putU4(a->localVariable._name._id);
+            pickleNameRef(p, a->localVariable._name);
             p.putU4(a->localVariable.unique);
         },
         [&](ast::Assign *a) {
@@ -837,7 +1093,7 @@ void SerializerImpl::pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expr
 
         [&](ast::Cast *c) {
             pickleAstHeader(p, 19, c);
-            p.putU4(c->cast._id);
+            pickleNameRef(p, c->cast);
             pickle(p, c->type.get());
             pickle(p, file, c->arg);
         },
@@ -845,7 +1101,7 @@ void SerializerImpl::pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expr
         [&](ast::EmptyTree *n) { pickleAstHeader(p, 20, n); },
         [&](ast::ClassDef *c) {
             pickleAstHeader(p, 21, c);
-            pickle(p, c->declLoc);
+            pickleTreeLoc(p, c->declLoc);
             p.putU1(c->kind);
             p.putU4(c->symbol._id);
             p.putU4(c->ancestors.size());
@@ -864,9 +1120,9 @@ void SerializerImpl::pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expr
         },
         [&](ast::MethodDef *c) {
             pickleAstHeader(p, 22, c);
-            pickle(p, c->declLoc);
+            pickleTreeLoc(p, c->declLoc);
             p.putU4(c->flags);
-            p.putU4(c->name._id);
+            pickleNameRef(p, c->name);
             p.putU4(c->symbol._id);
             p.putU4(c->args.size());
             pickle(p, file, c->rhs);
@@ -918,11 +1174,12 @@ void SerializerImpl::pickle(Pickler &p, FileRef file, const unique_ptr<ast::Expr
         [&](ast::UnresolvedIdent *a) {
             pickleAstHeader(p, 31, a);
             p.putU1((int)a->kind);
-            p.putU4(a->name._id);
+            pickleNameRef(p, a->name);
         },
         [&](ast::ConstantLit *a) {
             pickleAstHeader(p, 32, a);
             p.putU4(a->symbol._id);
+            p.putU4(a->resolutionScope._id);
             pickleTree(p, file, a->original);
         },
 
@@ -1042,7 +1299,7 @@ unique_ptr<ast::Expression> SerializerImpl::unpickleExpr(serialize::UnPickler &p
             return ast::MK::Array(loc, std::move(elems));
         }
         case 19: {
-            NameRef kind(gs, p.getU4());
+            NameRef kind = unpickleNameRef(p, gs);
             auto type = unpickleType(p, &gs);
             auto arg = unpickleExpr(p, gs, file);
             return make_unique<ast::Cast>(loc, std::move(type), std::move(arg), kind);
@@ -1151,9 +1408,12 @@ unique_ptr<ast::Expression> SerializerImpl::unpickleExpr(serialize::UnPickler &p
         }
         case 32: {
             SymbolRef sym(gs, p.getU4());
+            SymbolRef resolutionScope(gs, p.getU4());
             auto origTmp = unpickleExpr(p, gs, file);
             unique_ptr<ast::UnresolvedConstantLit> orig(static_cast<ast::UnresolvedConstantLit *>(origTmp.release()));
-            return make_unique<ast::ConstantLit>(loc, sym, std::move(orig));
+            auto cnst = make_unique<ast::ConstantLit>(loc, sym, std::move(orig));
+            cnst->resolutionScope = resolutionScope;
+            return cnst;
         }
     }
     Exception::raise("Not handled {}", kind);
@@ -1166,15 +1426,110 @@ unique_ptr<ast::Expression> Serializer::loadExpression(GlobalState &gs, const u1
     return SerializerImpl::unpickleExpr(up, gs, fileId);
 }
 
-vector<u1> Serializer::storeExpression(GlobalState &gs, unique_ptr<ast::Expression> &e) {
+vector<u1> Serializer::storeExpression(GlobalState &gs, unique_ptr<ast::Expression> &e, bool compress) {
     serialize::Pickler pickler;
     pickler.putU4(e->loc.file().id());
     SerializerImpl::pickle(pickler, e->loc.file(), e);
+    if (!compress) {
+        return pickler.resultUncompressed();
+    }
     return pickler.result(FILE_COMPRESSION_DEGREE);
 }
 
+vector<u1> Serializer::storeFileState(const CachedFileState &state) {
+    serialize::Pickler p;
+    p.putStr(state.sourceHash);
+    p.putU4(state.hash.definitions.hierarchyHash);
+    p.putU4(state.hash.definitions.methodHashes.size());
+    for (const auto &[name, hash] : state.hash.definitions.methodHashes) {
+        p.putU4(name._hashValue);
+        p.putU4(hash);
+    }
+    p.putU4(state.hash.definitions.definitionShapes.size());
+    for (const auto &[shape, name] : state.hash.definitions.definitionShapes) {
+        p.putU4(shape);
+        p.putU4(name._hashValue);
+    }
+    for (const auto *usages : {&state.hash.usages.sends, &state.hash.usages.constants}) {
+        p.putU4(usages->size());
+        for (const auto &name : *usages) {
+            p.putU4(name._hashValue);
+        }
+    }
+    p.putU4(state.errors.size());
+    for (const auto &error : state.errors) {
+        p.putU4(error.code);
+        p.putStr(error.text);
+    }
+    return p.result(FILE_COMPRESSION_DEGREE);
+}
+
+vector<u1> Serializer::storeErrors(const vector<RenderedError> &errors) {
+    serialize::Pickler p;
+    p.putU4(errors.size());
+    for (const auto &error : errors) {
+        p.putU4(error.file.id());
+        p.putU4(error.code);
+        p.putStr(error.text);
+    }
+    return p.result(FILE_COMPRESSION_DEGREE);
+}
+
+vector<RenderedError> Serializer::loadErrors(GlobalState &gs, const u1 *const data) {
+    serialize::UnPickler p(data, gs.tracer());
+    vector<RenderedError> errors(p.getU4());
+    for (auto &error : errors) {
+        error.file = FileRef(p.getU4());
+        error.code = p.getU4();
+        error.text = string(p.getStr());
+    }
+    return errors;
+}
+
+CachedFileState Serializer::loadFileState(GlobalState &gs, FileRef file, const u1 *const data) {
+    serialize::UnPickler p(data, gs.tracer());
+    CachedFileState state;
+    state.sourceHash = string(p.getStr());
+    state.hash.definitions.hierarchyHash = p.getU4();
+    auto methodCount = p.getU4();
+    state.hash.definitions.methodHashes.reserve(methodCount);
+    for (int i = 0; i < methodCount; i++) {
+        NameHash name;
+        name._hashValue = p.getU4();
+        state.hash.definitions.methodHashes[name] = p.getU4();
+    }
+    state.hash.definitions.definitionShapes.resize(p.getU4());
+    for (auto &[shape, name] : state.hash.definitions.definitionShapes) {
+        shape = p.getU4();
+        name._hashValue = p.getU4();
+    }
+    for (auto *usages : {&state.hash.usages.sends, &state.hash.usages.constants}) {
+        auto count = p.getU4();
+        usages->resize(count);
+        for (auto &name : *usages) {
+            name._hashValue = p.getU4();
+        }
+    }
+    auto errorCount = p.getU4();
+    state.errors.reserve(errorCount);
+    for (int i = 0; i < errorCount; i++) {
+        auto &error = state.errors.emplace_back();
+        error.file = file;
+        error.code = p.getU4();
+        error.text = string(p.getStr());
+    }
+    return state;
+}
+
 NameRef SerializerImpl::unpickleNameRef(UnPickler &p, GlobalState &gs) {
-    NameRef name(NameRef::WellKnown{}, p.getU4());
+    u4 id;
+    auto index = p.getU4();
+    if (index == 0) {
+        id = p.names.emplace_back(p.getU4());
+    } else {
+        id = p.names[index - 1];
+    }
+    NameRef name(NameRef::WellKnown{}, id);
     ENFORCE(name.data(gs)->ref(gs) == name);
     return name;
 }
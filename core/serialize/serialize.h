@@ -1,31 +1,62 @@
 #ifndef SORBET_SERIALIZE_H
 #define SORBET_SERIALIZE_H
 #include "ast/ast.h"
+#include "core/ErrorQueueMessage.h"
+#include "core/NameHash.h"
 #include "core/core.h"
 
 namespace sorbet::core::serialize {
+// What an incremental run remembers about a file between invocations: the hash of the source it saw, the
+// dependency hashes computed from that source, and the errors the file reported.
+struct CachedFileState {
+    std::string sourceHash;
+    FileHash hash;
+    std::vector<RenderedError> errors;
+};
+
 class Serializer {
 public:
-    static const u4 VERSION = 4;
+    static const u4 VERSION = 9;
     static const u1 GLOBAL_STATE_COMPRESSION_DEGREE =
         10; // >20 introduce decompression slowdown, >10 introduces compression slowdown
     static const u1 FILE_COMPRESSION_DEGREE =
         10; // >20 introduce decompression slowdown, >10 introduces compression slowdown
 
-    // Serialize a global state
-    static std::vector<u1> store(GlobalState &gs);
+    // Serialize a global state. Without `compress`, the state is bigger but `loadGlobalState` can read it in place.
+    static std::vector<u1> store(GlobalState &gs, bool compress = true);
 
     // Stores a GlobalState, but only includes `File`s with Type ==
     // Payload. This can be used in conjunction with `storeExpression` to store
     // a global state containing a name table along side a large number of
-    // individual cached files, which can be loaded independently.
-    static std::vector<u1> storePayloadAndNameTable(GlobalState &gs);
-    static std::vector<u1> storeExpression(GlobalState &gs, std::unique_ptr<ast::Expression> &e);
+    // individual cached files, which can be loaded independently. `compress` is as for `store`.
+    static std::vector<u1> storePayloadAndNameTable(GlobalState &gs, bool compress = true);
+    // What `store` or `storePayloadAndNameTable` would have returned with `compress` set, given what they returned
+    // without it. Saves pickling the state twice when both forms are needed.
+    static std::vector<u1> compressGlobalState(const std::vector<u1> &stored);
+    // With `compress` unset the tree is stored uncompressed, which trades space for letting `loadExpression` read it
+    // straight out of the buffer it is handed (e.g. a KeyValueStore mapping) without decompressing a copy first.
+    static std::vector<u1> storeExpression(GlobalState &gs, std::unique_ptr<ast::Expression> &e,
+                                           bool compress = true);
 
-    // Loads an ast::Expression saved by storeExpression. Optionally overrides
+    // Loads an ast::Expression saved by storeExpression, in either format. Optionally overrides
     // the saved file ID to the caller-specified ID.
     static std::unique_ptr<ast::Expression> loadExpression(GlobalState &gs, const u1 *const p, u4 forceId = 0);
-    static void loadGlobalState(GlobalState &gs, const u1 *const data);
+    // With `dataOutlivesState`, names of a state stored uncompressed keep pointing into `data` instead of being copied,
+    // which suits a payload compiled into the binary.
+    static void loadGlobalState(GlobalState &gs, const u1 *const data, bool dataOutlivesState = false);
+
+    // Stores the name and symbol tables of `gs` without its files. `loadNamesAndSymbols` swaps them into a `gs`
+    // whose file table matches the one of the state that was stored.
+    static std::vector<u1> storeNamesAndSymbols(GlobalState &gs);
+    static void loadNamesAndSymbols(GlobalState &gs, const u1 *const data);
+
+    static std::vector<u1> storeErrors(const std::vector<RenderedError> &errors);
+    static std::vector<RenderedError> loadErrors(GlobalState &gs, const u1 *const data);
+
+    // Stores and loads a CachedFileState. The `file` field of the errors is not saved; it is set to `file`
+    // when loading.
+    static std::vector<u1> storeFileState(const CachedFileState &state);
+    static CachedFileState loadFileState(GlobalState &gs, FileRef file, const u1 *const data);
 };
 }; // namespace sorbet::core::serialize
 
@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 // has to go first as it violates are requirements
+#include "core/ErrorQueue.h"
 #include "core/serialize/pickler.h"
+#include "core/Unfreeze.h"
 #include "core/serialize/serialize.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
@@ -78,4 +80,90 @@ TEST(SerializeTest, Strings) { // NOLINT
     EXPECT_EQ(u.getStr(), "\0\0\0\t\n\f\rНЯЯЯЯЯ");
 }
 
+TEST(SerializeTest, FileState) { // NOLINT
+    GlobalState gs(make_shared<ErrorQueue>(*logger, *logger));
+    gs.initEmpty();
+    NameHash foo;
+    foo._hashValue = 10;
+    NameHash bar;
+    bar._hashValue = 20;
+
+    CachedFileState state;
+    state.sourceHash = "abc";
+    state.hash.definitions.hierarchyHash = 42;
+    state.hash.definitions.methodHashes[foo] = 7;
+    state.hash.definitions.definitionShapes = {{5, foo}, {9, bar}};
+    state.hash.usages.sends = {foo, bar};
+    state.hash.usages.constants = {bar};
+    state.errors.emplace_back(RenderedError{FileRef(), 7003, false, "a.rb:1: Method `foo` does not exist"});
+
+    auto stored = Serializer::storeFileState(state);
+    auto loaded = Serializer::loadFileState(gs, FileRef(3), stored.data());
+    EXPECT_EQ(loaded.sourceHash, "abc");
+    EXPECT_EQ(loaded.hash.definitions.hierarchyHash, 42);
+    EXPECT_EQ(loaded.hash.definitions.methodHashes.size(), 1);
+    EXPECT_EQ(loaded.hash.definitions.methodHashes[foo], 7);
+    EXPECT_EQ(loaded.hash.definitions.definitionShapes, state.hash.definitions.definitionShapes);
+    EXPECT_EQ(loaded.hash.usages.sends, state.hash.usages.sends);
+    EXPECT_EQ(loaded.hash.usages.constants, state.hash.usages.constants);
+    ASSERT_EQ(loaded.errors.size(), 1);
+    EXPECT_EQ(loaded.errors[0].file, FileRef(3));
+    EXPECT_EQ(loaded.errors[0].code, 7003);
+    EXPECT_EQ(loaded.errors[0].text, state.errors[0].text);
+}
+
+TEST(SerializeTest, GlobalStateSpanningManyFrames) { // NOLINT
+    GlobalState gs(make_shared<ErrorQueue>(*logger, *logger));
+    gs.initEmpty();
+    {
+        UnfreezeNameTable nameTableAccess(gs);
+        UnfreezeSymbolTable symbolTableAccess(gs);
+        for (int i = 0; i < 40000; i++) {
+            auto name = gs.enterNameConstant(fmt::format("Class{}", i));
+            if (i % 8 == 0) {
+                gs.enterClassSymbol(Loc::none(), Symbols::root(), name);
+            }
+        }
+    }
+    auto stored = Serializer::store(gs);
+
+    GlobalState loaded(make_shared<ErrorQueue>(*logger, *logger));
+    Serializer::loadGlobalState(loaded, stored.data());
+    ASSERT_EQ(loaded.namesUsed(), gs.namesUsed());
+    ASSERT_EQ(loaded.symbolsUsed(), gs.symbolsUsed());
+    for (u4 i = 1; i < gs.namesUsed(); i++) {
+        EXPECT_EQ(NameRef(loaded, i).showRaw(loaded), NameRef(gs, i).showRaw(gs));
+    }
+    for (u4 i = 1; i < gs.symbolsUsed(); i++) {
+        EXPECT_EQ(SymbolRef(loaded, i).data(loaded)->name, SymbolRef(gs, i).data(gs)->name);
+        // Intrinsics are stored with their methods rather than installed again.
+        EXPECT_EQ(SymbolRef(loaded, i).data(loaded)->intrinsic(), SymbolRef(gs, i).data(gs)->intrinsic());
+    }
+    // The name table was restored too, so entering an existing name finds it.
+    UnfreezeNameTable loadedNameTableAccess(loaded);
+    UnfreezeNameTable nameTableAccess(gs);
+    EXPECT_EQ(loaded.enterNameConstant("Class39992").id(), gs.enterNameConstant("Class39992").id());
+    EXPECT_EQ(loaded.namesUsed(), gs.namesUsed());
+}
+
+TEST(SerializeTest, UncompressedGlobalStateIsReadInPlace) { // NOLINT
+    GlobalState gs(make_shared<ErrorQueue>(*logger, *logger));
+    gs.initEmpty();
+    NameRef name;
+    {
+        UnfreezeNameTable nameTableAccess(gs);
+        name = gs.enterNameUTF8("someUncompressedName");
+    }
+    auto stored = Serializer::store(gs, false);
+
+    GlobalState loaded(make_shared<ErrorQueue>(*logger, *logger));
+    Serializer::loadGlobalState(loaded, stored.data(), true);
+    ASSERT_EQ(loaded.namesUsed(), gs.namesUsed());
+    auto loadedName = NameRef(loaded, name.id()).data(loaded)->raw.utf8;
+    EXPECT_EQ(loadedName, "someUncompressedName");
+    // The name's string was not copied out of `stored`.
+    EXPECT_GE((const u1 *)loadedName.data(), stored.data());
+    EXPECT_LT((const u1 *)loadedName.data(), stored.data() + stored.size());
+}
+
 } // namespace sorbet::core::serialize
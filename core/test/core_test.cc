@@ -7,6 +7,7 @@
 #include "core/errors/internal.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
+#include <thread>
 
 namespace spd = spdlog;
 using namespace std;
@@ -49,6 +50,35 @@ TEST(ASTTest, TestOffset2Pos) { // NOLINT
     }
 }
 
+TEST(ASTTest, TestOffset2PosAcrossIndexBlocks) { // NOLINT
+    GlobalState gs(errorQueue);
+    gs.initEmpty();
+    UnfreezeFileTable fileTableAccess(gs);
+
+    // Lines of varying length, including empty ones and ones longer than a line index block.
+    string src;
+    for (int i = 0; i < 200; i++) {
+        src += string((i * 37) % 700, 'x');
+        src += i % 3 == 0 ? "\n\n" : "\n";
+    }
+    src += "no trailing newline";
+    FileRef f = gs.enterFile(string("blocks.rb"), src);
+
+    u4 line = 1;
+    u4 col = 1;
+    for (u4 off = 0; off <= src.size(); off++) {
+        auto detail = Loc::offset2Pos(f.data(gs), off);
+        ASSERT_EQ(line, detail.line) << "offset " << off;
+        ASSERT_EQ(col, detail.column) << "offset " << off;
+        if (off < src.size() && src[off] == '\n') {
+            line++;
+            col = 1;
+        } else {
+            col++;
+        }
+    }
+}
+
 TEST(ASTTest, Errors) { // NOLINT
     GlobalState gs(errorQueue);
     gs.initEmpty();
@@ -132,10 +162,37 @@ TEST(CoreTest, Substitute) { // NOLINT
     ASSERT_EQ("<U other>", other2.showRaw(gs2));
 }
 
+TEST(CoreTest, CompactNames) { // NOLINT
+    GlobalState gs(errorQueue);
+    gs.initEmpty();
+    const auto namesKept = gs.namesUsed();
+
+    NameRef unused, used, usedConstant;
+    {
+        UnfreezeNameTable thaw(gs);
+        unused = gs.enterNameUTF8("unused");
+        used = gs.enterNameUTF8("used");
+        usedConstant = gs.enterNameConstant(used);
+    }
+
+    auto compacted = gs.copyWithNamesBelow(namesKept);
+    EXPECT_EQ(namesKept, compacted->namesUsed());
+    LazyGlobalSubstitution subst(gs, *compacted);
+    UnfreezeNameTable thaw(*compacted);
+
+    EXPECT_EQ(Names::initialize(), subst.substitute(Names::initialize()));
+    auto constant = subst.substitute(usedConstant);
+    EXPECT_EQ("<C <U used>>", constant.showRaw(*compacted));
+    EXPECT_EQ(namesKept + 2, compacted->namesUsed());
+    EXPECT_EQ(constant, subst.substitute(usedConstant));
+    EXPECT_EQ(compacted->enterNameUTF8("used"), subst.substitute(used));
+    EXPECT_EQ(namesKept + 2, compacted->namesUsed());
+}
+
 TEST(CoreTest, LocTest) { // NOLINT
-    constexpr auto maxFileId = 0xffff - 1;
+    constexpr auto maxFileId = 0xffffffffu - 1;
     constexpr auto maxOffset = 0xffffff - 1;
-    for (auto fileRef = 0; fileRef < maxFileId; fileRef = fileRef * 2 + 1) {
+    for (u4 fileRef = 0; fileRef < maxFileId; fileRef = fileRef * 2 + 1) {
         for (auto beginPos = 0; beginPos < maxOffset; beginPos = beginPos * 2 + 1) {
             for (auto endPos = beginPos; endPos < maxOffset; endPos = endPos * 2 + 1) {
                 Loc loc(core::FileRef(fileRef), beginPos, endPos);
@@ -145,13 +202,13 @@ TEST(CoreTest, LocTest) { // NOLINT
             }
         }
     }
-    for (auto fileRef = 0; fileRef < maxFileId; fileRef = fileRef * 2 + 1) {
+    for (u4 fileRef = 0; fileRef < maxFileId; fileRef = fileRef * 2 + 1) {
         for (auto beginPos = 0; beginPos < maxOffset; beginPos = beginPos * 2 + 1) {
             for (auto endPos = beginPos; endPos < maxOffset; endPos = endPos * 2 + 1) {
                 Loc loc(core::FileRef(fileRef), beginPos, endPos);
-                auto [low, high] = loc.getAs2u4();
+                auto [begin, end, file] = loc.getAs3u4();
                 Loc loc2;
-                loc2.setFrom2u4(low, high);
+                loc2.setFrom3u4(begin, end, file);
                 EXPECT_EQ(loc.file().id(), loc2.file().id());
                 EXPECT_EQ(loc.beginPos(), loc2.beginPos());
                 EXPECT_EQ(loc.endPos(), loc2.endPos());
@@ -160,4 +217,131 @@ TEST(CoreTest, LocTest) { // NOLINT
     }
 }
 
+TEST(CoreTest, TypeInterner) { // NOLINT
+    GlobalState gs(errorQueue);
+    gs.initEmpty();
+
+    EXPECT_EQ(gs.typeInterner->classType(Symbols::String()), gs.typeInterner->classType(Symbols::String()));
+    EXPECT_NE(gs.typeInterner->classType(Symbols::String()), gs.typeInterner->classType(Symbols::Integer()));
+
+    auto arrayOfString = gs.typeInterner->appliedType(Symbols::Array(), {Types::String()});
+    EXPECT_EQ(arrayOfString, gs.typeInterner->appliedType(Symbols::Array(), {Types::String()}));
+    EXPECT_NE(arrayOfString, gs.typeInterner->appliedType(Symbols::Array(), {Types::Integer()}));
+
+    // Only arguments that are plain class types get shared
+    auto nilableString = Types::any(Context(gs, Symbols::root()), Types::nilClass(), Types::String());
+    EXPECT_NE(gs.typeInterner->appliedType(Symbols::Array(), {nilableString}),
+              gs.typeInterner->appliedType(Symbols::Array(), {nilableString}));
+
+    auto copy = gs.deepCopy();
+    EXPECT_EQ(arrayOfString, copy->typeInterner->appliedType(Symbols::Array(), {Types::String()}));
+}
+
+TEST(CoreTest, TypeShowCache) { // NOLINT
+    GlobalState gs(errorQueue);
+    gs.initEmpty();
+    Context ctx(gs, Symbols::root());
+    auto tuple = TupleType::build(ctx, {Types::Integer(), Types::String()});
+
+    auto shown = tuple->show(gs);
+    auto cached = gs.typeShowCache->find(tuple.get(), gs.symbolEpoch());
+    ASSERT_TRUE(cached.has_value());
+    EXPECT_EQ(shown, *cached);
+
+    // Only renaming a symbol retires what was printed before.
+    Symbols::Integer().data(gs);
+    EXPECT_TRUE(gs.typeShowCache->find(tuple.get(), gs.symbolEpoch()).has_value());
+    {
+        UnfreezeNameTable nameTableAccess(gs);
+        gs.mangleRenameSymbol(Symbols::Integer(), Symbols::Integer().data(gs)->name);
+    }
+    EXPECT_FALSE(gs.typeShowCache->find(tuple.get(), gs.symbolEpoch()).has_value());
+    EXPECT_NE(shown, tuple->show(gs));
+}
+
+TEST(CoreTest, SubtypingCache) { // NOLINT
+    GlobalState gs(errorQueue);
+    gs.initEmpty();
+    Context ctx(gs, Symbols::root());
+    auto nilableString = Types::any(ctx, Types::nilClass(), Types::String());
+
+    SubtypingCache cache;
+    EXPECT_TRUE(Types::isSubType(ctx, Types::String(), nilableString));
+    EXPECT_FALSE(Types::isSubType(ctx, Types::Integer(), nilableString));
+    EXPECT_NE(0, cache.size());
+    EXPECT_TRUE(Types::isSubType(ctx, Types::String(), nilableString));
+    EXPECT_FALSE(Types::isSubType(ctx, Types::Integer(), nilableString));
+    {
+        SubtypingCache nested;
+        EXPECT_EQ(&nested, SubtypingCache::current());
+    }
+    EXPECT_EQ(&cache, SubtypingCache::current());
+}
+
+TEST(CoreTest, ApproximateSubtractUnion) { // NOLINT
+    GlobalState gs(errorQueue);
+    gs.initEmpty();
+    Context ctx(gs, Symbols::root());
+    auto wide = Types::any(ctx, Types::any(ctx, Types::nilClass(), Types::String()),
+                           Types::any(ctx, Types::Integer(), Types::Symbol()));
+
+    auto subtracted = Types::approximateSubtract(ctx, wide, Types::any(ctx, Types::String(), Types::Integer()));
+    EXPECT_TRUE(Types::equiv(ctx, subtracted, Types::any(ctx, Types::nilClass(), Types::Symbol())));
+    EXPECT_TRUE(Types::dropSubtypesOf(ctx, wide, {Symbols::NilClass(), Symbols::String(), Symbols::Integer(),
+                                                  Symbols::Symbol()})
+                    ->isBottom());
+    EXPECT_EQ(wide, Types::approximateSubtract(ctx, wide, Types::Float()));
+}
+
+TEST(CoreTest, DeepCopyIsCopyOnWrite) { // NOLINT
+    GlobalState gs(errorQueue);
+    gs.initEmpty();
+    auto copy = gs.deepCopy();
+    auto counter = Symbols::Object().data(gs)->uniqueCounter;
+
+    Symbols::Object().data(*copy)->uniqueCounter = counter + 1;
+    EXPECT_EQ(counter, Symbols::Object().data(gs)->uniqueCounter);
+    EXPECT_EQ(counter + 1, Symbols::Object().data(*copy)->uniqueCounter);
+    EXPECT_EQ(Symbols::Object(), Symbols::Object().data(*copy)->ref(*copy));
+
+    auto namesBefore = gs.namesUsed();
+    {
+        UnfreezeNameTable nameTableAccess(*copy);
+        auto name = copy->enterNameUTF8("onlyInTheCopy");
+        EXPECT_EQ(name, name.data(*copy)->ref(*copy));
+    }
+    EXPECT_EQ(namesBefore, gs.namesUsed());
+    EXPECT_EQ(namesBefore + 1, copy->namesUsed());
+}
+
+TEST(CoreTest, ConcurrentNameEntry) { // NOLINT
+    GlobalState gs(errorQueue);
+    gs.initEmpty();
+    const int threadCount = 4;
+    const int nameCount = 20000; // enough to grow the name table while the threads race
+    vector<vector<NameRef>> entered(threadCount);
+    {
+        UnfreezeForConcurrentIndexing concurrentIndexing(gs);
+        vector<thread> threads;
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([&gs, &entered, t]() {
+                for (int i = 0; i < nameCount; i++) {
+                    // Every thread enters each name twice, the second time through its cache of recent names.
+                    entered[t].emplace_back(gs.enterNameUTF8("concurrent" + to_string(i)));
+                    EXPECT_EQ(entered[t].back(), gs.enterNameUTF8("concurrent" + to_string(i)));
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+    for (int t = 1; t < threadCount; t++) {
+        EXPECT_EQ(entered[0], entered[t]);
+    }
+    for (int i = 0; i < nameCount; i++) {
+        EXPECT_EQ("concurrent" + to_string(i), entered[0][i].data(gs)->shortName(gs));
+    }
+}
+
 } // namespace sorbet::core
@@ -1,6 +1,7 @@
 #include "common/common.h"
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -430,6 +431,43 @@ void emit_register(ostream &out) {
     out << "}" << '\n';
 }
 
+// Emits a lookup of the well-known UTF8 names by their string that neither hashes it nor touches the name table:
+// it switches on the length and the first character, and compares against the few names left.
+void emit_lookup(ostream &out) {
+    map<size_t, map<unsigned char, vector<pair<string, int>>>> byShape;
+    for (auto &name : names) {
+        // A constant name is entered right after the UTF8 name it wraps.
+        auto utf8Id = name.isConstant ? name.id - 1 : name.id;
+        byShape[name.val.size()][(unsigned char)name.val[0]].emplace_back(name.val, utf8Id);
+    }
+    out << "NameRef lookupWellKnownUTF8(std::string_view nm) {" << '\n';
+    out << "    switch (nm.size()) {" << '\n';
+    for (auto &[size, byFirst] : byShape) {
+        out << "        case " << size << ":" << '\n';
+        if (size == 0) {
+            out << "            return NameRef(NameRef::WellKnown{}, " << byFirst.begin()->second.front().second << ");"
+                << '\n';
+            continue;
+        }
+        out << "            switch ((unsigned char)nm[0]) {" << '\n';
+        for (auto &[first, candidates] : byFirst) {
+            out << "                case " << (int)first << ":" << '\n';
+            for (auto &[val, id] : candidates) {
+                out << "                    if (nm == std::string_view(\"" << absl::CEscape(val) << "\", " << size
+                    << ")) {" << '\n';
+                out << "                        return NameRef(NameRef::WellKnown{}, " << id << ");" << '\n';
+                out << "                    }" << '\n';
+            }
+            out << "                    break;" << '\n';
+        }
+        out << "            }" << '\n';
+        out << "            break;" << '\n';
+    }
+    out << "    }" << '\n';
+    out << "    return NameRef::noName();" << '\n';
+    out << "}" << '\n';
+}
+
 int main(int argc, char **argv) {
     int i = 1;
     for (auto &name : names) {
@@ -473,6 +511,8 @@ int main(int argc, char **argv) {
         header << "#endif" << '\n';
 
         header << "    void registerNames(GlobalState &gs);" << '\n';
+        header << "    // The well-known UTF8 name spelled `nm`, or noName() if there is none." << '\n';
+        header << "    NameRef lookupWellKnownUTF8(std::string_view nm);" << '\n';
         header << "}" << '\n';
         header << "}" << '\n';
         header << "}" << '\n';
@@ -499,6 +539,8 @@ int main(int argc, char **argv) {
         classfile << '\n';
 
         emit_register(classfile);
+        classfile << '\n';
+        emit_lookup(classfile);
 
         classfile << "}" << '\n';
         classfile << "}" << '\n';
@@ -97,10 +97,10 @@ TypePtr AndType::getCallArguments(Context ctx, NameRef name) {
 DispatchResult ShapeType::dispatchCall(Context ctx, DispatchArgs args) {
     categoryCounterInc("dispatch_call", "shapetype");
     auto method = Symbols::Shape().data(ctx)->findMember(ctx, args.name);
-    if (method.exists() && method.data(ctx)->intrinsic != nullptr) {
+    if (method.exists() && method.data(ctx)->hasIntrinsic()) {
         DispatchComponent comp{args.selfType, method, {}, nullptr, nullptr, nullptr, ArgInfo{}, nullptr};
         DispatchResult res{nullptr, std::move(comp)};
-        method.data(ctx)->intrinsic->apply(ctx, args, this, res);
+        method.data(ctx)->intrinsic()->apply(ctx, args, this, res);
         if (res.returnType != nullptr) {
             return res;
         }
@@ -111,10 +111,10 @@ DispatchResult ShapeType::dispatchCall(Context ctx, DispatchArgs args) {
 DispatchResult TupleType::dispatchCall(Context ctx, DispatchArgs args) {
     categoryCounterInc("dispatch_call", "tupletype");
     auto method = Symbols::Tuple().data(ctx)->findMember(ctx, args.name);
-    if (method.exists() && method.data(ctx)->intrinsic != nullptr) {
+    if (method.exists() && method.data(ctx)->hasIntrinsic()) {
         DispatchComponent comp{args.selfType, method, {}, nullptr, nullptr, nullptr, ArgInfo{}, nullptr};
         DispatchResult res{nullptr, std::move(comp)};
-        method.data(ctx)->intrinsic->apply(ctx, args, this, res);
+        method.data(ctx)->intrinsic()->apply(ctx, args, this, res);
         if (res.returnType != nullptr) {
             return res;
         }
@@ -412,6 +412,20 @@ optional<core::AutocorrectSuggestion> maybeSuggestExtendTHelpers(core::Context c
     return core::AutocorrectSuggestion{nextLineLoc, fmt::format("{}extend T::Helpers\n", prefix)};
 }
 
+SymbolRef MethodLookupCache::findMemberTransitive(const GlobalState &gs, SymbolRef klass, NameRef name) {
+    auto *cache = current();
+    if (cache == nullptr) {
+        return klass.data(gs)->findMemberTransitive(gs, name);
+    }
+    u8 key = (static_cast<u8>(klass._id) << 32) | static_cast<u4>(name._id);
+    if (auto *cached = cache->lookup(key)) {
+        return *cached;
+    }
+    auto result = klass.data(gs)->findMemberTransitive(gs, name);
+    cache->store(key, result);
+    return result;
+}
+
 // This implements Ruby's argument matching logic (assigning values passed to a
 // method call to formal parameters of the method).
 //
@@ -433,7 +447,7 @@ DispatchResult dispatchCallSymbol(Context ctx, DispatchArgs args,
         return DispatchResult(Types::untypedUntracked(), std::move(args.selfType), Symbols::noSymbol());
     }
 
-    SymbolRef mayBeOverloaded = symbol.data(ctx)->findMemberTransitive(ctx, args.name);
+    SymbolRef mayBeOverloaded = MethodLookupCache::findMemberTransitive(ctx, symbol, args.name);
 
     if (!mayBeOverloaded.exists()) {
         if (args.name == Names::initialize()) {
@@ -455,12 +469,11 @@ DispatchResult dispatchCallSymbol(Context ctx, DispatchArgs args,
         }
         auto result = DispatchResult(Types::untypedUntracked(), std::move(args.selfType), Symbols::noSymbol());
         if (auto e = ctx.state.beginError(args.locs.call, errors::Infer::UnknownMethod)) {
-            string thisStr = thisType->show(ctx);
             if (args.fullType.get() != thisType) {
                 e.setHeader("Method `{}` does not exist on `{}` component of `{}`", args.name.data(ctx)->show(ctx),
                             thisType->show(ctx), args.fullType->show(ctx));
             } else {
-                e.setHeader("Method `{}` does not exist on `{}`", args.name.data(ctx)->show(ctx), thisStr);
+                e.setHeader("Method `{}` does not exist on `{}`", args.name.data(ctx)->show(ctx), thisType->show(ctx));
 
                 // catch the special case of `interface!` or `abstract!` or `final!` and
                 // suggest adding `extend T::Helpers`.
@@ -651,12 +664,8 @@ DispatchResult dispatchCallSymbol(Context ctx, DispatchArgs args,
                 }
                 ++kwit;
 
-                auto arg = absl::c_find_if(hash->keys, [&](const TypePtr &litType) {
-                    auto lit = cast_type<LiteralType>(litType.get());
-                    return cast_type<ClassType>(lit->underlying().get())->symbol == Symbols::Symbol() &&
-                           lit->value == spec.name._id;
-                });
-                if (arg == hash->keys.end()) {
+                auto arg = hash->indexForKey(LiteralType::LiteralTypeKind::Symbol, spec.name._id);
+                if (!arg.has_value()) {
                     if (!spec.flags.isDefault) {
                         if (auto e = missingArg(ctx, args.locs.call, args.locs.receiver, method, spec)) {
                             result.main.errors.emplace_back(std::move(e));
@@ -667,8 +676,7 @@ DispatchResult dispatchCallSymbol(Context ctx, DispatchArgs args,
                 consumed.insert(spec.name);
                 TypeAndOrigins tpe;
                 tpe.origins = args.args.back()->origins;
-                auto offset = arg - hash->keys.begin();
-                tpe.type = hash->values[offset];
+                tpe.type = hash->values[*arg];
                 if (auto e = matchArgType(ctx, *constr, args.locs.call, args.locs.receiver, symbol, method, tpe, spec,
                                           args.selfType, targs, Loc::none())) {
                     result.main.errors.emplace_back(std::move(e));
@@ -767,8 +775,8 @@ DispatchResult dispatchCallSymbol(Context ctx, DispatchArgs args,
 
     TypePtr &resultType = result.returnType;
 
-    if (method.data(ctx)->intrinsic != nullptr) {
-        method.data(ctx)->intrinsic->apply(ctx, args, thisType, result);
+    if (method.data(ctx)->hasIntrinsic()) {
+        method.data(ctx)->intrinsic()->apply(ctx, args, thisType, result);
         // the call could have overriden constraint
         if (result.main.constr || constr != &core::TypeConstraint::EmptyFrozenConstraint) {
             constr = result.main.constr.get();
@@ -835,7 +843,7 @@ DispatchResult AppliedType::dispatchCall(Context ctx, DispatchArgs args) {
 }
 
 TypePtr getMethodArguments(Context ctx, SymbolRef klass, NameRef name, const vector<TypePtr> &targs) {
-    SymbolRef method = klass.data(ctx)->findMemberTransitive(ctx, name);
+    SymbolRef method = MethodLookupCache::findMemberTransitive(ctx, klass, name);
 
     if (!method.exists()) {
         return nullptr;
@@ -1018,7 +1026,7 @@ public:
         SymbolRef self = unwrapSymbol(thisType);
         auto singleton = self.data(ctx)->lookupSingletonClass(ctx);
         if (singleton.exists()) {
-            res.returnType = make_type<ClassType>(singleton);
+            res.returnType = ctx.state.typeInterner->classType(singleton);
         } else {
             res.returnType = Types::classClass();
         }
@@ -1114,15 +1122,48 @@ public:
             }
         }
 
-        res.returnType = make_type<MetaType>(make_type<AppliedType>(attachedClass, move(targs)));
+        res.returnType = make_type<MetaType>(ctx.state.typeInterner->appliedType(attachedClass, move(targs)));
     }
 } T_Generic_squareBrackets;
 
+// Array and hash literals with more elements than this are typed as T::Array and T::Hash of what their elements have in
+// common, rather than as a tuple or shape with a type per element.
+constexpr size_t MAX_TRACKED_LITERAL_ELEMENTS = 256;
+
+// The lub of every `stride`th argument from `start`, without literal types. Elements tend to share a handful of types
+// once their literals are dropped, so each distinct type is only lubbed once.
+TypePtr lubOfWidenedArgs(Context ctx, const DispatchArgs &args, size_t start, size_t stride) {
+    UnorderedSet<const Type *> seen;
+    TypePtr acc = Types::bottom();
+    for (size_t i = start; i < args.args.size(); i += stride) {
+        auto widened = Types::dropLiteral(args.args[i]->type);
+        if (seen.insert(widened.get()).second) {
+            acc = Types::lub(ctx, acc, widened);
+        }
+    }
+    return acc;
+}
+
 class Magic_buildHash : public IntrinsicMethod {
 public:
     void apply(Context ctx, DispatchArgs args, const Type *thisType, DispatchResult &res) const override {
         ENFORCE(args.args.size() % 2 == 0);
 
+        if (args.args.size() / 2 > MAX_TRACKED_LITERAL_ELEMENTS) {
+            for (size_t i = 0; i < args.args.size(); i += 2) {
+                if (cast_type<LiteralType>(args.args[i]->type.get()) == nullptr) {
+                    res.returnType = Types::hashOfUntyped();
+                    return;
+                }
+            }
+            auto key = lubOfWidenedArgs(ctx, args, 0, 2);
+            auto value = lubOfWidenedArgs(ctx, args, 1, 2);
+            vector<TypePtr> tupleArgs{key, value};
+            vector<TypePtr> targs{key, value, TupleType::build(ctx, tupleArgs)};
+            res.returnType = ctx.state.typeInterner->appliedType(Symbols::Hash(), move(targs));
+            return;
+        }
+
         vector<TypePtr> keys;
         vector<TypePtr> values;
         keys.reserve(args.args.size() / 2);
@@ -1148,9 +1189,13 @@ public:
             res.returnType = Types::arrayOfUntyped();
             return;
         }
+        bool isType = absl::c_any_of(args.args, [ctx](auto ty) { return isa_type<MetaType>(ty->type.get()); });
+        if (!isType && args.args.size() > MAX_TRACKED_LITERAL_ELEMENTS) {
+            res.returnType = Types::arrayOf(ctx, lubOfWidenedArgs(ctx, args, 0, 1));
+            return;
+        }
         vector<TypePtr> elems;
         elems.reserve(args.args.size());
-        bool isType = absl::c_any_of(args.args, [ctx](auto ty) { return isa_type<MetaType>(ty->type.get()); });
         int i = -1;
         for (auto &elem : args.args) {
             ++i;
@@ -1718,13 +1763,20 @@ public:
         for (auto &keyType : rhs->keys) {
             auto key = cast_type<LiteralType>(keyType.get());
             auto &value = rhs->values[&keyType - &rhs->keys.front()];
-            auto fnd =
-                absl::c_find_if(keys, [&key](auto &lit) { return key->equals(*cast_type<LiteralType>(lit.get())); });
-            if (fnd == keys.end()) {
+            auto fnd = shape->indexForKey(*key);
+            if (!fnd.has_value()) {
+                // Only a key that `rhs` repeats can be among the ones appended so far.
+                for (size_t i = shape->keys.size(); i < keys.size() && !fnd.has_value(); i++) {
+                    if (key->equals(*cast_type<LiteralType>(keys[i].get()))) {
+                        fnd = i;
+                    }
+                }
+            }
+            if (!fnd.has_value()) {
                 keys.emplace_back(keyType);
                 values.emplace_back(value);
             } else {
-                values[fnd - keys.begin()] = value;
+                values[*fnd] = value;
             }
         }
 
@@ -1854,7 +1906,8 @@ class enumerable_to_h : public IntrinsicMethod {
 public:
     // Forward Enumerable.to_h to RubyType.enumerable_to_h[self]
     void apply(Context ctx, DispatchArgs args, const Type *thisType, DispatchResult &res) const override {
-        auto hash = make_type<ClassType>(core::Symbols::Sorbet_Private_Static().data(ctx)->lookupSingletonClass(ctx));
+        auto hash = ctx.state.typeInterner->classType(
+            core::Symbols::Sorbet_Private_Static().data(ctx)->lookupSingletonClass(ctx));
         InlinedVector<Loc, 2> argLocs{args.locs.receiver};
         CallLocs locs{
             args.locs.call,
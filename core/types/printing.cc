@@ -2,6 +2,7 @@
 #include "absl/strings/escaping.h"
 #include "common/common.h"
 #include "core/Context.h"
+#include "core/GlobalState.h"
 #include "core/Names.h"
 #include "core/Symbols.h"
 #include "core/TypeConstraint.h"
@@ -18,6 +19,20 @@ string buildTabs(int count) {
     return res;
 }
 
+// Returns what `render` prints for `type`, or what it printed last time if gs.typeShowCache still has that. Only worth
+// it for the composite types, whose printing recurses into everything they contain.
+template <class F> string showCached(const GlobalState &gs, const Type &type, F render) {
+    auto epoch = gs.symbolEpoch();
+    if (auto shown = gs.typeShowCache->find(&type, epoch)) {
+        return move(*shown);
+    }
+    auto shown = render();
+    if (auto handle = TypePtr::retain(&type)) {
+        gs.typeShowCache->insert(move(handle), epoch, shown);
+    }
+    return shown;
+}
+
 } // namespace
 
 string ClassType::toStringWithTabs(const GlobalState &gs, int tabs) const {
@@ -80,8 +95,10 @@ string TupleType::toStringWithTabs(const GlobalState &gs, int tabs) const {
 }
 
 string TupleType::show(const GlobalState &gs) const {
-    return fmt::format("[{}]",
-                       fmt::map_join(this->elems, ", ", [&](const auto &el) -> string { return el->show(gs); }));
+    return showCached(gs, *this, [&]() -> string {
+        return fmt::format("[{}]",
+                           fmt::map_join(this->elems, ", ", [&](const auto &el) -> string { return el->show(gs); }));
+    });
 }
 
 string TupleType::showWithMoreInfo(const GlobalState &gs) const {
@@ -104,27 +121,29 @@ string ShapeType::toStringWithTabs(const GlobalState &gs, int tabs) const {
 }
 
 string ShapeType::show(const GlobalState &gs) const {
-    fmt::memory_buffer buf;
-    fmt::format_to(buf, "{{");
-    auto valueIterator = this->values.begin();
-    bool first = true;
-    for (auto &key : this->keys) {
-        if (first) {
-            first = false;
-        } else {
-            fmt::format_to(buf, ", ");
-        }
-        SymbolRef undSymbol = cast_type<ClassType>(cast_type<LiteralType>(key.get())->underlying().get())->symbol;
-        if (undSymbol == Symbols::Symbol()) {
-            fmt::format_to(buf, "{}: {}", NameRef(gs, cast_type<LiteralType>(key.get())->value).show(gs),
-                           (*valueIterator)->show(gs));
-        } else {
-            fmt::format_to(buf, "{} => {}", key->show(gs), (*valueIterator)->show(gs));
+    return showCached(gs, *this, [&]() -> string {
+        fmt::memory_buffer buf;
+        fmt::format_to(buf, "{{");
+        auto valueIterator = this->values.begin();
+        bool first = true;
+        for (auto &key : this->keys) {
+            if (first) {
+                first = false;
+            } else {
+                fmt::format_to(buf, ", ");
+            }
+            SymbolRef undSymbol = cast_type<ClassType>(cast_type<LiteralType>(key.get())->underlying().get())->symbol;
+            if (undSymbol == Symbols::Symbol()) {
+                fmt::format_to(buf, "{}: {}", NameRef(gs, cast_type<LiteralType>(key.get())->value).show(gs),
+                               (*valueIterator)->show(gs));
+            } else {
+                fmt::format_to(buf, "{} => {}", key->show(gs), (*valueIterator)->show(gs));
+            }
+            ++valueIterator;
         }
-        ++valueIterator;
-    }
-    fmt::format_to(buf, "}}");
-    return to_string(buf);
+        fmt::format_to(buf, "}}");
+        return to_string(buf);
+    });
 }
 
 string AliasType::toStringWithTabs(const GlobalState &gs, int tabs) const {
@@ -258,28 +277,30 @@ pair<OrInfo, optional<string>> showOrs(const GlobalState &gs, TypePtr left, Type
 }
 
 string OrType::show(const GlobalState &gs) const {
-    auto [info, str] = showOrs(gs, this->left, this->right);
+    return showCached(gs, *this, [&]() -> string {
+        auto [info, str] = showOrs(gs, this->left, this->right);
 
-    // If str is empty at this point, all of the types present in the flattened
-    // OrType are NilClass.
-    if (!str.has_value()) {
-        return Symbols::NilClass().show(gs);
-    }
+        // If str is empty at this point, all of the types present in the flattened
+        // OrType are NilClass.
+        if (!str.has_value()) {
+            return Symbols::NilClass().show(gs);
+        }
 
-    string res;
-    if (info.isBoolean()) {
-        res = "T::Boolean";
-    } else if (info.containsMultiple) {
-        res = fmt::format("T.any({})", *str);
-    } else {
-        res = *str;
-    }
+        string res;
+        if (info.isBoolean()) {
+            res = "T::Boolean";
+        } else if (info.containsMultiple) {
+            res = fmt::format("T.any({})", *str);
+        } else {
+            res = *str;
+        }
 
-    if (info.containsNil) {
-        return fmt::format("T.nilable({})", res);
-    } else {
-        return res;
-    }
+        if (info.containsNil) {
+            return fmt::format("T.nilable({})", res);
+        } else {
+            return res;
+        }
+    });
 }
 
 string TypeVar::toStringWithTabs(const GlobalState &gs, int tabs) const {
@@ -316,71 +337,73 @@ string AppliedType::toStringWithTabs(const GlobalState &gs, int tabs) const {
 }
 
 string AppliedType::show(const GlobalState &gs) const {
-    fmt::memory_buffer buf;
-    if (this->klass == Symbols::Array()) {
-        fmt::format_to(buf, "T::Array");
-    } else if (this->klass == Symbols::Hash()) {
-        fmt::format_to(buf, "T::Hash");
-    } else if (this->klass == Symbols::Enumerable()) {
-        fmt::format_to(buf, "T::Enumerable");
-    } else if (this->klass == Symbols::Enumerator()) {
-        fmt::format_to(buf, "T::Enumerator");
-    } else if (this->klass == Symbols::Range()) {
-        fmt::format_to(buf, "T::Range");
-    } else if (this->klass == Symbols::Set()) {
-        fmt::format_to(buf, "T::Set");
-    } else {
-        if (std::optional<int> procArity = Types::getProcArity(*this)) {
-            fmt::format_to(buf, "T.proc");
-
-            // The first element in targs is the return type.
-            // The rest are the arguments (in the correct order)
-            ENFORCE(this->targs.size() == *procArity + 1, "Proc must have exactly arity + 1 targs");
-            auto targs_it = this->targs.begin();
-            auto return_type = *targs_it;
-            targs_it++;
-
-            if (*procArity > 0) {
-                fmt::format_to(buf, ".params(");
-            }
-
-            int arg_num = 0;
-            fmt::format_to(buf, "{}",
-                           fmt::map_join(
-                               targs_it, this->targs.end(), ", ", [&](auto targ) -> auto {
-                                   return fmt::format("arg{}: {}", arg_num++, targ->show(gs));
-                               }));
-
-            if (*procArity > 0) {
-                fmt::format_to(buf, ")");
-            }
-
-            fmt::format_to(buf, ".returns({})", return_type->show(gs));
-            return to_string(buf);
+    return showCached(gs, *this, [&]() -> string {
+        fmt::memory_buffer buf;
+        if (this->klass == Symbols::Array()) {
+            fmt::format_to(buf, "T::Array");
+        } else if (this->klass == Symbols::Hash()) {
+            fmt::format_to(buf, "T::Hash");
+        } else if (this->klass == Symbols::Enumerable()) {
+            fmt::format_to(buf, "T::Enumerable");
+        } else if (this->klass == Symbols::Enumerator()) {
+            fmt::format_to(buf, "T::Enumerator");
+        } else if (this->klass == Symbols::Range()) {
+            fmt::format_to(buf, "T::Range");
+        } else if (this->klass == Symbols::Set()) {
+            fmt::format_to(buf, "T::Set");
         } else {
-            fmt::format_to(buf, "{}", this->klass.data(gs)->show(gs));
+            if (std::optional<int> procArity = Types::getProcArity(*this)) {
+                fmt::format_to(buf, "T.proc");
+
+                // The first element in targs is the return type.
+                // The rest are the arguments (in the correct order)
+                ENFORCE(this->targs.size() == *procArity + 1, "Proc must have exactly arity + 1 targs");
+                auto targs_it = this->targs.begin();
+                auto return_type = *targs_it;
+                targs_it++;
+
+                if (*procArity > 0) {
+                    fmt::format_to(buf, ".params(");
+                }
+
+                int arg_num = 0;
+                fmt::format_to(buf, "{}",
+                               fmt::map_join(
+                                   targs_it, this->targs.end(), ", ", [&](auto targ) -> auto {
+                                       return fmt::format("arg{}: {}", arg_num++, targ->show(gs));
+                                   }));
+
+                if (*procArity > 0) {
+                    fmt::format_to(buf, ")");
+                }
+
+                fmt::format_to(buf, ".returns({})", return_type->show(gs));
+                return to_string(buf);
+            } else {
+                fmt::format_to(buf, "{}", this->klass.data(gs)->show(gs));
+            }
         }
-    }
-    auto targs = this->targs;
-    auto typeMembers = this->klass.data(gs)->typeMembers();
-    if (typeMembers.size() < targs.size()) {
-        targs.erase(targs.begin() + typeMembers.size());
-    }
-    auto it = targs.begin();
-    for (auto typeMember : typeMembers) {
-        if (typeMember.data(gs)->isFixed()) {
-            it = targs.erase(it);
-        } else if (this->klass == Symbols::Hash() && typeMember == typeMembers.back()) {
-            it = targs.erase(it);
-        } else {
-            it++;
+        auto targs = this->targs;
+        auto typeMembers = this->klass.data(gs)->typeMembers();
+        if (typeMembers.size() < targs.size()) {
+            targs.erase(targs.begin() + typeMembers.size());
+        }
+        auto it = targs.begin();
+        for (auto typeMember : typeMembers) {
+            if (typeMember.data(gs)->isFixed()) {
+                it = targs.erase(it);
+            } else if (this->klass == Symbols::Hash() && typeMember == typeMembers.back()) {
+                it = targs.erase(it);
+            } else {
+                it++;
+            }
         }
-    }
 
-    if (!targs.empty()) {
-        fmt::format_to(buf, "[{}]", fmt::map_join(targs, ", ", [&](auto targ) { return targ->show(gs); }));
-    }
-    return to_string(buf);
+        if (!targs.empty()) {
+            fmt::format_to(buf, "[{}]", fmt::map_join(targs, ", ", [&](auto targ) { return targ->show(gs); }));
+        }
+        return to_string(buf);
+    });
 }
 
 string LambdaParam::toStringWithTabs(const GlobalState &gs, int tabs) const {
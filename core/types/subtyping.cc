@@ -1,5 +1,6 @@
 #include "common/common.h"
 #include "common/typecase.h"
+#include "core/GlobalState.h"
 #include "core/Symbols.h"
 #include "core/TypeConstraint.h"
 #include "core/Types.h"
@@ -109,6 +110,94 @@ TypePtr glbDistributeAnd(Context ctx, const TypePtr &t1, const TypePtr &t2) {
     return AndType::make_shared(t1, t2);
 }
 
+// Whether `t` is literally one of the two arms of `o`, and so trivially a subtype of it. By far the most common union
+// is T.nilable(X), and merging or narrowing it against X or NilClass lands here; answering that by comparing pointers
+// and class symbols saves distributing over the union and building a new one.
+bool isArmOf(const TypePtr &t, const OrType &o) {
+    if (t.get() == o.left.get() || t.get() == o.right.get()) {
+        return true;
+    }
+    if (auto *c = cast_type<ClassType>(t.get())) {
+        auto *left = cast_type<ClassType>(o.left.get());
+        auto *right = cast_type<ClassType>(o.right.get());
+        return (left != nullptr && left->symbol == c->symbol) || (right != nullptr && right->symbol == c->symbol);
+    }
+    return false;
+}
+
+// Collects the leaves of `t` if it is a union of plain classes only, like an enum-like T.any(A, B, C, ...). Returns
+// false if any leaf is something else, in which case `arms` is left partially filled.
+bool collectClassArms(const TypePtr &t, InlinedVector<const TypePtr *, 8> &arms) {
+    if (auto *o = cast_type<OrType>(t.get())) {
+        return collectClassArms(o->left, arms) && collectClassArms(o->right, arms);
+    }
+    auto *c = cast_type<ClassType>(t.get());
+    if (c == nullptr || c->symbol == Symbols::untyped() || c->symbol == Symbols::bottom() ||
+        c->symbol == Symbols::top()) {
+        return false;
+    }
+    arms.emplace_back(&t);
+    return true;
+}
+
+// lub of two unions of plain classes, done as a single merge over their leaves instead of distributing one union
+// over the other, which re-lubs (and re-checks subtyping against) the whole of t2 once per arm of t1. Returns nullptr
+// if either side has a leaf that is not a plain class.
+TypePtr lubClassUnions(Context ctx, const TypePtr &t1, const TypePtr &t2) {
+    InlinedVector<const TypePtr *, 8> arms1;
+    InlinedVector<const TypePtr *, 8> arms2;
+    if (!collectClassArms(t1, arms1) || !collectClassArms(t2, arms2)) {
+        return nullptr;
+    }
+    auto symbolOf = [](const TypePtr *t) { return cast_type<ClassType>(t->get())->symbol; };
+
+    InlinedVector<bool, 8> dropped(arms2.size(), false);
+    int droppedCount = 0;
+    InlinedVector<const TypePtr *, 8> added;
+    for (auto *arm1 : arms1) {
+        auto sym1 = symbolOf(arm1);
+        bool covered = false;
+        for (int j = 0; j < arms2.size() && !covered; j++) {
+            auto sym2 = symbolOf(arms2[j]);
+            covered = !dropped[j] && (sym1 == sym2 || sym1.data(ctx)->derivesFrom(ctx, sym2));
+        }
+        if (covered) {
+            continue;
+        }
+        for (int j = 0; j < arms2.size(); j++) {
+            if (!dropped[j] && symbolOf(arms2[j]).data(ctx)->derivesFrom(ctx, sym1)) {
+                dropped[j] = true;
+                droppedCount++;
+            }
+        }
+        added.emplace_back(arm1);
+    }
+
+    if (added.empty()) {
+        categoryCounterInc("lubClassUnions.outcome", "t2");
+        return t2;
+    }
+    if (droppedCount == arms2.size() && added.size() == arms1.size()) {
+        categoryCounterInc("lubClassUnions.outcome", "t1");
+        return t1;
+    }
+    TypePtr result;
+    if (droppedCount == 0) {
+        result = t2;
+    } else {
+        for (int j = 0; j < arms2.size(); j++) {
+            if (!dropped[j]) {
+                result = result == nullptr ? *arms2[j] : OrType::make_shared(result, *arms2[j]);
+            }
+        }
+    }
+    for (auto *arm1 : added) {
+        result = result == nullptr ? *arm1 : OrType::make_shared(result, *arm1);
+    }
+    categoryCounterInc("lubClassUnions.outcome", "merged");
+    return result;
+}
+
 // only keep knowledge in t1 that is not already present in t2. Return the same reference if unchaged
 TypePtr dropLubComponents(Context ctx, const TypePtr &t1, const TypePtr &t2) {
     if (auto *a1 = cast_type<AndType>(t1.get())) {
@@ -177,6 +266,14 @@ TypePtr Types::lub(Context ctx, const TypePtr &t1, const TypePtr &t2) {
     }
 
     if (auto *o2 = cast_type<OrType>(t2.get())) { // 3, 5, 6
+        if (isArmOf(t1, *o2)) {
+            categoryCounterInc("lub", "arm-of-or>");
+            return t2;
+        }
+        if (auto merged = lubClassUnions(ctx, t1, t2)) {
+            categoryCounterInc("lub", "class-union>");
+            return merged;
+        }
         categoryCounterInc("lub", "or>");
         return lubDistributeOr(ctx, t2, t1);
     } else if (auto *a2 = cast_type<AndType>(t2.get())) { // 2, 4
@@ -187,7 +284,15 @@ TypePtr Types::lub(Context ctx, const TypePtr &t1, const TypePtr &t2) {
             return lub(ctx, t1, t2filtered);
         }
         return OrType::make_shared(t1, t2filtered);
-    } else if (isa_type<OrType>(t1.get())) {
+    } else if (auto *o1 = cast_type<OrType>(t1.get())) {
+        if (isArmOf(t2, *o1)) {
+            categoryCounterInc("lub", "<or-arm-of");
+            return t1;
+        }
+        if (auto merged = lubClassUnions(ctx, t1, t2)) {
+            categoryCounterInc("lub", "<class-union");
+            return merged;
+        }
         categoryCounterInc("lub", "<or");
         return lubDistributeOr(ctx, t1, t2);
     }
@@ -244,7 +349,7 @@ TypePtr Types::lub(Context ctx, const TypePtr &t1, const TypePtr &t2) {
             j++;
         }
         if (changed) {
-            return make_type<AppliedType>(a2->klass, newTargs);
+            return ctx.state.typeInterner->appliedType(a2->klass, move(newTargs));
         } else {
             return t2s;
         }
@@ -297,17 +402,10 @@ TypePtr Types::lub(Context ctx, const TypePtr &t1, const TypePtr &t2) {
                             for (auto &el2 : h2->keys) {
                                 ++i;
                                 auto el2l = cast_type<LiteralType>(el2.get());
-                                auto *u2 = cast_type<ClassType>(el2l->underlying().get());
-                                ENFORCE(u2 != nullptr);
-                                auto fnd = absl::c_find_if(h1->keys, [&](auto &candidate) -> bool {
-                                    auto el1l = cast_type<LiteralType>(candidate.get());
-                                    ClassType *u1 = cast_type<ClassType>(el1l->underlying().get());
-                                    return el1l->value == el2l->value && u1->symbol == u2->symbol; // from lambda
-                                });
-                                if (fnd != h1->keys.end()) {
-                                    auto &inserted = valueLubs.emplace_back(
-                                        lub(ctx, h1->values[fnd - h1->keys.begin()], h2->values[i]));
-                                    differ1 = differ1 || inserted != h1->values[fnd - h1->keys.begin()];
+                                auto fnd = h1->indexForKey(*el2l);
+                                if (fnd.has_value()) {
+                                    auto &inserted = valueLubs.emplace_back(lub(ctx, h1->values[*fnd], h2->values[i]));
+                                    differ1 = differ1 || inserted != h1->values[*fnd];
                                     differ2 = differ2 || inserted != h2->values[i];
                                 } else {
                                     result = Types::hashOfUntyped();
@@ -593,9 +691,22 @@ TypePtr Types::glb(Context ctx, const TypePtr &t1, const TypePtr &t2) {
         return glbDistributeAnd(ctx, t2, t1);
     }
 
+    if (auto *o2 = cast_type<OrType>(t2.get())) {
+        if (isArmOf(t1, *o2)) {
+            categoryCounterInc("glb", "arm-of-or>");
+            return t1;
+        }
+    }
+    if (auto *o1 = cast_type<OrType>(t1.get())) {
+        if (isArmOf(t2, *o1)) {
+            categoryCounterInc("glb", "<or-arm-of");
+            return t2;
+        }
+    }
+
     if (auto *p1 = cast_type<ProxyType>(t1.get())) {
         if (auto *p2 = cast_type<ProxyType>(t2.get())) {
-            if (typeid(*p1) != typeid(*p2)) {
+            if (p1->tag != p2->tag) {
                 return Types::bottom();
             }
             TypePtr result;
@@ -643,15 +754,9 @@ TypePtr Types::glb(Context ctx, const TypePtr &t1, const TypePtr &t2) {
                         for (auto &el2 : h2->keys) {
                             ++i;
                             auto el2l = cast_type<LiteralType>(el2.get());
-                            auto *u2 = cast_type<ClassType>(el2l->underlying().get());
-                            ENFORCE(u2 != nullptr);
-                            auto fnd = absl::c_find_if(h1->keys, [&](auto &candidate) -> bool {
-                                auto el1l = cast_type<LiteralType>(candidate.get());
-                                ClassType *u1 = cast_type<ClassType>(el1l->underlying().get());
-                                return el1l->value == el2l->value && u1->symbol == u2->symbol; // from lambda
-                            });
-                            if (fnd != h1->keys.end()) {
-                                auto left = h1->values[fnd - h1->keys.begin()];
+                            auto fnd = h1->indexForKey(*el2l);
+                            if (fnd.has_value()) {
+                                auto left = h1->values[*fnd];
                                 auto right = h2->values[i];
                                 auto glbe = glb(ctx, left, right);
                                 if (glbe->isBottom()) {
@@ -854,7 +959,7 @@ TypePtr Types::glb(Context ctx, const TypePtr &t1, const TypePtr &t2) {
         } else if (absl::c_equal(a2->targs, newTargs) && a1->klass == a2->klass) {
             return ltr ? t1 : t2;
         } else {
-            return make_type<AppliedType>(a1->klass, newTargs);
+            return ctx.state.typeInterner->appliedType(a1->klass, move(newTargs));
         }
     }
     {
@@ -1092,17 +1197,9 @@ bool isSubTypeUnderConstraintSingle(Context ctx, TypeConstraint &constr, const T
                     int i = -1;
                     for (auto &el2 : h2->keys) {
                         ++i;
-                        auto el2l = cast_type<LiteralType>(el2.get());
-                        auto *u2 = cast_type<ClassType>(el2l->underlying().get());
-                        ENFORCE(u2 != nullptr);
-                        auto fnd = absl::c_find_if(h1->keys, [&](auto &candidate) -> bool {
-                            auto el1l = cast_type<LiteralType>(candidate.get());
-                            ClassType *u1 = cast_type<ClassType>(el1l->underlying().get());
-                            return el1l->value == el2l->value && u1->symbol == u2->symbol; // from lambda
-                        });
-                        result = fnd != h1->keys.end() &&
-                                 Types::isSubTypeUnderConstraint(ctx, constr, h1->values[fnd - h1->keys.begin()],
-                                                                 h2->values[i]);
+                        auto fnd = h1->indexForKey(*cast_type<LiteralType>(el2.get()));
+                        result = fnd.has_value() &&
+                                 Types::isSubTypeUnderConstraint(ctx, constr, h1->values[*fnd], h2->values[i]);
                         if (!result) {
                             return;
                         }
@@ -1150,11 +1247,87 @@ bool isSubTypeUnderConstraintSingle(Context ctx, TypeConstraint &constr, const T
     }
 }
 
+namespace {
+enum SubtypingCacheTag : u4 {
+    Separator = 0xFFFFFFF0,
+    Or,
+    And,
+    Applied,
+};
+
+// Appends a structural encoding of `type` to `key`. Returns false if the type isn't ground or doesn't fit.
+bool encodeGroundType(Type *type, SubtypingCache::Key &key, int &len) {
+    if (len >= SubtypingCache::KEY_LENGTH) {
+        return false;
+    }
+    if (type->tag == TypeTag::ClassType) {
+        key[len++] = static_cast<ClassType *>(type)->symbol._id;
+        return true;
+    }
+    if (auto *o = cast_type<OrType>(type)) {
+        key[len++] = SubtypingCacheTag::Or;
+        return encodeGroundType(o->left.get(), key, len) && encodeGroundType(o->right.get(), key, len);
+    }
+    if (auto *a = cast_type<AndType>(type)) {
+        key[len++] = SubtypingCacheTag::And;
+        return encodeGroundType(a->left.get(), key, len) && encodeGroundType(a->right.get(), key, len);
+    }
+    if (auto *app = cast_type<AppliedType>(type)) {
+        if (len + 3 + app->targs.size() > SubtypingCache::KEY_LENGTH) {
+            return false;
+        }
+        key[len++] = SubtypingCacheTag::Applied;
+        key[len++] = app->klass._id;
+        key[len++] = app->targs.size();
+        for (auto &targ : app->targs) {
+            if (targ->tag != TypeTag::ClassType) {
+                return false;
+            }
+            key[len++] = cast_type<ClassType>(targ.get())->symbol._id;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool subtypingCacheKey(const TypePtr &t1, const TypePtr &t2, SubtypingCache::Key &key) {
+    int len = 0;
+    if (!encodeGroundType(t1.get(), key, len) || len >= SubtypingCache::KEY_LENGTH) {
+        return false;
+    }
+    key[len++] = SubtypingCacheTag::Separator;
+    if (!encodeGroundType(t2.get(), key, len)) {
+        return false;
+    }
+    fill(key.begin() + len, key.end(), 0);
+    return true;
+}
+
+bool isSubTypeUnderConstraintUncached(Context ctx, TypeConstraint &constr, const TypePtr &t1, const TypePtr &t2);
+} // namespace
+
 bool Types::isSubTypeUnderConstraint(Context ctx, TypeConstraint &constr, const TypePtr &t1, const TypePtr &t2) {
     if (t1.get() == t2.get()) {
         return true;
     }
 
+    auto *cache = SubtypingCache::current();
+    SubtypingCache::Key key;
+    // With an empty, solved constraint there's nothing to record, so the answer only depends on the two types.
+    if (cache == nullptr || !constr.isSolved() || !constr.isEmpty() || !subtypingCacheKey(t1, t2, key)) {
+        return isSubTypeUnderConstraintUncached(ctx, constr, t1, t2);
+    }
+    if (auto *cached = cache->lookup(key)) {
+        return *cached;
+    }
+    auto result = isSubTypeUnderConstraintUncached(ctx, constr, t1, t2);
+    cache->store(key, result);
+    return result;
+}
+
+namespace {
+bool isSubTypeUnderConstraintUncached(Context ctx, TypeConstraint &constr, const TypePtr &t1, const TypePtr &t2) {
+
     // pairs to cover: 1  (_, _)
     //                 2  (_, And)
     //                 3  (_, Or)
@@ -1191,8 +1364,8 @@ bool Types::isSubTypeUnderConstraint(Context ctx, TypeConstraint &constr, const
         auto *a2o = cast_type<OrType>(l.get());
         if (a2o != nullptr) {
             // This handles `(A | B) & C` -> `(A & C) | (B & C)`
-            return Types::isSubTypeUnderConstraint(ctx, constr, glb(ctx, a2o->left, r), t2) &&
-                   Types::isSubTypeUnderConstraint(ctx, constr, glb(ctx, a2o->right, r), t2);
+            return Types::isSubTypeUnderConstraint(ctx, constr, Types::glb(ctx, a2o->left, r), t2) &&
+                   Types::isSubTypeUnderConstraint(ctx, constr, Types::glb(ctx, a2o->right, r), t2);
         }
     }
     if (o2 != nullptr) {
@@ -1206,8 +1379,8 @@ bool Types::isSubTypeUnderConstraint(Context ctx, TypeConstraint &constr, const
         auto *o2a = cast_type<AndType>(l.get());
         if (o2a != nullptr) {
             // This handles `(A & B) | C` -> `(A | C) & (B | C)`
-            return Types::isSubTypeUnderConstraint(ctx, constr, t1, lub(ctx, o2a->left, r)) &&
-                   Types::isSubTypeUnderConstraint(ctx, constr, t1, lub(ctx, o2a->right, r));
+            return Types::isSubTypeUnderConstraint(ctx, constr, t1, Types::lub(ctx, o2a->left, r)) &&
+                   Types::isSubTypeUnderConstraint(ctx, constr, t1, Types::lub(ctx, o2a->right, r));
         }
     }
 
@@ -1223,8 +1396,13 @@ bool Types::isSubTypeUnderConstraint(Context ctx, TypeConstraint &constr, const
 
     return isSubTypeUnderConstraintSingle(ctx, constr, t1, t2); // 1
 }
+} // namespace
 
 bool Types::equiv(Context ctx, const TypePtr &t1, const TypePtr &t2) {
+    if (t1 == t2) {
+        // Common for interned types, see TypeInterner
+        return true;
+    }
     return isSubType(ctx, t1, t2) && isSubType(ctx, t2, t1);
 }
 
@@ -1288,7 +1466,7 @@ TypePtr MetaType::_instantiate(Context ctx, const InlinedVector<SymbolRef, 4> &p
     Exception::raise("should never happen");
 }
 
-MetaType::MetaType(const TypePtr &wrapped) : wrapped(move(wrapped)) {
+MetaType::MetaType(const TypePtr &wrapped) : ProxyType(TypeTag::MetaType), wrapped(move(wrapped)) {
     categoryCounterInc("types.allocated", "metattype");
 }
 
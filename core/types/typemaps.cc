@@ -1,6 +1,7 @@
 #include "absl/base/casts.h"
 #include "common/common.h"
 #include "core/Context.h"
+#include "core/GlobalState.h"
 #include "core/Hashing.h"
 #include "core/Names.h"
 #include "core/TypeConstraint.h"
@@ -346,7 +347,7 @@ TypePtr AppliedType::_instantiate(Context ctx, const InlinedVector<SymbolRef, 4>
             newTargs[i] = this->targs[i];
             i++;
         }
-        return make_type<AppliedType>(this->klass, newTargs);
+        return ctx.state.typeInterner->appliedType(this->klass, move(newTargs));
     }
 
     return nullptr;
@@ -375,7 +376,7 @@ TypePtr AppliedType::_instantiate(Context ctx, const TypeConstraint &tc) {
             newTargs[i] = this->targs[i];
             i++;
         }
-        return make_type<AppliedType>(this->klass, newTargs);
+        return ctx.state.typeInterner->appliedType(this->klass, move(newTargs));
     }
 
     return nullptr;
@@ -404,7 +405,7 @@ TypePtr AppliedType::_approximate(Context ctx, const TypeConstraint &tc) {
             newTargs[i] = this->targs[i];
             i++;
         }
-        return make_type<AppliedType>(this->klass, newTargs);
+        return ctx.state.typeInterner->appliedType(this->klass, move(newTargs));
     }
 
     return nullptr;
@@ -1,5 +1,7 @@
 #include "core/Types.h"
+#include "absl/algorithm/container.h"
 #include "absl/base/casts.h"
+#include "absl/strings/str_join.h"
 #include "common/common.h"
 #include "common/typecase.h"
 #include "core/Context.h"
@@ -33,25 +35,23 @@ TypePtr Types::dispatchCallWithoutBlock(Context ctx, const TypePtr &recv, Dispat
     return move(dispatched.returnType);
 }
 
-TypePtr::TypePtr(shared_ptr<Type> &&store) : store(move(store)){};
-
 TypePtr Types::top() {
-    static auto res = make_type<ClassType>(Symbols::top());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::top()));
     return res;
 }
 
 TypePtr Types::bottom() {
-    static auto res = make_type<ClassType>(Symbols::bottom());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::bottom()));
     return res;
 }
 
 TypePtr Types::nilClass() {
-    static auto res = make_type<ClassType>(Symbols::NilClass());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::NilClass()));
     return res;
 }
 
 TypePtr Types::untypedUntracked() {
-    static auto res = make_type<ClassType>(Symbols::untyped());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::untyped()));
     return res;
 }
 
@@ -64,17 +64,17 @@ TypePtr Types::untyped(const sorbet::core::GlobalState &gs, sorbet::core::Symbol
 }
 
 TypePtr Types::void_() {
-    static auto res = make_type<ClassType>(Symbols::void_());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::void_()));
     return res;
 }
 
 TypePtr Types::trueClass() {
-    static auto res = make_type<ClassType>(Symbols::TrueClass());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::TrueClass()));
     return res;
 }
 
 TypePtr Types::falseClass() {
-    static auto res = make_type<ClassType>(Symbols::FalseClass());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::FalseClass()));
     return res;
 }
 
@@ -84,54 +84,54 @@ TypePtr Types::Boolean() {
 }
 
 TypePtr Types::Integer() {
-    static auto res = make_type<ClassType>(Symbols::Integer());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::Integer()));
     return res;
 }
 
 TypePtr Types::Float() {
-    static auto res = make_type<ClassType>(Symbols::Float());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::Float()));
     return res;
 }
 
 TypePtr Types::arrayOfUntyped() {
     static vector<TypePtr> targs{Types::untypedUntracked()};
-    static auto res = make_type<AppliedType>(Symbols::Array(), targs);
+    static auto res = TypePtr::immortal(new AppliedType(Symbols::Array(), targs));
     return res;
 }
 
 TypePtr Types::hashOfUntyped() {
     static vector<TypePtr> targs{Types::untypedUntracked(), Types::untypedUntracked(), Types::untypedUntracked()};
-    static auto res = make_type<AppliedType>(Symbols::Hash(), targs);
+    static auto res = TypePtr::immortal(new AppliedType(Symbols::Hash(), targs));
     return res;
 }
 
 TypePtr Types::procClass() {
-    static auto res = make_type<ClassType>(Symbols::Proc());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::Proc()));
     return res;
 }
 
 TypePtr Types::classClass() {
-    static auto res = make_type<ClassType>(Symbols::Class());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::Class()));
     return res;
 }
 
 TypePtr Types::declBuilderForProcsSingletonClass() {
-    static auto res = make_type<ClassType>(Symbols::DeclBuilderForProcsSingleton());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::DeclBuilderForProcsSingleton()));
     return res;
 }
 
 TypePtr Types::String() {
-    static auto res = make_type<ClassType>(Symbols::String());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::String()));
     return res;
 }
 
 TypePtr Types::Symbol() {
-    static auto res = make_type<ClassType>(Symbols::Symbol());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::Symbol()));
     return res;
 }
 
 TypePtr Types::Object() {
-    static auto res = make_type<ClassType>(Symbols::Object());
+    static auto res = TypePtr::immortal(new ClassType(Symbols::Object()));
     return res;
 }
 
@@ -141,6 +141,10 @@ TypePtr Types::falsyTypes() {
 }
 
 TypePtr Types::dropSubtypesOf(Context ctx, const TypePtr &from, SymbolRef klass) {
+    return dropSubtypesOf(ctx, from, absl::Span<const SymbolRef>(&klass, 1));
+}
+
+TypePtr Types::dropSubtypesOf(Context ctx, const TypePtr &from, absl::Span<const SymbolRef> klasses) {
     TypePtr result;
 
     if (from->isUntyped()) {
@@ -150,8 +154,8 @@ TypePtr Types::dropSubtypesOf(Context ctx, const TypePtr &from, SymbolRef klass)
     typecase(
         from.get(),
         [&](OrType *o) {
-            auto lhs = dropSubtypesOf(ctx, o->left, klass);
-            auto rhs = dropSubtypesOf(ctx, o->right, klass);
+            auto lhs = dropSubtypesOf(ctx, o->left, klasses);
+            auto rhs = dropSubtypesOf(ctx, o->right, klasses);
             if (lhs == o->left && rhs == o->right) {
                 result = from;
             } else if (lhs->isBottom()) {
@@ -163,8 +167,8 @@ TypePtr Types::dropSubtypesOf(Context ctx, const TypePtr &from, SymbolRef klass)
             }
         },
         [&](AndType *a) {
-            auto lhs = dropSubtypesOf(ctx, a->left, klass);
-            auto rhs = dropSubtypesOf(ctx, a->right, klass);
+            auto lhs = dropSubtypesOf(ctx, a->left, klasses);
+            auto rhs = dropSubtypesOf(ctx, a->right, klasses);
             if (lhs != a->left || rhs != a->right) {
                 result = Types::all(ctx, lhs, rhs);
             } else {
@@ -174,21 +178,25 @@ TypePtr Types::dropSubtypesOf(Context ctx, const TypePtr &from, SymbolRef klass)
         [&](ClassType *c) {
             if (c->isUntyped()) {
                 result = from;
-            } else if (c->symbol == klass || c->derivesFrom(ctx, klass)) {
+            } else if (absl::c_any_of(klasses, [&](SymbolRef klass) -> bool {
+                           return c->symbol == klass || c->derivesFrom(ctx, klass);
+                       })) {
                 result = Types::bottom();
             } else {
                 result = from;
             }
         },
         [&](AppliedType *c) {
-            if (c->klass == klass || c->derivesFrom(ctx, klass)) {
+            if (absl::c_any_of(klasses, [&](SymbolRef klass) -> bool {
+                    return c->klass == klass || c->derivesFrom(ctx, klass);
+                })) {
                 result = Types::bottom();
             } else {
                 result = from;
             }
         },
         [&](ProxyType *c) {
-            if (dropSubtypesOf(ctx, c->underlying(), klass)->isBottom()) {
+            if (dropSubtypesOf(ctx, c->underlying(), klasses)->isBottom()) {
                 result = Types::bottom();
             } else {
                 result = from;
@@ -196,8 +204,10 @@ TypePtr Types::dropSubtypesOf(Context ctx, const TypePtr &from, SymbolRef klass)
         },
         [&](Type *) { result = from; });
     ENFORCE(Types::isSubType(ctx, result, from),
-            "dropSubtypesOf({}, {}) returned {}, which is not a subtype of the input", from->toString(ctx),
-            klass.data(ctx)->showFullName(ctx), result->toString(ctx));
+            "dropSubtypesOf({}, [{}]) returned {}, which is not a subtype of the input", from->toString(ctx),
+            absl::StrJoin(klasses, ", ",
+                          [&](string *out, SymbolRef klass) { out->append(klass.data(ctx)->showFullName(ctx)); }),
+            result->toString(ctx));
     return result;
 }
 
@@ -205,8 +215,7 @@ bool Types::canBeTruthy(Context ctx, const TypePtr &what) {
     if (what->isUntyped()) {
         return true;
     }
-    auto truthyPart =
-        Types::dropSubtypesOf(ctx, Types::dropSubtypesOf(ctx, what, Symbols::NilClass()), Symbols::FalseClass());
+    auto truthyPart = Types::dropSubtypesOf(ctx, what, {Symbols::NilClass(), Symbols::FalseClass()});
     return !truthyPart->isBottom(); // check if truthyPart is empty
 }
 
@@ -220,15 +229,26 @@ bool Types::canBeFalsy(Context ctx, const TypePtr &what) {
 }
 
 TypePtr Types::approximateSubtract(Context ctx, const TypePtr &from, const TypePtr &what) {
-    TypePtr result;
-    typecase(
-        what.get(), [&](ClassType *c) { result = Types::dropSubtypesOf(ctx, from, c->symbol); },
-        [&](AppliedType *c) { result = Types::dropSubtypesOf(ctx, from, c->klass); },
-        [&](OrType *o) {
-            result = Types::approximateSubtract(ctx, Types::approximateSubtract(ctx, from, o->left), o->right);
-        },
-        [&](Type *) { result = from; });
-    return result;
+    // `what` is often the union of every class in a `when` clause, so its classes are dropped in a single walk over
+    // `from` rather than in one walk per class.
+    InlinedVector<SymbolRef, 4> klasses;
+    vector<Type *> todo{what.get()};
+    while (!todo.empty()) {
+        auto *tp = todo.back();
+        todo.pop_back();
+        typecase(
+            tp, [&](ClassType *c) { klasses.emplace_back(c->symbol); },
+            [&](AppliedType *c) { klasses.emplace_back(c->klass); },
+            [&](OrType *o) {
+                todo.emplace_back(o->right.get());
+                todo.emplace_back(o->left.get());
+            },
+            [&](Type *) {});
+    }
+    if (klasses.empty()) {
+        return from;
+    }
+    return Types::dropSubtypesOf(ctx, from, absl::MakeConstSpan(klasses));
 }
 
 TypePtr Types::dropLiteral(const TypePtr &tp) {
@@ -248,13 +268,13 @@ TypePtr Types::lubAll(Context ctx, vector<TypePtr> &elements) {
 
 TypePtr Types::arrayOf(Context ctx, const TypePtr &elem) {
     vector<TypePtr> targs{move(elem)};
-    return make_type<AppliedType>(Symbols::Array(), targs);
+    return ctx.state.typeInterner->appliedType(Symbols::Array(), move(targs));
 }
 
 TypePtr Types::hashOf(Context ctx, const TypePtr &elem) {
     vector<TypePtr> tupleArgs{Types::Symbol(), elem};
     vector<TypePtr> targs{Types::Symbol(), elem, TupleType::build(ctx, tupleArgs)};
-    return make_type<AppliedType>(Symbols::Hash(), targs);
+    return ctx.state.typeInterner->appliedType(Symbols::Hash(), move(targs));
 }
 
 std::optional<int> Types::getProcArity(const AppliedType &type) {
@@ -266,7 +286,9 @@ std::optional<int> Types::getProcArity(const AppliedType &type) {
     return std::nullopt;
 }
 
-ClassType::ClassType(SymbolRef symbol) : symbol(symbol) {
+ClassType::ClassType(SymbolRef symbol) : ClassType(TypeTag::ClassType, symbol) {}
+
+ClassType::ClassType(TypeTag tag, SymbolRef symbol) : GroundType(tag), symbol(symbol) {
     categoryCounterInc("types.allocated", "classtype");
     ENFORCE(symbol.exists());
 }
@@ -296,22 +318,26 @@ bool Type::isBottom() const {
     return t != nullptr && t->symbol == Symbols::bottom();
 }
 
-LiteralType::LiteralType(int64_t val) : value(val), literalKind(LiteralTypeKind::Integer) {
+LiteralType::LiteralType(int64_t val)
+    : ProxyType(TypeTag::LiteralType), value(val), literalKind(LiteralTypeKind::Integer) {
     categoryCounterInc("types.allocated", "literaltype");
 }
 
-LiteralType::LiteralType(double val) : floatval(val), literalKind(LiteralTypeKind::Float) {
+LiteralType::LiteralType(double val)
+    : ProxyType(TypeTag::LiteralType), floatval(val), literalKind(LiteralTypeKind::Float) {
     categoryCounterInc("types.allocated", "literaltype");
 }
 
 LiteralType::LiteralType(SymbolRef klass, NameRef val)
-    : value(val._id), literalKind(klass == Symbols::String() ? LiteralTypeKind::String : LiteralTypeKind::Symbol) {
+    : ProxyType(TypeTag::LiteralType), value(val._id),
+      literalKind(klass == Symbols::String() ? LiteralTypeKind::String : LiteralTypeKind::Symbol) {
     categoryCounterInc("types.allocated", "literaltype");
     ENFORCE(klass == Symbols::String() || klass == Symbols::Symbol());
 }
 
 LiteralType::LiteralType(bool val)
-    : value(val ? 1 : 0), literalKind(val ? LiteralTypeKind::True : LiteralTypeKind::False) {
+    : ProxyType(TypeTag::LiteralType), value(val ? 1 : 0),
+      literalKind(val ? LiteralTypeKind::True : LiteralTypeKind::False) {
     categoryCounterInc("types.allocated", "literaltype");
 }
 
@@ -334,7 +360,7 @@ TypePtr LiteralType::underlying() const {
 }
 
 TupleType::TupleType(TypePtr underlying, vector<TypePtr> elements)
-    : elems(move(elements)), underlying_(std::move(underlying)) {
+    : ProxyType(TypeTag::TupleType), elems(move(elements)), underlying_(std::move(underlying)) {
     categoryCounterInc("types.allocated", "tupletype");
 }
 
@@ -343,7 +369,8 @@ TypePtr TupleType::build(Context ctx, vector<TypePtr> elements) {
     return make_type<TupleType>(move(underlying), move(elements));
 }
 
-AndType::AndType(const TypePtr &left, const TypePtr &right) : left(move(left)), right(move(right)) {
+AndType::AndType(const TypePtr &left, const TypePtr &right)
+    : GroundType(TypeTag::AndType), left(move(left)), right(move(right)) {
     categoryCounterInc("types.allocated", "andtype");
 }
 
@@ -359,7 +386,8 @@ bool LiteralType::equals(const LiteralType &rhs) const {
     return lklass->symbol == rklass->symbol;
 }
 
-OrType::OrType(const TypePtr &left, const TypePtr &right) : left(move(left)), right(move(right)) {
+OrType::OrType(const TypePtr &left, const TypePtr &right)
+    : GroundType(TypeTag::OrType), left(move(left)), right(move(right)) {
     categoryCounterInc("types.allocated", "ortype");
 }
 
@@ -370,14 +398,58 @@ void TupleType::_sanityCheck(Context ctx) {
     ENFORCE(applied->klass == Symbols::Array());
 }
 
-ShapeType::ShapeType() : underlying_(Types::hashOfUntyped()) {
+ShapeType::ShapeType() : ProxyType(TypeTag::ShapeType), underlying_(Types::hashOfUntyped()) {
     categoryCounterInc("types.allocated", "shapetype");
 }
 
+namespace {
+// Below this many keys, scanning the keys is cheaper than building and searching an index.
+constexpr size_t SHAPE_INDEX_MIN_KEYS = 16;
+
+pair<LiteralType::LiteralTypeKind, int64_t> literalKey(const TypePtr &key) {
+    auto *lit = cast_type<LiteralType>(key.get());
+    return {lit->literalKind, lit->value};
+}
+} // namespace
+
 ShapeType::ShapeType(TypePtr underlying, vector<TypePtr> keys, vector<TypePtr> values)
-    : keys(move(keys)), values(move(values)), underlying_(std::move(underlying)) {
+    : ProxyType(TypeTag::ShapeType), keys(move(keys)), values(move(values)), underlying_(std::move(underlying)) {
     DEBUG_ONLY(for (auto &k : this->keys) { ENFORCE(cast_type<LiteralType>(k.get()) != nullptr); };);
     categoryCounterInc("types.allocated", "shapetype");
+    if (this->keys.size() >= SHAPE_INDEX_MIN_KEYS) {
+        sortedKeys.reserve(this->keys.size());
+        for (u4 i = 0; i < this->keys.size(); i++) {
+            sortedKeys.emplace_back(i);
+        }
+        // Ties are broken by position, so that a repeated key finds its first occurrence, as a scan would.
+        fast_sort(sortedKeys, [&](u4 left, u4 right) -> bool {
+            return make_pair(literalKey(this->keys[left]), left) < make_pair(literalKey(this->keys[right]), right);
+        });
+    }
+}
+
+optional<size_t> ShapeType::indexForKey(const LiteralType &key) const {
+    return indexForKey(key.literalKind, key.value);
+}
+
+optional<size_t> ShapeType::indexForKey(LiteralType::LiteralTypeKind kind, int64_t value) const {
+    const auto wanted = make_pair(kind, value);
+    if (sortedKeys.empty()) {
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (literalKey(keys[i]) == wanted) {
+                return i;
+            }
+        }
+        return nullopt;
+    }
+    ENFORCE(sortedKeys.size() == keys.size());
+    auto fnd = absl::c_lower_bound(sortedKeys, wanted, [&](u4 candidate, const auto &wanted) {
+        return literalKey(keys[candidate]) < wanted;
+    });
+    if (fnd == sortedKeys.end() || literalKey(keys[*fnd]) != wanted) {
+        return nullopt;
+    }
+    return *fnd;
 }
 
 TypePtr ShapeType::underlying() const {
@@ -399,7 +471,7 @@ void ShapeType::_sanityCheck(Context ctx) {
     }
 }
 
-AliasType::AliasType(SymbolRef other) : symbol(other) {
+AliasType::AliasType(SymbolRef other) : Type(TypeTag::AliasType), symbol(other) {
     categoryCounterInc("types.allocated", "aliastype");
 }
 
@@ -564,6 +636,12 @@ InlinedVector<SymbolRef, 4> Types::alignBaseTypeArgs(Context ctx, SymbolRef what
     return currentAlignment;
 }
 
+namespace {
+u8 mixAsSeenFromKey(u8 acc, u8 value) {
+    return (acc ^ value) * 0x9E3779B97F4A7C15ULL;
+}
+} // namespace
+
 /**
  * fromWhat - where the generic type was written
  * inWhat   - where the generic type is observed
@@ -585,9 +663,27 @@ TypePtr Types::resultTypeAsSeenFrom(Context ctx, TypePtr what, SymbolRef fromWha
                 fromWhat.data(ctx)->derivesFrom(ctx, inWhat),
             "\n{}\nis unrelated to\n\n{}", fromWhat.data(ctx)->toString(ctx), inWhat.data(ctx)->toString(ctx));
 
-    auto currentAlignment = alignBaseTypeArgs(ctx, originalOwner, targs, inWhat);
+    auto *cache = AsSeenFromCache::current();
+    if (cache == nullptr) {
+        auto currentAlignment = alignBaseTypeArgs(ctx, originalOwner, targs, inWhat);
+        return instantiate(ctx, what, currentAlignment, targs);
+    }
+
+    u8 key = mixAsSeenFromKey(reinterpret_cast<uintptr_t>(what.get()),
+                              (static_cast<u8>(fromWhat._id) << 32) | static_cast<u4>(inWhat._id));
+    for (auto &targ : targs) {
+        key = mixAsSeenFromKey(key, reinterpret_cast<uintptr_t>(targ.get()));
+    }
+    auto *entry = cache->lookup(key);
+    if (entry != nullptr && entry->what == what && entry->fromWhat == fromWhat && entry->inWhat == inWhat &&
+        absl::c_equal(entry->targs, targs, [](auto &l, auto &r) { return l.get() == r.get(); })) {
+        return entry->result;
+    }
 
-    return instantiate(ctx, what, currentAlignment, targs);
+    auto currentAlignment = alignBaseTypeArgs(ctx, originalOwner, targs, inWhat);
+    auto result = instantiate(ctx, what, currentAlignment, targs);
+    cache->store(key, AsSeenFromEntry{what, fromWhat, inWhat, targs, result});
+    return result;
 }
 
 TypePtr Types::getProcReturnType(Context ctx, const TypePtr &procType) {
@@ -618,7 +714,7 @@ bool TypeVar::derivesFrom(const GlobalState &gs, SymbolRef klass) const {
     Exception::raise("should never happen. You're missing a call to either Types::approximate or Types::instantiate");
 }
 
-TypeVar::TypeVar(SymbolRef sym) : sym(sym) {
+TypeVar::TypeVar(SymbolRef sym) : Type(TypeTag::TypeVar), sym(sym) {
     categoryCounterInc("types.allocated", "typevar");
 }
 
@@ -654,11 +750,11 @@ bool AppliedType::derivesFrom(const GlobalState &gs, SymbolRef klass) const {
     return und.derivesFrom(gs, klass);
 }
 
-LambdaParam::LambdaParam(const SymbolRef definition) : definition(definition) {
+LambdaParam::LambdaParam(const SymbolRef definition) : Type(TypeTag::LambdaParam), definition(definition) {
     categoryCounterInc("types.allocated", "lambdatypeparam");
 }
 
-SelfTypeParam::SelfTypeParam(const SymbolRef definition) : definition(definition) {
+SelfTypeParam::SelfTypeParam(const SymbolRef definition) : Type(TypeTag::SelfTypeParam), definition(definition) {
     categoryCounterInc("types.allocated", "selftypeparam");
 }
 
@@ -780,10 +876,11 @@ TypePtr TupleType::elementType() const {
     return ap->targs.front();
 }
 
-SelfType::SelfType() {
+SelfType::SelfType() : Type(TypeTag::SelfType) {
     categoryCounterInc("types.allocated", "selftype");
 };
-AppliedType::AppliedType(SymbolRef klass, vector<TypePtr> targs) : klass(klass), targs(std::move(targs)) {
+AppliedType::AppliedType(SymbolRef klass, vector<TypePtr> targs)
+    : Type(TypeTag::AppliedType), klass(klass), targs(std::move(targs)) {
     categoryCounterInc("types.allocated", "appliedtype");
 }
 
@@ -822,7 +919,7 @@ TypePtr Types::widen(Context ctx, const TypePtr &type) {
             for (const auto &t : appliedType->targs) {
                 newTargs.emplace_back(widen(ctx, t));
             }
-            ret = make_type<AppliedType>(appliedType->klass, newTargs);
+            ret = ctx.state.typeInterner->appliedType(appliedType->klass, move(newTargs));
         },
         [&](Type *tp) { ret = type; });
     ENFORCE(ret);
@@ -1,5 +1,7 @@
+#include "definition_validator/validator.h"
 #include "ast/ast.h"
 #include "ast/treemap/treemap.h"
+#include "core/Hashing.h"
 #include "core/core.h"
 #include "core/errors/resolver.h"
 
@@ -43,14 +45,16 @@ Signature decomposeSignature(const core::GlobalState &gs, core::SymbolRef method
 // Eventually this should check the appropriate subtype relationships on types,
 // as well, but for now we just look at the argument shapes and ensure that they
 // are compatible.
-void validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef superMethod, core::SymbolRef method) {
+// Returns whether the override was fine: false if anything was wrong with it, even if the error was not reported.
+bool validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef superMethod, core::SymbolRef method) {
     if (method.data(gs)->isOverloaded()) {
         // Don't try to check overloaded methods; It's not immediately clear how
         // to match overloads against their superclass definitions. Since we
         // Only permit overloading in the stdlib for now, this is no great loss.
-        return;
+        return true;
     }
 
+    bool compatible = true;
     auto left = decomposeSignature(gs, superMethod);
     auto right = decomposeSignature(gs, method);
 
@@ -58,6 +62,7 @@ void validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef sup
         auto leftPos = left.pos.required.size() + left.pos.optional.size();
         auto rightPos = right.pos.required.size() + right.pos.optional.size();
         if (leftPos > rightPos) {
+            compatible = false;
             if (auto e = gs.beginError(method.data(gs)->loc(), core::errors::Resolver::BadMethodOverride)) {
                 e.setHeader("Implementation of abstract method `{}` must accept at least `{}` positional arguments",
                             superMethod.data(gs)->show(gs), leftPos);
@@ -68,6 +73,7 @@ void validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef sup
 
     if (auto leftRest = left.pos.rest) {
         if (!right.pos.rest) {
+            compatible = false;
             if (auto e = gs.beginError(method.data(gs)->loc(), core::errors::Resolver::BadMethodOverride)) {
                 e.setHeader("Implementation of abstract method `{}` must accept *`{}`", superMethod.data(gs)->show(gs),
                             (*leftRest)->show(gs));
@@ -77,6 +83,7 @@ void validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef sup
     }
 
     if (right.pos.required.size() > left.pos.required.size()) {
+        compatible = false;
         if (auto e = gs.beginError(method.data(gs)->loc(), core::errors::Resolver::BadMethodOverride)) {
             e.setHeader("Implementation of abstract method `{}` must accept no more than `{}` required argument(s)",
                         superMethod.data(gs)->show(gs), left.pos.required.size());
@@ -92,6 +99,7 @@ void validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef sup
             if (absl::c_any_of(right.kw.optional, [&](const auto &r) { return r == req; })) {
                 continue;
             }
+            compatible = false;
             if (auto e = gs.beginError(method.data(gs)->loc(), core::errors::Resolver::BadMethodOverride)) {
                 e.setHeader("Implementation of abstract method `{}` is missing required keyword argument `{}`",
                             superMethod.data(gs)->show(gs), req.show(gs));
@@ -102,6 +110,7 @@ void validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef sup
 
     if (auto leftRest = left.kw.rest) {
         if (!right.kw.rest) {
+            compatible = false;
             if (auto e = gs.beginError(method.data(gs)->loc(), core::errors::Resolver::BadMethodOverride)) {
                 e.setHeader("Implementation of abstract method `{}` must accept **`{}`", superMethod.data(gs)->show(gs),
                             (*leftRest)->show(gs));
@@ -114,6 +123,7 @@ void validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef sup
         if (absl::c_any_of(left.kw.required, [&](const auto &l) { return l == extra; })) {
             continue;
         }
+        compatible = false;
         if (auto e = gs.beginError(method.data(gs)->loc(), core::errors::Resolver::BadMethodOverride)) {
             e.setHeader("Implementation of abstract method `{}` contains extra required keyword argument `{}`",
                         superMethod.data(gs)->show(gs), extra.toString(gs));
@@ -122,12 +132,37 @@ void validateCompatibleOverride(const core::GlobalState &gs, core::SymbolRef sup
     }
 
     if (!left.syntheticBlk && right.syntheticBlk) {
+        compatible = false;
         if (auto e = gs.beginError(method.data(gs)->loc(), core::errors::Resolver::BadMethodOverride)) {
             e.setHeader("Implementation of abstract method `{}` must explicitly name a block argument",
                         superMethod.data(gs)->show(gs));
             e.addErrorLine(superMethod.data(gs)->loc(), "Base method defined here");
         }
     }
+
+    return compatible;
+}
+
+// Everything about `sym` that checking an override involving it looks at, and that can change without the class
+// hierarchy changing.
+u4 overrideFingerprint(const core::GlobalState &gs, core::SymbolRef sym) {
+    auto data = sym.data(gs);
+    u4 res = core::mix(data->flags, data->name.id());
+    for (auto &arg : data->arguments()) {
+        u4 argFlags = arg.flags.isKeyword | arg.flags.isRepeated << 1 | arg.flags.isDefault << 2 |
+                      arg.flags.isBlock << 3 | arg.isSyntheticBlockArgument() << 4;
+        res = core::mix(core::mix(res, arg.name.id()), argFlags);
+    }
+    return res;
+}
+
+u4 overrideFingerprint(const core::GlobalState &gs, core::SymbolRef method,
+                       const InlinedVector<core::SymbolRef, 2> &overridden) {
+    auto res = overrideFingerprint(gs, method);
+    for (auto superMethod : overridden) {
+        res = core::mix(res, overrideFingerprint(gs, superMethod));
+    }
+    return res;
 }
 
 void validateOverriding(const core::GlobalState &gs, core::SymbolRef method) {
@@ -135,7 +170,7 @@ void validateOverriding(const core::GlobalState &gs, core::SymbolRef method) {
     auto name = method.data(gs)->name;
     ENFORCE(klass.data(gs)->isClass());
     auto klassData = klass.data(gs);
-    InlinedVector<core::SymbolRef, 4> overridenMethods;
+    InlinedVector<core::SymbolRef, 2> overridenMethods;
 
     // both of these match the behavior of the runtime checks, which will only allow public methods to be defined in
     // interfaces
@@ -160,6 +195,16 @@ void validateOverriding(const core::GlobalState &gs, core::SymbolRef method) {
         }
     }
 
+    // A method that was fine last time is fine again as long as neither it nor what it overrides changed.
+    const auto &hierarchy = gs.ancestorIndex;
+    if (hierarchy != nullptr) {
+        auto cached = gs.overrideCheckCache->find(hierarchy, method);
+        if (cached.has_value() && cached->fingerprint == overrideFingerprint(gs, method, cached->overridden)) {
+            prodCounterInc("definition_validator.override_cache.hit");
+            return;
+        }
+    }
+
     if (klassData->superClass().exists()) {
         auto superMethod = klassData->superClass().data(gs)->findMemberTransitive(gs, name);
         if (superMethod.exists()) {
@@ -173,8 +218,10 @@ void validateOverriding(const core::GlobalState &gs, core::SymbolRef method) {
         }
     }
 
+    bool clean = true;
     for (const auto &overridenMethod : overridenMethods) {
         if (overridenMethod.data(gs)->isFinalMethod()) {
+            clean = false;
             if (auto e = gs.beginError(method.data(gs)->loc(), core::errors::Resolver::OverridesFinal)) {
                 e.setHeader("`{}` was declared as final and cannot be overridden by `{}`",
                             overridenMethod.data(gs)->show(gs), method.data(gs)->show(gs));
@@ -184,9 +231,15 @@ void validateOverriding(const core::GlobalState &gs, core::SymbolRef method) {
         auto isRBI = absl::c_any_of(method.data(gs)->locs(), [&](auto &loc) { return loc.file().data(gs).isRBI(); });
         if ((overridenMethod.data(gs)->isAbstract() || overridenMethod.data(gs)->isOverridable()) &&
             !method.data(gs)->isIncompatibleOverride() && !isRBI) {
-            validateCompatibleOverride(gs, overridenMethod, method);
+            clean = validateCompatibleOverride(gs, overridenMethod, method) && clean;
         }
     }
+
+    if (clean && hierarchy != nullptr) {
+        auto fingerprint = overrideFingerprint(gs, method, overridenMethods);
+        gs.overrideCheckCache->insert(hierarchy, method,
+                                      core::OverrideCheckCache::Entry{fingerprint, overridenMethods});
+    }
 }
 
 core::Loc getAncestorLoc(const core::GlobalState &gs, const unique_ptr<ast::ClassDef> &classDef,
@@ -262,121 +315,122 @@ void validateFinal(const core::GlobalState &gs, const core::SymbolRef klass,
     validateFinalMethodHelper(gs, singleton, klass);
 }
 
-class ValidateWalk {
-private:
-    UnorderedMap<core::SymbolRef, vector<core::SymbolRef>> abstractCache;
-
-    const vector<core::SymbolRef> &getAbstractMethods(const core::GlobalState &gs, core::SymbolRef klass) {
-        vector<core::SymbolRef> abstract;
-        auto ent = abstractCache.find(klass);
-        if (ent != abstractCache.end()) {
-            return ent->second;
-        }
+const vector<core::SymbolRef> &ValidateWalk::getAbstractMethods(const core::GlobalState &gs, core::SymbolRef klass) {
+    vector<core::SymbolRef> abstract;
+    auto ent = abstractCache.find(klass);
+    if (ent != abstractCache.end()) {
+        return ent->second;
+    }
 
-        auto superclass = klass.data(gs)->superClass();
-        if (superclass.exists()) {
-            auto &superclassMethods = getAbstractMethods(gs, superclass);
-            // TODO(nelhage): This code could go quadratic or even exponential given
-            // pathological arrangements of interfaces and abstract methods. Switch
-            // to a better data structure if that is ever a problem.
-            abstract.insert(abstract.end(), superclassMethods.begin(), superclassMethods.end());
-        }
+    auto superclass = klass.data(gs)->superClass();
+    if (superclass.exists()) {
+        auto &superclassMethods = getAbstractMethods(gs, superclass);
+        // TODO(nelhage): This code could go quadratic or even exponential given
+        // pathological arrangements of interfaces and abstract methods. Switch
+        // to a better data structure if that is ever a problem.
+        abstract.insert(abstract.end(), superclassMethods.begin(), superclassMethods.end());
+    }
 
-        for (auto ancst : klass.data(gs)->mixins()) {
-            auto fromMixin = getAbstractMethods(gs, ancst);
-            abstract.insert(abstract.end(), fromMixin.begin(), fromMixin.end());
-        }
+    for (auto ancst : klass.data(gs)->mixins()) {
+        auto fromMixin = getAbstractMethods(gs, ancst);
+        abstract.insert(abstract.end(), fromMixin.begin(), fromMixin.end());
+    }
 
-        auto isAbstract = klass.data(gs)->isClassAbstract();
-        if (isAbstract) {
-            for (auto mem : klass.data(gs)->members()) {
-                if (mem.second.data(gs)->isMethod() && mem.second.data(gs)->isAbstract()) {
-                    abstract.emplace_back(mem.second);
-                }
+    auto isAbstract = klass.data(gs)->isClassAbstract();
+    if (isAbstract) {
+        for (auto mem : klass.data(gs)->members()) {
+            if (mem.second.data(gs)->isMethod() && mem.second.data(gs)->isAbstract()) {
+                abstract.emplace_back(mem.second);
             }
         }
+    }
+
+    auto &entry = abstractCache[klass];
+    entry = std::move(abstract);
+    return entry;
+}
 
-        auto &entry = abstractCache[klass];
-        entry = std::move(abstract);
-        return entry;
+// if/when we get final classes, we can just mark subclasses of `T::Struct` as final and essentially subsume the
+// logic here.
+void ValidateWalk::validateTStructNotGrandparent(const core::GlobalState &gs, core::SymbolRef sym) {
+    auto parent = sym.data(gs)->superClass();
+    if (!parent.exists()) {
+        return;
+    }
+    auto grandparent = parent.data(gs)->superClass();
+    if (!grandparent.exists() || grandparent != core::Symbols::T_Struct()) {
+        return;
+    }
+    if (auto e = gs.beginError(sym.data(gs)->loc(), core::errors::Resolver::SubclassingNotAllowed)) {
+        auto parentName = parent.data(gs)->show(gs);
+        e.setHeader("Subclassing `{}` is not allowed", parentName);
+        e.addErrorLine(parent.data(gs)->loc(), "`{}` is a subclass of `T::Struct`", parentName);
     }
+}
 
-    // if/when we get final classes, we can just mark subclasses of `T::Struct` as final and essentially subsume the
-    // logic here.
-    void validateTStructNotGrandparent(const core::GlobalState &gs, core::SymbolRef sym) {
-        auto parent = sym.data(gs)->superClass();
-        if (!parent.exists()) {
-            return;
-        }
-        auto grandparent = parent.data(gs)->superClass();
-        if (!grandparent.exists() || grandparent != core::Symbols::T_Struct()) {
-            return;
-        }
-        if (auto e = gs.beginError(sym.data(gs)->loc(), core::errors::Resolver::SubclassingNotAllowed)) {
-            auto parentName = parent.data(gs)->show(gs);
-            e.setHeader("Subclassing `{}` is not allowed", parentName);
-            e.addErrorLine(parent.data(gs)->loc(), "`{}` is a subclass of `T::Struct`", parentName);
-        }
+void ValidateWalk::validateAbstract(const core::GlobalState &gs, core::SymbolRef sym) {
+    if (sym.data(gs)->isClassAbstract()) {
+        return;
+    }
+    auto loc = sym.data(gs)->loc();
+    if (loc.exists() && loc.file().data(gs).isRBI()) {
+        return;
     }
 
-    void validateAbstract(const core::GlobalState &gs, core::SymbolRef sym) {
-        if (sym.data(gs)->isClassAbstract()) {
-            return;
-        }
-        auto loc = sym.data(gs)->loc();
-        if (loc.exists() && loc.file().data(gs).isRBI()) {
-            return;
-        }
+    auto &abstract = getAbstractMethods(gs, sym);
 
-        auto &abstract = getAbstractMethods(gs, sym);
+    if (abstract.empty()) {
+        return;
+    }
 
-        if (abstract.empty()) {
-            return;
+    for (auto proto : abstract) {
+        if (proto.data(gs)->owner == sym) {
+            continue;
         }
 
-        for (auto proto : abstract) {
-            if (proto.data(gs)->owner == sym) {
-                continue;
-            }
-
-            auto mem = sym.data(gs)->findConcreteMethodTransitive(gs, proto.data(gs)->name);
-            if (!mem.exists()) {
-                if (auto e = gs.beginError(loc, core::errors::Resolver::BadAbstractMethod)) {
-                    e.setHeader("Missing definition for abstract method `{}`", proto.data(gs)->show(gs));
-                    e.addErrorLine(proto.data(gs)->loc(), "defined here");
-                }
+        auto mem = sym.data(gs)->findConcreteMethodTransitive(gs, proto.data(gs)->name);
+        if (!mem.exists()) {
+            if (auto e = gs.beginError(loc, core::errors::Resolver::BadAbstractMethod)) {
+                e.setHeader("Missing definition for abstract method `{}`", proto.data(gs)->show(gs));
+                e.addErrorLine(proto.data(gs)->loc(), "defined here");
             }
         }
     }
+}
 
-public:
-    unique_ptr<ast::ClassDef> preTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> classDef) {
-        auto sym = classDef->symbol;
-        auto singleton = sym.data(ctx)->lookupSingletonClass(ctx);
-        validateTStructNotGrandparent(ctx.state, sym);
-        validateAbstract(ctx.state, sym);
-        validateAbstract(ctx.state, singleton);
-        validateFinal(ctx.state, sym, classDef);
-        return classDef;
-    }
-
-    unique_ptr<ast::MethodDef> preTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> methodDef) {
-        auto methodData = methodDef->symbol.data(ctx);
-        auto ownerData = methodData->owner.data(ctx);
-
-        // Only perform this check if this isn't a module from the stdlib, and
-        // if there are type members in the owning context.
-        // NOTE: We're skipping variance checks on the stdlib right now, as
-        // Array and Hash are defined with their parameters as covariant, and as
-        // a result most of their methods would fail this check.
-        if (!methodData->loc().file().data(ctx).isStdlib() && !ownerData->typeMembers().empty()) {
-            variance::validateMethodVariance(ctx, methodDef->symbol);
-        }
+unique_ptr<ast::ClassDef> ValidateWalk::preTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> classDef) {
+    auto sym = classDef->symbol;
+    auto singleton = sym.data(ctx)->lookupSingletonClass(ctx);
+    validateTStructNotGrandparent(ctx.state, sym);
+    validateAbstract(ctx.state, sym);
+    validateAbstract(ctx.state, singleton);
+    validateFinal(ctx.state, sym, classDef);
+    return classDef;
+}
 
-        validateOverriding(ctx.state, methodDef->symbol);
+unique_ptr<ast::MethodDef> ValidateWalk::preTransformMethodDef(core::Context ctx,
+                                                             unique_ptr<ast::MethodDef> methodDef) {
+    if (methodDef->name == core::Names::staticInit()) {
+        // Synthesized by the flattener, which may run in the same walk (see flatten::validateAndRunOne). There is
+        // nothing here to validate.
         return methodDef;
     }
-};
+
+    auto methodData = methodDef->symbol.data(ctx);
+    auto ownerData = methodData->owner.data(ctx);
+
+    // Only perform this check if this isn't a module from the stdlib, and
+    // if there are type members in the owning context.
+    // NOTE: We're skipping variance checks on the stdlib right now, as
+    // Array and Hash are defined with their parameters as covariant, and as
+    // a result most of their methods would fail this check.
+    if (!methodData->loc().file().data(ctx).isStdlib() && !ownerData->typeMembers().empty()) {
+        variance::validateMethodVariance(ctx, methodDef->symbol);
+    }
+
+    validateOverriding(ctx.state, methodDef->symbol);
+    return methodDef;
+}
 
 ast::ParsedFile runOne(core::Context ctx, ast::ParsedFile tree) {
     Timer timeit(ctx.state.tracer(), "validateSymbols");
@@ -22,108 +22,163 @@ using namespace std;
 
 namespace sorbet::dsl {
 
-class DSLReplacer {
-    friend class DSL;
+namespace {
+
+using SendRewriter = vector<unique_ptr<ast::Expression>> (*)(core::MutableContext ctx, ast::Send *send,
+                                                             const ast::Expression *prevStat, ast::ClassDefKind kind);
+using AssignRewriter = vector<unique_ptr<ast::Expression>> (*)(core::MutableContext ctx, ast::Assign *asgn);
+
+// Routes each class body statement straight to the rewriters that can replace it, so that a statement is looked at
+// once no matter how many DSLs there are. Sends are keyed on their method name and assignments on the method name of
+// the Send on their right-hand side; every rewriter returns nothing for the names it is not listed under here, so
+// adding a DSL means listing it under its names too. Within one name, rewriters keep their original precedence.
+class DispatchTable {
+    UnorderedMap<core::NameRef, vector<SendRewriter>> sends;
+    UnorderedMap<core::NameRef, vector<AssignRewriter>> assigns;
+
+    void add(SendRewriter rewriter, const vector<core::NameRef> &names) {
+        for (auto name : names) {
+            sends[name].emplace_back(rewriter);
+        }
+    }
+
+    void add(AssignRewriter rewriter, const vector<core::NameRef> &names) {
+        for (auto name : names) {
+            assigns[name].emplace_back(rewriter);
+        }
+    }
+
+    DispatchTable() {
+        add([](core::MutableContext ctx, ast::Assign *asgn) { return Struct::replaceDSL(ctx, asgn); },
+            {core::Names::new_()});
+        add([](core::MutableContext ctx, ast::Assign *asgn) { return ClassNew::replaceDSL(ctx, asgn); },
+            {core::Names::new_()});
+        add([](core::MutableContext ctx, ast::Assign *asgn) { return ProtobufDescriptorPool::replaceDSL(ctx, asgn); },
+            {core::Names::msgclass(), core::Names::enummodule()});
+
+        add([](core::MutableContext ctx, ast::Send *send, const ast::Expression *prevStat,
+               ast::ClassDefKind kind) { return MixinEncryptedProp::replaceDSL(ctx, send); },
+            {core::Names::encrypted_prop()});
+        add([](core::MutableContext ctx, ast::Send *send, const ast::Expression *prevStat,
+               ast::ClassDefKind kind) { return Minitest::replaceDSL(ctx, send); },
+            {core::Names::before(), core::Names::describe(), core::Names::it()});
+        add([](core::MutableContext ctx, ast::Send *send, const ast::Expression *prevStat,
+               ast::ClassDefKind kind) { return DSLBuilder::replaceDSL(ctx, send); },
+            {core::Names::dslOptional(), core::Names::dslRequired()});
+        add([](core::MutableContext ctx, ast::Send *send, const ast::Expression *prevStat,
+               ast::ClassDefKind kind) { return Private::replaceDSL(ctx, send); },
+            {core::Names::private_(), core::Names::privateClassMethod()});
+        add([](core::MutableContext ctx, ast::Send *send, const ast::Expression *prevStat,
+               ast::ClassDefKind kind) { return Delegate::replaceDSL(ctx, send); },
+            {core::Names::delegate()});
+        // This one is different: it gets an extra prevStat argument.
+        add([](core::MutableContext ctx, ast::Send *send, const ast::Expression *prevStat,
+               ast::ClassDefKind kind) { return AttrReader::replaceDSL(ctx, send, prevStat); },
+            {core::Names::attr(), core::Names::attrReader(), core::Names::attrWriter(), core::Names::attrAccessor()});
+        // This one is also a little different: it gets the ClassDef kind
+        add([](core::MutableContext ctx, ast::Send *send, const ast::Expression *prevStat,
+               ast::ClassDefKind kind) { return Mattr::replaceDSL(ctx, send, kind); },
+            {core::Names::mattrReader(), core::Names::cattrReader(), core::Names::mattrWriter(),
+             core::Names::cattrWriter(), core::Names::mattrAccessor(), core::Names::cattrAccessor(),
+             core::Names::classAttribute()});
+    }
 
 public:
-    unique_ptr<ast::ClassDef> postTransformClassDef(core::MutableContext ctx, unique_ptr<ast::ClassDef> classDef) {
-        Command::patchDSL(ctx, classDef.get());
-        Rails::patchDSL(ctx, classDef.get());
-        OpusEnum::patchDSL(ctx, classDef.get());
-        Prop::patchDSL(ctx, classDef.get());
-
-        ast::Expression *prevStat = nullptr;
-        UnorderedMap<ast::Expression *, vector<unique_ptr<ast::Expression>>> replaceNodes;
-        for (auto &stat : classDef->rhs) {
-            typecase(
-                stat.get(),
-                [&](ast::Assign *assign) {
-                    auto nodes = Struct::replaceDSL(ctx, assign);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-
-                    nodes = ClassNew::replaceDSL(ctx, assign);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-
-                    nodes = ProtobufDescriptorPool::replaceDSL(ctx, assign);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-                },
-
-                [&](ast::Send *send) {
-                    auto nodes = MixinEncryptedProp::replaceDSL(ctx, send);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-
-                    nodes = Minitest::replaceDSL(ctx, send);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = move(nodes);
-                        return;
-                    }
-
-                    nodes = DSLBuilder::replaceDSL(ctx, send);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-
-                    nodes = Private::replaceDSL(ctx, send);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-
-                    nodes = Delegate::replaceDSL(ctx, send);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-
-                    // This one is different: it gets an extra prevStat argument.
-                    nodes = AttrReader::replaceDSL(ctx, send, prevStat);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-
-                    // This one is also a little different: it gets the ClassDef kind
-                    nodes = Mattr::replaceDSL(ctx, send, classDef->kind);
-                    if (!nodes.empty()) {
-                        replaceNodes[stat.get()] = std::move(nodes);
-                        return;
-                    }
-                },
-
-                [&](ast::Expression *e) {});
-
-            prevStat = stat.get();
+    // Well-known names have the same ids in every GlobalState, so one table serves them all.
+    static const DispatchTable &get() {
+        static const DispatchTable table;
+        return table;
+    }
+
+    vector<unique_ptr<ast::Expression>> replace(core::MutableContext ctx, ast::Send *send,
+                                                const ast::Expression *prevStat, ast::ClassDefKind kind) const {
+        auto fnd = sends.find(send->fun);
+        if (fnd != sends.end()) {
+            for (auto rewriter : fnd->second) {
+                auto nodes = rewriter(ctx, send, prevStat, kind);
+                if (!nodes.empty()) {
+                    return nodes;
+                }
+            }
+        }
+        return {};
+    }
+
+    vector<unique_ptr<ast::Expression>> replace(core::MutableContext ctx, ast::Assign *asgn) const {
+        auto *send = ast::cast_tree<ast::Send>(asgn->rhs.get());
+        if (send == nullptr) {
+            return {};
         }
-        if (replaceNodes.empty()) {
-            return classDef;
+        auto fnd = assigns.find(send->fun);
+        if (fnd != assigns.end()) {
+            for (auto rewriter : fnd->second) {
+                auto nodes = rewriter(ctx, asgn);
+                if (!nodes.empty()) {
+                    return nodes;
+                }
+            }
         }
+        return {};
+    }
+};
 
-        auto oldRHS = std::move(classDef->rhs);
-        classDef->rhs.clear();
-        classDef->rhs.reserve(oldRHS.size());
+void patchClassDef(core::MutableContext ctx, ast::ClassDef *classDef) {
+    Command::patchDSL(ctx, classDef);
+    Rails::patchDSL(ctx, classDef);
+    OpusEnum::patchDSL(ctx, classDef);
+    Prop::patchDSL(ctx, classDef);
+
+    const auto &dispatch = DispatchTable::get();
+    ast::Expression *prevStat = nullptr;
+    UnorderedMap<ast::Expression *, vector<unique_ptr<ast::Expression>>> replaceNodes;
+    for (auto &stat : classDef->rhs) {
+        typecase(
+            stat.get(),
+            [&](ast::Assign *assign) {
+                auto nodes = dispatch.replace(ctx, assign);
+                if (!nodes.empty()) {
+                    replaceNodes[stat.get()] = std::move(nodes);
+                }
+            },
 
-        for (auto &stat : oldRHS) {
-            if (replaceNodes.find(stat.get()) == replaceNodes.end()) {
-                classDef->rhs.emplace_back(std::move(stat));
-            } else {
-                for (auto &newNode : replaceNodes.at(stat.get())) {
-                    classDef->rhs.emplace_back(std::move(newNode));
+            [&](ast::Send *send) {
+                auto nodes = dispatch.replace(ctx, send, prevStat, classDef->kind);
+                if (!nodes.empty()) {
+                    replaceNodes[stat.get()] = std::move(nodes);
                 }
+            },
+
+            [&](ast::Expression *e) {});
+
+        prevStat = stat.get();
+    }
+    if (replaceNodes.empty()) {
+        return;
+    }
+
+    auto oldRHS = std::move(classDef->rhs);
+    classDef->rhs.clear();
+    classDef->rhs.reserve(oldRHS.size());
+
+    for (auto &stat : oldRHS) {
+        if (replaceNodes.find(stat.get()) == replaceNodes.end()) {
+            classDef->rhs.emplace_back(std::move(stat));
+        } else {
+            for (auto &newNode : replaceNodes.at(stat.get())) {
+                classDef->rhs.emplace_back(std::move(newNode));
             }
         }
+    }
+}
+
+} // namespace
+
+class DSLReplacer {
+    friend class DSL;
+
+public:
+    unique_ptr<ast::ClassDef> postTransformClassDef(core::MutableContext ctx, unique_ptr<ast::ClassDef> classDef) {
+        patchClassDef(ctx, classDef.get());
         return classDef;
     }
 
@@ -135,6 +190,15 @@ private:
     DSLReplacer() = default;
 };
 
+unique_ptr<ast::ClassDef> DSLWalk::preTransformClassDef(core::MutableContext ctx, unique_ptr<ast::ClassDef> classDef) {
+    patchClassDef(ctx, classDef.get());
+    return classDef;
+}
+
+unique_ptr<ast::Expression> DSLWalk::postTransformSend(core::MutableContext ctx, unique_ptr<ast::Send> send) {
+    return InterfaceWrapper::replaceDSL(ctx, std::move(send));
+}
+
 unique_ptr<ast::Expression> DSL::run(core::MutableContext ctx, unique_ptr<ast::Expression> tree) {
     auto ast = std::move(tree);
 
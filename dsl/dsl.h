@@ -12,6 +12,18 @@ public:
     DSL() = delete;
 };
 
+/**
+ * The DSL rewrites as hooks for a walk that does something else too (see ast::FusedTransform). Unlike DSL::run, which
+ * rewrites each class body on the way back up, this rewrites it on the way down, so that the rest of the walk goes on
+ * to visit everything the DSLs generated.
+ */
+class DSLWalk {
+public:
+    std::unique_ptr<ast::ClassDef> preTransformClassDef(core::MutableContext ctx,
+                                                        std::unique_ptr<ast::ClassDef> classDef);
+    std::unique_ptr<ast::Expression> postTransformSend(core::MutableContext ctx, std::unique_ptr<ast::Send> send);
+};
+
 } // namespace sorbet::dsl
 
 #endif
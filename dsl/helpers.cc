@@ -52,7 +52,7 @@ unique_ptr<ast::Expression> thunkBody(core::MutableContext ctx, ast::Expression
     return move(send->block->body);
 }
 
-bool isProbablySymbol(core::MutableContext ctx, ast::Expression *type, core::SymbolRef sym) {
+bool isProbablySymbol(core::Context ctx, ast::Expression *type, core::SymbolRef sym) {
     auto cnst = ast::cast_tree<ast::UnresolvedConstantLit>(type);
     if (cnst) {
         if (cnst->cnst != sym.data(ctx)->name) {
@@ -64,7 +64,7 @@ bool isProbablySymbol(core::MutableContext ctx, ast::Expression *type, core::Sym
 
         auto scopeCnst = ast::cast_tree<ast::UnresolvedConstantLit>(cnst->scope.get());
         if (scopeCnst && ast::isa_tree<ast::EmptyTree>(scopeCnst->scope.get()) &&
-            scopeCnst->cnst == core::Symbols::T().data(ctx)->name) {
+            scopeCnst->cnst == core::Names::Constants::T()) {
             return true;
         }
 
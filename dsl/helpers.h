@@ -19,7 +19,7 @@ std::unique_ptr<ast::Expression> mkMutator(core::MutableContext ctx, core::Loc l
 
 std::unique_ptr<ast::Expression> thunkBody(core::MutableContext ctx, ast::Expression *node);
 
-bool isProbablySymbol(core::MutableContext ctx, ast::Expression *type, core::SymbolRef sym);
+bool isProbablySymbol(core::Context ctx, ast::Expression *type, core::SymbolRef sym);
 
 } // namespace sorbet::dsl
 
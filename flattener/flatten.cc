@@ -4,6 +4,7 @@
 #include "ast/treemap/treemap.h"
 #include "common/concurrency/WorkerPool.h"
 #include "core/core.h"
+#include "definition_validator/validator.h"
 
 #include <utility>
 
@@ -260,4 +261,19 @@ ast::ParsedFile runOne(core::Context ctx, ast::ParsedFile tree) {
     return tree;
 }
 
+ast::ParsedFile validateAndRunOne(core::Context ctx, ast::ParsedFile tree) {
+    Timer timeit(ctx.state.tracer(), "validateAndFlatten");
+
+    // The validator only reads the trees it is handed, and runs first, so it sees every definition before this pass
+    // moves it out of its parent.
+    definition_validator::ValidateWalk validate;
+    FlattenWalk flatten;
+    ast::FusedTransform<definition_validator::ValidateWalk, FlattenWalk> fused(validate, flatten);
+    tree.tree = ast::TreeMap::apply(ctx, fused, std::move(tree.tree));
+    tree.tree = flatten.addClasses(ctx, std::move(tree.tree));
+    tree.tree = flatten.addMethods(ctx, std::move(tree.tree));
+
+    return tree;
+}
+
 } // namespace sorbet::flatten
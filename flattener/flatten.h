@@ -7,6 +7,9 @@ namespace sorbet::flatten {
 
 ast::ParsedFile runOne(core::Context ctx, ast::ParsedFile trees);
 
+// definition_validator::runOne followed by runOne, in a single walk over the tree.
+ast::ParsedFile validateAndRunOne(core::Context ctx, ast::ParsedFile tree);
+
 } // namespace sorbet::flatten
 
 #endif
@@ -112,6 +112,12 @@ core::TypePtr extractArgType(core::Context ctx, cfg::Send &send, core::DispatchC
     return to;
 }
 
+// How much work guessing a method's argument types may do before giving up on it. The guesses take a dispatch for
+// every send that might be passed an argument and a fixed point over the method's blocks, which on a few generated
+// methods with thousands of sends costs more than typechecking everything else in the file.
+constexpr int MAX_GUESSING_DISPATCHES = 1000;
+constexpr int MAX_GUESSING_ROUNDS = 64;
+
 void extractSendArgumentKnowledge(core::Context ctx, core::Loc bindLoc, cfg::Send *snd,
                                   const UnorderedMap<core::LocalVariable, InlinedVector<core::NameRef, 1>> &blockLocals,
                                   UnorderedMap<core::NameRef, core::TypePtr> &blockArgRequirements) {
@@ -176,8 +182,11 @@ void extractSendArgumentKnowledge(core::Context ctx, core::Loc bindLoc, cfg::Sen
     }
 }
 
-UnorderedMap<core::NameRef, core::TypePtr> guessArgumentTypes(core::Context ctx, core::SymbolRef methodSymbol,
-                                                              unique_ptr<cfg::CFG> &cfg) {
+// Returns nothing if the method needs more work than the budget above allows.
+optional<UnorderedMap<core::NameRef, core::TypePtr>> guessArgumentTypes(core::Context ctx, core::SymbolRef methodSymbol,
+                                                                        unique_ptr<cfg::CFG> &cfg) {
+    int dispatchesLeft = MAX_GUESSING_DISPATCHES;
+
     // What variables by the end of basic block could plausibly contain what arguments.
     vector<UnorderedMap<core::LocalVariable, InlinedVector<core::NameRef, 1>>> localsStoringArguments;
     localsStoringArguments.resize(cfg->maxBasicBlockId);
@@ -234,6 +243,9 @@ UnorderedMap<core::NameRef, core::TypePtr> guessArgumentTypes(core::Context ctx,
                 }
 
                 if (shouldFindArgumentTypes) {
+                    if (--dispatchesLeft < 0) {
+                        return nullopt;
+                    }
                     extractSendArgumentKnowledge(ctx, bind.loc, snd, blockLocals, blockArgRequirements);
                 }
             }
@@ -249,7 +261,11 @@ UnorderedMap<core::NameRef, core::TypePtr> guessArgumentTypes(core::Context ctx,
     }
 
     bool changed = true;
+    int roundsLeft = MAX_GUESSING_ROUNDS;
     while (changed) {
+        if (--roundsLeft < 0) {
+            return nullopt;
+        }
         changed = false;
         for (auto it = cfg->forwardsTopoSort.rbegin(); it != cfg->forwardsTopoSort.rend(); ++it) {
             cfg::BasicBlock *bb = *it;
@@ -360,6 +376,22 @@ bool SigSuggestion::maybeSuggestSig(core::Context ctx, core::ErrorBuilder &e, un
                                     const core::TypePtr &methodReturnType, core::TypeConstraint &constr) {
     core::SymbolRef methodSymbol = cfg->symbol;
 
+    // Bail out on everything we'd never suggest a sig for before doing any of the guessing.
+    auto loc = methodSymbol.data(ctx)->loc();
+    if (!loc.file().exists()) {
+        return false;
+    }
+
+    // Sometimes the methodSymbol we're looking at has been synthesized by a DSL pass, so no 'def' exists in the source
+    if (loc.file().data(ctx).source().substr(loc.beginPos(), 3) != "def") {
+        return false;
+    }
+
+    bool hasExistingSig = methodSymbol.data(ctx)->resultType != nullptr;
+    if (hasExistingSig && !methodSymbol.data(ctx)->hasGeneratedSig()) {
+        return false;
+    }
+
     bool guessedSomethingUseful = false;
     if (ctx.state.suggestRuntimeProfiledType) {
         guessedSomethingUseful = true;
@@ -395,7 +427,13 @@ bool SigSuggestion::maybeSuggestSig(core::Context ctx, core::ErrorBuilder &e, un
         return false;
     }
 
-    auto guessedArgumentTypes = guessArgumentTypes(ctx, methodSymbol, cfg);
+    UnorderedMap<core::NameRef, core::TypePtr> guessedArgumentTypes;
+    if (auto guessed = guessArgumentTypes(ctx, methodSymbol, cfg)) {
+        guessedArgumentTypes = std::move(*guessed);
+    } else {
+        // Still worth suggesting the rest of the sig, with every argument we couldn't get from a parent untyped.
+        counterInc("infer.sig_suggestion.over_budget");
+    }
 
     auto enclosingClass = methodSymbol.data(ctx)->enclosingClass(ctx);
     auto closestMethod = closestOverridenMethod(ctx, enclosingClass, methodSymbol.data(ctx)->name);
@@ -414,12 +452,6 @@ bool SigSuggestion::maybeSuggestSig(core::Context ctx, core::ErrorBuilder &e, un
         }
     }
 
-    auto loc = methodSymbol.data(ctx)->loc();
-    // Sometimes the methodSymbol we're looking at has been synthesized by a DSL pass, so no 'def' exists in the source
-    if (loc.file().data(ctx).source().substr(loc.beginPos(), 3) != "def") {
-        return false;
-    }
-
     // Note: Before running any substantial codemod to add generated sigs at Stripe, be sure to insert `generated.`
     // in all the suggested sigs. (Either change this line below and recompile, or post-process using sed).
     fmt::format_to(ss, "sig {{");
@@ -498,15 +530,6 @@ bool SigSuggestion::maybeSuggestSig(core::Context ctx, core::ErrorBuilder &e, un
 
     auto [replacementLoc, padding] = loc.findStartOfLine(ctx);
     string spaces(padding, ' ');
-    bool hasExistingSig = methodSymbol.data(ctx)->resultType != nullptr;
-
-    if (!loc.file().exists()) {
-        return false;
-    }
-
-    if (hasExistingSig && !methodSymbol.data(ctx)->hasGeneratedSig()) {
-        return false;
-    }
 
     if (hasExistingSig) {
         if (auto existingStart = startOfExistingSig(ctx, loc)) {
@@ -22,11 +22,12 @@ core::TypePtr dropConstructor(core::Context ctx, core::Loc loc, core::TypePtr tp
     return tp;
 }
 
-KnowledgeFilter::KnowledgeFilter(core::Context ctx, unique_ptr<cfg::CFG> &cfg) {
+KnowledgeFilter::KnowledgeFilter(core::Context ctx, unique_ptr<cfg::CFG> &cfg)
+    : inWhat(*cfg), used_vars(cfg->numLocalVariables()) {
     for (auto &bb : cfg->basicBlocks) {
         if (bb->bexit.cond.variable != core::LocalVariable::noVariable() &&
             bb->bexit.cond.variable != core::LocalVariable::blockCall()) {
-            used_vars.insert(bb->bexit.cond.variable);
+            used_vars[cfg->localVariableId(bb->bexit.cond.variable)] = true;
         }
     }
     bool changed = true;
@@ -36,24 +37,24 @@ KnowledgeFilter::KnowledgeFilter(core::Context ctx, unique_ptr<cfg::CFG> &cfg) {
             for (auto &bind : bb->exprs) {
                 if (auto *id = cfg::cast_instruction<cfg::Ident>(bind.value.get())) {
                     if (isNeeded(bind.bind.variable) && !isNeeded(id->what)) {
-                        used_vars.insert(id->what);
+                        used_vars[cfg->localVariableId(id->what)] = true;
                         changed = true;
                     }
                 } else if (auto *send = cfg::cast_instruction<cfg::Send>(bind.value.get())) {
                     if (send->fun == core::Names::bang()) {
                         if (send->args.empty()) {
                             if (isNeeded(bind.bind.variable) && !isNeeded(send->recv.variable)) {
-                                used_vars.insert(send->recv.variable);
+                                used_vars[cfg->localVariableId(send->recv.variable)] = true;
                                 changed = true;
                             }
                         }
                     } else if (send->fun == core::Names::eqeq()) {
                         if (send->args.size() == 1) {
                             if (isNeeded(send->args[0].variable) && !isNeeded(send->recv.variable)) {
-                                used_vars.insert(send->recv.variable);
+                                used_vars[cfg->localVariableId(send->recv.variable)] = true;
                                 changed = true;
                             } else if (isNeeded(send->recv.variable) && !isNeeded(send->args[0].variable)) {
-                                used_vars.insert(send->args[0].variable);
+                                used_vars[cfg->localVariableId(send->args[0].variable)] = true;
                                 changed = true;
                             }
                         }
@@ -65,7 +66,8 @@ KnowledgeFilter::KnowledgeFilter(core::Context ctx, unique_ptr<cfg::CFG> &cfg) {
 }
 
 bool KnowledgeFilter::isNeeded(core::LocalVariable var) {
-    return used_vars.find(var) != used_vars.end();
+    auto fnd = inWhat.localVariableIds.find(var);
+    return fnd != inWhat.localVariableIds.end() && used_vars[fnd->second];
 }
 
 KnowledgeRef KnowledgeFact::under(core::Context ctx, const KnowledgeRef &what, const Environment &env, core::Loc loc,
@@ -82,7 +84,7 @@ KnowledgeRef KnowledgeFact::under(core::Context ctx, const KnowledgeRef &what, c
     for (auto &pair : env.vars) {
         auto local = pair.first;
         auto &state = pair.second;
-        if (enteringLoop && bb->outerLoops <= inWhat.maxLoopWrite[local]) {
+        if (enteringLoop && bb->outerLoops <= inWhat.maxLoopWriteById[state.localVariableId]) {
             continue;
         }
         auto fnd = absl::c_find_if(copy->yesTypeTests, [&](auto const &e) -> bool { return e.first == local; });
@@ -113,6 +115,12 @@ KnowledgeRef KnowledgeFact::under(core::Context ctx, const KnowledgeRef &what, c
 
             auto type = state.typeAndOrigins.type;
             if (isNeeded && !type->isUntyped() && !core::isa_type<core::MetaType>(type.get())) {
+                if (copy->yesTypeTests.size() >= MAX_TYPE_TESTS) {
+                    // Knowing less is always safe: past this point, only types flowing through the CFG narrow
+                    // variables, rather than facts about every other variable in scope.
+                    counterInc("infer.knowledge.capped");
+                    continue;
+                }
                 copy.mutate().yesTypeTests.emplace_back(local, type);
             }
         } else {
@@ -129,6 +137,9 @@ KnowledgeRef KnowledgeFact::under(core::Context ctx, const KnowledgeRef &what, c
 }
 
 void KnowledgeFact::min(core::Context ctx, const KnowledgeFact &other) {
+    if (this == &other) {
+        return;
+    }
     for (auto it = yesTypeTests.begin(); it != yesTypeTests.end(); /* nothing */) {
         auto &entry = *it;
         core::LocalVariable local = entry.first;
@@ -283,8 +294,8 @@ bool Environment::getKnownTruthy(core::LocalVariable var) const {
 void Environment::propagateKnowledge(core::Context ctx, core::LocalVariable to, core::LocalVariable from,
                                      KnowledgeFilter &knowledgeFilter) {
     if (knowledgeFilter.isNeeded(to) && knowledgeFilter.isNeeded(from)) {
-        auto &fromState = vars[from];
-        auto &toState = vars[to];
+        auto &fromState = stateFor(from);
+        auto &toState = stateFor(to);
         toState.knownTruthy = fromState.knownTruthy;
         auto &toKnowledge = toState.knowledge;
         auto &fromKnowledge = fromState.knowledge;
@@ -305,24 +316,31 @@ void Environment::propagateKnowledge(core::Context ctx, core::LocalVariable to,
     }
 }
 
+namespace {
+bool mentions(const KnowledgeFact &fact, core::LocalVariable var) {
+    auto isVar = [&](auto const &c) -> bool { return c.first == var; };
+    return absl::c_any_of(fact.yesTypeTests, isVar) || absl::c_any_of(fact.noTypeTests, isVar);
+}
+
+void forget(KnowledgeRef &knowledge, core::LocalVariable var) {
+    // Most facts don't mention `var`, and those can stay shared with the environments they were copied from.
+    if (!mentions(*knowledge, var)) {
+        return;
+    }
+    auto &fact = knowledge.mutate();
+    auto isVar = [&](auto const &c) -> bool { return c.first == var; };
+    fact.yesTypeTests.erase(remove_if(fact.yesTypeTests.begin(), fact.yesTypeTests.end(), isVar),
+                            fact.yesTypeTests.end());
+    fact.noTypeTests.erase(remove_if(fact.noTypeTests.begin(), fact.noTypeTests.end(), isVar), fact.noTypeTests.end());
+}
+} // namespace
+
 void Environment::clearKnowledge(core::Context ctx, core::LocalVariable reassigned, KnowledgeFilter &knowledgeFilter) {
     for (auto &el : vars) {
         auto &k = el.second.knowledge;
-        if (knowledgeFilter.isNeeded(el.first)) {
-            auto &truthy = k.truthy.mutate();
-            auto &falsy = k.falsy.mutate();
-            truthy.yesTypeTests.erase(remove_if(truthy.yesTypeTests.begin(), truthy.yesTypeTests.end(),
-                                                [&](auto const &c) -> bool { return c.first == reassigned; }),
-                                      truthy.yesTypeTests.end());
-            falsy.yesTypeTests.erase(remove_if(falsy.yesTypeTests.begin(), falsy.yesTypeTests.end(),
-                                               [&](auto const &c) -> bool { return c.first == reassigned; }),
-                                     falsy.yesTypeTests.end());
-            truthy.noTypeTests.erase(remove_if(truthy.noTypeTests.begin(), truthy.noTypeTests.end(),
-                                               [&](auto const &c) -> bool { return c.first == reassigned; }),
-                                     truthy.noTypeTests.end());
-            falsy.noTypeTests.erase(remove_if(falsy.noTypeTests.begin(), falsy.noTypeTests.end(),
-                                              [&](auto const &c) -> bool { return c.first == reassigned; }),
-                                    falsy.noTypeTests.end());
+        if (knowledgeFilter.isNeeded(el.second.localVariableId)) {
+            forget(k.truthy, reassigned);
+            forget(k.falsy, reassigned);
             k.sanityCheck();
         }
     }
@@ -477,7 +495,7 @@ void Environment::updateKnowledge(core::Context ctx, core::LocalVariable local,
 
 void Environment::setTypeAndOrigin(core::LocalVariable symbol, const core::TypeAndOrigins &typeAndOrigins) {
     ENFORCE(typeAndOrigins.type.get() != nullptr);
-    vars[symbol].typeAndOrigins = typeAndOrigins;
+    stateFor(symbol).typeAndOrigins = typeAndOrigins;
 }
 
 const Environment &Environment::withCond(core::Context ctx, const Environment &env, Environment &copy, bool isTrue,
@@ -485,7 +503,7 @@ const Environment &Environment::withCond(core::Context ctx, const Environment &e
     if (!env.bb->bexit.cond.variable.exists() || env.bb->bexit.cond.variable == core::LocalVariable::blockCall()) {
         return env;
     }
-    copy.cloneFrom(env);
+    copy.cloneFrom(env, filter);
     copy.assumeKnowledge(ctx, isTrue, env.bb->bexit.cond.variable, env.bb->bexit.loc, filter);
     return copy;
 }
@@ -515,14 +533,14 @@ void Environment::assumeKnowledge(core::Context ctx, bool isTrue, core::LocalVar
     } else {
         core::TypeAndOrigins tp = getTypeAndOrigin(ctx, cond);
         tp.origins.emplace_back(loc);
-        tp.type = core::Types::dropSubtypesOf(ctx, core::Types::dropSubtypesOf(ctx, tp.type, core::Symbols::NilClass()),
-                                              core::Symbols::FalseClass());
+        tp.type =
+            core::Types::dropSubtypesOf(ctx, tp.type, {core::Symbols::NilClass(), core::Symbols::FalseClass()});
         if (tp.type->isBottom()) {
             isDead = true;
             return;
         }
         setTypeAndOrigin(cond, tp);
-        vars[cond].knownTruthy = true;
+        stateFor(cond).knownTruthy = true;
     }
 
     auto &knowledgeToChoose = isTrue ? thisKnowledge.truthy : thisKnowledge.falsy;
@@ -578,14 +596,17 @@ void Environment::mergeWith(core::Context ctx, const Environment &other, core::L
     this->isDead |= other.isDead;
     for (auto &pair : vars) {
         auto var = pair.first;
+        auto id = pair.second.localVariableId;
         const auto &otherTO = other.getTypeAndOrigin(ctx, var);
         auto &thisTO = pair.second.typeAndOrigins;
         if (thisTO.type.get() != nullptr) {
             thisTO.type = core::Types::any(ctx, thisTO.type, otherTO.type);
             thisTO.type->sanityCheck(ctx);
-            for (auto origin : otherTO.origins) {
-                if (!absl::c_linear_search(thisTO.origins, origin)) {
-                    thisTO.origins.emplace_back(origin);
+            if (trackOrigins) {
+                for (auto origin : otherTO.origins) {
+                    if (!absl::c_linear_search(thisTO.origins, origin)) {
+                        thisTO.origins.emplace_back(origin);
+                    }
                 }
             }
             pair.second.knownTruthy = pair.second.knownTruthy && other.getKnownTruthy(var);
@@ -594,7 +615,7 @@ void Environment::mergeWith(core::Context ctx, const Environment &other, core::L
             pair.second.knownTruthy = other.getKnownTruthy(var);
         }
 
-        if (((bb->flags & cfg::CFG::LOOP_HEADER) != 0) && bb->outerLoops <= inWhat.maxLoopWrite[var]) {
+        if (((bb->flags & cfg::CFG::LOOP_HEADER) != 0) && bb->outerLoops <= inWhat.maxLoopWriteById[id]) {
             continue;
         }
         bool canBeFalsy = core::Types::canBeFalsy(ctx, otherTO.type) && !other.getKnownTruthy(var);
@@ -603,12 +624,12 @@ void Environment::mergeWith(core::Context ctx, const Environment &other, core::L
         if (canBeTruthy) {
             auto &thisKnowledge = getKnowledge(var);
             auto otherTruthy = KnowledgeFact::under(ctx, other.getKnowledge(var, false).truthy, other, loc, inWhat, bb,
-                                                    knowledgeFilter.isNeeded(var));
+                                                    knowledgeFilter.isNeeded(id));
             if (!otherTruthy->isDead) {
                 if (!thisKnowledge.seenTruthyOption) {
                     thisKnowledge.seenTruthyOption = true;
                     thisKnowledge.truthy = otherTruthy;
-                } else {
+                } else if (!thisKnowledge.truthy.sharesWith(otherTruthy)) {
                     thisKnowledge.truthy.mutate().min(ctx, *otherTruthy);
                 }
             }
@@ -617,12 +638,12 @@ void Environment::mergeWith(core::Context ctx, const Environment &other, core::L
         if (canBeFalsy) {
             auto &thisKnowledge = getKnowledge(var);
             auto otherFalsy = KnowledgeFact::under(ctx, other.getKnowledge(var, false).falsy, other, loc, inWhat, bb,
-                                                   knowledgeFilter.isNeeded(var));
+                                                   knowledgeFilter.isNeeded(id));
             if (!otherFalsy->isDead) {
                 if (!thisKnowledge.seenFalsyOption) {
                     thisKnowledge.seenFalsyOption = true;
                     thisKnowledge.falsy = otherFalsy;
-                } else {
+                } else if (!thisKnowledge.falsy.sharesWith(otherFalsy)) {
                     thisKnowledge.falsy.mutate().min(ctx, *otherFalsy);
                 }
             }
@@ -640,8 +661,9 @@ void Environment::computePins(core::Context ctx, const vector<Environment> &envs
         auto var = pair.first;
         core::TypeAndOrigins tp;
 
-        auto bindMinLoops = inWhat.minLoops.at(var);
-        if (bb->outerLoops == bindMinLoops || bindMinLoops == inWhat.maxLoopWrite.at(var)) {
+        auto id = pair.second.localVariableId;
+        auto bindMinLoops = inWhat.minLoopsById[id];
+        if (bb->outerLoops == bindMinLoops || bindMinLoops == inWhat.maxLoopWriteById[id]) {
             continue;
         }
 
@@ -651,9 +673,11 @@ void Environment::computePins(core::Context ctx, const vector<Environment> &envs
             if (otherPin != other.pinnedTypes.end()) {
                 if (tp.type != nullptr) {
                     tp.type = core::Types::any(ctx, tp.type, otherPin->second.type);
-                    for (auto origin : otherPin->second.origins) {
-                        if (!absl::c_linear_search(tp.origins, origin)) {
-                            tp.origins.emplace_back(origin);
+                    if (trackOrigins) {
+                        for (auto origin : otherPin->second.origins) {
+                            if (!absl::c_linear_search(tp.origins, origin)) {
+                                tp.origins.emplace_back(origin);
+                            }
                         }
                     }
                     tp.type->sanityCheck(ctx);
@@ -729,9 +753,11 @@ core::TypePtr flatmapHack(core::Context ctx, core::TypePtr receiver, core::TypeP
     return core::Types::arrayOf(ctx, flattenArrays(ctx, returnType));
 }
 
+template <bool HAS_QUERY>
 core::TypePtr Environment::processBinding(core::Context ctx, cfg::Binding &bind, int loopCount, int bindMinLoops,
                                           KnowledgeFilter &knowledgeFilter, core::TypeConstraint &constr,
                                           core::TypePtr &methodReturnType) {
+    ENFORCE(HAS_QUERY || ctx.state.lspQuery.isEmpty());
     try {
         core::TypeAndOrigins tp;
         bool noLoopChecking = cfg::isa_instruction<cfg::Alias>(bind.value.get()) ||
@@ -740,7 +766,7 @@ core::TypePtr Environment::processBinding(core::Context ctx, cfg::Binding &bind,
 
         bool checkFullyDefined = true;
         const core::lsp::Query &lspQuery = ctx.state.lspQuery;
-        bool lspQueryMatch = lspQuery.matchesLoc(bind.loc);
+        bool lspQueryMatch = HAS_QUERY && lspQuery.matchesLoc(bind.loc);
 
         typecase(
             bind.value.get(),
@@ -769,7 +795,9 @@ core::TypePtr Environment::processBinding(core::Context ctx, cfg::Binding &bind,
                     for (auto &err : it->main.errors) {
                         ctx.state._error(std::move(err));
                     }
-                    lspQueryMatch = lspQueryMatch || lspQuery.matchesSymbol(it->main.method);
+                    if constexpr (HAS_QUERY) {
+                        lspQueryMatch = lspQueryMatch || lspQuery.matchesSymbol(it->main.method);
+                    }
                     it = it->secondary.get();
                 }
                 shared_ptr<core::DispatchResult> retainedResult;
@@ -1170,11 +1198,31 @@ core::TypePtr Environment::processBinding(core::Context ctx, cfg::Binding &bind,
     }
 }
 
-void Environment::cloneFrom(const Environment &rhs) {
+template core::TypePtr Environment::processBinding<true>(core::Context ctx, cfg::Binding &bind, int loopCount,
+                                                         int bindMinLoops, KnowledgeFilter &knowledgeFilter,
+                                                         core::TypeConstraint &constr,
+                                                         core::TypePtr &methodReturnType);
+template core::TypePtr Environment::processBinding<false>(core::Context ctx, cfg::Binding &bind, int loopCount,
+                                                          int bindMinLoops, KnowledgeFilter &knowledgeFilter,
+                                                          core::TypeConstraint &constr,
+                                                          core::TypePtr &methodReturnType);
+
+void Environment::cloneFrom(const Environment &rhs, const UnorderedMap<core::LocalVariable, VariableState> &filter) {
     this->isDead = rhs.isDead;
-    this->vars = rhs.vars;
     this->bb = rhs.bb;
     this->pinnedTypes = rhs.pinnedTypes;
+    this->vars.reserve(filter.size() + 1);
+    for (auto &pair : filter) {
+        auto fnd = rhs.vars.find(pair.first);
+        if (fnd != rhs.vars.end()) {
+            this->vars.emplace(*fnd);
+        }
+    }
+    auto cond = rhs.bb->bexit.cond.variable;
+    auto fnd = rhs.vars.find(cond);
+    if (fnd != rhs.vars.end()) {
+        this->vars.emplace(*fnd);
+    }
 }
 
 const TestedKnowledge &Environment::getKnowledge(core::LocalVariable symbol, bool shouldFail) const {
@@ -1197,7 +1245,16 @@ core::TypeAndOrigins nilTypesWithOriginWithLoc(core::Loc loc) {
     return ret;
 }
 
-Environment::Environment(core::Loc ownerLoc) : uninitialized(nilTypesWithOriginWithLoc(ownerLoc)) {}
+Environment::Environment(core::Loc ownerLoc, const cfg::CFG &inWhat, bool trackOrigins)
+    : uninitialized(nilTypesWithOriginWithLoc(ownerLoc)), inWhat(inWhat), trackOrigins(trackOrigins) {}
+
+Environment::VariableState &Environment::stateFor(core::LocalVariable local) {
+    auto [it, inserted] = vars.try_emplace(local);
+    if (inserted) {
+        it->second.localVariableId = inWhat.localVariableId(local);
+    }
+    return it->second;
+}
 
 TestedKnowledge TestedKnowledge::empty;
 } // namespace sorbet::infer
@@ -23,7 +23,9 @@ class Environment;
 // it only makes sense for us to store it if we are going to use it
 // wallk all the instructions and collect knowledge that we may ever need
 class KnowledgeFilter {
-    UnorderedSet<core::LocalVariable> used_vars;
+    const cfg::CFG &inWhat;
+    // indexed by local variable id
+    std::vector<bool> used_vars;
 
 public:
     KnowledgeFilter(core::Context ctx, std::unique_ptr<cfg::CFG> &cfg);
@@ -32,6 +34,9 @@ public:
     KnowledgeFilter(KnowledgeFilter &&) = delete;
 
     bool isNeeded(core::LocalVariable var);
+    bool isNeeded(int localVariableId) {
+        return used_vars[localVariableId];
+    }
 };
 
 class KnowledgeRef;
@@ -39,6 +44,9 @@ class KnowledgeRef;
  * Encode things that we know hold and don't hold
  */
 struct KnowledgeFact {
+    // `under` stops recording what the environment knows about other variables once a fact has this many type tests.
+    static constexpr size_t MAX_TYPE_TESTS = 128;
+
     bool isDead = false;
     /* the following type tests are known to be true */
     InlinedVector<std::pair<core::LocalVariable, core::TypePtr>, 1> yesTypeTests;
@@ -72,6 +80,11 @@ public:
 
     KnowledgeFact &mutate();
 
+    // Whether both refer to the same fact, which merging them would leave unchanged.
+    bool sharesWith(const KnowledgeRef &other) const {
+        return knowledge == other.knowledge;
+    }
+
 private:
     std::shared_ptr<KnowledgeFact> knowledge;
 };
@@ -96,11 +109,15 @@ class Environment {
     const core::TypeAndOrigins uninitialized;
 
 public:
-    Environment(core::Loc ownerLoc);
+    Environment(core::Loc ownerLoc, const cfg::CFG &inWhat, bool trackOrigins);
     Environment(const Environment &rhs) = delete;
     Environment(Environment &&rhs) = default;
 
     bool isDead = false;
+    const cfg::CFG &inWhat;
+    // Origins are only ever shown in error messages. Without this, merging environments keeps whichever origins the
+    // first incoming edge had instead of collecting all of them.
+    const bool trackOrigins;
     cfg::BasicBlock *bb;
 
     /*
@@ -126,8 +143,12 @@ public:
         core::TypeAndOrigins typeAndOrigins;
         TestedKnowledge knowledge;
         bool knownTruthy;
+        // The variable's id in `inWhat`, which indexes its per-variable facts there and in KnowledgeFilter
+        int localVariableId;
     };
     UnorderedMap<core::LocalVariable, VariableState> vars;
+    /* the state of `local`, which is created (with a null type) if this environment has none yet */
+    VariableState &stateFor(core::LocalVariable local);
 
     UnorderedMap<core::LocalVariable, core::TypeAndOrigins> pinnedTypes;
 
@@ -167,6 +188,9 @@ public:
      * returns a reference to that. This odd calling convention is used to avoid
      * copies, and because all callers of this immediately use the result and
      * then discard it, so the mixed lifetimes are not a problem in practice.
+     *
+     * `filter` holds the arguments of the block being entered. Those are the only variables that flow into it, so
+     * `copy` only carries them (and the condition), rather than every variable `env` knows about.
      */
     static const Environment &withCond(core::Context ctx, const Environment &env, Environment &copy, bool isTrue,
                                        const UnorderedMap<core::LocalVariable, VariableState> &filter);
@@ -186,6 +210,9 @@ public:
     // method on `Type` or otherwise handled there.
     core::TypePtr getReturnType(core::Context ctx, core::TypePtr procType);
 
+    // With HAS_QUERY false, which is only correct when ctx.state.lspQuery is empty, every check against the query and
+    // every response to it is compiled out.
+    template <bool HAS_QUERY>
     core::TypePtr processBinding(core::Context ctx, cfg::Binding &bind, int loopCount, int bindMinLoops,
                                  KnowledgeFilter &knowledgeFilter, core::TypeConstraint &constr,
                                  core::TypePtr &methodReturnType);
@@ -193,7 +220,8 @@ public:
     void ensureGoodCondition(core::Context ctx, core::LocalVariable cond) {}
     void ensureGoodAssignTarget(core::Context ctx, core::LocalVariable target) {}
 
-    void cloneFrom(const Environment &rhs);
+    /* copies the state of the variables in `filter`, and of the exit condition of `rhs` */
+    void cloneFrom(const Environment &rhs, const UnorderedMap<core::LocalVariable, VariableState> &filter);
 };
 
 } // namespace sorbet::infer
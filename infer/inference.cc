@@ -9,13 +9,15 @@
 using namespace std;
 namespace sorbet::infer {
 
-unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg) {
-    ENFORCE(cfg->symbol == ctx.owner);
+namespace {
+struct SendCounts {
+    int typed = 0;
+    int total = 0;
+};
+
+SendCounts inferTypes(core::Context ctx, unique_ptr<cfg::CFG> &cfg, bool trackOrigins) {
+    SendCounts sendCounts;
     auto methodLoc = cfg->symbol.data(ctx)->loc();
-    prodCounterInc("types.input.methods.typechecked");
-    int typedSendCount = 0;
-    int totalSendCount = 0;
-    const int startErrorCount = ctx.state.totalErrors();
     auto guessTypes = true;
     unique_ptr<core::TypeConstraint> _constr;
     core::TypeConstraint *constr = &core::TypeConstraint::EmptyFrozenConstraint;
@@ -34,6 +36,8 @@ unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg)
 
     core::TypePtr methodReturnType = cfg->symbol.data(ctx)->resultType;
     auto missingReturnType = methodReturnType == nullptr;
+    // Outside of LSP queries, bindings are processed by the variant of processBinding that never looks at the query.
+    const bool hasQuery = !ctx.state.lspQuery.isEmpty();
 
     if (cfg->symbol.data(ctx)->name.data(ctx)->kind != core::NameKind::UTF8 ||
         cfg->symbol.data(ctx)->name == core::Names::staticInit() || !cfg->symbol.data(ctx)->loc().exists()) {
@@ -68,19 +72,23 @@ unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg)
     vector<Environment> outEnvironments;
     outEnvironments.reserve(cfg->maxBasicBlockId);
     for (int i = 0; i < cfg->maxBasicBlockId; i++) {
-        outEnvironments.emplace_back(methodLoc);
+        outEnvironments.emplace_back(methodLoc, *cfg, trackOrigins);
     }
     for (int i = 0; i < cfg->basicBlocks.size(); i++) {
         outEnvironments[cfg->forwardsTopoSort[i]->id].bb = cfg->forwardsTopoSort[i];
     }
     vector<bool> visited;
     visited.resize(cfg->maxBasicBlockId);
+    // How much work this method took: blocks are each visited once, but every edge into a block merges an environment,
+    // and blocks inside loops compute the pinned types of the variables their loops write.
+    int environmentMerges = 0;
+    int deepestLoop = 0;
     KnowledgeFilter knowledgeFilter(ctx, cfg);
     if (!cfg->basicBlocks.empty()) {
         ENFORCE(!cfg->symbol.data(ctx)->isAbstract());
     } else {
         ENFORCE(cfg->symbol.data(ctx)->isAbstract());
-        return cfg;
+        return sendCounts;
     }
     for (auto it = cfg->forwardsTopoSort.rbegin(); it != cfg->forwardsTopoSort.rend(); ++it) {
         cfg::BasicBlock *bb = *it;
@@ -90,13 +98,14 @@ unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg)
         Environment &current = outEnvironments[bb->id];
         current.vars.reserve(bb->args.size());
         for (cfg::VariableUseSite &arg : bb->args) {
-            current.vars[arg.variable].typeAndOrigins.type = nullptr;
+            current.stateFor(arg.variable).typeAndOrigins.type = nullptr;
         }
         if (bb->backEdges.size() == 1) {
             auto *parent = bb->backEdges[0];
             bool isTrueBranch = parent->bexit.thenb == bb;
             if (!outEnvironments[parent->id].isDead) {
-                Environment tempEnv(methodLoc);
+                environmentMerges++;
+                Environment tempEnv(methodLoc, *cfg, trackOrigins);
                 auto &envAsSeenFromBranch =
                     Environment::withCond(ctx, outEnvironments[parent->id], tempEnv, isTrueBranch, current.vars);
                 current.populateFrom(ctx, envAsSeenFromBranch);
@@ -110,10 +119,11 @@ unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg)
                     continue;
                 }
                 bool isTrueBranch = parent->bexit.thenb == bb;
-                Environment tempEnv(methodLoc);
+                Environment tempEnv(methodLoc, *cfg, trackOrigins);
                 auto &envAsSeenFromBranch =
                     Environment::withCond(ctx, outEnvironments[parent->id], tempEnv, isTrueBranch, current.vars);
                 if (!envAsSeenFromBranch.isDead) {
+                    environmentMerges++;
                     current.isDead = false;
                     current.mergeWith(ctx, envAsSeenFromBranch, parent->bexit.loc, *cfg.get(), bb, knowledgeFilter);
                 }
@@ -121,6 +131,7 @@ unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg)
         }
 
         current.computePins(ctx, outEnvironments, *cfg.get(), bb);
+        deepestLoop = max(deepestLoop, bb->outerLoops);
 
         for (auto &uninitialized : current.vars) {
             if (uninitialized.second.typeAndOrigins.type.get() == nullptr) {
@@ -162,12 +173,15 @@ unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg)
             i++;
             if (!current.isDead) {
                 current.ensureGoodAssignTarget(ctx, bind.bind.variable);
-                bind.bind.type = current.processBinding(ctx, bind, bb->outerLoops, cfg->minLoops[bind.bind.variable],
-                                                        knowledgeFilter, *constr, methodReturnType);
+                auto bindMinLoops = cfg->minLoopsById[cfg->localVariableId(bind.bind.variable)];
+                bind.bind.type = hasQuery ? current.processBinding<true>(ctx, bind, bb->outerLoops, bindMinLoops,
+                                                                         knowledgeFilter, *constr, methodReturnType)
+                                          : current.processBinding<false>(ctx, bind, bb->outerLoops, bindMinLoops,
+                                                                          knowledgeFilter, *constr, methodReturnType);
                 if (cfg::isa_instruction<cfg::Send>(bind.value.get())) {
-                    totalSendCount++;
+                    sendCounts.total++;
                     if (bind.bind.type && !bind.bind.type->isUntyped()) {
-                        typedSendCount++;
+                        sendCounts.typed++;
                     } else if (bind.bind.type->hasUntyped()) {
                         DEBUG_ONLY(histogramInc("untyped.sources", bind.bind.type->untypedBlame()._id););
                         if (auto e = ctx.state.beginError(bind.loc, core::errors::Infer::UntypedValue)) {
@@ -209,10 +223,9 @@ unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg)
             histogramInc("infer.knowledge.falsy.no.size", k.falsy->noTypeTests.size());
         }
     }
-    if (startErrorCount == ctx.state.totalErrors()) {
-        counterInc("infer.methods_typechecked.no_errors");
-    }
-
+    prodHistogramInc("infer.method.blocks", cfg->basicBlocks.size());
+    prodHistogramInc("infer.method.environment_merges", environmentMerges);
+    prodHistogramInc("infer.method.loop_depth", deepestLoop);
     if ((missingReturnType || cfg->symbol.data(ctx)->hasGeneratedSig()) && guessTypes) {
         if (auto e = ctx.state.beginError(cfg->symbol.data(ctx)->loc(), core::errors::Infer::UntypedMethod)) {
             e.setHeader("This function does not have a `sig`");
@@ -220,8 +233,49 @@ unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg)
         }
     }
 
-    prodCounterAdd("types.input.sends.typed", typedSendCount);
-    prodCounterAdd("types.input.sends.total", totalSendCount);
+    return sendCounts;
+}
+
+void clearInferredTypes(cfg::CFG &cfg) {
+    for (auto &bb : cfg.basicBlocks) {
+        bb->firstDeadInstructionIdx = -1;
+        for (auto &arg : bb->args) {
+            arg.type = nullptr;
+        }
+        for (auto &bind : bb->exprs) {
+            bind.bind.type = nullptr;
+        }
+        bb->bexit.cond.type = nullptr;
+    }
+}
+} // namespace
+
+unique_ptr<cfg::CFG> Inference::run(core::Context ctx, unique_ptr<cfg::CFG> cfg) {
+    ENFORCE(cfg->symbol == ctx.owner);
+    prodCounterInc("types.input.methods.typechecked");
+    const int startErrorCount = ctx.state.totalErrors();
+    SendCounts sendCounts;
+    bool inferred = false;
+    if (ctx.state.lspQuery.isEmpty()) {
+        // Most methods report no errors, and origins are only needed to explain errors. So infer without collecting
+        // them first, and only if that would have reported something, infer again with origins to report it.
+        core::ErrorProbe probe;
+        sendCounts = inferTypes(ctx, cfg, false);
+        inferred = !probe.sawError;
+        if (!inferred) {
+            prodCounterInc("infer.methods_reinferred_with_origins");
+            clearInferredTypes(*cfg);
+        }
+    }
+    if (!inferred) {
+        sendCounts = inferTypes(ctx, cfg, true);
+    }
+
+    if (startErrorCount == ctx.state.totalErrors()) {
+        counterInc("infer.methods_typechecked.no_errors");
+    }
+    prodCounterAdd("types.input.sends.typed", sendCounts.typed);
+    prodCounterAdd("types.input.sends.total", sendCounts.total);
 
     return cfg;
 }
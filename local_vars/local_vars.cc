@@ -1,9 +1,11 @@
 #include "local_vars.h"
 #include "absl/strings/match.h"
 #include "ast/treemap/treemap.h"
+#include "ast/verifier/verifier.h"
 #include "common/typecase.h"
 #include "core/core.h"
 #include "core/errors/namer.h"
+#include "dsl/dsl.h"
 
 using namespace std;
 
@@ -184,7 +186,7 @@ class LocalNameInserter {
         return args;
     }
 
-    core::SymbolRef methodOwner(core::MutableContext ctx) {
+    core::SymbolRef methodOwner(core::Context ctx) {
         core::SymbolRef owner = ctx.owner.data(ctx)->enclosingClass(ctx);
         if (owner == core::Symbols::root()) {
             // Root methods end up going on object
@@ -285,4 +287,13 @@ ast::ParsedFile LocalVars::run(core::MutableContext ctx, ast::ParsedFile tree) {
     return tree;
 }
 
+ast::ParsedFile LocalVars::runWithDSL(core::MutableContext ctx, ast::ParsedFile tree) {
+    dsl::DSLWalk dslWalk;
+    LocalNameInserter localNameInserter;
+    ast::FusedTransform<dsl::DSLWalk, LocalNameInserter> fused(dslWalk, localNameInserter);
+    tree.tree = ast::TreeMap::apply(ctx, fused, move(tree.tree));
+    tree.tree = ast::Verifier::run(ctx, move(tree.tree));
+    return tree;
+}
+
 } // namespace sorbet::local_vars
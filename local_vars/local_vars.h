@@ -8,6 +8,8 @@ namespace sorbet::local_vars {
 class LocalVars final {
 public:
     static ast::ParsedFile run(core::MutableContext ctx, ast::ParsedFile tree);
+    // dsl::DSL::run followed by run, done in a single walk over the tree (see dsl::DSLWalk).
+    static ast::ParsedFile runWithDSL(core::MutableContext ctx, ast::ParsedFile tree);
 
     LocalVars() = delete;
 };
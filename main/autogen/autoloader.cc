@@ -1,7 +1,12 @@
 #include "main/autogen/autoloader.h"
+#include "absl/strings/escaping.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
 #include "common/FileOps.h"
 #include "common/Timer.h"
+#include "common/crypto_hashing/crypto_hashing.h"
 #include "core/GlobalState.h"
 #include "core/Names.h"
 
@@ -328,6 +333,23 @@ DefTree DefTreeBuilder::merge(core::Context ctx, DefTree lhs, DefTree rhs) {
     return lhs;
 }
 
+DefTree DefTreeBuilder::mergeAll(core::Context ctx, WorkerPool &workers, vector<DefTree> trees) {
+    if (trees.empty()) {
+        return DefTree();
+    }
+    // Each round merges tree 2i+1 into tree 2i, and then keeps the merged trees for the next round.
+    while (trees.size() > 1) {
+        workers.parallelFor("autogenDefTreeMerge", trees.size() / 2, [&ctx, &trees](size_t i) {
+            trees[2 * i] = merge(ctx, move(trees[2 * i]), move(trees[2 * i + 1]));
+        });
+        for (size_t i = 1; 2 * i < trees.size(); i++) {
+            trees[i] = move(trees[2 * i]);
+        }
+        trees.resize((trees.size() + 1) / 2);
+    }
+    return move(trees[0]);
+}
+
 void DefTreeBuilder::updateNonBehaviorDef(core::Context ctx, DefTree &node, NamedDefinition ndef) {
     if (!node.namedDefs.empty()) {
         // Non behavior-defining definitions do not matter for nodes that have behavior. There is no
@@ -358,32 +380,99 @@ void DefTreeBuilder::collapseSameFileDefs(core::Context ctx, const AutoloaderCon
     }
 }
 
-void AutoloadWriter::writeAutoloads(core::Context ctx, const AutoloaderConfig &alCfg, const std::string &path,
-                                    const DefTree &root) {
+namespace {
+// Not a .rb file, so that it is never mistaken for an autoloader file.
+constexpr string_view MANIFEST_FILE = ".autoloader-manifest";
+
+string contentHash(string_view contents) {
+    auto hash = crypto_hashing::hash16(contents);
+    return absl::BytesToHexString(string_view{(char *)hash.data(), hash.size()});
+}
+
+// The content hash of every file written by the last run, by its path relative to the output root. nullopt if there
+// is no manifest, or it can't be read.
+optional<UnorderedMap<string, string>> readManifest(const string &path) {
+    auto manifestPath = join(path, string(MANIFEST_FILE));
+    if (!FileOps::exists(manifestPath)) {
+        return nullopt;
+    }
+    UnorderedMap<string, string> manifest;
+    for (auto line : absl::StrSplit(FileOps::read(manifestPath), '\n', absl::SkipEmpty())) {
+        vector<string_view> fields = absl::StrSplit(line, absl::MaxSplits('\t', 1));
+        if (fields.size() != 2) {
+            return nullopt;
+        }
+        manifest[string(fields[1])] = string(fields[0]);
+    }
+    return manifest;
+}
+} // namespace
+
+void AutoloadWriter::writeAutoloads(core::Context ctx, WorkerPool &workers, const AutoloaderConfig &alCfg,
+                                    const std::string &path, const DefTree &root) {
+    // With a manifest of what the last run wrote, files whose contents did not change are neither read back nor
+    // written, and stale ones are found without listing the output directory.
+    auto previous = readManifest(path);
     UnorderedSet<string> toDelete; // Remove from this set as we write files
-    if (FileOps::exists(path)) {
+    if (previous.has_value()) {
+        for (const auto &[relativePath, _] : *previous) {
+            toDelete.insert(join(path, relativePath));
+        }
+    } else if (FileOps::exists(path)) {
         vector<string> existingFiles = FileOps::listFilesInDir(path, {".rb"}, true, {}, {});
         toDelete.insert(make_move_iterator(existingFiles.begin()), make_move_iterator(existingFiles.end()));
     }
-    write(ctx, alCfg, path, toDelete, root);
+    // The directories exist before any file is written, so that files don't depend on each other and can be
+    // rendered and written in parallel.
+    vector<pair<string, const DefTree *>> files;
+    createDirs(ctx, path, root, files);
+    vector<string> hashes(files.size());
+    workers.parallelFor("autogenAutoloaderWrite", files.size(), [&](size_t i) {
+        auto &[filePath, node] = files[i];
+        auto src = node->renderAutoloadSrc(ctx, alCfg);
+        hashes[i] = contentHash(src);
+        if (!previous.has_value()) {
+            FileOps::writeIfDifferent(filePath, src);
+            return;
+        }
+        auto fnd = previous->find(filePath.substr(path.size() + 1));
+        if (fnd != previous->end() && fnd->second == hashes[i] && FileOps::exists(filePath)) {
+            prodCounterInc("autogen.autoloader.unchanged");
+            return;
+        }
+        prodCounterInc("autogen.autoloader.written");
+        FileOps::write(filePath, src);
+    });
+    for (const auto &[filePath, _] : files) {
+        toDelete.erase(filePath);
+    }
     for (const auto &file : toDelete) {
-        FileOps::removeFile(file);
+        // A file of the manifest may have been deleted by hand since.
+        if (FileOps::exists(file)) {
+            FileOps::removeFile(file);
+        }
+    }
+
+    vector<string> manifest;
+    manifest.reserve(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        manifest.emplace_back(absl::StrCat(hashes[i], "\t", files[i].first.substr(path.size() + 1), "\n"));
     }
+    fast_sort(manifest);
+    FileOps::writeIfDifferent(join(path, string(MANIFEST_FILE)), absl::StrJoin(manifest, ""));
 }
 
-void AutoloadWriter::write(core::Context ctx, const AutoloaderConfig &alCfg, const std::string &path,
-                           UnorderedSet<std::string> &toDelete, const DefTree &node) {
+void AutoloadWriter::createDirs(core::Context ctx, const std::string &path, const DefTree &node,
+                                vector<pair<string, const DefTree *>> &files) {
     string name = node.root() ? "root" : node.name().show(ctx);
-    string filePath = join(path, fmt::format("{}.rb", name));
-    FileOps::writeIfDifferent(filePath, node.renderAutoloadSrc(ctx, alCfg));
-    toDelete.erase(filePath);
+    files.emplace_back(join(path, fmt::format("{}.rb", name)), &node);
     if (!node.children.empty()) {
         auto subdir = join(path, node.root() ? "" : name);
         if (!node.root() && !FileOps::dirExists(subdir)) {
             FileOps::createDir(subdir);
         }
         for (auto &[_, child] : node.children) {
-            write(ctx, alCfg, subdir, toDelete, *child);
+            createDirs(ctx, subdir, *child, files);
         }
     }
 }
@@ -1,6 +1,7 @@
 #ifndef AUTOGEN_AUTOLOADER_H
 #define AUTOGEN_AUTOLOADER_H
 #include "ast/ast.h"
+#include "common/concurrency/WorkerPool.h"
 #include "main/autogen/autogen.h"
 #include "main/options/options.h"
 #include <string_view>
@@ -101,6 +102,8 @@ public:
     static void addSingleDef(core::Context, const AutoloaderConfig &, std::unique_ptr<DefTree> &root, NamedDefinition);
 
     static DefTree merge(core::Context, DefTree lhs, DefTree rhs);
+    // Merges the trees pairwise, with the pairs of each round merged in parallel.
+    static DefTree mergeAll(core::Context, WorkerPool &workers, std::vector<DefTree> trees);
     static void collapseSameFileDefs(core::Context, const AutoloaderConfig &, DefTree &root);
 
 private:
@@ -109,12 +112,13 @@ private:
 
 class AutoloadWriter {
 public:
-    static void writeAutoloads(core::Context ctx, const AutoloaderConfig &, const std::string &path,
-                               const DefTree &root);
+    static void writeAutoloads(core::Context ctx, WorkerPool &workers, const AutoloaderConfig &,
+                               const std::string &path, const DefTree &root);
 
 private:
-    static void write(core::Context ctx, const AutoloaderConfig &, const std::string &path,
-                      UnorderedSet<std::string> &toDelete, const DefTree &node);
+    // Creates the directories of the tree, and lists the file that every node is written to.
+    static void createDirs(core::Context ctx, const std::string &path, const DefTree &node,
+                           std::vector<std::pair<std::string, const DefTree *>> &files);
 };
 
 } // namespace sorbet::autogen
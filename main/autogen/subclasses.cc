@@ -1,4 +1,7 @@
 #include "main/autogen/subclasses.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
 #include "common/FileOps.h"
 
 using namespace std;
@@ -67,26 +70,61 @@ optional<Subclasses::Map> Subclasses::listAllSubclasses(core::Context ctx, Parse
 }
 
 // Generate all descendants of a parent class
-// Recursively walks `childMap`, which stores the IMMEDIATE children of subclassed class.
+// Walks `childMap`, which stores the IMMEDIATE children of subclassed class. Every class is expanded once, however
+// many paths lead to it from `parentName`.
 optional<Subclasses::Entries> Subclasses::descendantsOf(const Subclasses::Map &childMap, const string &parentName) {
     auto fnd = childMap.find(parentName);
     if (fnd == childMap.end()) {
         return nullopt;
     }
-    const Subclasses::Entries children = fnd->second;
 
     Subclasses::Entries out;
-    out.insert(children.begin(), children.end());
-    for (const auto &[name, _type] : children) {
-        auto descendants = Subclasses::descendantsOf(childMap, name);
-        if (descendants) {
-            out.insert(descendants->begin(), descendants->end());
+    vector<const Subclasses::Entries *> worklist{&fnd->second};
+    while (!worklist.empty()) {
+        const auto *children = worklist.back();
+        worklist.pop_back();
+        for (const auto &child : *children) {
+            if (!out.insert(child).second) {
+                continue;
+            }
+            auto childFnd = childMap.find(child.first);
+            if (childFnd != childMap.end()) {
+                worklist.emplace_back(&childFnd->second);
+            }
         }
     }
 
     return out;
 }
 
+string Subclasses::serializeEntries(const Subclasses::Map &childMap) {
+    // Starts with a header, so that a file without any subclasses is not mistaken for a missing cache entry.
+    string out = "subclasses\n";
+    for (const auto &[parentName, children] : childMap) {
+        for (const auto &[name, type] : children) {
+            absl::StrAppend(&out, parentName, "\t", name, "\t", (int)type, "\n");
+        }
+    }
+    return out;
+}
+
+optional<Subclasses::Map> Subclasses::deserializeEntries(string_view serialized) {
+    vector<string_view> lines = absl::StrSplit(serialized, '\n', absl::SkipEmpty());
+    if (lines.empty() || lines[0] != "subclasses") {
+        return nullopt;
+    }
+    Subclasses::Map out;
+    for (auto it = lines.begin() + 1; it != lines.end(); ++it) {
+        vector<string_view> fields = absl::StrSplit(*it, '\t');
+        int type;
+        if (fields.size() != 3 || !absl::SimpleAtoi(fields[2], &type)) {
+            return nullopt;
+        }
+        out[string(fields[0])].insert(make_pair(string(fields[1]), (Definition::Type)type));
+    }
+    return out;
+}
+
 // Manually patch the child map to account for inheritance that happens at runtime `self.included`
 // Please do not add to this list.
 void Subclasses::patchChildMap(Subclasses::Map &childMap) {
@@ -150,11 +188,8 @@ vector<string> Subclasses::genDescendantsMap(Subclasses::Map &childMap, vector<s
         }
 
         auto descendants = Subclasses::descendantsOf(childMap, parentName);
-        if (!descendants) {
-            descendantsMap[parentName];
-        }
-
-        descendantsMap.emplace(parentName, *descendants);
+        ENFORCE(descendants.has_value());
+        descendantsMap.emplace(parentName, std::move(*descendants));
     }
 
     return Subclasses::serializeSubclassMap(descendantsMap, parentNames);
@@ -15,6 +15,10 @@ public:
                                                             const std::vector<std::string> &absoluteIgnorePatterns,
                                                             const std::vector<std::string> &relativeIgnorePatterns);
     static std::vector<std::string> genDescendantsMap(Subclasses::Map &childMap, std::vector<std::string> &parentNames);
+    // What listAllSubclasses found in a file, in the form autogen caches it in, and back. nullopt if `serialized`
+    // is not in that form.
+    static std::string serializeEntries(const Subclasses::Map &childMap);
+    static std::optional<Subclasses::Map> deserializeEntries(std::string_view serialized);
 
 private:
     static void patchChildMap(Subclasses::Map &childMap);
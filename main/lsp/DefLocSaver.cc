@@ -6,51 +6,51 @@
 using namespace std;
 namespace sorbet::realmain::lsp {
 
-unique_ptr<ast::MethodDef> DefLocSaver::postTransformMethodDef(core::Context ctx,
-                                                               unique_ptr<ast::MethodDef> methodDef) {
+void DefLocSaver::postWalkMethodDef(core::Context ctx, const ast::MethodDef &methodDef) {
     const core::lsp::Query &lspQuery = ctx.state.lspQuery;
-    bool lspQueryMatch = lspQuery.matchesLoc(methodDef->declLoc) || lspQuery.matchesSymbol(methodDef->symbol);
+    bool lspQueryMatch = lspQuery.matchesLoc(methodDef.declLoc) || lspQuery.matchesSymbol(methodDef.symbol);
 
     if (lspQueryMatch) {
         // Query matches against the method definition as a whole.
-        auto &symbolData = methodDef->symbol.data(ctx);
+        auto &symbolData = methodDef.symbol.data(ctx);
         auto &argTypes = symbolData->arguments();
         core::TypeAndOrigins tp;
 
         // Check if it matches against a specific argument. If it does, send that instead;
         // it's more specific.
-        const int numArgs = methodDef->args.size();
+        const int numArgs = methodDef.args.size();
 
         ENFORCE(numArgs == argTypes.size());
         for (int i = 0; i < numArgs; i++) {
-            auto &arg = methodDef->args[i];
+            auto &arg = methodDef.args[i];
             auto &argType = argTypes[i];
             auto *localExp = ast::MK::arg2Local(arg.get());
             // localExp should never be null, but guard against the possibility.
             if (localExp && lspQuery.matchesLoc(localExp->loc)) {
-                tp.type = argType.type;
-                tp.origins.emplace_back(localExp->loc);
+                core::TypeAndOrigins argTp;
+                argTp.type = argType.type;
+                argTp.origins.emplace_back(localExp->loc);
                 core::lsp::QueryResponse::pushQueryResponse(
-                    ctx, core::lsp::IdentResponse(methodDef->symbol, localExp->loc, localExp->localVariable, tp));
-                return methodDef;
+                    ctx, core::lsp::IdentResponse(methodDef.symbol, localExp->loc, localExp->localVariable, argTp));
+                // An EVERY_LOC query wants the definition as well; it sorts after the argument, being longer.
+                if (lspQuery.kind != core::lsp::Query::Kind::EVERY_LOC) {
+                    return;
+                }
             }
         }
 
         tp.type = symbolData->resultType;
-        tp.origins.emplace_back(methodDef->declLoc);
+        tp.origins.emplace_back(methodDef.declLoc);
         core::lsp::QueryResponse::pushQueryResponse(
-            ctx, core::lsp::DefinitionResponse(methodDef->symbol, methodDef->declLoc, methodDef->name, tp));
+            ctx, core::lsp::DefinitionResponse(methodDef.symbol, methodDef.declLoc, methodDef.name, tp));
     }
-
-    return methodDef;
 }
 
-unique_ptr<ast::UnresolvedIdent> DefLocSaver::postTransformUnresolvedIdent(core::Context ctx,
-                                                                           unique_ptr<ast::UnresolvedIdent> id) {
-    if (id->kind == ast::UnresolvedIdent::Instance || id->kind == ast::UnresolvedIdent::Class) {
+void DefLocSaver::postWalkUnresolvedIdent(core::Context ctx, const ast::UnresolvedIdent &id) {
+    if (id.kind == ast::UnresolvedIdent::Instance || id.kind == ast::UnresolvedIdent::Class) {
         core::SymbolRef klass;
         // Logic cargo culted from `global2Local` in `walker_build.cc`.
-        if (id->kind == ast::UnresolvedIdent::Instance) {
+        if (id.kind == ast::UnresolvedIdent::Instance) {
             ENFORCE(ctx.owner.data(ctx)->isMethod());
             klass = ctx.owner.data(ctx)->owner;
         } else {
@@ -61,20 +61,20 @@ unique_ptr<ast::UnresolvedIdent> DefLocSaver::postTransformUnresolvedIdent(core:
             }
         }
 
-        auto sym = klass.data(ctx)->findMemberTransitive(ctx, id->name);
+        auto sym = klass.data(ctx)->findMemberTransitive(ctx, id.name);
         const core::lsp::Query &lspQuery = ctx.state.lspQuery;
-        if (sym.exists() && (lspQuery.matchesSymbol(sym) || lspQuery.matchesLoc(id->loc))) {
+        if (sym.exists() && (lspQuery.matchesSymbol(sym) || lspQuery.matchesLoc(id.loc))) {
             core::TypeAndOrigins tp;
             tp.type = sym.data(ctx.state)->resultType;
             tp.origins.emplace_back(sym.data(ctx.state)->loc());
             core::lsp::QueryResponse::pushQueryResponse(
-                ctx, core::lsp::ConstantResponse(klass, sym, id->loc, id->name, tp, tp));
+                ctx, core::lsp::ConstantResponse(klass, sym, id.loc, id.name, tp, tp));
         }
     }
-    return id;
 }
 
-void matchesQuery(core::Context ctx, ast::ConstantLit *lit, const core::lsp::Query &lspQuery, core::SymbolRef symbol) {
+void matchesQuery(core::Context ctx, const ast::ConstantLit *lit, const core::lsp::Query &lspQuery,
+                  core::SymbolRef symbol) {
     // Iterate. Ensures that we match "Foo" in "Foo::Bar" references.
     while (lit && symbol.exists() && lit->original) {
         if (lspQuery.matchesLoc(lit->loc) || lspQuery.matchesSymbol(symbol)) {
@@ -92,12 +92,10 @@ void matchesQuery(core::Context ctx, ast::ConstantLit *lit, const core::lsp::Que
     }
 }
 
-unique_ptr<ast::ConstantLit> DefLocSaver::postTransformConstantLit(core::Context ctx,
-                                                                   unique_ptr<ast::ConstantLit> lit) {
+void DefLocSaver::postWalkConstantLit(core::Context ctx, const ast::ConstantLit &lit) {
     const core::lsp::Query &lspQuery = ctx.state.lspQuery;
-    auto symbol = lit->symbol.data(ctx)->dealias(ctx);
-    matchesQuery(ctx, lit.get(), lspQuery, symbol);
-    return lit;
+    auto symbol = lit.symbol.data(ctx)->dealias(ctx);
+    matchesQuery(ctx, &lit, lspQuery, symbol);
 }
 
 } // namespace sorbet::realmain::lsp
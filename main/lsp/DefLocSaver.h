@@ -7,14 +7,11 @@ namespace sorbet::realmain::lsp {
 class DefLocSaver {
 public:
     // Handles loc and symbol requests for method definitions.
-    std::unique_ptr<ast::MethodDef> postTransformMethodDef(core::Context ctx,
-                                                           std::unique_ptr<ast::MethodDef> methodDef);
+    void postWalkMethodDef(core::Context ctx, const ast::MethodDef &methodDef);
     // Handles loc and symbol requests for instance variables.
-    std::unique_ptr<ast::UnresolvedIdent> postTransformUnresolvedIdent(core::Context ctx,
-                                                                       std::unique_ptr<ast::UnresolvedIdent> id);
+    void postWalkUnresolvedIdent(core::Context ctx, const ast::UnresolvedIdent &id);
 
     // Handles loc and symbol requests for constants.
-    std::unique_ptr<ast::ConstantLit> postTransformConstantLit(core::Context ctx,
-                                                               std::unique_ptr<ast::ConstantLit> lit);
+    void postWalkConstantLit(core::Context ctx, const ast::ConstantLit &lit);
 };
 }; // namespace sorbet::realmain::lsp
@@ -58,7 +58,10 @@ unique_ptr<LSPMessage> makeSorbetError(LSPErrorCodes code, string_view message,
 unique_ptr<LSPMessage> LSPMessage::fromClient(const string &json) {
     rapidjson::MemoryPoolAllocator<> alloc;
     rapidjson::Document d(&alloc);
-    if (d.Parse(json.c_str()).HasParseError()) {
+    // Parsing in place decodes strings into `buffer` rather than copying them into `alloc`, which matters for the
+    // file contents in didOpen and didChange. `d` refers into `buffer`, so it must outlive the conversion below.
+    string buffer = json;
+    if (d.ParseInsitu(buffer.data()).HasParseError()) {
         return makeSorbetError(LSPErrorCodes::ParseError,
                                fmt::format("Last LSP request: `{}` is not a valid json object", json));
     }
@@ -103,7 +106,9 @@ LSPMessage::RawLSPMessage fromJSONValue(rapidjson::Document &d) {
 LSPMessage::RawLSPMessage fromJSON(const std::string &json) {
     rapidjson::MemoryPoolAllocator<> alloc;
     rapidjson::Document d(&alloc);
-    d.Parse(json.c_str());
+    // See fromClient.
+    string buffer = json;
+    d.ParseInsitu(buffer.data());
     return fromJSONValue(d);
 }
 
@@ -143,6 +148,7 @@ bool LSPMessage::isDelayable() const {
         // These requests involve a specific file location, and should never be delayed.
         case LSPMethod::TextDocumentHover:
         case LSPMethod::TextDocumentCompletion:
+        case LSPMethod::CompletionItemResolve:
         case LSPMethod::TextDocumentSignatureHelp:
         // These are file updates. They shouldn't be delayed (but they can be combined/expedited).
         case LSPMethod::TextDocumentDidOpen:
@@ -153,6 +159,12 @@ bool LSPMessage::isDelayable() const {
             return false;
         // VS Code requests document symbols automatically and in the background. It's OK to delay these requests.
         case LSPMethod::TextDocumentDocumentSymbol:
+        // Performance and memory reports are for ad-hoc inspection, and are more useful after pending edits have been
+        // processed.
+        case LSPMethod::SorbetPerfReport:
+        case LSPMethod::SorbetMemoryReport:
+        // The daemon's errors are only as fresh as the edits processed before the request, so let edits merge past it.
+        case LSPMethod::SorbetDaemonTypecheck:
         // Sorbet processes these requests before they hit the server's queue.
         case LSPMethod::$CancelRequest:
         // Sorbet produces SorbetErrors for a variety of common things, including when it receives a message type it
@@ -62,6 +62,18 @@ public:
      * this one. */
     std::vector<std::unique_ptr<Timer>> timers;
 
+    /**
+     * When this message reached each phase of processing, used to break its latency down. A message produced by
+     * merging keeps the enqueue time of the oldest message merged into it.
+     */
+    struct Timeline {
+        std::chrono::steady_clock::time_point enqueued;
+        std::chrono::steady_clock::time_point dequeued;
+        std::chrono::steady_clock::time_point processed;
+        std::chrono::steady_clock::time_point sent;
+    };
+    Timeline timeline;
+
     /** Request counter. */
     int counter;
 
@@ -0,0 +1,167 @@
+#include "main/lsp/SymbolNameIndex.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include <functional>
+
+using namespace std;
+
+namespace sorbet::realmain::lsp {
+
+namespace {
+u4 trigramAt(string_view str, size_t pos) {
+    return ((u4)(unsigned char)str[pos] << 16) | ((u4)(unsigned char)str[pos + 1] << 8) | (u4)(unsigned char)str[pos + 2];
+}
+
+string_view stripRoot(string_view fullName) {
+    if (absl::StartsWith(fullName, "::")) {
+        fullName.remove_prefix(2);
+    }
+    return fullName;
+}
+} // namespace
+
+SymbolNameIndex::SymbolNameIndex(const core::GlobalState &gs) : symbolsIndexed(gs.symbolsUsed()) {
+    UnorderedMap<string_view, u4> nameIds;
+    for (u4 idx = 1; idx < gs.symbolsUsed(); idx++) {
+        core::SymbolRef ref(gs, idx);
+        auto shortName = ref.data(gs)->name.data(gs)->shortName(gs);
+        auto [it, inserted] = nameIds.try_emplace(shortName, names.size());
+        if (inserted) {
+            names.emplace_back(shortName);
+            symbolsByName.emplace_back();
+        }
+        symbolsByName[it->second].emplace_back(ref);
+    }
+
+    for (u4 nameId = 0; nameId < names.size(); nameId++) {
+        const auto &name = names[nameId];
+        for (size_t pos = 0; pos + 3 <= name.size(); pos++) {
+            auto &posting = namesByTrigram[trigramAt(name, pos)];
+            // A name that repeats a trigram only gets listed once.
+            if (posting.empty() || posting.back() != nameId) {
+                posting.emplace_back(nameId);
+            }
+        }
+    }
+
+    // Owners are usually entered before what they own, so the owner's name is almost always already known. Constants
+    // nested in something that is not named like one (a singleton class, a method) are left out.
+    UnorderedMap<u4, optional<u4>> entryOf;
+    function<optional<u4>(core::SymbolRef)> fullNameOf = [&](core::SymbolRef ref) -> optional<u4> {
+        auto fnd = entryOf.find(ref._id);
+        if (fnd != entryOf.end()) {
+            return fnd->second;
+        }
+        auto sym = ref.data(gs);
+        optional<u4> entry;
+        bool isConstant = (sym->isClass() && !sym->isSingletonClass(gs)) || sym->isStaticField() || sym->isTypeMember();
+        if (isConstant) {
+            if (sym->owner == core::Symbols::root()) {
+                entry = fullNames.size();
+                fullNames.emplace_back(sym->name.show(gs), ref);
+            } else if (auto ownerEntry = fullNameOf(sym->owner)) {
+                entry = fullNames.size();
+                fullNames.emplace_back(absl::StrCat(fullNames[*ownerEntry].first, "::", sym->name.show(gs)), ref);
+            }
+        }
+        entryOf[ref._id] = entry;
+        return entry;
+    };
+    for (u4 idx = 1; idx < gs.symbolsUsed(); idx++) {
+        core::SymbolRef ref(gs, idx);
+        if (ref != core::Symbols::root()) {
+            fullNameOf(ref);
+        }
+    }
+    fast_sort(fullNames, [](const auto &a, const auto &b) -> bool {
+        if (a.first != b.first) {
+            return a.first < b.first;
+        }
+        return a.second._id < b.second._id;
+    });
+    symbolsByFullName.reserve(fullNames.size());
+    for (const auto &[fullName, ref] : fullNames) {
+        // A constant and a class can share a name; the first one entered wins, as it does for findMember.
+        symbolsByFullName.try_emplace(fullName, ref);
+    }
+}
+
+bool SymbolNameIndex::isUpToDate(const core::GlobalState &gs) const {
+    return symbolsIndexed == gs.symbolsUsed();
+}
+
+vector<core::SymbolRef> SymbolNameIndex::search(string_view pattern) const {
+    vector<u4> candidates;
+    if (pattern.size() < 3) {
+        candidates.resize(names.size());
+        for (u4 nameId = 0; nameId < names.size(); nameId++) {
+            candidates[nameId] = nameId;
+        }
+    } else {
+        vector<const vector<u4> *> postings;
+        for (size_t pos = 0; pos + 3 <= pattern.size(); pos++) {
+            auto fnd = namesByTrigram.find(trigramAt(pattern, pos));
+            if (fnd == namesByTrigram.end()) {
+                return {};
+            }
+            postings.emplace_back(&fnd->second);
+        }
+        // Intersecting from the rarest trigram up keeps every intermediate result small.
+        fast_sort(postings, [](const auto *a, const auto *b) -> bool { return a->size() < b->size(); });
+        candidates = *postings[0];
+        for (size_t i = 1; i < postings.size() && !candidates.empty(); i++) {
+            vector<u4> intersection;
+            std::set_intersection(candidates.begin(), candidates.end(), postings[i]->begin(), postings[i]->end(),
+                                  std::back_inserter(intersection));
+            candidates = move(intersection);
+        }
+    }
+
+    // Sharing the trigrams does not make the pattern a substring, so check each candidate.
+    vector<pair<int, u4>> matches;
+    for (auto nameId : candidates) {
+        auto fnd = names[nameId].find(pattern);
+        if (fnd == string::npos) {
+            continue;
+        }
+        int rank = names[nameId].size() == pattern.size() ? 0 : fnd == 0 ? 1 : 2;
+        matches.emplace_back(rank, nameId);
+    }
+    fast_sort(matches, [&](const auto &a, const auto &b) -> bool {
+        if (a.first != b.first) {
+            return a.first < b.first;
+        }
+        if (names[a.second].size() != names[b.second].size()) {
+            return names[a.second].size() < names[b.second].size();
+        }
+        return a.second < b.second;
+    });
+
+    vector<core::SymbolRef> result;
+    for (auto &match : matches) {
+        const auto &symbols = symbolsByName[match.second];
+        result.insert(result.end(), symbols.begin(), symbols.end());
+    }
+    return result;
+}
+
+core::SymbolRef SymbolNameIndex::findByFullName(string_view fullName) const {
+    auto fnd = symbolsByFullName.find(stripRoot(fullName));
+    if (fnd == symbolsByFullName.end()) {
+        return core::SymbolRef();
+    }
+    return fnd->second;
+}
+
+vector<core::SymbolRef> SymbolNameIndex::searchFullName(string_view prefix) const {
+    prefix = stripRoot(prefix);
+    vector<core::SymbolRef> result;
+    auto it = std::lower_bound(fullNames.begin(), fullNames.end(), prefix,
+                               [](const auto &entry, string_view prefix) -> bool { return entry.first < prefix; });
+    for (; it != fullNames.end() && absl::StartsWith(it->first, prefix); ++it) {
+        result.emplace_back(it->second);
+    }
+    return result;
+}
+
+} // namespace sorbet::realmain::lsp
@@ -0,0 +1,59 @@
+#ifndef RUBY_TYPER_LSP_SYMBOLNAMEINDEX_H
+#define RUBY_TYPER_LSP_SYMBOLNAMEINDEX_H
+
+#include "common/common.h"
+#include "core/core.h"
+
+namespace sorbet::realmain::lsp {
+
+/**
+ * Indexes the short names of every symbol for workspace/symbol. A search finds the symbols whose name contains the
+ * pattern, as hasSimilarName does. Only the names that share every trigram of the pattern are checked.
+ *
+ * It also indexes the fully-qualified names of every constant (`A::B::C`), so that a path resolves to its symbol in one
+ * lookup instead of a findMember per segment, and everything under a namespace is one contiguous range.
+ *
+ * The index holds SymbolRefs, so it is only valid for the symbol table it was built from; see `isUpToDate`.
+ */
+class SymbolNameIndex final {
+    // The distinct short names, and the symbols that have each of them.
+    std::vector<std::string> names;
+    std::vector<std::vector<core::SymbolRef>> symbolsByName;
+    // For each trigram, the indices into `names` of the names that contain it, in increasing order.
+    UnorderedMap<u4, std::vector<u4>> namesByTrigram;
+    // The fully-qualified names of constants in sorted order, and the same names hashed. The keys of
+    // `symbolsByFullName` point into `fullNames`, which is why the index can be moved but not copied.
+    std::vector<std::pair<std::string, core::SymbolRef>> fullNames;
+    UnorderedMap<std::string_view, core::SymbolRef> symbolsByFullName;
+    u4 symbolsIndexed = 0;
+
+public:
+    SymbolNameIndex() = default;
+    explicit SymbolNameIndex(const core::GlobalState &gs);
+    SymbolNameIndex(SymbolNameIndex &&) = default;
+    SymbolNameIndex &operator=(SymbolNameIndex &&) = default;
+    SymbolNameIndex(const SymbolNameIndex &) = delete;
+    SymbolNameIndex &operator=(const SymbolNameIndex &) = delete;
+
+    /** False if `gs` has symbols this index has not seen. */
+    bool isUpToDate(const core::GlobalState &gs) const;
+
+    /**
+     * Returns the symbols whose name contains `pattern`. Exact matches come first, then prefix matches, then the
+     * rest. Within each group, shorter names come first.
+     */
+    std::vector<core::SymbolRef> search(std::string_view pattern) const;
+
+    /** Returns the constant named `fullName` (`A::B`, with or without a leading `::`), or a non-existent ref. */
+    core::SymbolRef findByFullName(std::string_view fullName) const;
+
+    /**
+     * Returns the constants whose fully-qualified name starts with `prefix`, in name order, so `A::` lists everything
+     * nested in `A`. The constant named exactly `prefix`, if any, comes first.
+     */
+    std::vector<core::SymbolRef> searchFullName(std::string_view prefix) const;
+};
+
+} // namespace sorbet::realmain::lsp
+
+#endif // RUBY_TYPER_LSP_SYMBOLNAMEINDEX_H
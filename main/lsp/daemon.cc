@@ -0,0 +1,209 @@
+#include "absl/strings/str_cat.h"
+#include "common/FileOps.h"
+#include "core/ErrorFlusher.h"
+#include "main/lsp/lsp.h"
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace sorbet::realmain::lsp {
+
+namespace {
+// How long the daemon waits for a client that connected to send its request, in getNewRequest timeouts.
+constexpr int MAX_REQUEST_READ_ATTEMPTS = 50;
+
+bool daemonAddress(const string &path, sockaddr_un &addr) {
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.data(), path.size());
+    return true;
+}
+
+// Returns the request sent on `fd`, or nullptr if the client went away or did not send a sorbet/daemonTypecheck.
+unique_ptr<LSPMessage> readDaemonRequest(const shared_ptr<spd::logger> &logger, int fd) {
+    string buffer;
+    unique_ptr<LSPMessage> msg;
+    try {
+        for (int i = 0; i < MAX_REQUEST_READ_ATTEMPTS && msg == nullptr; i++) {
+            msg = getNewRequest(logger, fd, buffer);
+        }
+    } catch (FileReadException e) {
+        return nullptr;
+    }
+    if (msg == nullptr || !msg->isRequest() || msg->method() != LSPMethod::SorbetDaemonTypecheck) {
+        logger->debug("Ignoring a daemon client that did not send a sorbet/daemonTypecheck request.");
+        return nullptr;
+    }
+    return msg;
+}
+
+bool writeAll(int fd, string_view data) {
+    while (!data.empty()) {
+        // MSG_NOSIGNAL, so that a client that gave up does not take the daemon down with SIGPIPE.
+        auto written = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written <= 0) {
+            return false;
+        }
+        data.remove_prefix(written);
+    }
+    return true;
+}
+
+unique_ptr<LSPMessage> makeInitializeRequest(const options::Options &opts) {
+    const auto &rootPath = opts.rawInputDirNames.at(0);
+    auto initializeParams =
+        make_unique<InitializeParams>(rootPath, absl::StrCat("file://", rootPath), make_unique<ClientCapabilities>());
+    return make_unique<LSPMessage>(
+        make_unique<RequestMessage>("2.0", 0, LSPMethod::Initialize, move(initializeParams)));
+}
+} // namespace
+
+void LSPLoop::acceptDaemonClients(const shared_ptr<spd::logger> &logger, const options::Options &opts,
+                                  LSPLoop::QueueState &state, absl::Mutex &mtx, absl::Mutex &clientsMutex,
+                                  UnorderedMap<int, int> &clients) {
+    const auto &path = opts.daemonSocket;
+    sockaddr_un addr;
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || !daemonAddress(path, addr) || (unlink(path.c_str()) != 0 && errno != ENOENT) ||
+        ::bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+        logger->error("Could not listen on --daemon-socket `{}`: {}", path, strerror(errno));
+        absl::MutexLock lck(&mtx); // guards state
+        if (!state.terminate) {
+            state.terminate = true;
+            state.errorCode = 1;
+        }
+        return;
+    }
+    logger->debug("Sorbet daemon listening on `{}`", path);
+
+    {
+        // The daemon is its own editor: it initializes itself, so that the first slow path starts right away.
+        absl::MutexLock lck(&mtx); // guards state
+        enqueueRequest(logger, state, makeInitializeRequest(opts), true);
+        enqueueRequest(logger, state,
+                       make_unique<LSPMessage>(make_unique<NotificationMessage>("2.0", LSPMethod::Initialized,
+                                                                                make_unique<InitializedParams>())),
+                       true);
+    }
+
+    int nextId = 1;
+    while (true) {
+        {
+            absl::MutexLock lck(&mtx); // guards state
+            if (state.terminate) {
+                break;
+            }
+        }
+        pollfd pending{listenFd, POLLIN, 0};
+        if (poll(&pending, 1, 100) <= 0) {
+            continue;
+        }
+        int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) {
+            continue;
+        }
+        auto msg = readDaemonRequest(logger, clientFd);
+        if (msg == nullptr) {
+            close(clientFd);
+            continue;
+        }
+        // Clients all number their requests the same way, so the daemon numbers them again.
+        int id = nextId++;
+        msg->asRequest().id = id;
+        {
+            absl::MutexLock lck(&clientsMutex);
+            clients[id] = clientFd;
+        }
+        absl::MutexLock lck(&mtx); // guards state
+        enqueueRequest(logger, state, move(msg), true);
+    }
+    close(listenFd);
+    unlink(path.c_str());
+}
+
+void LSPLoop::replyToDaemonClient(const LSPMessage &msg) {
+    if (!msg.isResponse()) {
+        return;
+    }
+    auto id = get_if<int>(&msg.asResponse().id);
+    if (id == nullptr) {
+        return;
+    }
+    int clientFd;
+    {
+        absl::MutexLock lck(&daemonClientsMutex);
+        auto client = daemonClients.find(*id);
+        if (client == daemonClients.end()) {
+            // e.g. the response to the daemon's own initialize request.
+            return;
+        }
+        clientFd = client->second;
+        daemonClients.erase(client);
+    }
+    auto json = msg.toJSON();
+    logger->debug("Write to daemon client: {}\n", json);
+    if (!writeAll(clientFd, fmt::format("Content-Length: {}\r\n\r\n{}", json.length(), json))) {
+        logger->debug("Daemon client went away before its errors were ready.");
+    }
+    close(clientFd);
+}
+
+optional<int> printDaemonErrors(const options::Options &opts, const shared_ptr<spd::logger> &logger,
+                                spdlog::logger &typeErrorsConsole) {
+    sockaddr_un addr;
+    if (!daemonAddress(opts.daemonSocket, addr)) {
+        logger->debug("--daemon-socket `{}` is too long; typechecking instead.", opts.daemonSocket);
+        return nullopt;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        logger->debug("No Sorbet daemon is listening on `{}`; typechecking instead.", opts.daemonSocket);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return nullopt;
+    }
+
+    auto json = LSPMessage(make_unique<RequestMessage>("2.0", 0, LSPMethod::SorbetDaemonTypecheck, JSONNullObject()))
+                    .toJSON();
+    unique_ptr<LSPMessage> response;
+    if (writeAll(fd, fmt::format("Content-Length: {}\r\n\r\n{}", json.length(), json))) {
+        string buffer;
+        try {
+            // The daemon answers once it has caught up with every edit it knows about, which may take a slow path.
+            while (response == nullptr) {
+                response = getNewRequest(logger, fd, buffer);
+            }
+        } catch (FileReadException e) {
+            response = nullptr;
+        }
+    }
+    close(fd);
+
+    if (response == nullptr || !response->isResponse() ||
+        response->asResponse().requestMethod != LSPMethod::SorbetDaemonTypecheck || !response->asResponse().result) {
+        logger->debug("The Sorbet daemon on `{}` did not answer; typechecking instead.", opts.daemonSocket);
+        return nullopt;
+    }
+    auto &result = get<unique_ptr<SorbetDaemonTypecheckResult>>(*response->asResponse().result);
+    // Printed the way ErrorFlusher::flushErrors prints them.
+    bool printedAtLeastOneError = false;
+    for (auto &error : result->errors) {
+        typeErrorsConsole.log(error->critical ? spdlog::level::critical : spdlog::level::err,
+                              printedAtLeastOneError ? "\n{}" : "{}", error->text);
+        printedAtLeastOneError = true;
+    }
+    int count = result->errors.size();
+    core::ErrorFlusher::flushErrorCount(typeErrorsConsole, count);
+    return count;
+}
+
+} // namespace sorbet::realmain::lsp
@@ -13,7 +13,7 @@ string stringify(const rapidjson::Value &value) {
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
     value.Accept(writer);
-    return buffer.GetString();
+    return string(buffer.GetString(), buffer.GetSize());
 }
 
 DeserializationError::DeserializationError(string_view message)
@@ -85,7 +85,7 @@ string JSONBaseType::toJSON() const {
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
     v->Accept(writer);
-    return buffer.GetString();
+    return string(buffer.GetString(), buffer.GetSize());
 }
 
 } // namespace sorbet::realmain::lsp
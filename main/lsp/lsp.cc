@@ -6,6 +6,7 @@
 #include "core/errors/internal.h"
 #include "core/errors/namer.h"
 #include "core/errors/resolver.h"
+#include "core/lsp/QueryResponse.h"
 
 using namespace std;
 
@@ -13,9 +14,9 @@ namespace sorbet::realmain::lsp {
 
 LSPLoop::LSPLoop(unique_ptr<core::GlobalState> gs, const options::Options &opts, const shared_ptr<spd::logger> &logger,
                  WorkerPool &workers, int inputFd, std::ostream &outputStream, bool skipConfigatron,
-                 bool disableFastPath)
-    : initialGS(std::move(gs)), opts(opts), logger(logger), workers(workers), inputFd(inputFd),
-      outputStream(outputStream), skipConfigatron(skipConfigatron), disableFastPath(disableFastPath),
+                 bool disableFastPath, unique_ptr<KeyValueStore> kvstore)
+    : initialGS(std::move(gs)), opts(opts), kvstore(std::move(kvstore)), logger(logger), workers(workers),
+      inputFd(inputFd), outputStream(outputStream), skipConfigatron(skipConfigatron), disableFastPath(disableFastPath),
       lastMetricUpdateTime(chrono::steady_clock::now()) {
     errorQueue = dynamic_pointer_cast<core::ErrorQueue>(initialGS->errorQueue);
     ENFORCE(errorQueue, "LSPLoop got an unexpected error queue");
@@ -27,6 +28,7 @@ LSPLoop::LSPLoop(unique_ptr<core::GlobalState> gs, const options::Options &opts,
         throw options::EarlyReturnWithCode(1);
     }
     rootPath = opts.rawInputDirNames.at(0);
+    namesBeforeIndexing = initialGS->namesUsed();
 }
 
 LSPLoop::TypecheckRun LSPLoop::runLSPQuery(unique_ptr<core::GlobalState> gs, const core::lsp::Query &q,
@@ -69,13 +71,51 @@ LSPLoop::setupLSPQueryByLoc(unique_ptr<core::GlobalState> gs, string_view uri, c
                          move(gs));
     }
 
+    if (forMethod == LSPMethod::TextDocumentHover || forMethod == LSPMethod::TextDocumentDefinition) {
+        return runLSPQueryFromIndex(move(gs), *loc.get());
+    }
     return runLSPQuery(move(gs), core::lsp::Query::createLocQuery(*loc.get()), {fref});
 }
 
-LSPLoop::TypecheckRun LSPLoop::setupLSPQueryBySymbol(unique_ptr<core::GlobalState> gs, core::SymbolRef sym) {
-    Timer timeit(logger, "setupLSPQueryBySymbol");
+LSPLoop::TypecheckRun LSPLoop::runLSPQueryFromIndex(unique_ptr<core::GlobalState> gs, core::Loc loc) {
+    auto fref = loc.file();
+    vector<unique_ptr<core::Error>> errors;
+    auto fnd = responsesByFile.find(fref.id());
+    if (fnd == responsesByFile.end()) {
+        auto run = runLSPQuery(move(gs), core::lsp::Query::createEveryLocQuery(), {fref});
+        gs = move(run.gs);
+        errors = move(run.errors);
+        // A slow path answers for every file, but only this one's responses are ours to keep.
+        vector<unique_ptr<core::lsp::QueryResponse>> responses;
+        for (auto &resp : run.responses) {
+            if (resp->getLoc().file() == fref) {
+                responses.emplace_back(move(resp));
+            }
+        }
+        fnd = responsesByFile.emplace(fref.id(), move(responses)).first;
+    }
+
+    // The responses are already sorted most precise first, so the matching ones come out as a LOC query would
+    // have returned them.
+    auto query = core::lsp::Query::createLocQuery(loc);
+    vector<unique_ptr<core::lsp::QueryResponse>> responses;
+    for (auto &resp : fnd->second) {
+        if (query.matchesLoc(resp->getLoc())) {
+            responses.emplace_back(make_unique<core::lsp::QueryResponse>(*resp));
+        }
+    }
+    return TypecheckRun{move(errors), {fref}, move(responses), move(gs), true};
+}
+
+// How many files findReferencesBySymbol indexes between looks at the queue for edits.
+constexpr size_t REFERENCES_BATCH_SIZE = 256;
+
+unique_ptr<core::GlobalState> LSPLoop::findReferencesBySymbol(unique_ptr<core::GlobalState> gs, core::SymbolRef sym,
+                                                             vector<unique_ptr<Location>> &locations) {
+    Timer timeit(logger, "findReferencesBySymbol");
     ENFORCE(sym.exists());
     vector<core::FileRef> frefs;
+    vector<core::FileRef> unindexed;
     const core::NameHash symNameHash(*gs, sym.data(*gs)->name.data(*gs));
     // Locate files that contain the same Name as the symbol. Is an overapproximation, but a good first filter.
     int i = -1;
@@ -90,10 +130,73 @@ LSPLoop::TypecheckRun LSPLoop::setupLSPQueryBySymbol(unique_ptr<core::GlobalStat
             (std::find(usedSends.begin(), usedSends.end(), symNameHash) != usedSends.end() ||
              std::find(usedConstants.begin(), usedConstants.end(), symNameHash) != usedConstants.end())) {
             frefs.emplace_back(ref);
+            if (!referencesByFile.contains(i)) {
+                unindexed.emplace_back(ref);
+            }
+        }
+    }
+
+    for (size_t begin = 0; begin < unindexed.size(); begin += REFERENCES_BATCH_SIZE) {
+        if (begin > 0 && slowPathSuperseded()) {
+            // Let the edit go first. The files indexed so far stay indexed, so the request picks up where it left off
+            // once it is processed again.
+            logger->debug("Pausing findReferencesBySymbol after {} of {} files for a pending edit", begin,
+                          unindexed.size());
+            requestYieldedToEdits = true;
+            return gs;
+        }
+        auto end = min(begin + REFERENCES_BATCH_SIZE, unindexed.size());
+        vector<core::FileRef> batch(unindexed.begin() + begin, unindexed.begin() + end);
+        // Record the references to every symbol in these files, not just `sym`, so that later requests for other
+        // symbols find them in the index too.
+        auto run = runLSPQuery(move(gs), core::lsp::Query::createReferencesQuery(), batch);
+        gs = move(run.gs);
+        // Every file that got typechecked now has all of its references recorded, even if it has none.
+        for (auto &f : run.filesTypechecked) {
+            referencesByFile[f.id()];
+        }
+        for (auto &q : run.responses) {
+            core::Loc loc = q->getLoc();
+            if (!loc.exists() || !loc.file().exists()) {
+                continue;
+            }
+            auto &refs = referencesByFile[loc.file().id()];
+            if (auto sendResp = q->isSend()) {
+                // If file is untyped, only support responses involving constants and definitions.
+                if (loc.file().data(*gs).strictLevel < core::StrictLevel::True) {
+                    continue;
+                }
+                for (auto it = sendResp->dispatchResult.get(); it != nullptr; it = it->secondary.get()) {
+                    if (it->main.method.exists()) {
+                        refs.emplace_back(it->main.method, loc);
+                    }
+                }
+            } else if (auto constResp = q->isConstant()) {
+                refs.emplace_back(constResp->symbol, loc);
+            } else if (auto defResp = q->isDefinition()) {
+                refs.emplace_back(defResp->symbol, loc);
+            }
+        }
+        for (auto &f : run.filesTypechecked) {
+            fast_sort(referencesByFile[f.id()],
+                      [](const auto &a, const auto &b) -> bool { return a.first._id < b.first._id; });
         }
     }
 
-    return runLSPQuery(move(gs), core::lsp::Query::createSymbolQuery(sym), frefs);
+    for (auto &f : frefs) {
+        auto fnd = referencesByFile.find(f.id());
+        if (fnd == referencesByFile.end()) {
+            continue;
+        }
+        const auto &refs = fnd->second;
+        auto it = std::lower_bound(refs.begin(), refs.end(), sym,
+                                   [](const auto &ref, core::SymbolRef s) -> bool { return ref.first._id < s._id; });
+        for (; it != refs.end() && it->first == sym; ++it) {
+            addLocIfExists(*gs, locations, it->second);
+        }
+    }
+    dedupeLocations(locations);
+    return gs;
 }
 
 bool LSPLoop::ensureInitialized(LSPMethod forMethod, const LSPMessage &msg,
@@ -105,24 +208,63 @@ bool LSPLoop::ensureInitialized(LSPMethod forMethod, const LSPMessage &msg,
     return false;
 }
 
+namespace {
+void hashCombine(size_t &acc, size_t value) {
+    acc ^= value + 0x9e3779b97f4a7c15 + (acc << 6) + (acc >> 2);
+}
+
+void hashRange(size_t &acc, const Range &range) {
+    hashCombine(acc, absl::Hash<tuple<int, int, int, int>>()(make_tuple(range.start->line, range.start->character,
+                                                                         range.end->line, range.end->character)));
+}
+
+// Hashes everything publishDiagnostics would show the client for `diagnostics`.
+size_t hashDiagnostics(const vector<unique_ptr<Diagnostic>> &diagnostics) {
+    size_t res = diagnostics.size();
+    for (auto &diagnostic : diagnostics) {
+        hashRange(res, *diagnostic->range);
+        hashCombine(res, absl::Hash<string>()(diagnostic->message));
+        if (diagnostic->code) {
+            hashCombine(res, absl::Hash<variant<int, string>>()(*diagnostic->code));
+        }
+        if (diagnostic->relatedInformation) {
+            for (auto &related : *diagnostic->relatedInformation) {
+                hashCombine(res, absl::Hash<string>()(related->location->uri));
+                hashRange(res, *related->location->range);
+                hashCombine(res, absl::Hash<string>()(related->message));
+            }
+        }
+    }
+    return res;
+}
+} // namespace
+
 LSPResult LSPLoop::pushDiagnostics(TypecheckRun run) {
     const core::GlobalState &gs = *run.gs;
-    const auto &filesTypechecked = run.filesTypechecked;
-    vector<core::FileRef> errorFilesInNewRun;
-    UnorderedMap<core::FileRef, vector<std::unique_ptr<core::Error>>> errorsAccumulated;
     vector<unique_ptr<LSPMessage>> responses;
 
     if (enableTypecheckInfo) {
         vector<string> pathsTypechecked;
-        for (auto &f : filesTypechecked) {
+        for (auto &f : run.filesTypechecked) {
             pathsTypechecked.emplace_back(f.data(gs).path());
         }
         auto sorbetTypecheckInfo = make_unique<SorbetTypecheckRunInfo>(run.tookFastPath, move(pathsTypechecked));
         responses.push_back(make_unique<LSPMessage>(
             make_unique<NotificationMessage>("2.0", LSPMethod::SorbetTypecheckRunInfo, move(sorbetTypecheckInfo))));
     }
+    auto diagnostics = diagnosticsFor(gs, run.filesTypechecked, move(run.errors));
+    responses.insert(responses.end(), make_move_iterator(diagnostics.begin()), make_move_iterator(diagnostics.end()));
+    return LSPResult{move(run.gs), move(responses)};
+}
 
-    for (auto &e : run.errors) {
+vector<unique_ptr<LSPMessage>> LSPLoop::diagnosticsFor(const core::GlobalState &gs,
+                                                       const vector<core::FileRef> &filesTypechecked,
+                                                       vector<unique_ptr<core::Error>> errors) {
+    vector<core::FileRef> errorFilesInNewRun;
+    UnorderedMap<core::FileRef, vector<std::unique_ptr<core::Error>>> errorsAccumulated;
+    vector<unique_ptr<LSPMessage>> responses;
+
+    for (auto &e : errors) {
         if (e->isSilenced) {
             continue;
         }
@@ -159,16 +301,25 @@ LSPResult LSPLoop::pushDiagnostics(TypecheckRun run) {
 
     this->filesThatHaveErrors = errorFilesInNewRun;
 
+    if (!opts.daemonSocket.empty()) {
+        // Rendered now, while `gs` still describes the files they are about, for sorbet/daemonTypecheck.
+        for (auto file : filesToUpdateErrorListFor) {
+            auto accumulated = errorsAccumulated.find(file);
+            if (accumulated == errorsAccumulated.end()) {
+                daemonErrors.erase(file);
+                continue;
+            }
+            auto &rendered = daemonErrors[file];
+            rendered.clear();
+            for (auto &e : accumulated->second) {
+                rendered.push_back(make_unique<SorbetDaemonError>(e->isCritical(), e->toString(gs)));
+            }
+        }
+    }
+
     for (auto file : filesToUpdateErrorListFor) {
         if (file.exists()) {
-            string uri;
-            { // uri
-                if (file.data(gs).sourceType == core::File::Type::Payload) {
-                    uri = string(file.data(gs).path());
-                } else {
-                    uri = localName2Remote(file.data(gs).path());
-                }
-            }
+            string uri = fileRef2Uri(gs, file);
 
             vector<unique_ptr<Diagnostic>> diagnostics;
             {
@@ -208,12 +359,26 @@ LSPResult LSPLoop::pushDiagnostics(TypecheckRun run) {
                 }
             }
 
+            auto diagnosticsHash = hashDiagnostics(diagnostics);
+            auto published = publishedDiagnosticsHashes.find(file);
+            if (published != publishedDiagnosticsHashes.end() && published->second == diagnosticsHash) {
+                // The client already shows exactly these diagnostics.
+                prodCounterInc("lsp.diagnostics.unchanged");
+                continue;
+            }
+            if (diagnostics.empty()) {
+                // filesThatHaveErrors no longer lists this file, so it won't be published again until it has errors.
+                publishedDiagnosticsHashes.erase(file);
+            } else {
+                publishedDiagnosticsHashes[file] = diagnosticsHash;
+            }
+
             responses.push_back(make_unique<LSPMessage>(
                 make_unique<NotificationMessage>("2.0", LSPMethod::TextDocumentPublishDiagnostics,
                                                  make_unique<PublishDiagnosticsParams>(uri, move(diagnostics)))));
         }
     }
-    return LSPResult{move(run.gs), move(responses)};
+    return responses;
 }
 
 constexpr chrono::minutes STATSD_INTERVAL = chrono::minutes(5);
@@ -226,16 +391,27 @@ void LSPLoop::sendCountersToStatsd(chrono::time_point<chrono::steady_clock> curr
     ENFORCE(this_thread::get_id() == mainThreadId, "sendCounterToStatsd can only be called from the main LSP thread.");
     // Record rusage-related stats.
     StatsD::addRusageStats();
-    auto counters = getAndClearThreadCounters();
+    // std::function has to be copyable.
+    auto counters = make_shared<CounterState>(getAndClearThreadCounters());
+    string statsdHost;
+    string prefix;
     if (!opts.statsdHost.empty()) {
         lastMetricUpdateTime = currentTime;
-
-        auto prefix = fmt::format("{}.lsp.counters", opts.statsdPrefix);
-        StatsD::submitCounters(counters, opts.statsdHost, opts.statsdPort, prefix);
-    }
-    if (!opts.webTraceFile.empty()) {
-        web_tracer_framework::Tracing::storeTraces(counters, opts.webTraceFile);
+        statsdHost = opts.statsdHost;
+        prefix = fmt::format("{}.lsp.counters", opts.statsdPrefix);
     }
+    // Counters are only sent every few minutes, so the previous submission is long done by now.
+    countersSubmitter.reset();
+    countersSubmitter =
+        runInAThread("submitCounters", [counters, statsdHost, port = opts.statsdPort, prefix,
+                                        webTraceFile = opts.webTraceFile, webTraceStream = opts.webTraceStream]() {
+            if (!statsdHost.empty()) {
+                StatsD::submitCounters(*counters, statsdHost, port, prefix);
+            }
+            if (!webTraceFile.empty()) {
+                web_tracer_framework::Tracing::storeTraces(*counters, webTraceFile, !webTraceStream);
+            }
+        });
 }
 
 LSPResult LSPResult::make(unique_ptr<core::GlobalState> gs, unique_ptr<ResponseMessage> response) {
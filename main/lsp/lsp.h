@@ -1,13 +1,16 @@
 #ifndef RUBY_TYPER_LSPLOOP_H
 #define RUBY_TYPER_LSPLOOP_H
 
+#include "absl/synchronization/mutex.h"
 #include "ast/ast.h"
 #include "common/concurrency/WorkerPool.h"
 #include "common/kvstore/KeyValueStore.h"
+#include "common/os/os.h"
 #include "core/ErrorQueue.h"
 #include "core/NameHash.h"
 #include "core/core.h"
 #include "main/lsp/LSPMessage.h"
+#include "main/lsp/SymbolNameIndex.h"
 #include "main/options/options.h"
 #include <chrono>
 #include <deque>
@@ -78,18 +81,102 @@ class LSPLoop {
         ~ShowOperation();
     };
 
+    /**
+     * While runLSP is running: the queue its reader thread fills, and the mutex that guards it. The slow path looks at
+     * the queue to notice when a newer edit has made it obsolete.
+     */
+    absl::Mutex *queueMutex = nullptr;
+    const QueueState *queueState = nullptr;
+    /** Set when a slow path was abandoned for a newer edit. The next typecheck then has to take the slow path. */
+    bool slowPathCanceled = false;
+
     /** Trees that have been indexed (with initialGS) and can be reused between different runs */
     std::vector<ast::ParsedFile> indexed;
     /** Trees that have been indexed (with finalGS) and can be reused between different runs */
     UnorderedMap<int, ast::ParsedFile> indexedFinalGS;
+    /**
+     * Files whose tree in `indexed` was dropped to stay within opts.lspTreeCacheMB. They are indexed again when a
+     * typecheck needs them.
+     */
+    UnorderedSet<int> evictedTrees;
+    /** Names of `initialGS` that no tree has entered; compactNames keeps them, as the symbols use them. */
+    u4 namesBeforeIndexing = 0;
+    /** How many names `initialGS` had after it indexed every file, or after compactNames last rebuilt its names. */
+    u4 namesAfterCompaction = 0;
+    /** For each file id, the value of `treeUseClock` when a fast path last used its trees. */
+    std::vector<u4> treeLastUsed;
+    /** Counts fast paths. */
+    u4 treeUseClock = 0;
     /** Hashes of global states obtained by resolving every file in isolation. Used for fastpath. */
     std::vector<core::FileHash> globalStateHashes;
+    /**
+     * References to symbols, recorded per file ID and sorted by symbol. A file gets its entry the first time
+     * find-references has to look at it. The entry is dropped when an edit gets the file typechecked again. Every
+     * entry is dropped on the slow path, because it renumbers symbols.
+     */
+    UnorderedMap<int, std::vector<std::pair<core::SymbolRef, core::Loc>>> referencesByFile;
+    /**
+     * For files that hover or go-to-definition has looked at, the responses to an EVERY_LOC query, in the order
+     * drainWithQueryResponses puts them. Those requests filter this list instead of typechecking the file again. It is
+     * cleared by every edit, because the responses carry types and locations that come from other files.
+     */
+    UnorderedMap<int, std::vector<std::unique_ptr<core::lsp::QueryResponse>>> responsesByFile;
+    /** Symbols by name for workspace/symbol. Built on first use, and rebuilt whenever the symbol table changes. */
+    SymbolNameIndex symbolNameIndex;
+    /**
+     * For each file id, the symbols with a loc in that file, in symbol order. Used by textDocument/documentSymbol.
+     * Built for a symbol table of `symbolsByFileCount` symbols; the slow path, which renumbers symbols, resets it.
+     */
+    std::vector<std::vector<core::SymbolRef>> symbolsByFile;
+    u4 symbolsByFileCount = 0;
+    /** A class's methods and those of its ancestors, grouped by name and sorted by short name. */
+    using MethodTable = std::vector<std::pair<core::NameRef, std::vector<core::SymbolRef>>>;
+    /**
+     * Method tables of the classes completion has looked at. Methods only change on the slow path, which clears this.
+     */
+    UnorderedMap<core::SymbolRef, MethodTable> methodTables;
+    /**
+     * The methods the last textDocument/completion listed, so that completionItem/resolve can compute the details it
+     * left out. Items name their method by `id` and index. The slow path renumbers symbols, so it clears `methods`.
+     */
+    struct PendingCompletion {
+        int id = 0;
+        core::TypePtr receiverType;
+        // Owns the constraint that the method details are shown under, if any.
+        std::shared_ptr<core::DispatchResult> dispatchResult;
+        std::vector<core::SymbolRef> methods;
+    };
+    PendingCompletion lastCompletion;
+    /**
+     * The last few hashes computed for each path, most recent first, keyed by a hash of the contents they describe.
+     * Switching back to a branch finds the hashes of its files here instead of computing them again.
+     */
+    UnorderedMap<std::string, std::vector<std::pair<std::array<u1, 16>, core::FileHash>>> recentFileHashes;
+    /** Guards `prefetchedContents`. */
+    absl::Mutex prefetchMutex;
+    /**
+     * Contents of files that Watchman reported as changed, read by the Watchman thread before it enqueued the change.
+     * Processing the change takes the entries for its files, and reads any that are missing.
+     */
+    UnorderedMap<std::string, std::string> prefetchedContents;
     /** List of files that have had errors in last run*/
     std::vector<core::FileRef> filesThatHaveErrors;
+    /**
+     * For each file in `filesThatHaveErrors`, a hash of the diagnostics last published for it. Files whose
+     * diagnostics hash the same after a run are not published again.
+     */
+    UnorderedMap<core::FileRef, size_t> publishedDiagnosticsHashes;
     /** Root of LSP client workspace */
     std::string rootUri;
     /** File system root of LSP client workspace. May be empty if it is the current working directory. */
     std::string rootPath;
+    /**
+     * What uri2FileRef and fileRef2Uri returned before, so that responses with many locations don't convert the
+     * same paths again. Entries are checked against the path of their file before they are used, which keeps them
+     * right however the file table changes.
+     */
+    UnorderedMap<std::string, core::FileRef> fileRefsByUri;
+    std::vector<std::string> urisByFileRef;
 
     /** Concrete error queue shared by all global states */
     std::shared_ptr<core::ErrorQueue> errorQueue;
@@ -102,7 +189,11 @@ class LSPLoop {
      */
     std::unique_ptr<core::GlobalState> initialGS;
     const options::Options &opts;
-    std::unique_ptr<KeyValueStore> kvstore; // always null for now.
+    /**
+     * With --cache-dir, caches the trees and file hashes computed while initializing, so that the next server started
+     * on the same files skips most of that work. Committed and released once initialization is done.
+     */
+    std::unique_ptr<KeyValueStore> kvstore;
     std::shared_ptr<spdlog::logger> logger;
     WorkerPool &workers;
     /**
@@ -141,20 +232,47 @@ class LSPLoop {
      * The time that LSP last sent metrics to statsd -- if `opts.statsdHost` was specified.
      */
     std::chrono::time_point<std::chrono::steady_clock> lastMetricUpdateTime;
+    /** Sends the counters taken by the last sendCountersToStatsd, so that the main thread need not wait for it. */
+    std::unique_ptr<Joinable> countersSubmitter;
+    /** The most recent end-to-end latencies of one LSP method, in microseconds. */
+    struct MethodLatencies {
+        std::vector<u8> samples;
+        /** Once `samples` is full, the index of the oldest sample, which the next one replaces. */
+        size_t next = 0;
+        /** Number of messages recorded, including those whose samples were since replaced. */
+        u8 count = 0;
+    };
+    /** Latencies of the messages processed so far, by method. Reported by sorbet/perfReport. */
+    UnorderedMap<LSPMethod, MethodLatencies> latencies;
+    /**
+     * With --daemon-socket, the connections of the clients waiting on a sorbet/daemonTypecheck response, by the ID the
+     * daemon gave their request.
+     */
+    absl::Mutex daemonClientsMutex;
+    UnorderedMap<int, int> daemonClients;
+    /** With --daemon-socket, the errors last reported for each file, rendered the way the command line prints them. */
+    UnorderedMap<core::FileRef, std::vector<std::unique_ptr<SorbetDaemonError>>> daemonErrors;
     /** ID of the main thread, which actually processes LSP requests and performs typechecking. */
     std::thread::id mainThreadId;
 
     /* Send the given message to client */
     void sendMessage(const LSPMessage &msg);
+    /** Sends the given messages to the client, flushing once after all of them instead of after each. */
+    void sendMessages(const std::vector<std::unique_ptr<LSPMessage>> &msgs);
+    /** Writes the given message to the output stream without flushing it. */
+    void writeMessage(const LSPMessage &msg);
 
     std::unique_ptr<Location> loc2Location(const core::GlobalState &gs, core::Loc loc);
     void addLocIfExists(const core::GlobalState &gs, std::vector<std::unique_ptr<Location>> &locs, core::Loc loc);
+    void dedupeLocations(std::vector<std::unique_ptr<Location>> &locations);
     std::vector<std::unique_ptr<Location>>
     extractLocations(const core::GlobalState &gs,
                      const std::vector<std::unique_ptr<core::lsp::QueryResponse>> &queryResponses,
                      std::vector<std::unique_ptr<Location>> locations = {});
 
-    core::FileRef updateFile(const std::shared_ptr<core::File> &file);
+    /** Enters `files` into initialGS and indexes them on `workers`. Returns their refs, in order (a null file gets a
+     * ref that does not exist). */
+    std::vector<core::FileRef> updateFiles(const std::vector<std::shared_ptr<core::File>> &files);
     /** Invalidate all currently cached trees and re-index them from file system.
      * This runs code that is not considered performance critical and this is expected to be slow */
     void reIndexFromFileSystem();
@@ -166,8 +284,30 @@ class LSPLoop {
         std::unique_ptr<core::GlobalState> gs;
         bool tookFastPath;
     };
-    /** Conservatively rerun entire pipeline without caching any trees */
+    /** Returns the tree in `indexed` for `file`, indexing the file again if its tree was evicted. */
+    const ast::ParsedFile &getIndexed(core::FileRef file);
+    /**
+     * Once the names of `initialGS` have grown by opts.lspCompactNamesPercent, replaces it with a copy that only has
+     * the names of the cached trees, moving the trees over.
+     */
+    void compactNames();
+    /** Drops the least recently used trees until the cached ones fit in opts.lspTreeCacheMB. */
+    void evictColdTrees(const core::GlobalState &gs);
+    /**
+     * Conservatively rerun entire pipeline without caching any trees. Files open in the editor are typechecked first.
+     * Unless a query is running, the diagnostics of every file are sent as soon as it has been typechecked.
+     */
     TypecheckRun runSlowPath();
+    /**
+     * True if the next message runLSP will process, skipping delayable ones, is an edit. Only edits that arrive after
+     * initialization count, and only while no LSP query is running. Also used by find-references to yield to edits.
+     */
+    bool slowPathSuperseded();
+    /**
+     * Set by a request that stopped early so that a pending edit can be processed first. runLSP sends nothing for it,
+     * and queues it again behind the edits.
+     */
+    bool requestYieldedToEdits = false;
     /** Returns `true` if the given changes can run on the fast path. */
     bool canTakeFastPath(const std::vector<std::shared_ptr<core::File>> &changedFiles,
                          const std::vector<core::FileHash> &hashes) const;
@@ -177,8 +317,18 @@ class LSPLoop {
                              const std::vector<core::FileRef> &filesForQuery = {});
 
     LSPResult pushDiagnostics(TypecheckRun run);
+    /**
+     * The publishDiagnostics notifications for the files in `filesTypechecked`, after typechecking them reported
+     * `errors`. Files that still have errors from an earlier run keep them. Used by pushDiagnostics, and during a slow
+     * path for the files typechecked so far.
+     */
+    std::vector<std::unique_ptr<LSPMessage>> diagnosticsFor(const core::GlobalState &gs,
+                                                            const std::vector<core::FileRef> &filesTypechecked,
+                                                            std::vector<std::unique_ptr<core::Error>> errors);
 
     std::vector<core::FileHash> computeStateHashes(const std::vector<std::shared_ptr<core::File>> &files);
+    /** Like computeStateHashes, but reuses the hashes in `recentFileHashes`. Use for edits. */
+    std::vector<core::FileHash> computeChangedFileHashes(const std::vector<std::shared_ptr<core::File>> &files);
     bool ensureInitialized(const LSPMethod forMethod, const LSPMessage &msg,
                            const std::unique_ptr<core::GlobalState> &currentGs);
 
@@ -186,6 +336,8 @@ class LSPLoop {
     std::string fileRef2Uri(const core::GlobalState &gs, core::FileRef);
     std::string remoteName2Local(std::string_view uri);
     std::string localName2Remote(std::string_view uri);
+    /** Whether `remoteName2Local(uri)` would be `path`, without building it. */
+    bool isLocalNameOf(std::string_view path, std::string_view uri) const;
     std::unique_ptr<core::Loc> lspPos2Loc(core::FileRef fref, const Position &pos, const core::GlobalState &gs);
 
     /** Used to implement textDocument/documentSymbol
@@ -194,10 +346,19 @@ class LSPLoop {
     std::unique_ptr<SymbolInformation> symbolRef2SymbolInformation(const core::GlobalState &gs, core::SymbolRef);
     TypecheckRun runLSPQuery(std::unique_ptr<core::GlobalState> gs, const core::lsp::Query &q,
                              const std::vector<core::FileRef> &filesToQuery);
+    /** Answers a location query from `responsesByFile`, filling in the entry for the file first if needed. */
+    TypecheckRun runLSPQueryFromIndex(std::unique_ptr<core::GlobalState> gs, core::Loc loc);
     std::variant<LSPLoop::TypecheckRun, std::pair<std::unique_ptr<ResponseError>, std::unique_ptr<core::GlobalState>>>
     setupLSPQueryByLoc(std::unique_ptr<core::GlobalState> gs, std::string_view uri, const Position &pos,
                        const LSPMethod forMethod, bool errorIfFileIsUntyped = true);
-    TypecheckRun setupLSPQueryBySymbol(std::unique_ptr<core::GlobalState> gs, core::SymbolRef symbol);
+    /**
+     * Appends the reference index's locations for `symbol` to `locations`. Candidate files missing from the index
+     * are typechecked once, and every reference in them is recorded. They are typechecked in batches; if an edit is
+     * waiting after a batch, this sets requestYieldedToEdits and returns without the remaining files.
+     */
+    std::unique_ptr<core::GlobalState> findReferencesBySymbol(std::unique_ptr<core::GlobalState> gs,
+                                                              core::SymbolRef symbol,
+                                                              std::vector<std::unique_ptr<Location>> &locations);
     LSPResult handleTextDocumentHover(std::unique_ptr<core::GlobalState> gs, const MessageId &id,
                                       const TextDocumentPositionParams &params);
     LSPResult handleTextDocumentDocumentSymbol(std::unique_ptr<core::GlobalState> gs, const MessageId &id,
@@ -213,14 +374,40 @@ class LSPLoop {
                                            const TextDocumentPositionParams &params);
     LSPResult handleTextDocumentCompletion(std::unique_ptr<core::GlobalState> gs, const MessageId &id,
                                            const CompletionParams &params);
-    std::unique_ptr<CompletionItem> getCompletionItem(const core::GlobalState &gs, core::SymbolRef what,
-                                                      core::TypePtr receiverType,
-                                                      const std::unique_ptr<core::TypeConstraint> &constraint);
+    /**
+     * Returns the item to list for `what`, without the details that are only computed once the item is resolved. Method
+     * items are remembered in `lastCompletion`.
+     */
+    std::unique_ptr<CompletionItem> getCompletionItem(const core::GlobalState &gs, core::SymbolRef what);
+    /** Adds the signature and documentation of `method` to its completion item. */
+    void addCompletionItemDetails(const core::GlobalState &gs, core::SymbolRef method, core::TypePtr receiverType,
+                                  const std::unique_ptr<core::TypeConstraint> &constraint, CompletionItem &item);
+    LSPResult handleCompletionItemResolve(std::unique_ptr<core::GlobalState> gs, const MessageId &id,
+                                          const CompletionItem &params);
+    /** Returns the method table of `klass`, building it (and those of its ancestors) on first use. */
+    const MethodTable &methodTableFor(const core::GlobalState &gs, core::SymbolRef klass);
+    UnorderedMap<core::NameRef, std::vector<core::SymbolRef>>
+    findSimilarMethodsIn(const core::GlobalState &gs, core::TypePtr receiver, std::string_view name);
     void findSimilarConstantOrIdent(const core::GlobalState &gs, const core::TypePtr receiverType,
                                     std::vector<std::unique_ptr<CompletionItem>> &items);
     void sendShowMessageNotification(MessageType messageType, std::string_view message);
     LSPResult handleTextSignatureHelp(std::unique_ptr<core::GlobalState> gs, const MessageId &id,
                                       const TextDocumentPositionParams &params);
+    LSPResult handleSorbetPerfReport(std::unique_ptr<core::GlobalState> gs, const MessageId &id);
+    LSPResult handleSorbetDaemonTypecheck(std::unique_ptr<core::GlobalState> gs, const MessageId &id);
+    LSPResult handleSorbetMemoryReport(std::unique_ptr<core::GlobalState> gs, const MessageId &id,
+                                       const SorbetMemoryReportParams &params);
+    /**
+     * With --daemon-socket: listens on the socket, enqueues the requests of the clients that connect to it, and records
+     * their connections in `clients` so that their responses can find them. Returns once `state.terminate` is set.
+     */
+    static void acceptDaemonClients(const std::shared_ptr<spd::logger> &logger, const options::Options &opts,
+                                    LSPLoop::QueueState &state, absl::Mutex &mtx, absl::Mutex &clientsMutex,
+                                    UnorderedMap<int, int> &clients);
+    /** Sends `msg` to the client whose request it answers, if it is a response to a daemon client. */
+    void replyToDaemonClient(const LSPMessage &msg);
+    /** Exports the phase latencies in `msg.timeline` as histograms, and remembers its total for sorbet/perfReport. */
+    void recordLatency(const LSPMessage &msg);
     /**
      * Performs pre-processing on the incoming LSP request and appends it to the queue.
      * Merges changes to the same document + Watchman filesystem updates, and processes pause/ignore requests.
@@ -260,7 +447,8 @@ class LSPLoop {
 public:
     LSPLoop(std::unique_ptr<core::GlobalState> gs, const options::Options &opts,
             const std::shared_ptr<spd::logger> &logger, WorkerPool &workers, int inputFd, std::ostream &output,
-            bool skipConfigatron = false, bool disableFastPath = false);
+            bool skipConfigatron = false, bool disableFastPath = false,
+            std::unique_ptr<KeyValueStore> kvstore = nullptr);
     std::unique_ptr<core::GlobalState> runLSP();
     LSPResult processRequest(std::unique_ptr<core::GlobalState> gs, const LSPMessage &msg);
     LSPResult processRequest(std::unique_ptr<core::GlobalState> gs, const std::string &json);
@@ -270,7 +458,35 @@ public:
     LSPResult processRequests(std::unique_ptr<core::GlobalState> gs, std::vector<std::unique_ptr<LSPMessage>> messages);
 };
 
-std::optional<std::string> findDocumentation(std::string_view sourceCode, int beginIndex);
+/**
+ * Serves every input directory in `opts` from this process, with an LSPLoop of its own for each on a thread of its
+ * own. The loops start from copies of `gs`, which share the payload until they change it, and run their jobs on
+ * `workers`. Messages from `inputFd` about a document go to the loop of the directory it is in.
+ */
+std::unique_ptr<core::GlobalState> runMultiRootLSP(std::unique_ptr<core::GlobalState> gs,
+                                                   const options::Options &opts,
+                                                   const std::shared_ptr<spd::logger> &logger, WorkerPool &workers,
+                                                   int inputFd, std::ostream &output,
+                                                   std::unique_ptr<KeyValueStore> kvstore);
+/**
+ * Attempts to read an LSP message from the file descriptor. Returns a nullptr if it fails.
+ *
+ * Extra bits read are stored into `buffer`.
+ *
+ * Throws an exception on read error or EOF.
+ */
+std::unique_ptr<LSPMessage> getNewRequest(const std::shared_ptr<spd::logger> &logger, int inputFd,
+                                          std::string &buffer);
+/**
+ * Asks the daemon listening on opts.daemonSocket for the errors in its files, and prints them the way typechecking
+ * would. Returns how many errors were printed, or nullopt if no daemon answered.
+ */
+std::optional<int> printDaemonErrors(const options::Options &opts, const std::shared_ptr<spd::logger> &logger,
+                                     spdlog::logger &typeErrorsConsole);
+/** The comment lines right above the definition starting at `beginPos` in `file`, without their `#`s. */
+std::optional<std::string> findDocumentation(const core::File &file, u4 beginPos);
+/** Reads the file at `path`, or returns "" if it does not exist (which is how Watchman reports deletions). */
+std::string readFile(std::string_view path, const FileSystem &fs);
 bool hasSimilarName(const core::GlobalState &gs, core::NameRef name, std::string_view pattern);
 bool hideSymbol(const core::GlobalState &gs, core::SymbolRef sym);
 std::string methodDetail(const core::GlobalState &gs, core::SymbolRef method, core::TypePtr receiver,
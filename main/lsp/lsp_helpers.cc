@@ -35,21 +35,54 @@ string LSPLoop::localName2Remote(string_view uri) {
     return absl::StrCat(rootUri, "/", relativeUri);
 }
 
+bool LSPLoop::isLocalNameOf(string_view path, string_view uri) const {
+    if (!absl::StartsWith(uri, rootUri)) {
+        return false;
+    }
+    auto relative = uri.substr(rootUri.length());
+    if (!relative.empty() && relative.front() == '/') {
+        relative = relative.substr(1);
+    }
+    if (rootPath.length() == 0) {
+        return path == relative;
+    }
+    return path.length() == rootPath.length() + 1 + relative.length() && absl::StartsWith(path, rootPath) &&
+           path[rootPath.length()] == '/' && absl::EndsWith(path, relative);
+}
+
 core::FileRef LSPLoop::uri2FileRef(string_view uri) {
     if (!absl::StartsWith(uri, rootUri)) {
         return core::FileRef();
     }
-    auto needle = remoteName2Local(uri);
-    return initialGS->findFileByPath(needle);
+    auto fnd = fileRefsByUri.find(uri);
+    if (fnd != fileRefsByUri.end()) {
+        auto file = fnd->second;
+        if (file.id() < initialGS->filesUsed() && isLocalNameOf(file.data(*initialGS).path(), uri)) {
+            return file;
+        }
+    }
+    auto file = initialGS->findFileByPath(remoteName2Local(uri));
+    if (file.exists()) {
+        fileRefsByUri[uri] = file;
+    }
+    return file;
 }
 
 string LSPLoop::fileRef2Uri(const core::GlobalState &gs, core::FileRef file) {
-    if (file.data(gs).sourceType == core::File::Type::Payload) {
-        return string(file.data(gs).path());
-    } else {
-        return localName2Remote(string(file.data(gs).path()));
+    auto &data = file.data(gs);
+    if (data.sourceType == core::File::Type::Payload) {
+        return string(data.path());
+    }
+    if (file.id() >= urisByFileRef.size()) {
+        urisByFileRef.resize(file.id() + 1);
+    }
+    auto &uri = urisByFileRef[file.id()];
+    if (uri.empty() || !isLocalNameOf(data.path(), uri)) {
+        uri = localName2Remote(data.path());
     }
+    return uri;
 }
+
 unique_ptr<Range> loc2Range(const core::GlobalState &gs, core::Loc loc) {
     unique_ptr<Position> start;
     unique_ptr<Position> end;
@@ -113,6 +146,17 @@ int cmpLocations(const Location &a, const Location &b) {
     return cmpPositions(*a.range->end, *b.range->end);
 }
 
+void LSPLoop::dedupeLocations(vector<unique_ptr<Location>> &locations) {
+    fast_sort(locations, [](const unique_ptr<Location> &a, const unique_ptr<Location> &b) -> bool {
+        return cmpLocations(*a, *b) < 0;
+    });
+    locations.resize(std::distance(
+        locations.begin(), std::unique(locations.begin(), locations.end(),
+                                       [](const unique_ptr<Location> &a, const unique_ptr<Location> &b) -> bool {
+                                           return cmpLocations(*a, *b) == 0;
+                                       })));
+}
+
 vector<unique_ptr<Location>>
 LSPLoop::extractLocations(const core::GlobalState &gs,
                           const vector<unique_ptr<core::lsp::QueryResponse>> &queryResponses,
@@ -127,15 +171,7 @@ LSPLoop::extractLocations(const core::GlobalState &gs,
             }
         }
     }
-    // Dedupe locations
-    fast_sort(locations, [](const unique_ptr<Location> &a, const unique_ptr<Location> &b) -> bool {
-        return cmpLocations(*a, *b) < 0;
-    });
-    locations.resize(std::distance(
-        locations.begin(), std::unique(locations.begin(), locations.end(),
-                                       [](const unique_ptr<Location> &a, const unique_ptr<Location> &b) -> bool {
-                                           return cmpLocations(*a, *b) == 0;
-                                       })));
+    dedupeLocations(locations);
     return locations;
 }
 
@@ -41,7 +41,7 @@ string tryConvertToString(optional<const rapidjson::Value *> value, string_view
     if (!realValue.IsString()) {
         throw JSONTypeError(name, "string", realValue);
     }
-    return realValue.GetString();
+    return string(realValue.GetString(), realValue.GetStringLength());
 }
 
 string tryConvertToStringConstant(optional<const rapidjson::Value *> value, string_view constantValue,
@@ -53,9 +53,12 @@ string tryConvertToStringConstant(optional<const rapidjson::Value *> value, stri
     return strValue;
 }
 
-optional<const rapidjson::Value *> maybeGetJSONField(const rapidjson::Value &value, const string &name) {
-    if (value.HasMember(name)) {
-        return &value[name];
+optional<const rapidjson::Value *> maybeGetJSONField(const rapidjson::Value &value, string_view name) {
+    // One lookup, and no copy of `name` (generated code passes literals).
+    rapidjson::Value key(rapidjson::StringRef(name.data(), name.size()));
+    auto it = value.FindMember(key);
+    if (it != value.MemberEnd()) {
+        return &it->value;
     }
     return nullopt;
 }
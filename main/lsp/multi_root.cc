@@ -0,0 +1,291 @@
+#include "absl/algorithm/container.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "common/FileOps.h"
+#include "main/lsp/lsp.h"
+#include "main/options/options.h" // For EarlyReturnWithCode.
+#include <atomic>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+namespace sorbet::realmain::lsp {
+namespace {
+// The ID that the requests every root is sent (initialize and shutdown) carry to all roots but the first, so that the
+// editor only gets one answer to them.
+const string BROADCAST_ID = "sorbet/multiRoot";
+
+// Hands what one root's LSPLoop writes to the editor's stream a message at a time, so that the messages of several
+// roots never interleave. LSPLoop flushes after every batch of messages it writes.
+class RootOutputBuffer final : public stringbuf {
+    ostream &out;
+    absl::Mutex &outMtx;
+    const bool dropBroadcastReplies;
+
+    bool isDropped(string_view body) const {
+        if (!dropBroadcastReplies || body.find(BROADCAST_ID) == string_view::npos) {
+            return false;
+        }
+        rapidjson::Document d;
+        d.Parse(body.data(), body.size());
+        if (d.HasParseError() || !d.IsObject()) {
+            return false;
+        }
+        auto id = d.FindMember("id");
+        return id != d.MemberEnd() && id->value.IsString() && id->value.GetString() == BROADCAST_ID;
+    }
+
+protected:
+    int sync() override {
+        auto written = str();
+        string_view pending = written;
+        string forwarded;
+        while (true) {
+            auto headerEnd = pending.find("\r\n\r\n");
+            if (headerEnd == string_view::npos) {
+                break;
+            }
+            int length = -1;
+            sscanf(string(pending.substr(0, headerEnd)).c_str(), "Content-Length: %i", &length);
+            auto messageEnd = headerEnd + 4 + length;
+            if (length < 0 || messageEnd > pending.size()) {
+                break;
+            }
+            if (!isDropped(pending.substr(headerEnd + 4, length))) {
+                forwarded.append(pending.substr(0, messageEnd));
+            }
+            pending.remove_prefix(messageEnd);
+        }
+        str(string(pending));
+        if (!forwarded.empty()) {
+            absl::MutexLock lck(&outMtx);
+            out.write(forwarded.data(), forwarded.size());
+            out.flush();
+        }
+        return 0;
+    }
+
+public:
+    RootOutputBuffer(ostream &out, absl::Mutex &outMtx, bool dropBroadcastReplies)
+        : stringbuf(ios_base::out | ios_base::ate), out(out), outMtx(outMtx),
+          dropBroadcastReplies(dropBroadcastReplies) {}
+};
+
+// One of the input directories, served by an LSPLoop of its own.
+struct Root {
+    const string dir;
+    options::Options opts;
+    // The URI the editor knows the directory by, once it sent `initialize`.
+    string uri;
+    // LSPLoop reads the messages routed to it from `readFd`.
+    int readFd = -1;
+    int writeFd = -1;
+    unique_ptr<RootOutputBuffer> outputBuffer;
+    unique_ptr<ostream> output;
+    unique_ptr<core::GlobalState> gs;
+    unique_ptr<KeyValueStore> kvstore;
+    unique_ptr<Joinable> thread;
+    atomic<bool> done{false};
+    int exitCode = 0;
+
+    Root(string_view dir, options::Options opts) : dir(dir), opts(move(opts)) {}
+};
+
+string rootUriFor(const InitializeParams &params, string_view dir) {
+    // An editor with several folders open names each of them. Prefer the one named like the directory.
+    if (params.workspaceFolders.has_value()) {
+        if (auto folders = get_if<vector<unique_ptr<WorkspaceFolder>>>(&*params.workspaceFolders)) {
+            auto slash = dir.rfind('/');
+            auto name = slash == string_view::npos ? dir : dir.substr(slash + 1);
+            for (auto &folder : *folders) {
+                if (absl::EndsWith(folder->uri, absl::StrCat("/", name))) {
+                    return folder->uri;
+                }
+            }
+        }
+    }
+    if (absl::StartsWith(dir, "/")) {
+        return absl::StrCat("file://", dir);
+    }
+    string rootUri;
+    if (auto rootUriString = get_if<string>(&params.rootUri)) {
+        rootUri = *rootUriString;
+    }
+    if (absl::StartsWith(dir, "./")) {
+        dir.remove_prefix(2);
+    }
+    return dir == "." || dir.empty() ? rootUri : absl::StrCat(rootUri, "/", dir);
+}
+
+// The document a message is about, for the methods that are about one.
+optional<string> documentUri(const string &json) {
+    rapidjson::Document d;
+    d.Parse(json.c_str());
+    if (d.HasParseError() || !d.IsObject()) {
+        return nullopt;
+    }
+    auto params = d.FindMember("params");
+    if (params == d.MemberEnd() || !params->value.IsObject()) {
+        return nullopt;
+    }
+    auto textDocument = params->value.FindMember("textDocument");
+    if (textDocument == params->value.MemberEnd() || !textDocument->value.IsObject()) {
+        return nullopt;
+    }
+    auto uri = textDocument->value.FindMember("uri");
+    if (uri == textDocument->value.MemberEnd() || !uri->value.IsString()) {
+        return nullopt;
+    }
+    return string(uri->value.GetString(), uri->value.GetStringLength());
+}
+
+// The root whose URI is the longest prefix of `uri`, or the first root.
+Root &rootFor(vector<unique_ptr<Root>> &roots, string_view uri) {
+    Root *best = roots.front().get();
+    size_t bestLength = 0;
+    for (auto &root : roots) {
+        if (root->uri.size() > bestLength && absl::StartsWith(uri, absl::StrCat(root->uri, "/"))) {
+            best = root.get();
+            bestLength = root->uri.size();
+        }
+    }
+    return *best;
+}
+
+void sendTo(Root &root, string_view json) {
+    auto message = absl::StrCat("Content-Length: ", json.size(), "\r\n\r\n", json);
+    string_view data = message;
+    while (!data.empty()) {
+        auto written = ::write(root.writeFd, data.data(), data.size());
+        if (written <= 0) {
+            return;
+        }
+        data.remove_prefix(written);
+    }
+}
+} // namespace
+
+unique_ptr<core::GlobalState> runMultiRootLSP(unique_ptr<core::GlobalState> gs, const options::Options &opts,
+                                              const shared_ptr<spd::logger> &logger, WorkerPool &workers,
+                                              int inputFd, ostream &output, unique_ptr<KeyValueStore> kvstore) {
+    if (!opts.daemonSocket.empty() || !opts.lspRecordSession.empty()) {
+        logger->error("Sorbet's language server does not support --daemon-socket or --lsp-record-session with "
+                      "several input directories.");
+        throw options::EarlyReturnWithCode(1);
+    }
+
+    absl::Mutex outputMtx;
+    vector<unique_ptr<Root>> roots;
+    for (auto &dir : opts.rawInputDirNames) {
+        auto &root = roots.emplace_back(make_unique<Root>(dir, opts.clone()));
+        root->opts.rawInputDirNames = {dir};
+        root->opts.inputFileNames.clear();
+        if (opts.pathPrefix.empty()) {
+            root->opts.pathPrefix = absl::StrCat(dir, "/");
+        }
+        int fds[2];
+        if (pipe(fds) != 0) {
+            logger->error("Could not create a pipe for input directory `{}`.", dir);
+            throw options::EarlyReturnWithCode(1);
+        }
+        root->readFd = fds[0];
+        root->writeFd = fds[1];
+        root->outputBuffer = make_unique<RootOutputBuffer>(output, outputMtx, roots.size() > 1);
+        root->output = make_unique<ostream>(root->outputBuffer.get());
+        // The copies share the payload's names, symbols and files until they change them.
+        root->gs = gs->deepCopy();
+        root->gs->pathPrefix = root->opts.pathPrefix;
+    }
+    // Every file goes to the root whose directory it is in, and files given by name outside of them to the first.
+    for (auto &file : opts.inputFileNames) {
+        auto owner = absl::c_find_if(
+            roots, [&](auto &root) -> bool { return absl::StartsWith(file, absl::StrCat(root->dir, "/")); });
+        auto &root = owner != roots.end() ? *owner : roots.front();
+        root->opts.inputFileNames.emplace_back(file);
+    }
+    // Only the first root caches; a KeyValueStore has a single owner.
+    roots.front()->kvstore = move(kvstore);
+
+    auto &errorLogger = gs->errorQueue->logger;
+    auto &errorTracer = gs->errorQueue->tracer;
+    for (auto &root : roots) {
+        root->thread = runInAThread("lspRoot", [&root = *root, &logger, &workers, &errorLogger, &errorTracer]() {
+            // The error queue belongs to the thread that drains it.
+            root.gs->errorQueue = make_shared<core::ErrorQueue>(errorLogger, errorTracer);
+            root.gs->errorQueue->ignoreFlushes = true;
+            try {
+                LSPLoop loop(move(root.gs), root.opts, logger, workers, root.readFd, *root.output, false, false,
+                             move(root.kvstore));
+                root.gs = loop.runLSP();
+            } catch (options::EarlyReturnWithCode &c) {
+                root.exitCode = c.returnCode;
+            }
+            root.done = true;
+        });
+    }
+
+    // Routes what the editor sends: messages about a document to the root that has it, and the rest to every root if
+    // they only tell the server something, or to the first root if they need an answer.
+    string buffer;
+    try {
+        while (absl::c_none_of(roots, [](auto &root) -> bool { return root->done; })) {
+            auto msg = getNewRequest(logger, inputFd, buffer);
+            if (msg == nullptr) {
+                continue;
+            }
+            if (msg->isRequest() && msg->method() == LSPMethod::Initialize) {
+                auto &params = get<unique_ptr<InitializeParams>>(msg->asRequest().params);
+                for (auto &root : roots) {
+                    root->uri = rootUriFor(*params, root->dir);
+                }
+            }
+            if (msg->isRequest() && (msg->method() == LSPMethod::Initialize || msg->method() == LSPMethod::Shutdown)) {
+                auto id = msg->asRequest().id;
+                for (auto &root : roots) {
+                    if (msg->method() == LSPMethod::Initialize) {
+                        get<unique_ptr<InitializeParams>>(msg->asRequest().params)->rootUri = root->uri;
+                    }
+                    if (root == roots.front()) {
+                        msg->asRequest().id = id;
+                    } else {
+                        msg->asRequest().id = BROADCAST_ID;
+                    }
+                    sendTo(*root, msg->toJSON());
+                }
+                continue;
+            }
+            auto json = msg->toJSON();
+            if (auto uri = documentUri(json)) {
+                sendTo(rootFor(roots, *uri), json);
+            } else if (msg->isNotification() && msg->method() != LSPMethod::SorbetError) {
+                for (auto &root : roots) {
+                    sendTo(*root, json);
+                }
+            } else {
+                sendTo(*roots.front(), json);
+            }
+        }
+    } catch (FileReadException e) {
+        // The editor went away. Closing the pipes below tells every root to exit.
+    }
+
+    for (auto &root : roots) {
+        close(root->writeFd);
+    }
+    int exitCode = 0;
+    for (auto &root : roots) {
+        root->thread = nullptr; // joins
+        close(root->readFd);
+        if (exitCode == 0) {
+            exitCode = root->exitCode;
+        }
+    }
+    if (exitCode != 0) {
+        throw options::EarlyReturnWithCode(exitCode);
+    }
+    return move(roots.front()->gs);
+}
+
+} // namespace sorbet::realmain::lsp
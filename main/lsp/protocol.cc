@@ -1,3 +1,5 @@
+#include "absl/algorithm/container.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "common/FileOps.h"
@@ -6,19 +8,13 @@
 #include "lsp.h"
 #include "main/lsp/watchman/WatchmanProcess.h"
 #include "main/options/options.h" // For EarlyReturnWithCode.
+#include <fstream>
 #include <iostream>
 
 using namespace std;
 
 namespace sorbet::realmain::lsp {
 
-/**
- * Attempts to read an LSP message from the file descriptor. Returns a nullptr if it fails.
- *
- * Extra bits read are stored into `buffer`.
- *
- * Throws an exception on read error or EOF.
- */
 unique_ptr<LSPMessage> getNewRequest(const shared_ptr<spd::logger> &logger, int inputFd, string &buffer) {
     int length = -1;
     string allRead;
@@ -105,6 +101,8 @@ unique_ptr<core::GlobalState> LSPLoop::runLSP() {
     LSPLoop::QueueState guardedState{{}, false, false, 0};
     absl::Mutex mtx;
     absl::Notification initializedNotification;
+    queueMutex = &mtx;
+    queueState = &guardedState;
 
     unique_ptr<watchman::WatchmanProcess> watchmanProcess;
     if (!opts.disableWatchman) {
@@ -112,8 +110,33 @@ unique_ptr<core::GlobalState> LSPLoop::runLSP() {
             // The lambda below intentionally does not capture `this`.
             watchmanProcess = make_unique<watchman::WatchmanProcess>(
                 logger, opts.watchmanPath, opts.rawInputDirNames.at(0), vector<string>({"rb", "rbi"}),
-                [&guardedState, &mtx, logger = this->logger,
-                 &initializedNotification](std::unique_ptr<WatchmanQueryResponse> response) {
+                [&guardedState, &mtx, logger = this->logger, &initializedNotification, &opts = this->opts,
+                 &rootPath = this->rootPath, &prefetchMutex = this->prefetchMutex,
+                 &prefetchedContents = this->prefetchedContents](std::unique_ptr<WatchmanQueryResponse> response) {
+                    // Drop ignored paths here, and read the rest, so that the coordinator neither sees nor reads them.
+                    auto &files = response->files;
+                    files.erase(remove_if(files.begin(), files.end(),
+                                          [&](const string &file) -> bool {
+                                              return FileOps::isFileIgnored(rootPath, absl::StrCat(rootPath, "/", file),
+                                                                            opts.absoluteIgnorePatterns,
+                                                                            opts.relativeIgnorePatterns);
+                                          }),
+                                files.end());
+                    if (files.empty()) {
+                        return;
+                    }
+                    UnorderedMap<string, string> contents;
+                    for (auto &file : files) {
+                        auto localPath = absl::StrCat(rootPath, "/", file);
+                        contents[localPath] = readFile(localPath, *opts.fs);
+                    }
+                    {
+                        absl::MutexLock lck(&prefetchMutex);
+                        for (auto &entry : contents) {
+                            prefetchedContents[entry.first] = move(entry.second);
+                        }
+                    }
+
                     auto notifMsg =
                         make_unique<NotificationMessage>("2.0", LSPMethod::SorbetWatchmanFileChange, move(response));
                     auto msg = make_unique<LSPMessage>(move(notifMsg));
@@ -141,34 +164,61 @@ unique_ptr<core::GlobalState> LSPLoop::runLSP() {
         }
     }
 
-    auto readerThread =
-        runInAThread("lspReader", [&guardedState, &mtx, logger = this->logger, inputFd = this->inputFd] {
-            // Thread that executes this lambda is called reader thread.
-            // This thread _intentionally_ does not capture `this`.
+    unique_ptr<Joinable> readerThread;
+    if (!opts.daemonSocket.empty()) {
+        readerThread = runInAThread("lspDaemon", [&guardedState, &mtx, logger = this->logger, &opts = this->opts,
+                                                  &clientsMutex = this->daemonClientsMutex,
+                                                  &clients = this->daemonClients] {
+            // Like the reader thread, but its requests come from the daemon's clients instead of stdin.
             NotifyOnDestruction notify(mtx, guardedState.terminate);
-            string buffer;
-            try {
-                auto timeit = make_unique<Timer>(logger, "getNewRequest");
-                while (true) {
-                    auto msg = getNewRequest(logger, inputFd, buffer);
-                    {
-                        absl::MutexLock lck(&mtx); // guards guardedState.
-                        if (msg) {
-                            enqueueRequest(logger, guardedState, move(msg), true);
-                            // Reset span now that we've found a request.
-                            timeit = make_unique<Timer>(logger, "getNewRequest");
+            acceptDaemonClients(logger, opts, guardedState, mtx, clientsMutex, clients);
+        });
+    } else {
+        readerThread =
+            runInAThread("lspReader", [&guardedState, &mtx, logger = this->logger, inputFd = this->inputFd,
+                                       recordSession = this->opts.lspRecordSession] {
+                // Thread that executes this lambda is called reader thread.
+                // This thread _intentionally_ does not capture `this`.
+                NotifyOnDestruction notify(mtx, guardedState.terminate);
+                string buffer;
+                unique_ptr<ofstream> recording;
+                auto recordingStart = chrono::steady_clock::now();
+                if (!recordSession.empty()) {
+                    recording = make_unique<ofstream>(recordSession, ios::trunc);
+                    if (!recording->good()) {
+                        logger->error("Could not open --lsp-record-session `{}`; not recording.", recordSession);
+                        recording = nullptr;
+                    }
+                }
+                try {
+                    auto timeit = make_unique<Timer>(logger, "getNewRequest");
+                    while (true) {
+                        auto msg = getNewRequest(logger, inputFd, buffer);
+                        if (msg && recording != nullptr) {
+                            // One message a line, after the milliseconds since the session started.
+                            auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() -
+                                                                                       recordingStart);
+                            *recording << elapsed.count() << '\t' << msg->toJSON() << endl;
                         }
-                        // Check if it's time to exit.
-                        if (guardedState.terminate) {
-                            // Another thread exited.
-                            break;
+                        {
+                            absl::MutexLock lck(&mtx); // guards guardedState.
+                            if (msg) {
+                                enqueueRequest(logger, guardedState, move(msg), true);
+                                // Reset span now that we've found a request.
+                                timeit = make_unique<Timer>(logger, "getNewRequest");
+                            }
+                            // Check if it's time to exit.
+                            if (guardedState.terminate) {
+                                // Another thread exited.
+                                break;
+                            }
                         }
                     }
+                } catch (FileReadException e) {
+                    // Failed to read from input stream. Ignore. NotifyOnDestruction will take care of exiting cleanly.
                 }
-            } catch (FileReadException e) {
-                // Failed to read from input stream. Ignore. NotifyOnDestruction will take care of exiting cleanly.
-            }
-        });
+            });
+    }
 
     mainThreadId = this_thread::get_id();
     unique_ptr<core::GlobalState> gs;
@@ -200,11 +250,26 @@ unique_ptr<core::GlobalState> LSPLoop::runLSP() {
                 guardedState.pendingRequests.pop_front();
             }
             prodCounterInc("lsp.messages.received");
+            msg->timeline.dequeued = chrono::steady_clock::now();
+            requestYieldedToEdits = false;
             auto result = processRequest(move(gs), *msg);
             gs = move(result.gs);
-            for (auto &msg : result.responses) {
-                sendMessage(*msg);
+            if (requestYieldedToEdits) {
+                absl::MutexLock lck(&mtx); // guards guardedState
+                // Right behind the edit that made it yield (enqueueRequest merges every edit into that one), and
+                // ahead of the requests that came after it.
+                auto &pending = guardedState.pendingRequests;
+                auto it = absl::c_find_if(pending, [](const auto &m) -> bool { return !m->isDelayable(); });
+                if (it != pending.end()) {
+                    ++it;
+                }
+                pending.insert(it, move(msg));
+                continue;
             }
+            msg->timeline.processed = chrono::steady_clock::now();
+            sendMessages(result.responses);
+            msg->timeline.sent = chrono::steady_clock::now();
+            recordLatency(*msg);
 
             if (initialized && !initializedNotification.HasBeenNotified()) {
                 initializedNotification.Notify();
@@ -224,6 +289,8 @@ unique_ptr<core::GlobalState> LSPLoop::runLSP() {
         }
     }
 
+    queueMutex = nullptr;
+    queueState = nullptr;
     if (gs) {
         return gs;
     } else {
@@ -324,6 +391,7 @@ void mergeFileChanges(deque<unique_ptr<LSPMessage>> &pendingRequests) {
         if (tryPreMerge(**it, *counts, consecutiveWorkspaceEdits, updatedFiles)) {
             // See which newer requests we can enqueue. We want to merge them *backwards*.
             int firstMergedCounter = (*it)->counter;
+            auto firstMergedEnqueued = (*it)->timeline.enqueued;
             auto firstMergedTracers = move((*it)->startTracers);
             auto firstMergedTimers = move((*it)->timers);
             it = pendingRequests.erase(it);
@@ -351,6 +419,7 @@ void mergeFileChanges(deque<unique_ptr<LSPMessage>> &pendingRequests) {
             auto mergedMessage = performMerge(updatedFiles, consecutiveWorkspaceEdits, counts);
             mergedMessage->startTracers = firstMergedTracers;
             mergedMessage->counter = firstMergedCounter;
+            mergedMessage->timeline.enqueued = firstMergedEnqueued;
             mergedMessage->timers = move(firstMergedTimers);
             // Return to where first message was found.
             it -= skipped;
@@ -384,6 +453,7 @@ void LSPLoop::enqueueRequest(const shared_ptr<spd::logger> &logger, LSPLoop::Que
     msg->counter = state.requestCounter++;
     msg->startTracers.push_back(timeit.getFlowEdge());
     msg->timers.push_back(make_unique<Timer>(logger, "processing_time"));
+    msg->timeline.enqueued = chrono::steady_clock::now();
 
     const LSPMethod method = msg->method();
     if (method == LSPMethod::$CancelRequest) {
@@ -445,6 +515,23 @@ unique_ptr<core::Loc> LSPLoop::lspPos2Loc(core::FileRef fref, const Position &po
 }
 
 void LSPLoop::sendMessage(const LSPMessage &msg) {
+    writeMessage(msg);
+    outputStream << flush;
+}
+
+void LSPLoop::sendMessages(const vector<unique_ptr<LSPMessage>> &msgs) {
+    for (auto &msg : msgs) {
+        writeMessage(*msg);
+    }
+    outputStream << flush;
+}
+
+void LSPLoop::writeMessage(const LSPMessage &msg) {
+    if (!opts.daemonSocket.empty()) {
+        // A daemon has no editor to talk to. Only the responses to its clients' requests go anywhere.
+        replyToDaemonClient(msg);
+        return;
+    }
     if (msg.isResponse()) {
         ENFORCE(msg.asResponse().result || msg.asResponse().error,
                 "A valid ResponseMessage must have a result or an error.");
@@ -452,9 +539,10 @@ void LSPLoop::sendMessage(const LSPMessage &msg) {
         ENFORCE(isServerNotification(msg.method()));
     }
     auto json = msg.toJSON();
-    string outResult = fmt::format("Content-Length: {}\r\n\r\n{}", json.length(), json);
     logger->debug("Write: {}\n", json);
-    outputStream << outResult << flush;
+    // Diagnostics batches can be large; write the body directly instead of copying it after the header.
+    outputStream << fmt::format("Content-Length: {}\r\n\r\n", json.length());
+    outputStream.write(json.data(), json.length());
 }
 
 } // namespace sorbet::realmain::lsp
@@ -25,7 +25,10 @@ LSPResult LSPLoop::processRequests(unique_ptr<core::GlobalState> gs, vector<uniq
 
     LSPResult rv{move(gs), {}};
     for (auto &message : state.pendingRequests) {
+        message->timeline.dequeued = chrono::steady_clock::now();
         auto rslt = processRequest(move(rv.gs), *message);
+        message->timeline.processed = message->timeline.sent = chrono::steady_clock::now();
+        recordLatency(*message);
         rv.gs = move(rslt.gs);
         rv.responses.insert(rv.responses.end(), make_move_iterator(rslt.responses.begin()),
                             make_move_iterator(rslt.responses.end()));
@@ -95,6 +98,9 @@ LSPResult LSPLoop::processRequestInternal(unique_ptr<core::GlobalState> gs, cons
                 ShowOperation stateHashOp(*this, "GlobalStateHash", "Finishing initialization...");
                 this->globalStateHashes = computeStateHashes(result.gs->getFiles());
             }
+            if (kvstore != nullptr) {
+                KeyValueStore::commit(move(kvstore));
+            }
             initialized = true;
             return result;
         }
@@ -162,7 +168,7 @@ LSPResult LSPLoop::processRequestInternal(unique_ptr<core::GlobalState> gs, cons
             }
 
             auto serverCap = make_unique<ServerCapabilities>();
-            serverCap->textDocumentSync = TextDocumentSyncKind::Full;
+            serverCap->textDocumentSync = TextDocumentSyncKind::Incremental;
             serverCap->definitionProvider = opts.lspGoToDefinitionEnabled;
             serverCap->documentSymbolProvider = opts.lspDocumentSymbolEnabled;
             serverCap->workspaceSymbolProvider = opts.lspWorkspaceSymbolsEnabled;
@@ -178,6 +184,7 @@ LSPResult LSPLoop::processRequestInternal(unique_ptr<core::GlobalState> gs, cons
             if (opts.lspAutocompleteEnabled) {
                 auto completionProvider = make_unique<CompletionOptions>();
                 completionProvider->triggerCharacters = {"."};
+                completionProvider->resolveProvider = true;
                 serverCap->completionProvider = move(completionProvider);
             }
 
@@ -198,12 +205,22 @@ LSPResult LSPLoop::processRequestInternal(unique_ptr<core::GlobalState> gs, cons
         } else if (method == LSPMethod::TextDocumentCompletion) {
             auto &params = get<unique_ptr<CompletionParams>>(rawParams);
             return handleTextDocumentCompletion(move(gs), id, *params);
+        } else if (method == LSPMethod::CompletionItemResolve) {
+            auto &params = get<unique_ptr<CompletionItem>>(rawParams);
+            return handleCompletionItemResolve(move(gs), id, *params);
         } else if (method == LSPMethod::TextDocumentSignatureHelp) {
             auto &params = get<unique_ptr<TextDocumentPositionParams>>(rawParams);
             return handleTextSignatureHelp(move(gs), id, *params);
         } else if (method == LSPMethod::TextDocumentReferences) {
             auto &params = get<unique_ptr<ReferenceParams>>(rawParams);
             return handleTextDocumentReferences(move(gs), id, *params);
+        } else if (method == LSPMethod::SorbetPerfReport) {
+            return handleSorbetPerfReport(move(gs), id);
+        } else if (method == LSPMethod::SorbetDaemonTypecheck) {
+            return handleSorbetDaemonTypecheck(move(gs), id);
+        } else if (method == LSPMethod::SorbetMemoryReport) {
+            auto &params = get<unique_ptr<SorbetMemoryReportParams>>(rawParams);
+            return handleSorbetMemoryReport(move(gs), id, *params);
         } else if (method == LSPMethod::Shutdown) {
             prodCategoryCounterInc("lsp.messages.processed", "shutdown");
             response->result = JSONNullObject();
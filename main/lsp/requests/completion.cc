@@ -18,28 +18,60 @@ mergeMaps(UnorderedMap<core::NameRef, vector<core::SymbolRef>> &&first,
     return std::move(first);
 };
 
-UnorderedMap<core::NameRef, vector<core::SymbolRef>> findSimilarMethodsIn(const core::GlobalState &gs,
-                                                                          core::TypePtr receiver, string_view name) {
+const LSPLoop::MethodTable &LSPLoop::methodTableFor(const core::GlobalState &gs, core::SymbolRef klass) {
+    auto fnd = methodTables.find(klass);
+    if (fnd != methodTables.end()) {
+        return fnd->second;
+    }
+    UnorderedMap<core::NameRef, vector<core::SymbolRef>> byName;
+    const auto &data = klass.data(gs);
+    for (auto member : data->members()) {
+        auto sym = member.second;
+        if (sym.data(gs)->isMethod()) {
+            byName[sym.data(gs)->name].emplace_back(sym);
+        }
+    }
+    auto addAncestor = [&](core::SymbolRef ancestor) -> void {
+        // N.B.: The reference is only used before the next call to methodTableFor, which may rehash methodTables.
+        for (auto &entry : methodTableFor(gs, ancestor)) {
+            auto &syms = byName[entry.first];
+            syms.insert(syms.end(), entry.second.begin(), entry.second.end());
+        }
+    };
+    for (auto mixin : data->mixins()) {
+        addAncestor(mixin);
+    }
+    if (data->superClass().exists()) {
+        addAncestor(data->superClass());
+    }
+
+    MethodTable table(make_move_iterator(byName.begin()), make_move_iterator(byName.end()));
+    for (auto &entry : table) {
+        fast_sort(entry.second, [](auto lhs, auto rhs) -> bool { return lhs._id < rhs._id; });
+        entry.second.erase(unique(entry.second.begin(), entry.second.end()), entry.second.end());
+    }
+    fast_sort(table, [&](const auto &left, const auto &right) -> bool {
+        auto leftShortName = left.first.data(gs)->shortName(gs);
+        auto rightShortName = right.first.data(gs)->shortName(gs);
+        if (leftShortName != rightShortName) {
+            return leftShortName < rightShortName;
+        }
+        return left.first._id < right.first._id;
+    });
+    return methodTables[klass] = move(table);
+}
+
+UnorderedMap<core::NameRef, vector<core::SymbolRef>>
+LSPLoop::findSimilarMethodsIn(const core::GlobalState &gs, core::TypePtr receiver, string_view name) {
     UnorderedMap<core::NameRef, vector<core::SymbolRef>> result;
     typecase(
         receiver.get(),
         [&](core::ClassType *c) {
-            const auto &owner = c->symbol.data(gs);
-            for (auto member : owner->membersStableOrderSlow(gs)) {
-                auto sym = member.second;
-                if (sym.data(gs)->isMethod() && hasSimilarName(gs, sym.data(gs)->name, name)) {
-                    result[sym.data(gs)->name].emplace_back(sym);
+            for (auto &entry : methodTableFor(gs, c->symbol)) {
+                if (hasSimilarName(gs, entry.first, name)) {
+                    result[entry.first] = entry.second;
                 }
             }
-            for (auto mixin : owner->mixins()) {
-                result = mergeMaps(std::move(result),
-                                   findSimilarMethodsIn(gs, core::make_type<core::ClassType>(mixin), name));
-            }
-            if (owner->superClass().exists()) {
-                result =
-                    mergeMaps(std::move(result),
-                              findSimilarMethodsIn(gs, core::make_type<core::ClassType>(owner->superClass()), name));
-            }
         },
         [&](core::AndType *c) {
             result = mergeMaps(findSimilarMethodsIn(gs, c->left, name), findSimilarMethodsIn(gs, c->right, name));
@@ -92,41 +124,28 @@ string methodSnippet(const core::GlobalState &gs, core::SymbolRef method) {
     return fmt::format("{}({}){}", shortName, fmt::join(typeAndArgNames, ", "), "${0}");
 }
 
-optional<string> findDocumentation(string_view sourceCode, int beginIndex) {
-    // everything in the file before the method definition.
-    auto preDefinition = sourceCode.substr(0, sourceCode.rfind('\n', beginIndex));
-
-    int lastNewlineLoc = preDefinition.rfind('\n');
-    // if there is no '\n' in preDefinition, we're at the top of the file.
-    if (lastNewlineLoc == preDefinition.npos) {
+optional<string> findDocumentation(const core::File &file, u4 beginPos) {
+    // Every line above the definition's that contains a `#`, up to the first one that doesn't. The first line of the
+    // file is never part of it, which is usually the sigil.
+    int definitionLine = file.lineBreakIndexAtOrAfter(beginPos);
+    if (definitionLine <= 2) {
         return nullopt;
     }
-    auto prevLine = preDefinition.substr(lastNewlineLoc, preDefinition.size() - lastNewlineLoc);
-    if (prevLine.find('#') == prevLine.npos) {
+    int lastLine = definitionLine - 1;
+    int firstLine = max(file.commentRunStart(lastLine), 2);
+    if (firstLine > lastLine) {
         return nullopt;
     }
 
-    string documentation = "";
-    // keep looking for previous newline locations, searching for lines with # in them.
-    while (prevLine.find('#') != prevLine.npos) {
-        documentation = absl::StrCat(prevLine.substr(prevLine.find('#') + 1, prevLine.size()), "\n", documentation);
-        int prevNewlineLoc = preDefinition.rfind('\n', lastNewlineLoc - 1);
-        // if there is no '\n', we're at the top of the file, so just return documentation.
-        if (prevNewlineLoc == preDefinition.npos) {
-            break;
-        }
-        prevLine = preDefinition.substr(prevNewlineLoc, lastNewlineLoc - prevNewlineLoc);
-        lastNewlineLoc = prevNewlineLoc;
-    }
-    if (documentation.empty()) {
-        return nullopt;
+    string documentation;
+    for (int line = firstLine; line <= lastLine; line++) {
+        auto text = file.getLine(line);
+        absl::StrAppend(&documentation, text.substr(text.find('#') + 1), "\n");
     }
     return documentation;
 }
 
-unique_ptr<CompletionItem> LSPLoop::getCompletionItem(const core::GlobalState &gs, core::SymbolRef what,
-                                                      core::TypePtr receiverType,
-                                                      const unique_ptr<core::TypeConstraint> &constraint) {
+unique_ptr<CompletionItem> LSPLoop::getCompletionItem(const core::GlobalState &gs, core::SymbolRef what) {
     ENFORCE(what.exists());
     auto item = make_unique<CompletionItem>(string(what.data(gs)->name.data(gs)->shortName(gs)));
     auto resultType = what.data(gs)->resultType;
@@ -135,9 +154,6 @@ unique_ptr<CompletionItem> LSPLoop::getCompletionItem(const core::GlobalState &g
     }
     if (what.data(gs)->isMethod()) {
         item->kind = CompletionItemKind::Function;
-        if (what.exists()) {
-            item->detail = methodDetail(gs, what, receiverType, nullptr, constraint);
-        }
         if (clientCompletionItemSnippetSupport) {
             item->insertTextFormat = InsertTextFormat::Snippet;
             item->insertText = methodSnippet(gs, what);
@@ -145,18 +161,10 @@ unique_ptr<CompletionItem> LSPLoop::getCompletionItem(const core::GlobalState &g
             item->insertTextFormat = InsertTextFormat::PlainText;
             item->insertText = string(what.data(gs)->name.data(gs)->shortName(gs));
         }
-
-        optional<string> documentation = nullopt;
-        if (what.data(gs)->loc().file().exists()) {
-            documentation =
-                findDocumentation(what.data(gs)->loc().file().data(gs).source(), what.data(gs)->loc().beginPos());
-        }
-        if (documentation) {
-            if (documentation->find("@deprecated") != documentation->npos) {
-                item->deprecated = true;
-            }
-            item->documentation = documentation;
-        }
+        // The signature and documentation are left for completionItem/resolve: receivers with hundreds of methods
+        // would otherwise spend most of the request on details of items that are never looked at.
+        item->data = make_unique<SorbetCompletionItemData>(lastCompletion.id, (int)lastCompletion.methods.size());
+        lastCompletion.methods.emplace_back(what);
     } else if (what.data(gs)->isStaticField()) {
         item->kind = CompletionItemKind::Constant;
         item->detail = resultType->show(gs);
@@ -166,6 +174,47 @@ unique_ptr<CompletionItem> LSPLoop::getCompletionItem(const core::GlobalState &g
     return item;
 }
 
+void LSPLoop::addCompletionItemDetails(const core::GlobalState &gs, core::SymbolRef method, core::TypePtr receiverType,
+                                       const unique_ptr<core::TypeConstraint> &constraint, CompletionItem &item) {
+    ENFORCE(method.data(gs)->isMethod());
+    item.detail = methodDetail(gs, method, receiverType, nullptr, constraint);
+
+    optional<string> documentation = nullopt;
+    if (method.data(gs)->loc().file().exists()) {
+        documentation = findDocumentation(method.data(gs)->loc().file().data(gs), method.data(gs)->loc().beginPos());
+    }
+    if (documentation) {
+        if (documentation->find("@deprecated") != documentation->npos) {
+            item.deprecated = true;
+        }
+        item.documentation = documentation;
+    }
+}
+
+LSPResult LSPLoop::handleCompletionItemResolve(unique_ptr<core::GlobalState> gs, const MessageId &id,
+                                               const CompletionItem &params) {
+    auto response = make_unique<ResponseMessage>("2.0", id, LSPMethod::CompletionItemResolve);
+    prodCategoryCounterInc("lsp.messages.processed", "completionItem.resolve");
+
+    // The item is sent back as it was received, with whatever details are still known about it.
+    rapidjson::MemoryPoolAllocator<> alloc;
+    auto item = CompletionItem::fromJSONValue(*params.toJSONValue(alloc));
+    if (item->data.has_value()) {
+        auto &data = **item->data;
+        if (data.completionId == lastCompletion.id && data.index >= 0 &&
+            data.index < (int)lastCompletion.methods.size()) {
+            const unique_ptr<core::TypeConstraint> noConstraint;
+            const auto &constraint = lastCompletion.dispatchResult != nullptr
+                                         ? lastCompletion.dispatchResult->main.constr
+                                         : noConstraint;
+            addCompletionItemDetails(*gs, lastCompletion.methods[data.index], lastCompletion.receiverType, constraint,
+                                     *item);
+        }
+    }
+    response->result = move(item);
+    return LSPResult::make(move(gs), move(response));
+}
+
 void LSPLoop::findSimilarConstantOrIdent(const core::GlobalState &gs, const core::TypePtr receiverType,
                                          vector<unique_ptr<CompletionItem>> &items) {
     if (auto c = core::cast_type<core::ClassType>(receiverType.get())) {
@@ -180,7 +229,7 @@ void LSPLoop::findSimilarConstantOrIdent(const core::GlobalState &gs, const core
                     sym.data(gs)->name.data(gs)->kind == core::NameKind::CONSTANT &&
                     // hide singletons
                     hasSimilarName(gs, sym.data(gs)->name, pattern)) {
-                    items.push_back(getCompletionItem(gs, sym, receiverType, nullptr));
+                    items.push_back(getCompletionItem(gs, sym));
                 }
             }
         } while (owner != core::Symbols::root());
@@ -206,12 +255,15 @@ LSPResult LSPLoop::handleTextDocumentCompletion(unique_ptr<core::GlobalState> gs
         gs = move(run->gs);
         auto &queryResponses = run->responses;
         vector<unique_ptr<CompletionItem>> items;
+        lastCompletion = PendingCompletion{lastCompletion.id + 1, nullptr, nullptr, {}};
         if (!queryResponses.empty()) {
             auto resp = move(queryResponses[0]);
 
             if (auto sendResp = resp->isSend()) {
                 auto pattern = sendResp->callerSideName.data(*gs)->shortName(*gs);
                 auto receiverType = sendResp->dispatchResult->main.receiver;
+                lastCompletion.receiverType = receiverType;
+                lastCompletion.dispatchResult = sendResp->dispatchResult;
                 logger->debug("Looking for method similar to {}", pattern);
                 UnorderedMap<core::NameRef, vector<core::SymbolRef>> methods =
                     findSimilarMethodsIn(*gs, receiverType, pattern);
@@ -229,8 +281,7 @@ LSPResult LSPLoop::handleTextDocumentCompletion(unique_ptr<core::GlobalState> gs
                 for (auto &entry : methodsSorted) {
                     if (entry.second[0].exists()) {
                         fast_sort(entry.second, [&](auto lhs, auto rhs) -> bool { return lhs._id < rhs._id; });
-                        items.push_back(getCompletionItem(*gs, entry.second[0], receiverType,
-                                                          sendResp->dispatchResult->main.constr));
+                        items.push_back(getCompletionItem(*gs, entry.second[0]));
                     }
                 }
             } else if (auto identResp = resp->isIdent()) {
@@ -0,0 +1,32 @@
+#include "common/Counters.h"
+#include "main/lsp/lsp.h"
+
+using namespace std;
+
+namespace sorbet::realmain::lsp {
+
+LSPResult LSPLoop::handleSorbetDaemonTypecheck(unique_ptr<core::GlobalState> gs, const MessageId &id) {
+    prodCategoryCounterInc("lsp.messages.processed", "sorbet.daemonTypecheck");
+    auto response = make_unique<ResponseMessage>("2.0", id, LSPMethod::SorbetDaemonTypecheck);
+    vector<pair<string_view, const vector<unique_ptr<SorbetDaemonError>> *>> files;
+    for (const auto &[file, errors] : daemonErrors) {
+        files.emplace_back(file.data(*gs).path(), &errors);
+    }
+    fast_sort(files, [](const auto &left, const auto &right) -> bool { return left.first < right.first; });
+
+    // Like the command line, critical errors go first.
+    vector<unique_ptr<SorbetDaemonError>> errors;
+    for (bool critical : {true, false}) {
+        for (const auto &[path, fileErrors] : files) {
+            for (const auto &error : *fileErrors) {
+                if (error->critical == critical) {
+                    errors.push_back(make_unique<SorbetDaemonError>(error->critical, error->text));
+                }
+            }
+        }
+    }
+    response->result = make_unique<SorbetDaemonTypecheckResult>(move(errors));
+    return LSPResult::make(move(gs), move(response));
+}
+
+} // namespace sorbet::realmain::lsp
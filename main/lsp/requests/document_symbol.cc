@@ -1,3 +1,4 @@
+#include "common/Timer.h"
 #include "core/lsp/QueryResponse.h"
 #include "main/lsp/lsp.h"
 
@@ -78,8 +79,27 @@ LSPResult LSPLoop::handleTextDocumentDocumentSymbol(unique_ptr<core::GlobalState
     vector<unique_ptr<DocumentSymbol>> result;
     string_view uri = params.textDocument->uri;
     auto fref = uri2FileRef(uri);
-    for (u4 idx = 1; idx < gs->symbolsUsed(); idx++) {
-        core::SymbolRef ref(gs.get(), idx);
+    if (symbolsByFileCount != gs->symbolsUsed()) {
+        Timer timeit(logger, "build_symbols_by_file");
+        symbolsByFile.clear();
+        for (u4 idx = 1; idx < gs->symbolsUsed(); idx++) {
+            core::SymbolRef ref(gs.get(), idx);
+            for (auto loc : ref.data(*gs)->locs()) {
+                auto fileId = loc.file().id();
+                if (fileId >= symbolsByFile.size()) {
+                    symbolsByFile.resize(fileId + 1);
+                }
+                auto &syms = symbolsByFile[fileId];
+                if (syms.empty() || syms.back() != ref) {
+                    syms.push_back(ref);
+                }
+            }
+        }
+        symbolsByFileCount = gs->symbolsUsed();
+    }
+    const vector<core::SymbolRef> noSymbols;
+    const auto &candidates = fref.id() < symbolsByFile.size() ? symbolsByFile[fref.id()] : noSymbols;
+    for (auto ref : candidates) {
         if (!hideSymbol(*gs, ref) &&
             (ref.data(*gs)->owner.data(*gs)->loc().file() != fref || ref.data(*gs)->owner == core::Symbols::root())) {
             for (auto definitionLocation : ref.data(*gs)->locs()) {
@@ -0,0 +1,41 @@
+#include "absl/algorithm/container.h"
+#include "common/os/os.h"
+#include "main/lsp/lsp.h"
+
+using namespace std;
+
+namespace sorbet::realmain::lsp {
+
+namespace {
+int kb(size_t bytes) {
+    return (int)(bytes / 1024);
+}
+} // namespace
+
+LSPResult LSPLoop::handleSorbetMemoryReport(unique_ptr<core::GlobalState> gs, const MessageId &id,
+                                            const SorbetMemoryReportParams &params) {
+    prodCategoryCounterInc("lsp.messages.processed", "sorbet.memoryReport");
+    auto response = make_unique<ResponseMessage>("2.0", id, LSPMethod::SorbetMemoryReport);
+    // The typechecked state is a copy of initialGS, and shares most of its tables, so only initialGS is measured.
+    auto usage = initialGS->memoryUsage();
+    int indexedTrees = absl::c_count_if(indexed, [](const auto &tree) -> bool { return tree.tree != nullptr; });
+    // Freeing trees races with allocating them on the workers, so this can be momentarily off.
+    auto treeBytes = max<int64_t>(0, ast::Expression::allocatedBytes());
+    auto report = make_unique<SorbetMemoryReport>(
+        initialGS->namesUsed(), kb(usage.names), initialGS->symbolsUsed(), kb(usage.symbols), initialGS->filesUsed(),
+        kb(usage.files), kb(usage.strings), indexedTrees, (int)evictedTrees.size(), (int)indexedFinalGS.size(),
+        kb(treeBytes), (int)filesThatHaveErrors.size(), (int)fileRefsByUri.size(), (int)recentFileHashes.size(),
+        kb(kvstore != nullptr ? kvstore->usedBytes() : 0), kb(heapAllocatedBytes()), kb(peakRssBytes()));
+    if (params.heapProfilePath.has_value()) {
+        if (dumpHeapProfile(*params.heapProfilePath)) {
+            report->heapProfilePath = *params.heapProfilePath;
+        } else {
+            logger->info("Could not write a heap profile to `{}`; the allocator does not support it.",
+                         *params.heapProfilePath);
+        }
+    }
+    response->result = move(report);
+    return LSPResult::make(move(gs), move(response));
+}
+
+} // namespace sorbet::realmain::lsp
@@ -0,0 +1,110 @@
+#include "common/Counters.h"
+#include "main/lsp/lsp.h"
+
+using namespace std;
+
+namespace sorbet::realmain::lsp {
+
+namespace {
+// Enough recent samples for a stable p99, while keeping sorbet/perfReport cheap to answer.
+constexpr size_t MAX_LATENCY_SAMPLES = 1024;
+
+// Histogram keys are latencies rounded up to a power of two milliseconds, so that a handful of buckets covers
+// everything from a hover to a slow path.
+int latencyBucket(chrono::steady_clock::duration duration) {
+    auto ms = chrono::duration_cast<chrono::milliseconds>(duration).count();
+    int bucket = 1;
+    while (bucket < ms && bucket < (1 << 20)) {
+        bucket <<= 1;
+    }
+    return bucket;
+}
+
+// Histogram names must be literals, hence the switch.
+void addMethodLatency(LSPMethod method, int bucket) {
+    switch (method) {
+        case LSPMethod::TextDocumentHover:
+            prodHistogramAdd("lsp.latency.textDocument.hover", bucket, 1);
+            break;
+        case LSPMethod::TextDocumentDefinition:
+            prodHistogramAdd("lsp.latency.textDocument.definition", bucket, 1);
+            break;
+        case LSPMethod::TextDocumentCompletion:
+            prodHistogramAdd("lsp.latency.textDocument.completion", bucket, 1);
+            break;
+        case LSPMethod::TextDocumentReferences:
+            prodHistogramAdd("lsp.latency.textDocument.references", bucket, 1);
+            break;
+        case LSPMethod::TextDocumentSignatureHelp:
+            prodHistogramAdd("lsp.latency.textDocument.signatureHelp", bucket, 1);
+            break;
+        case LSPMethod::TextDocumentDocumentSymbol:
+            prodHistogramAdd("lsp.latency.textDocument.documentSymbol", bucket, 1);
+            break;
+        case LSPMethod::WorkspaceSymbol:
+            prodHistogramAdd("lsp.latency.workspace.symbol", bucket, 1);
+            break;
+        // Edits are usually merged into a SorbetWorkspaceEdit before they are processed.
+        case LSPMethod::TextDocumentDidOpen:
+        case LSPMethod::TextDocumentDidChange:
+        case LSPMethod::TextDocumentDidClose:
+        case LSPMethod::SorbetWatchmanFileChange:
+        case LSPMethod::SorbetWorkspaceEdit:
+            prodHistogramAdd("lsp.latency.edit", bucket, 1);
+            break;
+        default:
+            prodHistogramAdd("lsp.latency.other", bucket, 1);
+            break;
+    }
+}
+
+double percentileMs(const vector<u8> &sortedMicros, double percentile) {
+    if (sortedMicros.empty()) {
+        return 0;
+    }
+    auto idx = min(sortedMicros.size() - 1, (size_t)(percentile * sortedMicros.size()));
+    return sortedMicros[idx] / 1000.0;
+}
+} // namespace
+
+void LSPLoop::recordLatency(const LSPMessage &msg) {
+    if (msg.isResponse()) {
+        return;
+    }
+    const auto &timeline = msg.timeline;
+    prodHistogramAdd("lsp.latency.queue", latencyBucket(timeline.dequeued - timeline.enqueued), 1);
+    prodHistogramAdd("lsp.latency.processing", latencyBucket(timeline.processed - timeline.dequeued), 1);
+    prodHistogramAdd("lsp.latency.send", latencyBucket(timeline.sent - timeline.processed), 1);
+
+    auto total = timeline.sent - timeline.enqueued;
+    const auto method = msg.method();
+    addMethodLatency(method, latencyBucket(total));
+
+    auto &entry = latencies[method];
+    u8 micros = chrono::duration_cast<chrono::microseconds>(total).count();
+    if (entry.samples.size() < MAX_LATENCY_SAMPLES) {
+        entry.samples.push_back(micros);
+    } else {
+        entry.samples[entry.next] = micros;
+        entry.next = (entry.next + 1) % MAX_LATENCY_SAMPLES;
+    }
+    entry.count++;
+}
+
+LSPResult LSPLoop::handleSorbetPerfReport(unique_ptr<core::GlobalState> gs, const MessageId &id) {
+    prodCategoryCounterInc("lsp.messages.processed", "sorbet.perfReport");
+    auto response = make_unique<ResponseMessage>("2.0", id, LSPMethod::SorbetPerfReport);
+    vector<unique_ptr<SorbetMethodLatency>> methods;
+    for (const auto &[method, entry] : latencies) {
+        auto sorted = entry.samples;
+        fast_sort(sorted);
+        methods.push_back(make_unique<SorbetMethodLatency>(convertLSPMethodToString(method), (int)entry.count,
+                                                           percentileMs(sorted, 0.50), percentileMs(sorted, 0.95),
+                                                           percentileMs(sorted, 0.99)));
+    }
+    fast_sort(methods, [](const auto &left, const auto &right) -> bool { return left->method < right->method; });
+    response->result = make_unique<SorbetPerfReport>(move(methods));
+    return LSPResult::make(move(gs), move(response));
+}
+
+} // namespace sorbet::realmain::lsp
@@ -10,9 +10,7 @@ pair<unique_ptr<core::GlobalState>, vector<unique_ptr<Location>>>
 LSPLoop::getReferencesToSymbol(unique_ptr<core::GlobalState> gs, core::SymbolRef symbol,
                                vector<unique_ptr<Location>> locations) {
     if (symbol.exists()) {
-        auto run2 = setupLSPQueryBySymbol(move(gs), symbol);
-        gs = move(run2.gs);
-        locations = extractLocations(*gs, run2.responses, move(locations));
+        gs = findReferencesBySymbol(move(gs), symbol, locations);
     }
     return make_pair(move(gs), move(locations));
 }
@@ -64,7 +62,7 @@ LSPResult LSPLoop::handleTextDocumentReferences(unique_ptr<core::GlobalState> gs
                 auto sendResp = resp->isSend();
                 auto start = sendResp->dispatchResult.get();
                 vector<unique_ptr<Location>> locations;
-                while (start != nullptr) {
+                while (start != nullptr && !requestYieldedToEdits) {
                     if (start->main.method.exists() && !start->main.receiver->isUntyped()) {
                         tie(gs, locations) = getReferencesToSymbol(move(gs), start->main.method, move(locations));
                     }
@@ -81,6 +79,10 @@ LSPResult LSPLoop::handleTextDocumentReferences(unique_ptr<core::GlobalState> gs
         // Should never happen, but satisfy the compiler.
         ENFORCE(false, "Internal error: setupLSPQueryByLoc returned invalid value.");
     }
+    if (requestYieldedToEdits) {
+        // runLSP answers once the request is processed again.
+        return LSPResult{move(gs), {}};
+    }
     return LSPResult::make(move(gs), move(response));
 }
 
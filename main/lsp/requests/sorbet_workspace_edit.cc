@@ -33,6 +33,22 @@ string getFileContents(UnorderedMap<string, string> &updates, unique_ptr<core::G
     }
 }
 
+namespace {
+// Like Loc::pos2Offset, but only scans the lines before `pos` instead of building a core::File to find every line
+// break. Positions past the end of `contents` are clamped to it.
+size_t position2Offset(string_view contents, const Position &pos) {
+    size_t lineStart = 0;
+    for (int line = 0; line < pos.line; line++) {
+        auto newline = contents.find('\n', lineStart);
+        if (newline == string_view::npos) {
+            return contents.size();
+        }
+        lineStart = newline + 1;
+    }
+    return min(lineStart + pos.character, contents.size());
+}
+} // namespace
+
 void LSPLoop::preprocessSorbetWorkspaceEdit(const DidChangeTextDocumentParams &changeParams,
                                             UnorderedMap<string, string> &updates) {
     string_view uri = changeParams.textDocument->uri;
@@ -46,21 +62,15 @@ void LSPLoop::preprocessSorbetWorkspaceEdit(const DidChangeTextDocumentParams &c
             if (change->range) {
                 auto &range = *change->range;
                 // incremental update
-                core::Loc::Detail start, end;
-                start.line = range->start->line + 1;
-                start.column = range->start->character + 1;
-                end.line = range->end->line + 1;
-                end.column = range->end->character + 1;
-                core::File old(string(localPath), string(fileContents), core::File::Type::Normal);
-                auto startOffset = core::Loc::pos2Offset(old, start);
-                auto endOffset = core::Loc::pos2Offset(old, end);
-                fileContents = fileContents.replace(startOffset, endOffset - startOffset, change->text);
+                auto startOffset = position2Offset(fileContents, *range->start);
+                auto endOffset = max(startOffset, position2Offset(fileContents, *range->end));
+                fileContents.replace(startOffset, endOffset - startOffset, change->text);
             } else {
                 // replace
                 fileContents = change->text;
             }
         }
-        updates[localPath] = fileContents;
+        updates[localPath] = move(fileContents);
     }
 }
 
@@ -94,11 +104,23 @@ void LSPLoop::preprocessSorbetWorkspaceEdit(const DidCloseTextDocumentParams &cl
 
 void LSPLoop::preprocessSorbetWorkspaceEdit(const WatchmanQueryResponse &queryResponse,
                                             UnorderedMap<string, string> &updates) {
+    UnorderedMap<string, string> prefetched;
+    {
+        absl::MutexLock lck(&prefetchMutex);
+        for (auto &file : queryResponse.files) {
+            auto fnd = prefetchedContents.find(absl::StrCat(rootPath, "/", file));
+            if (fnd != prefetchedContents.end()) {
+                prefetched[fnd->first] = move(fnd->second);
+                prefetchedContents.erase(fnd);
+            }
+        }
+    }
     for (auto file : queryResponse.files) {
         string localPath = absl::StrCat(rootPath, "/", file);
         if (!FileOps::isFileIgnored(rootPath, localPath, opts.absoluteIgnorePatterns, opts.relativeIgnorePatterns) &&
             openFiles.find(localPath) == openFiles.end()) {
-            updates[localPath] = readFile(localPath, *opts.fs);
+            auto fnd = prefetched.find(localPath);
+            updates[localPath] = fnd != prefetched.end() ? move(fnd->second) : readFile(localPath, *opts.fs);
         }
     }
 }
@@ -1,3 +1,4 @@
+#include "common/Timer.h"
 #include "core/lsp/QueryResponse.h"
 #include "main/lsp/lsp.h"
 
@@ -5,6 +6,11 @@ using namespace std;
 
 namespace sorbet::realmain::lsp {
 
+namespace {
+// Editors only show the first few results, and each one costs a loc2Location.
+constexpr size_t MAX_RESULTS = 100;
+} // namespace
+
 unique_ptr<SymbolInformation> LSPLoop::symbolRef2SymbolInformation(const core::GlobalState &gs,
                                                                    core::SymbolRef symRef) {
     auto sym = symRef.data(gs);
@@ -34,12 +40,19 @@ LSPResult LSPLoop::handleWorkspaceSymbols(unique_ptr<core::GlobalState> gs, cons
     string_view searchString = params.query;
     ShowOperation op(*this, "WorkspaceSymbols", fmt::format("Searching for symbol `{}`...", searchString));
 
-    for (u4 idx = 1; idx < gs->symbolsUsed(); idx++) {
-        core::SymbolRef ref(gs.get(), idx);
-        if (hasSimilarName(*gs, ref.data(*gs)->name, searchString)) {
-            auto data = symbolRef2SymbolInformation(*gs, ref);
-            if (data) {
-                result.push_back(move(data));
+    if (!symbolNameIndex.isUpToDate(*gs)) {
+        Timer timeit(logger, "buildSymbolNameIndex");
+        symbolNameIndex = SymbolNameIndex(*gs);
+    }
+    // A query that spells out a path, like `A::B`, names constants by where they are rather than what they contain.
+    auto matches = searchString.find("::") != string_view::npos ? symbolNameIndex.searchFullName(searchString)
+                                                                 : symbolNameIndex.search(searchString);
+    for (auto ref : matches) {
+        auto data = symbolRef2SymbolInformation(*gs, ref);
+        if (data) {
+            result.push_back(move(data));
+            if (result.size() >= MAX_RESULTS) {
+                break;
             }
         }
     }
@@ -241,6 +241,18 @@ TEST(GenerateLSPMessagesTest, DifferentLSPMessageTypes) {
     ASSERT_TRUE(LSPMessage(notification->toJSON()).isNotification());
 }
 
+// LSPMessage parses in place, so escapes are decoded into the input buffer. Embedded NULs must survive that.
+TEST(GenerateLSPMessagesTest, EscapedStringsSurviveInPlaceParsing) {
+    const string expectedText("a\n\"b\"\0c", 7);
+    auto errorParams = make_unique<SorbetErrorParams>(1, expectedText);
+    auto notification = make_unique<NotificationMessage>("2.0", LSPMethod::SorbetError, move(errorParams));
+    LSPMessage parsed(notification->toJSON());
+    ASSERT_TRUE(parsed.isNotification());
+    auto &params = get<unique_ptr<SorbetErrorParams>>(parsed.asNotification().params);
+    ASSERT_EQ(params->message, expectedText);
+    ASSERT_EQ(parsed.toJSON(), notification->toJSON());
+}
+
 string makeRequestMessage(LSPMethod method, optional<string_view> params) {
     return fmt::format("{{\"jsonrpc\": \"2.0\", \"id\": 0, \"method\": \"{}\"{}}}", convertLSPMethodToString(method),
                        (params ? fmt::format(", \"params\": {}", *params) : ""));
@@ -1,6 +1,7 @@
 #include "gtest/gtest.h"
 // has to go first as it violates are requirements
 
+#include "core/Unfreeze.h"
 #include "main/lsp/lsp.h"
 
 namespace spd = spdlog;
@@ -40,39 +41,65 @@ const string file_string = "# typed: true\n"
                            "      1\n"
                            "    end\n"
                            "end\n";
-string_view file = string_view(file_string);
+core::File file("file.rb", string(file_string), core::File::Type::Normal);
 
 TEST(FindDocumentationTest, OneLineDocumentation) { // NOLINT
-    int position = file.find("abcde");
+    int position = file_string.find("abcde");
     optional<string> b = findDocumentation(file, position);
     ASSERT_EQ(*b, " This is an instance method with a standard line documentation\n");
 }
 
 TEST(FindDocumentationTest, MultiLineDocumentation) { // NOLINT
-    int position = file.find("multidoc_instance");
+    int position = file_string.find("multidoc_instance");
     optional<string> b = findDocumentation(file, position);
     ASSERT_EQ(*b, " This is a multiline documented instance method.\n All of the lines should be displayed in the "
                   "docs.\n Including this one.\n");
 }
 TEST(FindDocumentationTest, SeparatedDocumentation) { // NOLINT
-    int position = file.find("nodocs");
+    int position = file_string.find("nodocs");
     optional<string> b = findDocumentation(file, position);
     ASSERT_TRUE(!b);
 }
 TEST(FindDocumentationTest, TopOfFile) { // NOLINT
-    int position = file.find("B");
+    int position = file_string.find("B");
     optional<string> b = findDocumentation(file, position);
     ASSERT_EQ(*b, " this is a class.\n");
 }
 TEST(FindDocumentationTest, DifferentIndentation) { // NOLINT
-    int position = file.find("weirdindent");
+    int position = file_string.find("weirdindent");
     optional<string> b = findDocumentation(file, position);
     ASSERT_EQ(*b, " weird indentation\n is in this documentation.\n");
 }
 TEST(FindDocumentationTest, Constant) { // NOLINT
-    int position = file.find("ZZZZZZ");
+    int position = file_string.find("ZZZZZZ");
     optional<string> b = findDocumentation(file, position);
     ASSERT_EQ(*b, " This is the documentation for a constant.\n This is the second line for a constant.\n");
 }
 
+TEST(SymbolNameIndexTest, FullyQualifiedNames) { // NOLINT
+    auto logger = spd::stderr_color_mt("symbol-name-index-test");
+    core::GlobalState gs(make_shared<core::ErrorQueue>(*logger, *logger));
+    gs.initEmpty();
+    core::SymbolRef outer, inner, constant;
+    {
+        core::UnfreezeNameTable nameTableAccess(gs);
+        core::UnfreezeSymbolTable symbolTableAccess(gs);
+        outer = gs.enterClassSymbol(core::Loc::none(), core::Symbols::root(), gs.enterNameConstant("Outer"));
+        inner = gs.enterClassSymbol(core::Loc::none(), outer, gs.enterNameConstant("Inner"));
+        constant = gs.enterStaticFieldSymbol(core::Loc::none(), inner, gs.enterNameConstant("LIMIT"));
+    }
+    SymbolNameIndex index(gs);
+
+    EXPECT_EQ(outer, index.findByFullName("Outer"));
+    EXPECT_EQ(inner, index.findByFullName("::Outer::Inner"));
+    EXPECT_EQ(constant, index.findByFullName("Outer::Inner::LIMIT"));
+    EXPECT_FALSE(index.findByFullName("Inner").exists());
+    EXPECT_EQ(core::Symbols::T_Array(), index.findByFullName("T::Array"));
+
+    vector<core::SymbolRef> nested = {inner, constant};
+    EXPECT_EQ(nested, index.searchFullName("Outer::"));
+    vector<core::SymbolRef> fromOuter = {outer, inner, constant};
+    EXPECT_EQ(fromOuter, index.searchFullName("Outer"));
+}
+
 } // namespace sorbet::realmain::lsp::test
\ No newline at end of file
@@ -887,6 +887,14 @@ void makeLSPTypes(vector<shared_ptr<JSONClassType>> &enumTypes, vector<shared_pt
                                         },
                                         enumTypes);
 
+    // Sorbet-specific: identifies an item of the last completion list, so completionItem/resolve can find its details.
+    auto SorbetCompletionItemData = makeObject("SorbetCompletionItemData",
+                                               {
+                                                   makeField("completionId", JSONInt),
+                                                   makeField("index", JSONInt),
+                                               },
+                                               classTypes);
+
     auto CompletionItem = makeObject(
         "CompletionItem",
         {
@@ -901,8 +909,8 @@ void makeLSPTypes(vector<shared_ptr<JSONClassType>> &enumTypes, vector<shared_pt
             makeField("additionalTextEdits", makeOptional(makeArray(TextEdit))),
             makeField("commitCharacters", makeOptional(makeArray(JSONString))),
             makeField("command", makeOptional(Command)),
-            // Unused in Sorbet.
-            // makeField("data", makeOptional(JSONAny)),
+            // The spec allows any JSON here; Sorbet only ever sends (and so only gets back) its own.
+            makeField("data", makeOptional(SorbetCompletionItemData)),
         },
         classTypes);
 
@@ -1293,6 +1301,58 @@ void makeLSPTypes(vector<shared_ptr<JSONClassType>> &enumTypes, vector<shared_pt
                                                  makeField("filesTypechecked", makeArray(JSONString)),
                                              },
                                              classTypes);
+    auto SorbetMethodLatency = makeObject("SorbetMethodLatency",
+                                          {
+                                              makeField("method", JSONString),
+                                              makeField("count", JSONInt),
+                                              makeField("p50Ms", JSONDouble),
+                                              makeField("p95Ms", JSONDouble),
+                                              makeField("p99Ms", JSONDouble),
+                                          },
+                                          classTypes);
+    auto SorbetPerfReport = makeObject("SorbetPerfReport",
+                                       {
+                                           makeField("methods", makeArray(SorbetMethodLatency)),
+                                       },
+                                       classTypes);
+    auto SorbetMemoryReportParams = makeObject("SorbetMemoryReportParams",
+                                               {
+                                                   makeField("heapProfilePath", makeOptional(JSONString)),
+                                               },
+                                               classTypes);
+    auto SorbetMemoryReport = makeObject("SorbetMemoryReport",
+                                         {
+                                             makeField("names", JSONInt),
+                                             makeField("namesKb", JSONInt),
+                                             makeField("symbols", JSONInt),
+                                             makeField("symbolsKb", JSONInt),
+                                             makeField("files", JSONInt),
+                                             makeField("filesKb", JSONInt),
+                                             makeField("stringsKb", JSONInt),
+                                             makeField("indexedTrees", JSONInt),
+                                             makeField("evictedTrees", JSONInt),
+                                             makeField("indexedFinalGSTrees", JSONInt),
+                                             makeField("treesKb", JSONInt),
+                                             makeField("filesWithErrors", JSONInt),
+                                             makeField("cachedUris", JSONInt),
+                                             makeField("cachedFileHashes", JSONInt),
+                                             makeField("kvstoreKb", JSONInt),
+                                             makeField("heapAllocatedKb", JSONInt),
+                                             makeField("maxRssKb", JSONInt),
+                                             makeField("heapProfilePath", makeOptional(JSONString)),
+                                         },
+                                         classTypes);
+    auto SorbetDaemonError = makeObject("SorbetDaemonError",
+                                        {
+                                            makeField("critical", JSONBool),
+                                            makeField("text", JSONString),
+                                        },
+                                        classTypes);
+    auto SorbetDaemonTypecheckResult = makeObject("SorbetDaemonTypecheckResult",
+                                                  {
+                                                      makeField("errors", makeArray(SorbetDaemonError)),
+                                                  },
+                                                  classTypes);
 
     /* Core LSPMessage objects */
     // N.B.: Only contains LSP methods that Sorbet actually cares about.
@@ -1312,6 +1372,7 @@ void makeLSPTypes(vector<shared_ptr<JSONClassType>> &enumTypes, vector<shared_pt
                                      "textDocument/definition",
                                      "textDocument/hover",
                                      "textDocument/completion",
+                                     "completionItem/resolve",
                                      "textDocument/references",
                                      "textDocument/signatureHelp",
                                      "workspace/symbol",
@@ -1323,6 +1384,9 @@ void makeLSPTypes(vector<shared_ptr<JSONClassType>> &enumTypes, vector<shared_pt
                                      "sorbet/error",
                                      "sorbet/workspaceEdit",
                                      "sorbet/typecheckRunInfo",
+                                     "sorbet/perfReport",
+                                     "sorbet/daemonTypecheck",
+                                     "sorbet/memoryReport",
                                  },
                                  enumTypes);
 
@@ -1335,10 +1399,14 @@ void makeLSPTypes(vector<shared_ptr<JSONClassType>> &enumTypes, vector<shared_pt
                                                 {"textDocument/definition", TextDocumentPositionParams},
                                                 {"textDocument/hover", TextDocumentPositionParams},
                                                 {"textDocument/completion", CompletionParams},
+                                                {"completionItem/resolve", CompletionItem},
                                                 {"textDocument/references", ReferenceParams},
                                                 {"textDocument/signatureHelp", TextDocumentPositionParams},
                                                 {"workspace/symbol", WorkspaceSymbolParams},
                                                 {"sorbet/error", SorbetErrorParams},
+                                                {"sorbet/perfReport", makeOptional(JSONNull)},
+                                                {"sorbet/daemonTypecheck", makeOptional(JSONNull)},
+                                                {"sorbet/memoryReport", SorbetMemoryReportParams},
                                             });
     auto RequestMessage =
         makeObject("RequestMessage",
@@ -1361,10 +1429,14 @@ void makeLSPTypes(vector<shared_ptr<JSONClassType>> &enumTypes, vector<shared_pt
                                 // CompletionItem[] | CompletionList | null
                                 // Sorbet only sends CompletionList.
                                 {"textDocument/completion", CompletionList},
+                                {"completionItem/resolve", CompletionItem},
                                 {"textDocument/references", makeVariant({JSONNull, makeArray(Location)})},
                                 {"textDocument/signatureHelp", makeVariant({JSONNull, SignatureHelp})},
                                 {"workspace/symbol", makeVariant({JSONNull, makeArray(SymbolInformation)})},
                                 {"sorbet/error", SorbetErrorParams},
+                                {"sorbet/perfReport", SorbetPerfReport},
+                                {"sorbet/daemonTypecheck", SorbetDaemonTypecheckResult},
+                                {"sorbet/memoryReport", SorbetMemoryReport},
                             });
     // N.B.: ResponseMessage.params must be optional, as it is not present when an error occurs.
     // N.B.: We add a 'requestMethod' field to response messages to make the discriminated union work.
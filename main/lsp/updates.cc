@@ -1,8 +1,11 @@
+#include "ast/substitute/substitute.h"
 #include "ast/treemap/treemap.h"
+#include "ast/treemap/treewalk.h"
 #include "common/Timer.h"
 #include "core/Error.h"
 #include "core/Files.h"
 #include "core/GlobalState.h"
+#include "core/GlobalSubstitution.h"
 #include "core/Names.h"
 #include "core/Unfreeze.h"
 #include "core/errors/internal.h"
@@ -40,82 +43,109 @@ LSPLoop::ShowOperation::~ShowOperation() {
     }
 }
 
-core::FileRef LSPLoop::updateFile(const shared_ptr<core::File> &file) {
-    Timer timeit(logger, "updateFile");
-    core::FileRef fref;
-    if (!file) {
-        return fref;
+vector<core::FileRef> LSPLoop::updateFiles(const vector<shared_ptr<core::File>> &files) {
+    Timer timeit(logger, "updateFiles");
+    vector<core::FileRef> frefs(files.size());
+    vector<core::FileRef> toIndex;
+    {
+        // Only the file table has to be updated one file at a time; indexing the files can then be shared out.
+        core::UnfreezeFileTable fileTableAccess(*initialGS);
+        for (int i = 0; i < files.size(); i++) {
+            if (!files[i]) {
+                continue;
+            }
+            auto fref = initialGS->findFileByPath(files[i]->path());
+            if (fref.exists()) {
+                initialGS = core::GlobalState::replaceFile(move(initialGS), fref, files[i]);
+            } else {
+                fref = initialGS->enterFile(files[i]);
+            }
+            fref.data(*initialGS).strictLevel = pipeline::decideStrictLevel(*initialGS, fref, opts);
+            frefs[i] = fref;
+            toIndex.emplace_back(fref);
+        }
     }
-    fref = initialGS->findFileByPath(file->path());
-    if (fref.exists()) {
-        initialGS = core::GlobalState::replaceFile(move(initialGS), fref, move(file));
+    // A file that changed twice in one batch only needs its latest contents indexed.
+    fast_sort(toIndex);
+    toIndex.erase(unique(toIndex.begin(), toIndex.end()), toIndex.end());
+
+    vector<ast::ParsedFile> trees;
+    if (initialGS->hasAnyDslPlugin()) {
+        // pipeline::index would also index the files that plugins generate, which LSP does not keep trees for.
+        for (auto fref : toIndex) {
+            trees.emplace_back(pipeline::indexOne(opts, *initialGS, fref, kvstore));
+        }
     } else {
-        fref = initialGS->enterFile(move(file));
+        trees = pipeline::index(initialGS, toIndex, opts, workers, kvstore);
     }
-
-    fref.data(*initialGS).strictLevel = pipeline::decideStrictLevel(*initialGS, fref, opts);
-    auto t = pipeline::indexOne(opts, *initialGS, fref, kvstore);
-    int id = t.file.id();
-    if (id >= indexed.size()) {
-        indexed.resize(id + 1);
+    for (auto &t : trees) {
+        int id = t.file.id();
+        if (id >= indexed.size()) {
+            indexed.resize(id + 1);
+        }
+        indexed[id] = move(t);
+        evictedTrees.erase(id);
     }
-    indexed[id] = move(t);
-    return fref;
+    return frefs;
 }
 
 vector<core::FileHash> LSPLoop::computeStateHashes(const vector<shared_ptr<core::File>> &files) {
     Timer timeit(logger, "computeStateHashes");
-    vector<core::FileHash> res(files.size());
-    shared_ptr<ConcurrentBoundedQueue<int>> fileq = make_shared<ConcurrentBoundedQueue<int>>(files.size());
-    for (int i = 0; i < files.size(); i++) {
-        auto copy = i;
-        fileq->push(move(copy), 1);
-    }
-
-    logger->debug("Computing state hashes for {} files", files.size());
-
-    res.resize(files.size());
-
-    shared_ptr<BlockingBoundedQueue<vector<pair<int, core::FileHash>>>> resultq =
-        make_shared<BlockingBoundedQueue<vector<pair<int, core::FileHash>>>>(files.size());
-    workers.multiplexJob("lspStateHash", [fileq, resultq, files, logger = this->logger]() {
-        vector<pair<int, core::FileHash>> threadResult;
-        int processedByThread = 0;
-        int job;
-        options::Options emptyOpts;
-        emptyOpts.runLSP = true;
-
-        {
-            for (auto result = fileq->try_pop(job); !result.done(); result = fileq->try_pop(job)) {
-                if (result.gotItem()) {
-                    processedByThread++;
+    return pipeline::computeFileHashes(*initialGS, files, *logger, workers, kvstore);
+}
 
-                    if (!files[job]) {
-                        threadResult.emplace_back(job, core::FileHash{});
-                        continue;
-                    }
-                    auto hash = pipeline::computeFileHash(files[job], *logger);
-                    threadResult.emplace_back(job, move(hash));
-                }
-            }
+namespace {
+void rememberFileHash(vector<pair<array<u1, 16>, core::FileHash>> &versions, const array<u1, 16> &contents,
+                      core::FileHash hash) {
+    constexpr int VERSIONS_PER_PATH = 2;
+    for (auto it = versions.begin(); it != versions.end(); ++it) {
+        if (it->first == contents) {
+            versions.erase(it);
+            break;
         }
+    }
+    versions.emplace(versions.begin(), contents, move(hash));
+    if (versions.size() > VERSIONS_PER_PATH) {
+        versions.pop_back();
+    }
+}
+} // namespace
 
-        if (processedByThread > 0) {
-            resultq->push(move(threadResult), processedByThread);
+vector<core::FileHash> LSPLoop::computeChangedFileHashes(const vector<shared_ptr<core::File>> &files) {
+    Timer timeit(logger, "computeChangedFileHashes");
+    vector<core::FileHash> res(files.size());
+    vector<array<u1, 16>> contents(files.size());
+    vector<int> missing;
+    vector<shared_ptr<core::File>> missingFiles;
+    for (int i = 0; i < files.size(); i++) {
+        if (!files[i]) {
+            continue;
+        }
+        auto &versions = recentFileHashes[files[i]->path()];
+        // Remember the version being replaced, so that changing the file back finds its hash.
+        auto fref = initialGS->findFileByPath(files[i]->path());
+        if (fref.exists() && fref.id() < globalStateHashes.size()) {
+            rememberFileHash(versions, fref.data(*initialGS).contentHash(), globalStateHashes[fref.id()]);
         }
-    });
 
-    {
-        vector<pair<int, core::FileHash>> threadResult;
-        for (auto result = resultq->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), *logger); !result.done();
-             result = resultq->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), *logger)) {
-            if (result.gotItem()) {
-                for (auto &a : threadResult) {
-                    res[a.first] = move(a.second);
-                }
-            }
+        contents[i] = files[i]->contentHash();
+        auto fnd = std::find_if(versions.begin(), versions.end(),
+                                [&](const auto &version) { return version.first == contents[i]; });
+        if (fnd != versions.end()) {
+            prodCounterInc("lsp.file_hash.cache.hit");
+            res[i] = fnd->second;
+        } else {
+            missing.emplace_back(i);
+            missingFiles.emplace_back(files[i]);
         }
     }
+
+    auto computed = computeStateHashes(missingFiles);
+    for (int i = 0; i < missing.size(); i++) {
+        auto idx = missing[i];
+        rememberFileHash(recentFileHashes[files[idx]->path()], contents[idx], computed[i]);
+        res[idx] = move(computed[i]);
+    }
     return res;
 }
 
@@ -123,6 +153,7 @@ void LSPLoop::reIndexFromFileSystem() {
     ShowOperation op(*this, "Indexing", "Indexing files...");
     Timer timeit(logger, "reIndexFromFileSystem");
     indexed.clear();
+    evictedTrees.clear();
     vector<core::FileRef> inputFiles = pipeline::reserveFiles(initialGS, opts.inputFileNames);
     for (auto &t : pipeline::index(initialGS, inputFiles, opts, workers, kvstore)) {
         int id = t.file.id();
@@ -131,6 +162,50 @@ void LSPLoop::reIndexFromFileSystem() {
         }
         indexed[id] = move(t);
     }
+    namesAfterCompaction = initialGS->namesUsed();
+}
+
+const ast::ParsedFile &LSPLoop::getIndexed(core::FileRef file) {
+    const int id = file.id();
+    if (evictedTrees.erase(id) > 0) {
+        prodCounterInc("lsp.trees.reindexed");
+        indexed[id] = pipeline::indexOne(opts, *initialGS, file, kvstore);
+    }
+    return indexed[id];
+}
+
+void LSPLoop::evictColdTrees(const core::GlobalState &gs) {
+    if (opts.lspTreeCacheMB == 0) {
+        return;
+    }
+    const size_t budget = (size_t)opts.lspTreeCacheMB * 1024 * 1024;
+    size_t cached = 0;
+    vector<pair<u4, int>> candidates;
+    for (auto &tree : indexed) {
+        if (tree.tree == nullptr || !tree.file.exists()) {
+            continue;
+        }
+        const int id = tree.file.id();
+        cached += tree.file.data(gs).source().size();
+        // Open files are edited often, so their trees are worth keeping regardless of age.
+        if (!openFiles.contains(string(tree.file.data(gs).path()))) {
+            candidates.emplace_back(id < treeLastUsed.size() ? treeLastUsed[id] : 0, id);
+        }
+    }
+    fast_sort(candidates);
+    int evicted = 0;
+    for (auto &candidate : candidates) {
+        if (cached <= budget) {
+            break;
+        }
+        auto &tree = indexed[candidate.second];
+        cached -= tree.file.data(gs).source().size();
+        tree.tree = nullptr;
+        evictedTrees.insert(candidate.second);
+        evicted++;
+    }
+    prodCounterAdd("lsp.trees.evicted", evicted);
+    prodHistogramInc("lsp.trees.cached_source_mb", cached / (1024 * 1024));
 }
 
 void tryApplyLocalVarSaver(const core::GlobalState &gs, vector<ast::ParsedFile> &indexedCopies) {
@@ -140,19 +215,46 @@ void tryApplyLocalVarSaver(const core::GlobalState &gs, vector<ast::ParsedFile>
     for (auto &t : indexedCopies) {
         LocalVarSaver localVarSaver;
         core::Context ctx(gs, core::Symbols::root());
-        t.tree = ast::TreeMap::apply(ctx, localVarSaver, move(t.tree));
+        ast::TreeWalk::apply(ctx, localVarSaver, t.tree.get());
     }
 }
 
 void tryApplyDefLocSaver(const core::GlobalState &gs, vector<ast::ParsedFile> &indexedCopies) {
-    if (gs.lspQuery.kind != core::lsp::Query::Kind::LOC && gs.lspQuery.kind != core::lsp::Query::Kind::SYMBOL) {
+    if (gs.lspQuery.kind != core::lsp::Query::Kind::LOC && gs.lspQuery.kind != core::lsp::Query::Kind::SYMBOL &&
+        gs.lspQuery.kind != core::lsp::Query::Kind::REFERENCES &&
+        gs.lspQuery.kind != core::lsp::Query::Kind::EVERY_LOC) {
         return;
     }
     for (auto &t : indexedCopies) {
         DefLocSaver defLocSaver;
         core::Context ctx(gs, core::Symbols::root());
-        t.tree = ast::TreeMap::apply(ctx, defLocSaver, move(t.tree));
+        ast::TreeWalk::apply(ctx, defLocSaver, t.tree.get());
+    }
+}
+
+void LSPLoop::compactNames() {
+    // A query may hold names of initialGS.
+    if (opts.lspCompactNamesPercent == 0 || !initialGS->lspQuery.isEmpty() ||
+        (u8)initialGS->namesUsed() * 100 < (u8)namesAfterCompaction * (100 + opts.lspCompactNamesPercent)) {
+        return;
+    }
+    Timer timeit(logger, "compact_names");
+    auto compacted = initialGS->copyWithNamesBelow(namesBeforeIndexing);
+    {
+        core::LazyGlobalSubstitution subst(*initialGS, *compacted);
+        core::UnfreezeNameTable nameTableAccess(*compacted);
+        core::MutableContext ctx(*compacted, core::Symbols::root());
+        // Evicted trees are indexed again with the compacted state when they are needed.
+        for (auto &tree : indexed) {
+            if (tree.tree != nullptr) {
+                tree.tree = ast::Substitute::run(ctx, subst, move(tree.tree));
+            }
+        }
     }
+    prodCounterAdd("lsp.names.compacted", initialGS->namesUsed() - compacted->namesUsed());
+    logger->debug("Compacted the name table from {} to {} names", initialGS->namesUsed(), compacted->namesUsed());
+    initialGS = move(compacted);
+    namesAfterCompaction = initialGS->namesUsed();
 }
 
 LSPLoop::TypecheckRun LSPLoop::runSlowPath() {
@@ -161,17 +263,31 @@ LSPLoop::TypecheckRun LSPLoop::runSlowPath() {
     ENFORCE(initialGS->errorQueue->isEmpty());
     prodCategoryCounterInc("lsp.updates", "slowpath");
     logger->debug("Taking slow path");
+    // The slow path copies every tree anyway, and starts over from initialGS.
+    compactNames();
 
     vector<ast::ParsedFile> indexedCopies;
-    for (const auto &tree : indexed) {
+    for (int i = 0; i < indexed.size(); i++) {
+        const auto &tree = evictedTrees.contains(i) ? getIndexed(core::FileRef(i)) : indexed[i];
         if (tree.tree) {
             indexedCopies.emplace_back(ast::ParsedFile{tree.tree->deepCopy(), tree.file});
         }
     }
 
     auto finalGs = initialGS->deepCopy(true);
-    // Discard indexed trees from old version of finalGS.
+    // Discard indexed trees from old version of finalGS, and the references recorded against its symbols.
     indexedFinalGS.clear();
+    referencesByFile.clear();
+    responsesByFile.clear();
+    symbolNameIndex = SymbolNameIndex();
+    methodTables.clear();
+    lastCompletion.methods.clear();
+    symbolsByFile.clear();
+    symbolsByFileCount = 0;
+    slowPathCanceled = false;
+    bool superseded = false;
+    auto isSuperseded = [&]() -> bool { return superseded = superseded || slowPathSuperseded(); };
+
     auto resolved = pipeline::resolve(finalGs, move(indexedCopies), opts, workers, skipConfigatron);
     tryApplyDefLocSaver(*finalGs, resolved);
     tryApplyLocalVarSaver(*finalGs, resolved);
@@ -180,18 +296,121 @@ LSPLoop::TypecheckRun LSPLoop::runSlowPath() {
         ENFORCE(tree.file.exists());
         affectedFiles.push_back(tree.file);
     }
-    pipeline::typecheck(finalGs, move(resolved), opts, workers);
+    // Errors of the files typechecked so far, by file. Without a query, every file's diagnostics are published as
+    // soon as it is done, instead of at the end of the slow path; the final run publishes them again, which leaves them
+    // as they are.
+    UnorderedMap<core::FileRef, vector<unique_ptr<core::Error>>> reportedErrors;
+    auto collectReportedErrors = [&](bool publish) {
+        auto flushed = initialGS->errorQueue->drainFlushedErrors();
+        for (auto &e : flushed.second) {
+            reportedErrors[e->loc.file()].push_back(move(e));
+        }
+        auto &files = flushed.first;
+        fast_sort(files);
+        files.erase(unique(files.begin(), files.end()), files.end());
+        // Only runLSP sends messages anywhere; other callers get the final run's diagnostics only.
+        if (!publish || files.empty() || queueMutex == nullptr) {
+            return;
+        }
+        vector<unique_ptr<core::Error>> published;
+        for (auto file : files) {
+            auto fnd = reportedErrors.find(file);
+            if (fnd != reportedErrors.end()) {
+                for (auto &e : fnd->second) {
+                    published.push_back(make_unique<core::Error>(*e));
+                }
+            }
+        }
+        sendMessages(diagnosticsFor(*finalGs, files, move(published)));
+    };
+    if (!initialGS->lspQuery.isEmpty()) {
+        if (!isSuperseded()) {
+            pipeline::typecheck(finalGs, move(resolved), opts, workers, isSuperseded);
+        }
+    } else {
+        // Errors from resolving are published with those of typechecking, once the file they are in is done.
+        collectReportedErrors(false);
+        auto onProgress = [&]() { collectReportedErrors(true); };
+        // The files open in the editor go first, so that the user doesn't look at stale errors while the rest of the
+        // codebase is typechecked.
+        auto firstClosed = stable_partition(resolved.begin(), resolved.end(), [&](const auto &tree) -> bool {
+            return openFiles.contains(string(tree.file.data(*finalGs).path()));
+        });
+        vector<ast::ParsedFile> openTrees(make_move_iterator(resolved.begin()), make_move_iterator(firstClosed));
+        resolved.erase(resolved.begin(), firstClosed);
+        if (!openTrees.empty() && !isSuperseded()) {
+            pipeline::typecheck(finalGs, move(openTrees), opts, workers, isSuperseded, onProgress);
+            collectReportedErrors(true);
+        }
+        if (!isSuperseded()) {
+            pipeline::typecheck(finalGs, move(resolved), opts, workers, isSuperseded, onProgress);
+        }
+    }
+    if (superseded) {
+        // The edit that is next in line starts another slow path, which will include these changes as well. Until
+        // then, the errors so far are incomplete, so leave the reported ones alone.
+        logger->debug("Canceling slow path for a newer edit");
+        prodCategoryCounterInc("lsp.updates", "slowpath_canceled");
+        initialGS->errorQueue->drainWithQueryResponses();
+        slowPathCanceled = true;
+        return TypecheckRun{{}, {}, {}, move(finalGs), false};
+    }
     auto out = initialGS->errorQueue->drainWithQueryResponses();
+    for (auto &file : reportedErrors) {
+        out.first.insert(out.first.end(), make_move_iterator(file.second.begin()),
+                         make_move_iterator(file.second.end()));
+    }
     finalGs->lspTypecheckCount++;
+    evictColdTrees(*initialGS);
     return TypecheckRun{move(out.first), move(affectedFiles), move(out.second), move(finalGs), false};
 }
 
+bool LSPLoop::slowPathSuperseded() {
+    if (queueMutex == nullptr || !initialized || !initialGS->lspQuery.isEmpty()) {
+        return false;
+    }
+    absl::MutexLock lck(queueMutex); // guards queueState
+    for (auto &msg : queueState->pendingRequests) {
+        if (msg->isDelayable()) {
+            continue;
+        }
+        switch (msg->method()) {
+            case LSPMethod::TextDocumentDidOpen:
+            case LSPMethod::TextDocumentDidChange:
+            case LSPMethod::TextDocumentDidClose:
+            case LSPMethod::SorbetWorkspaceEdit:
+            case LSPMethod::SorbetWatchmanFileChange:
+                return true;
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+namespace {
+// True if `after` still has every definition that `before` had, unchanged: the edit only added classes, constants or
+// methods.
+bool onlyAddsDefinitions(const core::GlobalStateHash &before, const core::GlobalStateHash &after) {
+    if (before.hierarchyHash == core::GlobalStateHash::HASH_STATE_INVALID ||
+        after.hierarchyHash == core::GlobalStateHash::HASH_STATE_INVALID) {
+        return false;
+    }
+    return std::includes(after.definitionShapes.begin(), after.definitionShapes.end(),
+                         before.definitionShapes.begin(), before.definitionShapes.end());
+}
+} // namespace
+
 bool LSPLoop::canTakeFastPath(const vector<shared_ptr<core::File>> &changedFiles,
                               const vector<core::FileHash> &hashes) const {
     if (disableFastPath) {
         logger->debug("Taking sad path because happy path is disabled.");
         return false;
     }
+    if (slowPathCanceled) {
+        logger->debug("Taking sad path because the last slow path was canceled.");
+        return false;
+    }
     logger->debug("Trying to see if happy path is available after {} file changes", changedFiles.size());
 
     ENFORCE(changedFiles.size() == hashes.size());
@@ -209,6 +428,10 @@ bool LSPLoop::canTakeFastPath(const vector<shared_ptr<core::File>> &changedFiles
                 ENFORCE(oldHash.definitions.hierarchyHash != core::GlobalStateHash::HASH_STATE_NOT_COMPUTED);
                 if (hashes[i].definitions.hierarchyHash != core::GlobalStateHash::HASH_STATE_INVALID &&
                     hashes[i].definitions.hierarchyHash != oldHash.definitions.hierarchyHash) {
+                    if (opts.lspAdditiveFastPath && onlyAddsDefinitions(oldHash.definitions, hashes[i].definitions)) {
+                        logger->debug("{} only adds definitions", changedFiles[i]->path());
+                        continue;
+                    }
                     logger->debug("Taking sad path because {} has changed definitions", changedFiles[i]->path());
                     return false;
                 }
@@ -223,50 +446,73 @@ LSPLoop::TypecheckRun LSPLoop::tryFastPath(unique_ptr<core::GlobalState> gs,
                                            const vector<core::FileRef> &filesForQuery) {
     auto finalGs = move(gs);
     // We assume finalGs is a copy of initialGS, which has had the inferencer & resolver run.
-    ENFORCE(finalGs->lspTypecheckCount > 0,
+    // After a canceled slow path, finalGs may not even be resolved; canTakeFastPath sends us to the slow path then.
+    ENFORCE(finalGs->lspTypecheckCount > 0 || slowPathCanceled,
             "Tried to run fast path with a GlobalState object that never had inferencer and resolver runs.");
     logger->debug("Trying to see if happy path is available after {} file changes", changedFiles.size());
 
+    if (!changedFiles.empty()) {
+        // Cached responses carry types and locations from other files, which any edit can change.
+        responsesByFile.clear();
+    }
+
     bool takeFastPath = false;
     vector<core::FileRef> subset;
     vector<core::NameHash> changedHashes;
+    // The names of the definitions that edits added, when canTakeFastPath let them through.
+    vector<core::NameHash> addedNames;
     {
         Timer timeit(logger, "fast_path_decision");
-        auto hashes = computeStateHashes(changedFiles);
+        auto hashes = computeChangedFileHashes(changedFiles);
         ENFORCE(changedFiles.size() == hashes.size());
         takeFastPath = canTakeFastPath(changedFiles, hashes);
 
+        auto frefs = updateFiles(changedFiles);
         int i = -1;
-        {
-            core::UnfreezeFileTable fileTableAccess(*initialGS);
-            for (auto &f : changedFiles) {
-                ++i;
-                auto fref = updateFile(f);
-                if (globalStateHashes.size() <= fref.id()) {
-                    // New file
-                    ENFORCE(!takeFastPath);
-                    globalStateHashes.resize(fref.id() + 1);
-                } else if (takeFastPath) {
-                    // Existing file on fast path
-                    auto &oldHash = globalStateHashes[fref.id()];
-                    for (auto &p : hashes[i].definitions.methodHashes) {
-                        auto fnd = oldHash.definitions.methodHashes.find(p.first);
-                        ENFORCE(fnd != oldHash.definitions.methodHashes.end(), "definitionHash should have failed");
-                        if (fnd->second != p.second) {
-                            changedHashes.emplace_back(p.first);
-                        }
+        for (auto fref : frefs) {
+            ++i;
+            if (globalStateHashes.size() <= fref.id()) {
+                // New file
+                ENFORCE(!takeFastPath);
+                globalStateHashes.resize(fref.id() + 1);
+            } else if (takeFastPath) {
+                // Existing file on fast path
+                auto &oldHash = globalStateHashes[fref.id()];
+                const bool addsDefinitions =
+                    hashes[i].definitions.hierarchyHash != core::GlobalStateHash::HASH_STATE_INVALID &&
+                    hashes[i].definitions.hierarchyHash != oldHash.definitions.hierarchyHash;
+                for (auto &p : hashes[i].definitions.methodHashes) {
+                    auto fnd = oldHash.definitions.methodHashes.find(p.first);
+                    ENFORCE(fnd != oldHash.definitions.methodHashes.end() || addsDefinitions,
+                            "definitionHash should have failed");
+                    if (fnd == oldHash.definitions.methodHashes.end() || fnd->second != p.second) {
+                        changedHashes.emplace_back(p.first);
+                    }
+                }
+                if (addsDefinitions) {
+                    vector<pair<u4, core::NameHash>> added;
+                    const auto &before = oldHash.definitions.definitionShapes;
+                    const auto &after = hashes[i].definitions.definitionShapes;
+                    std::set_difference(after.begin(), after.end(), before.begin(), before.end(),
+                                        std::back_inserter(added));
+                    for (auto &shape : added) {
+                        addedNames.emplace_back(shape.second);
                     }
-                    finalGs = core::GlobalState::replaceFile(move(finalGs), fref, changedFiles[i]);
-                    subset.emplace_back(fref);
                 }
-                globalStateHashes[fref.id()] = hashes[i];
+                finalGs = core::GlobalState::replaceFile(move(finalGs), fref, changedFiles[i]);
+                subset.emplace_back(fref);
             }
-            core::NameHash::sortAndDedupe(changedHashes);
+            globalStateHashes[fref.id()] = hashes[i];
         }
+        core::NameHash::sortAndDedupe(changedHashes);
+        core::NameHash::sortAndDedupe(addedNames);
     }
 
     if (takeFastPath) {
         Timer timeit(logger, "fast_path");
+        // Only the edited files need to be indexed again. The trees of everything else already use finalGs's names.
+        auto edited = subset;
+        fast_sort(edited);
         int i = -1;
         for (auto &oldHash : globalStateHashes) {
             i++;
@@ -278,30 +524,59 @@ LSPLoop::TypecheckRun LSPLoop::tryFastPath(unique_ptr<core::GlobalState> gs,
                 logger->debug("Added {} to update set as used a changed method",
                               !ref.exists() ? "" : ref.data(*finalGs).path());
                 subset.emplace_back(ref);
+                continue;
+            }
+            // A new constant may be what a constant in this file resolves to now.
+            std::set_intersection(addedNames.begin(), addedNames.end(), oldHash.usages.constants.begin(),
+                                  oldHash.usages.constants.end(), std::back_inserter(intersection));
+            if (!intersection.empty()) {
+                auto ref = core::FileRef(i);
+                logger->debug("Added {} to update set as used an added constant",
+                              !ref.exists() ? "" : ref.data(*finalGs).path());
+                subset.emplace_back(ref);
             }
         }
+        if (!addedNames.empty()) {
+            // New methods may show up in the tables of classes that already had one.
+            prodCategoryCounterInc("lsp.updates", "fastpath_added_definitions");
+            methodTables.clear();
+        }
         // Remove any duplicate files.
         fast_sort(subset);
         subset.resize(std::distance(subset.begin(), std::unique(subset.begin(), subset.end())));
+        // The references in these files may resolve differently now.
+        for (auto &f : subset) {
+            referencesByFile.erase(f.id());
+        }
 
         prodCategoryCounterInc("lsp.updates", "fastpath");
         logger->debug("Taking fast path");
         ENFORCE(initialGS->errorQueue->isEmpty());
         vector<ast::ParsedFile> updatedIndexed;
         for (auto &f : subset) {
-            auto t = pipeline::indexOne(opts, *finalGs, f, kvstore);
-            const int id = t.file.id();
-            indexedFinalGS[id] = move(t);
-            updatedIndexed.emplace_back(ast::ParsedFile{indexedFinalGS[id].tree->deepCopy(), indexedFinalGS[id].file});
+            const int id = f.id();
+            if (std::binary_search(edited.begin(), edited.end(), f)) {
+                indexedFinalGS[id] = pipeline::indexOne(opts, *finalGs, f, kvstore);
+            }
+            const auto it = indexedFinalGS.find(id);
+            const auto &parsedFile = it == indexedFinalGS.end() ? getIndexed(f) : it->second;
+            updatedIndexed.emplace_back(ast::ParsedFile{parsedFile.tree->deepCopy(), parsedFile.file});
         }
 
         for (auto &f : filesForQuery) {
             const int id = f.id();
             const auto it = indexedFinalGS.find(id);
-            const auto &parsedFile = it == indexedFinalGS.end() ? indexed[id] : it->second;
+            const auto &parsedFile = it == indexedFinalGS.end() ? getIndexed(f) : it->second;
             updatedIndexed.emplace_back(ast::ParsedFile{parsedFile.tree->deepCopy(), parsedFile.file});
         }
         subset.insert(subset.end(), filesForQuery.begin(), filesForQuery.end());
+        treeUseClock++;
+        for (auto &f : subset) {
+            if (f.id() >= treeLastUsed.size()) {
+                treeLastUsed.resize(f.id() + 1);
+            }
+            treeLastUsed[f.id()] = treeUseClock;
+        }
 
         auto resolved = pipeline::incrementalResolve(*finalGs, move(updatedIndexed), opts);
         tryApplyDefLocSaver(*finalGs, resolved);
@@ -309,6 +584,7 @@ LSPLoop::TypecheckRun LSPLoop::tryFastPath(unique_ptr<core::GlobalState> gs,
         pipeline::typecheck(finalGs, move(resolved), opts, workers);
         auto out = initialGS->errorQueue->drainWithQueryResponses();
         finalGs->lspTypecheckCount++;
+        evictColdTrees(*initialGS);
         return TypecheckRun{move(out.first), move(subset), move(out.second), move(finalGs), true};
     } else {
         return runSlowPath();
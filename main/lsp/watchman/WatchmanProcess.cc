@@ -2,11 +2,17 @@
 #include "common/FileOps.h"
 #include "rapidjson/document.h"
 #include "subprocess.hpp"
+#include <chrono>
 
 using namespace std;
 
 namespace sorbet::realmain::lsp::watchman {
 
+namespace {
+constexpr int COALESCE_QUIET_MS = 20;
+constexpr int COALESCE_MAX_MS = 250;
+} // namespace
+
 WatchmanProcess::WatchmanProcess(shared_ptr<spdlog::logger> logger, string_view watchmanPath, string_view workSpace,
                                  vector<string> extensions,
                                  function<void(unique_ptr<sorbet::realmain::lsp::WatchmanQueryResponse>)> processUpdate,
@@ -55,9 +61,23 @@ void WatchmanProcess::start() {
         auto fd = fileno(file);
 
         string buffer;
+        // Updates that arrive in a burst (e.g. from `git checkout`) are coalesced into one, which is sent once Watchman
+        // goes quiet for COALESCE_QUIET_MS or the burst has lasted COALESCE_MAX_MS.
+        unique_ptr<sorbet::realmain::lsp::WatchmanQueryResponse> pending;
+        chrono::steady_clock::time_point pendingSince;
+        auto flushPending = [&]() -> void {
+            fast_sort(pending->files);
+            pending->files.erase(unique(pending->files.begin(), pending->files.end()), pending->files.end());
+            processUpdate(move(pending));
+            pending = nullptr;
+        };
 
         while (!isStopped()) {
-            auto maybeLine = FileOps::readLineFromFd(fd, buffer);
+            auto maybeLine = FileOps::readLineFromFd(fd, buffer, pending ? COALESCE_QUIET_MS : 100);
+            if (pending && (!maybeLine || chrono::steady_clock::now() - pendingSince >
+                                              chrono::milliseconds(COALESCE_MAX_MS))) {
+                flushPending();
+            }
             if (!maybeLine) {
                 // Timeout occurred. See if we should abort before reading further.
                 continue;
@@ -73,7 +93,13 @@ void WatchmanProcess::start() {
             } else if (d.HasMember("is_fresh_instance")) {
                 try {
                     auto queryResponse = sorbet::realmain::lsp::WatchmanQueryResponse::fromJSONValue(d);
-                    processUpdate(move(queryResponse));
+                    if (pending) {
+                        pending->files.insert(pending->files.end(), make_move_iterator(queryResponse->files.begin()),
+                                              make_move_iterator(queryResponse->files.end()));
+                    } else {
+                        pending = move(queryResponse);
+                        pendingSince = chrono::steady_clock::now();
+                    }
                 } catch (sorbet::realmain::lsp::DeserializationError e) {
                     // Gracefully handle deserialization errors, since they could be our fault.
                     logger->error("Unable to deserialize Watchman request: {}\nOriginal request:\n{}", e.what(), line);
@@ -3,6 +3,7 @@
 #include "yaml-cpp/yaml.h"
 #include <cxxopts.hpp>
 
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_split.h"
 #include "common/FileOps.h"
 #include "common/Timer.h"
@@ -39,15 +40,18 @@ const vector<PrintOptions> print_options({
     {"symbol-table", &Printers::SymbolTable, true},
     {"symbol-table-raw", &Printers::SymbolTableRaw, true},
     {"symbol-table-json", &Printers::SymbolTableJson, true},
+    {"symbol-table-proto", &Printers::SymbolTableProto, true},
     {"symbol-table-full", &Printers::SymbolTableFull, true},
     {"symbol-table-full-raw", &Printers::SymbolTableFullRaw, true},
     {"symbol-table-full-json", &Printers::SymbolTableFullJson, true},
+    {"symbol-table-full-proto", &Printers::SymbolTableFullProto, true},
     {"name-tree", &Printers::NameTree, true},
     {"name-tree-raw", &Printers::NameTreeRaw, true},
     {"file-table-json", &Printers::FileTableJson, true},
     {"resolve-tree", &Printers::ResolveTree, true},
     {"resolve-tree-raw", &Printers::ResolveTreeRaw, true},
     {"missing-constants", &Printers::MissingConstants, true},
+    {"file-deps", &Printers::FileDeps, true},
     {"flattened-tree", &Printers::FlattenedTree, true},
     {"flattened-tree-raw", &Printers::FlattenedTreeRaw, true},
     {"cfg", &Printers::CFG, true},
@@ -73,11 +77,53 @@ void PrinterConfig::print(const string_view &contents) const {
     }
 };
 
+void PrinterConfig::printUnbuffered(const string_view &contents) const {
+    if (outputPath.empty()) {
+        fmt::print("{}", contents);
+        return;
+    }
+    absl::MutexLock lck(&state->mutex);
+    ENFORCE(state->buf.size() == 0, "printUnbuffered can't be mixed with print");
+    if (state->unbuffered == nullptr) {
+        state->unbuffered = std::fopen(outputPath.c_str(), "wb");
+        if (state->unbuffered == nullptr) {
+            throw FileNotFoundException();
+        }
+    }
+    fwrite(contents.data(), sizeof(char), contents.size(), state->unbuffered);
+};
+
+void PrinterConfig::printForFile(u4 fileId, string contents) const {
+    absl::MutexLock lck(&state->mutex);
+    state->byFile.emplace_back(fileId, move(contents));
+}
+
+void PrinterConfig::printFilesInOrder() const {
+    vector<pair<u4, string>> byFile;
+    {
+        absl::MutexLock lck(&state->mutex);
+        byFile = move(state->byFile);
+        state->byFile.clear();
+    }
+    fast_sort(byFile, [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+    for (auto &entry : byFile) {
+        print(entry.second);
+    }
+}
+
 void PrinterConfig::flush() {
+    if (enabled) {
+        printFilesInOrder();
+    }
     if (!enabled || !supportsFlush || outputPath.empty()) {
         return;
     }
     absl::MutexLock lck(&state->mutex);
+    if (state->unbuffered != nullptr) {
+        fclose(state->unbuffered);
+        state->unbuffered = nullptr;
+        return;
+    }
     FileOps::write(outputPath, to_string(state->buf));
 };
 
@@ -95,6 +141,7 @@ vector<reference_wrapper<PrinterConfig>> Printers::printers() {
         SymbolTable,
         SymbolTableRaw,
         SymbolTableJson,
+        SymbolTableProto,
         SymbolTableFull,
         SymbolTableFullRaw,
         NameTree,
@@ -103,6 +150,7 @@ vector<reference_wrapper<PrinterConfig>> Printers::printers() {
         ResolveTree,
         ResolveTreeRaw,
         MissingConstants,
+        FileDeps,
         FlattenedTree,
         FlattenedTreeRaw,
         CFG,
@@ -230,6 +278,7 @@ static vector<string> extractExtraSubprocessOptions(const YAML::Node &config, co
 struct DslConfiguration {
     UnorderedMap<string, string> triggers;
     vector<string> rubyExtraArgs;
+    bool resident;
 };
 
 DslConfiguration extractDslPlugins(string filePath, shared_ptr<spdlog::logger> logger) {
@@ -265,10 +314,19 @@ DslConfiguration extractDslPlugins(string filePath, shared_ptr<spdlog::logger> l
         logger->error("{}: Required key `triggers` must be a map", filePath);
         good = false;
     }
+    bool resident = false;
+    if (auto residentNode = config["resident"]) {
+        try {
+            resident = residentNode.as<bool>();
+        } catch (YAML::BadConversion) {
+            logger->error("{}: `resident` must be a boolean", filePath);
+            good = false;
+        }
+    }
     if (!good) {
         throw EarlyReturnWithCode(1);
     }
-    return {triggers, extractExtraSubprocessOptions(config, filePath, logger)};
+    return {triggers, extractExtraSubprocessOptions(config, filePath, logger), resident};
 }
 
 cxxopts::Options buildOptions() {
@@ -306,6 +364,14 @@ cxxopts::Options buildOptions() {
                                     cxxopts::value<vector<string>>(), "path");
     options.add_options("advanced")("web-trace-file", "Web trace file. For use with chrome about://tracing",
                                     cxxopts::value<string>()->default_value(empty.webTraceFile), "file");
+    options.add_options("advanced")("web-trace-stream",
+                                    "Append spans to the web trace file while running, instead of all of them at exit");
+    options.add_options("advanced")(
+        "web-trace-sample", "With --web-trace-stream, only keep every n-th span of a timer after its first 1000",
+        cxxopts::value<int>()->default_value(to_string(empty.webTraceSample)), "n");
+    options.add_options("advanced")("profile-files",
+                                    "Write a CSV of the time each phase spent on every file, most expensive first",
+                                    cxxopts::value<string>()->default_value(empty.profileFiles), "file");
     options.add_options("advanced")("debug-log-file", "Path to debug log file",
                                     cxxopts::value<string>()->default_value(empty.debugLogFile), "file");
     options.add_options("advanced")("reserve-mem-kb",
@@ -325,6 +391,15 @@ cxxopts::Options buildOptions() {
     options.add_options("advanced")("color", "Use color output", cxxopts::value<string>()->default_value("auto"),
                                     "{always,never,[auto]}");
     options.add_options("advanced")("lsp", "Start in language-server-protocol mode");
+    options.add_options("advanced")(
+        "daemon-socket",
+        "With --lsp, keep typechecking as files change and answer requests for errors on this Unix socket. Without "
+        "--lsp, print the errors of the daemon on this socket, or typecheck as usual if none is running",
+        cxxopts::value<string>()->default_value(empty.daemonSocket), "path");
+    options.add_options("advanced")(
+        "lsp-record-session",
+        "With --lsp, record every message the editor sends, and when, to this file. test/lsp_replay replays them",
+        cxxopts::value<string>()->default_value(empty.lspRecordSession), "path");
     options.add_options("advanced")("no-config", "Do not load the content of the `sorbet/config` file");
     options.add_options("advanced")("disable-watchman",
                                     "When in language-server-protocol mode, disable file watching via Watchman");
@@ -380,6 +455,10 @@ cxxopts::Options buildOptions() {
                                     "Error URL base string. If set, error URLs are generated by prefixing the "
                                     "error code with this string.",
                                     cxxopts::value<string>()->default_value(empty.errorUrlBase), "url-base");
+    options.add_options("advanced")("error-format",
+                                    "How to print errors: `text`, or `proto` to write each error to stdout as a "
+                                    "varint-length-delimited com.stripe.rubytyper.Error message",
+                                    cxxopts::value<string>()->default_value(empty.errorFormat), "{text,proto}");
     // Developer options
     options.add_options("dev")("p,print", to_string(all_prints), cxxopts::value<vector<string>>(), "type");
     options.add_options("dev")("autogen-subclasses-parent",
@@ -393,6 +472,29 @@ cxxopts::Options buildOptions() {
                                cxxopts::value<string>()->default_value("inferencer"), "phase");
     options.add_options("dev")("no-stdlib", "Do not load included rbi files for stdlib");
     options.add_options("dev")("skip-dsl-passes", "Do not run DSL passess");
+    options.add_options("dev")("fuse-dsl-local-vars",
+                               "Run the DSL passes and local variable resolution in one walk over each tree");
+    options.add_options("dev")("index-definitions-only",
+                               "Keep only the constant references, global variables and instance variable "
+                               "declarations of the method bodies of files below `typed: true`, which is all namer "
+                               "and resolver use of them");
+    options.add_options("dev")("stdin-stream",
+                               "Read Ruby documents from stdin, each after a line with its length in bytes, and "
+                               "typecheck each one against the input files. Each document's errors are written to "
+                               "stdout, framed the same way");
+    options.add_options("dev")("optimize-cfg",
+                               "Remove constant loads that nothing reads from each method's CFG, and the blocks that "
+                               "leaves empty, before inference");
+    options.add_options("dev")("parse-chunk-lines",
+                               "Parse large files made of top-level classes and modules as chunks of at least this "
+                               "many lines, in parallel (0 to parse every file as a whole)",
+                               cxxopts::value<int>()->default_value("0"), "lines");
+    options.add_options("dev")("release-typechecked-trees",
+                               "Free each tree as soon as it is typechecked instead of when Sorbet exits, so that "
+                               "memory use does not grow with the number of files");
+    options.add_options("dev")("skip-synthesized-accessor-bodies",
+                               "Do not typecheck the placeholder bodies of the prop and struct accessors that Sorbet "
+                               "synthesizes; only their sigs are used");
     options.add_options("dev")("wait-for-dbg", "Wait for debugger on start");
     options.add_options("dev")("stress-incremental-resolver",
                                "Force incremental updates to discover resolver & namer bugs");
@@ -416,8 +518,65 @@ cxxopts::Options buildOptions() {
                                cxxopts::value<string>()->default_value(""), "filepath.yaml");
     options.add_options("dev")("store-state", "Store state into file",
                                cxxopts::value<string>()->default_value(empty.storeState), "file");
+    options.add_options("dev")("store-state-uncompressed",
+                               "With --store-state, store the state uncompressed so that it can be loaded in place");
+    options.add_options("dev")("rbi-bundle",
+                               "Start from a state stored with --store-state, e.g. from a run over a set of gem RBIs, "
+                               "instead of the payload compiled into Sorbet. Input files the state already holds are "
+                               "not indexed again",
+                               cxxopts::value<string>()->default_value(empty.rbiBundle), "file");
     options.add_options("dev")("cache-dir", "Use the specified folder to cache data",
                                cxxopts::value<string>()->default_value(empty.cacheDir), "dir");
+    options.add_options("dev")("incremental",
+                               "Only typecheck files affected by changes since the last run with the same --cache-dir");
+    options.add_options("dev")("check-only",
+                               "Only typecheck this file, against the rest of the project as of the last run with the "
+                               "same --cache-dir and --check-only (may be repeated)",
+                               cxxopts::value<vector<string>>(), "file");
+    options.add_options("dev")("store-resolved",
+                               "Resolve every file and store the result into file, for --load-resolved to typecheck, "
+                               "instead of typechecking",
+                               cxxopts::value<string>()->default_value(empty.storeResolved), "file");
+    options.add_options("dev")("load-resolved",
+                               "Typecheck the files of a state stored by --store-resolved instead of the input files",
+                               cxxopts::value<string>()->default_value(empty.loadResolved), "file");
+    options.add_options("dev")("shard",
+                               "With --load-resolved, only typecheck the i-th of N similarly sized shards of its files",
+                               cxxopts::value<string>(), "i/N");
+    options.add_options("dev")("fail-fast",
+                               "Stop typechecking once this many errors have been reported. With --cache-dir, the "
+                               "files that had errors in the last run are typechecked first",
+                               cxxopts::value<int>()->default_value(to_string(empty.failFast)), "errors");
+    options.add_options("dev")("cache-method-inference",
+                               "Skip inference for methods that had no errors in an earlier run with the same --cache-dir "
+                               "and whose body and callees did not change since");
+    options.add_options("dev")("remote-cache-dir",
+                               "Read --cache-dir misses through to this folder, usually shared between machines, and "
+                               "copy newly cached data into it",
+                               cxxopts::value<string>()->default_value(empty.remoteCacheDir), "dir");
+    options.add_options("dev")("max-cache-size-mb",
+                               "Evict the entries of --cache-dir that went unused the longest once it grows past this "
+                               "size (0 for no limit). The cached GlobalState file beside the database is not "
+                               "counted",
+                               cxxopts::value<int>()->default_value(to_string(empty.maxCacheSizeMB)), "int");
+    options.add_options("dev")("lsp-tree-cache-mb",
+                               "In LSP mode, drop the cached trees of the files typechecked least recently once the "
+                               "cached trees cover more than this many MB of source (0 for no limit)",
+                               cxxopts::value<int>()->default_value(to_string(empty.lspTreeCacheMB)), "int");
+    options.add_options("dev")("lsp-compact-names-percent",
+                               "In LSP mode, once the name table has grown by this many percent since it was last "
+                               "built, build it again from the cached trees before a slow path, dropping the names "
+                               "no file uses anymore (0 to never)",
+                               cxxopts::value<int>()->default_value(to_string(empty.lspCompactNamesPercent)), "int");
+    options.add_options("dev")("lsp-additive-fast-path",
+                               "In LSP mode, take the fast path for edits that only add classes, constants or methods, "
+                               "typechecking the files that use their names along with the edited ones");
+    options.add_options("dev")("lsp-parse-definitions-separately",
+                               "In LSP mode, parse each top-level class and module of a file on its own, so that a "
+                               "syntax error only changes the tree of the definition it is in");
+    options.add_options("dev")("cache-uncompressed-trees",
+                               "Store parse trees in --cache-dir uncompressed, so warm runs read them without "
+                               "decompressing (needs more disk)");
     options.add_options("dev")("suppress-non-critical", "Exit 0 unless there was a critical error");
     options.add_options("dev")("dsl-plugins", "YAML config that configures external DSL plugins",
                                cxxopts::value<string>()->default_value(""), "filepath.yaml");
@@ -429,6 +588,8 @@ cxxopts::Options buildOptions() {
 
     options.add_options("dev")("max-threads", "Set number of threads",
                                cxxopts::value<int>()->default_value(to_string(defaultThreads)), "int");
+    options.add_options("dev")("pin-threads",
+                               "Keep every worker thread on one core, filling up one NUMA node before the next");
     options.add_options("dev")("counter", "Print internal counter", cxxopts::value<vector<string>>(), "counter");
     options.add_options("dev")("statsd-host", "StatsD sever hostname",
                                cxxopts::value<string>()->default_value(empty.statsdHost), "host");
@@ -531,6 +692,10 @@ string_view stripTrailingSlashes(string_view path) {
     return path;
 }
 
+Options Options::clone() const {
+    return Options(*this);
+}
+
 void Options::flushPrinters() {
     for (PrinterConfig &cfg : print.printers()) {
         cfg.flush();
@@ -676,11 +841,101 @@ void readOptions(Options &opts, int argc, char *argv[],
         }
 
         opts.runLSP = raw["lsp"].as<bool>();
-        if (opts.runLSP && !opts.cacheDir.empty()) {
-            logger->error("lsp mode does not yet support caching.");
+        opts.incremental = raw["incremental"].as<bool>();
+        if (opts.incremental && opts.cacheDir.empty()) {
+            logger->error("--incremental requires --cache-dir.");
+            throw EarlyReturnWithCode(1);
+        }
+        if (opts.incremental && (opts.runLSP || opts.autocorrect)) {
+            logger->error("--incremental can not be combined with --lsp or --autocorrect.");
+            throw EarlyReturnWithCode(1);
+        }
+        if (raw.count("check-only") > 0) {
+            opts.checkOnly = raw["check-only"].as<vector<string>>();
+        }
+        if (!opts.checkOnly.empty() && opts.cacheDir.empty()) {
+            logger->error("--check-only requires --cache-dir.");
+            throw EarlyReturnWithCode(1);
+        }
+        if (!opts.checkOnly.empty() && (opts.runLSP || opts.autocorrect || opts.incremental)) {
+            logger->error("--check-only can not be combined with --lsp, --autocorrect or --incremental.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.storeResolved = raw["store-resolved"].as<string>();
+        opts.loadResolved = raw["load-resolved"].as<string>();
+        if (!opts.storeResolved.empty() && !opts.loadResolved.empty()) {
+            logger->error("--store-resolved can not be combined with --load-resolved.");
+            throw EarlyReturnWithCode(1);
+        }
+        if ((!opts.storeResolved.empty() || !opts.loadResolved.empty()) &&
+            (opts.runLSP || opts.autocorrect || opts.incremental || !opts.checkOnly.empty())) {
+            logger->error("--store-resolved and --load-resolved can not be combined with --lsp, --autocorrect, "
+                          "--incremental or --check-only.");
+            throw EarlyReturnWithCode(1);
+        }
+        if (raw.count("shard") > 0) {
+            auto shard = raw["shard"].as<string>();
+            vector<string_view> parts = absl::StrSplit(shard, '/');
+            int index = 0;
+            int count = 0;
+            if (parts.size() != 2 || !absl::SimpleAtoi(parts[0], &index) || !absl::SimpleAtoi(parts[1], &count) ||
+                index < 1 || index > count) {
+                logger->error("--shard must be of the form i/N, with 1 <= i <= N: `{}`.", shard);
+                throw EarlyReturnWithCode(1);
+            }
+            if (opts.loadResolved.empty()) {
+                logger->error("--shard requires --load-resolved.");
+                throw EarlyReturnWithCode(1);
+            }
+            opts.shardIndex = index - 1;
+            opts.shardCount = count;
+        }
+        opts.failFast = raw["fail-fast"].as<int>();
+        if (opts.failFast < 0) {
+            logger->error("--fail-fast can not be negative.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.cacheMethodInference = raw["cache-method-inference"].as<bool>();
+        if (opts.cacheMethodInference && opts.cacheDir.empty()) {
+            logger->error("--cache-method-inference requires --cache-dir.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.remoteCacheDir = raw["remote-cache-dir"].as<string>();
+        if (!opts.remoteCacheDir.empty() && opts.cacheDir.empty()) {
+            logger->error("--remote-cache-dir requires --cache-dir.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.maxCacheSizeMB = raw["max-cache-size-mb"].as<int>();
+        if (opts.maxCacheSizeMB < 0) {
+            logger->error("--max-cache-size-mb must not be negative.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.lspTreeCacheMB = raw["lsp-tree-cache-mb"].as<int>();
+        if (opts.lspTreeCacheMB < 0) {
+            logger->error("--lsp-tree-cache-mb must not be negative.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.lspCompactNamesPercent = raw["lsp-compact-names-percent"].as<int>();
+        if (opts.lspCompactNamesPercent < 0) {
+            logger->error("--lsp-compact-names-percent must not be negative.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.lspAdditiveFastPath = raw["lsp-additive-fast-path"].as<bool>();
+        opts.lspParseDefinitionsSeparately = raw["lsp-parse-definitions-separately"].as<bool>();
+        opts.cacheUncompressedTrees = raw["cache-uncompressed-trees"].as<bool>();
+        if (opts.cacheUncompressedTrees && opts.cacheDir.empty()) {
+            logger->error("--cache-uncompressed-trees requires --cache-dir.");
             throw EarlyReturnWithCode(1);
         }
         opts.disableWatchman = raw["disable-watchman"].as<bool>();
+        opts.daemonSocket = raw["daemon-socket"].as<string>();
+        if (!opts.daemonSocket.empty() && (opts.autocorrect || opts.incremental || !opts.checkOnly.empty() ||
+                                           !opts.storeResolved.empty() || !opts.loadResolved.empty())) {
+            logger->error("--daemon-socket can not be combined with --autocorrect, --incremental, --check-only, "
+                          "--store-resolved or --load-resolved.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.lspRecordSession = raw["lsp-record-session"].as<string>();
         opts.watchmanPath = raw["watchman-path"].as<string>();
         // Certain features only need certain passes
         if (opts.print.isAutogen() && (opts.stopAfterPhase != Phase::NAMER)) {
@@ -718,6 +973,8 @@ void readOptions(Options &opts, int argc, char *argv[],
         opts.threads = opts.runLSP ? raw["max-threads"].as<int>()
                                    : min(raw["max-threads"].as<int>(), int(opts.inputFileNames.size() / 2));
 
+        opts.pinThreads = raw["pin-threads"].as<bool>();
+
         if (raw["h"].as<bool>()) {
             logger->info("{}", options.help({""}));
             throw EarlyReturnWithCode(0);
@@ -751,8 +1008,29 @@ void readOptions(Options &opts, int argc, char *argv[],
             opts.configatronFiles = raw["configatron-file"].as<vector<string>>();
         }
         opts.skipDSLPasses = raw["skip-dsl-passes"].as<bool>();
+        opts.fuseDSLAndLocalVars = raw["fuse-dsl-local-vars"].as<bool>();
+        opts.indexDefinitionsOnly = raw["index-definitions-only"].as<bool>();
+        opts.stdinStream = raw["stdin-stream"].as<bool>();
+        opts.optimizeCFG = raw["optimize-cfg"].as<bool>();
+        opts.parseChunkLines = raw["parse-chunk-lines"].as<int>();
+        if (opts.parseChunkLines < 0) {
+            logger->error("--parse-chunk-lines must not be negative.");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.releaseTypecheckedTrees = raw["release-typechecked-trees"].as<bool>();
+        opts.skipSynthesizedAccessorBodies = raw["skip-synthesized-accessor-bodies"].as<bool>();
         opts.storeState = raw["store-state"].as<string>();
+        opts.storeStateUncompressed = raw["store-state-uncompressed"].as<bool>();
+        opts.rbiBundle = raw["rbi-bundle"].as<string>();
+        if (!opts.rbiBundle.empty() && !FileOps::exists(opts.rbiBundle)) {
+            logger->error("File `{}` not found", opts.rbiBundle);
+            throw EarlyReturnWithCode(1);
+        }
         opts.suggestTyped = raw["suggest-typed"].as<bool>();
+        if (opts.incremental && opts.suggestTyped) {
+            logger->error("--incremental can not be combined with --suggest-typed.");
+            throw EarlyReturnWithCode(1);
+        }
         opts.waitForDebugger = raw["wait-for-dbg"].as<bool>();
         opts.stressIncrementalResolver = raw["stress-incremental-resolver"].as<bool>();
         opts.suggestRuntimeProfiledType = raw["suggest-runtime-profiled"].as<bool>();
@@ -769,6 +1047,17 @@ void readOptions(Options &opts, int argc, char *argv[],
         opts.metricsPrefix = raw["metrics-prefix"].as<string>();
         opts.debugLogFile = raw["debug-log-file"].as<string>();
         opts.webTraceFile = raw["web-trace-file"].as<string>();
+        opts.webTraceStream = raw["web-trace-stream"].as<bool>();
+        opts.webTraceSample = raw["web-trace-sample"].as<int>();
+        if (opts.webTraceStream && opts.webTraceFile.empty()) {
+            logger->error("--web-trace-stream must be used with --web-trace-file");
+            throw EarlyReturnWithCode(1);
+        }
+        if (opts.webTraceSample < 1) {
+            logger->error("--web-trace-sample must be at least 1");
+            throw EarlyReturnWithCode(1);
+        }
+        opts.profileFiles = raw["profile-files"].as<string>();
         opts.reserveMemKiB = raw["reserve-mem-kb"].as<u8>();
         if (raw.count("autogen-version") > 0) {
             if (!opts.print.AutogenMsgPack.enabled) {
@@ -779,6 +1068,25 @@ void readOptions(Options &opts, int argc, char *argv[],
         }
         extractAutoloaderConfig(raw, opts, logger);
         opts.errorUrlBase = raw["error-url-base"].as<string>();
+        opts.errorFormat = raw["error-format"].as<string>();
+        if (opts.errorFormat != "text" && opts.errorFormat != "proto") {
+            logger->error("Unknown --error-format: {}\nValid values: text, proto", opts.errorFormat);
+            throw EarlyReturnWithCode(1);
+        }
+        if (opts.errorFormat != "text" && opts.runLSP) {
+            logger->error("--error-format={} can not be combined with --lsp.", opts.errorFormat);
+            throw EarlyReturnWithCode(1);
+        }
+        if (!opts.profileFiles.empty() && opts.runLSP) {
+            logger->error("--profile-files can not be combined with --lsp.");
+            throw EarlyReturnWithCode(1);
+        }
+#ifdef SORBET_NO_PER_FILE_SPANS
+        if (!opts.profileFiles.empty()) {
+            logger->error("--profile-files is not supported by builds without per-file spans.");
+            throw EarlyReturnWithCode(1);
+        }
+#endif
         if (raw.count("error-white-list") > 0) {
             auto rawList = raw["error-white-list"].as<vector<int>>();
             opts.errorCodeWhiteList = set<int>(rawList.begin(), rawList.end());
@@ -795,13 +1103,14 @@ void readOptions(Options &opts, int argc, char *argv[],
             opts.suggestSig = raw["suggest-sig"].as<bool>();
         }
 
-        if (raw.count("e") == 0 && opts.inputFileNames.empty() && !opts.runLSP && opts.storeState.empty()) {
+        if (raw.count("e") == 0 && opts.inputFileNames.empty() && !opts.runLSP && opts.storeState.empty() &&
+            opts.loadResolved.empty() && !opts.stdinStream) {
             logger->error("You must pass either `{}` or at least one folder or ruby file.\n\n{}", "-e",
                           options.help({""}));
             throw EarlyReturnWithCode(1);
         }
 
-        if ((raw["color"].as<string>() == "never") || opts.runLSP) {
+        if ((raw["color"].as<string>() == "never") || opts.runLSP || opts.stdinStream || opts.errorFormat != "text") {
             core::ErrorColors::disableColors();
         } else if (raw["color"].as<string>() == "auto") {
             if (rang::rang_implementation::isTerminal(cerr.rdbuf())) {
@@ -842,6 +1151,7 @@ void readOptions(Options &opts, int argc, char *argv[],
             auto dslConfig = extractDslPlugins(raw["dsl-plugins"].as<string>(), logger);
             opts.dslPluginTriggers = std::move(dslConfig.triggers);
             opts.dslRubyExtraArgs = std::move(dslConfig.rubyExtraArgs);
+            opts.dslResidentPlugins = dslConfig.resident;
         }
     } catch (cxxopts::OptionParseException &e) {
         logger->info("{}. To see all available options pass `--help`.", e.what());
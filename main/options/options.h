@@ -21,9 +21,19 @@ public:
     bool supportsFlush = false;
 
     void print(const std::string_view &contents) const;
+    // Writes `contents` to the output file right away instead of keeping all of it until flush(), for outputs too
+    // large to be held in memory. Can't be mixed with print for the same printer.
+    void printUnbuffered(const std::string_view &contents) const;
     template <typename... Args> void fmt(const std::string &msg, const Args &... args) const {
         print(fmt::format(msg, args...));
     }
+    /**
+     * Keeps `contents` as the output for the file with id `fileId` until printFilesInOrder. Meant for worker threads,
+     * which then take the printer's lock once per file rather than once per line, and don't interleave their output.
+     */
+    void printForFile(u4 fileId, std::string contents) const;
+    // Prints what printForFile was handed so far, ordered by file id.
+    void printFilesInOrder() const;
     void flush();
 
     PrinterConfig();
@@ -35,6 +45,9 @@ public:
 private:
     struct GuardedState {
         fmt::memory_buffer buf;
+        // Open by printUnbuffered until flush()
+        std::FILE *unbuffered = nullptr;
+        std::vector<std::pair<u4, std::string>> byFile;
         absl::Mutex mutex;
     };
     std::shared_ptr<GuardedState> state;
@@ -55,13 +68,18 @@ struct Printers {
     PrinterConfig SymbolTable;
     PrinterConfig SymbolTableRaw;
     PrinterConfig SymbolTableJson;
+    // symbol-table-proto format outputs every symbol as a length-delimited Symbol, parents first.
+    // See Symbol.proto for details
+    PrinterConfig SymbolTableProto;
     PrinterConfig SymbolTableFull;
     PrinterConfig SymbolTableFullRaw;
     PrinterConfig SymbolTableFullJson;
+    PrinterConfig SymbolTableFullProto;
     PrinterConfig FileTableJson;
     PrinterConfig ResolveTree;
     PrinterConfig ResolveTreeRaw;
     PrinterConfig MissingConstants;
+    PrinterConfig FileDeps;
     PrinterConfig FlattenedTree;
     PrinterConfig FlattenedTreeRaw;
     PrinterConfig CFG;
@@ -131,27 +149,67 @@ struct Options {
     bool runLSP = false;
     bool disableWatchman = false;
     std::string watchmanPath = "watchman";
+    // With --lsp, the Unix socket the daemon answers typecheck requests on instead of reading LSP from stdin.
+    // Without it, the socket of the daemon to ask for errors instead of typechecking. Empty when not given.
+    std::string daemonSocket;
+    // With --lsp, the file that every message read from the client is appended to, for test/lsp_replay to replay.
+    std::string lspRecordSession;
     bool stressIncrementalResolver = false;
+    bool incremental = false;
+    bool cacheMethodInference = false;
+    // With --fail-fast, typechecking stops once this many errors have been reported, and typechecks the files that
+    // had errors in the last run with the same --cache-dir first. 0 when not given.
+    int failFast = 0;
+    bool cacheUncompressedTrees = false;
     bool noErrorCount = false;
     bool autocorrect = false;
     bool waitForDebugger = false;
     bool skipDSLPasses = false;
+    // Run the DSL passes and local variable resolution as a single walk over each tree.
+    bool fuseDSLAndLocalVars = false;
+    // Right after desugaring a file below `typed: true`, drop what namer and resolver don't use of its method bodies.
+    // Nothing of those bodies is inferred anyway. Ignored for autogen, which reports on every method body.
+    bool indexDefinitionsOnly = false;
+    // Typecheck the Ruby documents read from stdin one at a time against the input files, instead of the input files.
+    bool stdinStream = false;
+    // Drop more side-effect free instructions from the CFG of each method before inferring it.
+    bool optimizeCFG = false;
+    // While indexing files in parallel, parse the files that parser::Parser::chunkBoundaries can cut into chunks of
+    // at least this many lines chunk by chunk, in parallel. 0 when not given.
+    int parseChunkLines = 0;
+    // Keep only the file of each typechecked tree, freeing the tree on the thread that typechecked it.
+    bool releaseTypecheckedTrees = false;
+    // Neither build CFGs for nor infer the accessors that DSL passes synthesize with a `T.cast(T.unsafe(nil), type)` or
+    // `T.unsafe(nil)` body. Their sigs already say everything such bodies could.
+    bool skipSynthesizedAccessorBodies = false;
     bool suggestRuntimeProfiledType = false;
     bool censorForSnapshotTests = false;
     int threads = 0;
+    bool pinThreads = false;
+    int maxCacheSizeMB = 0; // 0 means unbounded
+    int lspTreeCacheMB = 0; // 0 means unbounded
+    // In LSP mode, rebuild the name table of the indexing state once it has grown by this many percent. 0 for never.
+    int lspCompactNamesPercent = 0;
     int logLevel = 0; // number of time -v was passed
     int autogenVersion = 0;
     std::string typedSource = "";
     std::string cacheDir = "";
+    std::string remoteCacheDir = "";
     std::vector<std::string> configatronDirs;
     std::vector<std::string> configatronFiles;
     UnorderedMap<std::string, core::StrictLevel> strictnessOverrides;
     UnorderedMap<std::string, std::string> dslPluginTriggers;
     std::vector<std::string> dslRubyExtraArgs;
+    bool dslResidentPlugins = false;
     std::string storeState = "";
+    bool storeStateUncompressed = false;
+    // A state stored with --store-state to start from instead of the payload, which Sorbet then treats as payload.
+    std::string rbiBundle = "";
     bool enableCounters = false;
     std::vector<std::string> someCounters;
     std::string errorUrlBase = "https://srb.help/";
+    /** How errors are printed: "text" for people, or "proto" for length-delimited, binary core::Proto records. */
+    std::string errorFormat = "text";
     std::set<int> errorCodeWhiteList;
     std::set<int> errorCodeBlackList;
     /** Prefix to remove from all printed paths. */
@@ -179,6 +237,17 @@ struct Options {
     std::vector<std::string> relativeIgnorePatterns;
     // Contains the expanded list of all Ruby file inputs (rawInputFileNames + all Ruby files in rawInputDirNames)
     std::vector<std::string> inputFileNames;
+    // With --check-only, the files to typecheck against the project snapshot of an earlier run instead of
+    // typechecking inputFileNames.
+    std::vector<std::string> checkOnly;
+    // With --store-resolved, where to write the resolved state and the resolved trees of every file, instead of
+    // typechecking them.
+    std::string storeResolved;
+    // With --load-resolved, a state written by --store-resolved whose files are typechecked instead of
+    // inputFileNames. Only the files of shard `shardIndex` (counting from 0) out of `shardCount` are typechecked.
+    std::string loadResolved;
+    int shardIndex = 0;
+    int shardCount = 1;
     // A list of parent classes to be used in `-p autogen-subclasses`
     std::vector<std::string> autogenSubclassesParents;
     // Ignore patterns beginning from the root of an input folder.
@@ -193,10 +262,19 @@ struct Options {
     bool lspDocumentSymbolEnabled = false;
     bool lspSignatureHelpEnabled = false;
     bool lspHoverEnabled = false;
+    // Lets the LSP fast path handle edits that only add definitions, instead of taking the slow path.
+    bool lspAdditiveFastPath = false;
+    // Parse each top-level class or module of a file on its own (see parser::Parser::runChunks), so that a syntax
+    // error mid-edit only changes the tree of the definition being edited.
+    bool lspParseDefinitionsSeparately = false;
 
     std::string inlineInput; // passed via -e
     std::string debugLogFile;
     std::string webTraceFile;
+    bool webTraceStream = false;
+    int webTraceSample = 1;
+    // Where --profile-files writes the time and work spent on every file, if anywhere
+    std::string profileFiles;
 
     std::shared_ptr<FileSystem> fs = std::make_shared<OSFileSystem>();
 
@@ -204,13 +282,17 @@ struct Options {
 
     Options() = default;
 
-    Options(const Options &) = delete;
+    /** A copy, for the rare caller that needs options of its own; copying them is never done by accident. */
+    Options clone() const;
 
     Options(Options &&) = default;
 
     Options &operator=(const Options &) = delete;
 
     Options &operator=(Options &&) = delete;
+
+private:
+    Options(const Options &) = default;
 };
 
 void readOptions(Options &, int argc, char *argv[],
@@ -33,21 +33,37 @@ TEST(OptionsTest, DefaultConstructorMatchesReadOptions) {
     EXPECT_EQ(empty.autocorrect, opts.autocorrect);
     EXPECT_EQ(empty.waitForDebugger, opts.waitForDebugger);
     EXPECT_EQ(empty.skipDSLPasses, opts.skipDSLPasses);
+    EXPECT_EQ(empty.fuseDSLAndLocalVars, opts.fuseDSLAndLocalVars);
+    EXPECT_EQ(empty.optimizeCFG, opts.optimizeCFG);
+    EXPECT_EQ(empty.parseChunkLines, opts.parseChunkLines);
+    EXPECT_EQ(empty.releaseTypecheckedTrees, opts.releaseTypecheckedTrees);
+    EXPECT_EQ(empty.skipSynthesizedAccessorBodies, opts.skipSynthesizedAccessorBodies);
     EXPECT_EQ(empty.suggestRuntimeProfiledType, opts.suggestRuntimeProfiledType);
     EXPECT_EQ(empty.threads, opts.threads);
+    EXPECT_EQ(empty.pinThreads, opts.pinThreads);
     EXPECT_EQ(empty.logLevel, opts.logLevel);
     EXPECT_EQ(empty.autogenVersion, opts.autogenVersion);
     EXPECT_EQ(empty.typedSource, opts.typedSource);
     EXPECT_EQ(empty.cacheDir, opts.cacheDir);
+    EXPECT_EQ(empty.checkOnly.size(), opts.checkOnly.size());
+    EXPECT_EQ(empty.failFast, opts.failFast);
+    EXPECT_EQ(empty.daemonSocket, opts.daemonSocket);
+    EXPECT_EQ(empty.lspRecordSession, opts.lspRecordSession);
+    EXPECT_EQ(empty.storeResolved, opts.storeResolved);
+    EXPECT_EQ(empty.loadResolved, opts.loadResolved);
+    EXPECT_EQ(empty.shardIndex, opts.shardIndex);
+    EXPECT_EQ(empty.shardCount, opts.shardCount);
     EXPECT_EQ(empty.configatronDirs.size(), opts.configatronDirs.size());
     EXPECT_EQ(empty.configatronFiles.size(), opts.configatronFiles.size());
     EXPECT_EQ(empty.strictnessOverrides.size(), opts.strictnessOverrides.size());
     EXPECT_EQ(empty.dslPluginTriggers.size(), opts.dslPluginTriggers.size());
     EXPECT_EQ(empty.dslRubyExtraArgs.size(), opts.dslRubyExtraArgs.size());
+    EXPECT_EQ(empty.dslResidentPlugins, opts.dslResidentPlugins);
     EXPECT_EQ(empty.storeState, opts.storeState);
     EXPECT_EQ(empty.enableCounters, opts.enableCounters);
     EXPECT_EQ(empty.someCounters.size(), opts.someCounters.size());
     EXPECT_EQ(empty.errorUrlBase, opts.errorUrlBase);
+    EXPECT_EQ(empty.errorFormat, opts.errorFormat);
     EXPECT_EQ(empty.errorCodeWhiteList, opts.errorCodeWhiteList);
     EXPECT_EQ(empty.errorCodeBlackList, opts.errorCodeBlackList);
     EXPECT_EQ(empty.pathPrefix, opts.pathPrefix);
@@ -71,7 +87,13 @@ TEST(OptionsTest, DefaultConstructorMatchesReadOptions) {
     EXPECT_EQ(empty.lspWorkspaceSymbolsEnabled, opts.lspWorkspaceSymbolsEnabled);
     EXPECT_EQ(empty.lspDocumentSymbolEnabled, opts.lspDocumentSymbolEnabled);
     EXPECT_EQ(empty.lspSignatureHelpEnabled, opts.lspSignatureHelpEnabled);
+    EXPECT_EQ(empty.lspAdditiveFastPath, opts.lspAdditiveFastPath);
+    EXPECT_EQ(empty.lspParseDefinitionsSeparately, opts.lspParseDefinitionsSeparately);
+    EXPECT_EQ(empty.lspCompactNamesPercent, opts.lspCompactNamesPercent);
     EXPECT_EQ(empty.inlineInput, opts.inlineInput);
     EXPECT_EQ(empty.debugLogFile, opts.debugLogFile);
     EXPECT_EQ(empty.webTraceFile, opts.webTraceFile);
+    EXPECT_EQ(empty.webTraceStream, opts.webTraceStream);
+    EXPECT_EQ(empty.webTraceSample, opts.webTraceSample);
+    EXPECT_EQ(empty.profileFiles, opts.profileFiles);
 }
@@ -1,21 +1,31 @@
 // has to go first, as it violates poisons
 #include "core/proto/proto.h"
+#include <chrono>
+#include <cstring>
 #include <sstream>
+#include <thread>
 
 #include "ProgressIndicator.h"
+#include "absl/algorithm/container.h"
 #include "absl/strings/escaping.h" // BytesToHexString
 #include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "ast/Helpers.h"
 #include "ast/desugar/Desugar.h"
-#include "ast/substitute/substitute.h"
 #include "ast/treemap/treemap.h"
+#include "ast/treemap/treewalk.h"
 #include "cfg/CFG.h"
 #include "cfg/builder/builder.h"
 #include "cfg/proto/proto.h"
 #include "common/FileOps.h"
+#include "common/JSON.h"
 #include "common/Timer.h"
 #include "common/concurrency/ConcurrentQueue.h"
 #include "common/crypto_hashing/crypto_hashing.h"
-#include "core/GlobalSubstitution.h"
+#include "common/os/os.h"
 #include "core/Unfreeze.h"
 #include "core/errors/parser.h"
 #include "core/serialize/serialize.h"
@@ -36,55 +46,279 @@ using namespace std;
 
 namespace sorbet::realmain::pipeline {
 
+core::UsageHash getAllNames(const core::GlobalState &gs, const unique_ptr<ast::Expression> &tree);
+
+// Remembers which methods built a CFG and inferred without reporting a single error, silenced ones included, so
+// that a later run can skip them (--cache-method-inference). Only clean outcomes are remembered: rendered errors
+// mention locations in other files, which the key does not cover.
+class InferenceCache {
+    const unique_ptr<KeyValueStore> &kvstore;
+    unique_ptr<core::GlobalStateHash> hashes;
+
+public:
+    // Reading is safe from any thread.
+    InferenceCache(const core::GlobalState &gs, const unique_ptr<KeyValueStore> &kvstore)
+        : kvstore(kvstore), hashes(gs.hash()) {}
+
+    // The key covers the method's own source, name and strictness, the class hierarchy and every signature that
+    // is visible through the names the method sends.
+    string methodKey(core::Context ctx, ast::MethodDef &m) const {
+        vector<core::NameHash> sends;
+        auto usages = getAllNames(ctx, m.rhs);
+        sends = move(usages.sends);
+        for (auto &arg : m.args) {
+            auto argUsages = getAllNames(ctx, arg);
+            sends.insert(sends.end(), argUsages.sends.begin(), argUsages.sends.end());
+        }
+        // Dispatched to without being named: `new` calls `initialize`, `super` the method's own name.
+        sends.emplace_back(ctx.state, core::Names::initialize().data(ctx));
+        sends.emplace_back(ctx.state, m.name.data(ctx));
+        core::NameHash::sortAndDedupe(sends);
+
+        string digest = fmt::format("{}//{}//{}//{}", hashes->hierarchyHash,
+                                    (int)m.loc.file().data(ctx).strictLevel, m.symbol.data(ctx)->showFullName(ctx),
+                                    m.loc.source(ctx));
+        for (auto &name : sends) {
+            auto fnd = hashes->methodHashes.find(name);
+            absl::StrAppend(&digest, "//", name._hashValue, ":",
+                            fnd == hashes->methodHashes.end() ? 0 : fnd->second);
+        }
+        auto hashBytes = sorbet::crypto_hashing::hash64(digest);
+        return absl::StrCat("inference//",
+                            absl::BytesToHexString(string_view{(char *)hashBytes.data(), size(hashBytes)}));
+    }
+
+    bool isClean(string_view key) const {
+        return kvstore->read(key) != nullptr;
+    }
+
+    static void markClean(KeyValueStore &kvstore, string_view key) {
+        kvstore.write(key, vector<u1>{1});
+    }
+};
+
+bool isUnsafeNil(core::Context ctx, const ast::Expression *expr) {
+    auto *send = ast::cast_tree_const<ast::Send>(expr);
+    if (send == nullptr || send->fun != core::Names::unsafe() || send->args.size() != 1) {
+        return false;
+    }
+    auto *recv = ast::cast_tree_const<ast::ConstantLit>(send->recv.get());
+    auto *arg = ast::cast_tree_const<ast::Literal>(send->args[0].get());
+    return recv != nullptr && recv->symbol == core::Symbols::T() && arg != nullptr && arg->isNil(ctx);
+}
+
+// The getters and setters that the Prop and Struct DSL passes write: `T.cast(T.unsafe(nil), type)` or `T.unsafe(nil)`.
+bool isPlaceholderAccessor(core::Context ctx, const ast::MethodDef &m) {
+    if (!m.isDSLSynthesized()) {
+        return false;
+    }
+    if (auto *cast = ast::cast_tree_const<ast::Cast>(m.rhs.get())) {
+        return cast->cast == core::Names::cast() && isUnsafeNil(ctx, cast->arg.get());
+    }
+    return isUnsafeNil(ctx, m.rhs.get());
+}
+
 class CFGCollectorAndTyper {
+    static constexpr size_t EXPORT_FLUSH_BYTES = 1024 * 1024;
+
     const options::Options &opts;
+    const InferenceCache *cache;
 
 public:
-    CFGCollectorAndTyper(const options::Options &opts) : opts(opts){};
+    // Keys of the methods that reported no errors this run and were not already known to be clean.
+    vector<string> cleanMethods;
+    // What --profile-files reports for the file.
+    int methodsInferred = 0;
+    int sendsDispatched = 0;
+    // The exported CFGs of the methods typechecked so far, written out by flushExported once there are enough of them
+    // to be worth taking the printer's lock.
+    string exported;
+    // What -p cfg prints for the methods typechecked so far, handed to the printer once the whole file is done.
+    string printedCFGs;
+
+    CFGCollectorAndTyper(const options::Options &opts, const InferenceCache *cache = nullptr)
+        : opts(opts), cache(cache){};
 
     unique_ptr<ast::MethodDef> preTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> m) {
-        if (m->loc.file().data(ctx).strictLevel < core::StrictLevel::True || m->symbol.data(ctx)->isOverloaded()) {
-            return m;
+        typecheckMethod(ctx, *m);
+        return m;
+    }
+
+    void typecheckMethod(core::Context ctx, ast::MethodDef &m) {
+        if (m.loc.file().data(ctx).strictLevel < core::StrictLevel::True || m.symbol.data(ctx)->isOverloaded()) {
+            return;
         }
+        // LSP queries may be about locations inside the accessors' types, so those still look at them.
+        if (opts.skipSynthesizedAccessorBodies && ctx.state.lspQuery.isEmpty() && isPlaceholderAccessor(ctx, m)) {
+            prodCounterInc("types.input.methods.skipped_accessors");
+            return;
+        }
+        string cacheKey;
+        if (cache != nullptr) {
+            cacheKey = cache->methodKey(ctx, m);
+            if (cache->isClean(cacheKey)) {
+                prodCounterInc("types.input.methods.inference_cache.hit");
+                return;
+            }
+            prodCounterInc("types.input.methods.inference_cache.miss");
+        }
+        auto errorsBefore = core::ErrorQueue::errorsPushedByThisThread();
         auto &print = opts.print;
-        auto cfg = cfg::CFGBuilder::buildFor(ctx.withOwner(m->symbol), *m);
+        auto cfg = cfg::CFGBuilder::buildFor(ctx.withOwner(m.symbol), m);
 
         if (opts.stopAfterPhase == options::Phase::CFG) {
-            return m;
+            return;
         }
         cfg = infer::Inference::run(ctx.withOwner(cfg->symbol), move(cfg));
+        methodsInferred++;
+        if (!opts.profileFiles.empty()) {
+            for (auto &bb : cfg->basicBlocks) {
+                for (auto &bind : bb->exprs) {
+                    if (cfg::isa_instruction<cfg::Send>(bind.value.get())) {
+                        sendsDispatched++;
+                    }
+                }
+            }
+        }
+        if (cache != nullptr && core::ErrorQueue::errorsPushedByThisThread() == errorsBefore) {
+            cleanMethods.emplace_back(move(cacheKey));
+        }
         if (print.CFG.enabled) {
-            print.CFG.fmt("{}\n\n", cfg->toString(ctx));
+            printedCFGs += fmt::format("{}\n\n", cfg->toString(ctx));
         }
         if ((print.CFGJson.enabled || print.CFGProto.enabled) && cfg->shouldExport(ctx.state)) {
             auto proto = cfg::Proto::toProto(ctx.state, *cfg);
             if (print.CFGJson.enabled) {
-                string buf = core::Proto::toJSON(proto);
-                print.CFGJson.print(buf);
+                exported += core::Proto::toJSON(proto);
             } else {
-                // The proto wire format allows simply concatenating repeated message fields
-                string buf = cfg::Proto::toMulti(proto).SerializeAsString();
-                print.CFGProto.print(buf);
+                // The proto wire format allows simply concatenating repeated message fields, so this is written as
+                // an element of MultiCFG.cfg without building a MultiCFG around it.
+                core::Proto::appendAsRepeated(proto, com::stripe::rubytyper::MultiCFG::kCfgFieldNumber, exported);
             }
+            if (exported.size() >= EXPORT_FLUSH_BYTES) {
+                flushExported();
+            }
+        }
+    }
+
+    void flushExported() {
+        if (exported.empty()) {
+            return;
+        }
+        auto &print = opts.print;
+        if (print.CFGJson.enabled) {
+            print.CFGJson.print(exported);
+        } else {
+            print.CFGProto.print(exported);
         }
+        exported.clear();
+    }
+};
+
+// Collects every method of a tree, in the order CFGCollectorAndTyper would visit them.
+class MethodDefCollector {
+public:
+    vector<ast::MethodDef *> methods;
+
+    unique_ptr<ast::MethodDef> preTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> m) {
+        methods.emplace_back(m.get());
         return m;
     }
 };
 
-string fileKey(core::GlobalState &gs, core::FileRef file) {
+string fileKey(const core::GlobalState &gs, core::FileRef file) {
     auto path = file.data(gs).path();
     string key(path.begin(), path.end());
     key += "//";
-    auto hashBytes = sorbet::crypto_hashing::hash64(file.data(gs).source());
+    auto &hashBytes = file.data(gs).contentHash();
     key += absl::BytesToHexString(string_view{(char *)hashBytes.data(), size(hashBytes)});
     return key;
 }
 
-unique_ptr<ast::Expression> fetchTreeFromCache(core::GlobalState &gs, core::FileRef file,
+namespace {
+// Whether indexing drops what namer and resolver don't use of `file`'s method bodies (see --index-definitions-only).
+// Always the case for RBIs: nothing of their method bodies is ever inferred, and autogen skips them.
+bool indexesDefinitionsOnly(const options::Options &opts, const core::GlobalState &gs, core::FileRef file) {
+    auto &data = file.data(gs);
+    if (data.isRBI()) {
+        return true;
+    }
+    return opts.indexDefinitionsOnly && !opts.print.isAutogen() && data.strictLevel < core::StrictLevel::True;
+}
+
+// Where the tree of `file` is cached. Trees that lost most of their method bodies are kept apart from whole ones, as
+// a later run may want the whole tree of the same contents (e.g. once --typed-override raises the file's strictness).
+string treeKey(const options::Options &opts, const core::GlobalState &gs, core::FileRef file) {
+    auto key = fileKey(gs, file);
+    if (indexesDefinitionsOnly(opts, gs, file)) {
+        key += "//definitions";
+    }
+    return key;
+}
+} // namespace
+
+struct CacheEntry {
+    string key;
+    vector<u1> value;
+    // Whether the key names everything the value depends on but the state it refers to, so that it can go to the
+    // remote cache (see KeyValueStore::setRemoteScope).
+    bool shared;
+};
+using CacheEntries = vector<CacheEntry>;
+
+// A file written within the resolution of its file system's timestamps can change again without its stat changing, so
+// stamps are only recorded once they are at least this old.
+constexpr u8 STAMP_SETTLE_NS = 2'000'000'000;
+
+// Where the content hash of a file is recorded under what stat said about it, so that a later run finding the file
+// unchanged on disk takes the hash, and through it the cached tree, without reading the source. Empty if the source
+// did not come from disk.
+string fileStampKey(const core::File &file) {
+    auto *mapping = file.mapping();
+    if (mapping == nullptr || mapping->stamp.mtimeNs == 0) {
+        return "";
+    }
+    auto &stamp = mapping->stamp;
+    return absl::StrCat("file-stamp//", file.path(), "//", stamp.size, ":", stamp.mtimeNs, ":", stamp.inode, ":",
+                        stamp.device);
+}
+
+void trustRecordedContentHash(core::File &file, const unique_ptr<KeyValueStore> &kvstore) {
+    auto stampKey = fileStampKey(file);
+    if (stampKey.empty() || file.contentHashTrusted()) {
+        return;
+    }
+    auto recorded = kvstore->readString(stampKey);
+    array<u1, 16> hash;
+    if (recorded.size() != hash.size()) {
+        prodCounterInc("types.input.files.stamp.miss");
+        return;
+    }
+    memcpy(hash.data(), recorded.data(), hash.size());
+    file.trustContentHash(hash);
+    prodCounterInc("types.input.files.stamp.hit");
+}
+
+void addFileStampCacheEntry(const core::File &file, CacheEntries &entries) {
+    auto stampKey = fileStampKey(file);
+    if (stampKey.empty() || file.contentHashTrusted()) {
+        return;
+    }
+    auto now = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    if (file.mapping()->stamp.mtimeNs + STAMP_SETTLE_NS > (u8)now) {
+        return;
+    }
+    auto &hash = file.contentHash();
+    // Stamps describe this machine's file system.
+    entries.push_back(CacheEntry{move(stampKey), vector<u1>(hash.begin(), hash.end()), false});
+}
+
+unique_ptr<ast::Expression> fetchTreeFromCache(core::GlobalState &gs, const options::Options &opts, core::FileRef file,
                                                const unique_ptr<KeyValueStore> &kvstore) {
     if (kvstore && file.id() < gs.filesUsed()) {
-        string fileHashKey = fileKey(gs, file);
-        auto maybeCached = kvstore->read(fileHashKey);
+        trustRecordedContentHash(file.data(gs), kvstore);
+        string fileHashKey = treeKey(opts, gs, file);
+        auto maybeCached = kvstore->readShared(fileHashKey);
         if (maybeCached) {
             prodCounterInc("types.input.files.kvstore.hit");
             auto cachedTree = core::serialize::Serializer::loadExpression(gs, maybeCached, file.id());
@@ -98,25 +332,159 @@ unique_ptr<ast::Expression> fetchTreeFromCache(core::GlobalState &gs, core::File
     return nullptr;
 }
 
-void cacheTrees(core::GlobalState &gs, unique_ptr<KeyValueStore> &kvstore, vector<ast::ParsedFile> &trees) {
+// Serializes the trees that didn't come from the cache. This doesn't touch `kvstore`, so indexing workers do it for
+// the trees they produced and leave only the writes to the thread that owns the store.
+CacheEntries serializeTreesForCache(core::GlobalState &gs, const options::Options &opts,
+                                    const unique_ptr<KeyValueStore> &kvstore, vector<ast::ParsedFile> &trees) {
+    CacheEntries entries;
     if (!kvstore) {
-        return;
+        return entries;
     }
+    const bool compress = !opts.cacheUncompressedTrees;
     for (auto &tree : trees) {
+        addFileStampCacheEntry(tree.file.data(gs), entries);
         if (tree.file.data(gs).cachedParseTree) {
             continue;
         }
-        string fileHashKey = fileKey(gs, tree.file);
-        kvstore->write(fileHashKey, core::serialize::Serializer::storeExpression(gs, tree.tree));
+        entries.push_back(CacheEntry{treeKey(opts, gs, tree.file),
+                                     core::serialize::Serializer::storeExpression(gs, tree.tree, compress), true});
+    }
+    return entries;
+}
+
+void writeCacheEntries(unique_ptr<KeyValueStore> &kvstore, const CacheEntries &entries) {
+    for (auto &entry : entries) {
+        if (entry.shared) {
+            kvstore->writeShared(entry.key, entry.value);
+        } else {
+            kvstore->write(entry.key, entry.value);
+        }
+    }
+}
+
+void cacheTrees(core::GlobalState &gs, const options::Options &opts, unique_ptr<KeyValueStore> &kvstore,
+                vector<ast::ParsedFile> &trees) {
+    writeCacheEntries(kvstore, serializeTreesForCache(gs, opts, kvstore, trees));
+}
+
+// The cached tree of a file doesn't say what plugins generated for it, so the generated files are cached next to it,
+// under a key that also covers the plugin configuration.
+string pluginFilesKey(const options::Options &opts, const core::GlobalState &gs, core::FileRef file) {
+    vector<string> config;
+    for (auto &[method, command] : opts.dslPluginTriggers) {
+        config.emplace_back(absl::StrCat(method, "=", command));
+    }
+    fast_sort(config);
+    config.insert(config.end(), opts.dslRubyExtraArgs.begin(), opts.dslRubyExtraArgs.end());
+    auto hashBytes = sorbet::crypto_hashing::hash64(absl::StrJoin(config, "\n"));
+    return absl::StrCat("plugin-files/", absl::BytesToHexString(string_view{(char *)hashBytes.data(), size(hashBytes)}),
+                        "/", fileKey(gs, file));
+}
+
+// Stored as `<count>\n`, then `<path size> <source size>\n<path><source>` for every file, so that even a file plugins
+// generated nothing for has a non-empty entry.
+void addPluginFilesCacheEntry(const options::Options &opts, const core::GlobalState &gs, core::FileRef file,
+                              const vector<shared_ptr<core::File>> &pluginFiles, CacheEntries &entries) {
+    string encoded = fmt::format("{}\n", pluginFiles.size());
+    for (auto &pluginFile : pluginFiles) {
+        auto path = pluginFile->path();
+        auto source = pluginFile->source();
+        absl::StrAppend(&encoded, path.size(), " ", source.size(), "\n", path, source);
+    }
+    // In the layout KeyValueStore::readString expects.
+    vector<u1> value(sizeof(size_t) + encoded.size());
+    size_t encodedSize = encoded.size();
+    memcpy(value.data(), &encodedSize, sizeof(encodedSize));
+    memcpy(value.data() + sizeof(encodedSize), encoded.data(), encoded.size());
+    entries.push_back(CacheEntry{pluginFilesKey(opts, gs, file), move(value), true});
+}
+
+// Returns nullopt when the cache can't say what plugins generate for `file`, in which case they have to run again.
+optional<vector<shared_ptr<core::File>>> fetchPluginFilesFromCache(const options::Options &opts,
+                                                                  const core::GlobalState &gs, core::FileRef file,
+                                                                  const unique_ptr<KeyValueStore> &kvstore) {
+    vector<shared_ptr<core::File>> pluginFiles;
+    if (!kvstore || file.id() >= gs.filesUsed()) {
+        return nullopt;
+    }
+    if (!gs.hasAnyDslPlugin()) {
+        return pluginFiles;
+    }
+    string_view encoded = kvstore->readSharedString(pluginFilesKey(opts, gs, file));
+    auto readSize = [&](char delimiter, size_t &out) -> bool {
+        auto end = encoded.find(delimiter);
+        if (end == string_view::npos || !absl::SimpleAtoi(encoded.substr(0, end), &out)) {
+            return false;
+        }
+        encoded.remove_prefix(end + 1);
+        return true;
+    };
+    size_t count = 0;
+    if (!readSize('\n', count)) {
+        prodCounterInc("types.input.plugin_files.kvstore.miss");
+        return nullopt;
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t pathSize = 0, sourceSize = 0;
+        if (!readSize(' ', pathSize) || !readSize('\n', sourceSize) || encoded.size() < pathSize + sourceSize) {
+            prodCounterInc("types.input.plugin_files.kvstore.miss");
+            return nullopt;
+        }
+        auto pluginFile = make_shared<core::File>(string(encoded.substr(0, pathSize)),
+                                                  string(encoded.substr(pathSize, sourceSize)), core::File::Normal);
+        pluginFile->pluginGenerated = true;
+        pluginFiles.emplace_back(move(pluginFile));
+        encoded.remove_prefix(pathSize + sourceSize);
+    }
+    prodCounterInc("types.input.plugin_files.kvstore.hit");
+    return pluginFiles;
+}
+
+// Parses `file` chunk by chunk, on a pool of its own, if --parse-chunk-lines lets parser::Parser::chunkBoundaries cut
+// it. Only done while indexing concurrently, when any thread may enter names. Returns nullptr if the file should be
+// parsed as a whole instead, e.g. because one of its chunks does not parse on its own.
+unique_ptr<parser::Node> runChunkedParser(core::GlobalState &gs, core::FileRef file, int chunkLines) {
+    if (chunkLines == 0 || !gs.indexingConcurrently()) {
+        return nullptr;
+    }
+    auto boundaries = parser::Parser::chunkBoundaries(file.data(gs).source(), chunkLines);
+    if (boundaries.empty()) {
+        return nullptr;
+    }
+    const size_t chunkCount = boundaries.size() - 1;
+    vector<unique_ptr<parser::Node>> chunks(chunkCount);
+    {
+        auto workers = WorkerPool::create(min<int>(chunkCount, max(1u, thread::hardware_concurrency())), gs.tracer());
+        workers->parallelFor("parseChunks", chunkCount, [&](size_t i) {
+            chunks[i] = parser::Parser::runChunk(gs, file, boundaries[i], boundaries[i + 1]);
+        });
+    }
+    for (auto &chunk : chunks) {
+        if (chunk == nullptr) {
+            prodCounterInc("types.input.files.chunked_parse.fallback");
+            return nullptr;
+        }
     }
+    prodCounterInc("types.input.files.chunked_parse");
+    return parser::Parser::joinChunks(move(chunks));
 }
 
-unique_ptr<parser::Node> runParser(core::GlobalState &gs, core::FileRef file, const options::Printers &print) {
-    Timer timeit(gs.tracer(), "runParser", {{"file", (string)file.data(gs).path()}});
+unique_ptr<parser::Node> runParser(const options::Options &opts, core::GlobalState &gs, core::FileRef file) {
+    FileTimer timeit(gs.tracer(), "runParser", "file", [&]() { return string(file.data(gs).path()); });
+    auto &print = opts.print;
     unique_ptr<parser::Node> nodes;
     {
         core::UnfreezeNameTable nameTableAccess(gs); // enters strings from source code as names
-        nodes = parser::Parser::run(gs, file);
+        nodes = runChunkedParser(gs, file, opts.parseChunkLines);
+        if (nodes == nullptr && opts.runLSP && opts.lspParseDefinitionsSeparately) {
+            auto boundaries = parser::Parser::chunkBoundaries(file.data(gs).source(), 1);
+            if (!boundaries.empty()) {
+                nodes = parser::Parser::runChunks(gs, file, boundaries);
+            }
+        }
+        if (nodes == nullptr) {
+            nodes = parser::Parser::run(gs, file);
+        }
     }
     if (print.ParseTree.enabled) {
         print.ParseTree.fmt("{}\n", nodes->toStringWithTabs(gs, 0));
@@ -132,7 +500,7 @@ unique_ptr<parser::Node> runParser(core::GlobalState &gs, core::FileRef file, co
 
 unique_ptr<ast::Expression> runDesugar(core::GlobalState &gs, core::FileRef file, unique_ptr<parser::Node> parseTree,
                                        const options::Printers &print) {
-    Timer timeit(gs.tracer(), "runDesugar", {{"file", (string)file.data(gs).path()}});
+    FileTimer timeit(gs.tracer(), "runDesugar", "file", [&]() { return string(file.data(gs).path()); });
     unique_ptr<ast::Expression> ast;
     core::MutableContext ctx(gs, core::Symbols::root());
     {
@@ -149,20 +517,140 @@ unique_ptr<ast::Expression> runDesugar(core::GlobalState &gs, core::FileRef file
     return ast;
 }
 
+namespace {
+// Takes what namer and resolver use out of a method body: its constant references, global variables, nested methods
+// and the declarations of instance and class variables at its top level, which are kept whole.
+class MethodBodyDefinitions {
+    // Whether each assignment being walked is a declaration that is kept whole.
+    vector<bool> declarations;
+    int inDeclaration = 0;
+    // Blocks and nested methods being walked. Resolver only accepts (or reports) declarations there in place, so
+    // those are not kept.
+    int nesting = 0;
+
+    bool isDeclaration(const ast::Assign &asgn) const {
+        auto *uid = ast::cast_tree_const<ast::UnresolvedIdent>(asgn.lhs.get());
+        if (nesting > 0 || uid == nullptr ||
+            (uid->kind != ast::UnresolvedIdent::Instance && uid->kind != ast::UnresolvedIdent::Class)) {
+            return false;
+        }
+        auto *send = ast::cast_tree_const<ast::Send>(asgn.rhs.get());
+        return send != nullptr &&
+               (send->fun == core::Names::let() || send->fun == core::Names::cast() ||
+                send->fun == core::Names::assertType());
+    }
+
+    unique_ptr<ast::Expression> take(unique_ptr<ast::Expression> expr) {
+        kept.emplace_back(move(expr));
+        return ast::MK::EmptyTree();
+    }
+
+public:
+    ast::InsSeq::STATS_store kept;
+
+    unique_ptr<ast::Assign> preTransformAssign(core::MutableContext ctx, unique_ptr<ast::Assign> asgn) {
+        declarations.emplace_back(isDeclaration(*asgn));
+        if (declarations.back()) {
+            inDeclaration++;
+        }
+        return asgn;
+    }
+
+    unique_ptr<ast::Expression> postTransformAssign(core::MutableContext ctx, unique_ptr<ast::Assign> asgn) {
+        bool declaration = declarations.back();
+        declarations.pop_back();
+        if (!declaration) {
+            return asgn;
+        }
+        inDeclaration--;
+        return take(move(asgn));
+    }
+
+    unique_ptr<ast::Expression> postTransformUnresolvedConstantLit(core::MutableContext ctx,
+                                                                   unique_ptr<ast::UnresolvedConstantLit> cnst) {
+        return inDeclaration > 0 ? move(cnst) : take(move(cnst));
+    }
+
+    unique_ptr<ast::Expression> postTransformConstantLit(core::MutableContext ctx, unique_ptr<ast::ConstantLit> cnst) {
+        return inDeclaration > 0 ? move(cnst) : take(move(cnst));
+    }
+
+    unique_ptr<ast::Expression> postTransformUnresolvedIdent(core::MutableContext ctx,
+                                                             unique_ptr<ast::UnresolvedIdent> id) {
+        if (inDeclaration > 0 || id->kind != ast::UnresolvedIdent::Global) {
+            return id;
+        }
+        return take(move(id));
+    }
+
+    unique_ptr<ast::Block> preTransformBlock(core::MutableContext ctx, unique_ptr<ast::Block> block) {
+        nesting++;
+        return block;
+    }
+
+    unique_ptr<ast::Expression> postTransformBlock(core::MutableContext ctx, unique_ptr<ast::Block> block) {
+        nesting--;
+        return block;
+    }
+
+    unique_ptr<ast::MethodDef> preTransformMethodDef(core::MutableContext ctx, unique_ptr<ast::MethodDef> method) {
+        nesting++;
+        return method;
+    }
+
+    unique_ptr<ast::Expression> postTransformMethodDef(core::MutableContext ctx, unique_ptr<ast::MethodDef> method) {
+        nesting--;
+        // What namer and resolver use of its body is already kept.
+        method->rhs = ast::MK::EmptyTree();
+        return take(move(method));
+    }
+};
+
+// Replaces every method body with what MethodBodyDefinitions takes out of it.
+class DefinitionsOnly {
+public:
+    unique_ptr<ast::MethodDef> preTransformMethodDef(core::MutableContext ctx, unique_ptr<ast::MethodDef> method) {
+        MethodBodyDefinitions definitions;
+        auto loc = method->rhs->loc;
+        ast::TreeMap::apply(ctx, definitions, move(method->rhs));
+        method->rhs = ast::MK::InsSeq(loc, std::move(definitions.kept), ast::MK::EmptyTree());
+        return method;
+    }
+};
+
+unique_ptr<ast::Expression> runDefinitionsOnly(core::GlobalState &gs, core::FileRef file,
+                                               unique_ptr<ast::Expression> ast) {
+    FileTimer timeit(gs.tracer(), "runDefinitionsOnly", "file", [&]() { return string(file.data(gs).path()); });
+    prodCounterInc("types.input.files.definitions_only");
+    core::MutableContext ctx(gs, core::Symbols::root());
+    core::ErrorRegion errs(gs, file);
+    DefinitionsOnly definitionsOnly;
+    return ast::TreeMap::apply(ctx, definitionsOnly, move(ast));
+}
+} // namespace
+
 unique_ptr<ast::Expression> runDSL(core::GlobalState &gs, core::FileRef file, unique_ptr<ast::Expression> ast) {
     core::MutableContext ctx(gs, core::Symbols::root());
-    Timer timeit(gs.tracer(), "runDSL", {{"file", (string)file.data(gs).path()}});
+    FileTimer timeit(gs.tracer(), "runDSL", "file", [&]() { return string(file.data(gs).path()); });
     core::UnfreezeNameTable nameTableAccess(gs); // creates temporaries during desugaring
     core::ErrorRegion errs(gs, file);
     return dsl::DSL::run(ctx, move(ast));
 }
 
 ast::ParsedFile runLocalVars(core::GlobalState &gs, ast::ParsedFile tree) {
-    Timer timeit(gs.tracer(), "runLocalVars", {{"file", (string)tree.file.data(gs).path()}});
+    FileTimer timeit(gs.tracer(), "runLocalVars", "file", [&]() { return string(tree.file.data(gs).path()); });
     core::MutableContext ctx(gs, core::Symbols::root());
     return sorbet::local_vars::LocalVars::run(ctx, move(tree));
 }
 
+ast::ParsedFile runDSLAndLocalVars(core::GlobalState &gs, ast::ParsedFile tree) {
+    FileTimer timeit(gs.tracer(), "runDSLAndLocalVars", "file", [&]() { return string(tree.file.data(gs).path()); });
+    core::MutableContext ctx(gs, core::Symbols::root());
+    core::UnfreezeNameTable nameTableAccess(gs); // creates temporaries during desugaring
+    core::ErrorRegion errs(gs, tree.file);
+    return sorbet::local_vars::LocalVars::runWithDSL(ctx, move(tree));
+}
+
 ast::ParsedFile emptyParsedFile(core::FileRef file) {
     return {make_unique<ast::EmptyTree>(), file};
 }
@@ -175,14 +663,14 @@ ast::ParsedFile indexOne(const options::Options &opts, core::GlobalState &lgs, c
 
     Timer timeit(lgs.tracer(), "indexOne");
     try {
-        unique_ptr<ast::Expression> tree = fetchTreeFromCache(lgs, file, kvstore);
+        unique_ptr<ast::Expression> tree = fetchTreeFromCache(lgs, opts, file, kvstore);
 
         if (!tree) {
             // tree isn't cached. Need to start from parser
             if (file.data(lgs).strictLevel == core::StrictLevel::Ignore) {
                 return emptyParsedFile(file);
             }
-            auto parseTree = runParser(lgs, file, print);
+            auto parseTree = runParser(opts, lgs, file);
             if (opts.stopAfterPhase == options::Phase::PARSER) {
                 return emptyParsedFile(file);
             }
@@ -190,10 +678,17 @@ ast::ParsedFile indexOne(const options::Options &opts, core::GlobalState &lgs, c
             if (opts.stopAfterPhase == options::Phase::DESUGARER) {
                 return emptyParsedFile(file);
             }
-            if (!opts.skipDSLPasses) {
-                tree = runDSL(lgs, file, move(tree));
+            if (indexesDefinitionsOnly(opts, lgs, file)) {
+                tree = runDefinitionsOnly(lgs, file, move(tree));
+            }
+            if (opts.fuseDSLAndLocalVars && !opts.skipDSLPasses) {
+                tree = runDSLAndLocalVars(lgs, ast::ParsedFile{move(tree), file}).tree;
+            } else {
+                if (!opts.skipDSLPasses) {
+                    tree = runDSL(lgs, file, move(tree));
+                }
+                tree = runLocalVars(lgs, ast::ParsedFile{move(tree), file}).tree;
             }
-            tree = runLocalVars(lgs, ast::ParsedFile{move(tree), file}).tree;
             if (opts.stopAfterPhase == options::Phase::LOCAL_VARS) {
                 return emptyParsedFile(file);
             }
@@ -230,16 +725,23 @@ pair<ast::ParsedFile, vector<shared_ptr<core::File>>> indexOneWithPlugins(const
     ast::ParsedFile dslsInlined{nullptr, file};
     vector<shared_ptr<core::File>> resultPluginFiles;
 
-    Timer timeit(gs.tracer(), "indexOneWithPlugins", {{"file", (string)file.data(gs).path()}});
+    FileTimer timeit(gs.tracer(), "indexOneWithPlugins", "file", [&]() { return string(file.data(gs).path()); });
     try {
-        unique_ptr<ast::Expression> tree = fetchTreeFromCache(gs, file, kvstore);
+        // A cached tree is only usable together with the files plugins generated for it.
+        unique_ptr<ast::Expression> tree;
+        if (auto cachedPluginFiles = fetchPluginFilesFromCache(opts, gs, file, kvstore)) {
+            tree = fetchTreeFromCache(gs, opts, file, kvstore);
+            if (tree) {
+                resultPluginFiles = move(*cachedPluginFiles);
+            }
+        }
 
         if (!tree) {
             // tree isn't cached. Need to start from parser
             if (file.data(gs).strictLevel == core::StrictLevel::Ignore) {
                 return emptyPluginFile(file);
             }
-            auto parseTree = runParser(gs, file, print);
+            auto parseTree = runParser(opts, gs, file);
             if (opts.stopAfterPhase == options::Phase::PARSER) {
                 return emptyPluginFile(file);
             }
@@ -255,18 +757,28 @@ pair<ast::ParsedFile, vector<shared_ptr<core::File>>> indexOneWithPlugins(const
                 tree = move(pluginTree);
                 resultPluginFiles = move(pluginFiles);
             }
-
-            if (!opts.skipDSLPasses) {
-                tree = runDSL(gs, file, move(tree));
-            }
-            if (print.DSLTree.enabled) {
-                print.DSLTree.fmt("{}\n", tree->toStringWithTabs(gs, 0));
-            }
-            if (print.DSLTreeRaw.enabled) {
-                print.DSLTreeRaw.fmt("{}\n", tree->showRaw(gs));
+            // Plugins are triggered by sends anywhere in the file, so they still see the whole of it.
+            if (indexesDefinitionsOnly(opts, gs, file)) {
+                tree = runDefinitionsOnly(gs, file, move(tree));
             }
 
-            tree = runLocalVars(gs, ast::ParsedFile{move(tree), file}).tree;
+            // Printing the DSL tree needs it as it is before local variables are resolved.
+            if (opts.fuseDSLAndLocalVars && !opts.skipDSLPasses && !print.DSLTree.enabled &&
+                !print.DSLTreeRaw.enabled) {
+                tree = runDSLAndLocalVars(gs, ast::ParsedFile{move(tree), file}).tree;
+            } else {
+                if (!opts.skipDSLPasses) {
+                    tree = runDSL(gs, file, move(tree));
+                }
+                if (print.DSLTree.enabled) {
+                    print.DSLTree.fmt("{}\n", tree->toStringWithTabs(gs, 0));
+                }
+                if (print.DSLTreeRaw.enabled) {
+                    print.DSLTreeRaw.fmt("{}\n", tree->showRaw(gs));
+                }
+
+                tree = runLocalVars(gs, ast::ParsedFile{move(tree), file}).tree;
+            }
             if (opts.stopAfterPhase == options::Phase::LOCAL_VARS) {
                 return emptyPluginFile(file);
             }
@@ -294,6 +806,8 @@ pair<ast::ParsedFile, vector<shared_ptr<core::File>>> indexOneWithPlugins(const
 
 vector<ast::ParsedFile> incrementalResolve(core::GlobalState &gs, vector<ast::ParsedFile> what,
                                            const options::Options &opts) {
+    // Symbols entered from here on are new, e.g. the classes an edit added.
+    const u4 firstNewSymbol = gs.symbolsUsed();
     try {
         int i = 0;
         Timer timeit(gs.tracer(), "incremental_naming");
@@ -323,7 +837,7 @@ vector<ast::ParsedFile> incrementalResolve(core::GlobalState &gs, vector<ast::Pa
             core::UnfreezeSymbolTable symbolTable(gs);
             core::UnfreezeNameTable nameTable(gs);
 
-            what = sorbet::resolver::Resolver::runTreePasses(ctx, move(what));
+            what = sorbet::resolver::Resolver::runTreePasses(ctx, move(what), firstNewSymbol);
         }
     } catch (SorbetException &) {
         if (auto e = gs.beginError(sorbet::core::Loc::none(), sorbet::core::errors::Internal::InternalError)) {
@@ -334,17 +848,36 @@ vector<ast::ParsedFile> incrementalResolve(core::GlobalState &gs, vector<ast::Pa
     return what;
 }
 
+namespace {
+// Roughly how many bytes of Ruby source it takes to introduce one new name. Only used to size the name table up front
+// so that indexing does not have to rehash it as it goes.
+constexpr size_t SOURCE_BYTES_PER_NAME = 256;
+} // namespace
+
 vector<core::FileRef> reserveFiles(unique_ptr<core::GlobalState> &gs, const vector<string> &files) {
     Timer timeit(gs->tracer(), "reserveFiles");
     vector<core::FileRef> ret;
+    size_t sourceBytes = 0;
     core::UnfreezeFileTable unfreezeFiles(*gs);
     for (auto f : files) {
         auto fileRef = gs->findFileByPath(f);
-        if (!fileRef.exists()) {
+        if (fileRef.exists() && fileRef.dataAllowingUnsafe(*gs).sourceType == core::File::Payload) {
+            // Came with --rbi-bundle, which already holds its definitions unless the file changed since.
+            if (crypto_hashing::hash16(FileOps::read(f)) == fileRef.dataAllowingUnsafe(*gs).contentHash()) {
+                prodCounterInc("types.input.files.bundled");
+                continue;
+            }
+            gs->tracer().warn("`{}` changed since the --rbi-bundle was stored, which should be stored again", f);
+            gs = core::GlobalState::replaceFile(move(gs), fileRef,
+                                                make_shared<core::File>(string(f), "", core::File::NotYetRead));
+            sourceBytes += FileOps::fileSize(f);
+        } else if (!fileRef.exists()) {
             fileRef = gs->reserveFileRef(f);
+            sourceBytes += FileOps::fileSize(f);
         }
         ret.emplace_back(move(fileRef));
     }
+    gs->reserveNames(gs->namesUsed() + sourceBytes / SOURCE_BYTES_PER_NAME);
     return ret;
 }
 
@@ -424,39 +957,71 @@ void incrementStrictLevelCounter(core::StrictLevel level) {
     }
 }
 
-void readFileWithStrictnessOverrides(unique_ptr<core::GlobalState> &gs, core::FileRef file,
-                                     const options::Options &opts) {
-    if (file.dataAllowingUnsafe(*gs).sourceType != core::File::NotYetRead) {
-        return;
-    }
-    auto fileName = file.dataAllowingUnsafe(*gs).path();
-    Timer timeit(gs->tracer(), "readFileWithStrictnessOverrides", {{"file", (string)fileName}});
+struct PrefetchedFile {
+    core::FileRef file;
+    // Set instead of `src` when the file system can map files into memory, outside of the language server.
+    shared_ptr<MappedFile> mapped;
     string src;
     bool fileFound = true;
+};
+
+// The I/O half of readFileWithStrictnessOverrides. Only reads from `gs`, so it can run on any thread.
+PrefetchedFile prefetchFile(const core::GlobalState &gs, core::FileRef file, const options::Options &opts) {
+    PrefetchedFile prefetched{file};
+    if (file.dataAllowingUnsafe(gs).sourceType != core::File::NotYetRead) {
+        return prefetched;
+    }
+    auto fileName = file.dataAllowingUnsafe(gs).path();
+    FileTimer timeit(gs.tracer(), "readFile", "file", [&]() { return string(fileName); });
     try {
-        src = opts.fs->readFile(fileName);
+        // A mapped file that is truncated on disk raises SIGBUS when its lost pages are touched. The language server
+        // keeps files around for as long as it runs, while the editor and version control rewrite them underneath it,
+        // so it reads them into memory instead.
+        if (!opts.runLSP) {
+            prefetched.mapped = opts.fs->readFileMapped(fileName);
+        }
+        if (prefetched.mapped == nullptr) {
+            prefetched.src = opts.fs->readFile(fileName);
+        }
     } catch (FileNotFoundException e) {
         // continue with an empty source, because the
         // assertion below requires every input file to map
         // to one output tree
-        fileFound = false;
+        prefetched.fileFound = false;
+    }
+    return prefetched;
+}
+
+void enterFileWithStrictnessOverrides(core::GlobalState &gs, PrefetchedFile prefetched, const options::Options &opts) {
+    auto file = prefetched.file;
+    if (file.dataAllowingUnsafe(gs).sourceType != core::File::NotYetRead) {
+        return;
+    }
+    auto fileName = file.dataAllowingUnsafe(gs).path();
+    FileTimer timeit(gs.tracer(), "readFileWithStrictnessOverrides", "file", [&]() { return string(fileName); });
+    shared_ptr<core::File> entry;
+    if (prefetched.mapped != nullptr) {
+        entry = make_shared<core::File>(string(fileName.begin(), fileName.end()), move(prefetched.mapped),
+                                        core::File::Normal);
+    } else {
+        entry = make_shared<core::File>(string(fileName.begin(), fileName.end()), move(prefetched.src),
+                                        core::File::Normal);
     }
-    prodCounterAdd("types.input.bytes", src.size());
+    prodCounterAdd("types.input.bytes", entry->source().size());
     prodCounterInc("types.input.files");
 
     {
-        core::UnfreezeFileTable unfreezeFiles(*gs);
-        auto entered = gs->enterNewFileAt(
-            make_shared<core::File>(string(fileName.begin(), fileName.end()), move(src), core::File::Normal), file);
+        core::UnfreezeFileTable unfreezeFiles(gs);
+        auto entered = gs.enterNewFileAt(move(entry), file);
         ENFORCE(entered == file);
     }
     if (enable_counters) {
-        counterAdd("types.input.lines", file.data(*gs).lineCount());
+        counterAdd("types.input.lines", file.data(gs).lineCount());
     }
 
-    auto &fileData = file.data(*gs);
-    if (!fileFound) {
-        if (auto e = gs->beginError(sorbet::core::Loc::none(file), core::errors::Internal::FileNotFound)) {
+    auto &fileData = file.data(gs);
+    if (!prefetched.fileFound) {
+        if (auto e = gs.beginError(sorbet::core::Loc::none(file), core::errors::Internal::FileNotFound)) {
             e.setHeader("File Not Found");
         }
     }
@@ -465,11 +1030,16 @@ void readFileWithStrictnessOverrides(unique_ptr<core::GlobalState> &gs, core::Fi
         fileData.sourceType = core::File::PayloadGeneration;
     }
 
-    auto level = decideStrictLevel(*gs, file, opts);
+    auto level = decideStrictLevel(gs, file, opts);
     fileData.strictLevel = level;
     incrementStrictLevelCounter(level);
 }
 
+void readFileWithStrictnessOverrides(unique_ptr<core::GlobalState> &gs, core::FileRef file,
+                                     const options::Options &opts) {
+    enterFileWithStrictnessOverrides(*gs, prefetchFile(*gs, file, opts), opts);
+}
+
 struct IndexResult {
     unique_ptr<core::GlobalState> gs;
     vector<ast::ParsedFile> trees;
@@ -479,91 +1049,116 @@ struct IndexResult {
 struct IndexThreadResultPack {
     CounterState counters;
     IndexResult res;
+    CacheEntries cacheEntries;
 };
 
-IndexResult mergeIndexResults(const shared_ptr<core::GlobalState> cgs, const options::Options &opts,
+// Collects the trees that workers index concurrently into `gs`. Workers intern names in `gs` itself, so their trees
+// need no name substitution.
+IndexResult mergeIndexResults(core::GlobalState &gs, const options::Options &opts,
                               shared_ptr<BlockingBoundedQueue<IndexThreadResultPack>> input,
                               unique_ptr<KeyValueStore> &kvstore) {
     ProgressIndicator progress(opts.showProgress, "Indexing", input->bound);
-    Timer timeit(cgs->tracer(), "mergeIndexResults");
+    Timer timeit(gs.tracer(), "mergeIndexResults");
     IndexThreadResultPack threadResult;
     IndexResult ret;
-    for (auto result = input->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), cgs->tracer()); !result.done();
-         result = input->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), cgs->tracer())) {
+    for (auto result = input->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), gs.tracer()); !result.done();
+         result = input->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), gs.tracer())) {
         if (result.gotItem()) {
             counterConsume(move(threadResult.counters));
-            if (ret.gs == nullptr) {
-                ret.gs = move(threadResult.res.gs);
-                ENFORCE(ret.trees.empty());
-                ret.trees = move(threadResult.res.trees);
-                ret.pluginGeneratedFiles = move(threadResult.res.pluginGeneratedFiles);
-                cacheTrees(*ret.gs, kvstore, ret.trees);
-            } else {
-                core::GlobalSubstitution substitution(*threadResult.res.gs, *ret.gs, cgs.get());
-                core::MutableContext ctx(*ret.gs, core::Symbols::root());
-                {
-                    Timer timeit(cgs->tracer(), "substituteTrees");
-                    for (auto &tree : threadResult.res.trees) {
-                        auto file = tree.file;
-                        core::ErrorRegion errs(*ret.gs, file);
-                        if (!file.data(*ret.gs).cachedParseTree) {
-                            tree.tree = ast::Substitute::run(ctx, substitution, move(tree.tree));
-                        }
-                    }
-                }
-                cacheTrees(*ret.gs, kvstore, threadResult.res.trees);
-                ret.trees.insert(ret.trees.end(), make_move_iterator(threadResult.res.trees.begin()),
-                                 make_move_iterator(threadResult.res.trees.end()));
+            writeCacheEntries(kvstore, threadResult.cacheEntries);
+            ret.trees.insert(ret.trees.end(), make_move_iterator(threadResult.res.trees.begin()),
+                             make_move_iterator(threadResult.res.trees.end()));
 
-                ret.pluginGeneratedFiles.insert(ret.pluginGeneratedFiles.end(),
-                                                make_move_iterator(threadResult.res.pluginGeneratedFiles.begin()),
-                                                make_move_iterator(threadResult.res.pluginGeneratedFiles.end()));
-            }
+            ret.pluginGeneratedFiles.insert(ret.pluginGeneratedFiles.end(),
+                                            make_move_iterator(threadResult.res.pluginGeneratedFiles.begin()),
+                                            make_move_iterator(threadResult.res.pluginGeneratedFiles.end()));
             progress.reportProgress(input->doneEstimate());
-            ret.gs->errorQueue->flushErrors();
+            gs.errorQueue->flushErrors();
         }
     }
     return ret;
 }
 
-IndexResult indexSuppliedFiles(const shared_ptr<core::GlobalState> &baseGs, vector<core::FileRef> &files,
+IndexResult indexSuppliedFiles(unique_ptr<core::GlobalState> gs, vector<core::FileRef> &files,
                                const options::Options &opts, WorkerPool &workers, unique_ptr<KeyValueStore> &kvstore) {
-    Timer timeit(baseGs->tracer(), "indexSuppliedFiles");
+    Timer timeit(gs->tracer(), "indexSuppliedFiles");
     auto resultq = make_shared<BlockingBoundedQueue<IndexThreadResultPack>>(files.size());
     auto fileq = make_shared<ConcurrentBoundedQueue<core::FileRef>>(files.size());
+    // Files whose contents have been read, but that haven't been parsed yet.
+    auto readq = make_shared<BlockingBoundedQueue<PrefetchedFile>>(files.size());
     for (auto &file : files) {
         fileq->push(move(file), 1);
     }
 
-    workers.multiplexJob("indexSuppliedFiles", [baseGs, &opts, fileq, resultq, &kvstore]() {
-        Timer timeit(baseGs->tracer(), "indexSuppliedFilesWorker");
-        unique_ptr<core::GlobalState> localGs = baseGs->deepCopy();
-        IndexThreadResultPack threadResult;
+    IndexResult ret;
+    {
+        core::UnfreezeForConcurrentIndexing concurrentIndexing(*gs);
+        core::GlobalState *sharedGs = gs.get();
+
+        // Reading files is mostly waiting on I/O, so a dedicated thread reads ahead of the workers.
+        unique_ptr<Joinable> reader;
+        if (threads_supported) {
+            reader = runInAThread("readFiles", [sharedGs, &opts, fileq, readq]() {
+                core::FileRef file;
+                for (auto result = fileq->try_pop(file); !result.done(); result = fileq->try_pop(file)) {
+                    if (result.gotItem()) {
+                        readq->push(prefetchFile(*sharedGs, file, opts), 1);
+                    }
+                }
+            });
+        }
+
+        workers.multiplexJob("indexSuppliedFiles", files.size(), [sharedGs, &opts, fileq, readq, resultq, &kvstore]() {
+            Timer timeit(sharedGs->tracer(), "indexSuppliedFilesWorker");
+            IndexThreadResultPack threadResult;
 
-        {
-            core::FileRef job;
-            for (auto result = fileq->try_pop(job); !result.done(); result = fileq->try_pop(job)) {
-                if (result.gotItem()) {
-                    core::FileRef file = job;
-                    readFileWithStrictnessOverrides(localGs, file, opts);
-                    auto [parsedFile, pluginFiles] = indexOneWithPlugins(opts, *localGs, file, kvstore);
+            {
+                PrefetchedFile job;
+                while (true) {
+                    auto result = readq->try_pop(job);
+                    if (result.done()) {
+                        break;
+                    }
+                    if (!result.gotItem()) {
+                        // The reader thread hasn't caught up. Instead of waiting on it, read a file ourselves.
+                        core::FileRef file;
+                        if (fileq->try_pop(file).gotItem()) {
+                            readq->push(prefetchFile(*sharedGs, file, opts), 1);
+                            continue;
+                        }
+                        result = readq->wait_pop_timed(job, WorkerPool::BLOCK_INTERVAL(), sharedGs->tracer());
+                        if (!result.gotItem()) {
+                            continue;
+                        }
+                    }
+                    core::FileRef file = job.file;
+                    enterFileWithStrictnessOverrides(*sharedGs, move(job), opts);
+                    auto [parsedFile, pluginFiles] = indexOneWithPlugins(opts, *sharedGs, file, kvstore);
+                    if (kvstore && sharedGs->hasAnyDslPlugin() && !file.data(*sharedGs).cachedParseTree) {
+                        addPluginFilesCacheEntry(opts, *sharedGs, file, pluginFiles, threadResult.cacheEntries);
+                    }
                     threadResult.res.pluginGeneratedFiles.insert(threadResult.res.pluginGeneratedFiles.end(),
                                                                  make_move_iterator(pluginFiles.begin()),
                                                                  make_move_iterator(pluginFiles.end()));
                     threadResult.res.trees.emplace_back(move(parsedFile));
                 }
             }
-        }
 
-        if (!threadResult.res.trees.empty()) {
-            threadResult.counters = getAndClearThreadCounters();
-            threadResult.res.gs = move(localGs);
-            auto computedTreesCount = threadResult.res.trees.size();
-            resultq->push(move(threadResult), computedTreesCount);
-        }
-    });
+            if (!threadResult.res.trees.empty()) {
+                auto treeEntries = serializeTreesForCache(*sharedGs, opts, kvstore, threadResult.res.trees);
+                threadResult.cacheEntries.insert(threadResult.cacheEntries.end(),
+                                                 make_move_iterator(treeEntries.begin()),
+                                                 make_move_iterator(treeEntries.end()));
+                threadResult.counters = getAndClearThreadCounters();
+                auto computedTreesCount = threadResult.res.trees.size();
+                resultq->push(move(threadResult), computedTreesCount);
+            }
+        });
 
-    return mergeIndexResults(baseGs, opts, resultq, kvstore);
+        ret = mergeIndexResults(*gs, opts, resultq, kvstore);
+    }
+    ret.gs = move(gs);
+    return ret;
 }
 
 IndexResult indexPluginFiles(IndexResult firstPass, const options::Options &opts, WorkerPool &workers,
@@ -581,50 +1176,38 @@ IndexResult indexPluginFiles(IndexResult firstPass, const options::Options &opts
             pluginFileq->push(move(generatedFile), 1);
         }
     }
-    const shared_ptr<core::GlobalState> protoGs = move(firstPass.gs);
-    workers.multiplexJob("indexPluginFiles", [protoGs, &opts, pluginFileq, resultq, &kvstore]() {
-        Timer timeit(protoGs->tracer(), "indexPluginFilesWorker");
-        auto localGs = protoGs->deepCopy();
-        IndexThreadResultPack threadResult;
-        core::FileRef job;
+    firstPass.pluginGeneratedFiles.clear();
 
-        for (auto result = pluginFileq->try_pop(job); !result.done(); result = pluginFileq->try_pop(job)) {
-            if (result.gotItem()) {
-                core::FileRef file = job;
-                file.data(*localGs).strictLevel = decideStrictLevel(*localGs, file, opts);
-                threadResult.res.trees.emplace_back(indexOne(opts, *localGs, file, kvstore));
-            }
-        }
+    IndexResult indexedPluginFiles;
+    {
+        core::UnfreezeForConcurrentIndexing concurrentIndexing(*firstPass.gs);
+        core::GlobalState *sharedGs = firstPass.gs.get();
+        const size_t pluginFileCount = pluginFileq->bound;
+        workers.multiplexJob("indexPluginFiles", pluginFileCount, [sharedGs, &opts, pluginFileq, resultq, &kvstore]() {
+            Timer timeit(sharedGs->tracer(), "indexPluginFilesWorker");
+            IndexThreadResultPack threadResult;
+            core::FileRef job;
 
-        if (!threadResult.res.trees.empty()) {
-            threadResult.counters = getAndClearThreadCounters();
-            threadResult.res.gs = move(localGs);
-            auto sizeIncrement = threadResult.res.trees.size();
-            resultq->push(move(threadResult), sizeIncrement);
-        }
-    });
-    auto indexedPluginFiles = mergeIndexResults(protoGs, opts, resultq, kvstore);
-    IndexResult suppliedFilesAndPluginFiles;
-    if (indexedPluginFiles.trees.empty()) {
-        return firstPass;
-    }
-    suppliedFilesAndPluginFiles.gs = move(indexedPluginFiles.gs);
+            for (auto result = pluginFileq->try_pop(job); !result.done(); result = pluginFileq->try_pop(job)) {
+                if (result.gotItem()) {
+                    core::FileRef file = job;
+                    file.data(*sharedGs).strictLevel = decideStrictLevel(*sharedGs, file, opts);
+                    threadResult.res.trees.emplace_back(indexOne(opts, *sharedGs, file, kvstore));
+                }
+            }
 
-    {
-        Timer timeit(suppliedFilesAndPluginFiles.gs->tracer(), "incremental_resolve");
-        core::GlobalSubstitution substitution(*protoGs, *suppliedFilesAndPluginFiles.gs, protoGs.get());
-        core::MutableContext ctx(*suppliedFilesAndPluginFiles.gs, core::Symbols::root());
-        for (auto &tree : firstPass.trees) {
-            auto file = tree.file;
-            core::ErrorRegion errs(*suppliedFilesAndPluginFiles.gs, file);
-            tree.tree = ast::Substitute::run(ctx, substitution, move(tree.tree));
-        }
+            if (!threadResult.res.trees.empty()) {
+                threadResult.cacheEntries = serializeTreesForCache(*sharedGs, opts, kvstore, threadResult.res.trees);
+                threadResult.counters = getAndClearThreadCounters();
+                auto sizeIncrement = threadResult.res.trees.size();
+                resultq->push(move(threadResult), sizeIncrement);
+            }
+        });
+        indexedPluginFiles = mergeIndexResults(*firstPass.gs, opts, resultq, kvstore);
     }
-    suppliedFilesAndPluginFiles.trees = move(firstPass.trees);
-    suppliedFilesAndPluginFiles.trees.insert(suppliedFilesAndPluginFiles.trees.end(),
-                                             make_move_iterator(indexedPluginFiles.trees.begin()),
-                                             make_move_iterator(indexedPluginFiles.trees.end()));
-    return suppliedFilesAndPluginFiles;
+    firstPass.trees.insert(firstPass.trees.end(), make_move_iterator(indexedPluginFiles.trees.begin()),
+                           make_move_iterator(indexedPluginFiles.trees.end()));
+    return firstPass;
 }
 
 vector<ast::ParsedFile> index(unique_ptr<core::GlobalState> &gs, vector<core::FileRef> files,
@@ -645,6 +1228,11 @@ vector<ast::ParsedFile> index(unique_ptr<core::GlobalState> &gs, vector<core::Fi
         for (auto file : files) {
             readFileWithStrictnessOverrides(gs, file, opts);
             auto [parsedFile, pluginFiles] = indexOneWithPlugins(opts, *gs, file, kvstore);
+            if (kvstore && gs->hasAnyDslPlugin() && !file.data(*gs).cachedParseTree) {
+                CacheEntries entries;
+                addPluginFilesCacheEntry(opts, *gs, file, pluginFiles, entries);
+                writeCacheEntries(kvstore, entries);
+            }
             ret.emplace_back(move(parsedFile));
             pluginFileCount += pluginFiles.size();
             for (auto &pluginFile : pluginFiles) {
@@ -656,8 +1244,8 @@ vector<ast::ParsedFile> index(unique_ptr<core::GlobalState> &gs, vector<core::Fi
                 }
                 ret.emplace_back(indexOne(opts, *gs, pluginFileRef, kvstore));
             }
-            cacheTrees(*gs, kvstore, ret);
         }
+        cacheTrees(*gs, opts, kvstore, ret);
         ENFORCE(files.size() + pluginFileCount == ret.size());
     } else {
         auto firstPass = indexSuppliedFiles(move(gs), files, opts, workers, kvstore);
@@ -670,41 +1258,59 @@ vector<ast::ParsedFile> index(unique_ptr<core::GlobalState> &gs, vector<core::Fi
     return ret;
 }
 
-ast::ParsedFile typecheckOne(core::Context ctx, ast::ParsedFile resolved, const options::Options &opts) {
-    ast::ParsedFile result{make_unique<ast::EmptyTree>(), resolved.file};
+namespace {
+// Runs the passes of typecheckOne that come before inference. Returns false if `resolved` should not be inferred.
+bool prepareForInference(core::Context ctx, ast::ParsedFile &resolved, const options::Options &opts) {
     core::FileRef f = resolved.file;
 
-    resolved = definition_validator::runOne(ctx, std::move(resolved));
-
-    resolved = flatten::runOne(ctx, move(resolved));
+    if (f.data(ctx).isRBI() && !opts.print.FlattenedTree.enabled && !opts.print.FlattenedTreeRaw.enabled) {
+        // RBIs are never inferred, so only the definitions in them need validating; flattening would be for nothing.
+        resolved = definition_validator::runOne(ctx, move(resolved));
+        return false;
+    }
+    resolved = flatten::validateAndRunOne(ctx, move(resolved));
 
     if (opts.print.FlattenedTree.enabled) {
-        opts.print.FlattenedTree.fmt("{}\n", resolved.tree->toString(ctx));
+        opts.print.FlattenedTree.printForFile(f.id(), fmt::format("{}\n", resolved.tree->toString(ctx)));
     }
     if (opts.print.FlattenedTreeRaw.enabled) {
-        opts.print.FlattenedTreeRaw.fmt("{}\n", resolved.tree->showRaw(ctx));
+        opts.print.FlattenedTreeRaw.printForFile(f.id(), fmt::format("{}\n", resolved.tree->showRaw(ctx)));
     }
 
     if (opts.stopAfterPhase == options::Phase::NAMER || opts.stopAfterPhase == options::Phase::RESOLVER) {
-        return result;
+        return false;
     }
-    if (f.data(ctx).isRBI()) {
+    return !f.data(ctx).isRBI();
+}
+
+ast::ParsedFile typecheckOneWithCache(core::Context ctx, ast::ParsedFile resolved, const options::Options &opts,
+                                      const InferenceCache *cache, vector<string> &cleanMethods) {
+    ast::ParsedFile result{make_unique<ast::EmptyTree>(), resolved.file};
+    core::FileRef f = resolved.file;
+
+    if (!prepareForInference(ctx, resolved, opts)) {
         return result;
     }
 
-    Timer timeit(ctx.state.tracer(), "typecheckOne", {{"file", (string)f.data(ctx).path()}});
+    FileTimer timeit(ctx.state.tracer(), "typecheckOne", "file", [&]() { return string(f.data(ctx).path()); });
     try {
-        if (opts.print.CFG.enabled) {
-            opts.print.CFG.fmt("digraph \"{}\" {{\n", FileOps::getFileName(f.data(ctx).path()));
-        }
-        CFGCollectorAndTyper collector(opts);
+        CFGCollectorAndTyper collector(opts, cache);
         {
             core::ErrorRegion errs(ctx, f);
+            auto errorsBefore = core::ErrorQueue::errorsPushedByThisThread();
             result.tree = ast::TreeMap::apply(ctx, collector, move(resolved.tree));
+            collector.flushExported();
+            timeit.setTag("methods", to_string(collector.methodsInferred));
+            timeit.setTag("sends", to_string(collector.sendsDispatched));
+            timeit.setTag("errors", to_string(core::ErrorQueue::errorsPushedByThisThread() - errorsBefore));
         }
         if (opts.print.CFG.enabled) {
-            opts.print.CFG.fmt("}}\n\n");
+            opts.print.CFG.printForFile(f.id(), fmt::format("digraph \"{}\" {{\n{}}}\n\n",
+                                                            FileOps::getFileName(f.data(ctx).path()),
+                                                            collector.printedCFGs));
         }
+        cleanMethods.insert(cleanMethods.end(), make_move_iterator(collector.cleanMethods.begin()),
+                            make_move_iterator(collector.cleanMethods.end()));
     } catch (SorbetException &) {
         Exception::failInFuzzer();
         if (auto e = ctx.state.beginError(sorbet::core::Loc::none(f), core::errors::Internal::InternalError)) {
@@ -713,47 +1319,157 @@ ast::ParsedFile typecheckOne(core::Context ctx, ast::ParsedFile resolved, const
     }
     return result;
 }
+} // namespace
+
+ast::ParsedFile typecheckOne(core::Context ctx, ast::ParsedFile resolved, const options::Options &opts) {
+    vector<string> cleanMethods;
+    return typecheckOneWithCache(ctx, move(resolved), opts, nullptr, cleanMethods);
+}
 
 struct typecheck_thread_result {
     vector<ast::ParsedFile> trees;
+    vector<string> cleanMethods;
     CounterState counters;
 };
 
-vector<ast::ParsedFile> name(core::GlobalState &gs, vector<ast::ParsedFile> what, const options::Options &opts,
-                             bool skipConfigatron) {
-    Timer timeit(gs.tracer(), "name");
-    if (!skipConfigatron) {
-        core::UnfreezeNameTable nameTableAccess(gs);     // creates names from config
-        core::UnfreezeSymbolTable symbolTableAccess(gs); // creates methods for them
-        namer::configatron::fillInFromFileSystem(gs, opts.configatronDirs, opts.configatronFiles);
+namespace {
+// Files at least this large get their methods inferred as separate jobs, so that a few huge files picked up late
+// don't leave a single thread working at the tail of typechecking.
+constexpr size_t SPLIT_TYPECHECK_MIN_BYTES = 64 * 1024;
+
+// Typecheck workers hand what they have to the main thread after this many files or this much time, whichever comes
+// first, so that it can take in their trees and counters as they go rather than all at once at the end.
+constexpr int TYPECHECK_RESULT_BATCH_FILES = 16;
+constexpr auto TYPECHECK_RESULT_BATCH_INTERVAL = chrono::milliseconds(100);
+
+// A file whose methods are inferred by whichever threads are free. The thread that finishes the last method
+// reports the errors of every method, in the order typecheckOne would have, and hands the tree back.
+struct SplitTypecheckJob {
+    ast::ParsedFile file;
+    vector<ast::MethodDef *> methods;
+    vector<vector<core::ErrorQueueMessage>> errors;
+    atomic<int> remaining;
+};
+
+struct TypecheckMethodJob {
+    // Null for the job that tells the threads waiting for methods that every file is done.
+    shared_ptr<SplitTypecheckJob> split;
+    int method;
+};
+
+// Nothing reads a tree once it is typechecked: its errors and autocorrects are already in the error queue, and callers
+// only look at the files. Freeing it here rather than when the run ends keeps at most a few trees per thread alive.
+void addTypecheckedTree(const options::Options &opts, ast::ParsedFile tree, typecheck_thread_result &threadResult) {
+    if (opts.releaseTypecheckedTrees) {
+        tree.tree = make_unique<ast::EmptyTree>();
     }
+    threadResult.trees.emplace_back(move(tree));
+}
 
+void finishSplitJob(core::Context ctx, const options::Options &opts, SplitTypecheckJob &split,
+                    typecheck_thread_result &threadResult) {
     {
-        ProgressIndicator namingProgress(opts.showProgress, "Naming", what.size());
+        core::ErrorRegion errs(ctx, split.file.file);
+        for (auto &errors : split.errors) {
+            ctx.state.errorQueue->pushBuffered(move(errors));
+        }
+    }
+    addTypecheckedTree(opts, move(split.file), threadResult);
+}
 
-        int i = 0;
-        for (auto &tree : what) {
-            auto file = tree.file;
-            try {
-                ast::ParsedFile ast;
-                {
-                    core::MutableContext ctx(gs, core::Symbols::root());
-                    Timer timeit(gs.tracer(), "naming", {{"file", (string)file.data(gs).path()}});
-                    core::ErrorRegion errs(gs, file);
-                    core::UnfreezeNameTable nameTableAccess(gs);     // creates singletons and class names
-                    core::UnfreezeSymbolTable symbolTableAccess(gs); // enters symbols
-                    tree = namer::Namer::run(ctx, move(tree));
-                }
-                gs.errorQueue->flushErrors();
-                namingProgress.reportProgress(i);
-                i++;
-            } catch (SorbetException &) {
-                Exception::failInFuzzer();
-                if (auto e = gs.beginError(sorbet::core::Loc::none(file), core::errors::Internal::InternalError)) {
-                    e.setHeader("Exception naming file: `{}` (backtrace is above)", file.data(gs).path());
-                }
+// Returns true if this finished the last method of the file.
+bool typecheckSplitMethod(core::Context ctx, const options::Options &opts, const InferenceCache *cache,
+                          TypecheckMethodJob job, typecheck_thread_result &threadResult) {
+    auto &split = *job.split;
+    {
+        FileTimer timeit(ctx.state.tracer(), "typecheckSplitMethod", "file",
+                         [&]() { return string(split.file.file.data(ctx).path()); });
+        core::ErrorBuffer errors;
+        try {
+            CFGCollectorAndTyper collector(opts, cache);
+            collector.typecheckMethod(ctx, *split.methods[job.method]);
+            collector.flushExported();
+            timeit.setTag("methods", to_string(collector.methodsInferred));
+            timeit.setTag("sends", to_string(collector.sendsDispatched));
+            threadResult.cleanMethods.insert(threadResult.cleanMethods.end(),
+                                             make_move_iterator(collector.cleanMethods.begin()),
+                                             make_move_iterator(collector.cleanMethods.end()));
+        } catch (SorbetException &) {
+            Exception::failInFuzzer();
+            auto f = split.file.file;
+            if (auto e = ctx.state.beginError(sorbet::core::Loc::none(f), core::errors::Internal::InternalError)) {
+                e.setHeader("Exception in cfg+infer: {} (backtrace is above)", f.data(ctx).path());
             }
         }
+        timeit.setTag("errors", to_string(errors.messages.size()));
+        split.errors[job.method] = move(errors.messages);
+    }
+    if (split.remaining.fetch_sub(1) != 1) {
+        return false;
+    }
+    finishSplitJob(ctx, opts, split, threadResult);
+    return true;
+}
+
+// Returns true if the file is done, false if its methods were queued on `methodq` instead.
+bool typecheckOrSplit(core::Context ctx, const options::Options &opts, const InferenceCache *cache,
+                      ast::ParsedFile job, BlockingUnBoundedQueue<TypecheckMethodJob> &methodq,
+                      typecheck_thread_result &threadResult) {
+    core::FileRef file = job.file;
+    // --suggest-typed reads File::minErrorLevel, which every error of the file updates without synchronization.
+    if (opts.print.CFG.enabled || opts.suggestTyped || file.data(ctx).source().size() < SPLIT_TYPECHECK_MIN_BYTES) {
+        try {
+            addTypecheckedTree(opts, typecheckOneWithCache(ctx, move(job), opts, cache, threadResult.cleanMethods),
+                               threadResult);
+        } catch (SorbetException &) {
+            Exception::failInFuzzer();
+            ctx.state.tracer().error("Exception typing file: {} (backtrace is above)", file.data(ctx).path());
+        }
+        return true;
+    }
+
+    auto split = make_shared<SplitTypecheckJob>();
+    try {
+        if (!prepareForInference(ctx, job, opts)) {
+            threadResult.trees.emplace_back(ast::ParsedFile{make_unique<ast::EmptyTree>(), file});
+            return true;
+        }
+        MethodDefCollector collector;
+        job.tree = ast::TreeMap::apply(ctx, collector, move(job.tree));
+        split->methods = move(collector.methods);
+    } catch (SorbetException &) {
+        Exception::failInFuzzer();
+        ctx.state.tracer().error("Exception typing file: {} (backtrace is above)", file.data(ctx).path());
+        return true;
+    }
+    split->file = move(job);
+    split->errors.resize(split->methods.size());
+    split->remaining = split->methods.size();
+    if (split->methods.empty()) {
+        finishSplitJob(ctx, opts, *split, threadResult);
+        return true;
+    }
+    for (int i = 0; i < split->methods.size(); i++) {
+        methodq.push(TypecheckMethodJob{split, i}, 1);
+    }
+    return false;
+}
+} // namespace
+
+vector<ast::ParsedFile> name(core::GlobalState &gs, vector<ast::ParsedFile> what, const options::Options &opts,
+                             WorkerPool &workers, bool skipConfigatron) {
+    Timer timeit(gs.tracer(), "name");
+    if (!skipConfigatron) {
+        core::UnfreezeNameTable nameTableAccess(gs);     // creates names from config
+        core::UnfreezeSymbolTable symbolTableAccess(gs); // creates methods for them
+        namer::configatron::fillInFromFileSystem(gs, workers, opts.configatronDirs, opts.configatronFiles);
+    }
+
+    {
+        ProgressIndicator namingProgress(opts.showProgress, "Naming", 1);
+        what = namer::Namer::run(gs, move(what), workers);
+        gs.errorQueue->flushErrors();
+        namingProgress.reportProgress(1);
     }
 
     return what;
@@ -761,9 +1477,8 @@ vector<ast::ParsedFile> name(core::GlobalState &gs, vector<ast::ParsedFile> what
 class GatherUnresolvedConstantsWalk {
 public:
     vector<string> unresolvedConstants;
-    unique_ptr<ast::Expression> postTransformConstantLit(core::MutableContext ctx,
-                                                         unique_ptr<ast::ConstantLit> original) {
-        auto unresolvedPath = original->fullUnresolvedPath(ctx);
+    void postWalkConstantLit(core::Context ctx, const ast::ConstantLit &original) {
+        auto unresolvedPath = original.fullUnresolvedPath(ctx);
         if (unresolvedPath.has_value()) {
             unresolvedConstants.emplace_back(fmt::format(
                 "{}::{}",
@@ -771,23 +1486,101 @@ public:
                 fmt::map_join(unresolvedPath->second,
                               "::", [&](const auto &el) -> string { return el.data(ctx)->show(ctx); })));
         }
-        return original;
     }
 };
 
 vector<ast::ParsedFile> printMissingConstants(core::GlobalState &gs, const options::Options &opts,
                                               vector<ast::ParsedFile> what) {
     Timer timeit(gs.tracer(), "printMissingConstants");
-    core::MutableContext ctx(gs, core::Symbols::root());
+    core::Context ctx(gs, core::Symbols::root());
     GatherUnresolvedConstantsWalk walk;
     for (auto &resolved : what) {
-        resolved.tree = ast::TreeMap::apply(ctx, walk, move(resolved.tree));
+        ast::TreeWalk::apply(ctx, walk, resolved.tree.get());
     }
     fast_sort(walk.unresolvedConstants);
     opts.print.MissingConstants.fmt("{}\n", fmt::join(walk.unresolvedConstants, "\n"));
     return what;
 }
 
+// The files that define the constants one file mentions, other than itself and the payload. A constant reopened in
+// several files depends on all of them, since any of them can change what it means.
+class GatherFileDependenciesWalk {
+public:
+    const core::FileRef file;
+    vector<core::FileRef> dependencies;
+
+    GatherFileDependenciesWalk(core::FileRef file) : file(file) {}
+
+    void postWalkConstantLit(core::Context ctx, const ast::ConstantLit &lit) {
+        if (!lit.symbol.exists() || lit.symbol == core::Symbols::StubModule()) {
+            return;
+        }
+        for (auto loc : lit.symbol.data(ctx)->locs()) {
+            auto definedIn = loc.file();
+            if (definedIn.exists() && definedIn != file && definedIn.data(ctx).sourceType != core::File::Payload) {
+                dependencies.emplace_back(definedIn);
+            }
+        }
+    }
+};
+
+struct FileDependenciesResult {
+    vector<pair<core::FileRef, vector<core::FileRef>>> files;
+};
+
+vector<ast::ParsedFile> printFileDeps(core::GlobalState &gs, const options::Options &opts,
+                                      vector<ast::ParsedFile> what, WorkerPool &workers) {
+    Timer timeit(gs.tracer(), "printFileDeps");
+    auto resultq = make_shared<BlockingBoundedQueue<FileDependenciesResult>>(what.size());
+    auto fileq = make_shared<ConcurrentBoundedQueue<int>>(what.size());
+    for (int i = 0; i < what.size(); i++) {
+        fileq->push(move(i), 1);
+    }
+    const core::GlobalState &sharedGs = gs;
+    workers.multiplexJob("printFileDeps", [&sharedGs, &what, fileq, resultq]() {
+        core::Context ctx(sharedGs, core::Symbols::root());
+        FileDependenciesResult threadResult;
+        int idx = 0;
+        for (auto result = fileq->try_pop(idx); !result.done(); result = fileq->try_pop(idx)) {
+            if (result.gotItem()) {
+                GatherFileDependenciesWalk walk(what[idx].file);
+                ast::TreeWalk::apply(ctx, walk, what[idx].tree.get());
+                fast_sort(walk.dependencies);
+                walk.dependencies.erase(unique(walk.dependencies.begin(), walk.dependencies.end()),
+                                        walk.dependencies.end());
+                threadResult.files.emplace_back(walk.file, move(walk.dependencies));
+            }
+        }
+        if (!threadResult.files.empty()) {
+            auto sizeIncrement = threadResult.files.size();
+            resultq->push(move(threadResult), sizeIncrement);
+        }
+    });
+
+    vector<pair<core::FileRef, vector<core::FileRef>>> graph;
+    graph.reserve(what.size());
+    FileDependenciesResult threadResult;
+    for (auto result = resultq->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), gs.tracer());
+         !result.done(); result = resultq->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), gs.tracer())) {
+        if (result.gotItem()) {
+            graph.insert(graph.end(), make_move_iterator(threadResult.files.begin()),
+                         make_move_iterator(threadResult.files.end()));
+        }
+    }
+    // One JSON object per line, in path order, so that the output is stable and can be read as it is written.
+    auto path = [&](core::FileRef file) -> string { return JSON::escape(string(file.data(gs).path())); };
+    fast_sort(graph,
+              [&](const auto &a, const auto &b) -> bool { return a.first.data(gs).path() < b.first.data(gs).path(); });
+    for (auto &[file, dependencies] : graph) {
+        fast_sort(dependencies, [&](auto a, auto b) -> bool { return a.data(gs).path() < b.data(gs).path(); });
+        opts.print.FileDeps.fmt("{{\"file\":\"{}\",\"deps\":[{}]}}\n", path(file),
+                                fmt::map_join(dependencies, ",", [&](auto dep) -> string {
+                                    return fmt::format("\"{}\"", path(dep));
+                                }));
+    }
+    return what;
+}
+
 class DefinitionLinesBlacklistEnforcer {
 private:
     const core::FileRef file;
@@ -820,27 +1613,51 @@ public:
         ENFORCE(file.exists());
     };
 
-    unique_ptr<ast::ClassDef> preTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> original) {
-        checkSym(ctx, original->symbol);
-        return original;
+    void preWalkClassDef(core::Context ctx, const ast::ClassDef &original) {
+        checkSym(ctx, original.symbol);
     }
-    unique_ptr<ast::MethodDef> preTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> original) {
-        checkSym(ctx, original->symbol);
-        return original;
+    void preWalkMethodDef(core::Context ctx, const ast::MethodDef &original) {
+        checkSym(ctx, original.symbol);
     }
 };
 
 ast::ParsedFile checkNoDefinitionsInsideProhibitedLines(core::GlobalState &gs, ast::ParsedFile what,
                                                         int prohibitedLinesStart, int prohibitedLinesEnd) {
     DefinitionLinesBlacklistEnforcer enforcer(what.file, prohibitedLinesStart, prohibitedLinesEnd);
-    what.tree = ast::TreeMap::apply(core::Context(gs, core::Symbols::root()), enforcer, move(what.tree));
+    ast::TreeWalk::apply(core::Context(gs, core::Symbols::root()), enforcer, what.tree.get());
+    return what;
+}
+
+// The printers that show resolved trees. They also run on trees loaded by `cachedResolve`.
+vector<ast::ParsedFile> printResolved(core::GlobalState &gs, const options::Options &opts,
+                                      vector<ast::ParsedFile> what, WorkerPool &workers) {
+    if (opts.print.ResolveTree.enabled || opts.print.ResolveTreeRaw.enabled) {
+        for (auto &resolved : what) {
+            if (opts.print.ResolveTree.enabled) {
+                opts.print.ResolveTree.fmt("{}\n", resolved.tree->toString(gs));
+            }
+            if (opts.print.ResolveTreeRaw.enabled) {
+                opts.print.ResolveTreeRaw.fmt("{}\n", resolved.tree->showRaw(gs));
+            }
+        }
+    }
+    if (opts.print.MissingConstants.enabled) {
+        what = printMissingConstants(gs, opts, move(what));
+    }
+    if (opts.print.FileDeps.enabled) {
+        what = printFileDeps(gs, opts, move(what), workers);
+    }
     return what;
 }
 
 vector<ast::ParsedFile> resolve(unique_ptr<core::GlobalState> &gs, vector<ast::ParsedFile> what,
                                 const options::Options &opts, WorkerPool &workers, bool skipConfigatron) {
     try {
-        what = name(*gs, move(what), opts, skipConfigatron);
+        what = name(*gs, move(what), opts, workers, skipConfigatron);
+        if (!opts.runLSP) {
+            // LSP resolves over and over, which would add up the samples.
+            reportMemoryUsage(*gs, "memory.name", nullptr);
+        }
 
         for (auto &named : what) {
             if (opts.print.NameTree.enabled) {
@@ -895,69 +1712,525 @@ vector<ast::ParsedFile> resolve(unique_ptr<core::GlobalState> &gs, vector<ast::P
     }
 
     gs->errorQueue->flushErrors();
-    if (opts.print.ResolveTree.enabled || opts.print.ResolveTreeRaw.enabled) {
-        for (auto &resolved : what) {
-            if (opts.print.ResolveTree.enabled) {
-                opts.print.ResolveTree.fmt("{}\n", resolved.tree->toString(*gs));
-            }
-            if (opts.print.ResolveTreeRaw.enabled) {
-                opts.print.ResolveTreeRaw.fmt("{}\n", resolved.tree->showRaw(*gs));
-            }
+    return printResolved(*gs, opts, move(what), workers);
+}
+
+namespace {
+// Everything that decides what `resolve` produces: the contents and strictness of every file, payload included, and
+// the options that change which errors are reported or how they are printed.
+string resolvedStateKey(const core::GlobalState &gs, const options::Options &opts) {
+    string digest;
+    for (auto &file : gs.getFiles()) {
+        if (file == nullptr) {
+            continue;
         }
+        auto &hashBytes = file->contentHash();
+        absl::StrAppend(&digest, file->path(), "//", (int)file->strictLevel, "//",
+                        string_view{(char *)hashBytes.data(), size(hashBytes)});
     }
-    if (opts.print.MissingConstants.enabled) {
-        what = printMissingConstants(*gs, opts, move(what));
+    absl::StrAppend(&digest, fmt::format("{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}", fmt::join(opts.configatronDirs, ","),
+                                         fmt::join(opts.configatronFiles, ","),
+                                         fmt::join(opts.errorCodeWhiteList, ","),
+                                         fmt::join(opts.errorCodeBlackList, ","), opts.pathPrefix, opts.errorUrlBase,
+                                         opts.censorForSnapshotTests, opts.errorFormat));
+    auto hashBytes = sorbet::crypto_hashing::hash64(digest);
+    return absl::StrCat("resolved//", absl::BytesToHexString(string_view{(char *)hashBytes.data(), size(hashBytes)}));
+}
+
+string resolvedTreeKey(string_view stateKey, core::FileRef file) {
+    return absl::StrCat(stateKey, "//", file.id());
+}
+
+string resolvedErrorsKey(string_view stateKey) {
+    return absl::StrCat(stateKey, "//errors");
+}
+
+optional<vector<ast::ParsedFile>> fetchResolvedFromCache(core::GlobalState &gs, vector<ast::ParsedFile> &what,
+                                                         string_view stateKey,
+                                                         const unique_ptr<KeyValueStore> &kvstore) {
+    auto namesAndSymbols = kvstore->read(stateKey);
+    auto errors = kvstore->read(resolvedErrorsKey(stateKey));
+    if (namesAndSymbols == nullptr || errors == nullptr) {
+        prodCounterInc("types.input.resolved.kvstore.miss");
+        return nullopt;
+    }
+    // Make sure every tree is there before touching `gs`.
+    vector<u1 *> trees;
+    for (auto &file : what) {
+        auto tree = kvstore->read(resolvedTreeKey(stateKey, file.file));
+        if (tree == nullptr) {
+            prodCounterInc("types.input.resolved.kvstore.miss");
+            return nullopt;
+        }
+        trees.emplace_back(tree);
     }
 
+    Timer timeit(gs.tracer(), "read_resolved.kvstore");
+    prodCounterInc("types.input.resolved.kvstore.hit");
+    core::serialize::Serializer::loadNamesAndSymbols(gs, namesAndSymbols);
+    gs.ancestorIndex = core::AncestorIndex::build(gs);
+    vector<ast::ParsedFile> result;
+    for (int i = 0; i < what.size(); i++) {
+        auto file = what[i].file;
+        result.emplace_back(
+            ast::ParsedFile{core::serialize::Serializer::loadExpression(gs, trees[i], file.id()), file});
+    }
+    for (auto &error : core::serialize::Serializer::loadErrors(gs, errors)) {
+        gs.errorQueue->pushRenderedError(move(error));
+    }
+    return result;
+}
+
+void cacheResolved(core::GlobalState &gs, vector<ast::ParsedFile> &what, string_view stateKey,
+                   const vector<core::RenderedError> &errors, const unique_ptr<KeyValueStore> &kvstore) {
+    Timer timeit(gs.tracer(), "write_resolved.kvstore");
+    for (auto &file : what) {
+        kvstore->write(resolvedTreeKey(stateKey, file.file),
+                       core::serialize::Serializer::storeExpression(gs, file.tree));
+    }
+    kvstore->write(resolvedErrorsKey(stateKey), core::serialize::Serializer::storeErrors(errors));
+    // Written last: a state without its trees is never read back.
+    kvstore->write(stateKey, core::serialize::Serializer::storeNamesAndSymbols(gs));
+}
+} // namespace
+
+vector<ast::ParsedFile> cachedResolve(unique_ptr<core::GlobalState> &gs, vector<ast::ParsedFile> what,
+                                      const options::Options &opts, WorkerPool &workers,
+                                      unique_ptr<KeyValueStore> &kvstore) {
+    // Only resolved trees are stored, so printing the named ones means naming again.
+    const bool printsNamed = opts.print.NameTree.enabled || opts.print.NameTreeRaw.enabled;
+    if (kvstore == nullptr || opts.stopAfterPhase == options::Phase::NAMER || opts.stressIncrementalResolver ||
+        printsNamed) {
+        return resolve(gs, move(what), opts, workers);
+    }
+    // The errors of indexing are reported by every run; only those of naming and resolving get cached.
+    gs->errorQueue->flushErrors(true);
+    auto stateKey = resolvedStateKey(*gs, opts);
+    if (auto resolved = fetchResolvedFromCache(*gs, what, stateKey, kvstore)) {
+        if (!opts.runLSP) {
+            // What is loaded is what naming and resolving would have left, so it stands in for both.
+            reportMemoryUsage(*gs, "memory.name", nullptr);
+        }
+        return printResolved(*gs, opts, move(*resolved), workers);
+    }
+
+    gs->errorQueue->recordFlushedErrors = true;
+    what = resolve(gs, move(what), opts, workers);
+    gs->errorQueue->flushErrors(true);
+    gs->errorQueue->recordFlushedErrors = false;
+    auto errors = move(gs->errorQueue->recordedErrors);
+    gs->errorQueue->recordedErrors.clear();
+    if (!gs->hadCriticalError()) {
+        cacheResolved(*gs, what, stateKey, errors, kvstore);
+    }
     return what;
 }
 
+namespace {
+// Everything that decides what the project looks like apart from the contents of its files: where they come from,
+// configatron, and the options that change which errors are reported or how they are printed.
+string projectSnapshotKey(const options::Options &opts) {
+    auto digest =
+        fmt::format("{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}", fmt::join(opts.rawInputDirNames, ","),
+                    fmt::join(opts.rawInputFileNames, ","), fmt::join(opts.configatronDirs, ","),
+                    fmt::join(opts.configatronFiles, ","), fmt::join(opts.errorCodeWhiteList, ","),
+                    fmt::join(opts.errorCodeBlackList, ","), opts.pathPrefix, opts.errorUrlBase,
+                    opts.censorForSnapshotTests, opts.errorFormat);
+    auto hashBytes = sorbet::crypto_hashing::hash64(digest);
+    return absl::StrCat("project-snapshot//",
+                        absl::BytesToHexString(string_view{(char *)hashBytes.data(), size(hashBytes)}));
+}
+
+// The paths of --dir listings start with `./`, which people tend to leave out when naming a single file.
+core::FileRef findProjectFile(core::GlobalState &gs, string_view path) {
+    auto file = gs.findFileByPath(path);
+    if (!file.exists()) {
+        file = gs.findFileByPath(absl::StartsWith(path, "./") ? string(path.substr(2)) : absl::StrCat("./", path));
+    }
+    return file;
+}
+} // namespace
+
+void storeProjectSnapshot(core::GlobalState &gs, const options::Options &opts,
+                          const unique_ptr<KeyValueStore> &kvstore) {
+    if (opts.checkOnly.empty() || kvstore == nullptr || gs.hadCriticalError()) {
+        return;
+    }
+    Timer timeit(gs.tracer(), "write_project_snapshot.kvstore");
+    kvstore->write(projectSnapshotKey(opts), core::serialize::Serializer::store(gs));
+}
+
+bool loadProjectSnapshot(unique_ptr<core::GlobalState> &gs, const options::Options &opts,
+                         const unique_ptr<KeyValueStore> &kvstore) {
+    if (opts.checkOnly.empty() || kvstore == nullptr) {
+        return false;
+    }
+    auto data = kvstore->read(projectSnapshotKey(opts));
+    if (data == nullptr) {
+        prodCounterInc("types.input.project_snapshot.kvstore.miss");
+        return false;
+    }
+
+    Timer timeit(gs->tracer(), "read_project_snapshot.kvstore");
+    auto snapshot = make_unique<core::GlobalState>(gs->errorQueue);
+    snapshot->pathPrefix = gs->pathPrefix;
+    snapshot->errorUrlBase = gs->errorUrlBase;
+    core::serialize::Serializer::loadGlobalState(*snapshot, data);
+
+    // Like the fast path of LSP: the other files were resolved against the definitions these files had back then,
+    // so they must still define the same classes, modules and ancestors.
+    for (auto &path : opts.checkOnly) {
+        auto file = findProjectFile(*snapshot, path);
+        if (!file.exists()) {
+            gs->tracer().debug("Typechecking the whole project because `{}` is a new file", path);
+            prodCounterInc("types.input.project_snapshot.kvstore.miss");
+            return false;
+        }
+        string source;
+        try {
+            source = opts.fs->readFile(path);
+        } catch (FileNotFoundException &) {
+            return false;
+        }
+        auto &oldFile = file.data(*snapshot);
+        if (oldFile.source() == source) {
+            continue;
+        }
+        auto newFile = make_shared<core::File>(string(oldFile.path()), move(source), core::File::Type::Normal);
+        auto newHash = computeFileHash(newFile, gs->tracer());
+        auto oldHash = computeFileHash(
+            make_shared<core::File>(string(oldFile.path()), string(oldFile.source()), core::File::Type::Normal),
+            gs->tracer());
+        if (newHash.definitions.hierarchyHash != core::GlobalStateHash::HASH_STATE_INVALID &&
+            newHash.definitions.hierarchyHash != oldHash.definitions.hierarchyHash) {
+            gs->tracer().debug("Typechecking the whole project because `{}` has changed definitions", path);
+            prodCounterInc("types.input.project_snapshot.kvstore.miss");
+            return false;
+        }
+        snapshot = core::GlobalState::replaceFile(move(snapshot), file, move(newFile));
+    }
+    prodCounterInc("types.input.project_snapshot.kvstore.hit");
+    snapshot->ancestorIndex = core::AncestorIndex::build(*snapshot);
+    gs = move(snapshot);
+    return true;
+}
+
+vector<ast::ParsedFile> resolveInProjectSnapshot(unique_ptr<core::GlobalState> &gs, const options::Options &opts,
+                                                 unique_ptr<KeyValueStore> &kvstore) {
+    Timer timeit(gs->tracer(), "resolveInProjectSnapshot");
+    vector<core::FileRef> files;
+    for (auto &path : opts.checkOnly) {
+        files.emplace_back(findProjectFile(*gs, path));
+    }
+    fast_sort(files);
+    files.erase(unique(files.begin(), files.end()), files.end());
+
+    vector<ast::ParsedFile> indexed;
+    for (auto file : files) {
+        file.data(*gs).strictLevel = decideStrictLevel(*gs, file, opts);
+        indexed.emplace_back(indexOne(opts, *gs, file, kvstore));
+    }
+    return incrementalResolve(*gs, move(indexed), opts);
+}
+
+namespace {
+// A resolved state is stored as the state, then the number of trees, then the file id and size of every tree followed
+// by the tree itself.
+void appendU4(vector<u1> &out, u4 value) {
+    auto at = out.size();
+    out.resize(at + sizeof(value));
+    memcpy(out.data() + at, &value, sizeof(value));
+}
+
+void appendBlob(vector<u1> &out, const vector<u1> &blob) {
+    appendU4(out, blob.size());
+    out.insert(out.end(), blob.begin(), blob.end());
+}
+
+// Reads what `appendU4` wrote at `pos`, and moves `pos` past it.
+u4 readU4(spdlog::logger &tracer, string_view data, size_t &pos, string_view path) {
+    u4 value;
+    if (data.size() < pos + sizeof(value)) {
+        tracer.error("`{}` is not a state stored by --store-resolved", path);
+        throw options::EarlyReturnWithCode(1);
+    }
+    memcpy(&value, data.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return value;
+}
+
+// Reads what `appendBlob` wrote at `pos`, and moves `pos` past it.
+const u1 *readBlob(spdlog::logger &tracer, string_view data, size_t &pos, string_view path) {
+    auto size = readU4(tracer, data, pos, path);
+    if (data.size() < pos + size) {
+        tracer.error("`{}` is not a state stored by --store-resolved", path);
+        throw options::EarlyReturnWithCode(1);
+    }
+    auto blob = reinterpret_cast<const u1 *>(data.data() + pos);
+    pos += size;
+    return blob;
+}
+
+// Splits `files` into `shardCount` shards of about the same amount of source, going from the biggest file to the
+// smallest and putting each into the shard with the least source so far, and returns the ones of shard `shardIndex`.
+// Ties are broken by path, so every run splits the same state the same way.
+vector<int> filesOfShard(const core::GlobalState &gs, const vector<core::FileRef> &files, int shardIndex,
+                         int shardCount) {
+    vector<int> bySize(files.size());
+    for (int i = 0; i < files.size(); i++) {
+        bySize[i] = i;
+    }
+    fast_sort(bySize, [&](int lhs, int rhs) -> bool {
+        auto &left = files[lhs].data(gs);
+        auto &right = files[rhs].data(gs);
+        if (left.source().size() != right.source().size()) {
+            return left.source().size() > right.source().size();
+        }
+        return left.path() < right.path();
+    });
+    vector<size_t> shardSizes(shardCount, 0);
+    vector<int> result;
+    for (auto i : bySize) {
+        auto smallest = absl::c_min_element(shardSizes) - shardSizes.begin();
+        shardSizes[smallest] += files[i].data(gs).source().size();
+        if (smallest == shardIndex) {
+            result.emplace_back(i);
+        }
+    }
+    fast_sort(result);
+    return result;
+}
+} // namespace
+
+void storeResolved(core::GlobalState &gs, vector<ast::ParsedFile> &what, string_view path) {
+    if (gs.hadCriticalError()) {
+        return;
+    }
+    Timer timeit(gs.tracer(), "storeResolved");
+    vector<u1> out;
+    appendBlob(out, core::serialize::Serializer::store(gs));
+    appendU4(out, what.size());
+    for (auto &file : what) {
+        appendU4(out, file.file.id());
+        appendBlob(out, core::serialize::Serializer::storeExpression(gs, file.tree));
+    }
+    FileOps::write(path, out);
+}
+
+vector<ast::ParsedFile> loadResolved(unique_ptr<core::GlobalState> &gs, const options::Options &opts) {
+    Timer timeit(gs->tracer(), "loadResolved");
+    string data;
+    try {
+        data = FileOps::read(opts.loadResolved);
+    } catch (FileNotFoundException &) {
+        gs->tracer().error("Could not read the resolved state `{}`", opts.loadResolved);
+        throw options::EarlyReturnWithCode(1);
+    }
+
+    size_t pos = 0;
+    auto state = make_unique<core::GlobalState>(gs->errorQueue);
+    state->pathPrefix = gs->pathPrefix;
+    state->errorUrlBase = gs->errorUrlBase;
+    core::serialize::Serializer::loadGlobalState(*state, readBlob(gs->tracer(), data, pos, opts.loadResolved));
+    state->ancestorIndex = core::AncestorIndex::build(*state);
+
+    vector<core::FileRef> files;
+    vector<const u1 *> trees;
+    auto count = readU4(gs->tracer(), data, pos, opts.loadResolved);
+    for (u4 i = 0; i < count; i++) {
+        files.emplace_back(readU4(gs->tracer(), data, pos, opts.loadResolved));
+        trees.emplace_back(readBlob(gs->tracer(), data, pos, opts.loadResolved));
+    }
+
+    vector<ast::ParsedFile> result;
+    for (auto i : filesOfShard(*state, files, opts.shardIndex, opts.shardCount)) {
+        auto file = files[i];
+        file.data(*state).strictLevel = decideStrictLevel(*state, file, opts);
+        result.emplace_back(
+            ast::ParsedFile{core::serialize::Serializer::loadExpression(*state, trees[i], file.id()), file});
+    }
+    prodCounterAdd("types.input.files", result.size());
+    gs = move(state);
+    return result;
+}
+
+namespace {
+// The files that had errors when --fail-fast last typechecked the same input files, one path per line.
+string failingFilesKey(const options::Options &opts) {
+    auto digest =
+        fmt::format("{}\n{}", fmt::join(opts.rawInputDirNames, ","), fmt::join(opts.rawInputFileNames, ","));
+    auto hashBytes = sorbet::crypto_hashing::hash64(digest);
+    return absl::StrCat("failing-files//",
+                        absl::BytesToHexString(string_view{(char *)hashBytes.data(), size(hashBytes)}));
+}
+
+UnorderedSet<core::FileRef> fetchFailingFiles(core::GlobalState &gs, const options::Options &opts,
+                                              const unique_ptr<KeyValueStore> &kvstore) {
+    UnorderedSet<core::FileRef> result;
+    if (opts.failFast == 0 || kvstore == nullptr) {
+        return result;
+    }
+    for (string_view path : absl::StrSplit(kvstore->readString(failingFilesKey(opts)), '\n', absl::SkipEmpty())) {
+        auto file = gs.findFileByPath(path);
+        if (file.exists()) {
+            result.insert(file);
+        }
+    }
+    return result;
+}
+
+// Files that already failed and weren't typechecked this time, e.g. because the run stopped early, stay recorded.
+void storeFailingFiles(core::GlobalState &gs, const options::Options &opts, const UnorderedSet<core::FileRef> &before,
+                       const vector<ast::ParsedFile> &typechecked, const unique_ptr<KeyValueStore> &kvstore) {
+    if (opts.failFast == 0 || kvstore == nullptr) {
+        return;
+    }
+    UnorderedSet<core::FileRef> failing = gs.errorQueue->filesWithFlushedErrors;
+    UnorderedSet<core::FileRef> seen;
+    for (auto &tree : typechecked) {
+        seen.insert(tree.file);
+    }
+    for (auto file : before) {
+        if (!seen.contains(file)) {
+            failing.insert(file);
+        }
+    }
+    vector<string_view> paths;
+    for (auto file : failing) {
+        if (file.exists()) {
+            paths.emplace_back(file.data(gs).path());
+        }
+    }
+    fast_sort(paths);
+    kvstore->writeString(failingFilesKey(opts), absl::StrJoin(paths, "\n"));
+}
+} // namespace
+
+vector<ast::ParsedFile> typecheck(unique_ptr<core::GlobalState> &gs, vector<ast::ParsedFile> what,
+                                  const options::Options &opts, WorkerPool &workers,
+                                  const function<bool()> &isCanceled, const function<void()> &onProgress) {
+    unique_ptr<KeyValueStore> kvstore;
+    return typecheck(gs, move(what), opts, workers, kvstore, isCanceled, onProgress);
+}
+
 vector<ast::ParsedFile> typecheck(unique_ptr<core::GlobalState> &gs, vector<ast::ParsedFile> what,
-                                  const options::Options &opts, WorkerPool &workers) {
+                                  const options::Options &opts, WorkerPool &workers, unique_ptr<KeyValueStore> &kvstore,
+                                  const function<bool()> &isCanceled, const function<void()> &onProgress) {
     vector<ast::ParsedFile> typecheck_result;
+    optional<InferenceCache> cache;
+    if (kvstore != nullptr && opts.cacheMethodInference) {
+        cache.emplace(*gs, kvstore);
+    }
+    const InferenceCache *cachePtr = cache.has_value() ? &*cache : nullptr;
 
     {
         Timer timeit(gs->tracer(), "typecheck");
 
         shared_ptr<ConcurrentBoundedQueue<ast::ParsedFile>> fileq;
+        shared_ptr<BlockingUnBoundedQueue<TypecheckMethodJob>> methodq;
+        shared_ptr<atomic<int>> filesLeft;
         shared_ptr<BlockingBoundedQueue<typecheck_thread_result>> resultq;
+        auto canceled = make_shared<atomic<bool>>(false);
 
         {
             fileq = make_shared<ConcurrentBoundedQueue<ast::ParsedFile>>(what.size());
+            methodq = make_shared<BlockingUnBoundedQueue<TypecheckMethodJob>>();
+            filesLeft = make_shared<atomic<int>>(what.size());
             resultq = make_shared<BlockingBoundedQueue<typecheck_thread_result>>(what.size());
         }
 
         core::Context ctx(*gs, core::Symbols::root());
 
+        // Biggest files first, so that none of them is picked up when the other threads are about to run out of work.
+        // With --fail-fast, the files that failed last time go before all others, as they are the likeliest to fail.
+        auto failedBefore = fetchFailingFiles(*gs, opts, kvstore);
+        fast_sort(what, [&gs, &failedBefore](const auto &lhs, const auto &rhs) {
+            auto lhsFailed = failedBefore.contains(lhs.file);
+            auto rhsFailed = failedBefore.contains(rhs.file);
+            if (lhsFailed != rhsFailed) {
+                return lhsFailed;
+            }
+            auto lhsSize = lhs.file.data(*gs).source().size();
+            auto rhsSize = rhs.file.data(*gs).source().size();
+            return lhsSize != rhsSize ? lhsSize > rhsSize : lhs.file < rhs.file;
+        });
+        if (opts.failFast > 0) {
+            gs->errorQueue->recordFilesWithErrors = true;
+            gs->errorQueue->filesWithFlushedErrors.clear();
+        }
+        // Stops handing out files once --fail-fast errors have been reported, counting those of earlier phases.
+        auto failedFast = [&]() -> bool {
+            return opts.failFast > 0 && gs->errorQueue->nonSilencedErrorCount.load() >= opts.failFast;
+        };
+        if (failedFast()) {
+            canceled->store(true, memory_order_relaxed);
+        }
         for (auto &resolved : what) {
             fileq->push(move(resolved), 1);
         }
 
         {
             ProgressIndicator cfgInferProgress(opts.showProgress, "CFG+Inference", what.size());
-            workers.multiplexJob("typecheck", [ctx, &opts, fileq, resultq]() {
+            workers.multiplexJob("typecheck", [ctx, &opts, fileq, methodq, filesLeft, resultq, canceled, cachePtr]() {
+                // The hierarchy and symbol table are final by now, so this thread can remember subtyping answers,
+                // method lookups and instantiated generic types across files
+                core::SubtypingCache subtypingCache;
+                core::MethodLookupCache methodLookupCache;
+                core::AsSeenFromCache asSeenFromCache;
                 typecheck_thread_result threadResult;
                 ast::ParsedFile job;
+                TypecheckMethodJob methodJob;
                 int processedByThread = 0;
+                auto lastPush = chrono::steady_clock::now();
+                auto pushResult = [&]() {
+                    threadResult.counters = getAndClearThreadCounters();
+                    resultq->push(move(threadResult), processedByThread);
+                    threadResult = typecheck_thread_result();
+                    processedByThread = 0;
+                    lastPush = chrono::steady_clock::now();
+                };
 
                 {
-                    for (auto result = fileq->try_pop(job); !result.done(); result = fileq->try_pop(job)) {
-                        if (result.gotItem()) {
+                    while (filesLeft->load() > 0) {
+                        bool finishedFile;
+                        // Methods of split files go first: their file can't be reported until they are done.
+                        if (methodq->try_pop(methodJob).gotItem()) {
+                            if (methodJob.split == nullptr) {
+                                // Pass it on to the threads still waiting.
+                                methodq->push(move(methodJob), 0);
+                                continue;
+                            }
+                            finishedFile = typecheckSplitMethod(ctx, opts, cachePtr, move(methodJob), threadResult);
+                        } else if (fileq->try_pop(job).gotItem()) {
+                            // Split methods still run after a cancellation; their files are already counted as
+                            // started.
+                            finishedFile = canceled->load(memory_order_relaxed) ||
+                                           typecheckOrSplit(ctx, opts, cachePtr, move(job), *methodq, threadResult);
+                        } else if (methodq->wait_pop_timed(methodJob, WorkerPool::BLOCK_INTERVAL(), ctx.state.tracer())
+                                       .gotItem()) {
+                            if (methodJob.split == nullptr) {
+                                methodq->push(move(methodJob), 0);
+                                continue;
+                            }
+                            // Every file has been picked up, but other threads may still be splitting some of them.
+                            finishedFile = typecheckSplitMethod(ctx, opts, cachePtr, move(methodJob), threadResult);
+                        } else {
+                            continue;
+                        }
+                        if (finishedFile) {
                             processedByThread++;
-                            core::FileRef file = job.file;
-                            try {
-                                threadResult.trees.emplace_back(typecheckOne(ctx, move(job), opts));
-                            } catch (SorbetException &) {
-                                Exception::failInFuzzer();
-                                ctx.state.tracer().error("Exception typing file: {} (backtrace is above)",
-                                                         file.data(ctx).path());
+                            if (filesLeft->fetch_sub(1) == 1) {
+                                methodq->push(TypecheckMethodJob{nullptr, 0}, 0);
+                            }
+                            if (processedByThread >= TYPECHECK_RESULT_BATCH_FILES ||
+                                chrono::steady_clock::now() - lastPush >= TYPECHECK_RESULT_BATCH_INTERVAL) {
+                                pushResult();
                             }
                         }
                     }
                 }
                 if (processedByThread > 0) {
-                    threadResult.counters = getAndClearThreadCounters();
-                    resultq->push(move(threadResult), processedByThread);
+                    pushResult();
                 }
             });
 
@@ -968,14 +2241,36 @@ vector<ast::ParsedFile> typecheck(unique_ptr<core::GlobalState> &gs, vector<ast:
                      result = resultq->wait_pop_timed(threadResult, WorkerPool::BLOCK_INTERVAL(), gs->tracer())) {
                     if (result.gotItem()) {
                         counterConsume(move(threadResult.counters));
+                        for (auto &key : threadResult.cleanMethods) {
+                            InferenceCache::markClean(*kvstore, key);
+                        }
                         typecheck_result.insert(typecheck_result.end(), make_move_iterator(threadResult.trees.begin()),
                                                 make_move_iterator(threadResult.trees.end()));
                     }
-                    cfgInferProgress.reportProgress(fileq->doneEstimate());
+                    cfgInferProgress.reportProgress(resultq->enqueuedEstimate());
                     gs->errorQueue->flushErrors();
+                    if (onProgress) {
+                        onProgress();
+                    }
+                    if (!canceled->load(memory_order_relaxed) && ((isCanceled && isCanceled()) || failedFast())) {
+                        canceled->store(true, memory_order_relaxed);
+                    }
                 }
             }
         }
+        if (opts.failFast > 0) {
+            if (canceled->load(memory_order_relaxed)) {
+                prodCounterInc("types.fail_fast.stopped");
+            }
+            storeFailingFiles(*gs, opts, failedBefore, typecheck_result, kvstore);
+            gs->errorQueue->recordFilesWithErrors = false;
+            gs->errorQueue->filesWithFlushedErrors.clear();
+        }
+        // The worker threads kept these per file, so that the output is in file order however the files were split
+        // between them.
+        opts.print.FlattenedTree.printFilesInOrder();
+        opts.print.FlattenedTreeRaw.printFilesInOrder();
+        opts.print.CFG.printFilesInOrder();
 
         if (opts.print.SymbolTable.enabled) {
             opts.print.SymbolTable.fmt("{}\n", gs->toString());
@@ -983,25 +2278,23 @@ vector<ast::ParsedFile> typecheck(unique_ptr<core::GlobalState> &gs, vector<ast:
         if (opts.print.SymbolTableRaw.enabled) {
             opts.print.SymbolTableRaw.fmt("{}\n", gs->showRaw());
         }
+        // These are written as they are produced, since the whole symbol table can be too large to hold at once.
         if (opts.print.SymbolTableJson.enabled) {
-            auto root = core::Proto::toProto(*gs, core::Symbols::root(), false);
-            if (opts.print.SymbolTableJson.outputPath.empty()) {
-                core::Proto::toJSON(root, cout);
-            } else {
-                stringstream buf;
-                core::Proto::toJSON(root, buf);
-                opts.print.SymbolTableJson.print(buf.str());
-            }
+            core::Proto::symbolsToJSON(*gs, core::Symbols::root(), false,
+                                       [&](string_view out) { opts.print.SymbolTableJson.printUnbuffered(out); });
+        }
+        if (opts.print.SymbolTableProto.enabled) {
+            core::Proto::symbolsToDelimited(*gs, core::Symbols::root(), false,
+                                            [&](string_view out) { opts.print.SymbolTableProto.printUnbuffered(out); });
         }
         if (opts.print.SymbolTableFullJson.enabled) {
-            auto root = core::Proto::toProto(*gs, core::Symbols::root(), true);
-            if (opts.print.SymbolTableJson.outputPath.empty()) {
-                core::Proto::toJSON(root, cout);
-            } else {
-                stringstream buf;
-                core::Proto::toJSON(root, buf);
-                opts.print.SymbolTableJson.print(buf.str());
-            }
+            core::Proto::symbolsToJSON(*gs, core::Symbols::root(), true,
+                                       [&](string_view out) { opts.print.SymbolTableFullJson.printUnbuffered(out); });
+        }
+        if (opts.print.SymbolTableFullProto.enabled) {
+            core::Proto::symbolsToDelimited(
+                *gs, core::Symbols::root(), true,
+                [&](string_view out) { opts.print.SymbolTableFullProto.printUnbuffered(out); });
         }
         if (opts.print.SymbolTableFull.enabled) {
             opts.print.SymbolTableFull.fmt("{}\n", gs->toStringFull());
@@ -1030,17 +2323,15 @@ vector<ast::ParsedFile> typecheck(unique_ptr<core::GlobalState> &gs, vector<ast:
 class AllNamesCollector {
 public:
     core::UsageHash acc;
-    unique_ptr<ast::Send> preTransformSend(core::Context ctx, unique_ptr<ast::Send> original) {
-        acc.sends.emplace_back(ctx.state, original->fun.data(ctx));
-        return original;
+    void preWalkSend(core::Context ctx, const ast::Send &original) {
+        acc.sends.emplace_back(ctx.state, original.fun.data(ctx));
     }
 
-    unique_ptr<ast::MethodDef> postTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> original) {
-        acc.constants.emplace_back(ctx.state, original->name.data(ctx.state));
-        return original;
+    void postWalkMethodDef(core::Context ctx, const ast::MethodDef &original) {
+        acc.constants.emplace_back(ctx.state, original.name.data(ctx.state));
     }
 
-    void handleUnresolvedConstantLit(core::Context ctx, ast::UnresolvedConstantLit *expr) {
+    void handleUnresolvedConstantLit(core::Context ctx, const ast::UnresolvedConstantLit *expr) {
         while (expr) {
             acc.constants.emplace_back(ctx.state, expr->cnst.data(ctx));
             // Handle references to 'Foo' in 'Foo::Bar'.
@@ -1048,48 +2339,67 @@ public:
         }
     }
 
-    unique_ptr<ast::ClassDef> postTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> original) {
-        acc.constants.emplace_back(ctx.state, original->symbol.data(ctx)->name.data(ctx));
-        original->name->showRaw(ctx.state);
+    void postWalkClassDef(core::Context ctx, const ast::ClassDef &original) {
+        acc.constants.emplace_back(ctx.state, original.symbol.data(ctx)->name.data(ctx));
 
-        handleUnresolvedConstantLit(ctx, ast::cast_tree<ast::UnresolvedConstantLit>(original->name.get()));
+        handleUnresolvedConstantLit(ctx, ast::cast_tree<ast::UnresolvedConstantLit>(original.name.get()));
 
         // Grab names of superclasses. (N.B. `include` and `extend` are captured as ConstantLits.)
-        for (auto &ancst : original->ancestors) {
+        for (auto &ancst : original.ancestors) {
             handleUnresolvedConstantLit(ctx, ast::cast_tree<ast::UnresolvedConstantLit>(ancst.get()));
         }
-
-        return original;
     }
 
-    unique_ptr<ast::UnresolvedConstantLit>
-    postTransformUnresolvedConstantLit(core::Context ctx, unique_ptr<ast::UnresolvedConstantLit> original) {
-        handleUnresolvedConstantLit(ctx, original.get());
-        return original;
+    void postWalkUnresolvedConstantLit(core::Context ctx, const ast::UnresolvedConstantLit &original) {
+        handleUnresolvedConstantLit(ctx, &original);
     }
 
-    unique_ptr<ast::UnresolvedIdent> postTransformUnresolvedIdent(core::Context ctx,
-                                                                  unique_ptr<ast::UnresolvedIdent> id) {
-        if (id->kind != ast::UnresolvedIdent::Local) {
-            acc.constants.emplace_back(ctx.state, id->name.data(ctx));
+    void postWalkUnresolvedIdent(core::Context ctx, const ast::UnresolvedIdent &id) {
+        if (id.kind != ast::UnresolvedIdent::Local) {
+            acc.constants.emplace_back(ctx.state, id.name.data(ctx));
         }
-        return id;
     }
 };
 
-core::UsageHash getAllNames(const core::GlobalState &gs, unique_ptr<ast::Expression> &tree) {
+core::UsageHash getAllNames(const core::GlobalState &gs, const unique_ptr<ast::Expression> &tree) {
     AllNamesCollector collector;
-    tree = ast::TreeMap::apply(core::Context(gs, core::Symbols::root()), collector, move(tree));
+    ast::TreeWalk::apply(core::Context(gs, core::Symbols::root()), collector, tree.get());
     core::NameHash::sortAndDedupe(collector.acc.sends);
     core::NameHash::sortAndDedupe(collector.acc.constants);
     return move(collector.acc);
 };
 
+void reportMemoryUsage(const core::GlobalState &gs, ConstExprStr category, KeyValueStore *kvstore) {
+    auto usage = gs.memoryUsage();
+    prodCategoryCounterAdd(category, "names", usage.names);
+    prodCategoryCounterAdd(category, "symbols", usage.symbols);
+    prodCategoryCounterAdd(category, "files", usage.files);
+    prodCategoryCounterAdd(category, "strings", usage.strings);
+    // Freeing memory races with allocating it, so these can be momentarily off.
+    prodCategoryCounterAdd(category, "parse_trees", max<int64_t>(0, parser::Node::allocatedBytes()));
+    prodCategoryCounterAdd(category, "trees", max<int64_t>(0, ast::Expression::allocatedBytes()));
+    prodCategoryCounterAdd(category, "cfgs", max<int64_t>(0, cfg::BasicBlock::allocatedBytes()));
+    if (kvstore != nullptr) {
+        prodCategoryCounterAdd(category, "kvstore", kvstore->usedBytes());
+    }
+    // Peak RSS only grows, so a phase's value is the most the process had resident by the end of that phase.
+    prodCategoryCounterAdd(category, "max_rss", peakRssBytes());
+    prodCategoryCounterAdd(category, "heap_allocated", heapAllocatedBytes());
+}
+
 core::FileHash computeFileHash(shared_ptr<core::File> forWhat, spdlog::logger &logger) {
     Timer timeit(logger, "computeFileHash");
     const static options::Options emptyOpts{};
-    unique_ptr<core::GlobalState> lgs = make_unique<core::GlobalState>((make_shared<core::ErrorQueue>(logger, logger)));
-    lgs->initEmpty();
+    // Every file is hashed in a copy of the same empty state. Hashing that state once up front means that hashing a
+    // copy only has to look again at the symbols the file's definitions wrote to.
+    const static unique_ptr<const core::GlobalState> emptyGs = [&logger]() {
+        auto gs = make_unique<core::GlobalState>(make_shared<core::ErrorQueue>(logger, logger));
+        gs->initEmpty();
+        gs->hash();
+        return gs;
+    }();
+    unique_ptr<core::GlobalState> lgs = emptyGs->deepCopy();
+    lgs->errorQueue = make_shared<core::ErrorQueue>(logger, logger);
     lgs->errorQueue->ignoreFlushes = true;
     lgs->silenceErrors = true;
     core::FileRef fref;
@@ -1114,7 +2424,293 @@ core::FileHash computeFileHash(shared_ptr<core::File> forWhat, spdlog::logger &l
     auto workers = WorkerPool::create(0, lgs->tracer());
     pipeline::resolve(lgs, move(single), emptyOpts, *workers, true);
 
-    return {move(*lgs->hash()), move(allNames)};
+    auto hash = lgs->hash();
+    hash->definitionShapes = lgs->definitionShapes();
+    return {move(*hash), move(allNames)};
+}
+
+vector<core::FileHash> computeFileHashes(const vector<shared_ptr<core::File>> &files, spdlog::logger &logger,
+                                         WorkerPool &workers) {
+    Timer timeit(logger, "computeFileHashes");
+    vector<core::FileHash> res(files.size());
+    logger.debug("Computing state hashes for {} files", files.size());
+    // Every index is written by exactly one task, so the results need no synchronization.
+    workers.parallelFor("computeFileHashes", files.size(), [&res, &files, &logger](size_t i) {
+        if (files[i]) {
+            res[i] = computeFileHash(files[i], logger);
+        }
+    });
+    return res;
+}
+
+namespace {
+const string INCREMENTAL_MANIFEST_KEY = "incremental_manifest";
+
+string incrementalFileKey(const core::File &file) {
+    return absl::StrCat("incremental//", file.path());
+}
+
+string sourceHash(const core::File &file) {
+    auto &hashBytes = file.contentHash();
+    return absl::BytesToHexString(string_view{(char *)hashBytes.data(), size(hashBytes)});
+}
+
+// `computeFileHash` only looks at the contents of a file.
+string fileHashKey(const core::File &file) {
+    return absl::StrCat("file_hash//", sourceHash(file));
+}
+
+// Everything besides the files' own contents that can change which files get typechecked or what their errors
+// look like. If any of it differs from the previous run, every file is typechecked again.
+string incrementalManifest(const core::GlobalState &gs, const vector<ast::ParsedFile> &what,
+                           const options::Options &opts) {
+    vector<string> overrides;
+    for (auto &[path, level] : opts.strictnessOverrides) {
+        overrides.emplace_back(absl::StrCat(path, "=", (int)level));
+    }
+    fast_sort(overrides);
+    vector<string> paths;
+    for (auto &file : what) {
+        paths.emplace_back(file.file.data(gs).path());
+    }
+    return fmt::format("{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}", (int)opts.forceMinStrict,
+                       (int)opts.forceMaxStrict, fmt::join(overrides, ","), fmt::join(opts.errorCodeWhiteList, ","),
+                       fmt::join(opts.errorCodeBlackList, ","), opts.suggestSig, opts.supressNonCriticalErrors,
+                       opts.pathPrefix, opts.errorUrlBase, opts.censorForSnapshotTests, opts.errorFormat,
+                       fmt::join(paths, "\n"));
+}
+
+// Collects the names of methods whose definitions differ between `oldHash` and `newHash`, including methods that
+// only exist in one of them.
+void collectChangedMethods(const core::GlobalStateHash &oldHash, const core::GlobalStateHash &newHash,
+                           vector<core::NameHash> &changed) {
+    for (auto &[name, hash] : newHash.methodHashes) {
+        auto fnd = oldHash.methodHashes.find(name);
+        if (fnd == oldHash.methodHashes.end() || fnd->second != hash) {
+            changed.emplace_back(name);
+        }
+    }
+    for (auto &[name, hash] : oldHash.methodHashes) {
+        if (!newHash.methodHashes.contains(name)) {
+            changed.emplace_back(name);
+        }
+    }
+}
+
+bool sendsAny(const core::UsageHash &usages, const vector<core::NameHash> &names) {
+    // both are sorted and deduplicated
+    auto sendsIt = usages.sends.begin();
+    auto namesIt = names.begin();
+    while (sendsIt != usages.sends.end() && namesIt != names.end()) {
+        if (*sendsIt < *namesIt) {
+            sendsIt++;
+        } else if (*namesIt < *sendsIt) {
+            namesIt++;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+vector<ast::ParsedFile> incrementalTypecheck(unique_ptr<core::GlobalState> &gs, vector<ast::ParsedFile> what,
+                                             const options::Options &opts, WorkerPool &workers,
+                                             unique_ptr<KeyValueStore> &kvstore) {
+    ENFORCE(kvstore != nullptr);
+    Timer timeit(gs->tracer(), "incrementalTypecheck");
+    // Errors from the earlier phases are reported by every run; keep them out of the cached per-file errors.
+    gs->errorQueue->flushErrors(true);
+
+    auto manifest = incrementalManifest(*gs, what, opts);
+    bool fullRun = kvstore->readString(INCREMENTAL_MANIFEST_KEY) != manifest;
+    if (fullRun) {
+        gs->tracer().debug("Typechecking every file because the incremental manifest changed");
+    }
+
+    vector<core::FileRef> files;
+    vector<optional<core::serialize::CachedFileState>> cached(what.size());
+    vector<string> sourceHashes(what.size());
+    vector<int> changed;
+    vector<shared_ptr<core::File>> changedFiles;
+    for (int i = 0; i < what.size(); i++) {
+        files.emplace_back(what[i].file);
+        auto &file = files[i].data(*gs);
+        sourceHashes[i] = sourceHash(file);
+        if (auto data = kvstore->read(incrementalFileKey(file))) {
+            cached[i] = core::serialize::Serializer::loadFileState(*gs, files[i], data);
+        }
+        if (!cached[i].has_value() || cached[i]->sourceHash != sourceHashes[i]) {
+            changed.emplace_back(i);
+            changedFiles.emplace_back(
+                make_shared<core::File>(string(file.path()), string(file.source()), core::File::Type::Normal));
+        }
+    }
+
+    vector<core::FileHash> hashes(what.size());
+    vector<core::NameHash> changedMethods;
+    {
+        auto changedHashes = computeFileHashes(changedFiles, gs->tracer(), workers);
+        for (int i = 0; i < changed.size(); i++) {
+            auto idx = changed[i];
+            auto &newHash = changedHashes[i];
+            if (!cached[idx].has_value()) {
+                fullRun = true;
+            } else if (newHash.definitions.hierarchyHash != core::GlobalStateHash::HASH_STATE_INVALID) {
+                auto &oldHash = cached[idx]->hash.definitions;
+                if (newHash.definitions.hierarchyHash != oldHash.hierarchyHash) {
+                    gs->tracer().debug("Typechecking every file because {} has changed definitions",
+                                       files[idx].data(*gs).path());
+                    fullRun = true;
+                } else {
+                    collectChangedMethods(oldHash, newHash.definitions, changedMethods);
+                }
+            }
+            hashes[idx] = move(newHash);
+        }
+        core::NameHash::sortAndDedupe(changedMethods);
+    }
+    for (int i = 0; i < what.size(); i++) {
+        if (cached[i].has_value() && cached[i]->sourceHash == sourceHashes[i]) {
+            hashes[i] = move(cached[i]->hash);
+        }
+    }
+
+    vector<bool> recheck(what.size(), fullRun);
+    for (auto idx : changed) {
+        recheck[idx] = true;
+    }
+    if (!fullRun && !changedMethods.empty()) {
+        for (int i = 0; i < what.size(); i++) {
+            if (!recheck[i] && sendsAny(hashes[i].usages, changedMethods)) {
+                recheck[i] = true;
+            }
+        }
+    }
+
+    vector<ast::ParsedFile> toTypecheck;
+    vector<ast::ParsedFile> skipped;
+    for (int i = 0; i < what.size(); i++) {
+        if (recheck[i]) {
+            toTypecheck.emplace_back(move(what[i]));
+        } else {
+            for (auto &error : cached[i]->errors) {
+                gs->errorQueue->pushRenderedError(move(error));
+            }
+            skipped.emplace_back(move(what[i]));
+        }
+    }
+    prodCounterAdd("types.input.files.incremental.skipped", skipped.size());
+
+    gs->errorQueue->recordFlushedErrors = true;
+    auto result = typecheck(gs, move(toTypecheck), opts, workers, kvstore);
+    gs->errorQueue->flushErrors(true);
+    gs->errorQueue->recordFlushedErrors = false;
+    auto recorded = move(gs->errorQueue->recordedErrors);
+    gs->errorQueue->recordedErrors.clear();
+
+    result.insert(result.end(), make_move_iterator(skipped.begin()), make_move_iterator(skipped.end()));
+    if (gs->hadCriticalError()) {
+        // Leave the cache as it was so that the next run looks at these files again.
+        return result;
+    }
+
+    UnorderedMap<core::FileRef, vector<core::RenderedError>> errorsByFile;
+    for (auto &error : recorded) {
+        if (error.file.exists()) {
+            errorsByFile[error.file].emplace_back(move(error));
+        }
+    }
+    for (int i = 0; i < what.size(); i++) {
+        if (!recheck[i]) {
+            continue;
+        }
+        core::serialize::CachedFileState state;
+        state.sourceHash = move(sourceHashes[i]);
+        state.hash = move(hashes[i]);
+        state.errors = move(errorsByFile[files[i]]);
+        kvstore->write(incrementalFileKey(files[i].data(*gs)), core::serialize::Serializer::storeFileState(state));
+    }
+    kvstore->writeString(INCREMENTAL_MANIFEST_KEY, manifest);
+    KeyValueStore::commit(move(kvstore));
+    return result;
+}
+
+void typecheckDocumentStream(const core::GlobalState &base, const options::Options &opts, istream &in, ostream &out) {
+    size_t length = 0;
+    int documents = 0;
+    unique_ptr<KeyValueStore> kvstore;
+    while (in >> length && in.get() == '\n') {
+        string source(length, '\0');
+        if (!in.read(source.data(), length)) {
+            break;
+        }
+        documents++;
+        if (core::File::fileSigil(source) == core::StrictLevel::None) {
+            // As with -e: at the end, so as to not upset line numbers.
+            source += "\n# typed: true";
+        }
+        // The copy shares the tables of `base` until the document adds to them, which only takes what it defines.
+        auto gs = base.deepCopy();
+        core::FileRef file;
+        {
+            core::UnfreezeFileTable fileTableAccess(*gs);
+            file = gs->enterFile("-e", source);
+            file.data(*gs).strictLevel = decideStrictLevel(*gs, file, opts);
+        }
+        vector<ast::ParsedFile> trees;
+        trees.emplace_back(indexOne(opts, *gs, file, kvstore));
+        trees = incrementalResolve(*gs, move(trees), opts);
+        for (auto &tree : trees) {
+            typecheckOne(core::Context(*gs, core::Symbols::root()), move(tree), opts);
+        }
+        string errors;
+        for (auto &error : gs->errorQueue->drainAllErrors()) {
+            if (!error->isSilenced) {
+                absl::StrAppend(&errors, error->toString(*gs), "\n");
+            }
+        }
+        out << errors.size() << '\n' << errors << flush;
+    }
+    prodCounterAdd("types.input.files.streamed", documents);
+}
+
+vector<core::FileHash> computeFileHashes(core::GlobalState &gs, const vector<shared_ptr<core::File>> &files,
+                                         spdlog::logger &logger, WorkerPool &workers,
+                                         const unique_ptr<KeyValueStore> &kvstore) {
+    if (kvstore == nullptr) {
+        return computeFileHashes(files, logger, workers);
+    }
+    Timer timeit(logger, "computeFileHashes.kvstore");
+    vector<core::FileHash> res(files.size());
+    vector<string> keys(files.size());
+    vector<int> missing;
+    vector<shared_ptr<core::File>> missingFiles;
+    for (int i = 0; i < files.size(); i++) {
+        if (!files[i]) {
+            continue;
+        }
+        keys[i] = fileHashKey(*files[i]);
+        if (auto data = kvstore->read(keys[i])) {
+            prodCounterInc("types.input.file_hash.kvstore.hit");
+            res[i] = move(core::serialize::Serializer::loadFileState(gs, core::FileRef(), data).hash);
+        } else {
+            prodCounterInc("types.input.file_hash.kvstore.miss");
+            missing.emplace_back(i);
+            missingFiles.emplace_back(files[i]);
+        }
+    }
+
+    auto computed = computeFileHashes(missingFiles, logger, workers);
+    for (int i = 0; i < missing.size(); i++) {
+        auto idx = missing[i];
+        core::serialize::CachedFileState state;
+        state.sourceHash = sourceHash(*files[idx]);
+        state.hash = move(computed[i]);
+        kvstore->write(keys[idx], core::serialize::Serializer::storeFileState(state));
+        res[idx] = move(state.hash);
+    }
+    return res;
 }
 
 } // namespace sorbet::realmain::pipeline
@@ -7,6 +7,8 @@
 #include "common/kvstore/KeyValueStore.h"
 #include "core/NameHash.h"
 #include "main/options/options.h"
+#include <functional>
+#include <iosfwd>
 
 namespace sorbet::realmain::pipeline {
 ast::ParsedFile indexOne(const options::Options &opts, core::GlobalState &lgs, core::FileRef file,
@@ -25,19 +27,94 @@ std::vector<ast::ParsedFile> index(std::unique_ptr<core::GlobalState> &gs, std::
 std::vector<ast::ParsedFile> resolve(std::unique_ptr<core::GlobalState> &gs, std::vector<ast::ParsedFile> what,
                                      const options::Options &opts, WorkerPool &workers, bool skipConfigatron = false);
 
+// Like `resolve`, but when every file and the options that matter are the same as in an earlier run with the same
+// `kvstore`, loads the resolved trees, symbol table and errors that run stored instead of naming and resolving.
+std::vector<ast::ParsedFile> cachedResolve(std::unique_ptr<core::GlobalState> &gs, std::vector<ast::ParsedFile> what,
+                                           const options::Options &opts, WorkerPool &workers,
+                                           std::unique_ptr<KeyValueStore> &kvstore);
+
+// With --check-only, stores the resolved `gs` as the project snapshot that later runs with the same options check
+// their files against.
+void storeProjectSnapshot(core::GlobalState &gs, const options::Options &opts,
+                          const std::unique_ptr<KeyValueStore> &kvstore);
+
+// With --check-only, replaces `gs` with the project snapshot of an earlier run, holding the current contents of the
+// --check-only files. Returns false, leaving `gs` alone, when there is no snapshot or when one of those files is new
+// or defines different classes and modules than it did in the snapshot.
+bool loadProjectSnapshot(std::unique_ptr<core::GlobalState> &gs, const options::Options &opts,
+                         const std::unique_ptr<KeyValueStore> &kvstore);
+
+// Indexes the --check-only files again and resolves them into the snapshot that `loadProjectSnapshot` loaded.
+std::vector<ast::ParsedFile> resolveInProjectSnapshot(std::unique_ptr<core::GlobalState> &gs,
+                                                      const options::Options &opts,
+                                                      std::unique_ptr<KeyValueStore> &kvstore);
+
+// Stores the resolved `gs` and the resolved trees of its files `what` into `path`, for --load-resolved.
+void storeResolved(core::GlobalState &gs, std::vector<ast::ParsedFile> &what, std::string_view path);
+
+// Replaces `gs` with the state that --store-resolved stored into --load-resolved, and returns the resolved trees of
+// the files of --shard. Every run that loads the same state with the same number of shards splits its files the same
+// way, with about as much source in each shard.
+std::vector<ast::ParsedFile> loadResolved(std::unique_ptr<core::GlobalState> &gs, const options::Options &opts);
+
 std::vector<ast::ParsedFile> incrementalResolve(core::GlobalState &gs, std::vector<ast::ParsedFile> what,
                                                 const options::Options &opts);
 
 std::vector<ast::ParsedFile> name(core::GlobalState &gs, std::vector<ast::ParsedFile> what,
-                                  const options::Options &opts, bool skipConfigatron = false);
+                                  const options::Options &opts, WorkerPool &workers, bool skipConfigatron = false);
+
+// `isCanceled` is polled while files are being typechecked. Once it returns true, the files nobody has picked up yet
+// are skipped, and the result only has the trees that did get typechecked. `onProgress` is called on the calling
+// thread every time `isCanceled` is polled, so that it can look at the errors of the files typechecked so far.
+std::vector<ast::ParsedFile> typecheck(std::unique_ptr<core::GlobalState> &gs, std::vector<ast::ParsedFile> what,
+                                       const options::Options &opts, WorkerPool &workers,
+                                       const std::function<bool()> &isCanceled = nullptr,
+                                       const std::function<void()> &onProgress = nullptr);
 
+// With --cache-method-inference, skips methods that `kvstore` knows to be clean and records the ones that turn out
+// to be. Does not commit `kvstore`.
 std::vector<ast::ParsedFile> typecheck(std::unique_ptr<core::GlobalState> &gs, std::vector<ast::ParsedFile> what,
-                                       const options::Options &opts, WorkerPool &workers);
+                                       const options::Options &opts, WorkerPool &workers,
+                                       std::unique_ptr<KeyValueStore> &kvstore,
+                                       const std::function<bool()> &isCanceled = nullptr,
+                                       const std::function<void()> &onProgress = nullptr);
 
 ast::ParsedFile typecheckOne(core::Context ctx, ast::ParsedFile resolved, const options::Options &opts);
 
+// Typechecks only the files that changed since the last run with the same `--cache-dir`, plus the files that call
+// a method whose definition changed, and replays the cached errors of everything else. Falls back to typechecking
+// every file when the class hierarchy changed. Commits and consumes `kvstore`.
+std::vector<ast::ParsedFile> incrementalTypecheck(std::unique_ptr<core::GlobalState> &gs,
+                                                  std::vector<ast::ParsedFile> what, const options::Options &opts,
+                                                  WorkerPool &workers, std::unique_ptr<KeyValueStore> &kvstore);
+
+// Reads Ruby documents from `in`, each after a line with its length in bytes, and typechecks each one on its own
+// against a copy of `base`, which must already be resolved. After each document, writes its errors to `out` framed
+// the same way, so an empty record means it had none.
+void typecheckDocumentStream(const core::GlobalState &base, const options::Options &opts, std::istream &in,
+                             std::ostream &out);
+
+// Records how much memory the name, symbol, file and string tables, the parser, AST and CFG nodes of every thread,
+// and the data in `kvstore` (if not null) take up, along with the process's peak RSS and heap bytes allocated so far,
+// as prod counters in the `category` category.
+void reportMemoryUsage(const core::GlobalState &gs, ConstExprStr category, KeyValueStore *kvstore);
+
+// The key that the indexed tree of `file` is cached under: its path and a hash of its contents.
+std::string fileKey(const core::GlobalState &gs, core::FileRef file);
+
 core::FileHash computeFileHash(std::shared_ptr<core::File> forWhat, spdlog::logger &logger);
 
+// Computes `computeFileHash` for every file in parallel. `nullptr` entries get an empty hash.
+std::vector<core::FileHash> computeFileHashes(const std::vector<std::shared_ptr<core::File>> &files,
+                                              spdlog::logger &logger, WorkerPool &workers);
+
+// Like `computeFileHashes`, but reuses the hashes that `kvstore` remembers for file contents it has seen before, and
+// remembers the ones it had to compute. Does not commit `kvstore`.
+std::vector<core::FileHash> computeFileHashes(core::GlobalState &gs,
+                                              const std::vector<std::shared_ptr<core::File>> &files,
+                                              spdlog::logger &logger, WorkerPool &workers,
+                                              const std::unique_ptr<KeyValueStore> &kvstore);
+
 core::StrictLevel decideStrictLevel(const core::GlobalState &gs, const core::FileRef file,
                                     const options::Options &opts);
 
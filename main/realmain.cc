@@ -14,6 +14,7 @@
 #endif
 
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "common/FileOps.h"
 #include "common/Timer.h"
 #include "core/Error.h"
@@ -170,14 +171,44 @@ struct AutogenResult {
         vector<string> classlist;
         optional<autogen::Subclasses::Map> subclasses;
     };
+    // The counters and DefTree of a thread come with the result of its last file.
     CounterState counters;
     vector<pair<int, Serialized>> prints;
-    unique_ptr<autogen::DefTree> defTree = make_unique<autogen::DefTree>();
+    unique_ptr<autogen::DefTree> defTree;
+    // Msgpack and subclasses output that wasn't in the cache yet, for the thread that owns the cache to store.
+    vector<pair<string, string>> cacheEntries;
 };
 
+// How many files autogen workers may get ahead of the next file to print.
+constexpr int AUTOGEN_REORDER_WINDOW = 256;
+
+// Autogen output also depends on how constants resolved, which is what the hierarchy hash covers, so cached output
+// is only reused when the file, the autogen version, and the class hierarchy are all unchanged.
+string autogenMsgpackKey(core::Context ctx, const options::Options &opts, u4 hierarchyHash, core::FileRef file) {
+    return fmt::format("autogen-msgpack/{}/{}/{}", opts.autogenVersion, hierarchyHash,
+                       pipeline::fileKey(ctx.state, file));
+}
+
+// Which subclasses are listed also depends on the ignore patterns.
+string autogenSubclassesKey(core::Context ctx, const options::Options &opts, u4 hierarchyHash, core::FileRef file) {
+    auto patterns = absl::StrCat(absl::StrJoin(opts.autogenSubclassesAbsoluteIgnorePatterns, ","), ";",
+                                 absl::StrJoin(opts.autogenSubclassesRelativeIgnorePatterns, ","));
+    auto patternsHash = std::hash<string>{}(patterns);
+    return fmt::format("autogen-subclasses/{}/{}/{}/{}", opts.autogenVersion, hierarchyHash, patternsHash,
+                       pipeline::fileKey(ctx.state, file));
+}
+
 void runAutogen(core::Context ctx, options::Options &opts, const autogen::AutoloaderConfig &autoloaderCfg,
-                WorkerPool &workers, vector<ast::ParsedFile> &indexed) {
+                WorkerPool &workers, vector<ast::ParsedFile> &indexed, unique_ptr<KeyValueStore> &kvstore) {
     Timer timeit(logger, "autogen");
+    auto &print = opts.print;
+    // Trees only have to be generated for the msgpack and subclasses outputs, which can come from the cache.
+    const bool useCache = kvstore != nullptr && (print.AutogenMsgPack.enabled || print.AutogenSubclasses.enabled) &&
+                          !print.Autogen.enabled && !print.AutogenClasslist.enabled && !print.AutogenAutoloader.enabled;
+    const bool cacheMsgpack = useCache && print.AutogenMsgPack.enabled;
+    const bool cacheSubclasses = useCache && print.AutogenSubclasses.enabled;
+    const u4 hierarchyHash = useCache ? ctx.state.hash()->hierarchyHash : 0;
+    KeyValueStore *cache = kvstore.get();
 
     auto resultq = make_shared<BlockingBoundedQueue<AutogenResult>>(indexed.size());
     auto fileq = make_shared<ConcurrentBoundedQueue<int>>(indexed.size());
@@ -185,87 +216,173 @@ void runAutogen(core::Context ctx, options::Options &opts, const autogen::Autolo
         fileq->push(move(i), 1);
     }
 
-    workers.multiplexJob("runAutogen", [&ctx, &opts, &indexed, &autoloaderCfg, fileq, resultq]() {
-        AutogenResult out;
-        int n = 0;
-        {
-            Timer timeit(logger, "autogenWorker");
-            int idx = 0;
-
-            for (auto result = fileq->try_pop(idx); !result.done(); result = fileq->try_pop(idx)) {
-                ++n;
-                auto &tree = indexed[idx];
-                if (tree.file.data(ctx).isRBI()) {
-                    continue;
-                }
-                auto pf = autogen::Autogen::generate(ctx, move(tree));
-                tree = move(pf.tree);
-
+    // Results are printed in the order of `indexed` as soon as all earlier ones are, and no thread gets more than
+    // AUTOGEN_REORDER_WINDOW files ahead of the next one to print, so that only that many results are held at once.
+    auto printed = make_shared<atomic<int>>(0);
+    const auto printingThread = this_thread::get_id();
+    workers.multiplexJob("runAutogen", [&ctx, &opts, &indexed, &autoloaderCfg, fileq, resultq, useCache,
+                                        cacheMsgpack, cacheSubclasses, hierarchyHash, cache, printed,
+                                        printingThread]() {
+        Timer timeit(logger, "autogenWorker");
+        auto defTree = make_unique<autogen::DefTree>();
+        auto generate = [&](int idx, AutogenResult &out) {
+            auto &tree = indexed[idx];
+            if (tree.file.data(ctx).isRBI()) {
+                // Nothing to print, but the file's turn still has to come.
+                out.prints.emplace_back(make_pair(idx, AutogenResult::Serialized{}));
+                return;
+            }
+            string cacheKey;
+            string subclassesCacheKey;
+            if (useCache) {
+                // Only a file whose every output is cached can skip generating.
                 AutogenResult::Serialized serialized;
-                if (opts.print.Autogen.enabled) {
-                    Timer timeit(logger, "autogenToString");
-                    serialized.strval = pf.toString(ctx);
+                bool hit = true;
+                if (cacheMsgpack) {
+                    cacheKey = autogenMsgpackKey(ctx, opts, hierarchyHash, tree.file);
+                    auto cached = cache->readString(cacheKey);
+                    if (!cached.empty()) {
+                        prodCounterInc("autogen.msgpack.kvstore.hit");
+                        serialized.msgpack = string(cached);
+                    } else {
+                        prodCounterInc("autogen.msgpack.kvstore.miss");
+                        hit = false;
+                    }
                 }
-                if (opts.print.AutogenMsgPack.enabled) {
-                    Timer timeit(logger, "autogenToMsgpack");
-                    serialized.msgpack = pf.toMsgpack(ctx, opts.autogenVersion);
+                if (cacheSubclasses) {
+                    subclassesCacheKey = autogenSubclassesKey(ctx, opts, hierarchyHash, tree.file);
+                    serialized.subclasses =
+                        autogen::Subclasses::deserializeEntries(cache->readString(subclassesCacheKey));
+                    if (serialized.subclasses.has_value()) {
+                        prodCounterInc("autogen.subclasses.kvstore.hit");
+                    } else {
+                        prodCounterInc("autogen.subclasses.kvstore.miss");
+                        hit = false;
+                    }
                 }
-                if (opts.print.AutogenClasslist.enabled) {
-                    Timer timeit(logger, "autogenClasslist");
-                    serialized.classlist = pf.listAllClasses(ctx);
+                if (hit) {
+                    out.prints.emplace_back(make_pair(idx, move(serialized)));
+                    return;
                 }
-                if (opts.print.AutogenSubclasses.enabled) {
-                    Timer timeit(logger, "autogenSubclasses");
-                    serialized.subclasses =
-                        autogen::Subclasses::listAllSubclasses(ctx, pf, opts.autogenSubclassesAbsoluteIgnorePatterns,
-                                                               opts.autogenSubclassesRelativeIgnorePatterns);
+            }
+            auto pf = autogen::Autogen::generate(ctx, move(tree));
+            tree = move(pf.tree);
+
+            AutogenResult::Serialized serialized;
+            if (opts.print.Autogen.enabled) {
+                Timer timeit(logger, "autogenToString");
+                serialized.strval = pf.toString(ctx);
+            }
+            if (opts.print.AutogenMsgPack.enabled) {
+                Timer timeit(logger, "autogenToMsgpack");
+                serialized.msgpack = pf.toMsgpack(ctx, opts.autogenVersion);
+                if (cacheMsgpack) {
+                    out.cacheEntries.emplace_back(move(cacheKey), serialized.msgpack);
                 }
-                if (opts.print.AutogenAutoloader.enabled) {
-                    Timer timeit(logger, "autogenNamedDefs");
-                    autogen::DefTreeBuilder::addParsedFileDefinitions(ctx, autoloaderCfg, out.defTree, pf);
+            }
+            if (opts.print.AutogenClasslist.enabled) {
+                Timer timeit(logger, "autogenClasslist");
+                serialized.classlist = pf.listAllClasses(ctx);
+            }
+            if (opts.print.AutogenSubclasses.enabled) {
+                Timer timeit(logger, "autogenSubclasses");
+                serialized.subclasses =
+                    autogen::Subclasses::listAllSubclasses(ctx, pf, opts.autogenSubclassesAbsoluteIgnorePatterns,
+                                                           opts.autogenSubclassesRelativeIgnorePatterns);
+                if (cacheSubclasses) {
+                    // An ignored file is cached as one without subclasses.
+                    auto found = serialized.subclasses.value_or(autogen::Subclasses::Map{});
+                    out.cacheEntries.emplace_back(move(subclassesCacheKey),
+                                                  autogen::Subclasses::serializeEntries(found));
                 }
+            }
+            if (opts.print.AutogenAutoloader.enabled) {
+                Timer timeit(logger, "autogenNamedDefs");
+                autogen::DefTreeBuilder::addParsedFileDefinitions(ctx, autoloaderCfg, defTree, pf);
+            }
+
+            out.prints.emplace_back(make_pair(idx, move(serialized)));
+        };
 
-                out.prints.emplace_back(make_pair(idx, serialized));
+        int idx = 0;
+        auto popNext = [&]() -> bool {
+            for (auto result = fileq->try_pop(idx); !result.done(); result = fileq->try_pop(idx)) {
+                if (result.gotItem()) {
+                    return true;
+                }
             }
+            return false;
+        };
+        // One file is popped ahead, so that the result of the last file of this thread can also carry its counters
+        // and DefTree.
+        for (bool hasNext = popNext(); hasNext;) {
+            // When there are no workers, this runs on the printing thread, which can't wait for itself.
+            while (this_thread::get_id() != printingThread && idx >= printed->load() + AUTOGEN_REORDER_WINDOW) {
+                this_thread::sleep_for(chrono::microseconds(100));
+            }
+            AutogenResult out;
+            generate(idx, out);
+            hasNext = popNext();
+            if (!hasNext) {
+                out.counters = getAndClearThreadCounters();
+                out.defTree = move(defTree);
+            }
+            resultq->push(move(out), 1);
         }
-
-        out.counters = getAndClearThreadCounters();
-        resultq->push(move(out), n);
     });
 
-    autogen::DefTree root;
+    vector<autogen::DefTree> defTrees;
     AutogenResult out;
+    // What is left to print once every file is done, in file order.
     vector<pair<int, AutogenResult::Serialized>> merged;
+    UnorderedMap<int, AutogenResult::Serialized> pending;
+    int nextToPrint = 0;
     for (auto res = resultq->wait_pop_timed(out, chrono::seconds{1}, *logger); !res.done();
          res = resultq->wait_pop_timed(out, chrono::seconds{1}, *logger)) {
         if (!res.gotItem()) {
             continue;
         }
         counterConsume(move(out.counters));
-        merged.insert(merged.end(), make_move_iterator(out.prints.begin()), make_move_iterator(out.prints.end()));
-        if (opts.print.AutogenAutoloader.enabled) {
-            Timer timeit(logger, "autogenAutoloaderDefTreeMerge");
-            root = autogen::DefTreeBuilder::merge(ctx, move(root), move(*out.defTree));
+        for (auto &[key, value] : out.cacheEntries) {
+            kvstore->writeString(key, value);
         }
-    }
-    fast_sort(merged, [](const auto &lhs, const auto &rhs) -> bool { return lhs.first < rhs.first; });
-
-    for (auto &elem : merged) {
-        if (opts.print.Autogen.enabled) {
-            opts.print.Autogen.print(elem.second.strval);
+        for (auto &[idx, serialized] : out.prints) {
+            pending[idx] = move(serialized);
         }
-        if (opts.print.AutogenMsgPack.enabled) {
-            opts.print.AutogenMsgPack.print(elem.second.msgpack);
+        if (opts.print.AutogenAutoloader.enabled && out.defTree != nullptr) {
+            defTrees.emplace_back(move(*out.defTree));
+        }
+        for (auto it = pending.find(nextToPrint); it != pending.end(); it = pending.find(nextToPrint)) {
+            auto &serialized = it->second;
+            if (opts.print.Autogen.enabled) {
+                opts.print.Autogen.printUnbuffered(serialized.strval);
+            }
+            if (opts.print.AutogenMsgPack.enabled) {
+                opts.print.AutogenMsgPack.printUnbuffered(serialized.msgpack);
+            }
+            serialized.strval.clear();
+            serialized.msgpack.clear();
+            merged.emplace_back(nextToPrint, move(serialized));
+            pending.erase(it);
+            nextToPrint++;
+            printed->store(nextToPrint);
         }
     }
+    ENFORCE(pending.empty());
     if (opts.print.AutogenAutoloader.enabled) {
+        autogen::DefTree root;
+        {
+            Timer timeit(logger, "autogenAutoloaderDefTreeMerge");
+            root = autogen::DefTreeBuilder::mergeAll(ctx, workers, move(defTrees));
+        }
         {
             Timer timeit(logger, "autogenAutoloaderPrune");
             autogen::DefTreeBuilder::collapseSameFileDefs(ctx, autoloaderCfg, root);
         }
         {
             Timer timeit(logger, "autogenAutoloaderWrite");
-            autogen::AutoloadWriter::writeAutoloads(ctx, autoloaderCfg, opts.print.AutogenAutoloader.outputPath, root);
+            autogen::AutoloadWriter::writeAutoloads(ctx, workers, autoloaderCfg, opts.print.AutogenAutoloader.outputPath,
+                                                    root);
         }
     }
 
@@ -386,21 +503,64 @@ int realmain(int argc, char *argv[]) {
                          "or set SORBET_SILENCE_DEV_MESSAGE=1 in your shell environment.\n");
         }
     }
-    unique_ptr<WorkerPool> workers = WorkerPool::create(opts.threads, *logger);
+#ifndef SORBET_REALMAIN_MIN
+    if (!opts.runLSP && !opts.daemonSocket.empty()) {
+        // A daemon that is already up to date answers faster than typechecking from scratch could.
+        if (auto errorCount = lsp::printDaemonErrors(opts, logger, *typeErrorsConsole)) {
+            opts.flushPrinters();
+            return *errorCount > 0 ? 1 : 0;
+        }
+    }
+#endif
+    unique_ptr<WorkerPool> workers = WorkerPool::create(opts.threads, *logger, opts.pinThreads);
+    if (!opts.profileFiles.empty()) {
+        Timer::setRecordAllSpans(true);
+    }
+    Timer::setSpanArgsEnabled(!opts.webTraceFile.empty() || !opts.profileFiles.empty());
+    unique_ptr<web_tracer_framework::TraceStreamer> traceStreamer;
+    if (opts.webTraceStream) {
+        // StatsD, --metrics-file, --profile-files and --counters still need the spans at exit.
+        bool keepInCounters = !opts.statsdHost.empty() || !opts.metricsFile.empty() || !opts.profileFiles.empty() ||
+                              opts.enableCounters || !opts.someCounters.empty();
+        traceStreamer = make_unique<web_tracer_framework::TraceStreamer>(opts.webTraceFile, opts.webTraceSample,
+                                                                         keepInCounters);
+    }
 
     unique_ptr<core::GlobalState> gs =
         make_unique<core::GlobalState>((make_shared<core::ErrorQueue>(*typeErrorsConsole, *logger)));
     gs->pathPrefix = opts.pathPrefix;
     gs->errorUrlBase = opts.errorUrlBase;
+    if (opts.errorFormat == "proto") {
+        gs->errorQueue->errorRenderer = [](const core::GlobalState &gs, const core::Error &error) -> string {
+            return core::Proto::toDelimited(core::Proto::toProto(gs, error));
+        };
+        gs->errorQueue->renderedOutput = &cout;
+    }
     vector<ast::ParsedFile> indexed;
 
     logger->trace("building initial global state");
-    unique_ptr<KeyValueStore> kvstore;
-    if (!opts.cacheDir.empty()) {
-        kvstore = make_unique<KeyValueStore>(Version::full_version_string, opts.cacheDir,
-                                             opts.skipDSLPasses ? "nodsl" : "default");
+    auto openCache = [&opts]() -> unique_ptr<KeyValueStore> {
+        if (opts.cacheDir.empty()) {
+            return nullptr;
+        }
+        unique_ptr<RemoteCache> remote;
+        if (!opts.remoteCacheDir.empty()) {
+            remote = make_unique<DirectoryRemoteCache>(opts.remoteCacheDir);
+        }
+        // Cached trees use the names of the payload they were indexed with, which --rbi-bundle replaces.
+        auto version = absl::StrCat(Version::full_version_string, payload::rbiBundleVersion(opts));
+        return make_unique<KeyValueStore>(move(version), opts.cacheDir, opts.skipDSLPasses ? "nodsl" : "default",
+                                          (size_t)opts.maxCacheSizeMB * 1024 * 1024, move(remote));
+    };
+    unique_ptr<KeyValueStore> kvstore = openCache();
+    // Both already have the payload, and every file of the project indexed and resolved.
+    const bool fromResolved = !opts.loadResolved.empty();
+    const bool fromSnapshot = !fromResolved && pipeline::loadProjectSnapshot(gs, opts, kvstore);
+    if (fromResolved) {
+        indexed = pipeline::loadResolved(gs, opts);
+    } else if (!fromSnapshot) {
+        payload::createInitialGlobalState(gs, opts, kvstore);
     }
-    payload::createInitialGlobalState(gs, opts, kvstore);
     if (opts.silenceErrors) {
         gs->silenceErrors = true;
     }
@@ -416,6 +576,9 @@ int realmain(int argc, char *argv[]) {
     if (opts.censorForSnapshotTests) {
         gs->censorForSnapshotTests = true;
     }
+    if (opts.optimizeCFG) {
+        gs->optimizeCFG = true;
+    }
     if (opts.reserveMemKiB > 0) {
         gs->reserveMemory(opts.reserveMemKiB);
     }
@@ -430,6 +593,7 @@ int realmain(int argc, char *argv[]) {
         gs->addDslPlugin(plugin.first, plugin.second);
     }
     gs->dslRubyExtraArgs = opts.dslRubyExtraArgs;
+    gs->dslResidentPlugins = opts.dslResidentPlugins;
 
     logger->trace("done building initial global state");
 
@@ -442,9 +606,33 @@ int realmain(int argc, char *argv[]) {
                       "If you're developing an LSP extension to some editor, make sure to run sorbet with `-v` flag,"
                       "it will enable outputing the LSP session to stderr(`Write: ` and `Read: ` log lines)",
                       Version::full_version_string);
-        lsp::LSPLoop loop(move(gs), opts, logger, *workers, STDIN_FILENO, cout);
-        gs = loop.runLSP();
+        if (opts.rawInputDirNames.size() > 1) {
+            gs = lsp::runMultiRootLSP(move(gs), opts, logger, *workers, STDIN_FILENO, cout, move(kvstore));
+        } else {
+            lsp::LSPLoop loop(move(gs), opts, logger, *workers, STDIN_FILENO, cout, false, false, move(kvstore));
+            gs = loop.runLSP();
+        }
 #endif
+    } else if (opts.stdinStream) {
+        // The input files are resolved once; each document is then checked against a copy of that state.
+        auto inputFiles = pipeline::reserveFiles(gs, opts.inputFileNames);
+        indexed = pipeline::index(gs, inputFiles, opts, *workers, kvstore);
+        indexed = pipeline::resolve(gs, move(indexed), opts, *workers);
+        gs->errorQueue->flushErrors(true);
+        pipeline::typecheckDocumentStream(*gs, opts, cin, cout);
+    } else if (fromSnapshot || fromResolved) {
+        Timer timeall(logger, "wall_time");
+        if (fromSnapshot) {
+            indexed = pipeline::resolveInProjectSnapshot(gs, opts, kvstore);
+        }
+        indexed = pipeline::typecheck(gs, move(indexed), opts, *workers, kvstore);
+        if (kvstore != nullptr && !gs->hadCriticalError()) {
+            KeyValueStore::commit(move(kvstore));
+        }
+        gs->errorQueue->flushErrors(true);
+        if (!opts.noErrorCount) {
+            gs->errorQueue->flushErrorCount();
+        }
     } else {
         Timer timeall(logger, "wall_time");
         vector<core::FileRef> inputFiles;
@@ -469,6 +657,7 @@ int realmain(int argc, char *argv[]) {
         }
 
         { indexed = pipeline::index(gs, inputFiles, opts, *workers, kvstore); }
+        pipeline::reportMemoryUsage(*gs, "memory.index", kvstore.get());
 
         payload::retainGlobalState(gs, opts, kvstore);
 
@@ -481,7 +670,8 @@ int realmain(int argc, char *argv[]) {
 
             core::MutableContext ctx(*gs, core::Symbols::root());
 
-            indexed = pipeline::name(*gs, move(indexed), opts);
+            indexed = pipeline::name(*gs, move(indexed), opts, *workers);
+            pipeline::reportMemoryUsage(*gs, "memory.name", kvstore.get());
             autogen::AutoloaderConfig autoloaderCfg;
             {
                 core::UnfreezeNameTable nameTableAccess(*gs);
@@ -496,11 +686,36 @@ int realmain(int argc, char *argv[]) {
                 autoloaderCfg = autogen::AutoloaderConfig::enterConfig(*gs, opts.autoloaderConfig);
             }
 
-            runAutogen(ctx, opts, autoloaderCfg, *workers, indexed);
+            if (kvstore == nullptr) {
+                // As below: retainGlobalState committed the cache after indexing.
+                kvstore = openCache();
+            }
+            runAutogen(ctx, opts, autoloaderCfg, *workers, indexed, kvstore);
+            pipeline::reportMemoryUsage(*gs, "memory.autogen", kvstore.get());
+            if (kvstore != nullptr && !gs->hadCriticalError()) {
+                KeyValueStore::commit(move(kvstore));
+            }
 #endif
         } else {
-            indexed = pipeline::resolve(gs, move(indexed), opts, *workers);
-            indexed = pipeline::typecheck(gs, move(indexed), opts, *workers);
+            if (kvstore == nullptr) {
+                // retainGlobalState committed the cache after indexing, but resolving writes to it too.
+                kvstore = openCache();
+            }
+            indexed = pipeline::cachedResolve(gs, move(indexed), opts, *workers, kvstore);
+            pipeline::reportMemoryUsage(*gs, "memory.resolve", kvstore.get());
+            pipeline::storeProjectSnapshot(*gs, opts, kvstore);
+            if (!opts.storeResolved.empty()) {
+                // The runs with --load-resolved typecheck the files.
+                pipeline::storeResolved(*gs, indexed, opts.storeResolved);
+            } else if (opts.incremental) {
+                indexed = pipeline::incrementalTypecheck(gs, move(indexed), opts, *workers, kvstore);
+            } else {
+                indexed = pipeline::typecheck(gs, move(indexed), opts, *workers, kvstore);
+            }
+            pipeline::reportMemoryUsage(*gs, "memory.typecheck", kvstore.get());
+            if (kvstore != nullptr && !gs->hadCriticalError()) {
+                KeyValueStore::commit(move(kvstore));
+            }
         }
 
         if (opts.suggestTyped) {
@@ -532,13 +747,14 @@ int realmain(int argc, char *argv[]) {
             gs->errorQueue->flushErrorCount();
         }
         if (opts.autocorrect) {
-            gs->errorQueue->flushAutocorrects(*gs, *opts.fs);
+            gs->errorQueue->flushAutocorrects(*gs, *opts.fs, *workers);
         }
         logger->trace("sorbet done");
 
         if (!opts.storeState.empty()) {
             gs->markAsPayload();
-            FileOps::write(opts.storeState.c_str(), core::serialize::Serializer::store(*gs));
+            FileOps::write(opts.storeState.c_str(),
+                           core::serialize::Serializer::store(*gs, !opts.storeStateUncompressed));
         }
 
         auto untypedSources = getAndClearHistogram("untyped.sources");
@@ -560,6 +776,7 @@ int realmain(int argc, char *argv[]) {
     }
 
 #ifndef SORBET_REALMAIN_MIN
+    workers->reportUsage();
     addStandardMetrics();
 
     if (!opts.someCounters.empty()) {
@@ -576,6 +793,8 @@ int realmain(int argc, char *argv[]) {
         logger->debug("" + getCounterStatistics(Counters::ALL_COUNTERS));
     }
 
+    // Writes out the last spans before the counters follow them.
+    traceStreamer = nullptr;
     auto counters = getAndClearThreadCounters();
 
     if (!opts.statsdHost.empty()) {
@@ -586,7 +805,10 @@ int realmain(int argc, char *argv[]) {
         StatsD::submitCounters(counters, opts.statsdHost, opts.statsdPort, prefix + ".counters");
     }
     if (!opts.webTraceFile.empty()) {
-        web_tracer_framework::Tracing::storeTraces(counters, opts.webTraceFile);
+        web_tracer_framework::Tracing::storeTraces(counters, opts.webTraceFile, !opts.webTraceStream);
+    }
+    if (!opts.profileFiles.empty()) {
+        web_tracer_framework::Tracing::storeFileProfile(counters, opts.profileFiles);
     }
 
     if (!opts.metricsFile.empty()) {
@@ -2,7 +2,10 @@
 // has to go first as it violates our poisions
 
 #include "absl/strings/match.h"
+#include "absl/synchronization/mutex.h"
 #include "common/FileOps.h"
+#include "common/concurrency/WorkerPool.h"
+#include "common/crypto_hashing/crypto_hashing.h"
 #include "configatron.h"
 #include <cctype>
 #include <sys/types.h>
@@ -38,24 +41,59 @@ StringKind classifyString(string_view str) {
     }
 }
 
-core::TypePtr getType(core::GlobalState &gs, const YAML::Node &node) {
+// The type of a scalar, as far as it can be told without a GlobalState.
+enum class LeafKind : u1 { Nil, Boolean, Integer, Float, String, Symbol, Untyped };
+
+LeafKind getKind(const YAML::Node &node) {
     ENFORCE(node.IsScalar());
     string value = node.as<string>();
     if (value == "true" || value == "false") {
-        return core::Types::Boolean();
+        return LeafKind::Boolean;
     }
     switch (classifyString(value)) {
         case StringKind::Integer:
-            return core::Types::Integer();
+            return LeafKind::Integer;
         case StringKind::Float:
-            return core::Types::Float();
+            return LeafKind::Float;
         case StringKind::String:
-            return core::Types::String();
+            return LeafKind::String;
         case StringKind::Symbol:
+            return LeafKind::Symbol;
+    }
+}
+
+core::TypePtr getType(LeafKind kind) {
+    switch (kind) {
+        case LeafKind::Nil:
+            return core::Types::nilClass();
+        case LeafKind::Boolean:
+            return core::Types::Boolean();
+        case LeafKind::Integer:
+            return core::Types::Integer();
+        case LeafKind::Float:
+            return core::Types::Float();
+        case LeafKind::String:
+            return core::Types::String();
+        case LeafKind::Symbol:
             return core::Types::Symbol();
+        case LeafKind::Untyped:
+            return core::Types::untypedUntracked();
     }
 }
 
+// One step of walking a YAML file. A parsed file is the list of steps the walk took, so that parsing can happen on any
+// thread and only replaying the steps into the Path tree (which builds types) needs the GlobalState.
+struct ConfigStep {
+    enum class Kind : u1 { Enter, Leave, Scalar, Sequence };
+    Kind kind;
+    // The key entered, for Enter.
+    string selector;
+    // The value for Scalar, the kinds of the elements for Sequence.
+    vector<LeafKind> leaves;
+};
+
+using ParsedConfig = vector<ConfigStep>;
+
 struct Path {
     Path *parent;
     string selector;
@@ -130,39 +168,31 @@ struct Path {
     }
 };
 
-void recurse(core::GlobalState &gs, const YAML::Node &node, shared_ptr<Path> prefix) {
+void recurse(const YAML::Node &node, ParsedConfig &out) {
     switch (node.Type()) {
         case YAML::NodeType::Null:
-            prefix->setType(gs, core::Types::nilClass());
+            out.push_back(ConfigStep{ConfigStep::Kind::Scalar, "", {LeafKind::Nil}});
             break;
         case YAML::NodeType::Scalar:
-            prefix->setType(gs, getType(gs, node));
+            out.push_back(ConfigStep{ConfigStep::Kind::Scalar, "", {getKind(node)}});
             break;
         case YAML::NodeType::Sequence: {
-            core::TypePtr elemType;
+            ConfigStep step{ConfigStep::Kind::Sequence, "", {}};
             for (const auto &child : node) {
-                auto thisElemType = child.IsScalar() ? getType(gs, child) : core::Types::untypedUntracked();
-                if (elemType) {
-                    elemType =
-                        core::Types::any(core::MutableContext(gs, core::Symbols::root()), elemType, thisElemType);
-                } else {
-                    elemType = thisElemType;
-                }
+                step.leaves.push_back(child.IsScalar() ? getKind(child) : LeafKind::Untyped);
             }
-            if (!elemType) {
-                elemType = core::Types::bottom();
-            }
-            vector<core::TypePtr> elems{elemType};
-            prefix->setType(gs, core::make_type<core::AppliedType>(core::Symbols::Array(), elems));
+            out.push_back(move(step));
             break;
         }
         case YAML::NodeType::Map:
             for (const auto &child : node) {
                 auto key = child.first.as<string>();
                 if (key != "<<") {
-                    recurse(gs, child.second, prefix->getChild(key));
+                    out.push_back(ConfigStep{ConfigStep::Kind::Enter, move(key), {}});
+                    recurse(child.second, out);
+                    out.push_back(ConfigStep{ConfigStep::Kind::Leave, "", {}});
                 } else {
-                    recurse(gs, child.second, prefix);
+                    recurse(child.second, out);
                 }
             }
 
@@ -172,24 +202,83 @@ void recurse(core::GlobalState &gs, const YAML::Node &node, shared_ptr<Path> pre
     }
 }
 
-void handleFile(core::GlobalState &gs, const string &file, shared_ptr<Path> rootNode) {
-    YAML::Node config = YAML::LoadFile(file);
+ParsedConfig parseConfig(const string &contents) {
+    ParsedConfig result;
+    YAML::Node config = YAML::Load(contents);
     switch (config.Type()) {
         case YAML::NodeType::Map:
             for (const auto &child : config) {
-                auto key = child.first.as<string>();
-                recurse(gs, child.second, rootNode);
+                recurse(child.second, result);
             }
             break;
         default:
             break;
     }
+    return result;
+}
+
+void replay(core::GlobalState &gs, const ParsedConfig &config, shared_ptr<Path> rootNode) {
+    vector<shared_ptr<Path>> stack{move(rootNode)};
+    for (const auto &step : config) {
+        auto &prefix = stack.back();
+        switch (step.kind) {
+            case ConfigStep::Kind::Enter:
+                stack.push_back(prefix->getChild(step.selector));
+                break;
+            case ConfigStep::Kind::Leave:
+                stack.pop_back();
+                break;
+            case ConfigStep::Kind::Scalar:
+                prefix->setType(gs, getType(step.leaves.front()));
+                break;
+            case ConfigStep::Kind::Sequence: {
+                core::TypePtr elemType;
+                for (auto leaf : step.leaves) {
+                    auto thisElemType = getType(leaf);
+                    if (elemType) {
+                        elemType =
+                            core::Types::any(core::MutableContext(gs, core::Symbols::root()), elemType, thisElemType);
+                    } else {
+                        elemType = thisElemType;
+                    }
+                }
+                if (!elemType) {
+                    elemType = core::Types::bottom();
+                }
+                vector<core::TypePtr> elems{elemType};
+                prefix->setType(gs, core::make_type<core::AppliedType>(core::Symbols::Array(), elems));
+                break;
+            }
+        }
+    }
+}
+
+// Parsed files by the hash of their contents. LSP re-runs configatron on every slow path, and config files rarely
+// change between two of them.
+absl::Mutex parsedConfigsMutex;
+UnorderedMap<string, shared_ptr<const ParsedConfig>> parsedConfigs GUARDED_BY(parsedConfigsMutex);
+
+shared_ptr<const ParsedConfig> parseFile(const string &file) {
+    auto contents = FileOps::read(file);
+    auto hashBytes = crypto_hashing::hash64(contents);
+    string hash((const char *)hashBytes.data(), hashBytes.size());
+    {
+        absl::ReaderMutexLock lock(&parsedConfigsMutex);
+        auto it = parsedConfigs.find(hash);
+        if (it != parsedConfigs.end()) {
+            return it->second;
+        }
+    }
+    auto parsed = make_shared<const ParsedConfig>(parseConfig(contents));
+    absl::MutexLock lock(&parsedConfigsMutex);
+    return parsedConfigs.emplace(move(hash), move(parsed)).first->second;
 }
 } // namespace
 
-void configatron::fillInFromFileSystem(core::GlobalState &gs, const vector<string> &folders,
+void configatron::fillInFromFileSystem(core::GlobalState &gs, WorkerPool &workers, const vector<string> &folders,
                                        const vector<string> &files) {
-    auto rootNode = make_shared<Path>(nullptr, "");
+    // Every file to load, with the name it is nested under if it came from one of `folders`.
+    vector<pair<string, optional<string>>> toLoad;
     for (auto &folder : folders) {
         auto files = FileOps::listFilesInDir(folder, {".yaml"}, true, {}, {});
         const int prefixLen = folder.length() + 1;
@@ -198,12 +287,21 @@ void configatron::fillInFromFileSystem(core::GlobalState &gs, const vector<strin
             string_view fileName(file.c_str(), file.size() - extLen);
             // Trim off folder + '/'
             fileName = fileName.substr(prefixLen);
-            auto innerNode = rootNode->getChild(fileName);
-            handleFile(gs, file, innerNode);
+            toLoad.emplace_back(file, string(fileName));
         }
     }
     for (auto &file : files) {
-        handleFile(gs, file, rootNode);
+        toLoad.emplace_back(file, nullopt);
+    }
+
+    vector<shared_ptr<const ParsedConfig>> parsed(toLoad.size());
+    workers.parallelFor("configatron.parse", toLoad.size(),
+                        [&](size_t i) -> void { parsed[i] = parseFile(toLoad[i].first); });
+
+    auto rootNode = make_shared<Path>(nullptr, "");
+    for (size_t i = 0; i < toLoad.size(); i++) {
+        auto &nestedUnder = toLoad[i].second;
+        replay(gs, *parsed[i], nestedUnder ? rootNode->getChild(*nestedUnder) : rootNode);
     }
 
     core::SymbolRef configatron =
@@ -2,12 +2,16 @@
 #define SORBET_CONFIGATRON_H
 
 #include "core/core.h"
+namespace sorbet {
+class WorkerPool;
+}
 namespace sorbet::namer {
 
 class configatron {
 public:
-    static void fillInFromFileSystem(core::GlobalState &gs, const std::vector<std::string> &folders,
-                                     const std::vector<std::string> &files);
+    // Files are parsed in parallel on `workers`, and only merged into `gs` serially.
+    static void fillInFromFileSystem(core::GlobalState &gs, WorkerPool &workers,
+                                     const std::vector<std::string> &folders, const std::vector<std::string> &files);
 };
 } // namespace sorbet::namer
 
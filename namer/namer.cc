@@ -4,11 +4,15 @@
 #include "ast/ast.h"
 #include "ast/desugar/Desugar.h"
 #include "ast/treemap/treemap.h"
+#include "common/Timer.h"
+#include "common/concurrency/ConcurrentQueue.h"
 #include "common/typecase.h"
 #include "core/Context.h"
 #include "core/Names.h"
 #include "core/Symbols.h"
+#include "core/Unfreeze.h"
 #include "core/core.h"
+#include "core/errors/internal.h"
 #include "core/errors/namer.h"
 #include "flattener/flatten.h"
 
@@ -17,26 +21,287 @@ using namespace std;
 namespace sorbet::namer {
 
 /**
- * Used with TreeMap to insert all the class and method symbols into the symbol
- * table.
+ * Naming happens in three phases, so that the two tree walks can run in parallel:
+ *
+ *  - DefinitionFinder walks a tree without touching GlobalState and records every node that defines or modifies a
+ *    symbol, in the exact order that a single walk over the tree would visit them.
+ *  - SymbolDefiner replays those nodes against GlobalState. This is the only phase that mutates GlobalState, so it
+ *    runs serially, one file at a time, in the order files were given to us. That keeps symbol ids deterministic.
+ *  - TreeSymbolizer walks the tree again and rewrites it using the symbols SymbolDefiner picked, without touching
+ *    GlobalState.
  */
-class NameInserter {
-    friend class Namer;
+namespace {
+
+struct FoundDefinition {
+    enum class Kind : u1 {
+        ClassDef,
+        ClassDefExit,
+        MethodDef,
+        MethodDefExit,
+        // The default value of a method argument. Everything up to `skipTo` lives inside that default.
+        DefaultArg,
+        Visibility,
+        ModuleFunction,
+        GlobalField,
+        ConstantAssign,
+    };
 
-    core::SymbolRef squashNames(core::MutableContext ctx, core::SymbolRef owner, unique_ptr<ast::Expression> &node) {
-        auto constLit = ast::cast_tree<ast::UnresolvedConstantLit>(node.get());
+    Kind kind;
+    ast::Expression *node;
+    // For DefaultArg: index of the argument the default belongs to.
+    u4 argIndex = 0;
+    // For DefaultArg: index of the first definition past the end of the default value.
+    u4 skipTo = 0;
+};
+
+struct FoundDefinitions {
+    vector<FoundDefinition> defs;
+};
+
+enum class AssignKind : u1 {
+    // `A = ...`: lhs becomes a static field.
+    StaticField,
+    // type_member/type_template that should be dropped from the tree
+    TypeMemberRemoved,
+    // type_member/type_template that stays in the tree, as written
+    TypeMemberKept,
+    // type_member/type_template with `fixed:`, whose lhs is replaced with the type member itself
+    TypeMemberFixed,
+    // type_member/type_template that was turned into `T.type_alias(T.untyped)` because of an error
+    TypeMemberAlias,
+};
+
+struct AssignOutcome {
+    AssignKind kind;
+    core::SymbolRef symbol;
+};
+
+struct MethodOutcome {
+    core::SymbolRef symbol;
+    // For every argument: whether it was entered as a plain local, dropping any default value.
+    vector<bool> plainArgs;
+};
+
+struct DefinedSymbols {
+    // Keyed by ClassDef, UnresolvedConstantLit (in class names and constant scopes) and UnresolvedIdent (globals).
+    // An UnresolvedConstantLit in a scope without an entry is dropped from the tree.
+    UnorderedMap<const ast::Expression *, core::SymbolRef> symbols;
+    UnorderedMap<const ast::MethodDef *, MethodOutcome> methods;
+    UnorderedMap<const ast::Assign *, AssignOutcome> assigns;
+};
+
+struct ParsedArgShape {
+    core::Loc loc;
+    core::LocalVariable local;
+    bool keyword = false;
+    bool block = false;
+    bool repeated = false;
+    bool shadow = false;
+    bool hasDefault = false;
+};
+
+// Same as ast::ArgParsing::parseArg, but leaves the tree untouched.
+ParsedArgShape parseArgShape(const ast::Expression *arg) {
+    ParsedArgShape parsed;
+    typecase(
+        arg, [&](const ast::UnresolvedIdent *nm) { Exception::raise("Unexpected unresolved name in arg!"); },
+        [&](const ast::RestArg *rest) {
+            parsed = parseArgShape(rest->expr.get());
+            parsed.repeated = true;
+        },
+        [&](const ast::KeywordArg *kw) {
+            parsed = parseArgShape(kw->expr.get());
+            parsed.keyword = true;
+        },
+        [&](const ast::OptionalArg *opt) {
+            parsed = parseArgShape(opt->expr.get());
+            parsed.hasDefault = true;
+        },
+        [&](const ast::BlockArg *blk) {
+            parsed = parseArgShape(blk->expr.get());
+            parsed.block = true;
+        },
+        [&](const ast::ShadowArg *shadow) {
+            parsed = parseArgShape(shadow->expr.get());
+            parsed.shadow = true;
+        },
+        [&](const ast::Local *local) {
+            parsed.local = local->localVariable;
+            parsed.loc = local->loc;
+        });
+    return parsed;
+}
+
+vector<ParsedArgShape> parseArgShapes(const ast::MethodDef::ARGS_store &args) {
+    vector<ParsedArgShape> parsed;
+    for (auto &arg : args) {
+        if (!ast::isa_tree<ast::Reference>(arg.get())) {
+            Exception::raise("Must be a reference!");
+        }
+        parsed.emplace_back(parseArgShape(arg.get()));
+    }
+    return parsed;
+}
+
+bool isVisibilityModifier(core::NameRef fun) {
+    switch (fun._id) {
+        case core::Names::private_()._id:
+        case core::Names::privateClassMethod()._id:
+        case core::Names::protected_()._id:
+        case core::Names::public_()._id:
+        case core::Names::moduleFunction()._id:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// TreeSymbolizer turns `private def foo` into the method def itself. Sees through those sends to find the method
+// def that a visibility modifier will apply to.
+ast::MethodDef *modifiedMethodDef(ast::Expression *expr) {
+    if (auto *mdef = ast::cast_tree<ast::MethodDef>(expr)) {
+        return mdef;
+    }
+    auto *send = ast::cast_tree<ast::Send>(expr);
+    if (send != nullptr && send->args.size() == 1 && isVisibilityModifier(send->fun)) {
+        return modifiedMethodDef(send->args[0].get());
+    }
+    return nullptr;
+}
+
+bool isValidAncestor(ast::Expression *exp) {
+    if (ast::isa_tree<ast::EmptyTree>(exp) || exp->isSelfReference() || ast::isa_tree<ast::ConstantLit>(exp)) {
+        return true;
+    }
+    if (auto lit = ast::cast_tree<ast::UnresolvedConstantLit>(exp)) {
+        return isValidAncestor(lit->scope.get());
+    }
+    return false;
+}
+
+/**
+ * Collects the nodes of a tree that define symbols. Does not change the tree or GlobalState, so it can run on many
+ * trees at once.
+ */
+class DefinitionFinder {
+    FoundDefinitions &found;
+    // Default values of the arguments of the methods we're currently inside of. Those have already been visited, so
+    // they're moved out of the way while TreeMap walks the rest of the method.
+    vector<vector<unique_ptr<ast::Expression>>> stashedDefaults;
+
+    void add(FoundDefinition::Kind kind, ast::Expression *node) {
+        found.defs.emplace_back(FoundDefinition{kind, node});
+    }
+
+public:
+    DefinitionFinder(FoundDefinitions &found) : found(found) {}
+
+    unique_ptr<ast::ClassDef> preTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> klass) {
+        add(FoundDefinition::Kind::ClassDef, klass.get());
+        return klass;
+    }
+
+    unique_ptr<ast::Expression> postTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> klass) {
+        add(FoundDefinition::Kind::ClassDefExit, klass.get());
+        return klass;
+    }
+
+    unique_ptr<ast::MethodDef> preTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> method) {
+        add(FoundDefinition::Kind::MethodDef, method.get());
+
+        // Depending on what's already in GlobalState, SymbolDefiner might drop some default values from the tree.
+        // Walk each of them here, so that their definitions can be skipped as a unit.
+        auto &stash = stashedDefaults.emplace_back();
+        u4 i = 0;
+        for (auto &arg : method->args) {
+            if (auto *optArg = ast::cast_tree<ast::OptionalArg>(arg.get())) {
+                auto defaultIdx = found.defs.size();
+                found.defs.emplace_back(FoundDefinition{FoundDefinition::Kind::DefaultArg, method.get(), i});
+                optArg->default_ = ast::TreeMap::apply(ctx.withOwner(method->symbol), *this, move(optArg->default_));
+                found.defs[defaultIdx].skipTo = found.defs.size();
+                stash.emplace_back(move(optArg->default_));
+            } else {
+                stash.emplace_back(nullptr);
+            }
+            i++;
+        }
+        return method;
+    }
+
+    unique_ptr<ast::Expression> postTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> method) {
+        auto &stash = stashedDefaults.back();
+        ENFORCE(stash.size() == method->args.size());
+        for (int i = 0; i < stash.size(); i++) {
+            if (auto *optArg = ast::cast_tree<ast::OptionalArg>(method->args[i].get())) {
+                optArg->default_ = move(stash[i]);
+            }
+        }
+        stashedDefaults.pop_back();
+        add(FoundDefinition::Kind::MethodDefExit, method.get());
+        return method;
+    }
+
+    unique_ptr<ast::Expression> postTransformSend(core::Context ctx, unique_ptr<ast::Send> send) {
+        if (send->args.size() == 1 && modifiedMethodDef(send->args[0].get()) != nullptr) {
+            if (isVisibilityModifier(send->fun)) {
+                add(FoundDefinition::Kind::Visibility, send.get());
+            }
+            return send;
+        }
+        if (send->recv->isSelfReference() && send->fun == core::Names::moduleFunction()) {
+            add(FoundDefinition::Kind::ModuleFunction, send.get());
+        }
+        return send;
+    }
+
+    unique_ptr<ast::Expression> postTransformUnresolvedIdent(core::Context ctx, unique_ptr<ast::UnresolvedIdent> nm) {
+        if (nm->kind == ast::UnresolvedIdent::Global) {
+            add(FoundDefinition::Kind::GlobalField, nm.get());
+        }
+        return nm;
+    }
+
+    unique_ptr<ast::Expression> postTransformAssign(core::Context ctx, unique_ptr<ast::Assign> asgn) {
+        if (ast::isa_tree<ast::UnresolvedConstantLit>(asgn->lhs.get())) {
+            add(FoundDefinition::Kind::ConstantAssign, asgn.get());
+        }
+        return asgn;
+    }
+};
+
+/**
+ * Enters the definitions collected by DefinitionFinder into GlobalState. Must run serially.
+ */
+class SymbolDefiner {
+    DefinedSymbols &defined;
+
+    struct LocalFrame {
+        bool moduleFunctionActive = false;
+    };
+
+    vector<LocalFrame> scopeStack;
+    vector<core::SymbolRef> ownerStack;
+    // Number of arguments of each method we're currently inside of, used to sanity check the symbol we made for it.
+    vector<int> argCountStack;
+
+    core::MutableContext currentCtx(core::MutableContext ctx) {
+        return ctx.withOwner(ownerStack.back());
+    }
+
+    core::SymbolRef squashNames(core::MutableContext ctx, core::SymbolRef owner, const ast::Expression *node) {
+        auto constLit = ast::cast_tree_const<ast::UnresolvedConstantLit>(node);
         if (constLit == nullptr) {
-            if (auto *id = ast::cast_tree<ast::ConstantLit>(node.get())) {
+            if (auto *id = ast::cast_tree_const<ast::ConstantLit>(node)) {
                 return id->symbol.data(ctx)->dealias(ctx);
             }
-            if (auto *uid = ast::cast_tree<ast::UnresolvedIdent>(node.get())) {
+            if (auto *uid = ast::cast_tree_const<ast::UnresolvedIdent>(node)) {
                 if (uid->kind != ast::UnresolvedIdent::Class || uid->name != core::Names::singleton()) {
                     if (auto e = ctx.state.beginError(node->loc, core::errors::Namer::DynamicConstant)) {
                         e.setHeader("Unsupported constant scope");
                     }
                 }
                 // emitted via `class << self` blocks
-            } else if (ast::isa_tree<ast::EmptyTree>(node.get())) {
+            } else if (ast::isa_tree<ast::EmptyTree>(node)) {
                 // ::Foo
             } else if (node->isSelfReference()) {
                 // self::Foo
@@ -45,11 +310,10 @@ class NameInserter {
                     e.setHeader("Dynamic constant references are unsupported");
                 }
             }
-            node = ast::MK::EmptyTree();
             return owner;
         }
 
-        auto newOwner = squashNames(ctx, owner, constLit->scope);
+        auto newOwner = squashNames(ctx, owner, constLit->scope.get());
         core::SymbolRef existing = newOwner.data(ctx)->findMember(ctx, constLit->cnst);
         if (!existing.exists()) {
             if (!newOwner.data(ctx)->isClass()) {
@@ -60,25 +324,31 @@ class NameInserter {
                                 newOwnerName, newOwnerName);
                     e.addErrorLine(newOwner.data(ctx)->loc(), "`{}` defined here", newOwnerName);
                 }
-                node = ast::MK::EmptyTree();
                 return owner;
             }
             existing = ctx.state.enterClassSymbol(constLit->loc, newOwner, constLit->cnst);
             existing.data(ctx)->singletonClass(ctx); // force singleton class into existance
         }
 
-        node.release();
-        unique_ptr<ast::UnresolvedConstantLit> constTmp(constLit);
-        node = make_unique<ast::ConstantLit>(constLit->loc, existing, std::move(constTmp));
+        defined.symbols[constLit] = existing;
         return existing;
     }
 
-    unique_ptr<ast::Expression> arg2Symbol(core::MutableContext ctx, int pos, ast::ParsedArg parsedArg) {
+    // The loc `node` will have once TreeSymbolizer squashed it.
+    core::Loc squashedLoc(const ast::Expression *node) {
+        if (ast::isa_tree<ast::ConstantLit>(node) ||
+            (ast::isa_tree<ast::UnresolvedConstantLit>(node) && defined.symbols.contains(node))) {
+            return node->loc;
+        }
+        return core::Loc::none();
+    }
+
+    void arg2Symbol(core::MutableContext ctx, int pos, const ParsedArgShape &parsedArg, vector<bool> &plainArgs) {
         if (pos < ctx.owner.data(ctx)->arguments().size()) {
             // TODO: check that flags match;
-            auto localExpr = make_unique<ast::Local>(parsedArg.loc, parsedArg.local);
             ctx.owner.data(ctx)->arguments()[pos].loc = parsedArg.loc;
-            return move(localExpr);
+            plainArgs[pos] = true;
+            return;
         }
 
         core::NameRef name;
@@ -100,17 +370,17 @@ class NameInserter {
             auto argCopy = argInfo.deepCopy();
             argCopy.name = ctx.state.freshNameUnique(core::UniqueNameKind::MangledKeywordArg, argInfo.name, pos + 1);
             ctx.owner.dataAllowingNone(ctx)->arguments().emplace_back(move(argCopy));
-            auto localExpr = make_unique<ast::Local>(parsedArg.loc, parsedArg.local);
-            return move(localExpr);
+            plainArgs[pos] = true;
+            return;
         }
         // at this point, we should have at least pos + 1 arguments, and arguments[pos] should be the thing we got back
         // from enterMethodArgumentSymbol
         ENFORCE(ctx.owner.data(ctx)->arguments().size() >= pos + 1);
-        unique_ptr<ast::Reference> localExpr = make_unique<ast::Local>(parsedArg.loc, parsedArg.local);
 
-        if (parsedArg.default_) {
+        if (parsedArg.hasDefault) {
             argInfo.flags.isDefault = true;
-            localExpr = make_unique<ast::OptionalArg>(parsedArg.loc, move(localExpr), move(parsedArg.default_));
+        } else {
+            plainArgs[pos] = true;
         }
 
         if (parsedArg.keyword) {
@@ -122,262 +392,10 @@ class NameInserter {
         if (parsedArg.repeated) {
             argInfo.flags.isRepeated = true;
         }
-
-        return move(localExpr);
-    }
-
-    struct LocalFrame {
-        bool moduleFunctionActive = false;
-    };
-
-    LocalFrame &enterScope() {
-        auto &frame = scopeStack.emplace_back();
-        return frame;
-    }
-
-    void exitScope() {
-        scopeStack.pop_back();
-    }
-
-    vector<LocalFrame> scopeStack;
-
-    bool addAncestor(core::MutableContext ctx, unique_ptr<ast::ClassDef> &klass, unique_ptr<ast::Expression> &node) {
-        auto send = ast::cast_tree<ast::Send>(node.get());
-        if (send == nullptr) {
-            ENFORCE(node.get() != nullptr);
-            return false;
-        }
-
-        ast::ClassDef::ANCESTORS_store *dest;
-        if (send->fun == core::Names::include()) {
-            dest = &klass->ancestors;
-        } else if (send->fun == core::Names::extend()) {
-            dest = &klass->singletonAncestors;
-        } else {
-            return false;
-        }
-        if (!send->recv->isSelfReference()) {
-            // ignore `something.include`
-            return false;
-        }
-
-        if (send->args.empty()) {
-            if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::IncludeMutipleParam)) {
-                e.setHeader("`{}` requires at least one argument", send->fun.data(ctx)->show(ctx));
-            }
-            return false;
-        }
-
-        if (send->block != nullptr) {
-            if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::IncludePassedBlock)) {
-                e.setHeader("`{}` can not be passed a block", send->fun.data(ctx)->show(ctx));
-            }
-            return false;
-        }
-
-        for (auto it = send->args.rbegin(); it != send->args.rend(); it++) {
-            // Reverse order is intentional: that's how Ruby does it.
-            auto &arg = *it;
-            if (ast::isa_tree<ast::EmptyTree>(arg.get())) {
-                continue;
-            }
-            if (arg->isSelfReference()) {
-                dest->emplace_back(std::move(arg));
-                continue;
-            }
-            if (isValidAncestor(arg.get())) {
-                dest->emplace_back(std::move(arg));
-            } else {
-                if (auto e = ctx.state.beginError(arg->loc, core::errors::Namer::AncestorNotConstant)) {
-                    e.setHeader("`{}` must only contain constant literals", send->fun.data(ctx)->show(ctx));
-                }
-                arg = ast::MK::EmptyTree();
-            }
-        }
-
-        return true;
-    }
-
-    void aliasMethod(core::MutableContext ctx, core::Loc loc, core::SymbolRef owner, core::NameRef newName,
-                     core::SymbolRef method) {
-        core::SymbolRef alias = ctx.state.enterMethodSymbol(loc, owner, newName);
-        alias.data(ctx)->resultType = core::make_type<core::AliasType>(method);
-    }
-
-    void aliasModuleFunction(core::MutableContext ctx, core::Loc loc, core::SymbolRef method) {
-        core::SymbolRef owner = method.data(ctx)->owner;
-        aliasMethod(ctx, loc, owner.data(ctx)->singletonClass(ctx), method.data(ctx)->name, method);
-    }
-
-    core::SymbolRef methodOwner(core::MutableContext ctx) {
-        core::SymbolRef owner = ctx.owner.data(ctx)->enclosingClass(ctx);
-        if (owner == core::Symbols::root()) {
-            // Root methods end up going on object
-            owner = core::Symbols::Object();
-        }
-        return owner;
-    }
-    bool isValidAncestor(ast::Expression *exp) {
-        if (ast::isa_tree<ast::EmptyTree>(exp) || exp->isSelfReference() || ast::isa_tree<ast::ConstantLit>(exp)) {
-            return true;
-        }
-        if (auto lit = ast::cast_tree<ast::UnresolvedConstantLit>(exp)) {
-            return isValidAncestor(lit->scope.get());
-        }
-        return false;
-    }
-
-public:
-    unique_ptr<ast::ClassDef> preTransformClassDef(core::MutableContext ctx, unique_ptr<ast::ClassDef> klass) {
-        auto *ident = ast::cast_tree<ast::UnresolvedIdent>(klass->name.get());
-
-        if ((ident != nullptr) && ident->name == core::Names::singleton()) {
-            ENFORCE(ident->kind == ast::UnresolvedIdent::Class);
-            klass->symbol = ctx.owner.data(ctx)->enclosingClass(ctx).data(ctx)->singletonClass(ctx);
-        } else {
-            if (klass->symbol == core::Symbols::todo()) {
-                klass->symbol = squashNames(ctx, ctx.owner.data(ctx)->enclosingClass(ctx), klass->name);
-            } else {
-                // Desugar populates a top-level root() ClassDef.
-                // Nothing else should have been typeAlias by now.
-                ENFORCE(klass->symbol == core::Symbols::root());
-            }
-            bool isModule = klass->kind == ast::ClassDefKind::Module;
-            if (!klass->symbol.data(ctx)->isClass()) {
-                if (auto e = ctx.state.beginError(klass->loc, core::errors::Namer::ModuleKindRedefinition)) {
-                    e.setHeader("Redefining constant `{}`", klass->symbol.data(ctx)->show(ctx));
-                    e.addErrorLine(klass->symbol.data(ctx)->loc(), "Previous definition");
-                }
-                auto origName = klass->symbol.data(ctx)->name;
-                ctx.state.mangleRenameSymbol(klass->symbol, klass->symbol.data(ctx)->name);
-                klass->symbol = ctx.state.enterClassSymbol(klass->declLoc, klass->symbol.data(ctx)->owner, origName);
-                klass->symbol.data(ctx)->setIsModule(isModule);
-
-                auto oldSymCount = ctx.state.symbolsUsed();
-                auto newSingleton =
-                    klass->symbol.data(ctx)->singletonClass(ctx); // force singleton class into existence
-                ENFORCE(newSingleton._id >= oldSymCount,
-                        "should be a fresh symbol. Otherwise we could be reusing an existing singletonClass");
-            } else if (klass->symbol.data(ctx)->isClassModuleSet() &&
-                       isModule != klass->symbol.data(ctx)->isClassModule()) {
-                if (auto e = ctx.state.beginError(klass->loc, core::errors::Namer::ModuleKindRedefinition)) {
-                    e.setHeader("`{}` was previously defined as a `{}`", klass->symbol.data(ctx)->show(ctx),
-                                klass->symbol.data(ctx)->isClassModule() ? "module" : "class");
-                }
-            } else {
-                klass->symbol.data(ctx)->setIsModule(isModule);
-            }
-        }
-        enterScope();
-        return klass;
-    }
-
-    bool handleNamerDSL(core::MutableContext ctx, unique_ptr<ast::ClassDef> &klass, unique_ptr<ast::Expression> &line) {
-        if (addAncestor(ctx, klass, line)) {
-            return true;
-        }
-
-        auto *send = ast::cast_tree<ast::Send>(line.get());
-        if (send == nullptr) {
-            return false;
-        }
-        if (send->fun == core::Names::declareFinal()) {
-            klass->symbol.data(ctx)->setClassFinal();
-            klass->symbol.data(ctx)->singletonClass(ctx).data(ctx)->setClassFinal();
-        }
-        if (send->fun == core::Names::declareInterface() || send->fun == core::Names::declareAbstract()) {
-            klass->symbol.data(ctx)->setClassAbstract();
-            klass->symbol.data(ctx)->singletonClass(ctx).data(ctx)->setClassAbstract();
-        }
-        if (send->fun == core::Names::declareInterface()) {
-            klass->symbol.data(ctx)->setClassInterface();
-            if (klass->kind == ast::Class) {
-                if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::InterfaceClass)) {
-                    e.setHeader("Classes can't be interfaces. Use `abstract!` instead of `interface!`");
-                }
-            }
-        }
-
-        // explicitly keep the namer dsl functions present
-        return false;
-    }
-
-    // This decides if we need to keep a node around incase the current LSP query needs type information for it
-    bool shouldLeaveAncestorForIDE(const unique_ptr<ast::Expression> &anc) {
-        // used in Desugar <-> resolver to signal classes that did not have explicit superclass
-        if (ast::isa_tree<ast::EmptyTree>(anc.get()) || anc->isSelfReference()) {
-            return false;
-        }
-        auto rcl = ast::cast_tree<ast::ConstantLit>(anc.get());
-        if (rcl && rcl->symbol == core::Symbols::todo()) {
-            return false;
-        }
-        return true;
-    }
-
-    unique_ptr<ast::Expression> postTransformClassDef(core::MutableContext ctx, unique_ptr<ast::ClassDef> klass) {
-        exitScope();
-        if (klass->kind == ast::Class && !klass->symbol.data(ctx)->superClass().exists() &&
-            klass->symbol != core::Symbols::BasicObject()) {
-            klass->symbol.data(ctx)->setSuperClass(core::Symbols::todo());
-        }
-
-        // In Ruby 2.5 they changed this class to have a different superclass
-        // from 2.4. Since we don't have a good story around versioned ruby rbis
-        // yet, lets just force the superclass regardless of version.
-        if (klass->symbol == core::Symbols::Net_IMAP()) {
-            klass->symbol.data(ctx)->setSuperClass(core::Symbols::Net_Protocol());
-        }
-
-        klass->symbol.data(ctx)->addLoc(ctx, klass->declLoc);
-        klass->symbol.data(ctx)->singletonClass(ctx); // force singleton class into existence
-
-        auto toRemove = remove_if(klass->rhs.begin(), klass->rhs.end(),
-                                  [&](unique_ptr<ast::Expression> &line) { return handleNamerDSL(ctx, klass, line); });
-        klass->rhs.erase(toRemove, klass->rhs.end());
-
-        if (!klass->ancestors.empty()) {
-            /* Superclass is typeAlias in parent scope, mixins are typeAlias in inner scope */
-            for (auto &anc : klass->ancestors) {
-                if (!isValidAncestor(anc.get())) {
-                    if (auto e = ctx.state.beginError(anc->loc, core::errors::Namer::AncestorNotConstant)) {
-                        e.setHeader("Superclasses must only contain constant literals");
-                    }
-                    anc = ast::MK::EmptyTree();
-                } else if (shouldLeaveAncestorForIDE(anc) &&
-                           (klass->kind == ast::Module || anc != klass->ancestors.front())) {
-                    klass->rhs.emplace_back(ast::MK::KeepForIDE(anc->deepCopy()));
-                }
-            }
-        }
-        if (!klass->singletonAncestors.empty()) {
-            for (auto &sanc : klass->singletonAncestors) {
-                if (shouldLeaveAncestorForIDE(sanc)) {
-                    klass->rhs.emplace_back(ast::MK::KeepForIDE(sanc->deepCopy()));
-                }
-            }
-        }
-        ast::InsSeq::STATS_store ideSeqs;
-        if (ast::isa_tree<ast::ConstantLit>(klass->name.get())) {
-            ideSeqs.emplace_back(ast::MK::KeepForIDE(klass->name->deepCopy()));
-        }
-        if (klass->kind == ast::Class && !klass->ancestors.empty() &&
-            shouldLeaveAncestorForIDE(klass->ancestors.front())) {
-            ideSeqs.emplace_back(ast::MK::KeepForIDE(klass->ancestors.front()->deepCopy()));
-        }
-
-        // make sure we've added a static init symbol so we have it ready for the flatten pass later
-        if (klass->symbol == core::Symbols::root()) {
-            ctx.state.staticInitForFile(klass->loc);
-        } else {
-            ctx.state.staticInitForClass(klass->symbol, klass->loc);
-        }
-
-        return ast::MK::InsSeq(klass->declLoc, std::move(ideSeqs), std::move(klass));
     }
 
-    ast::MethodDef::ARGS_store fillInArgs(core::MutableContext ctx, vector<ast::ParsedArg> parsedArgs) {
-        ast::MethodDef::ARGS_store args;
+    vector<bool> fillInArgs(core::MutableContext ctx, const vector<ParsedArgShape> &parsedArgs) {
+        vector<bool> plainArgs(parsedArgs.size(), true);
         bool inShadows = false;
         bool intrinsic = isIntrinsic(ctx, ctx.owner);
         bool swapArgs = intrinsic && (ctx.owner.data(ctx)->arguments().size() == 1);
@@ -393,12 +411,8 @@ public:
         int i = -1;
         for (auto &arg : parsedArgs) {
             i++;
-            auto localVariable = arg.local;
-
             if (arg.shadow) {
                 inShadows = true;
-                auto localExpr = make_unique<ast::Local>(arg.loc, localVariable);
-                args.emplace_back(move(localExpr));
             } else {
                 ENFORCE(!inShadows, "shadow argument followed by non-shadow argument!");
 
@@ -407,80 +421,42 @@ public:
                     ctx.owner.data(ctx)->arguments().emplace_back(move(swappedArg));
                 }
 
-                auto expr = arg2Symbol(ctx, i, move(arg));
-                args.emplace_back(move(expr));
+                arg2Symbol(ctx, i, arg, plainArgs);
                 ENFORCE(i < ctx.owner.data(ctx)->arguments().size());
             }
         }
 
-        return args;
+        return plainArgs;
     }
 
-    unique_ptr<ast::Expression> postTransformSend(core::MutableContext ctx, unique_ptr<ast::Send> original) {
-        ast::MethodDef *mdef;
-        if (original->args.size() == 1 && (mdef = ast::cast_tree<ast::MethodDef>(original->args[0].get())) != nullptr) {
-            switch (original->fun._id) {
-                case core::Names::private_()._id:
-                case core::Names::privateClassMethod()._id:
-                    mdef->symbol.data(ctx)->setPrivate();
-                    break;
-                case core::Names::protected_()._id:
-                    mdef->symbol.data(ctx)->setProtected();
-                    break;
-                case core::Names::public_()._id:
-                    mdef->symbol.data(ctx)->setPublic();
-                    break;
-                case core::Names::moduleFunction()._id:
-                    aliasModuleFunction(ctx, original->loc, mdef->symbol);
-                    break;
-                default:
-                    return original;
-            }
-            return std::move(original->args[0]);
-        }
-        if (original->recv->isSelfReference()) {
-            switch (original->fun._id) {
-                case core::Names::moduleFunction()._id: {
-                    if (original->args.empty()) {
-                        scopeStack.back().moduleFunctionActive = true;
-                        break;
-                    }
-                    for (auto &arg : original->args) {
-                        auto lit = ast::cast_tree<ast::Literal>(arg.get());
-                        if (lit == nullptr || !lit->isSymbol(ctx)) {
-                            if (auto e = ctx.state.beginError(arg->loc, core::errors::Namer::DynamicDSLInvocation)) {
-                                e.setHeader("Unsupported argument to `{}`: arguments must be symbol literals",
-                                            original->fun.show(ctx));
-                            }
-                            continue;
-                        }
-                        core::NameRef name = lit->asSymbol(ctx);
-
-                        core::SymbolRef meth = methodOwner(ctx).data(ctx)->findMember(ctx, name);
-                        if (!meth.exists()) {
-                            if (auto e = ctx.state.beginError(arg->loc, core::errors::Namer::MethodNotFound)) {
-                                e.setHeader("`{}`: no such method: `{}`", original->fun.show(ctx), name.show(ctx));
-                            }
-                            continue;
-                        }
-                        aliasModuleFunction(ctx, original->loc, meth);
-                    }
-                    break;
-                }
-            }
-        }
+    void aliasMethod(core::MutableContext ctx, core::Loc loc, core::SymbolRef owner, core::NameRef newName,
+                     core::SymbolRef method) {
+        core::SymbolRef alias = ctx.state.enterMethodSymbol(loc, owner, newName);
+        alias.data(ctx)->resultType = core::make_type<core::AliasType>(method);
+    }
 
-        return original;
+    void aliasModuleFunction(core::MutableContext ctx, core::Loc loc, core::SymbolRef method) {
+        core::SymbolRef owner = method.data(ctx)->owner;
+        aliasMethod(ctx, loc, owner.data(ctx)->singletonClass(ctx), method.data(ctx)->name, method);
+    }
+
+    core::SymbolRef methodOwner(core::MutableContext ctx) {
+        core::SymbolRef owner = ctx.owner.data(ctx)->enclosingClass(ctx);
+        if (owner == core::Symbols::root()) {
+            // Root methods end up going on object
+            owner = core::Symbols::Object();
+        }
+        return owner;
     }
 
     // Allow stub symbols created to hold intrinsics to be filled in
     // with real types from code
     bool isIntrinsic(core::Context ctx, core::SymbolRef sym) {
         auto data = sym.data(ctx);
-        return data->intrinsic != nullptr && data->resultType == nullptr;
+        return data->hasIntrinsic() && data->resultType == nullptr;
     }
 
-    bool paramsMatch(core::MutableContext ctx, core::Loc loc, const vector<ast::ParsedArg> &parsedArgs) {
+    bool paramsMatch(core::MutableContext ctx, core::Loc loc, const vector<ParsedArgShape> &parsedArgs) {
         auto sym = ctx.owner.data(ctx)->dealias(ctx);
         if (sym.data(ctx)->arguments().size() != parsedArgs.size()) {
             if (auto e = ctx.state.beginError(loc, core::errors::Namer::RedefinitionOfMethod)) {
@@ -546,8 +522,127 @@ public:
         return true;
     }
 
-    unique_ptr<ast::MethodDef> preTransformMethodDef(core::MutableContext ctx, unique_ptr<ast::MethodDef> method) {
-        enterScope();
+    // Returns the SymbolRef corresponding to the class `self.class`, unless the
+    // context is a class, in which case return it.
+    core::SymbolRef contextClass(core::GlobalState &gs, core::SymbolRef ofWhat) const {
+        core::SymbolRef owner = ofWhat;
+        while (true) {
+            ENFORCE(owner.exists(), "non-existing owner in contextClass");
+            const auto &data = owner.data(gs);
+
+            if (data->isClass()) {
+                break;
+            }
+            if (data->name == core::Names::staticInit()) {
+                owner = data->owner.data(gs)->attachedClass(gs);
+            } else {
+                owner = data->owner;
+            }
+        }
+        return owner;
+    }
+
+    void defineClass(core::MutableContext ctx, const ast::ClassDef *klass) {
+        core::SymbolRef sym;
+        auto *ident = ast::cast_tree_const<ast::UnresolvedIdent>(klass->name.get());
+
+        if ((ident != nullptr) && ident->name == core::Names::singleton()) {
+            ENFORCE(ident->kind == ast::UnresolvedIdent::Class);
+            sym = ctx.owner.data(ctx)->enclosingClass(ctx).data(ctx)->singletonClass(ctx);
+        } else {
+            if (klass->symbol == core::Symbols::todo()) {
+                sym = squashNames(ctx, ctx.owner.data(ctx)->enclosingClass(ctx), klass->name.get());
+            } else {
+                // Desugar populates a top-level root() ClassDef.
+                // Nothing else should have been typeAlias by now.
+                ENFORCE(klass->symbol == core::Symbols::root());
+                sym = klass->symbol;
+            }
+            bool isModule = klass->kind == ast::ClassDefKind::Module;
+            if (!sym.data(ctx)->isClass()) {
+                if (auto e = ctx.state.beginError(klass->loc, core::errors::Namer::ModuleKindRedefinition)) {
+                    e.setHeader("Redefining constant `{}`", sym.data(ctx)->show(ctx));
+                    e.addErrorLine(sym.data(ctx)->loc(), "Previous definition");
+                }
+                auto origName = sym.data(ctx)->name;
+                ctx.state.mangleRenameSymbol(sym, sym.data(ctx)->name);
+                sym = ctx.state.enterClassSymbol(klass->declLoc, sym.data(ctx)->owner, origName);
+                sym.data(ctx)->setIsModule(isModule);
+
+                auto oldSymCount = ctx.state.symbolsUsed();
+                auto newSingleton = sym.data(ctx)->singletonClass(ctx); // force singleton class into existence
+                ENFORCE(newSingleton._id >= oldSymCount,
+                        "should be a fresh symbol. Otherwise we could be reusing an existing singletonClass");
+            } else if (sym.data(ctx)->isClassModuleSet() && isModule != sym.data(ctx)->isClassModule()) {
+                if (auto e = ctx.state.beginError(klass->loc, core::errors::Namer::ModuleKindRedefinition)) {
+                    e.setHeader("`{}` was previously defined as a `{}`", sym.data(ctx)->show(ctx),
+                                sym.data(ctx)->isClassModule() ? "module" : "class");
+                }
+            } else {
+                sym.data(ctx)->setIsModule(isModule);
+            }
+        }
+        defined.symbols[klass] = sym;
+        scopeStack.emplace_back();
+        ownerStack.emplace_back(sym);
+    }
+
+    void defineNamerDSL(core::MutableContext ctx, const ast::ClassDef *klass, core::SymbolRef sym) {
+        for (auto &line : klass->rhs) {
+            auto *send = ast::cast_tree_const<ast::Send>(line.get());
+            if (send == nullptr) {
+                continue;
+            }
+            if (send->fun == core::Names::declareFinal()) {
+                sym.data(ctx)->setClassFinal();
+                sym.data(ctx)->singletonClass(ctx).data(ctx)->setClassFinal();
+            }
+            if (send->fun == core::Names::declareInterface() || send->fun == core::Names::declareAbstract()) {
+                sym.data(ctx)->setClassAbstract();
+                sym.data(ctx)->singletonClass(ctx).data(ctx)->setClassAbstract();
+            }
+            if (send->fun == core::Names::declareInterface()) {
+                sym.data(ctx)->setClassInterface();
+                if (klass->kind == ast::Class) {
+                    if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::InterfaceClass)) {
+                        e.setHeader("Classes can't be interfaces. Use `abstract!` instead of `interface!`");
+                    }
+                }
+            }
+        }
+    }
+
+    void defineClassExit(core::MutableContext ctx, const ast::ClassDef *klass) {
+        scopeStack.pop_back();
+        ownerStack.pop_back();
+        auto sym = defined.symbols[klass];
+
+        if (klass->kind == ast::Class && !sym.data(ctx)->superClass().exists() && sym != core::Symbols::BasicObject()) {
+            sym.data(ctx)->setSuperClass(core::Symbols::todo());
+        }
+
+        // In Ruby 2.5 they changed this class to have a different superclass
+        // from 2.4. Since we don't have a good story around versioned ruby rbis
+        // yet, lets just force the superclass regardless of version.
+        if (sym == core::Symbols::Net_IMAP()) {
+            sym.data(ctx)->setSuperClass(core::Symbols::Net_Protocol());
+        }
+
+        sym.data(ctx)->addLoc(ctx, klass->declLoc);
+        sym.data(ctx)->singletonClass(ctx); // force singleton class into existence
+
+        defineNamerDSL(ctx, klass, sym);
+
+        // make sure we've added a static init symbol so we have it ready for the flatten pass later
+        if (sym == core::Symbols::root()) {
+            ctx.state.staticInitForFile(klass->loc);
+        } else {
+            ctx.state.staticInitForClass(sym, klass->loc);
+        }
+    }
+
+    void defineMethod(core::MutableContext ctx, const ast::MethodDef *method) {
+        scopeStack.emplace_back();
 
         core::SymbolRef owner = methodOwner(ctx);
 
@@ -558,16 +653,19 @@ public:
         }
         ENFORCE(owner.data(ctx)->isClass());
 
-        auto parsedArgs = ast::ArgParsing::parseArgs(ctx, method->args);
+        auto parsedArgs = parseArgShapes(method->args);
+        auto &outcome = defined.methods[method];
+        argCountStack.emplace_back(parsedArgs.size());
 
         auto sym = owner.data(ctx)->findMemberNoDealias(ctx, method->name);
         if (sym.exists()) {
             if (method->declLoc == sym.data(ctx)->loc()) {
                 // TODO remove if the paramsMatch is perfect
                 // Reparsing the same file
-                method->symbol = sym;
-                method->args = fillInArgs(ctx.withOwner(method->symbol), move(parsedArgs));
-                return method;
+                outcome.symbol = sym;
+                outcome.plainArgs = fillInArgs(ctx.withOwner(sym), parsedArgs);
+                ownerStack.emplace_back(sym);
+                return;
             }
             if (isIntrinsic(ctx, sym) || paramsMatch(ctx.withOwner(sym), method->declLoc, parsedArgs)) {
                 sym.data(ctx)->addLoc(ctx, method->declLoc);
@@ -575,65 +673,85 @@ public:
                 ctx.state.mangleRenameSymbol(sym, method->name);
             }
         }
-        method->symbol = ctx.state.enterMethodSymbol(method->declLoc, owner, method->name);
-        method->args = fillInArgs(ctx.withOwner(method->symbol), move(parsedArgs));
-        method->symbol.data(ctx)->addLoc(ctx, method->declLoc);
+        outcome.symbol = ctx.state.enterMethodSymbol(method->declLoc, owner, method->name);
+        outcome.plainArgs = fillInArgs(ctx.withOwner(outcome.symbol), parsedArgs);
+        outcome.symbol.data(ctx)->addLoc(ctx, method->declLoc);
         if (method->isDSLSynthesized()) {
-            method->symbol.data(ctx)->setDSLSynthesized();
+            outcome.symbol.data(ctx)->setDSLSynthesized();
         }
-        return method;
+        ownerStack.emplace_back(outcome.symbol);
     }
 
-    unique_ptr<ast::MethodDef> postTransformMethodDef(core::MutableContext ctx, unique_ptr<ast::MethodDef> method) {
-        ENFORCE(method->args.size() == method->symbol.data(ctx)->arguments().size());
-        exitScope();
+    void defineMethodExit(core::MutableContext ctx, const ast::MethodDef *method) {
+        ownerStack.pop_back();
+        scopeStack.pop_back();
+        auto sym = defined.methods[method].symbol;
+        ENFORCE(argCountStack.back() == sym.data(ctx)->arguments().size(), "{}: {} != {}", method->name.showRaw(ctx),
+                argCountStack.back(), sym.data(ctx)->arguments().size());
+        argCountStack.pop_back();
         if (scopeStack.back().moduleFunctionActive) {
-            aliasModuleFunction(ctx, method->symbol.data(ctx)->loc(), method->symbol);
+            aliasModuleFunction(ctx, sym.data(ctx)->loc(), sym);
         }
-        ENFORCE(method->args.size() == method->symbol.data(ctx)->arguments().size(), "{}: {} != {}",
-                method->name.showRaw(ctx), method->args.size(), method->symbol.data(ctx)->arguments().size());
-        // Not all information is unfortunately available in the symbol. Original argument names aren't.
-        // method->args.clear();
-        return method;
     }
 
-    unique_ptr<ast::Expression> postTransformUnresolvedIdent(core::MutableContext ctx,
-                                                             unique_ptr<ast::UnresolvedIdent> nm) {
-        ENFORCE(nm->kind != ast::UnresolvedIdent::Local, "Unresolved local left after `name_locals`");
-
-        if (nm->kind == ast::UnresolvedIdent::Global) {
-            core::SymbolData root = core::Symbols::root().data(ctx);
-            core::SymbolRef sym = root->findMember(ctx, nm->name);
-            if (!sym.exists()) {
-                sym = ctx.state.enterFieldSymbol(nm->loc, core::Symbols::root(), nm->name);
-            }
-            return make_unique<ast::Field>(nm->loc, sym);
-        } else {
-            return nm;
+    void defineVisibility(core::MutableContext ctx, const ast::Send *send) {
+        auto *mdef = modifiedMethodDef(send->args[0].get());
+        auto sym = defined.methods[mdef].symbol;
+        switch (send->fun._id) {
+            case core::Names::private_()._id:
+            case core::Names::privateClassMethod()._id:
+                sym.data(ctx)->setPrivate();
+                break;
+            case core::Names::protected_()._id:
+                sym.data(ctx)->setProtected();
+                break;
+            case core::Names::public_()._id:
+                sym.data(ctx)->setPublic();
+                break;
+            case core::Names::moduleFunction()._id:
+                aliasModuleFunction(ctx, send->loc, sym);
+                break;
+            default:
+                ENFORCE(false, "not a visibility modifier");
         }
     }
 
-    // Returns the SymbolRef corresponding to the class `self.class`, unless the
-    // context is a class, in which case return it.
-    core::SymbolRef contextClass(core::GlobalState &gs, core::SymbolRef ofWhat) const {
-        core::SymbolRef owner = ofWhat;
-        while (true) {
-            ENFORCE(owner.exists(), "non-existing owner in contextClass");
-            const auto &data = owner.data(gs);
-
-            if (data->isClass()) {
-                break;
+    void defineModuleFunction(core::MutableContext ctx, const ast::Send *send) {
+        if (send->args.empty()) {
+            scopeStack.back().moduleFunctionActive = true;
+            return;
+        }
+        for (auto &arg : send->args) {
+            auto lit = ast::cast_tree_const<ast::Literal>(arg.get());
+            if (lit == nullptr || !lit->isSymbol(ctx)) {
+                if (auto e = ctx.state.beginError(arg->loc, core::errors::Namer::DynamicDSLInvocation)) {
+                    e.setHeader("Unsupported argument to `{}`: arguments must be symbol literals", send->fun.show(ctx));
+                }
+                continue;
             }
-            if (data->name == core::Names::staticInit()) {
-                owner = data->owner.data(gs)->attachedClass(gs);
-            } else {
-                owner = data->owner;
+            core::NameRef name = lit->asSymbol(ctx);
+
+            core::SymbolRef meth = methodOwner(ctx).data(ctx)->findMember(ctx, name);
+            if (!meth.exists()) {
+                if (auto e = ctx.state.beginError(arg->loc, core::errors::Namer::MethodNotFound)) {
+                    e.setHeader("`{}`: no such method: `{}`", send->fun.show(ctx), name.show(ctx));
+                }
+                continue;
             }
+            aliasModuleFunction(ctx, send->loc, meth);
         }
-        return owner;
     }
 
-    unique_ptr<ast::Assign> fillAssign(core::MutableContext ctx, unique_ptr<ast::Assign> asgn) {
+    void defineGlobalField(core::MutableContext ctx, const ast::UnresolvedIdent *nm) {
+        core::SymbolData root = core::Symbols::root().data(ctx);
+        core::SymbolRef sym = root->findMember(ctx, nm->name);
+        if (!sym.exists()) {
+            sym = ctx.state.enterFieldSymbol(nm->loc, core::Symbols::root(), nm->name);
+        }
+        defined.symbols[nm] = sym;
+    }
+
+    core::SymbolRef fillAssign(core::MutableContext ctx, const ast::Assign *asgn) {
         // forbid dynamic constant definition
         auto ownerData = ctx.owner.data(ctx);
         if (!ownerData->isClass() && !ownerData->isDSLSynthesized()) {
@@ -642,9 +760,9 @@ public:
             }
         }
 
-        auto lhs = ast::cast_tree<ast::UnresolvedConstantLit>(asgn->lhs.get());
+        auto lhs = ast::cast_tree_const<ast::UnresolvedConstantLit>(asgn->lhs.get());
         ENFORCE(lhs);
-        core::SymbolRef scope = squashNames(ctx, contextClass(ctx, ctx.owner), lhs->scope);
+        core::SymbolRef scope = squashNames(ctx, contextClass(ctx, ctx.owner), lhs->scope.get());
         if (!scope.data(ctx)->isClass()) {
             if (auto e = ctx.state.beginError(asgn->loc, core::errors::Namer::InvalidClassOwner)) {
                 auto constLitName = lhs->cnst.data(ctx)->show(ctx);
@@ -656,7 +774,7 @@ public:
             // Mangle this one out of the way, and re-enter a symbol with this name as a class.
             auto scopeName = scope.data(ctx)->name;
             ctx.state.mangleRenameSymbol(scope, scopeName);
-            scope = ctx.state.enterClassSymbol(lhs->scope->loc, scope.data(ctx)->owner, scopeName);
+            scope = ctx.state.enterClassSymbol(squashedLoc(lhs->scope.get()), scope.data(ctx)->owner, scopeName);
             scope.data(ctx)->singletonClass(ctx); // force singleton class into existance
         }
 
@@ -668,34 +786,32 @@ public:
             }
             ctx.state.mangleRenameSymbol(sym, sym.data(ctx)->name);
         }
-        core::SymbolRef cnst = ctx.state.enterStaticFieldSymbol(lhs->loc, scope, lhs->cnst);
-        auto loc = lhs->loc;
-        unique_ptr<ast::UnresolvedConstantLit> lhsU(lhs);
-        asgn->lhs.release();
-        asgn->lhs = make_unique<ast::ConstantLit>(loc, cnst, std::move(lhsU));
-        return asgn;
+        return ctx.state.enterStaticFieldSymbol(lhs->loc, scope, lhs->cnst);
+    }
+
+    AssignOutcome defineTypeAlias(core::MutableContext ctx, const ast::Assign *asgn) {
+        auto sym = fillAssign(ctx, asgn);
+        if (sym.data(ctx)->isStaticField()) {
+            sym.data(ctx)->setTypeAlias();
+        }
+        return {AssignKind::TypeMemberAlias, sym};
     }
 
-    unique_ptr<ast::Expression> handleTypeMemberDefinition(core::MutableContext ctx, const ast::Send *send,
-                                                           unique_ptr<ast::Assign> asgn,
-                                                           const ast::UnresolvedConstantLit *typeName) {
-        ENFORCE(asgn->lhs.get() == typeName &&
-                asgn->rhs.get() == send); // this method assumes that `asgn` owns `send` and `typeName`
+    AssignOutcome defineTypeMember(core::MutableContext ctx, const ast::Send *send, const ast::Assign *asgn,
+                                   const ast::UnresolvedConstantLit *typeName) {
         core::Variance variance = core::Variance::Invariant;
         bool isTypeTemplate = send->fun == core::Names::typeTemplate();
         if (!ctx.owner.data(ctx)->isClass()) {
             if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::InvalidTypeDefinition)) {
                 e.setHeader("Types must be defined in class or module scopes");
             }
-            return make_unique<ast::EmptyTree>();
+            return {AssignKind::TypeMemberRemoved, core::Symbols::noSymbol()};
         }
         if (ctx.owner == core::Symbols::root()) {
             if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::RootTypeMember)) {
                 e.setHeader("`{}` cannot be used at the top-level", "type_member");
             }
-            auto send =
-                ast::MK::Send1(asgn->loc, ast::MK::T(asgn->loc), core::Names::typeAlias(), ast::MK::Untyped(asgn->loc));
-            return handleAssignment(ctx, make_unique<ast::Assign>(asgn->loc, std::move(asgn->lhs), std::move(send)));
+            return defineTypeAlias(ctx, asgn);
         }
 
         auto onSymbol = isTypeTemplate ? ctx.owner.data(ctx)->singletonClass(ctx) : ctx.owner;
@@ -704,13 +820,10 @@ public:
                 if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::InvalidTypeDefinition)) {
                     e.setHeader("Too many args in type definition");
                 }
-                auto send = ast::MK::Send1(asgn->loc, ast::MK::T(asgn->loc), core::Names::typeAlias(),
-                                           ast::MK::Untyped(asgn->loc));
-                return handleAssignment(ctx,
-                                        make_unique<ast::Assign>(asgn->loc, std::move(asgn->lhs), std::move(send)));
+                return defineTypeAlias(ctx, asgn);
             }
 
-            auto lit = ast::cast_tree<ast::Literal>(send->args[0].get());
+            auto lit = ast::cast_tree_const<ast::Literal>(send->args[0].get());
             if (lit != nullptr && lit->isSymbol(ctx)) {
                 core::NameRef name = lit->asSymbol(ctx);
 
@@ -728,7 +841,7 @@ public:
                     }
                 }
             } else {
-                if (send->args.size() != 1 || ast::cast_tree<ast::Hash>(send->args[0].get()) == nullptr) {
+                if (send->args.size() != 1 || ast::cast_tree_const<ast::Hash>(send->args[0].get()) == nullptr) {
                     if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::InvalidTypeDefinition)) {
                         e.setHeader("Invalid param, must be a :symbol");
                     }
@@ -742,7 +855,7 @@ public:
             if (auto e = ctx.state.beginError(typeName->loc, core::errors::Namer::InvalidTypeDefinition)) {
                 e.setHeader("Duplicate type member `{}`", typeName->cnst.data(ctx)->show(ctx));
             }
-            return make_unique<ast::EmptyTree>();
+            return {AssignKind::TypeMemberRemoved, core::Symbols::noSymbol()};
         }
         auto oldSym = onSymbol.data(ctx)->findMemberNoDealias(ctx, typeName->cnst);
         if (oldSym.exists() && !(oldSym.data(ctx)->loc() == asgn->loc || oldSym.data(ctx)->loc().isTombStoned(ctx))) {
@@ -769,13 +882,11 @@ public:
         }
 
         if (!send->args.empty()) {
-            auto *hash = ast::cast_tree<ast::Hash>(send->args.back().get());
+            auto *hash = ast::cast_tree_const<ast::Hash>(send->args.back().get());
             if (hash) {
-                int i = -1;
+                bool replacesLhs = false;
                 for (auto &keyExpr : hash->keys) {
-                    i++;
-                    auto key = ast::cast_tree<ast::Literal>(keyExpr.get());
-                    core::NameRef name;
+                    auto key = ast::cast_tree_const<ast::Literal>(keyExpr.get());
                     if (key != nullptr && key->isSymbol(ctx)) {
                         switch (key->asSymbol(ctx)._id) {
                             case core::Names::fixed()._id:
@@ -786,7 +897,7 @@ public:
                                 // dependency in the resolver. See RUBYPLAT-520
                                 sym.data(ctx)->resultType = core::Types::untyped(ctx, sym);
 
-                                asgn->lhs = ast::MK::Constant(asgn->lhs->loc, sym);
+                                replacesLhs = true;
                                 continue;
 
                             // intentionally falling through here
@@ -810,7 +921,7 @@ public:
 
                 // one of :fixed or bounds were provided
                 if (fixed != bounded) {
-                    return asgn;
+                    return {replacesLhs ? AssignKind::TypeMemberFixed : AssignKind::TypeMemberKept, sym};
                 } else if (fixed) {
                     // both :fixed and bounds were specified
                     if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::InvalidTypeDefinition)) {
@@ -823,69 +934,451 @@ public:
                 }
             }
         }
-        return make_unique<ast::EmptyTree>();
+        return {AssignKind::TypeMemberRemoved, core::Symbols::noSymbol()};
     }
 
-    unique_ptr<ast::Expression> handleAssignment(core::MutableContext ctx, unique_ptr<ast::Assign> asgn) {
-        auto *send = ast::cast_tree<ast::Send>(asgn->rhs.get());
-        auto ret = fillAssign(ctx, std::move(asgn));
-        if (send->fun == core::Names::typeAlias()) {
-            auto id = ast::cast_tree<ast::ConstantLit>(ret->lhs.get());
-            ENFORCE(id != nullptr, "fillAssign did not make lhs into a ConstantLit");
-
-            auto sym = id->symbol;
-            ENFORCE(sym.exists(), "fillAssign did not make symbol for ConstantLit");
+    void defineConstantAssign(core::MutableContext ctx, const ast::Assign *asgn) {
+        auto &outcome = defined.assigns[asgn];
+        auto *send = ast::cast_tree_const<ast::Send>(asgn->rhs.get());
+        if (send == nullptr) {
+            outcome = {AssignKind::StaticField, fillAssign(ctx, asgn)};
+            return;
+        }
 
-            if (sym.data(ctx)->isStaticField()) {
+        if (!send->recv->isSelfReference()) {
+            auto sym = fillAssign(ctx, asgn);
+            if (send->fun == core::Names::typeAlias() && sym.data(ctx)->isStaticField()) {
                 sym.data(ctx)->setTypeAlias();
             }
+            outcome = {AssignKind::StaticField, sym};
+            return;
+        }
+
+        auto *typeName = ast::cast_tree_const<ast::UnresolvedConstantLit>(asgn->lhs.get());
+        switch (send->fun._id) {
+            case core::Names::typeTemplate()._id:
+            case core::Names::typeMember()._id:
+                outcome = defineTypeMember(ctx, send, asgn, typeName);
+                return;
+            default:
+                outcome = {AssignKind::StaticField, fillAssign(ctx, asgn)};
+                return;
+        }
+    }
+
+public:
+    SymbolDefiner(DefinedSymbols &defined, core::SymbolRef owner) : defined(defined) {
+        scopeStack.emplace_back();
+        ownerStack.emplace_back(owner);
+    }
+
+    void run(core::MutableContext ctx, const FoundDefinitions &found) {
+        for (u4 i = 0; i < found.defs.size(); i++) {
+            auto &def = found.defs[i];
+            auto ownerCtx = currentCtx(ctx);
+            switch (def.kind) {
+                case FoundDefinition::Kind::ClassDef:
+                    defineClass(ownerCtx, ast::cast_tree_const<ast::ClassDef>(def.node));
+                    break;
+                case FoundDefinition::Kind::ClassDefExit:
+                    defineClassExit(ownerCtx, ast::cast_tree_const<ast::ClassDef>(def.node));
+                    break;
+                case FoundDefinition::Kind::MethodDef:
+                    defineMethod(ownerCtx, ast::cast_tree_const<ast::MethodDef>(def.node));
+                    break;
+                case FoundDefinition::Kind::MethodDefExit:
+                    defineMethodExit(ownerCtx, ast::cast_tree_const<ast::MethodDef>(def.node));
+                    break;
+                case FoundDefinition::Kind::DefaultArg: {
+                    auto &outcome = defined.methods[ast::cast_tree_const<ast::MethodDef>(def.node)];
+                    if (outcome.plainArgs[def.argIndex]) {
+                        // The default value is dropped from the tree, so nothing in it gets defined.
+                        i = def.skipTo - 1;
+                    }
+                    break;
+                }
+                case FoundDefinition::Kind::Visibility:
+                    defineVisibility(ownerCtx, ast::cast_tree_const<ast::Send>(def.node));
+                    break;
+                case FoundDefinition::Kind::ModuleFunction:
+                    defineModuleFunction(ownerCtx, ast::cast_tree_const<ast::Send>(def.node));
+                    break;
+                case FoundDefinition::Kind::GlobalField:
+                    defineGlobalField(ownerCtx, ast::cast_tree_const<ast::UnresolvedIdent>(def.node));
+                    break;
+                case FoundDefinition::Kind::ConstantAssign:
+                    defineConstantAssign(ownerCtx, ast::cast_tree_const<ast::Assign>(def.node));
+                    break;
+            }
         }
-        return ret;
+        ENFORCE(ownerStack.size() == 1);
     }
+};
 
-    unique_ptr<ast::Expression> postTransformAssign(core::MutableContext ctx, unique_ptr<ast::Assign> asgn) {
-        auto *lhs = ast::cast_tree<ast::UnresolvedConstantLit>(asgn->lhs.get());
-        if (lhs == nullptr) {
-            return asgn;
+/**
+ * Rewrites a tree using the symbols SymbolDefiner entered for it. Only reads GlobalState, so it can run on many trees
+ * at once.
+ */
+class TreeSymbolizer {
+    const DefinedSymbols &defined;
+
+    void squashNames(core::Context ctx, unique_ptr<ast::Expression> &node) {
+        auto constLit = ast::cast_tree<ast::UnresolvedConstantLit>(node.get());
+        if (constLit == nullptr) {
+            if (!ast::isa_tree<ast::ConstantLit>(node.get())) {
+                node = ast::MK::EmptyTree();
+            }
+            return;
+        }
+
+        auto fnd = defined.symbols.find(constLit);
+        if (fnd == defined.symbols.end()) {
+            node = ast::MK::EmptyTree();
+            return;
         }
+        squashNames(ctx, constLit->scope);
+        node.release();
+        unique_ptr<ast::UnresolvedConstantLit> constTmp(constLit);
+        node = make_unique<ast::ConstantLit>(constLit->loc, fnd->second, std::move(constTmp));
+    }
 
-        auto *send = ast::cast_tree<ast::Send>(asgn->rhs.get());
+    bool addAncestor(core::Context ctx, unique_ptr<ast::ClassDef> &klass, unique_ptr<ast::Expression> &node) {
+        auto send = ast::cast_tree<ast::Send>(node.get());
         if (send == nullptr) {
-            return fillAssign(ctx, std::move(asgn));
+            ENFORCE(node.get() != nullptr);
+            return false;
         }
 
+        ast::ClassDef::ANCESTORS_store *dest;
+        if (send->fun == core::Names::include()) {
+            dest = &klass->ancestors;
+        } else if (send->fun == core::Names::extend()) {
+            dest = &klass->singletonAncestors;
+        } else {
+            return false;
+        }
         if (!send->recv->isSelfReference()) {
-            return handleAssignment(ctx, std::move(asgn));
+            // ignore `something.include`
+            return false;
         }
 
-        auto *typeName = ast::cast_tree<ast::UnresolvedConstantLit>(asgn->lhs.get());
-        if (typeName == nullptr) {
-            return fillAssign(ctx, std::move(asgn));
+        if (send->args.empty()) {
+            if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::IncludeMutipleParam)) {
+                e.setHeader("`{}` requires at least one argument", send->fun.data(ctx)->show(ctx));
+            }
+            return false;
         }
 
-        switch (send->fun._id) {
-            case core::Names::typeTemplate()._id:
-                return handleTypeMemberDefinition(ctx, send, std::move(asgn), typeName);
-            case core::Names::typeMember()._id:
-                return handleTypeMemberDefinition(ctx, send, std::move(asgn), typeName);
-            default:
-                return fillAssign(ctx, std::move(asgn));
+        if (send->block != nullptr) {
+            if (auto e = ctx.state.beginError(send->loc, core::errors::Namer::IncludePassedBlock)) {
+                e.setHeader("`{}` can not be passed a block", send->fun.data(ctx)->show(ctx));
+            }
+            return false;
+        }
+
+        for (auto it = send->args.rbegin(); it != send->args.rend(); it++) {
+            // Reverse order is intentional: that's how Ruby does it.
+            auto &arg = *it;
+            if (ast::isa_tree<ast::EmptyTree>(arg.get())) {
+                continue;
+            }
+            if (arg->isSelfReference()) {
+                dest->emplace_back(std::move(arg));
+                continue;
+            }
+            if (isValidAncestor(arg.get())) {
+                dest->emplace_back(std::move(arg));
+            } else {
+                if (auto e = ctx.state.beginError(arg->loc, core::errors::Namer::AncestorNotConstant)) {
+                    e.setHeader("`{}` must only contain constant literals", send->fun.data(ctx)->show(ctx));
+                }
+                arg = ast::MK::EmptyTree();
+            }
+        }
+
+        return true;
+    }
+
+    // This decides if we need to keep a node around incase the current LSP query needs type information for it
+    bool shouldLeaveAncestorForIDE(const unique_ptr<ast::Expression> &anc) {
+        // used in Desugar <-> resolver to signal classes that did not have explicit superclass
+        if (ast::isa_tree<ast::EmptyTree>(anc.get()) || anc->isSelfReference()) {
+            return false;
+        }
+        auto rcl = ast::cast_tree<ast::ConstantLit>(anc.get());
+        if (rcl && rcl->symbol == core::Symbols::todo()) {
+            return false;
+        }
+        return true;
+    }
+
+    ast::MethodDef::ARGS_store fillInArgs(core::Context ctx, vector<ast::ParsedArg> parsedArgs,
+                                          const vector<bool> &plainArgs) {
+        ENFORCE(parsedArgs.size() == plainArgs.size());
+        ast::MethodDef::ARGS_store args;
+        int i = -1;
+        for (auto &arg : parsedArgs) {
+            i++;
+            unique_ptr<ast::Reference> localExpr = make_unique<ast::Local>(arg.loc, arg.local);
+            if (!arg.shadow && !plainArgs[i] && arg.default_) {
+                localExpr = make_unique<ast::OptionalArg>(arg.loc, move(localExpr), move(arg.default_));
+            }
+            args.emplace_back(move(localExpr));
+        }
+        return args;
+    }
+
+    unique_ptr<ast::Assign> fillAssign(core::Context ctx, unique_ptr<ast::Assign> asgn, core::SymbolRef cnst) {
+        auto lhs = ast::cast_tree<ast::UnresolvedConstantLit>(asgn->lhs.get());
+        ENFORCE(lhs);
+        squashNames(ctx, lhs->scope);
+        auto loc = lhs->loc;
+        unique_ptr<ast::UnresolvedConstantLit> lhsU(lhs);
+        asgn->lhs.release();
+        asgn->lhs = make_unique<ast::ConstantLit>(loc, cnst, std::move(lhsU));
+        return asgn;
+    }
+
+public:
+    TreeSymbolizer(const DefinedSymbols &defined) : defined(defined) {}
+
+    unique_ptr<ast::ClassDef> preTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> klass) {
+        auto fnd = defined.symbols.find(klass.get());
+        ENFORCE(fnd != defined.symbols.end());
+        auto *ident = ast::cast_tree<ast::UnresolvedIdent>(klass->name.get());
+        bool isSingleton = ident != nullptr && ident->name == core::Names::singleton();
+        if (!isSingleton && klass->symbol == core::Symbols::todo()) {
+            squashNames(ctx, klass->name);
+        }
+        klass->symbol = fnd->second;
+        return klass;
+    }
+
+    unique_ptr<ast::Expression> postTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> klass) {
+        auto toRemove = remove_if(klass->rhs.begin(), klass->rhs.end(),
+                                  [&](unique_ptr<ast::Expression> &line) { return addAncestor(ctx, klass, line); });
+        klass->rhs.erase(toRemove, klass->rhs.end());
+
+        if (!klass->ancestors.empty()) {
+            /* Superclass is typeAlias in parent scope, mixins are typeAlias in inner scope */
+            for (auto &anc : klass->ancestors) {
+                if (!isValidAncestor(anc.get())) {
+                    if (auto e = ctx.state.beginError(anc->loc, core::errors::Namer::AncestorNotConstant)) {
+                        e.setHeader("Superclasses must only contain constant literals");
+                    }
+                    anc = ast::MK::EmptyTree();
+                } else if (shouldLeaveAncestorForIDE(anc) &&
+                           (klass->kind == ast::Module || anc != klass->ancestors.front())) {
+                    klass->rhs.emplace_back(ast::MK::KeepForIDE(anc->deepCopy()));
+                }
+            }
+        }
+        if (!klass->singletonAncestors.empty()) {
+            for (auto &sanc : klass->singletonAncestors) {
+                if (shouldLeaveAncestorForIDE(sanc)) {
+                    klass->rhs.emplace_back(ast::MK::KeepForIDE(sanc->deepCopy()));
+                }
+            }
+        }
+        ast::InsSeq::STATS_store ideSeqs;
+        if (ast::isa_tree<ast::ConstantLit>(klass->name.get())) {
+            ideSeqs.emplace_back(ast::MK::KeepForIDE(klass->name->deepCopy()));
+        }
+        if (klass->kind == ast::Class && !klass->ancestors.empty() &&
+            shouldLeaveAncestorForIDE(klass->ancestors.front())) {
+            ideSeqs.emplace_back(ast::MK::KeepForIDE(klass->ancestors.front()->deepCopy()));
+        }
+
+        return ast::MK::InsSeq(klass->declLoc, std::move(ideSeqs), std::move(klass));
+    }
+
+    unique_ptr<ast::MethodDef> preTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> method) {
+        auto fnd = defined.methods.find(method.get());
+        ENFORCE(fnd != defined.methods.end());
+        method->symbol = fnd->second.symbol;
+        auto parsedArgs = ast::ArgParsing::parseArgs(ctx, method->args);
+        method->args = fillInArgs(ctx.withOwner(method->symbol), move(parsedArgs), fnd->second.plainArgs);
+        return method;
+    }
+
+    unique_ptr<ast::Expression> postTransformSend(core::Context ctx, unique_ptr<ast::Send> original) {
+        if (original->args.size() == 1 && ast::isa_tree<ast::MethodDef>(original->args[0].get()) &&
+            isVisibilityModifier(original->fun)) {
+            return std::move(original->args[0]);
+        }
+        return original;
+    }
+
+    unique_ptr<ast::Expression> postTransformUnresolvedIdent(core::Context ctx, unique_ptr<ast::UnresolvedIdent> nm) {
+        ENFORCE(nm->kind != ast::UnresolvedIdent::Local, "Unresolved local left after `name_locals`");
+
+        if (nm->kind == ast::UnresolvedIdent::Global) {
+            auto fnd = defined.symbols.find(nm.get());
+            ENFORCE(fnd != defined.symbols.end());
+            return make_unique<ast::Field>(nm->loc, fnd->second);
+        } else {
+            return nm;
         }
     }
 
-private:
-    NameInserter() {
-        enterScope();
+    unique_ptr<ast::Expression> postTransformAssign(core::Context ctx, unique_ptr<ast::Assign> asgn) {
+        auto *lhs = ast::cast_tree<ast::UnresolvedConstantLit>(asgn->lhs.get());
+        if (lhs == nullptr) {
+            return asgn;
+        }
+
+        auto fnd = defined.assigns.find(asgn.get());
+        ENFORCE(fnd != defined.assigns.end());
+        auto &outcome = fnd->second;
+        switch (outcome.kind) {
+            case AssignKind::StaticField:
+                return fillAssign(ctx, std::move(asgn), outcome.symbol);
+            case AssignKind::TypeMemberRemoved:
+                return make_unique<ast::EmptyTree>();
+            case AssignKind::TypeMemberKept:
+                return asgn;
+            case AssignKind::TypeMemberFixed:
+                asgn->lhs = ast::MK::Constant(asgn->lhs->loc, outcome.symbol);
+                return asgn;
+            case AssignKind::TypeMemberAlias: {
+                auto send = ast::MK::Send1(asgn->loc, ast::MK::T(asgn->loc), core::Names::typeAlias(),
+                                           ast::MK::Untyped(asgn->loc));
+                return fillAssign(ctx, make_unique<ast::Assign>(asgn->loc, std::move(asgn->lhs), std::move(send)),
+                                  outcome.symbol);
+            }
+        }
     }
 };
 
+struct NamingJob {
+    ast::ParsedFile tree;
+    FoundDefinitions found;
+    DefinedSymbols defined;
+    bool failed = false;
+};
+
+void reportNamingException(const core::GlobalState &gs, NamingJob &job) {
+    Exception::failInFuzzer();
+    auto file = job.tree.file;
+    if (auto e = gs.beginError(sorbet::core::Loc::none(file), core::errors::Internal::InternalError)) {
+        e.setHeader("Exception naming file: `{}` (backtrace is above)", file.data(gs).path());
+    }
+    job.failed = true;
+    job.tree.tree = ast::MK::EmptyTree();
+}
+
+// Runs `fn` on every job that hasn't failed yet, using all of the workers. Returns once every job has been processed.
+template <class F>
+void runOnAllJobs(const core::GlobalState &gs, ConstExprStr taskName, vector<NamingJob> &jobs, WorkerPool &workers,
+                  F fn) {
+    auto fileq = make_shared<ConcurrentBoundedQueue<int>>(jobs.size());
+    auto resultq = make_shared<BlockingBoundedQueue<int>>(jobs.size());
+    for (int i = 0; i < jobs.size(); i++) {
+        fileq->push(move(i), 1);
+    }
+
+    workers.multiplexJob(taskName, [&gs, &jobs, &fn, fileq, resultq]() {
+        int processedByThread = 0;
+        int idx;
+        for (auto result = fileq->try_pop(idx); !result.done(); result = fileq->try_pop(idx)) {
+            if (result.gotItem()) {
+                processedByThread++;
+                auto &job = jobs[idx];
+                if (job.failed) {
+                    continue;
+                }
+                core::ErrorRegion errs(gs, job.tree.file);
+                try {
+                    fn(job);
+                } catch (SorbetException &) {
+                    reportNamingException(gs, job);
+                }
+            }
+        }
+        if (processedByThread > 0) {
+            resultq->push(move(processedByThread), processedByThread);
+        }
+    });
+
+    int threadProcessed;
+    for (auto result = resultq->wait_pop_timed(threadProcessed, WorkerPool::BLOCK_INTERVAL(), gs.tracer());
+         !result.done();
+         result = resultq->wait_pop_timed(threadProcessed, WorkerPool::BLOCK_INTERVAL(), gs.tracer())) {
+    }
+}
+
+void findDefinitions(core::Context ctx, NamingJob &job) {
+    DefinitionFinder finder(job.found);
+    job.tree.tree = ast::TreeMap::apply(ctx, finder, std::move(job.tree.tree));
+}
+
+void defineSymbols(core::MutableContext ctx, NamingJob &job) {
+    SymbolDefiner definer(job.defined, ctx.owner);
+    definer.run(ctx, job.found);
+    job.found.defs.clear();
+}
+
+void symbolizeTree(core::Context ctx, NamingJob &job) {
+    TreeSymbolizer symbolizer(job.defined);
+    job.tree.tree = ast::TreeMap::apply(ctx, symbolizer, std::move(job.tree.tree));
+    job.defined = DefinedSymbols();
+}
+
+} // namespace
+
 ast::ParsedFile Namer::run(core::MutableContext ctx, ast::ParsedFile tree) {
-    NameInserter nameInserter;
-    tree.tree = ast::TreeMap::apply(ctx, nameInserter, std::move(tree.tree));
+    NamingJob job{move(tree)};
+    findDefinitions(ctx, job);
+    defineSymbols(ctx, job);
+    symbolizeTree(ctx, job);
     // This check is FAR too slow to run on large codebases, especially with sanitizers on.
     // But it can be super useful to uncomment when debugging certain issues.
     // ctx.state.sanityCheck();
-    return tree;
+    return move(job.tree);
+}
+
+vector<ast::ParsedFile> Namer::run(core::GlobalState &gs, vector<ast::ParsedFile> trees, WorkerPool &workers) {
+    vector<NamingJob> jobs;
+    jobs.reserve(trees.size());
+    for (auto &tree : trees) {
+        jobs.emplace_back(NamingJob{move(tree)});
+    }
+    trees.clear();
+
+    core::Context ctx(gs, core::Symbols::root());
+    {
+        Timer timeit(gs.tracer(), "naming.findDefinitions");
+        runOnAllJobs(gs, "findDefinitions", jobs, workers, [ctx](NamingJob &job) { findDefinitions(ctx, job); });
+    }
+
+    {
+        Timer timeit(gs.tracer(), "naming.defineSymbols");
+        core::UnfreezeNameTable nameTableAccess(gs);     // creates singletons and class names
+        core::UnfreezeSymbolTable symbolTableAccess(gs); // enters symbols
+        core::MutableContext mctx(gs, core::Symbols::root());
+        // Jobs are in the order the files were given to us, which keeps symbol ids deterministic.
+        for (auto &job : jobs) {
+            if (job.failed) {
+                continue;
+            }
+            core::ErrorRegion errs(gs, job.tree.file);
+            try {
+                defineSymbols(mctx, job);
+            } catch (SorbetException &) {
+                reportNamingException(gs, job);
+            }
+        }
+    }
+
+    {
+        Timer timeit(gs.tracer(), "naming.symbolizeTrees");
+        runOnAllJobs(gs, "symbolizeTrees", jobs, workers, [ctx](NamingJob &job) { symbolizeTree(ctx, job); });
+    }
+
+    for (auto &job : jobs) {
+        trees.emplace_back(move(job.tree));
+    }
+    return trees;
 }
 
 }; // namespace sorbet::namer
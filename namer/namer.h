@@ -1,6 +1,7 @@
 #ifndef SORBET_NAMER_NAMER_H
 #define SORBET_NAMER_NAMER_H
 #include "ast/ast.h"
+#include "common/concurrency/WorkerPool.h"
 #include <memory>
 
 namespace sorbet::namer {
@@ -9,6 +10,11 @@ class Namer final {
 public:
     static ast::ParsedFile run(core::MutableContext ctx, ast::ParsedFile tree);
 
+    // Names many files at once. Finding definitions and rewriting trees happens in parallel on `workers`, while
+    // entering symbols happens serially in the order of `trees`, so the resulting symbol table is deterministic.
+    static std::vector<ast::ParsedFile> run(core::GlobalState &gs, std::vector<ast::ParsedFile> trees,
+                                            WorkerPool &workers);
+
     Namer() = delete;
 };
 
@@ -4,6 +4,7 @@
 #include "ast/ast.h"
 #include "ast/desugar/Desugar.h"
 #include "common/common.h"
+#include "common/concurrency/WorkerPool.h"
 #include "core/Error.h"
 #include "core/Unfreeze.h"
 #include "dsl/dsl.h"
@@ -37,16 +38,22 @@ private:
 
 static string_view testClass_str = "Test"sv;
 
-ast::ParsedFile getTree(core::GlobalState &gs, string str) {
+ast::ParsedFile getDesugaredTree(core::GlobalState &gs, string str) {
     sorbet::core::UnfreezeNameTable nameTableAccess(gs); // enters original strings
     sorbet::core::UnfreezeFileTable ft(gs);              // enters original strings
     auto tree = parser::Parser::run(gs, "<test>", str);
     auto file = tree->loc.file();
     file.data(gs).strictLevel = core::StrictLevel::Strict;
     sorbet::core::MutableContext ctx(gs, core::Symbols::root());
-    auto ast = ast::desugar::node2Tree(ctx, move(tree));
-    ast = dsl::DSL::run(ctx, move(ast));
-    return ast::ParsedFile{move(ast), file};
+    return ast::ParsedFile{ast::desugar::node2Tree(ctx, move(tree)), file};
+}
+
+ast::ParsedFile getTree(core::GlobalState &gs, string str) {
+    auto tree = getDesugaredTree(gs, str);
+    sorbet::core::UnfreezeNameTable nameTableAccess(gs); // creates temporaries
+    sorbet::core::MutableContext ctx(gs, core::Symbols::root());
+    tree.tree = dsl::DSL::run(ctx, move(tree.tree));
+    return tree;
 }
 
 ast::ParsedFile hello_world(core::GlobalState &gs) {
@@ -73,6 +80,18 @@ TEST_F(NamerFixture, HelloWorld) { // NOLINT
     ASSERT_EQ(1, symbol->arguments().size());
 }
 
+TEST_F(NamerFixture, LocalVarsFusedWithDSL) { // NOLINT
+    auto ctx = getCtx();
+    string src = "class A\n"
+                 "  attr_reader :foo\n"
+                 "  def bar(x); y = x; [x].each { |z| y = z }; super; end\n"
+                 "end\n";
+    auto separate = sorbet::local_vars::LocalVars::run(ctx, getTree(ctx, src));
+    sorbet::core::UnfreezeNameTable nameTableAccess(ctx); // creates temporaries
+    auto fused = sorbet::local_vars::LocalVars::runWithDSL(ctx, getDesugaredTree(ctx, src));
+    EXPECT_EQ(separate.tree->toString(ctx), fused.tree->toString(ctx));
+}
+
 TEST_F(NamerFixture, Idempotent) { // NOLINT
     auto ctx = getCtx();
     auto baseSymbols = ctx.state.symbolsUsed();
@@ -138,4 +157,30 @@ TEST_F(NamerFixture, InsideClass) { // NOLINT
     ASSERT_EQ(fooSym, barSym.data(ctx)->owner);
 }
 
+TEST_F(NamerFixture, NameManyFiles) { // NOLINT
+    auto ctx = getCtx();
+    vector<ast::ParsedFile> trees;
+    trees.emplace_back(getTree(ctx, "class Test; class Foo; def bar; end; end; end"));
+    trees.emplace_back(getTree(ctx, "class Test; class Foo; def baz; end; end; class Qux; end; end"));
+    vector<ast::ParsedFile> localTrees;
+    for (auto &tree : trees) {
+        localTrees.emplace_back(sorbet::local_vars::LocalVars::run(ctx, move(tree)));
+    }
+    auto workers = WorkerPool::create(2, *logger);
+    localTrees = namer::Namer::run(ctx.state, move(localTrees), *workers);
+    ASSERT_EQ(2, localTrees.size());
+
+    const auto &rootScope =
+        core::Symbols::root().data(ctx)->findMember(ctx, ctx.state.enterNameConstant(testClass_str)).data(ctx);
+
+    ASSERT_EQ(4, rootScope->members().size());
+    auto fooSym = rootScope->members().at(ctx.state.enterNameConstant("Foo"));
+    const auto &fooInfo = fooSym.data(ctx);
+    ASSERT_EQ(3, fooInfo->members().size());
+    auto barSym = fooInfo->members().at(ctx.state.enterNameUTF8("bar"));
+    auto bazSym = fooInfo->members().at(ctx.state.enterNameUTF8("baz"));
+    // Symbols are entered in the order the files were given, no matter which thread found them.
+    ASSERT_LT(barSym._id, bazSym._id);
+}
+
 } // namespace sorbet::namer::test
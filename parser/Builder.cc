@@ -56,7 +56,7 @@ string Dedenter::dedent(string_view str) {
 
 class Builder::Impl {
 public:
-    Impl(GlobalState &gs, core::FileRef file) : gs_(gs), file_(file) {
+    Impl(GlobalState &gs, core::FileRef file, u4 offset) : gs_(gs), file_(file), offset_(offset) {
         this->maxOff_ = file.data(gs).source().size();
         foreignNodes_.emplace_back();
     }
@@ -64,13 +64,14 @@ public:
     GlobalState &gs_;
     u2 uniqueCounter_ = 1;
     core::FileRef file_;
+    u4 offset_;
     u4 maxOff_;
     ruby_parser::base_driver *driver_;
 
     vector<unique_ptr<Node>> foreignNodes_;
 
     u4 clamp(u4 off) {
-        return std::min(off, maxOff_);
+        return std::min(off + offset_, maxOff_);
     }
 
     core::Loc tokLoc(const token *tok) {
@@ -128,7 +129,8 @@ public:
     }
 
     void error(ruby_parser::dclass err, core::Loc loc) {
-        driver_->external_diagnostic(ruby_parser::dlevel::ERROR, err, loc.beginPos(), loc.endPos(), "");
+        driver_->external_diagnostic(ruby_parser::dlevel::ERROR, err, loc.beginPos() - offset_,
+                                     loc.endPos() - offset_, "");
     }
 
     /* Begin callback methods */
@@ -1046,7 +1048,7 @@ public:
     }
 };
 
-Builder::Builder(GlobalState &gs, core::FileRef file) : impl_(new Builder::Impl(gs, file)) {}
+Builder::Builder(GlobalState &gs, core::FileRef file, u4 offset) : impl_(new Builder::Impl(gs, file, offset)) {}
 Builder::~Builder() = default;
 
 }; // namespace sorbet::parser
@@ -14,7 +14,8 @@ class Node;
 
 class Builder final {
 public:
-    Builder(sorbet::core::GlobalState &gs, sorbet::core::FileRef file);
+    // `offset` is where the source handed to the driver starts in `file`, when that is only part of it.
+    Builder(sorbet::core::GlobalState &gs, sorbet::core::FileRef file, u4 offset = 0);
     ~Builder();
 
     static ruby_parser::builder interface;
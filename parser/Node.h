@@ -20,6 +20,12 @@ public:
     virtual std::string nodeName() = 0;
     core::Loc loc;
 
+    // Nodes are bump-allocated out of per-thread memory instead of one malloc each (see NodeAllocation.cc).
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+    // The memory that all live nodes of all threads currently take up.
+    static int64_t allocatedBytes();
+
 protected:
     void printTabs(fmt::memory_buffer &to, int count) const;
     void printNode(fmt::memory_buffer &to, const std::unique_ptr<Node> &node, const core::GlobalState &gs,
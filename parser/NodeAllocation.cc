@@ -0,0 +1,30 @@
+#include "common/BlockPool.h"
+#include "parser/Node.h"
+
+using namespace std;
+
+namespace sorbet::parser {
+
+/*
+ * A parse builds a whole tree of nodes that lives only until the same thread has desugared it, so nodes are
+ * bump-allocated out of that thread's blocks (see BlockPool) and go back to the system a block at a time once the
+ * tree is dropped, instead of with one free() each.
+ */
+namespace {
+atomic<int64_t> nodeBytes{0};
+thread_local BlockPool nodeBlocks(nodeBytes);
+} // namespace
+
+void *Node::operator new(size_t size) {
+    return nodeBlocks.allocate(size);
+}
+
+void Node::operator delete(void *ptr, size_t size) {
+    BlockPool::deallocate(ptr, size, nodeBytes);
+}
+
+int64_t Node::allocatedBytes() {
+    return nodeBytes.load(memory_order_relaxed);
+}
+
+} // namespace sorbet::parser
@@ -1,5 +1,6 @@
 #include "parser.h"
 #include "Builder.h"
+#include "absl/algorithm/container.h"
 #include "core/Loc.h"
 #include "core/errors/parser.h"
 #include "ruby_parser/driver.hh"
@@ -24,7 +25,8 @@ class ErrorToError {
     }
 
 public:
-    static void run(core::GlobalState &gs, core::FileRef file, ruby_parser::diagnostics_t diagnostics) {
+    // `offset` is where the source that `diagnostics` are about starts in `file`.
+    static void run(core::GlobalState &gs, core::FileRef file, ruby_parser::diagnostics_t diagnostics, u4 offset = 0) {
         if (diagnostics.empty()) {
             return;
         }
@@ -47,8 +49,8 @@ public:
             }
             string msg("Parse {}: ");
             msg.append(dclassStrings[(int)diag.error_class()]);
-            core::Loc loc(file, translatePos(diag.location().beginPos, maxOff - 1),
-                          translatePos(diag.location().endPos, maxOff));
+            core::Loc loc(file, translatePos(offset + diag.location().beginPos, maxOff - 1),
+                          translatePos(offset + diag.location().endPos, maxOff));
             if (auto e = gs.beginError(loc, core::errors::Parser::ParserError)) {
                 e.setHeader(msg, level, diag.data());
             }
@@ -77,4 +79,117 @@ unique_ptr<Node> Parser::run(sorbet::core::GlobalState &gs, string_view path, st
     return run(gs, file);
 }
 
+namespace {
+bool isBlank(string_view text) {
+    return absl::c_all_of(text, [](char c) { return isspace(c); });
+}
+
+// Whether `line` starts with the keyword `word`, rather than with a longer identifier.
+bool startsWithWord(string_view line, string_view word) {
+    if (line.substr(0, word.size()) != word) {
+        return false;
+    }
+    return line.size() == word.size() || !(isalnum(line[word.size()]) || line[word.size()] == '_');
+}
+} // namespace
+
+vector<u4> Parser::chunkBoundaries(string_view source, u4 linesPerChunk) {
+    vector<u4> boundaries{0};
+    u4 line = 0;
+    u4 chunkStartLine = 0;
+    // Where the line after the last top-level `end` starts, once the chunk is long enough to be cut there. The cut is
+    // only made at the next top-level statement, so that no chunk is only comments.
+    optional<u4> pendingCut;
+    u4 pendingCutLine = 0;
+    size_t lineStart = 0;
+    while (lineStart < source.size()) {
+        auto lineEnd = min(source.find('\n', lineStart), source.size());
+        auto text = source.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        line++;
+        if (text.empty() || isspace(text[0]) || text[0] == '#') {
+            continue;
+        }
+        if (startsWithWord(text, "end") && isBlank(text.substr(3))) {
+            if (line - chunkStartLine >= linesPerChunk) {
+                pendingCut = lineStart;
+                pendingCutLine = line;
+            }
+            continue;
+        }
+        if (!startsWithWord(text, "class") && !startsWithWord(text, "module") && !startsWithWord(text, "require") &&
+            !startsWithWord(text, "require_relative")) {
+            // e.g. a top-level local that a later chunk could read, or the contents of a multi-line string.
+            return {};
+        }
+        if (pendingCut.has_value()) {
+            boundaries.emplace_back(*pendingCut);
+            chunkStartLine = pendingCutLine;
+            pendingCut = nullopt;
+        }
+    }
+    if (boundaries.size() < 2) {
+        return {};
+    }
+    boundaries.emplace_back(source.size());
+    return boundaries;
+}
+
+namespace {
+unique_ptr<Node> parseRange(core::GlobalState &gs, core::FileRef file, u4 begin, u4 end,
+                            ruby_parser::diagnostics_t &diagnostics) {
+    Builder builder(gs, file, begin);
+    auto source = file.data(gs).source().substr(begin, end - begin);
+    ruby_parser::typedruby25 driver(string(source.begin(), source.end()), Builder::interface);
+    auto ast = unique_ptr<Node>(builder.build(&driver));
+    diagnostics = move(driver.diagnostics);
+    return ast;
+}
+} // namespace
+
+unique_ptr<Node> Parser::runChunk(core::GlobalState &gs, core::FileRef file, u4 begin, u4 end) {
+    ruby_parser::diagnostics_t diagnostics;
+    auto ast = parseRange(gs, file, begin, end, diagnostics);
+    for (auto &diag : diagnostics) {
+        if (diag.level() == ruby_parser::dlevel::ERROR || diag.level() == ruby_parser::dlevel::FATAL) {
+            return nullptr;
+        }
+    }
+    return ast;
+}
+
+unique_ptr<Node> Parser::runChunks(core::GlobalState &gs, core::FileRef file, const vector<u4> &boundaries) {
+    vector<unique_ptr<Node>> chunks;
+    for (int i = 0; i + 1 < boundaries.size(); i++) {
+        ruby_parser::diagnostics_t diagnostics;
+        auto ast = parseRange(gs, file, boundaries[i], boundaries[i + 1], diagnostics);
+        ErrorToError::run(gs, file, move(diagnostics), boundaries[i]);
+        if (ast != nullptr) {
+            chunks.emplace_back(move(ast));
+        }
+    }
+    if (chunks.empty()) {
+        core::Loc loc(file, 0, 0);
+        NodeVec empty;
+        return make_unique<Begin>(loc, std::move(empty));
+    }
+    return joinChunks(move(chunks));
+}
+
+unique_ptr<Node> Parser::joinChunks(vector<unique_ptr<Node>> chunks) {
+    NodeVec stmts;
+    for (auto &chunk : chunks) {
+        // A chunk with several statements is a Begin of them, like a file with several statements.
+        if (auto *begin = parser::cast_node<Begin>(chunk.get())) {
+            for (auto &stmt : begin->stmts) {
+                stmts.emplace_back(std::move(stmt));
+            }
+        } else {
+            stmts.emplace_back(std::move(chunk));
+        }
+    }
+    auto loc = stmts.front()->loc.join(stmts.back()->loc);
+    return make_unique<Begin>(loc, std::move(stmts));
+}
+
 }; // namespace sorbet::parser
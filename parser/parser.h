@@ -9,6 +9,21 @@ class Parser final {
 public:
     static std::unique_ptr<Node> run(core::GlobalState &gs, core::FileRef file);
     static std::unique_ptr<Node> run(core::GlobalState &gs, std::string_view path, std::string_view src);
+
+    // Offsets at which `source` can be cut into chunks of at least `linesPerChunk` lines that parse on their own,
+    // starting with 0 and ending with the size of `source`. Empty unless that makes at least two chunks. This is a
+    // scan of the lines, not a parse: it only cuts files in which every line that starts in the first column opens or
+    // closes a class or module, is a comment or is a require, and cuts them after the lines that close one.
+    static std::vector<u4> chunkBoundaries(std::string_view source, u4 linesPerChunk);
+    // Parses the source of `file` from `begin` to `end`, with locs into the whole file. Returns nullptr, and reports
+    // nothing, if that source has parse errors or no statements: the whole file should be parsed instead.
+    static std::unique_ptr<Node> runChunk(core::GlobalState &gs, core::FileRef file, u4 begin, u4 end);
+    // Parses each chunk between `boundaries` on its own, and reports their parse errors like run does. A syntax error
+    // then only changes the tree of the chunk it is in, instead of what the parser recovers for the rest of the file.
+    static std::unique_ptr<Node> runChunks(core::GlobalState &gs, core::FileRef file,
+                                           const std::vector<u4> &boundaries);
+    // The tree the whole file parses to, from the trees of its chunks in order.
+    static std::unique_ptr<Node> joinChunks(std::vector<std::unique_ptr<Node>> chunks);
 };
 
 } // namespace sorbet::parser
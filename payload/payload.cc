@@ -1,25 +1,125 @@
 #include "payload/payload.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "common/FileOps.h"
 #include "common/Timer.h"
 #include "common/concurrency/WorkerPool.h"
+#include "common/crypto_hashing/crypto_hashing.h"
+#include "common/os/os.h"
 #include "core/Unfreeze.h"
 #include "core/serialize/serialize.h"
 #include "main/pipeline/pipeline.h"
 #include "payload/binary/binary.h"
 #include "payload/text/text.h"
+#include <cstdio>
+#include <unistd.h>
 
 using namespace std;
 
 namespace sorbet::payload {
 
 constexpr string_view GLOBAL_STATE_KEY = "GlobalState"sv;
+// With --cache-dir, the cached GlobalState is also written uncompressed to a file of the cache directory that is named
+// after its contents, and this key names that file. Every process that shares the cache maps the file and reads its
+// names and payload sources in place, so that they all share one copy of them in the page cache instead of each
+// decoding its own onto the heap. The copy in the KeyValueStore is only read when the file is gone.
+//
+// The file lives beside the database rather than in it, so --max-cache-size-mb neither counts nor evicts it. There is
+// only ever one: writing a new state removes the file of the previous one.
+constexpr string_view GLOBAL_STATE_FILE_KEY = "GlobalStateFile"sv;
+// A hash of the cached GlobalState, which names it to the remote cache. Only machines that start from the same state
+// can decode each other's trees, as those refer to its names by id.
+constexpr string_view GLOBAL_STATE_HASH_KEY = "GlobalStateHash"sv;
+
+namespace {
+string globalStatePath(const realmain::options::Options &options, string_view name) {
+    return absl::StrCat(options.cacheDir, "/", name);
+}
+
+bool loadMappedGlobalState(core::GlobalState &gs, const realmain::options::Options &options, KeyValueStore &kvstore) {
+    auto name = string(kvstore.readString(GLOBAL_STATE_FILE_KEY));
+    if (name.empty()) {
+        return false;
+    }
+    shared_ptr<MappedFile> mapped;
+    try {
+        mapped = FileOps::readMapped(globalStatePath(options, name));
+    } catch (FileNotFoundException &) {
+        // e.g. replaced by another process since this one opened the cache.
+        return false;
+    }
+    if (mapped->contents().empty()) {
+        return false;
+    }
+    Timer timeit(gs.tracer(), "read_global_state.mapped");
+    core::serialize::Serializer::loadGlobalState(gs, (const u1 *)mapped->contents().data(), true);
+    // Like the payload compiled into the binary, the mapping has to outlive every GlobalState copied from this one.
+    intentionallyLeakMemory(new shared_ptr<MappedFile>(move(mapped)));
+    return true;
+}
+
+void loadRbiBundle(core::GlobalState &gs, const realmain::options::Options &options) {
+    auto mapped = FileOps::readMapped(options.rbiBundle);
+    if (mapped->contents().empty()) {
+        Exception::raise("Empty --rbi-bundle: {}", options.rbiBundle);
+    }
+    Timer timeit(gs.tracer(), "read_global_state.rbi_bundle");
+    core::serialize::Serializer::loadGlobalState(gs, (const u1 *)mapped->contents().data(), true);
+    // Like the payload compiled into the binary, the mapping has to outlive every GlobalState copied from this one.
+    intentionallyLeakMemory(new shared_ptr<MappedFile>(move(mapped)));
+}
+
+// Lets `kvstore` share what it caches with the machines that start from the state identified by `scope`.
+void shareCacheWith(unique_ptr<KeyValueStore> &kvstore, const realmain::options::Options &options, string scope) {
+    // The language server keeps entering names into the state it indexes files with, but never stores that state, so
+    // nothing identifies what its cached trees have to be decoded with.
+    if (kvstore && !options.runLSP) {
+        kvstore->setRemoteScope(move(scope));
+    }
+}
+
+// Written under a temporary name first, so that no process ever maps a state that is only partially written.
+bool writeGlobalStateFile(const string &path, const vector<u1> &data) {
+    auto tempPath = fmt::format("{}.{}.tmp", path, getpid());
+    FILE *fp = fopen(tempPath.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    bool written = fwrite(data.data(), sizeof(u1), data.size(), fp) == data.size();
+    written = fclose(fp) == 0 && written;
+    if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+string rbiBundleVersion(const realmain::options::Options &options) {
+    if (options.rbiBundle.empty()) {
+        return "";
+    }
+    // Cached trees refer to the names of the state they were indexed in, so they are only good with the same bundle.
+    auto mapped = FileOps::readMapped(options.rbiBundle);
+    auto hash = crypto_hashing::hash16(mapped->contents());
+    return absl::BytesToHexString(string_view((const char *)hash.data(), hash.size()));
+}
 
 void createInitialGlobalState(unique_ptr<core::GlobalState> &gs, const realmain::options::Options &options,
                               unique_ptr<KeyValueStore> &kvstore) {
     if (kvstore) {
-        auto maybeGsBytes = kvstore->read(GLOBAL_STATE_KEY);
-        if (maybeGsBytes) {
-            Timer timeit(gs->tracer(), "read_global_state.kvstore");
-            core::serialize::Serializer::loadGlobalState(*gs, maybeGsBytes);
+        bool loaded = loadMappedGlobalState(*gs, options, *kvstore);
+        if (!loaded) {
+            auto maybeGsBytes = kvstore->read(GLOBAL_STATE_KEY);
+            if (maybeGsBytes) {
+                Timer timeit(gs->tracer(), "read_global_state.kvstore");
+                core::serialize::Serializer::loadGlobalState(*gs, maybeGsBytes);
+                loaded = true;
+            }
+        }
+        if (loaded) {
+            // Caches written before it was recorded have no hash, and share nothing until they store a new state.
+            shareCacheWith(kvstore, options, string(kvstore->readString(GLOBAL_STATE_HASH_KEY)));
             for (unsigned int i = 1; i < gs->filesUsed(); i++) {
                 core::FileRef fref(i);
                 if (fref.dataAllowingUnsafe(*gs).sourceType == core::File::Type::Normal) {
@@ -29,8 +129,16 @@ void createInitialGlobalState(unique_ptr<core::GlobalState> &gs, const realmain:
             return;
         }
     }
+    if (!options.rbiBundle.empty()) {
+        // The bundle was stored with --store-state, which marked all of its files as payload.
+        loadRbiBundle(*gs, options);
+        // The hash of the bundle is part of the cache version already.
+        shareCacheWith(kvstore, options, "rbi-bundle");
+        return;
+    }
     if (options.noStdlib) {
         gs->initEmpty();
+        shareCacheWith(kvstore, options, "empty");
         return;
     }
 
@@ -54,9 +162,14 @@ void createInitialGlobalState(unique_ptr<core::GlobalState> &gs, const realmain:
         auto indexed = realmain::pipeline::index(gs, payloadFiles, emptyOpts, *workers, kvstore);
         realmain::pipeline::resolve(gs, move(indexed), emptyOpts, *workers); // result is thrown away
         gs->ensureCleanStrings = false;
+        // Indexing the payload on several threads enters its names in an order that differs between runs, so this
+        // state is left unnamed: what is cached against it stays local.
     } else {
         Timer timeit(gs->tracer(), "read_global_state.binary");
-        core::serialize::Serializer::loadGlobalState(*gs, nameTablePayload);
+        // The payload is compiled into the binary, so its names can point straight into it.
+        core::serialize::Serializer::loadGlobalState(*gs, nameTablePayload, true);
+        // The payload is part of the binary, whose version is part of the cache's.
+        shareCacheWith(kvstore, options, "payload");
     }
 }
 
@@ -64,7 +177,28 @@ void retainGlobalState(unique_ptr<core::GlobalState> &gs, const realmain::option
                        unique_ptr<KeyValueStore> &kvstore) {
     if (kvstore && gs->wasModified() && !gs->hadCriticalError()) {
         Timer timeit(gs->tracer(), "write_global_state.kvstore");
-        kvstore->write(GLOBAL_STATE_KEY, core::serialize::Serializer::storePayloadAndNameTable(*gs));
+        auto data = core::serialize::Serializer::storePayloadAndNameTable(*gs, false);
+        auto hash = crypto_hashing::hash16(string_view((const char *)data.data(), data.size()));
+        auto hexHash = absl::BytesToHexString(string_view((const char *)hash.data(), hash.size()));
+        auto name = absl::StrCat("global-state-", hexHash);
+        auto previous = string(kvstore->readString(GLOBAL_STATE_FILE_KEY));
+        auto path = globalStatePath(options, name);
+        // Files are named after their contents, so an existing one already holds exactly this state. The cached trees
+        // refer to the names of this state, so a file of another state must not stay named here.
+        if (FileOps::exists(path) || writeGlobalStateFile(path, data)) {
+            kvstore->writeString(GLOBAL_STATE_FILE_KEY, name);
+        } else {
+            kvstore->writeString(GLOBAL_STATE_FILE_KEY, "");
+        }
+        if (!previous.empty() && previous != name) {
+            // Processes that already mapped it keep their mapping.
+            remove(globalStatePath(options, previous).c_str());
+        }
+        // Only the file is read in place; the fallback copy is kept as small as the other entries.
+        kvstore->write(GLOBAL_STATE_KEY, core::serialize::Serializer::compressGlobalState(data));
+        kvstore->writeString(GLOBAL_STATE_HASH_KEY, hexHash);
+        // The trees this run cached refer to names of this state, so they are uploaded under its hash.
+        shareCacheWith(kvstore, options, hexHash);
         KeyValueStore::commit(move(kvstore));
     }
 }
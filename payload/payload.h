@@ -7,6 +7,9 @@
 
 namespace sorbet::payload {
 
+/** What distinguishes the --rbi-bundle of `options` from others, to be added to the version of the cache. Empty without
+ * one. */
+std::string rbiBundleVersion(const realmain::options::Options &options);
 void createInitialGlobalState(std::unique_ptr<core::GlobalState> &gs, const realmain::options::Options &options,
                               std::unique_ptr<KeyValueStore> &kvstore);
 void retainGlobalState(std::unique_ptr<core::GlobalState> &gs, const realmain::options::Options &options,
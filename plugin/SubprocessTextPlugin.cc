@@ -1,5 +1,8 @@
 #include "plugin/SubprocessTextPlugin.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/str_replace.h"
+#include "absl/synchronization/mutex.h"
 #include "ast/treemap/treemap.h"
 #include "common/Subprocess.h"
 #include "core/errors/plugin.h"
@@ -8,6 +11,112 @@ using namespace std;
 
 namespace sorbet::plugin {
 
+namespace {
+
+// Runs plugin scripts on behalf of a resident Ruby process. Each request is `<size>\n` followed by `size` bytes holding
+// the script path and its arguments, separated by NUL bytes. Each reply is `<status> <size>\n` followed by `size` bytes
+// of whatever the script printed. The script is `load`ed with ARGV set to its arguments, exactly as if Ruby had been
+// started on it, and with its output captured rather than sent to Sorbet. STDOUT itself points at stderr while a
+// script runs, so that stray writes to it can't corrupt the replies.
+constexpr string_view RESIDENT_DRIVER = R"(
+require 'stringio'
+reply = STDOUT.dup
+reply.binmode
+STDOUT.reopen(STDERR)
+STDIN.binmode
+while (header = STDIN.gets)
+  script, *args = STDIN.read(Integer(header)).split("\0", -1)
+  captured = StringIO.new
+  ok = true
+  begin
+    $stdout = captured
+    ARGV.replace(args)
+    load(script, true)
+  rescue SystemExit => e
+    ok = e.success?
+  rescue Exception => e
+    STDERR.puts("#{e.class}: #{e.message}")
+    ok = false
+  ensure
+    $stdout = STDOUT
+  end
+  output = captured.string
+  reply.write("#{ok ? 0 : 1} #{output.bytesize}\n", output)
+  reply.flush
+end
+)";
+
+// Every worker talks to its own resident process, which lives as long as the worker does.
+thread_local unique_ptr<ResidentSubprocess> residentRuby;
+
+// Output of earlier resident plugin calls, by request. Plugins in resident mode promise that their output only depends
+// on their arguments, so identical calls (common with per-model DSLs) run once per Sorbet process.
+constexpr size_t MAX_CACHED_RESPONSES = 1 << 16;
+absl::Mutex responseCacheMutex;
+UnorderedMap<string, optional<string>> responseCache GUARDED_BY(responseCacheMutex);
+
+optional<string> callResident(const core::GlobalState &gs, const string &request) {
+    if (!residentRuby) {
+        vector<string> args(gs.dslRubyExtraArgs);
+        args.emplace_back("-e");
+        args.emplace_back(RESIDENT_DRIVER);
+        residentRuby = ResidentSubprocess::spawn("ruby", move(args));
+        if (!residentRuby) {
+            return nullopt;
+        }
+    }
+    optional<string> header;
+    if (residentRuby->write(fmt::format("{}\n", request.size())) && residentRuby->write(request)) {
+        header = residentRuby->readUntil('\n');
+    }
+    string_view status, size;
+    if (header) {
+        auto space = header->find(' ');
+        if (space != string::npos) {
+            status = string_view(*header).substr(0, space);
+            size = string_view(*header).substr(space + 1);
+        }
+    }
+    optional<string> output;
+    u4 outputSize;
+    if (!size.empty() && absl::SimpleAtoi(size, &outputSize)) {
+        output = residentRuby->readExactly(outputSize);
+    }
+    if (!output) {
+        // The process died or broke protocol; start a fresh one for the next call.
+        residentRuby = nullptr;
+        return nullopt;
+    }
+    if (status != "0") {
+        return nullopt;
+    }
+    return output;
+}
+
+optional<string> runResident(const core::GlobalState &gs, const vector<string> &args) {
+    auto request = absl::StrJoin(args, string_view("\0", 1));
+    {
+        absl::ReaderMutexLock lock(&responseCacheMutex);
+        auto it = responseCache.find(request);
+        if (it != responseCache.end()) {
+            prodCounterInc("plugin.resident.cache_hit");
+            return it->second;
+        }
+    }
+    prodCounterInc("plugin.resident.cache_miss");
+    auto output = callResident(gs, request);
+    {
+        absl::MutexLock lock(&responseCacheMutex);
+        if (responseCache.size() >= MAX_CACHED_RESPONSES) {
+            responseCache.clear();
+        }
+        responseCache.emplace(move(request), output);
+    }
+    return output;
+}
+
+} // namespace
+
 struct Namespace {
     enum NamespaceType { Class, Module };
     NamespaceType type;
@@ -68,7 +177,10 @@ struct SpawningWalker {
                 string_view shortName = send->fun.data(ctx)->shortName(ctx);
                 string sendSource = send->loc.source(ctx);
 
-                vector<string> args(ctx.state.dslRubyExtraArgs);
+                vector<string> args;
+                if (!ctx.state.dslResidentPlugins) {
+                    args = ctx.state.dslRubyExtraArgs;
+                }
                 args.emplace_back(*command);
                 args.emplace_back("--class");
                 args.emplace_back(move(className));
@@ -77,7 +189,11 @@ struct SpawningWalker {
                 args.emplace_back("--source");
                 args.emplace_back(move(sendSource));
 
-                output = Subprocess::spawn("ruby", move(args));
+                if (ctx.state.dslResidentPlugins) {
+                    output = runResident(ctx.state, args);
+                } else {
+                    output = Subprocess::spawn("ruby", move(args));
+                }
             }
 
             if (output) {
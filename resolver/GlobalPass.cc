@@ -1,4 +1,6 @@
 #include "common/Timer.h"
+#include "common/concurrency/ConcurrentQueue.h"
+#include "core/ErrorQueue.h"
 #include "core/Names.h"
 #include "core/core.h"
 #include "core/errors/resolver.h"
@@ -151,11 +153,11 @@ void resolveTypeMembers(core::GlobalState &gs, core::SymbolRef sym,
 
 }; // namespace
 
-void Resolver::finalizeAncestors(core::GlobalState &gs) {
+void Resolver::finalizeAncestors(core::GlobalState &gs, u4 firstSymbol) {
     Timer timer(gs.errorQueue->logger, "resolver.finalize_ancestors");
     int methodCount = 0;
     int classCount = 0;
-    for (int i = 1; i < gs.symbolsUsed(); ++i) {
+    for (int i = firstSymbol; i < gs.symbolsUsed(); ++i) {
         auto ref = core::SymbolRef(&gs, i);
         auto loc = ref.data(gs)->loc();
         if (loc.file().exists() && loc.file().data(gs).sourceType == core::File::Type::Normal) {
@@ -210,8 +212,10 @@ void Resolver::finalizeAncestors(core::GlobalState &gs) {
         }
     }
 
-    prodCounterAdd("types.input.classes.total", classCount);
-    prodCounterAdd("types.input.methods.total", methodCount);
+    if (firstSymbol == 1) {
+        prodCounterAdd("types.input.classes.total", classCount);
+        prodCounterAdd("types.input.methods.total", methodCount);
+    }
 }
 
 struct ParentLinearizationInformation {
@@ -325,9 +329,182 @@ InlinedVector<core::SymbolRef, 4> ParentLinearizationInformation::fullLinearizat
     return res;
 }
 
-void computeLinearization(core::GlobalState &gs) {
+constexpr int LINEARIZATION_UNVISITED = -1;
+constexpr int LINEARIZATION_IN_PROGRESS = -2;
+constexpr int LINEARIZATION_CYCLE = -3;
+constexpr int LINEARIZATION_COMPUTED = -4;
+// Hierarchies smaller than this are linearized serially; levels smaller than this are linearized on the main thread.
+constexpr int PARALLEL_LINEARIZATION_MIN_CLASSES = 1024;
+constexpr int LINEARIZATION_CHUNK_SIZE = 256;
+
+// Computes the depth of `ofClass` in the ancestor DAG, counting only classes that still need to be linearized: a class
+// at level N only depends on classes at levels below N. Returns LINEARIZATION_CYCLE if the ancestors contain a loop.
+int linearizationLevel(const core::GlobalState &gs, core::SymbolRef ofClass, vector<int> &levels) {
+    auto level = levels[ofClass._id];
+    if (level != LINEARIZATION_UNVISITED) {
+        return level == LINEARIZATION_IN_PROGRESS ? LINEARIZATION_CYCLE : level;
+    }
+    auto data = ofClass.data(gs);
+    if (data->isClassLinearizationComputed()) {
+        // Nothing to wait for, so anything depending on it can go in level 0.
+        return levels[ofClass._id] = LINEARIZATION_COMPUTED;
+    }
+    levels[ofClass._id] = LINEARIZATION_IN_PROGRESS;
+    level = 0;
+    // Stub mixins are never linearized through, but their flags are still read, so they count as dependencies too.
+    auto dependOn = [&](core::SymbolRef dep) -> bool {
+        auto depLevel = linearizationLevel(gs, dep, levels);
+        level = max(level, depLevel + 1);
+        return depLevel != LINEARIZATION_CYCLE;
+    };
+    bool acyclic = !data->superClass().exists() || dependOn(data->superClass());
+    for (auto mixin : data->mixins()) {
+        acyclic = acyclic && dependOn(mixin);
+    }
+    return levels[ofClass._id] = acyclic ? level : LINEARIZATION_CYCLE;
+}
+
+// Records, in the order the serial walk in computeLinearization would report them, the classes that report
+// IncludesNonModule, once per offending mixin.
+void recordLinearizationErrorOrder(const core::GlobalState &gs, core::SymbolRef ofClass, vector<bool> &visited,
+                                   vector<core::SymbolRef> &order) {
+    if (visited[ofClass._id]) {
+        return;
+    }
+    visited[ofClass._id] = true;
+    auto data = ofClass.data(gs);
+    if (data->superClass().exists()) {
+        recordLinearizationErrorOrder(gs, data->superClass(), visited, order);
+    }
+    for (auto mixin : data->mixins()) {
+        if (mixin == data->superClass() || mixin.data(gs)->superClass() == core::Symbols::StubSuperClass() ||
+            mixin.data(gs)->superClass() == core::Symbols::StubModule()) {
+            continue;
+        }
+        recordLinearizationErrorOrder(gs, mixin, visited, order);
+        if (!mixin.data(gs)->isClassModule() && mixin != core::Symbols::BasicObject()) {
+            order.emplace_back(ofClass);
+        }
+    }
+}
+
+struct LinearizationChunkResult {
+    vector<pair<core::SymbolRef, vector<core::ErrorQueueMessage>>> errors;
+};
+
+void linearizeChunk(core::GlobalState &gs, const vector<core::SymbolRef> &level, size_t begin, size_t end,
+                    LinearizationChunkResult &out) {
+    for (auto i = begin; i < end; i++) {
+        core::ErrorBuffer errors;
+        computeLinearization(gs, level[i]);
+        if (!errors.messages.empty()) {
+            out.errors.emplace_back(level[i], move(errors.messages));
+        }
+    }
+}
+
+// Linearizes the hierarchy level by level, fanning each level out across `workers`. Within a level no class depends
+// on another, and everything a class reads was written by an earlier level, so each class only ever writes its own
+// symbol. Errors are held back and reported afterwards in the order the serial walk would have produced them.
+bool computeLinearizationInParallel(core::GlobalState &gs, WorkerPool &workers) {
+    vector<int> levelOf(gs.symbolsUsed(), LINEARIZATION_UNVISITED);
+    vector<vector<core::SymbolRef>> levels;
+    for (int i = 1; i < gs.symbolsUsed(); ++i) {
+        auto sym = core::SymbolRef(&gs, i);
+        if (!sym.data(gs)->isClass()) {
+            continue;
+        }
+        auto level = linearizationLevel(gs, sym, levelOf);
+        if (level == LINEARIZATION_CYCLE) {
+            // Let the serial walk report the loop.
+            return false;
+        }
+        if (level >= 0) {
+            if (levels.size() <= (size_t)level) {
+                levels.resize(level + 1);
+            }
+            levels[level].emplace_back(sym);
+        }
+    }
+
+    vector<core::SymbolRef> errorOrder;
+    {
+        vector<bool> visited(gs.symbolsUsed(), false);
+        for (int i = 1; i < gs.symbolsUsed(); ++i) {
+            // Neither classes that were already linearized nor non-classes report anything.
+            if (levelOf[i] < 0) {
+                visited[i] = true;
+            }
+        }
+        for (int i = 1; i < gs.symbolsUsed(); ++i) {
+            if (!visited[i]) {
+                recordLinearizationErrorOrder(gs, core::SymbolRef(&gs, i), visited, errorOrder);
+            }
+        }
+    }
+
+    UnorderedMap<u4, vector<core::ErrorQueueMessage>> errors;
+    for (auto &level : levels) {
+        if (level.size() < PARALLEL_LINEARIZATION_MIN_CLASSES) {
+            LinearizationChunkResult result;
+            linearizeChunk(gs, level, 0, level.size(), result);
+            for (auto &[sym, messages] : result.errors) {
+                errors[sym._id] = move(messages);
+            }
+            continue;
+        }
+        auto chunkCount = (level.size() + LINEARIZATION_CHUNK_SIZE - 1) / LINEARIZATION_CHUNK_SIZE;
+        auto chunkq = make_shared<ConcurrentBoundedQueue<size_t>>(chunkCount);
+        auto resultq = make_shared<BlockingBoundedQueue<LinearizationChunkResult>>(chunkCount);
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            chunkq->push(size_t(chunk), 1);
+        }
+        workers.multiplexJob("computeLinearization", [&gs, &level, chunkq, resultq]() {
+            size_t chunk;
+            for (auto result = chunkq->try_pop(chunk); !result.done(); result = chunkq->try_pop(chunk)) {
+                if (result.gotItem()) {
+                    LinearizationChunkResult out;
+                    linearizeChunk(gs, level, chunk * LINEARIZATION_CHUNK_SIZE,
+                                   min(level.size(), (chunk + 1) * LINEARIZATION_CHUNK_SIZE), out);
+                    resultq->push(move(out), 1);
+                }
+            }
+        });
+        LinearizationChunkResult out;
+        for (auto result = resultq->wait_pop_timed(out, WorkerPool::BLOCK_INTERVAL(), gs.tracer()); !result.done();
+             result = resultq->wait_pop_timed(out, WorkerPool::BLOCK_INTERVAL(), gs.tracer())) {
+            if (result.gotItem()) {
+                for (auto &[sym, messages] : out.errors) {
+                    errors[sym._id] = move(messages);
+                }
+            }
+        }
+    }
+
+    // Every recorded error of a class shares its location and error class, so either all of them made it into its
+    // buffer or none did, and they are in mixin order.
+    UnorderedMap<u4, size_t> reported;
+    for (auto sym : errorOrder) {
+        auto fnd = errors.find(sym._id);
+        if (fnd == errors.end()) {
+            continue;
+        }
+        auto &next = reported[sym._id];
+        ENFORCE(next < fnd->second.size());
+        vector<core::ErrorQueueMessage> one;
+        one.emplace_back(move(fnd->second[next++]));
+        gs.errorQueue->pushBuffered(move(one));
+    }
+    return true;
+}
+
+void computeLinearization(core::GlobalState &gs, WorkerPool &workers) {
     Timer timer(gs.errorQueue->logger, "resolver.compute_linearization");
 
+    if (gs.symbolsUsed() >= PARALLEL_LINEARIZATION_MIN_CLASSES && computeLinearizationInParallel(gs, workers)) {
+        return;
+    }
+
     // TODO: this does not support `prepend`
     for (int i = 1; i < gs.symbolsUsed(); ++i) {
         const auto &data = core::SymbolRef(&gs, i).data(gs);
@@ -338,14 +515,8 @@ void computeLinearization(core::GlobalState &gs) {
     }
 }
 
-void Resolver::finalizeSymbols(core::GlobalState &gs) {
-    Timer timer(gs.errorQueue->logger, "resolver.finalize_resolution");
-    // TODO(nelhage): Properly this first loop should go in finalizeAncestors,
-    // but we currently compute mixes_in_class_methods during the same AST walk
-    // that resolves types and we don't want to introduce additional passes if
-    // we don't have to. It would be a tractable refactor to merge it
-    // `ResolveConstantsWalk` if it becomes necessary to process earlier.
-    for (int i = 1; i < gs.symbolsUsed(); ++i) {
+void Resolver::finalizeClassMethods(core::GlobalState &gs, u4 firstSymbol) {
+    for (int i = firstSymbol; i < gs.symbolsUsed(); ++i) {
         auto sym = core::SymbolRef(&gs, i);
         if (!sym.data(gs)->isClass()) {
             continue;
@@ -363,19 +534,66 @@ void Resolver::finalizeSymbols(core::GlobalState &gs) {
             singleton.data(gs)->mixins().emplace_back(classMethods);
         }
     }
+}
 
-    computeLinearization(gs);
-
+void Resolver::finalizeTypeMembers(core::GlobalState &gs, u4 firstSymbol) {
     vector<vector<pair<core::SymbolRef, core::SymbolRef>>> typeAliases;
     typeAliases.resize(gs.symbolsUsed());
     vector<bool> resolved;
     resolved.resize(gs.symbolsUsed());
     for (int i = 1; i < gs.symbolsUsed(); ++i) {
         auto sym = core::SymbolRef(&gs, i);
-        if (sym.data(gs)->isClass()) {
+        if (!sym.data(gs)->isClass()) {
+            continue;
+        }
+        if (i < firstSymbol) {
+            // Done before, and reported then. Only the aliases it records are needed again, by the newer classes.
+            core::ErrorProbe alreadyReported;
+            resolveTypeMembers(gs, sym, typeAliases, resolved);
+        } else {
             resolveTypeMembers(gs, sym, typeAliases, resolved);
         }
     }
 }
 
+void Resolver::finalizeSymbols(core::GlobalState &gs, WorkerPool &workers) {
+    Timer timer(gs.errorQueue->logger, "resolver.finalize_resolution");
+    // TODO(nelhage): Properly this first loop should go in finalizeAncestors,
+    // but we currently compute mixes_in_class_methods during the same AST walk
+    // that resolves types and we don't want to introduce additional passes if
+    // we don't have to. It would be a tractable refactor to merge it
+    // `ResolveConstantsWalk` if it becomes necessary to process earlier.
+    finalizeClassMethods(gs, 1);
+
+    computeLinearization(gs, workers);
+    {
+        Timer timer(gs.errorQueue->logger, "resolver.ancestor_index");
+        gs.ancestorIndex = core::AncestorIndex::build(gs);
+    }
+
+    finalizeTypeMembers(gs, 1);
+}
+
+void Resolver::finalizeNewSymbols(core::GlobalState &gs, u4 firstNewSymbol) {
+    bool sawNewClass = false;
+    for (u4 i = firstNewSymbol; i < gs.symbolsUsed() && !sawNewClass; ++i) {
+        const auto &data = core::SymbolRef(&gs, i).data(gs);
+        sawNewClass = data->isClass() && !data->ignoreInHashing(gs);
+    }
+    if (!sawNewClass) {
+        return;
+    }
+    Timer timer(gs.errorQueue->logger, "resolver.finalize_new_symbols");
+    finalizeAncestors(gs, firstNewSymbol);
+    finalizeClassMethods(gs, firstNewSymbol);
+    // The classes from before keep their ancestors, so only the new ones need a linearization.
+    for (u4 i = firstNewSymbol; i < gs.symbolsUsed(); ++i) {
+        if (core::SymbolRef(&gs, i).data(gs)->isClass()) {
+            computeLinearization(gs, core::SymbolRef(&gs, i));
+        }
+    }
+    gs.ancestorIndex = core::AncestorIndex::build(gs);
+    finalizeTypeMembers(gs, firstNewSymbol);
+}
+
 } // namespace sorbet::resolver
@@ -3,9 +3,12 @@
 #include "ast/Trees.h"
 #include "ast/ast.h"
 #include "ast/treemap/treemap.h"
+#include "ast/treemap/treewalk.h"
 #include "core/Error.h"
+#include "core/ErrorQueue.h"
 #include "core/Names.h"
 #include "core/StrictLevel.h"
+#include "core/ThreadLocalCache.h"
 #include "core/core.h"
 #include "resolver/resolver.h"
 #include "resolver/type_syntax.h"
@@ -80,11 +83,65 @@ private:
     struct Nesting {
         const shared_ptr<Nesting> parent;
         const core::SymbolRef scope;
-
-        Nesting(shared_ptr<Nesting> parent, core::SymbolRef scope) : parent(std::move(parent)), scope(scope) {}
+        // Identifies the chain of scopes from here to the root, so that the nestings of different files can be told
+        // apart cheaply in LhsLookupCache.
+        const u8 chainHash;
+
+        Nesting(shared_ptr<Nesting> parent, core::SymbolRef scope)
+            : parent(std::move(parent)), scope(scope),
+              chainHash(mixHash(this->parent == nullptr ? 0 : this->parent->chainHash, scope._id)) {}
+
+        // Whether both nestings are made of the same scopes.
+        static bool sameChain(const Nesting *a, const Nesting *b) {
+            while (a != nullptr && b != nullptr) {
+                if (a == b) {
+                    return true;
+                }
+                if (a->scope != b->scope) {
+                    return false;
+                }
+                a = a->parent.get();
+                b = b->parent.get();
+            }
+            return a == b;
+        }
     };
     shared_ptr<Nesting> nesting_;
 
+    static u8 mixHash(u8 acc, u8 value) {
+        return (acc ^ value) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    struct LhsLookupEntry {
+        shared_ptr<Nesting> nesting;
+        core::NameRef name;
+        core::SymbolRef result;
+    };
+
+    /**
+     * While alive, the constructing thread remembers what resolveLhs found for a (nesting, name) pair, so that the
+     * same constant referenced from many files of one namespace is only looked up once. What resolveLhs finds only
+     * depends on the symbol table, so this is valid while that doesn't change: for the whole tree walk, and for one
+     * round of the fixed point.
+     *
+     * Entries are keyed by a hash of the nesting's scopes and the name. An entry for another pair with that hash is
+     * replaced.
+     */
+    class LhsLookupCache final : public core::ThreadLocalCache<LhsLookupCache, u8, LhsLookupEntry, 1 << 16> {
+    public:
+        optional<core::SymbolRef> find(const shared_ptr<Nesting> &nesting, core::NameRef name) const {
+            auto *entry = lookup(mixHash(nesting->chainHash, name._id));
+            if (entry == nullptr || entry->name != name || !Nesting::sameChain(entry->nesting.get(), nesting.get())) {
+                return nullopt;
+            }
+            return entry->result;
+        }
+
+        void insert(const shared_ptr<Nesting> &nesting, core::NameRef name, core::SymbolRef result) {
+            store(mixHash(nesting->chainHash, name._id), LhsLookupEntry{nesting, name, result});
+        }
+    };
+
     struct ResolutionItem {
         shared_ptr<Nesting> scope;
         ast::ConstantLit *out;
@@ -139,7 +196,8 @@ private:
     vector<ClassAliasResolutionItem> todoClassAliases_;
     vector<TypeAliasResolutionItem> todoTypeAliases_;
 
-    static core::SymbolRef resolveLhs(core::Context ctx, shared_ptr<Nesting> nesting, core::NameRef name) {
+    static core::SymbolRef resolveLhsUncached(core::Context ctx, const shared_ptr<Nesting> &nesting,
+                                              core::NameRef name) {
         Nesting *scope = nesting.get();
         while (scope != nullptr) {
             auto lookup = scope->scope.data(ctx)->findMember(ctx, name);
@@ -151,6 +209,19 @@ private:
         return nesting->scope.data(ctx)->findMemberTransitive(ctx, name);
     }
 
+    static core::SymbolRef resolveLhs(core::Context ctx, shared_ptr<Nesting> nesting, core::NameRef name) {
+        auto *cache = LhsLookupCache::current();
+        if (cache == nullptr) {
+            return resolveLhsUncached(ctx, nesting, name);
+        }
+        if (auto cached = cache->find(nesting, name)) {
+            return *cached;
+        }
+        auto result = resolveLhsUncached(ctx, nesting, name);
+        cache->insert(nesting, name, result);
+        return result;
+    }
+
     static bool isAlreadyResolved(core::Context ctx, const ast::ConstantLit &original) {
         auto sym = original.symbol;
         if (!sym.exists()) {
@@ -278,28 +349,115 @@ private:
         job.out->resolutionScope = scope;
     }
 
-    static bool resolveJob(core::Context ctx, ResolutionItem &job) {
+    // Computes what `job` resolves to given the current state, without writing it back to the tree. Returns
+    // noSymbol if the job can't be resolved yet.
+    static core::SymbolRef tryResolveJob(core::Context ctx, const ResolutionItem &job) {
         if (isAlreadyResolved(ctx, *job.out)) {
-            return true;
+            return job.out->symbol;
         }
         auto resolved = resolveConstant(ctx.withOwner(job.scope->scope), job.scope, job.out->original);
         if (!resolved.exists()) {
-            return false;
+            return core::Symbols::noSymbol();
         }
-        if (resolved.data(ctx)->isTypeAlias()) {
-            if (resolved.data(ctx)->resultType != nullptr) {
-                // A TypeAliasResolutionItem job completed successfully,
-                // or we forced the type alias this constant refers to to resolve.
-                job.out->symbol = resolved;
-                return true;
-            }
-            return false;
+        if (resolved.data(ctx)->isTypeAlias() && resolved.data(ctx)->resultType == nullptr) {
+            // Only resolved once a TypeAliasResolutionItem job completed successfully,
+            // or we forced the type alias this constant refers to to resolve.
+            return core::Symbols::noSymbol();
         }
+        return resolved;
+    }
 
+    static bool resolveJob(core::Context ctx, ResolutionItem &job) {
+        auto resolved = tryResolveJob(ctx, job);
+        if (!resolved.exists()) {
+            return false;
+        }
         job.out->symbol = resolved;
         return true;
     }
 
+    // Below this many pending constants a round of the fixed point is cheaper to run serially.
+    static constexpr size_t PARALLEL_RESOLVE_MIN_JOBS = 2048;
+    static constexpr size_t PARALLEL_RESOLVE_CHUNK_SIZE = 256;
+
+    // Runs one round of resolveJob over `todo`, returning for every job whether it got resolved. Produces exactly
+    // the symbols and errors that running resolveJob over `todo` in order would.
+    //
+    // Resolving constants only reads GlobalState, so every job is first evaluated in parallel against the state at
+    // the start of the round, with its errors held back. The only thing a job can observe from jobs before it in
+    // the same round is its scope's ConstantLit, as that is another job's output. The merge therefore walks the
+    // jobs in order, applying the speculative result unless the job's scope was resolved earlier in this round, in
+    // which case the job is evaluated again on the spot.
+    static vector<bool> resolveJobsRound(core::Context ctx, vector<ResolutionItem> &todo, WorkerPool &workers) {
+        LhsLookupCache lhsLookupCache;
+        vector<bool> done(todo.size(), false);
+        if (todo.size() < PARALLEL_RESOLVE_MIN_JOBS) {
+            for (size_t i = 0; i < todo.size(); i++) {
+                done[i] = resolveJob(ctx, todo[i]);
+            }
+            return done;
+        }
+
+        vector<core::SymbolRef> speculative(todo.size());
+        vector<vector<core::ErrorQueueMessage>> bufferedErrors(todo.size());
+        auto chunkCount = (todo.size() + PARALLEL_RESOLVE_CHUNK_SIZE - 1) / PARALLEL_RESOLVE_CHUNK_SIZE;
+        auto chunkq = make_shared<ConcurrentBoundedQueue<size_t>>(chunkCount);
+        auto resultq = make_shared<BlockingBoundedQueue<size_t>>(chunkCount);
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            chunkq->push(size_t(chunk), 1);
+        }
+
+        const auto &jobs = todo;
+        workers.multiplexJob("resolveConstantsRound", [ctx, chunkq, resultq, &jobs, &speculative, &bufferedErrors]() {
+            LhsLookupCache lhsLookupCache;
+            size_t chunk;
+            size_t processed = 0;
+            for (auto result = chunkq->try_pop(chunk); !result.done(); result = chunkq->try_pop(chunk)) {
+                if (!result.gotItem()) {
+                    continue;
+                }
+                auto end = min(jobs.size(), (chunk + 1) * PARALLEL_RESOLVE_CHUNK_SIZE);
+                for (auto i = chunk * PARALLEL_RESOLVE_CHUNK_SIZE; i < end; i++) {
+                    core::ErrorBuffer errors;
+                    speculative[i] = tryResolveJob(ctx, jobs[i]);
+                    bufferedErrors[i] = move(errors.messages);
+                }
+                processed++;
+            }
+            if (processed > 0) {
+                resultq->push(size_t(processed), processed);
+            }
+        });
+        {
+            size_t processed;
+            for (auto result = resultq->wait_pop_timed(processed, WorkerPool::BLOCK_INTERVAL(), ctx.state.tracer());
+                 !result.done();
+                 result = resultq->wait_pop_timed(processed, WorkerPool::BLOCK_INTERVAL(), ctx.state.tracer())) {
+            }
+        }
+
+        UnorderedSet<const ast::ConstantLit *> resolvedThisRound;
+        for (size_t i = 0; i < todo.size(); i++) {
+            auto &job = todo[i];
+            auto *scope = ast::cast_tree<ast::ConstantLit>(job.out->original->scope.get());
+            core::SymbolRef resolved;
+            if (scope != nullptr && resolvedThisRound.contains(scope)) {
+                // The speculative result (and whatever errors it buffered) is stale; redo the job as the serial
+                // loop would have seen it.
+                resolved = tryResolveJob(ctx, job);
+            } else {
+                ctx.state.errorQueue->pushBuffered(move(bufferedErrors[i]));
+                resolved = speculative[i];
+            }
+            if (resolved.exists()) {
+                job.out->symbol = resolved;
+                resolvedThisRound.insert(job.out);
+                done[i] = true;
+            }
+        }
+        return done;
+    }
+
     static bool resolveTypeAliasJob(core::MutableContext ctx, TypeAliasResolutionItem &job) {
         core::SymbolRef enclosingTypeMember;
         core::SymbolRef enclosingClass = job.lhs.data(ctx)->enclosingClass(ctx);
@@ -635,6 +793,7 @@ public:
 
         workers.multiplexJob("resolveConstantsWalk", [ictx, fileq, resultq]() {
             Timer timeit(ictx.state.tracer(), "ResolveConstantsWorker");
+            LhsLookupCache lhsLookupCache;
             ResolveConstantsWalk constants(ictx);
             vector<ast::ParsedFile> partiallyResolvedTrees;
             ast::ParsedFile job;
@@ -717,9 +876,17 @@ public:
             {
                 Timer timeit(ctx.state.errorQueue->logger, "resolver.resolve_constants.fixed_point.constants");
                 int origSize = todo.size();
-                auto it = remove_if(todo.begin(), todo.end(),
-                                    [ctx](ResolutionItem &job) -> bool { return resolveJob(ctx, job); });
-                todo.erase(it, todo.end());
+                auto done = resolveJobsRound(ctx, todo, workers);
+                size_t kept = 0;
+                for (size_t i = 0; i < todo.size(); i++) {
+                    if (!done[i]) {
+                        if (kept != i) {
+                            todo[kept] = move(todo[i]);
+                        }
+                        kept++;
+                    }
+                }
+                todo.erase(todo.begin() + kept, todo.end());
                 progress = progress || (origSize != todo.size());
                 categoryCounterAdd("resolve.constants.nonancestor", "retry", origSize - todo.size());
             }
@@ -803,6 +970,101 @@ public:
     }
 };
 
+// A sig parsed ahead of ResolveSignaturesWalk, with the errors that parsing it reported, to be reported where the walk
+// would have parsed it.
+struct PreParsedSig {
+    ParsedSig sig;
+    vector<core::ErrorQueueMessage> errors;
+};
+using PreParsedSigs = UnorderedMap<const ast::Send *, PreParsedSig>;
+
+// Parsing the sigs of a file only reads GlobalState, so every file's sigs are parsed on the WorkerPool first, leaving
+// ResolveSignaturesWalk to apply them to the symbols. This pairs sigs with methods the way the walk does. A sig is
+// left for the walk to parse if the walk could change what it parses to before getting to it: if its method needs a
+// singleton class that doesn't exist yet, or it names a class whose type isn't settled yet because the walk resolves
+// the `fixed:` type of one of its type members.
+class SigPreParser {
+    class SettledTypesCheck {
+    public:
+        bool settled = true;
+
+        void postWalkConstantLit(core::Context ctx, const ast::ConstantLit &lit) {
+            if (!lit.symbol.exists()) {
+                return;
+            }
+            auto sym = lit.symbol.data(ctx)->dealias(ctx);
+            auto data = sym.data(ctx);
+            if (!data->isClass() || data->resultType != nullptr) {
+                return;
+            }
+            for (auto typeMember : data->typeMembers()) {
+                auto memberData = typeMember.data(ctx);
+                if (memberData->isFixed() && memberData->resultType == nullptr) {
+                    settled = false;
+                }
+            }
+        }
+    };
+
+    void process(core::Context ctx, const InlinedVector<ast::Expression *, 4> &stats) {
+        InlinedVector<ast::Send *, 1> lastSigs;
+        for (auto *stat : stats) {
+            if (auto *send = ast::cast_tree<ast::Send>(stat)) {
+                if (TypeSyntax::isSig(ctx, send)) {
+                    lastSigs.emplace_back(send);
+                }
+            } else if (auto *mdef = ast::cast_tree<ast::MethodDef>(stat)) {
+                if (!lastSigs.empty()) {
+                    parseSigsFor(ctx, *mdef, lastSigs);
+                    lastSigs.clear();
+                }
+            }
+        }
+    }
+
+    void parseSigsFor(core::Context ctx, const ast::MethodDef &mdef, const InlinedVector<ast::Send *, 1> &sigs) {
+        auto sigOwner = mdef.isSelf() ? ctx.owner.data(ctx)->lookupSingletonClass(ctx) : ctx.owner;
+        if (!sigOwner.exists()) {
+            return;
+        }
+        for (auto *sig : sigs) {
+            SettledTypesCheck check;
+            ast::TreeWalk::apply(ctx, check, sig);
+            if (!check.settled) {
+                continue;
+            }
+            auto allowSelfType = true;
+            auto allowRebind = false;
+            core::ErrorBuffer errors;
+            auto parsed = TypeSyntax::parseSig(ctx.withOwner(sigOwner), sig, nullptr,
+                                               TypeSyntaxArgs{allowSelfType, allowRebind, mdef.symbol, sigTypes});
+            result.emplace(sig, PreParsedSig{move(parsed), move(errors.messages)});
+        }
+    }
+
+public:
+    PreParsedSigs result;
+    TypeSyntaxCache *sigTypes = nullptr;
+
+    void postWalkClassDef(core::Context ctx, const ast::ClassDef &klass) {
+        InlinedVector<ast::Expression *, 4> stats;
+        for (auto &stat : klass.rhs) {
+            stats.emplace_back(stat.get());
+        }
+        process(ctx.withOwner(klass.symbol), stats);
+    }
+
+    void postWalkInsSeq(core::Context ctx, const ast::InsSeq &seq) {
+        InlinedVector<ast::Expression *, 4> stats;
+        for (auto &stat : seq.stats) {
+            stats.emplace_back(stat.get());
+        }
+        // Like the walk, treat the value of the sequence as one more statement.
+        stats.emplace_back(seq.expr.get());
+        process(ctx.withOwner(ctx.owner.data(ctx)->enclosingClass(ctx)), stats);
+    }
+};
+
 class ResolveSignaturesWalk {
 private:
     std::vector<int> nestedBlockCounts;
@@ -1143,11 +1405,7 @@ private:
                     }
 
                     while (i < lastSigs.size()) {
-                        auto allowSelfType = true;
-                        auto allowRebind = false;
-                        auto sig =
-                            TypeSyntax::parseSig(ctx.withOwner(sigOwner), ast::cast_tree<ast::Send>(lastSigs[i]),
-                                                 nullptr, TypeSyntaxArgs{allowSelfType, allowRebind, mdef->symbol});
+                        auto sig = parseMethodSig(ctx.withOwner(sigOwner), lastSigs[i], mdef->symbol);
                         core::SymbolRef overloadSym;
                         if (isOverloaded) {
                             vector<int> argsToKeep;
@@ -1325,6 +1583,19 @@ private:
         return true;
     }
 
+    ParsedSig parseMethodSig(core::Context ctx, ast::Send *sig, core::SymbolRef method) {
+        if (preParsed != nullptr) {
+            auto fnd = preParsed->find(sig);
+            if (fnd != preParsed->end()) {
+                ctx.state.errorQueue->pushBuffered(move(fnd->second.errors));
+                return move(fnd->second.sig);
+            }
+        }
+        auto allowSelfType = true;
+        auto allowRebind = false;
+        return TypeSyntax::parseSig(ctx, sig, nullptr, TypeSyntaxArgs{allowSelfType, allowRebind, method, sigTypes});
+    }
+
     core::SymbolRef methodOwner(core::Context ctx) {
         core::SymbolRef owner = ctx.owner.data(ctx)->enclosingClass(ctx);
         if (owner == core::Symbols::root()) {
@@ -1335,6 +1606,11 @@ private:
     }
 
 public:
+    // The sigs of the file being walked that SigPreParser already parsed, if any.
+    PreParsedSigs *preParsed = nullptr;
+    // Shared with SigPreParser, for the types that sigs spell the same way.
+    TypeSyntaxCache *sigTypes = nullptr;
+
     ResolveSignaturesWalk() {
         nestedBlockCounts.emplace_back(0);
     }
@@ -1621,20 +1897,37 @@ public:
 }; // namespace
 
 vector<ast::ParsedFile> Resolver::run(core::MutableContext ctx, vector<ast::ParsedFile> trees, WorkerPool &workers) {
+    ctx.state.ancestorIndex = nullptr;
     trees = ResolveConstantsWalk::resolveConstants(ctx, std::move(trees), workers);
     finalizeAncestors(ctx.state);
     trees = resolveMixesInClassMethods(ctx, std::move(trees));
-    finalizeSymbols(ctx.state);
-    trees = resolveSigs(ctx, std::move(trees));
+    finalizeSymbols(ctx.state, workers);
+    trees = resolveSigs(ctx, std::move(trees), workers);
     sanityCheck(ctx, trees);
 
     return trees;
 }
 
-vector<ast::ParsedFile> Resolver::resolveSigs(core::MutableContext ctx, vector<ast::ParsedFile> trees) {
+vector<ast::ParsedFile> Resolver::resolveSigs(core::MutableContext ctx, vector<ast::ParsedFile> trees,
+                                              WorkerPool &workers) {
     ResolveSignaturesWalk sigs;
     Timer timeit(ctx.state.errorQueue->logger, "resolver.sigs_vars_and_flatten");
-    for (auto &tree : trees) {
+    TypeSyntaxCache sigTypes;
+    sigs.sigTypes = &sigTypes;
+    vector<PreParsedSigs> preParsed(trees.size());
+    if (trees.size() > 1) {
+        Timer timeit(ctx.state.errorQueue->logger, "resolver.sigs_vars_and_flatten.parse_sigs");
+        core::Context ictx = ctx;
+        workers.parallelFor("resolveSigsParse", trees.size(), [ictx, &trees, &preParsed, &sigTypes](size_t i) {
+            SigPreParser parser;
+            parser.sigTypes = &sigTypes;
+            ast::TreeWalk::apply(ictx, parser, trees[i].tree.get());
+            preParsed[i] = std::move(parser.result);
+        });
+    }
+    for (size_t i = 0; i < trees.size(); i++) {
+        auto &tree = trees[i];
+        sigs.preParsed = i < preParsed.size() ? &preParsed[i] : nullptr;
         tree.tree = ast::TreeMap::apply(ctx, sigs, std::move(tree.tree));
     }
 
@@ -1660,11 +1953,13 @@ void Resolver::sanityCheck(core::MutableContext ctx, vector<ast::ParsedFile> &tr
     }
 }
 
-vector<ast::ParsedFile> Resolver::runTreePasses(core::MutableContext ctx, vector<ast::ParsedFile> trees) {
+vector<ast::ParsedFile> Resolver::runTreePasses(core::MutableContext ctx, vector<ast::ParsedFile> trees,
+                                                u4 firstNewSymbol) {
     auto workers = WorkerPool::create(0, ctx.state.tracer());
     trees = ResolveConstantsWalk::resolveConstants(ctx, std::move(trees), *workers);
     trees = resolveMixesInClassMethods(ctx, std::move(trees));
-    trees = resolveSigs(ctx, std::move(trees));
+    finalizeNewSymbols(ctx.state, firstNewSymbol);
+    trees = resolveSigs(ctx, std::move(trees), *workers);
     sanityCheck(ctx, trees);
     // This check is FAR too slow to run on large codebases, especially with sanitizers on.
     // But it can be super useful to uncomment when debugging certain issues.
@@ -1675,6 +1970,7 @@ vector<ast::ParsedFile> Resolver::runTreePasses(core::MutableContext ctx, vector
 
 vector<ast::ParsedFile> Resolver::runConstantResolution(core::MutableContext ctx, vector<ast::ParsedFile> trees,
                                                         WorkerPool &workers) {
+    ctx.state.ancestorIndex = nullptr;
     trees = ResolveConstantsWalk::resolveConstants(ctx, std::move(trees), workers);
     sanityCheck(ctx, trees);
 
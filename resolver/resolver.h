@@ -14,18 +14,27 @@ public:
     Resolver() = delete;
 
     /** Only runs tree passes, used for incremental changes that do not affect global state. Assumes that `run` was
-     * called on a tree that contains same definitions before (LSP uses heuristics that should only have false negatives
-     * to find this) */
-    static std::vector<ast::ParsedFile> runTreePasses(core::MutableContext ctx, std::vector<ast::ParsedFile> trees);
+     * called on a tree that contains same definitions before, or those and more (LSP uses heuristics that should only
+     * have false negatives to find this). Symbols from `firstNewSymbol` on were entered since `run`, and are finalized
+     * the way `run` would have. */
+    static std::vector<ast::ParsedFile> runTreePasses(core::MutableContext ctx, std::vector<ast::ParsedFile> trees,
+                                                      u4 firstNewSymbol);
 
     // used by autogen only
     static std::vector<ast::ParsedFile> runConstantResolution(core::MutableContext ctx,
                                                               std::vector<ast::ParsedFile> trees, WorkerPool &workers);
 
 private:
-    static void finalizeAncestors(core::GlobalState &gs);
-    static void finalizeSymbols(core::GlobalState &gs);
-    static std::vector<ast::ParsedFile> resolveSigs(core::MutableContext ctx, std::vector<ast::ParsedFile> trees);
+    static void finalizeAncestors(core::GlobalState &gs, u4 firstSymbol = 1);
+    static void finalizeSymbols(core::GlobalState &gs, WorkerPool &workers);
+    /** Wires the `mixes_in_class_methods` of the classes from `firstSymbol` on into their singleton classes. */
+    static void finalizeClassMethods(core::GlobalState &gs, u4 firstSymbol);
+    /** Resolves the type members of the classes from `firstSymbol` on. Earlier ones are redone without errors. */
+    static void finalizeTypeMembers(core::GlobalState &gs, u4 firstSymbol);
+    /** Like finalizeAncestors and finalizeSymbols, for just the symbols from `firstNewSymbol` on. */
+    static void finalizeNewSymbols(core::GlobalState &gs, u4 firstNewSymbol);
+    static std::vector<ast::ParsedFile> resolveSigs(core::MutableContext ctx, std::vector<ast::ParsedFile> trees,
+                                                    WorkerPool &workers);
     static std::vector<ast::ParsedFile> resolveMixesInClassMethods(core::MutableContext ctx,
                                                                    std::vector<ast::ParsedFile> trees);
     static void sanityCheck(core::MutableContext ctx, std::vector<ast::ParsedFile> &trees);
@@ -38,6 +38,106 @@ bool isTProc(core::Context ctx, ast::Send *send) {
     return false;
 }
 
+// The arity of the stdlib generics whose `[]` appendCacheKey understands, or 0 for every other class.
+int stdlibGenericArity(core::SymbolRef sym) {
+    if (sym == core::Symbols::T_Hash()) {
+        return 2;
+    }
+    if (sym == core::Symbols::T_Array() || sym == core::Symbols::T_Set() || sym == core::Symbols::T_Enumerable() ||
+        sym == core::Symbols::T_Enumerator() || sym == core::Symbols::T_Range()) {
+        return 1;
+    }
+    return 0;
+}
+
+enum class CacheKeyTag : u4 { Constant = 1, Combinator, Generic, Tuple };
+
+// Appends to `key` what the type `expr` means depends on, and returns whether that is all it depends on, so that
+// getResultTypeAndBind may share its type with every other expression with the same key. That is the case for the
+// expressions made only of non-generic classes and type aliases, T.nilable, T.any, T.all, T.untyped, T.noreturn,
+// tuples and the stdlib generics, and that can't report an error. Everything that depends on the class or method the
+// sig is in (self, T.self_type, type members, T.type_parameter, T.proc) is never shared.
+bool appendCacheKey(core::Context ctx, const ast::Expression &expr, const TypeSyntaxArgs &args, vector<u4> &key) {
+    if (auto *lit = ast::cast_tree_const<ast::ConstantLit>(&expr)) {
+        if (!lit->symbol.exists()) {
+            return false;
+        }
+        auto data = lit->symbol.data(ctx);
+        if (data->isTypeAlias()) {
+            if (data->resultType == nullptr) {
+                return false;
+            }
+        } else {
+            auto sym = data->dealias(ctx);
+            // Generic classes are either an error here or have `fixed:` type members that may not be resolved yet.
+            if (!sym.data(ctx)->isClass() || sym == core::Symbols::StubModule() ||
+                !sym.data(ctx)->typeMembers().empty()) {
+                return false;
+            }
+        }
+        key.insert(key.end(), {static_cast<u4>(CacheKeyTag::Constant), lit->symbol._id});
+        return true;
+    }
+    if (auto *arr = ast::cast_tree_const<ast::Array>(&expr)) {
+        key.insert(key.end(), {static_cast<u4>(CacheKeyTag::Tuple), static_cast<u4>(arr->elems.size())});
+        for (auto &el : arr->elems) {
+            if (!appendCacheKey(ctx, *el, args, key)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    auto *send = ast::cast_tree_const<ast::Send>(&expr);
+    if (send == nullptr || send->block != nullptr) {
+        return false;
+    }
+    auto *recv = ast::cast_tree_const<ast::ConstantLit>(send->recv.get());
+    if (recv == nullptr) {
+        return false;
+    }
+    auto argCount = send->args.size();
+    if (recv->symbol == core::Symbols::T()) {
+        switch (send->fun._id) {
+            case core::Names::nilable()._id:
+                if (argCount != 1) {
+                    return false;
+                }
+                break;
+            case core::Names::any()._id:
+            case core::Names::all()._id:
+                if (argCount == 0) {
+                    return false;
+                }
+                break;
+            case core::Names::untyped()._id:
+            case core::Names::noreturn()._id:
+                if (argCount != 0) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+        key.insert(key.end(), {static_cast<u4>(CacheKeyTag::Combinator), send->fun._id, static_cast<u4>(argCount)});
+        if (debug_mode && send->fun == core::Names::untyped()) {
+            // T.untyped remembers what it was written for in debug builds.
+            key.emplace_back(args.untypedBlame._id);
+        }
+    } else {
+        auto arity = stdlibGenericArity(recv->symbol);
+        if (send->fun != core::Names::squareBrackets() || arity == 0 || argCount != arity) {
+            return false;
+        }
+        key.insert(key.end(), {static_cast<u4>(CacheKeyTag::Generic), recv->symbol._id, static_cast<u4>(argCount)});
+    }
+    for (auto &arg : send->args) {
+        if (!appendCacheKey(ctx, *arg, args, key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool TypeSyntax::isSig(core::Context ctx, ast::Send *send) {
     if (send->fun != core::Names::sig()) {
         return false;
@@ -64,7 +164,7 @@ bool TypeSyntax::isSig(core::Context ctx, ast::Send *send) {
     return false;
 }
 
-ParsedSig TypeSyntax::parseSig(core::MutableContext ctx, ast::Send *sigSend, const ParsedSig *parent,
+ParsedSig TypeSyntax::parseSig(core::Context ctx, ast::Send *sigSend, const ParsedSig *parent,
                                const TypeSyntaxArgs &args) {
     ParsedSig sig;
 
@@ -360,7 +460,7 @@ ParsedSig TypeSyntax::parseSig(core::MutableContext ctx, ast::Send *sigSend, con
     return sig;
 }
 
-core::TypePtr interpretTCombinator(core::MutableContext ctx, ast::Send *send, const ParsedSig &sig,
+core::TypePtr interpretTCombinator(core::Context ctx, ast::Send *send, const ParsedSig &sig,
                                    const TypeSyntaxArgs &args) {
     switch (send->fun._id) {
         case core::Names::nilable()._id:
@@ -480,7 +580,7 @@ core::TypePtr interpretTCombinator(core::MutableContext ctx, ast::Send *send, co
                 return core::Types::untypedUntracked();
             }
 
-            auto singleton = sym.data(ctx)->singletonClass(ctx);
+            auto singleton = sym.data(ctx)->lookupSingletonClass(ctx);
             if (!singleton.exists()) {
                 if (auto e = ctx.state.beginError(send->loc, core::errors::Resolver::InvalidTypeDeclaration)) {
                     e.setHeader("Unknown class");
@@ -510,17 +610,32 @@ core::TypePtr interpretTCombinator(core::MutableContext ctx, ast::Send *send, co
     }
 }
 
-core::TypePtr TypeSyntax::getResultType(core::MutableContext ctx, ast::Expression &expr,
+core::TypePtr TypeSyntax::getResultType(core::Context ctx, ast::Expression &expr,
                                         const ParsedSig &sigBeingParsed, const TypeSyntaxArgs &args) {
     return getResultTypeAndBind(ctx, expr, sigBeingParsed, args.withoutRebind()).type;
 }
 
-TypeSyntax::ResultType TypeSyntax::getResultTypeAndBind(core::MutableContext ctx, ast::Expression &expr,
+TypeSyntax::ResultType TypeSyntax::getResultTypeAndBind(core::Context ctx, ast::Expression &expr,
                                                         const ParsedSig &sigBeingParsed, const TypeSyntaxArgs &args) {
     // Ensure that we only check types from a class context
     auto ctxOwnerData = ctx.owner.data(ctx);
     ENFORCE(ctxOwnerData->isClass(), "getResultTypeAndBind wasn't called with a class owner");
 
+    // Bare constants are cheap enough to not be worth a trip through the cache.
+    if (args.cache != nullptr && !ast::isa_tree<ast::ConstantLit>(&expr)) {
+        vector<u4> key;
+        if (appendCacheKey(ctx, expr, args, key)) {
+            if (auto cached = args.cache->find(key)) {
+                counterInc("types.sig_cache.hit");
+                return ResultType{move(cached), core::SymbolRef()};
+            }
+            // Everything below this expression has a key too, and is shared through this one.
+            auto result = getResultTypeAndBind(ctx, expr, sigBeingParsed, args.withoutCache());
+            args.cache->insert(move(key), result.type);
+            return result;
+        }
+    }
+
     ResultType result;
     typecase(
         &expr,
@@ -781,7 +896,15 @@ TypeSyntax::ResultType TypeSyntax::getResultTypeAndBind(core::MutableContext ctx
                 return;
             }
 
-            auto ctype = core::make_type<core::ClassType>(corrected.data(ctx)->singletonClass(ctx));
+            auto singleton = corrected.data(ctx)->lookupSingletonClass(ctx);
+            if (!singleton.exists()) {
+                if (auto e = ctx.state.beginError(s->loc, core::errors::Resolver::InvalidTypeDeclaration)) {
+                    e.setHeader("Unknown class");
+                }
+                result.type = core::Types::untypedUntracked();
+                return;
+            }
+            auto ctype = core::make_type<core::ClassType>(singleton);
             core::CallLocs locs{
                 s->loc,
                 recvi->loc,
@@ -825,6 +948,20 @@ TypeSyntax::ResultType TypeSyntax::getResultTypeAndBind(core::MutableContext ctx
     return result;
 } // namespace sorbet::resolver
 
+core::TypePtr TypeSyntaxCache::find(const vector<u4> &key) {
+    absl::ReaderMutexLock lock(&mtx);
+    auto fnd = types.find(key);
+    if (fnd == types.end()) {
+        return nullptr;
+    }
+    return fnd->second;
+}
+
+void TypeSyntaxCache::insert(vector<u4> key, core::TypePtr type) {
+    absl::MutexLock lock(&mtx);
+    types.emplace(move(key), move(type));
+}
+
 ParsedSig::TypeArgSpec &ParsedSig::enterTypeArgByName(core::NameRef name) {
     for (auto &current : typeArgs) {
         if (current.name == name) {
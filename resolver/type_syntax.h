@@ -3,6 +3,7 @@
 #include <memory>
 #include <vector>
 
+#include "absl/synchronization/mutex.h"
 #include "ast/ast.h"
 #include "core/Symbols.h"
 
@@ -47,37 +48,65 @@ struct ParsedSig {
     const TypeArgSpec &findTypeArgByName(core::NameRef name) const;
 };
 
+/**
+ * The types of the sig expressions that mean the same thing wherever they are written, like `T.nilable(String)` or
+ * `T::Hash[Symbol, T.untyped]`, so that each is built once and shared by every sig that mentions it. Keyed by the
+ * symbols and names in the expression (see TypeSyntax::getResultTypeAndBind). Safe to use from any thread, but only
+ * valid while the symbols those types mention stay as they are, so it lives for one pass over the sigs.
+ */
+class TypeSyntaxCache final {
+public:
+    TypeSyntaxCache() = default;
+    TypeSyntaxCache(const TypeSyntaxCache &) = delete;
+    TypeSyntaxCache &operator=(const TypeSyntaxCache &) = delete;
+
+    // nullptr if the expression hasn't been seen yet.
+    core::TypePtr find(const std::vector<u4> &key);
+    void insert(std::vector<u4> key, core::TypePtr type);
+
+private:
+    absl::Mutex mtx;
+    UnorderedMap<std::vector<u4>, core::TypePtr> types;
+};
+
 struct TypeSyntaxArgs {
     bool allowSelfType = false;
     bool allowRebind = false;
     core::SymbolRef untypedBlame;
+    TypeSyntaxCache *cache = nullptr;
 
     TypeSyntaxArgs withoutRebind() const {
-        return TypeSyntaxArgs{allowSelfType, false, untypedBlame};
+        return TypeSyntaxArgs{allowSelfType, false, untypedBlame, cache};
     }
 
     TypeSyntaxArgs withRebind() const {
-        return TypeSyntaxArgs{allowSelfType, true, untypedBlame};
+        return TypeSyntaxArgs{allowSelfType, true, untypedBlame, cache};
     }
 
     TypeSyntaxArgs withoutSelfType() const {
-        return TypeSyntaxArgs{false, allowRebind, untypedBlame};
+        return TypeSyntaxArgs{false, allowRebind, untypedBlame, cache};
+    }
+
+    TypeSyntaxArgs withoutCache() const {
+        return TypeSyntaxArgs{allowSelfType, allowRebind, untypedBlame, nullptr};
     }
 };
 
+// Type syntax only reads GlobalState, so that sigs can be parsed on several threads at once (see
+// ResolveSignaturesWalk). Every class it names has had its singleton class made by the namer.
 class TypeSyntax {
 public:
     static bool isSig(core::Context ctx, ast::Send *send);
-    static ParsedSig parseSig(core::MutableContext ctx, ast::Send *send, const ParsedSig *parent,
+    static ParsedSig parseSig(core::Context ctx, ast::Send *send, const ParsedSig *parent,
                               const TypeSyntaxArgs &args);
 
     struct ResultType {
         core::TypePtr type;
         core::SymbolRef rebind;
     };
-    static ResultType getResultTypeAndBind(core::MutableContext ctx, ast::Expression &expr, const ParsedSig &,
+    static ResultType getResultTypeAndBind(core::Context ctx, ast::Expression &expr, const ParsedSig &,
                                            const TypeSyntaxArgs &args);
-    static core::TypePtr getResultType(core::MutableContext ctx, ast::Expression &expr, const ParsedSig &,
+    static core::TypePtr getResultType(core::Context ctx, ast::Expression &expr, const ParsedSig &,
                                        const TypeSyntaxArgs &args);
 
     TypeSyntax() = delete;
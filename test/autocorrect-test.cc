@@ -47,6 +47,16 @@ TEST(ErrorTest, AutocorrectTest) { // NOLINT
     autocorrects.emplace_back(core::Loc(file, 1, 2), "same");
     result = core::AutocorrectSuggestion::apply(move(autocorrects), sources);
     ASSERT_EQ("1same3", result[file]);
+
+    // Conflicting autocorrects resolve the same way whatever order they are reported in.
+    vector<core::AutocorrectSuggestion> forwards;
+    forwards.emplace_back(core::Loc(file, 1, 2), "first");
+    forwards.emplace_back(core::Loc(file, 1, 2), "second");
+    vector<core::AutocorrectSuggestion> backwards;
+    backwards.emplace_back(core::Loc(file, 1, 2), "second");
+    backwards.emplace_back(core::Loc(file, 1, 2), "first");
+    ASSERT_EQ(core::AutocorrectSuggestion::applyToFile(move(forwards), "123"),
+              core::AutocorrectSuggestion::applyToFile(move(backwards), "123"));
 }
 
 } // namespace sorbet
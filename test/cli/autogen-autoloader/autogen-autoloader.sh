@@ -16,7 +16,7 @@ main/sorbet --silence-dev-message --stop-after=namer -p autogen-autoloader:outpu
   test/cli/autogen-autoloader/{foo,bar,bar2,errors}.rb \
   test/cli/autogen-autoloader/scripts/baz.rb 2>&1
 
-for file in $(find output -type f | sort); do
+for file in $(find output -type f -name "*.rb" | sort); do
   printf "\n--- %s\n" "$file"
   cat "$file"
 done
@@ -41,7 +41,17 @@ main/sorbet --silence-dev-message --stop-after=namer \
   --autogen-autoloader-modules=Foo \
   test/cli/autogen-autoloader/inplace.rb
 
-find inplace-output | sort
+find inplace-output -not -name .autoloader-manifest | sort
+
+echo
+echo "--- unchanged files are not written again"
+main/sorbet --silence-dev-message --stop-after=namer \
+  -p autogen-autoloader:inplace-output \
+  --autogen-autoloader-modules=Foo \
+  --metrics-file=inplace-metrics.json \
+  test/cli/autogen-autoloader/inplace.rb
+grep -c "autogen.autoloader.unchanged" inplace-metrics.json
+grep -c "autogen.autoloader.written" inplace-metrics.json || true
 
 echo
 echo "--- strip-prefixes and root rename"
@@ -8,3 +8,15 @@ main/sorbet --silence-dev-message --stop-after=namer -p autogen-subclasses \
   --autogen-subclasses-parent=Opus::IDontExist \
   --autogen-subclasses-parent=Opus::NeverSubclassed \
   test/cli/autogen-subclasses/a.rb
+
+echo "--- cached ---"
+dir=$(mktemp -d)
+trap 'rm -r "$dir"' EXIT
+for run in miss hit; do
+  main/sorbet --silence-dev-message --stop-after=namer -p autogen-subclasses \
+    --autogen-subclasses-parent=Opus::Mixin \
+    --autogen-subclasses-parent=Opus::Parent \
+    --cache-dir "$dir" --metrics-file "$dir/$run.json" \
+    test/cli/autogen-subclasses/a.rb
+  grep -c "autogen.subclasses.kvstore.$run" "$dir/$run.json"
+done
@@ -0,0 +1,29 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+mkdir "$dir/cache"
+cat >> "$dir/test.rb" <<EOF
+# typed: true
+class A; end
+A.new.foo
+EOF
+main/sorbet --silence-dev-message --cache-dir "$dir/cache" "$dir/test.rb" > "$dir/uncached" 2>&1
+ls "$dir/cache" | grep -c "^global-state-"
+
+# A run that maps the state reports what the first one did.
+main/sorbet --silence-dev-message --cache-dir "$dir/cache" "$dir/test.rb" > "$dir/mapped" 2>&1
+diff "$dir/uncached" "$dir/mapped"
+
+# Without the file, the copy in the cache database is used instead.
+rm "$dir/cache"/global-state-*
+main/sorbet --silence-dev-message --cache-dir "$dir/cache" "$dir/test.rb" > "$dir/unmapped" 2>&1
+diff "$dir/uncached" "$dir/unmapped"
+
+# A state with more names replaces the file of the previous one.
+echo "class B; end" >> "$dir/test.rb"
+main/sorbet --silence-dev-message --cache-dir "$dir/cache" "$dir/test.rb" > /dev/null 2>&1
+ls "$dir/cache" | grep -c "^global-state-"
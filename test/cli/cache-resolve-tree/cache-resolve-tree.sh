@@ -0,0 +1,21 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+set -e
+
+mkdir "$dir/cache"
+cat >> "$dir/test.rb" <<EOF
+# typed: true
+class A
+  X = 1
+end
+EOF
+main/sorbet --silence-dev-message --cache-dir "$dir/cache" -p resolve-tree "$dir/test.rb" > "$dir/first.out"
+# The second run loads the resolved trees from the cache, and still has to print them.
+main/sorbet --silence-dev-message --cache-dir "$dir/cache" -p resolve-tree "$dir/test.rb" > "$dir/second.out"
+if [ -s "$dir/second.out" ] && diff "$dir/first.out" "$dir/second.out"; then
+    echo "same resolve tree"
+fi
@@ -0,0 +1,19 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+for name in a b c d; do
+    cat > "$dir/$name.rb" <<RUBY
+# typed: true
+class ${name^}
+  def foo; 1 + 2; end
+end
+RUBY
+done
+
+# However the files are split between threads, each file's CFGs come out together and in file order.
+main/sorbet --silence-dev-message --max-threads=4 -p cfg "$dir/a.rb" "$dir/b.rb" "$dir/c.rb" "$dir/d.rb" 2> /dev/null |
+    grep '^digraph'
@@ -0,0 +1,9 @@
+# typed: true
+class A
+  extend T::Sig
+
+  sig {returns(Integer)}
+  def self.count
+    "none"
+  end
+end
@@ -0,0 +1,37 @@
+#!/bin/bash
+dir=$(mktemp -d)
+socket="$dir/socket"
+cleanup() {
+    kill "$daemon" 2> /dev/null
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+main/sorbet --silence-dev-message --lsp --disable-watchman --daemon-socket "$socket" test/cli/daemon \
+    < /dev/null > /dev/null 2>&1 &
+daemon=$!
+for _ in $(seq 100); do
+    if [ -S "$socket" ]; then
+        break
+    fi
+    sleep 0.1
+done
+
+# The daemon prints the errors that typechecking from scratch prints, and exits the same way.
+main/sorbet --silence-dev-message test/cli/daemon > "$dir/cli" 2>&1
+echo "exit: $?" >> "$dir/cli"
+main/sorbet --silence-dev-message --daemon-socket "$socket" test/cli/daemon > "$dir/daemon" 2>&1
+echo "exit: $?" >> "$dir/daemon"
+if ! grep -q "https://srb.help" "$dir/daemon"; then
+    echo "FAILED: the daemon did not report any error"
+fi
+if ! diff <(sort "$dir/cli") <(sort "$dir/daemon"); then
+    echo "FAILED: the daemon did not report the errors of a typecheck"
+fi
+
+# Without a daemon, the client typechecks by itself.
+main/sorbet --silence-dev-message --daemon-socket "$dir/missing" test/cli/daemon > "$dir/fallback" 2>&1
+echo "exit: $?" >> "$dir/fallback"
+if ! diff <(sort "$dir/cli") <(sort "$dir/fallback"); then
+    echo "FAILED: the client did not typecheck without a daemon"
+fi
@@ -0,0 +1,7 @@
+# typed: true
+class A
+  def foo
+    B.new
+    C::VALUE
+  end
+end
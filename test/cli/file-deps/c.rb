@@ -0,0 +1,4 @@
+# typed: true
+class C
+  VALUE = 1
+end
@@ -0,0 +1,3 @@
+#!/bin/bash
+main/sorbet --silence-dev-message -p file-deps test/cli/file-deps/a.rb test/cli/file-deps/b.rb \
+  test/cli/file-deps/c.rb
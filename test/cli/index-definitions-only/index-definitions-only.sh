@@ -0,0 +1,35 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+cat > "$dir/a.rb" <<RUBY
+# typed: false
+class A
+  def initialize
+    @count = T.let(0, Integer)
+  end
+
+  def foo
+    x = Undefined
+    Integer.sqrt(x).to_s + \$global
+  end
+end
+RUBY
+cat > "$dir/b.rb" <<RUBY
+# typed: true
+class B
+  def bar
+    T.reveal_type(\$global)
+  end
+end
+RUBY
+
+main/sorbet --silence-dev-message "$dir" > "$dir/whole" 2>&1
+main/sorbet --silence-dev-message --index-definitions-only --metrics-file="$dir/metrics.json" "$dir" \
+    > "$dir/definitions" 2>&1
+# The bodies of a.rb only report constants that don't resolve, which are kept.
+diff "$dir/whole" "$dir/definitions" && echo "same errors"
+grep -c "types.input.files.definitions_only" "$dir/metrics.json"
@@ -36,3 +36,22 @@ main/sorbet --silence-dev-message \
             test/cli/metrics-file/with-error-branching.rb 2>&1
 
 grep -A1 "\"ruby_typer.unknown..error.total\"" metrics5.json || echo "No error metrics reported."
+
+echo ------------------------------
+
+# Every phase that runs on the workers reports how the workers spent it
+main/sorbet --silence-dev-message --max-threads=2 \
+            --metrics-file=metrics6.json \
+            test/cli/metrics-file/test.rb 2>&1
+
+for category in queue_wait_us wall_us cpu_us idle_us straggler_us; do
+    grep -c "\"ruby_typer.unknown..workers.$category.typecheck\"" metrics6.json
+done
+
+echo ------------------------------
+
+# Every phase reports the peak RSS and heap usage it reached
+for phase in index name resolve typecheck; do
+    grep -c "\"ruby_typer.unknown..memory.$phase.max_rss\"" metrics6.json
+done
+grep -c "\"ruby_typer.unknown..memory.typecheck.heap_allocated\"" metrics6.json
@@ -0,0 +1,28 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+# Concurrent indexing, which chunked parsing needs, only happens for three files or more.
+for name in b c; do
+    echo "# typed: true" > "$dir/$name.rb"
+done
+{
+    echo "# typed: true"
+    for i in $(seq 1 20); do
+        echo "# Class number $i"
+        echo "class A$i"
+        echo "  def foo"
+        echo "    bar$i"
+        echo "  end"
+        echo "end"
+        echo
+    done
+} > "$dir/a.rb"
+
+main/sorbet --silence-dev-message --max-threads=0 "$dir" > "$dir/whole" 2>&1
+main/sorbet --silence-dev-message --max-threads=0 --parse-chunk-lines=10 "$dir" > "$dir/chunked" 2>&1
+# The errors are on the same lines when a.rb is parsed as chunks of about 10 lines.
+diff "$dir/whole" "$dir/chunked" && echo "same errors"
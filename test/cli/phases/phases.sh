@@ -18,7 +18,8 @@ diff -r out fileout | sort
 
 echo "--- checking crashes ---"
 # Makes sure all these options don't crash us
-for p in symbol-table-json symbol-table-full symbol-table-full-raw symbol-table-full-json cfg-proto; do
+for p in symbol-table-json symbol-table-proto symbol-table-full symbol-table-full-raw symbol-table-full-json \
+    symbol-table-full-proto cfg-proto; do
     main/sorbet --silence-dev-message -p "$p" -e '1' > /dev/null
 done
 
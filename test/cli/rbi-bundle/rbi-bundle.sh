@@ -0,0 +1,32 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+cat > "$dir/my_gem.rbi" <<RUBY
+# typed: true
+module MyGem
+  extend T::Sig
+
+  sig {returns(Integer)}
+  def self.version; end
+end
+RUBY
+cat > "$dir/app.rb" <<RUBY
+# typed: true
+MyGem.version.nope
+RUBY
+
+main/sorbet --silence-dev-message --store-state "$dir/bundle" "$dir/my_gem.rbi" > /dev/null 2>&1
+
+# The bundled RBI is not indexed again, yet what it defines is known.
+main/sorbet --silence-dev-message --rbi-bundle "$dir/bundle" --metrics-file="$dir/metrics.json" \
+    "$dir/app.rb" "$dir/my_gem.rbi" 2>&1 | grep -c "does not exist on \`Integer\`"
+grep -c "types.input.files.bundled" "$dir/metrics.json"
+
+# A bundled file that changed since is indexed again.
+echo "# A new comment" >> "$dir/my_gem.rbi"
+main/sorbet --silence-dev-message --rbi-bundle "$dir/bundle" "$dir/app.rb" "$dir/my_gem.rbi" 2>&1 | \
+    grep -c "changed since the --rbi-bundle was stored"
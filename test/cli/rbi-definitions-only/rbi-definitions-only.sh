@@ -0,0 +1,27 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+cat > "$dir/a.rbi" <<RUBY
+# typed: strict
+class A
+  extend T::Sig
+
+  sig {returns(Integer)}
+  def foo
+    Undefined.new.bar
+  end
+end
+RUBY
+cat > "$dir/b.rb" <<RUBY
+# typed: true
+A.new.foo.nope
+RUBY
+
+# Only the definitions of RBIs are indexed, yet the constants in their bodies are still resolved.
+main/sorbet --silence-dev-message --metrics-file="$dir/metrics.json" "$dir" 2>&1 | grep -c "Unable to resolve constant"
+main/sorbet --silence-dev-message "$dir" 2>&1 | grep -c "does not exist on \`Integer\`"
+grep -c "types.input.files.definitions_only" "$dir/metrics.json"
@@ -0,0 +1,24 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+cat > "$dir/a.rb" <<RUBY
+# typed: true
+class A
+  def foo
+    bar
+  end
+end
+RUBY
+cat > "$dir/b.rb" <<RUBY
+# typed: false
+class B; end
+RUBY
+
+main/sorbet --silence-dev-message --suggest-typed "$dir" > "$dir/kept" 2>&1
+main/sorbet --silence-dev-message --suggest-typed --release-typechecked-trees "$dir" > "$dir/released" 2>&1
+# Freeing the trees right after typechecking them changes neither the errors nor the suggested sigils.
+diff "$dir/kept" "$dir/released" && echo "same errors"
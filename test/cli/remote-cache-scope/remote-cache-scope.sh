@@ -0,0 +1,24 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+mkdir "$dir/first" "$dir/second" "$dir/remote"
+
+# The first machine caches the tree of x.rb, and shares it.
+main/sorbet --silence-dev-message --cache-dir "$dir/first" --remote-cache-dir "$dir/remote" \
+  test/cli/remote-cache-scope/x.rb 2>&1
+if [ -n "$(ls "$dir/remote")" ]; then
+    echo "the first machine shared its trees"
+fi
+
+# The second machine's state has other names, as it indexed other files before.
+main/sorbet --silence-dev-message --cache-dir "$dir/second" test/cli/remote-cache-scope/y.rb 2>&1
+
+# So the tree of x.rb the first machine shared refers to names the second one doesn't have, and must not be used.
+main/sorbet --silence-dev-message --cache-dir "$dir/second" --remote-cache-dir "$dir/remote" \
+  --metrics-file="$dir/metrics.json" test/cli/remote-cache-scope/x.rb 2>&1
+grep -A1 "\"ruby_typer.unknown..types.input.files.kvstore.hit\"" "$dir/metrics.json" || echo "no tree hit"
+grep -A1 "\"ruby_typer.unknown..cache.remote.hit\"" "$dir/metrics.json" || echo "no remote hit"
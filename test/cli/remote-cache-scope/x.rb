@@ -0,0 +1,4 @@
+# typed: true
+class OnlyOnTheFirstMachine
+  def shared_method; end
+end
@@ -0,0 +1,4 @@
+# typed: true
+class OnlyOnTheSecondMachine
+  def local_method; end
+end
@@ -0,0 +1,11 @@
+# typed: true
+class B < A
+  extend T::Sig
+
+  sig {params(name: String).returns(String)}
+  def self.greet(name)
+    "Hello, #{name}"
+  end
+
+  greet(A.count)
+end
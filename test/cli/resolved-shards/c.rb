@@ -0,0 +1,7 @@
+# typed: true
+module C
+  def self.run
+    B.greet(nil)
+    B.missing
+  end
+end
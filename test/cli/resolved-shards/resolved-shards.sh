@@ -0,0 +1,24 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+# Every error of a full run is reported by exactly one of the shards.
+main/sorbet --silence-dev-message --no-error-count test/cli/resolved-shards/*.rb > "$dir/full" 2>&1
+main/sorbet --silence-dev-message --no-error-count --store-resolved "$dir/resolved" test/cli/resolved-shards/*.rb 2>&1
+for shard in 1/3 2/3 3/3; do
+    main/sorbet --silence-dev-message --no-error-count --load-resolved "$dir/resolved" --shard "$shard" \
+        > "$dir/shard" 2>&1
+    cat "$dir/shard" >> "$dir/sharded"
+    if ! grep -q "https://srb.help" "$dir/shard"; then
+        echo "FAILED: shard $shard did not typecheck any file"
+    fi
+done
+
+grep "https://srb.help" "$dir/full" | sort > "$dir/full.headers"
+grep "https://srb.help" "$dir/sharded" | sort > "$dir/sharded.headers"
+if ! diff "$dir/full.headers" "$dir/sharded.headers"; then
+    echo "FAILED: the shards did not report the errors of the full run"
+fi
@@ -0,0 +1,21 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+broken='class A; def foo; T.reveal_type(1); end; end'
+clean='class A; def foo; 1; end; end'
+
+main/sorbet --silence-dev-message -e "$broken" 2>&1 | grep -v "^Errors: " > "$dir/errors"
+{
+    printf '%d\n%s' "$(wc -c < "$dir/errors")" "$(cat "$dir/errors")"
+    echo
+    echo 0
+} > "$dir/expected"
+
+# Both documents define A; each is checked on its own.
+printf '%d\n%s%d\n%s' ${#broken} "$broken" ${#clean} "$clean" |
+    main/sorbet --silence-dev-message --stdin-stream > "$dir/stream" 2>&1
+diff "$dir/expected" "$dir/stream" && echo "same errors"
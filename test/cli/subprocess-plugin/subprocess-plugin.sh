@@ -3,6 +3,8 @@
 # Check that the subprocess is getting good arguments
 echo ------ Arguments passed to plugin
 main/sorbet --silence-dev-message --dsl-plugins test/cli/subprocess-plugin/echo_argv.yaml --print plugin-generated-code test/cli/subprocess-plugin/permute.rb
+echo ------ Resident plugin process
+main/sorbet --silence-dev-message --dsl-plugins test/cli/subprocess-plugin/resident.yaml --print plugin-generated-code test/cli/subprocess-plugin/permute.rb
 echo ------ Extra arguments for Ruby
 main/sorbet --silence-dev-message --dsl-plugins test/cli/subprocess-plugin/ruby_extra_args.yaml --print plugin-generated-code test/cli/subprocess-plugin/permute.rb
 echo ------ Multi file generated code
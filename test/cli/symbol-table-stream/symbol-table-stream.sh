@@ -0,0 +1,14 @@
+#!/bin/bash
+dir=$(mktemp -d)
+cleanup() {
+    rm -r "$dir"
+}
+trap cleanup EXIT
+
+# Written to a file, the symbol table is the same as on stdout.
+main/sorbet --silence-dev-message -p symbol-table-json -e 'class A; def foo(x); end; end' > "$dir/stdout" 2> /dev/null
+main/sorbet --silence-dev-message -p "symbol-table-json:$dir/file" -e 'class A; def foo(x); end; end' 2> /dev/null
+diff "$dir/stdout" "$dir/file" && echo "same json"
+
+main/sorbet --silence-dev-message -p "symbol-table-proto:$dir/proto" -e 'class A; def foo(x); end; end' 2> /dev/null
+test -s "$dir/proto" && echo "wrote proto"
@@ -1,9 +1,13 @@
+#include "absl/strings/match.h"
+#include "common/FileOps.h"
 #include "core/Unfreeze.h"
 #include "main/pipeline/pipeline.h"
 #include "payload/payload.h"
 #include "spdlog/sinks/stdout_sinks.h"
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 
 using namespace std;
 using namespace sorbet;
@@ -24,6 +28,25 @@ unique_ptr<const realmain::options::Options> opts =
 
 unique_ptr<KeyValueStore> kvstore;
 
+// With --time-budget-ms=N, an input that takes longer than N milliseconds to typecheck aborts like a crash would, so
+// that libFuzzer keeps it, and `-minimize_crash=1` shrinks it to the smallest input that is still too slow. Slow inputs
+// are also written to --slow-input-dir, if given, to be turned into regression tests.
+optional<chrono::milliseconds> timeBudget;
+string slowInputDir;
+
+const string TIME_BUDGET_FLAG = "--time-budget-ms=";
+const string SLOW_INPUT_DIR_FLAG = "--slow-input-dir=";
+
+void reportSlowInput(const string &inputData, chrono::milliseconds took) {
+    logger->critical("Input took {}ms to typecheck, over the budget of {}ms", took.count(), timeBudget->count());
+    if (!slowInputDir.empty()) {
+        auto path = fmt::format("{}/slow-{:016x}.rb", slowInputDir, hash<string>{}(inputData));
+        FileOps::write(path, inputData);
+        logger->critical("Wrote it to {}", path);
+    }
+    abort();
+}
+
 unique_ptr<core::GlobalState> buildInitialGlobalState() {
     typeErrorsConsole->set_level(spd::level::critical);
 
@@ -42,8 +65,13 @@ extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
     // Huh, I wish we could use cxxopts, but libfuzzer & cxxopts choke on each other argument formats
     // thus we do it manually
     for (int i = 0; i < *argc; i++) {
-        if (string((*argv)[i]) == "--stress-incremental-resolver") {
+        string arg = (*argv)[i];
+        if (arg == "--stress-incremental-resolver") {
             opts = make_unique<const realmain::options::Options>(createDefaultOptions(true));
+        } else if (absl::StartsWith(arg, TIME_BUDGET_FLAG)) {
+            timeBudget = chrono::milliseconds(stoi(arg.substr(TIME_BUDGET_FLAG.size())));
+        } else if (absl::StartsWith(arg, SLOW_INPUT_DIR_FLAG)) {
+            slowInputDir = arg.substr(SLOW_INPUT_DIR_FLAG.size());
         }
     }
 
@@ -60,6 +88,7 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     unique_ptr<core::GlobalState> gs;
     { gs = commonGs->deepCopy(true); }
     string inputData((const char *)data, size);
+    auto start = chrono::steady_clock::now();
     vector<ast::ParsedFile> indexed;
     vector<core::FileRef> inputFiles;
     {
@@ -72,5 +101,11 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     indexed = realmain::pipeline::index(gs, inputFiles, *opts, *workers, kvstore);
     indexed = realmain::pipeline::resolve(gs, move(indexed), *opts, *workers);
     indexed = realmain::pipeline::typecheck(gs, move(indexed), *opts, *workers);
+    if (timeBudget.has_value()) {
+        auto took = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        if (took > *timeBudget) {
+            reportSlowInput(inputData, took);
+        }
+    }
     return 0;
 }
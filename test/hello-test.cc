@@ -5,6 +5,7 @@
 #include "ast/Helpers.h"
 #include "ast/ast.h"
 #include "ast/treemap/treemap.h"
+#include "ast/treemap/treewalk.h"
 #include "common/common.h"
 #include "core/Error.h"
 #include "core/GlobalSubstitution.h"
@@ -171,6 +172,111 @@ TEST(PreOrderTreeMap, CountTrees) { // NOLINT
     EXPECT_EQ(c.count, 3);
 }
 
+TEST(TreeWalk, VisitsInTreeMapOrder) { // NOLINT
+    class Recorder {
+    public:
+        vector<string> visits;
+
+        void preWalkClassDef(core::Context ctx, const ast::ClassDef &original) {
+            visits.emplace_back("preClassDef");
+        }
+        void postWalkClassDef(core::Context ctx, const ast::ClassDef &original) {
+            visits.emplace_back("postClassDef");
+        }
+        void preWalkMethodDef(core::Context ctx, const ast::MethodDef &original) {
+            visits.emplace_back("preMethodDef");
+        }
+        void postWalkMethodDef(core::Context ctx, const ast::MethodDef &original) {
+            visits.emplace_back("postMethodDef");
+        }
+        void postWalkLiteral(core::Context ctx, const ast::Literal &original) {
+            visits.emplace_back("postLiteral");
+        }
+    };
+
+    sorbet::core::GlobalState cb(errorQueue);
+    cb.initEmpty();
+    sorbet::core::Loc loc(sorbet::core::FileRef(), 42, 91);
+    sorbet::core::NameRef name;
+    {
+        sorbet::core::UnfreezeNameTable nt(cb);
+        name = cb.enterNameUTF8("Foo");
+    }
+
+    ast::MethodDef::ARGS_store args;
+    ast::ClassDef::RHS_store classrhs;
+    classrhs.emplace_back(make_unique<ast::MethodDef>(loc, loc, core::Symbols::todo(), name, std::move(args),
+                                                      ast::MK::Int(loc, 5), false));
+    unique_ptr<ast::Expression> tree = make_unique<ast::ClassDef>(
+        loc, loc, core::Symbols::todo(), make_unique<ast::UnresolvedConstantLit>(loc, ast::MK::EmptyTree(), name),
+        ast::ClassDef::ANCESTORS_store(), std::move(classrhs), ast::ClassDefKind::Class);
+    auto *before = tree.get();
+
+    Recorder recorder;
+    ast::TreeWalk::apply(core::Context(cb, core::Symbols::root()), recorder, tree.get());
+    EXPECT_EQ(before, tree.get());
+    EXPECT_EQ(recorder.visits,
+              vector<string>({"preClassDef", "preMethodDef", "postLiteral", "postMethodDef", "postClassDef"}));
+}
+
+TEST(TreeMap, FusedTransformRunsBothPasses) { // NOLINT
+    class Recorder {
+    public:
+        string prefix;
+        bool dropMethods = false;
+        vector<string> &visits;
+
+        Recorder(string prefix, vector<string> &visits) : prefix(prefix), visits(visits) {}
+
+        unique_ptr<ast::ClassDef> preTransformClassDef(core::Context ctx, unique_ptr<ast::ClassDef> original) {
+            visits.emplace_back(prefix + "preClassDef");
+            return original;
+        }
+        unique_ptr<ast::Expression> postTransformMethodDef(core::Context ctx, unique_ptr<ast::MethodDef> original) {
+            visits.emplace_back(prefix + "postMethodDef");
+            if (dropMethods) {
+                return ast::MK::EmptyTree();
+            }
+            return original;
+        }
+        unique_ptr<ast::Expression> postTransformLiteral(core::Context ctx, unique_ptr<ast::Literal> original) {
+            visits.emplace_back(prefix + "postLiteral");
+            return original;
+        }
+    };
+
+    sorbet::core::GlobalState cb(errorQueue);
+    cb.initEmpty();
+    sorbet::core::Loc loc(sorbet::core::FileRef(), 42, 91);
+    sorbet::core::NameRef name;
+    {
+        sorbet::core::UnfreezeNameTable nt(cb);
+        name = cb.enterNameUTF8("Foo");
+    }
+
+    ast::MethodDef::ARGS_store args;
+    ast::ClassDef::RHS_store classrhs;
+    classrhs.emplace_back(make_unique<ast::MethodDef>(loc, loc, core::Symbols::todo(), name, std::move(args),
+                                                      ast::MK::Int(loc, 5), false));
+    unique_ptr<ast::Expression> tree = make_unique<ast::ClassDef>(
+        loc, loc, core::Symbols::todo(), make_unique<ast::UnresolvedConstantLit>(loc, ast::MK::EmptyTree(), name),
+        ast::ClassDef::ANCESTORS_store(), std::move(classrhs), ast::ClassDefKind::Class);
+
+    vector<string> visits;
+    Recorder first("first.", visits);
+    Recorder second("second.", visits);
+    first.dropMethods = true;
+    ast::FusedTransform<Recorder, Recorder> fused(first, second);
+    tree = ast::TreeMap::apply(core::Context(cb, core::Symbols::root()), fused, std::move(tree));
+
+    // `second` never sees the method that `first` replaced.
+    EXPECT_EQ(visits, vector<string>({"first.preClassDef", "second.preClassDef", "first.postLiteral",
+                                      "second.postLiteral", "first.postMethodDef"}));
+    auto *classDef = ast::cast_tree<ast::ClassDef>(tree.get());
+    ASSERT_NE(nullptr, classDef);
+    EXPECT_TRUE(ast::isa_tree<ast::EmptyTree>(classDef->rhs.front().get()));
+}
+
 TEST(PayloadTests, CloneSubstitutePayload) {
     auto logger = spd::stderr_color_mt("ClonePayload");
     auto errorQueue = make_shared<sorbet::core::ErrorQueue>(*logger, *logger);
@@ -192,4 +298,16 @@ TEST(PayloadTests, CloneSubstitutePayload) {
     ASSERT_EQ(c1->symbolsUsed(), c2->symbolsUsed());
     ASSERT_EQ(c1->symbolsUsed(), gs.symbolsUsed());
 }
+
+TEST(GlobalStateHash, NoticesWritesAfterCaching) { // NOLINT
+    sorbet::core::GlobalState gs(errorQueue);
+    gs.initEmpty();
+    auto before = gs.hash()->hierarchyHash;
+    auto copy = gs.deepCopy();
+    ASSERT_EQ(before, copy->hash()->hierarchyHash);
+
+    core::Symbols::Integer().data(*copy)->setIsModule(true);
+    EXPECT_NE(before, copy->hash()->hierarchyHash);
+    EXPECT_EQ(before, gs.hash()->hierarchyHash);
+}
 } // namespace sorbet
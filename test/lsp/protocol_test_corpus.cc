@@ -345,6 +345,39 @@ TEST_F(ProtocolTest, CompletionOnNonClass) {
     send(LSPMessage(move(completionReq)));
 }
 
+// Completion leaves the signature and documentation of methods for completionItem/resolve.
+TEST_F(ProtocolTest, CompletionItemResolveAddsDetails) {
+    assertDiagnostics(initializeLSP(), {});
+    send(*openFile("yolo1.rb", "# typed: true\nclass A\n  # Does foo.\n  def foo; end\nend\nA.new.fo\n"));
+
+    auto completionParams = make_unique<CompletionParams>(make_unique<TextDocumentIdentifier>(getUri("yolo1.rb")),
+                                                          make_unique<Position>(5, 8));
+    auto completionResponses = send(LSPMessage(
+        make_unique<RequestMessage>("2.0", nextId++, LSPMethod::TextDocumentCompletion, move(completionParams))));
+    ASSERT_EQ(completionResponses.size(), 1);
+    ASSERT_TRUE(completionResponses.at(0)->isResponse());
+    auto &completionList = get<unique_ptr<CompletionList>>(*completionResponses.at(0)->asResponse().result);
+    unique_ptr<CompletionItem> foo;
+    for (auto &item : completionList->items) {
+        if (item->label == "foo") {
+            foo = move(item);
+        }
+    }
+    ASSERT_NE(foo, nullptr);
+    EXPECT_FALSE(foo->detail.has_value());
+    EXPECT_TRUE(foo->data.has_value());
+
+    auto resolveResponses =
+        send(LSPMessage(make_unique<RequestMessage>("2.0", nextId++, LSPMethod::CompletionItemResolve, move(foo))));
+    ASSERT_EQ(resolveResponses.size(), 1);
+    ASSERT_TRUE(resolveResponses.at(0)->isResponse());
+    auto &resolved = get<unique_ptr<CompletionItem>>(*resolveResponses.at(0)->asResponse().result);
+    EXPECT_EQ(resolved->label, "foo");
+    EXPECT_TRUE(resolved->detail.has_value());
+    ASSERT_TRUE(resolved->documentation.has_value());
+    EXPECT_EQ(get<string>(*resolved->documentation), " Does foo.\n");
+}
+
 // Ensures that unrecognized notifications are ignored.
 TEST_F(ProtocolTest, IgnoresUnrecognizedNotifications) {
     assertDiagnostics(initializeLSP(), {});
@@ -0,0 +1,97 @@
+#include "main/lsp/LSPMessage.h"
+#include "main/lsp/lsp.h"
+#include "main/lsp/wrapper.h"
+#include "main/options/options.h"
+#include "payload/payload.h"
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+namespace sorbet::realmain::lsp {
+using namespace std;
+
+namespace {
+struct RecordedMessage {
+    chrono::milliseconds offset;
+    unique_ptr<LSPMessage> message;
+};
+
+// Reads a session written by --lsp-record-session: one message a line, after the milliseconds since it started.
+vector<RecordedMessage> readSession(string_view path) {
+    vector<RecordedMessage> session;
+    ifstream in{string(path)};
+    string line;
+    while (getline(in, line)) {
+        auto tab = line.find('\t');
+        if (tab == string::npos) {
+            continue;
+        }
+        auto offset = chrono::milliseconds(stoll(line.substr(0, tab)));
+        session.push_back(RecordedMessage{offset, LSPMessage::fromClient(line.substr(tab + 1))});
+    }
+    return session;
+}
+} // namespace
+
+int replaySession(string_view sessionPath, vector<char *> sorbetArgs) {
+    auto stderrColorSink = make_shared<spd::sinks::ansicolor_stderr_sink_mt>();
+    auto logger = make_shared<spd::logger>("console", stderrColorSink);
+    auto typeErrorsConsole = make_shared<spd::logger>("typeDiagnostics", stderrColorSink);
+    typeErrorsConsole->set_pattern("%v");
+
+    options::Options opts;
+    try {
+        options::readOptions(opts, sorbetArgs.size(), sorbetArgs.data(), logger);
+    } catch (options::EarlyReturnWithCode &c) {
+        return c.returnCode;
+    }
+    auto gs = make_unique<core::GlobalState>((make_shared<core::ErrorQueue>(*typeErrorsConsole, *logger)));
+    unique_ptr<KeyValueStore> kvstore;
+    payload::createInitialGlobalState(gs, opts, kvstore);
+    gs->errorQueue->ignoreFlushes = true;
+    LSPWrapper lspWrapper(move(gs), move(opts), logger, false);
+
+    auto session = readSession(sessionPath);
+    if (session.empty()) {
+        cerr << "No messages recorded in " << sessionPath << "\n";
+        return 1;
+    }
+
+    // Whatever the editor sent while the previous messages were being processed is handed to LSP at once, the way
+    // LSPLoop's queue would have seen it. The recorded pauses themselves are not waited out.
+    auto replayStart = chrono::steady_clock::now();
+    size_t next = 0;
+    while (next < session.size()) {
+        auto elapsed = chrono::steady_clock::now() - replayStart;
+        vector<unique_ptr<LSPMessage>> batch;
+        do {
+            batch.push_back(move(session[next].message));
+            next++;
+        } while (next < session.size() && session[next].offset <= elapsed);
+        lspWrapper.getLSPResponsesFor(batch);
+    }
+    auto replayTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - replayStart);
+
+    auto perfReport = make_unique<RequestMessage>("2.0", "lsp_replay", LSPMethod::SorbetPerfReport, JSONNullObject());
+    auto responses = lspWrapper.getLSPResponsesFor(LSPMessage(move(perfReport)));
+    if (responses.size() != 1 || !responses.at(0)->isResponse()) {
+        cerr << "Sorbet returned an invalid response for sorbet/perfReport\n";
+        return 1;
+    }
+    cerr << "Replayed " << session.size() << " messages in " << replayTime.count() << "ms\n";
+    cout << responses.at(0)->toJSON() << "\n";
+    return 0;
+}
+} // namespace sorbet::realmain::lsp
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: lsp_replay path/to/session [sorbet options...]\n";
+        return 1;
+    }
+
+    // The remaining arguments are read the way `sorbet --lsp` would read them.
+    std::vector<char *> sorbetArgs{argv[0]};
+    sorbetArgs.insert(sorbetArgs.end(), argv + 2, argv + argc);
+    return sorbet::realmain::lsp::replaySession(argv[1], std::move(sorbetArgs));
+}
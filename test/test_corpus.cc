@@ -113,6 +113,9 @@ UnorderedSet<string> knownExpectations = {
 ast::ParsedFile testSerialize(core::GlobalState &gs, ast::ParsedFile expr) {
     auto saved = core::serialize::Serializer::storeExpression(gs, expr.tree);
     auto restored = core::serialize::Serializer::loadExpression(gs, saved.data());
+    // Round trip through the uncompressed format too, which is read in place.
+    auto savedUncompressed = core::serialize::Serializer::storeExpression(gs, restored, false);
+    restored = core::serialize::Serializer::loadExpression(gs, savedUncompressed.data());
     return {move(restored), expr.file};
 }
 
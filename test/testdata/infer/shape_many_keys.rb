@@ -0,0 +1,32 @@
+# typed: true
+
+# Shapes with enough keys to be looked up through their index rather than by scanning.
+extend T::Sig
+
+sig do
+  params(
+    config: {
+      k01: Integer, k02: Integer, k03: Integer, k04: Integer, k05: Integer, k06: Integer, k07: Integer,
+      k08: Integer, k09: Integer, k10: Integer, k11: Integer, k12: Integer, k13: Integer, k14: Integer,
+      k15: Integer, k16: Integer, k17: String, k18: Symbol, '19' => Integer, 20 => Integer,
+    }
+  ).void
+end
+def takes_config(config); end
+
+config = {
+  '19' => 0, 20 => 0, k18: :sym, k17: "str", k16: 0, k15: 0, k14: 0, k13: 0, k12: 0, k11: 0, k10: 0,
+  k09: 0, k08: 0, k07: 0, k06: 0, k05: 0, k04: 0, k03: 0, k02: 0, k01: 0,
+}
+takes_config(config)
+
+takes_config(config.merge({k17: 1})) # error: Expected `{k01: Integer
+
+T.assert_type!(
+  config.merge({k01: "one", k99: 1}),
+  {
+    '19' => Integer, 20 => Integer, k18: Symbol, k17: String, k16: Integer, k15: Integer, k14: Integer,
+    k13: Integer, k12: Integer, k11: Integer, k10: Integer, k09: Integer, k08: Integer, k07: Integer,
+    k06: Integer, k05: Integer, k04: Integer, k03: Integer, k02: Integer, k01: String, k99: Integer,
+  }
+)
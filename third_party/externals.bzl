@@ -13,6 +13,12 @@ def externals():
         shallow_since = "1547838363 -0500",
     )
 
+    git_repository(
+        name = "com_google_benchmark",
+        remote = "https://github.com/google/benchmark.git",
+        commit = "090faecb454fbd6e6e17a75ef8146acb037118d4",  # v1.5.0
+    )
+
     http_archive(
         name = "yaml_cpp",
         url = "https://github.com/jbeder/yaml-cpp/archive/yaml-cpp-0.6.2.zip",
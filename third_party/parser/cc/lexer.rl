@@ -111,6 +111,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <ruby_parser/driver.hh>
 #include <cassert>
+#include <cstring>
 #include "absl/strings/numbers.h"
 
 %% write data nofinal;
@@ -1340,8 +1341,21 @@ void lexer::set_state_expr_value() {
     | '\\' e_heredoc_nl
     ;
 
+  # Every byte of a comment up to the next newline would only loop in
+  # the c_line* state, so skip straight to that newline instead of
+  # stepping through the comment text one byte at a time. memchr scans
+  # a vector register's worth of bytes per step. Without a newline the
+  # comment runs into EOF, which is left to the regular transitions.
+  action skip_comment_text {
+    sharp_s = p;
+    const char* comment_nl = static_cast<const char*>(memchr(p + 1, '\n', pe - p - 1));
+    if (comment_nl != nullptr) {
+      fexec comment_nl;
+    }
+  }
+
   w_comment =
-      '#'     %{ sharp_s = p - 1; }
+      '#'     $skip_comment_text
       # The (p == pe) condition compensates for added "\0" and
       # the way Ragel handles EOF.
       c_line* %{ emit_comment(sharp_s, p == pe ? p - 2 : p); }
@@ -0,0 +1,20 @@
+#!/bin/bash
+
+set -exuo pipefail
+
+# Like fuzz.sh, but looks for inputs that are slow to typecheck rather than ones that crash. Every input that takes
+# longer than the budget is kept in fuzz_slow/. To shrink one to the smallest input that is still too slow, run
+#   bazel-bin/test/fuzz/fuzz_dash_e -minimize_crash=1 <input> --time-budget-ms=<budget>
+budget_ms="${1:-2000}"
+
+bazel build //test/fuzz:fuzz_dash_e --config=fuzz -c opt
+PATH=$PATH:$(pwd)/bazel-sorbet/external/llvm_toolchain/bin/
+export PATH
+
+mkdir -p fuzz_corpus
+find ./test/testdata/ -iname "*.rb"|grep -v disable|xargs -n 1 -I % cp % fuzz_corpus
+
+mkdir -p fuzz_slow/original
+
+nice ./bazel-bin/test/fuzz/fuzz_dash_e -use_value_profile=1 -only_ascii=1 -dict=test/fuzz/ruby.dict \
+    -artifact_prefix=fuzz_slow/original/ fuzz_corpus/ --time-budget-ms="$budget_ms" --slow-input-dir=fuzz_slow